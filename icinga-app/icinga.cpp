@@ -32,6 +32,7 @@
 #include "base/context.hpp"
 #include "base/console.hpp"
 #include "base/process.hpp"
+#include "base/memoryusage.hpp"
 #include "config.h"
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -212,7 +213,21 @@ static int Main()
 #endif /* RLIMIT_STACK */
 	}
 
-	Application::DeclareConcurrency(std::thread::hardware_concurrency());
+	String cpuAffinity = Utility::GetFromEnvironment("ICINGA2_CPU_AFFINITY");
+	if (!cpuAffinity.IsEmpty()) {
+		try {
+			Application::SetCpuAffinity(cpuAffinity);
+		} catch (const std::invalid_argument& ex) {
+			std::cout
+				<< "Error setting \"ICINGA2_CPU_AFFINITY\": " << ex.what() << '\n';
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!Utility::GetFromEnvironment("ICINGA2_MEMORY_ACCOUNTING").IsEmpty())
+		MemoryUsage::EnableTypeAccounting();
+
+	Application::DeclareConcurrency(Application::GetCpuCount());
 	Application::DeclareMaxConcurrentChecks(Application::GetDefaultMaxConcurrentChecks());
 
 	ScriptGlobal::Set("Environment", "production");
@@ -38,9 +38,12 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <set>
 #include <thread>
 #ifdef __linux__
 #include <sys/prctl.h>
+#include <pthread.h>
+#include <sched.h>
 #endif /* __linux__ */
 #ifdef _WIN32
 #include <windows.h>
@@ -57,9 +60,14 @@ boost::signals2::signal<void ()> Application::OnReopenLogs;
 Application::Ptr Application::m_Instance = nullptr;
 bool Application::m_ShuttingDown = false;
 bool Application::m_RequestRestart = false;
+bool Application::m_RequestHandover = false;
 bool Application::m_RequestReopenLogs = false;
 pid_t Application::m_ReloadProcess = 0;
+std::function<bool ()> Application::m_ReloadHandler;
+std::vector<std::vector<int> > Application::m_CpuNodes;
+static thread_local int l_ThreadNode = -1;
 static bool l_Restarting = false;
+static bool l_ForceFullReload = false;
 static bool l_InExceptionHandler = false;
 int Application::m_ArgC;
 char **Application::m_ArgV;
@@ -310,7 +318,7 @@ void Application::RunEventLoop()
 	double lastLoop = Utility::GetTime();
 
 mainloop:
-	while (!m_ShuttingDown && !m_RequestRestart) {
+	while (!m_ShuttingDown && !m_RequestRestart && !m_RequestHandover) {
 		/* Watches for changes to the system time. Adjusts timers if necessary. */
 		Utility::Sleep(2.5);
 
@@ -340,6 +348,36 @@ mainloop:
 		lastLoop = now;
 	}
 
+	if (m_RequestHandover) {
+		m_RequestHandover = false;
+
+		Log(LogInformation, "Application", "Reload requested, letting new process take over.");
+
+		/* Checks kept running while the new process validated its config. Persist
+		 * their results now, the new process restores the state file once we're gone. */
+		Application::GetInstance()->OnHandover();
+
+#ifdef HAVE_SYSTEMD
+		sd_notifyf(0, "MAINPID=%lu", (unsigned long) m_ReloadProcess);
+#endif /* HAVE_SYSTEMD */
+
+		/* Write the PID of the new process to the pidfile before this
+		 * process exits to keep systemd happy.
+		 */
+		Application::Ptr instance = GetInstance();
+		try {
+			instance->UpdatePidFile(GetPidPath(), m_ReloadProcess);
+		} catch (const std::exception&) {
+			/* abort restart */
+			Log(LogCritical, "Application", "Cannot update PID file. Aborting restart operation.");
+			goto mainloop;
+		}
+
+		instance->ClosePidFile(false);
+
+		Exit(0);
+	}
+
 	if (m_RequestRestart) {
 		m_RequestRestart = false;         // we are now handling the request, once is enough
 
@@ -352,6 +390,30 @@ mainloop:
 			goto mainloop;
 
 		l_Restarting = true;
+
+		/* Try to apply the changes in this process. The handler runs in its own
+		 * thread because it waits for the new configuration to be validated. */
+		if (m_ReloadHandler && !l_ForceFullReload) {
+			std::thread t([]() {
+				bool handled = m_ReloadHandler();
+
+				l_Restarting = false;
+
+				if (handled) {
+#ifdef HAVE_SYSTEMD
+					sd_notify(0, "READY=1");
+#endif /* HAVE_SYSTEMD */
+				} else {
+					l_ForceFullReload = true;
+					RequestRestart();
+				}
+			});
+			t.detach();
+
+			goto mainloop;
+		}
+
+		l_ForceFullReload = false;
 		m_ReloadProcess = StartReloadProcess();
 
 		goto mainloop;
@@ -379,6 +441,14 @@ void Application::OnShutdown()
 	/* Nothing to do here. */
 }
 
+/**
+ * Called before this process exits so that the reload process can take over.
+ */
+void Application::OnHandover()
+{
+	/* Nothing to do here. */
+}
+
 static void ReloadProcessCallbackInternal(const ProcessResult& pr)
 {
 	if (pr.ExitStatus != 0) {
@@ -448,6 +518,16 @@ void Application::RequestRestart()
 	m_RequestRestart = true;
 }
 
+/**
+ * Sets a handler which is called instead of starting a new process when
+ * a restart was requested. The handler returns false if a new process
+ * has to be started anyway.
+ */
+void Application::SetReloadHandler(const std::function<bool ()>& handler)
+{
+	m_ReloadHandler = handler;
+}
+
 /**
  * Signals the application to reopen log files during the
  * next execution of the event loop.
@@ -716,32 +796,14 @@ void Application::SigUsr1Handler(int)
 }
 
 /**
- * Signal handler for SIGUSR2. Hands over PID to child and commits suicide
+ * Signal handler for SIGUSR2. The event loop hands over the current state
+ * and the PID to the child and commits suicide.
  *
  * @param - The signal number.
  */
 void Application::SigUsr2Handler(int)
 {
-	Log(LogInformation, "Application", "Reload requested, letting new process take over.");
-#ifdef HAVE_SYSTEMD
-	sd_notifyf(0, "MAINPID=%lu", (unsigned long) m_ReloadProcess);
-#endif /* HAVE_SYSTEMD */
-
-	/* Write the PID of the new process to the pidfile before this
-	 * process exits to keep systemd happy.
-	 */
-	Application::Ptr instance = GetInstance();
-	try {
-		instance->UpdatePidFile(GetPidPath(), m_ReloadProcess);
-	} catch (const std::exception&) {
-		/* abort restart */
-		Log(LogCritical, "Application", "Cannot update PID file. Aborting restart operation.");
-		return;
-	}
-
-	instance->ClosePidFile(false);
-
-	Exit(0);
+	m_RequestHandover = true;
 }
 
 /**
@@ -1553,6 +1615,196 @@ int Application::GetConcurrency()
 	return ScriptGlobal::Get("Concurrency", &defaultConcurrency);
 }
 
+/**
+ * Retrieves the concurrency level for a NUMA node, i.e. the node's share of
+ * the concurrency level.
+ *
+ * @param node The node.
+ * @returns The concurrency level.
+ */
+int Application::GetConcurrency(int node)
+{
+	int concurrency = GetConcurrency();
+
+	if (m_CpuNodes.empty())
+		return concurrency;
+
+	size_t total = 0;
+
+	for (const std::vector<int>& cpus : m_CpuNodes)
+		total += cpus.size();
+
+	size_t cpus = m_CpuNodes[node % m_CpuNodes.size()].size();
+
+	return std::max(1, static_cast<int>(concurrency * cpus / total));
+}
+
+/**
+ * Parses a list of CPUs, e.g. "0-3,8,10-11".
+ */
+static std::set<int> ParseCpuList(const String& list)
+{
+	std::set<int> cpus;
+
+	for (const String& token : list.Split(",")) {
+		String range = token.Trim();
+
+		if (range.IsEmpty())
+			continue;
+
+		size_t pos = range.Find("-");
+		long first, last;
+
+		if (pos == String::NPos)
+			first = last = Convert::ToLong(range);
+		else {
+			first = Convert::ToLong(range.SubStr(0, pos));
+			last = Convert::ToLong(range.SubStr(pos + 1));
+		}
+
+		if (first < 0 || last < first)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid CPU range '" + range + "'."));
+
+		for (long cpu = first; cpu <= last; cpu++)
+			cpus.insert(cpu);
+	}
+
+	return cpus;
+}
+
+/**
+ * Restricts the threads to a set of CPUs and partitions them by NUMA node.
+ * This must be called before any threads are started.
+ *
+ * @param cpus A list of CPUs, e.g. "0-31,64-95", or "all" to use all CPUs.
+ */
+void Application::SetCpuAffinity(const String& cpus)
+{
+	std::vector<std::set<int> > nodes;
+
+	Utility::Glob("/sys/devices/system/node/node*", [&nodes](const String& path) {
+		std::ifstream fp((path + "/cpulist").CStr());
+		String line;
+
+		if (std::getline(fp, line.GetData()))
+			nodes.push_back(ParseCpuList(line));
+	}, GlobDirectory);
+
+	/* Without NUMA information all CPUs belong to the same node. */
+	if (nodes.empty()) {
+		std::set<int> all;
+
+		for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency(); cpu++)
+			all.insert(cpu);
+
+		nodes.push_back(all);
+	}
+
+	std::set<int> allowed;
+
+	if (cpus != "all")
+		allowed = ParseCpuList(cpus);
+
+	m_CpuNodes.clear();
+
+	for (const std::set<int>& node : nodes) {
+		std::vector<int> nodeCpus;
+
+		for (int cpu : node) {
+			if (cpus == "all" || allowed.find(cpu) != allowed.end())
+				nodeCpus.push_back(cpu);
+		}
+
+		if (!nodeCpus.empty())
+			m_CpuNodes.push_back(std::move(nodeCpus));
+	}
+
+	if (m_CpuNodes.empty())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("None of the CPUs '" + cpus + "' are available."));
+
+	/* Threads which don't belong to a node inherit this. */
+	SetThreadAffinity(-1);
+}
+
+/**
+ * Retrieves the number of CPUs the threads may use.
+ *
+ * @returns The number of CPUs.
+ */
+int Application::GetCpuCount()
+{
+	if (m_CpuNodes.empty())
+		return std::thread::hardware_concurrency();
+
+	int count = 0;
+
+	for (const std::vector<int>& cpus : m_CpuNodes)
+		count += cpus.size();
+
+	return count;
+}
+
+/**
+ * Retrieves the number of NUMA nodes the threads are partitioned into.
+ *
+ * @returns The number of nodes, 1 unless a CPU affinity was set.
+ */
+int Application::GetCpuNodeCount()
+{
+	return std::max<int>(1, m_CpuNodes.size());
+}
+
+/**
+ * Binds the current thread to the CPUs of a NUMA node. Does nothing unless
+ * a CPU affinity was set.
+ *
+ * @param node The node, modulo the number of nodes. -1 allows all CPUs.
+ */
+void Application::SetThreadAffinity(int node)
+{
+	if (m_CpuNodes.empty())
+		return;
+
+	std::vector<int> cpus;
+
+	if (node < 0) {
+		for (const std::vector<int>& nodeCpus : m_CpuNodes)
+			cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+
+		l_ThreadNode = -1;
+	} else {
+		l_ThreadNode = node % m_CpuNodes.size();
+		cpus = m_CpuNodes[l_ThreadNode];
+	}
+
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (int cpu : cpus) {
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	}
+
+	int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+	if (rc != 0) {
+		Log(LogWarning, "Application")
+			<< "Could not set the CPU affinity for node " << node << ": " << Utility::FormatErrorNumber(rc);
+	}
+#endif /* __linux__ */
+}
+
+/**
+ * Retrieves the NUMA node the current thread is bound to.
+ *
+ * @returns The node, or -1 if the thread isn't bound to a node.
+ */
+int Application::GetThreadNode()
+{
+	return l_ThreadNode;
+}
+
 /**
  * Sets the max concurrent checks.
  *
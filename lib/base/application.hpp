@@ -24,6 +24,7 @@
 #include "base/application-ti.hpp"
 #include "base/logger.hpp"
 #include <iosfwd>
+#include <functional>
 
 namespace icinga
 {
@@ -71,6 +72,7 @@ public:
 
 	static void RequestShutdown();
 	static void RequestRestart();
+	static void SetReloadHandler(const std::function<bool ()>& handler);
 	static void RequestReopenLogs();
 
 	static bool IsShuttingDown();
@@ -144,8 +146,15 @@ public:
 	static void DeclareRLimitStack(int limit);
 
 	static int GetConcurrency();
+	static int GetConcurrency(int node);
 	static void DeclareConcurrency(int ncpus);
 
+	static void SetCpuAffinity(const String& cpus);
+	static int GetCpuCount();
+	static int GetCpuNodeCount();
+	static void SetThreadAffinity(int node);
+	static int GetThreadNode();
+
 	static int GetMaxConcurrentChecks();
 	static int GetDefaultMaxConcurrentChecks();
 	static void DeclareMaxConcurrentChecks(int maxChecks);
@@ -179,6 +188,7 @@ protected:
 	pid_t StartReloadProcess();
 
 	virtual void OnShutdown();
+	virtual void OnHandover();
 
 	void ValidateName(const Lazy<String>& lvalue, const ValidationUtils& utils) final;
 
@@ -187,8 +197,11 @@ private:
 
 	static bool m_ShuttingDown; /**< Whether the application is in the process of shutting down. */
 	static bool m_RequestRestart; /**< A restart was requested through SIGHUP */
+	static bool m_RequestHandover; /**< The reload process asked to take over through SIGUSR2 */
 	static pid_t m_ReloadProcess; /**< The PID of a subprocess doing a reload, only valid when l_Restarting==true */
 	static bool m_RequestReopenLogs; /**< Whether we should re-open log files. */
+	static std::function<bool ()> m_ReloadHandler; /**< Applies config changes without starting a new process. */
+	static std::vector<std::vector<int> > m_CpuNodes; /**< The CPUs threads may use per NUMA node, empty unless a CPU affinity was set. */
 
 	static int m_ArgC; /**< The number of command-line arguments. */
 	static char **m_ArgV; /**< Command-line arguments. */
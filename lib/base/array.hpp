@@ -22,6 +22,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/objectlock.hpp"
+#include "base/objectpool.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
 #include <vector>
@@ -41,6 +42,7 @@ class Array final : public Object
 {
 public:
 	DECLARE_OBJECT(Array);
+	DECLARE_POOLED_ALLOCATOR();
 
 	/**
 	 * An iterator that can be used to iterate over array elements.
@@ -0,0 +1,112 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/atom.hpp"
+#include <boost/thread/mutex.hpp>
+#include <unordered_set>
+
+using namespace icinga;
+
+struct AtomHash
+{
+	size_t operator()(const String& str) const
+	{
+		return std::hash<std::string>()(str.GetData());
+	}
+};
+
+typedef std::unordered_set<String, AtomHash> AtomTable;
+
+/* Atoms may be used in static initializers, so the table is created on first use. */
+static boost::mutex& GetAtomMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+/* The table is never cleaned up, atoms stay valid until the process exits. */
+static AtomTable& GetAtomTable()
+{
+	static AtomTable *table = new AtomTable();
+	return *table;
+}
+
+static const String *InternString(const String& str)
+{
+	boost::mutex::scoped_lock lock(GetAtomMutex());
+
+	/* Elements of node-based containers don't move on insertion. */
+	return &*GetAtomTable().insert(str).first;
+}
+
+Atom::Atom()
+{
+	static const String *emptyAtom = InternString(String());
+
+	m_String = emptyAtom;
+}
+
+Atom::Atom(const String& str)
+	: m_String(InternString(str))
+{ }
+
+Atom::Atom(const char *str)
+	: m_String(InternString(str))
+{ }
+
+const String& Atom::GetString() const
+{
+	return *m_String;
+}
+
+Atom::operator const String&() const
+{
+	return *m_String;
+}
+
+bool Atom::operator==(const Atom& rhs) const
+{
+	return m_String == rhs.m_String;
+}
+
+bool Atom::operator!=(const Atom& rhs) const
+{
+	return m_String != rhs.m_String;
+}
+
+/**
+ * Orders atoms by their address. This is stable for the process' lifetime
+ * but isn't the lexical order.
+ */
+bool Atom::operator<(const Atom& rhs) const
+{
+	return std::less<const String *>()(m_String, rhs.m_String);
+}
+
+size_t Atom::GetHash() const
+{
+	return std::hash<const String *>()(m_String);
+}
+
+size_t Atom::GetCount()
+{
+	boost::mutex::scoped_lock lock(GetAtomMutex());
+
+	return GetAtomTable().size();
+}
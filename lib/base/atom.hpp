@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef ATOM_H
+#define ATOM_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include <functional>
+
+namespace icinga
+{
+
+/**
+ * An interned string. All atoms with the same content share one String
+ * which is never freed, so atoms can be copied, compared and hashed
+ * without touching the string's characters.
+ *
+ * Atoms are meant for a bounded set of names, e.g. attribute names and
+ * message keys. Don't use them for arbitrary user data.
+ *
+ * @ingroup base
+ */
+class Atom
+{
+public:
+	Atom();
+	Atom(const String& str);
+	Atom(const char *str);
+
+	const String& GetString() const;
+	operator const String&() const;
+
+	bool operator==(const Atom& rhs) const;
+	bool operator!=(const Atom& rhs) const;
+	bool operator<(const Atom& rhs) const;
+
+	size_t GetHash() const;
+
+	static size_t GetCount();
+
+private:
+	const String *m_String;
+};
+
+}
+
+namespace std
+{
+
+template<>
+struct hash<icinga::Atom>
+{
+	size_t operator()(const icinga::Atom& atom) const
+	{
+		return atom.GetHash();
+	}
+};
+
+}
+
+#endif /* ATOM_H */
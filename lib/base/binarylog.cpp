@@ -0,0 +1,177 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/binarylog.hpp"
+#include "base/exception.hpp"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+using namespace icinga;
+
+/*
+ * File header: "I2BL" followed by the format version (1 byte).
+ *
+ * Records start with their type (1 byte), all integers are little-endian:
+ *
+ * 'F' (facility): u32 id, u16 length, name
+ * 'E' (entry):    u8 severity, u32 facility id, f64 timestamp, u32 length, message
+ */
+static const char l_BinaryLogMagic[] = { 'I', '2', 'B', 'L' };
+static const unsigned char l_BinaryLogVersion = 1;
+
+static void WriteInt(std::ostream& stream, uint64_t value, size_t bytes)
+{
+	char buffer[8];
+
+	for (size_t i = 0; i < bytes; i++)
+		buffer[i] = static_cast<char>((value >> (i * 8)) & 0xff);
+
+	stream.write(buffer, bytes);
+}
+
+static uint64_t ReadInt(std::istream& stream, size_t bytes)
+{
+	unsigned char buffer[8];
+
+	if (!stream.read(reinterpret_cast<char *>(buffer), bytes))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Binary log record is truncated."));
+
+	uint64_t value = 0;
+
+	for (size_t i = 0; i < bytes; i++)
+		value |= static_cast<uint64_t>(buffer[i]) << (i * 8);
+
+	return value;
+}
+
+static String ReadData(std::istream& stream, size_t length)
+{
+	std::string data(length, '\0');
+
+	if (length > 0 && !stream.read(&data[0], length))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Binary log record is truncated."));
+
+	return data;
+}
+
+void BinaryLogWriter::WriteHeader(std::ostream& stream)
+{
+	m_Facilities.clear();
+
+	stream.write(l_BinaryLogMagic, sizeof(l_BinaryLogMagic));
+	stream.put(static_cast<char>(l_BinaryLogVersion));
+}
+
+void BinaryLogWriter::WriteEntry(std::ostream& stream, const LogEntry& entry)
+{
+	auto it = m_Facilities.find(entry.Facility.GetData());
+
+	if (it == m_Facilities.end()) {
+		it = m_Facilities.emplace(entry.Facility.GetData(), m_Facilities.size()).first;
+
+		size_t length = std::min<size_t>(entry.Facility.GetLength(), 0xffff);
+
+		stream.put('F');
+		WriteInt(stream, it->second, 4);
+		WriteInt(stream, length, 2);
+		stream.write(entry.Facility.CStr(), length);
+	}
+
+	uint64_t timestamp;
+	static_assert(sizeof(timestamp) == sizeof(entry.Timestamp), "double must be 64 bits wide");
+	memcpy(&timestamp, &entry.Timestamp, sizeof(timestamp));
+
+	stream.put('E');
+	stream.put(static_cast<char>(entry.Severity));
+	WriteInt(stream, it->second, 4);
+	WriteInt(stream, timestamp, 8);
+	WriteInt(stream, entry.Message.GetLength(), 4);
+	stream.write(entry.Message.CStr(), entry.Message.GetLength());
+}
+
+/**
+ * Reads the next log entry.
+ *
+ * @param stream The input stream.
+ * @param entry The log entry.
+ * @returns true if an entry was read, false at the end of the stream.
+ */
+bool BinaryLogReader::ReadEntry(std::istream& stream, LogEntry *entry)
+{
+	for (;;) {
+		int type = stream.get();
+
+		if (type == std::char_traits<char>::eof())
+			return false;
+
+		switch (type) {
+			case 'I': {
+				/* A new header is written whenever the log file was reopened. */
+				char magic[sizeof(l_BinaryLogMagic) - 1];
+
+				if (!stream.read(magic, sizeof(magic)) || memcmp(magic, l_BinaryLogMagic + 1, sizeof(magic)) != 0)
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid binary log header."));
+
+				if (stream.get() != l_BinaryLogVersion)
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported binary log version."));
+
+				m_Facilities.clear();
+				break;
+			}
+
+			case 'F': {
+				size_t id = ReadInt(stream, 4);
+				size_t length = ReadInt(stream, 2);
+
+				if (id >= m_Facilities.size())
+					m_Facilities.resize(id + 1);
+
+				m_Facilities[id] = ReadData(stream, length);
+				break;
+			}
+
+			case 'E': {
+				int severity = stream.get();
+
+				if (severity < LogDebug || severity > LogCritical)
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid severity in binary log record."));
+
+				size_t facility = ReadInt(stream, 4);
+
+				if (facility >= m_Facilities.size())
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Unknown facility in binary log record."));
+
+				uint64_t timestamp = ReadInt(stream, 8);
+				size_t length = ReadInt(stream, 4);
+
+				entry->Severity = static_cast<LogSeverity>(severity);
+				entry->Facility = m_Facilities[facility];
+				memcpy(&entry->Timestamp, &timestamp, sizeof(timestamp));
+				entry->Message = ReadData(stream, length);
+
+				return true;
+			}
+
+			default:
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid binary log record type."));
+		}
+	}
+}
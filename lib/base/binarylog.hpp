@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef BINARYLOG_H
+#define BINARYLOG_H
+
+#include "base/i2-base.hpp"
+#include "base/logger.hpp"
+#include <iosfwd>
+#include <unordered_map>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * Writes log entries in the compact binary log format.
+ *
+ * Each file (or each part of a file after it was reopened) starts with a
+ * header. Facility names are written once and then referred to by their ID.
+ *
+ * @ingroup base
+ */
+class BinaryLogWriter
+{
+public:
+	void WriteHeader(std::ostream& stream);
+	void WriteEntry(std::ostream& stream, const LogEntry& entry);
+
+private:
+	std::unordered_map<std::string, unsigned int> m_Facilities;
+};
+
+/**
+ * Reads log entries which were written by BinaryLogWriter.
+ *
+ * @ingroup base
+ */
+class BinaryLogReader
+{
+public:
+	bool ReadEntry(std::istream& stream, LogEntry *entry);
+
+private:
+	std::vector<String> m_Facilities;
+};
+
+}
+
+#endif /* BINARYLOG_H */
@@ -33,7 +33,16 @@
 #include "base/workqueue.hpp"
 #include "base/context.hpp"
 #include "base/application.hpp"
+#include "base/object-packer.hpp"
+#include "base/utility.hpp"
 #include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <iterator>
+#include <thread>
 #include <boost/exception/errinfo_api_function.hpp>
 #include <boost/exception/errinfo_errno.hpp>
 #include <boost/exception/errinfo_file_name.hpp>
@@ -44,6 +53,9 @@ REGISTER_TYPE_WITH_PROTOTYPE(ConfigObject, ConfigObject::GetPrototype());
 
 boost::signals2::signal<void (const ConfigObject::Ptr&)> ConfigObject::OnStateChanged;
 
+static boost::mutex l_DirtyObjectsMutex;
+static std::vector<ConfigObject::Ptr> l_DirtyObjects;
+
 bool ConfigObject::IsActive() const
 {
 	return GetActive();
@@ -453,6 +465,17 @@ void ConfigObject::OnStateLoaded()
 	/* Nothing to do here. */
 }
 
+/**
+ * Estimates how much CPU time per second running this object costs the
+ * endpoint which has the authority for it.
+ *
+ * @returns The estimated load or 0 if it is unknown.
+ */
+double ConfigObject::GetLoadEstimate() const
+{
+	return 0;
+}
+
 void ConfigObject::Pause()
 {
 	SetPauseCalled(true);
@@ -480,7 +503,199 @@ void ConfigObject::SetAuthority(bool authority)
 	}
 }
 
-void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
+void ConfigObject::MarkStateDirty()
+{
+	m_StateVersion++;
+
+	/* Only active objects are registered and thus safe to reference. */
+	if (!IsActive() || m_StateDirty.exchange(true))
+		return;
+
+	boost::mutex::scoped_lock lock(l_DirtyObjectsMutex);
+	l_DirtyObjects.emplace_back(this);
+}
+
+/**
+ * Returns the objects whose state attributes changed since the last call
+ * and resets their dirty flag.
+ */
+static std::vector<ConfigObject::Ptr> TakeDirtyObjects()
+{
+	std::vector<ConfigObject::Ptr> objects;
+
+	{
+		boost::mutex::scoped_lock lock(l_DirtyObjectsMutex);
+		objects.swap(l_DirtyObjects);
+	}
+
+	/* Objects which are changed while they're being dumped are marked again. */
+	for (const ConfigObject::Ptr& object : objects)
+		object->ResetStateDirty();
+
+	return objects;
+}
+
+void ConfigObject::ResetStateDirty()
+{
+	m_StateDirty = false;
+}
+
+/**
+ * Returns a counter which is incremented whenever one of the object's state
+ * attributes changes.
+ */
+uint64_t ConfigObject::GetStateVersion() const
+{
+	return m_StateVersion;
+}
+
+/* Records of the binary state format start with one of these bytes, records
+ * in the older JSON format start with '{'. */
+enum StateRecordType : char
+{
+	StateRecordSchema = 1,
+	StateRecordObject = 2
+};
+
+/**
+ * The fields of a type in a binary state file. Field names are only written
+ * once per type; the object records contain the values in the same order.
+ */
+struct StateSchema
+{
+	String TypeName;
+	Type::Ptr ObjectType;
+	std::vector<int> FieldIds; /**< The current field ID for each value, or -1. */
+	std::vector<bool> Deferred; /**< Whether the field is restored in the background. */
+};
+
+typedef std::vector<std::shared_ptr<const StateSchema> > StateSchemaList;
+
+static String MakeStateRecord(StateRecordType recordType, const Value& value)
+{
+	return String(1, recordType) + PackObject(value);
+}
+
+/**
+ * Serializes objects into a stream using the binary state format, i.e.
+ * netstrings which contain packed schema and object records.
+ *
+ * @returns The number of bytes written.
+ */
+static size_t SerializeObjects(std::ostream& fp, const std::vector<ConfigObject::Ptr>& objects, int attributeTypes)
+{
+	std::ostringstream msgbuf;
+
+	/* The schemas are written up front as the objects are serialized in parallel. */
+	std::unordered_map<Type *, std::pair<int, std::vector<int> > > schemas;
+
+	for (const ConfigObject::Ptr& object : objects) {
+		Type::Ptr type = object->GetReflectionType();
+
+		if (schemas.find(type.get()) != schemas.end())
+			continue;
+
+		std::vector<int> fieldIds;
+		ArrayData fieldNames;
+
+		for (int i = 0; i < type->GetFieldCount(); i++) {
+			Field field = type->GetFieldInfo(i);
+
+			if (attributeTypes != 0 && (field.Attributes & attributeTypes) == 0)
+				continue;
+
+			if (strcmp(field.Name, "type") == 0)
+				continue;
+
+			fieldIds.push_back(i);
+			fieldNames.emplace_back(field.Name);
+		}
+
+		int index = schemas.size();
+		schemas[type.get()] = std::make_pair(index, std::move(fieldIds));
+
+		NetString::WriteStringToStream(msgbuf, MakeStateRecord(StateRecordSchema, new Array({
+			index,
+			type->GetName(),
+			new Array(std::move(fieldNames))
+		})));
+	}
+
+	std::string header = msgbuf.str();
+	fp.write(header.c_str(), header.size());
+
+	size_t written = header.size();
+
+	/* Objects are serialized in parallel, one segment of objects per task. The
+	 * segments are written in order, a window of segments at a time so that
+	 * only a part of the state is held in memory. */
+	const size_t segmentSize = 1000;
+	const size_t segmentsPerWindow = 4 * Application::GetConcurrency();
+
+	WorkQueue dumpq(0, Application::GetConcurrency());
+	dumpq.SetName("ConfigObject::DumpObjects");
+
+	std::vector<std::string> segments;
+
+	for (size_t windowStart = 0; windowStart < objects.size(); windowStart += segmentSize * segmentsPerWindow) {
+		size_t windowEnd = std::min(objects.size(), windowStart + segmentSize * segmentsPerWindow);
+
+		segments.clear();
+		segments.resize((windowEnd - windowStart + segmentSize - 1) / segmentSize);
+
+		for (size_t i = 0; i < segments.size(); i++) {
+			dumpq.Enqueue([&objects, &segments, &schemas, windowStart, windowEnd, segmentSize, i, attributeTypes]() {
+				std::ostringstream msgbuf;
+
+				size_t begin = windowStart + i * segmentSize;
+				size_t end = std::min(windowEnd, begin + segmentSize);
+
+				for (size_t j = begin; j < end; j++) {
+					const ConfigObject::Ptr& object = objects[j];
+					const std::pair<int, std::vector<int> >& schema = schemas.at(object->GetReflectionType().get());
+
+					ArrayData values;
+					values.reserve(schema.second.size());
+
+					/* Same order as the schema: by field ID, without the type. */
+					object->VisitFields(attributeTypes, [attributeTypes, &values](const Field& field, const Value& value) {
+						if (strcmp(field.Name, "type") != 0)
+							values.emplace_back(Serialize(value, attributeTypes));
+					});
+
+					NetString::WriteStringToStream(msgbuf, MakeStateRecord(StateRecordObject, new Array({
+						schema.first,
+						object->GetName(),
+						new Array(std::move(values))
+					})));
+				}
+
+				segments[i] = msgbuf.str();
+			});
+		}
+
+		dumpq.Join();
+
+		if (dumpq.HasExceptions()) {
+			dumpq.ReportExceptions("ConfigObject");
+			BOOST_THROW_EXCEPTION(std::runtime_error("Could not serialize the program state."));
+		}
+
+		for (const std::string& segment : segments) {
+			fp.write(segment.c_str(), segment.size());
+			written += segment.size();
+		}
+	}
+
+	return written;
+}
+
+/**
+ * Writes the state of all objects into a file and removes the state journal.
+ *
+ * @returns The size of the file.
+ */
+size_t ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 {
 	Log(LogInformation, "ConfigObject")
 		<< "Dumping program state to file '" << filename << "'";
@@ -492,7 +707,10 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 	if (!fp)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + tempFilename + "' file"));
 
-	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+	/* All changes up to now are part of the full dump. */
+	TakeDirtyObjects();
+
+	std::vector<ConfigObject::Ptr> objects;
 
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
@@ -500,25 +718,11 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
-			Dictionary::Ptr update = Serialize(object, attributeTypes);
-
-			if (!update)
-				continue;
-
-			Dictionary::Ptr persistentObject = new Dictionary({
-				{ "type", type->GetName() },
-				{ "name", object->GetName() },
-				{ "update", update }
-			});
-
-			String json = JsonEncode(persistentObject);
-
-			NetString::WriteStringToStream(sfp, json);
-		}
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView())
+			objects.push_back(object);
 	}
 
-	sfp->Close();
+	size_t written = SerializeObjects(fp, objects, attributeTypes);
 
 	fp.close();
 
@@ -532,47 +736,254 @@ void ConfigObject::DumpObjects(const String& filename, int attributeTypes)
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(tempFilename));
 	}
+
+	String journalFilename = GetStateJournalPath(filename);
+
+	if (Utility::PathExists(journalFilename) && unlink(journalFilename.CStr()) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("unlink")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(journalFilename));
+	}
+
+	return written;
+}
+
+/**
+ * Appends the state of all objects which changed since the last dump to the
+ * state journal. The journal is applied on top of the state file when the
+ * state is restored, and removed by the next full dump.
+ *
+ * @returns The number of bytes appended to the journal.
+ */
+size_t ConfigObject::DumpModifiedObjects(const String& filename, int attributeTypes)
+{
+	std::vector<ConfigObject::Ptr> objects = TakeDirtyObjects();
+
+	String journalFilename = GetStateJournalPath(filename);
+
+	Log(LogInformation, "ConfigObject")
+		<< "Appending the state of " << objects.size() << " modified objects to file '" << journalFilename << "'";
+
+	if (objects.empty())
+		return 0;
+
+	std::fstream fp;
+	fp.open(journalFilename.CStr(), std::ios_base::out | std::ios_base::app | std::ios_base::binary);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + journalFilename + "' file"));
+
+	fp.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+	size_t written = SerializeObjects(fp, objects, attributeTypes);
+
+	fp.close();
+
+	return written;
+}
+
+String ConfigObject::GetStateJournalPath(const String& filename)
+{
+	return filename + ".journal";
+}
+
+/**
+ * The state of an object as read from a state file, in either format.
+ */
+struct PersistentObject
+{
+	String TypeName;
+	String Name;
+
+	/* JSON format */
+	Dictionary::Ptr Update;
+
+	/* binary format */
+	std::shared_ptr<const StateSchema> Schema;
+	Array::Ptr Values;
+
+	String GetKey() const
+	{
+		return TypeName + "!" + Name;
+	}
+};
+
+/**
+ * Handles a schema record by adding the schema to a copy of the list of
+ * schemas. Tasks which are already queued keep using the previous list.
+ */
+static void ReadStateSchema(const String& message, std::shared_ptr<const StateSchemaList>& schemas, int attributeTypes)
+{
+	Array::Ptr record = UnpackObject(message.SubStr(1));
+
+	int index = record->Get(0);
+	Array::Ptr fieldNames = record->Get(2);
+
+	if (index < 0 || !fieldNames)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid schema record in state file."));
+
+	auto schema = std::make_shared<StateSchema>();
+	schema->TypeName = record->Get(1);
+	schema->ObjectType = Type::GetByName(schema->TypeName);
+
+	ObjectLock olock(fieldNames);
+	for (const String& fieldName : fieldNames) {
+		int fid = schema->ObjectType ? schema->ObjectType->GetFieldId(fieldName) : -1;
+
+		if (fid >= 0 && (schema->ObjectType->GetFieldInfo(fid).Attributes & attributeTypes) == 0)
+			fid = -1;
+
+		schema->FieldIds.push_back(fid);
+		schema->Deferred.push_back(fid >= 0 && (schema->ObjectType->GetFieldInfo(fid).Attributes & FALazyRestore));
+	}
+
+	auto newSchemas = schemas ? std::make_shared<StateSchemaList>(*schemas) : std::make_shared<StateSchemaList>();
+
+	if (newSchemas->size() <= static_cast<size_t>(index))
+		newSchemas->resize(index + 1);
+
+	(*newSchemas)[index] = schema;
+	schemas = newSchemas;
+}
+
+static PersistentObject DecodePersistentObject(const String& message, const std::shared_ptr<const StateSchemaList>& schemas)
+{
+	PersistentObject result;
+
+	if (message.GetLength() > 0 && message[0] == StateRecordObject) {
+		Array::Ptr record = UnpackObject(message.SubStr(1));
+
+		int index = record->Get(0);
+
+		if (!schemas || index < 0 || static_cast<size_t>(index) >= schemas->size() || !(*schemas)[index])
+			BOOST_THROW_EXCEPTION(std::invalid_argument("State record refers to an unknown schema."));
+
+		result.Schema = (*schemas)[index];
+		result.TypeName = result.Schema->TypeName;
+		result.Name = record->Get(1);
+		result.Values = record->Get(2);
+	} else {
+		Dictionary::Ptr persistentObject = JsonDecode(message);
+
+		result.TypeName = persistentObject->Get("type");
+		result.Name = persistentObject->Get("name");
+		result.Update = persistentObject->Get("update");
+	}
+
+	return result;
 }
 
-void ConfigObject::RestoreObject(const String& message, int attributeTypes)
+/**
+ * A field value which is restored after the objects were activated.
+ */
+struct DeferredField
 {
-	Dictionary::Ptr persistentObject = JsonDecode(message);
+	ConfigObject::Ptr Object;
+	int FieldId;
+	Value PackedValue;
+};
 
-	String type = persistentObject->Get("type");
-	String name = persistentObject->Get("name");
+static boost::mutex l_DeferredFieldsMutex;
+static std::vector<DeferredField> l_DeferredFields;
 
-	ConfigObject::Ptr object = GetObject(type, name);
+static void RestoreObject(const PersistentObject& persistentObject, int attributeTypes)
+{
+	ConfigObject::Ptr object = ConfigObject::GetObject(persistentObject.TypeName, persistentObject.Name);
 
 	if (!object)
 		return;
 
 #ifdef I2_DEBUG
 	Log(LogDebug, "ConfigObject")
-		<< "Restoring object '" << name << "' of type '" << type << "'.";
+		<< "Restoring object '" << persistentObject.Name << "' of type '" << persistentObject.TypeName << "'.";
 #endif /* I2_DEBUG */
-	Dictionary::Ptr update = persistentObject->Get("update");
-	Deserialize(object, update, false, attributeTypes);
+
+	if (persistentObject.Update) {
+		Deserialize(object, persistentObject.Update, false, attributeTypes);
+	} else if (persistentObject.Values && persistentObject.Schema->ObjectType == object->GetReflectionType()) {
+		/* Set the fields directly, without building a dictionary first. */
+		const std::vector<int>& fieldIds = persistentObject.Schema->FieldIds;
+		size_t count = std::min(fieldIds.size(), persistentObject.Values->GetLength());
+
+		std::vector<DeferredField> deferred;
+
+		for (size_t i = 0; i < count; i++) {
+			int fid = fieldIds[i];
+
+			if (fid < 0)
+				continue;
+
+			if (persistentObject.Schema->Deferred[i]) {
+				deferred.push_back({ object, fid, persistentObject.Values->Get(i) });
+				continue;
+			}
+
+			try {
+				object->SetField(fid, Deserialize(persistentObject.Values->Get(i), false, attributeTypes), true);
+			} catch (const std::exception&) {
+				object->SetField(fid, Empty);
+			}
+		}
+
+		if (!deferred.empty()) {
+			boost::mutex::scoped_lock lock(l_DeferredFieldsMutex);
+			std::move(deferred.begin(), deferred.end(), std::back_inserter(l_DeferredFields));
+		}
+	}
+
 	object->OnStateLoaded();
 	object->SetStateLoaded(true);
 }
 
-void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
+/**
+ * Restores the fields which were skipped by RestoreObject(). Values which
+ * were set in the meantime, e.g. by a new check result, are kept.
+ */
+static void RestoreDeferredFields(const std::shared_ptr<std::vector<DeferredField> >& fields, int attributeTypes)
 {
-	if (!Utility::PathExists(filename))
-		return;
+	Utility::SetThreadName("State Restore");
+
+	double start = Utility::GetTime();
+	size_t restored = 0;
+
+	for (const DeferredField& field : *fields) {
+		Value value;
+
+		try {
+			value = Deserialize(field.PackedValue, false, attributeTypes);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ConfigObject")
+				<< "Could not restore attribute of object '" << field.Object->GetName() << "': " << DiagnosticInformation(ex, false);
+			continue;
+		}
+
+		ObjectLock olock(field.Object);
+
+		if (!field.Object->GetField(field.FieldId).IsEmpty())
+			continue;
+
+		field.Object->SetField(field.FieldId, value);
+		restored++;
+	}
 
 	Log(LogInformation, "ConfigObject")
-		<< "Restoring program state from file '" << filename << "'";
+		<< "Restored " << restored << " deferred attributes in " << Utility::FormatDuration(Utility::GetTime() - start) << ".";
+}
 
+/**
+ * Reads the records of a state file and calls the callback for each
+ * object record. Schema records are handled right away.
+ */
+static void ReadStateFile(const String& filename, int attributeTypes,
+	const std::function<void (const String&, const std::shared_ptr<const StateSchemaList>&)>& callback)
+{
 	std::fstream fp;
-	fp.open(filename.CStr(), std::ios_base::in);
+	fp.open(filename.CStr(), std::ios_base::in | std::ios_base::binary);
 
-	StdioStream::Ptr sfp = new StdioStream (&fp, false);
-
-	unsigned long restored = 0;
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
 
-	WorkQueue upq(25000, Application::GetConcurrency());
-	upq.SetName("ConfigObject::RestoreObjects");
+	std::shared_ptr<const StateSchemaList> schemas;
 
 	String message;
 	StreamReadContext src;
@@ -585,14 +996,85 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 		if (srs != StatusNewItem)
 			continue;
 
-		upq.Enqueue(std::bind(&ConfigObject::RestoreObject, message, attributeTypes));
-		restored++;
+		if (message.GetLength() > 0 && message[0] == StateRecordSchema)
+			ReadStateSchema(message, schemas, attributeTypes);
+		else
+			callback(message, schemas);
 	}
 
 	sfp->Close();
+}
+
+/**
+ * Reads the state journal. Later entries for an object replace earlier ones.
+ */
+static std::map<String, PersistentObject> ReadStateJournal(const String& filename, const String& journalFilename, int attributeTypes)
+{
+	std::map<String, PersistentObject> journal;
+
+	struct stat journalStat, stateStat;
+
+	if (stat(journalFilename.CStr(), &journalStat) < 0)
+		return journal;
+
+	/* A journal which is older than the state file is left over from a full dump which was interrupted. */
+	if (stat(filename.CStr(), &stateStat) == 0 && journalStat.st_mtime < stateStat.st_mtime) {
+		Log(LogWarning, "ConfigObject")
+			<< "Ignoring state journal '" << journalFilename << "' which is older than the state file.";
+		return journal;
+	}
+
+	ReadStateFile(journalFilename, attributeTypes, [&journal](const String& message, const std::shared_ptr<const StateSchemaList>& schemas) {
+		PersistentObject persistentObject = DecodePersistentObject(message, schemas);
+		journal[persistentObject.GetKey()] = persistentObject;
+	});
+
+	return journal;
+}
+
+void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
+{
+	String journalFilename = GetStateJournalPath(filename);
+
+	if (!Utility::PathExists(filename) && !Utility::PathExists(journalFilename))
+		return;
+
+	Log(LogInformation, "ConfigObject")
+		<< "Restoring program state from file '" << filename << "'";
+
+	std::map<String, PersistentObject> journal = ReadStateJournal(filename, journalFilename, attributeTypes);
+
+	unsigned long restored = 0;
+
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("ConfigObject::RestoreObjects");
+
+	if (Utility::PathExists(filename)) {
+		ReadStateFile(filename, attributeTypes, [&upq, &journal, &restored, attributeTypes](const String& message, const std::shared_ptr<const StateSchemaList>& schemas) {
+			upq.Enqueue([message, schemas, attributeTypes, &journal]() {
+				PersistentObject persistentObject = DecodePersistentObject(message, schemas);
+
+				/* The journal has a more recent state for this object. */
+				if (journal.find(persistentObject.GetKey()) != journal.end())
+					return;
+
+				RestoreObject(persistentObject, attributeTypes);
+			});
+
+			restored++;
+		});
+	}
+
+	for (const std::pair<String, PersistentObject>& kv : journal) {
+		const PersistentObject& persistentObject = kv.second;
+		upq.Enqueue([&persistentObject, attributeTypes]() { RestoreObject(persistentObject, attributeTypes); });
+	}
 
 	upq.Join();
 
+	Log(LogInformation, "ConfigObject")
+		<< "Applied " << journal.size() << " objects from the state journal.";
+
 	unsigned long no_state = 0;
 
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
@@ -601,7 +1083,7 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
 			if (!object->GetStateLoaded()) {
 				object->OnStateLoaded();
 				object->SetStateLoaded(true);
@@ -613,6 +1095,19 @@ void ConfigObject::RestoreObjects(const String& filename, int attributeTypes)
 
 	Log(LogInformation, "ConfigObject")
 		<< "Restored " << restored << " objects. Loaded " << no_state << " new objects without state.";
+
+	auto deferred = std::make_shared<std::vector<DeferredField> >();
+
+	{
+		boost::mutex::scoped_lock lock(l_DeferredFieldsMutex);
+		deferred->swap(l_DeferredFields);
+	}
+
+	/* Large attributes (e.g. check results) aren't needed for scheduling and are restored in the background. */
+	if (!deferred->empty()) {
+		std::thread thread(std::bind(&RestoreDeferredFields, deferred, attributeTypes));
+		thread.detach();
+	}
 }
 
 void ConfigObject::StopObjects()
@@ -623,7 +1118,7 @@ void ConfigObject::StopObjects()
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
 			object->Deactivate();
 		}
 	}
@@ -637,7 +1132,7 @@ void ConfigObject::DumpModifiedAttributes(const std::function<void(const ConfigO
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
 			Dictionary::Ptr originalAttributes = object->GetOriginalAttributes();
 
 			if (!originalAttributes)
@@ -711,7 +1206,7 @@ Dictionary::Ptr ConfigObject::GetSourceLocation() const
 	DebugInfo di = GetDebugInfo();
 
 	return new Dictionary({
-		{ "path", di.Path },
+		{ "path", di.Path.GetString() },
 		{ "first_line", di.FirstLine },
 		{ "first_column", di.FirstColumn },
 		{ "last_line", di.LastLine },
@@ -26,6 +26,7 @@
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
 #include <boost/signals2.hpp>
+#include <atomic>
 
 namespace icinga
 {
@@ -76,6 +77,8 @@ public:
 	virtual void OnAllConfigLoaded();
 	virtual void OnStateLoaded();
 
+	virtual double GetLoadEstimate() const;
+
 	Dictionary::Ptr GetSourceLocation() const override;
 
 	template<typename T>
@@ -88,8 +91,14 @@ public:
 
 	static ConfigObject::Ptr GetObject(const String& type, const String& name);
 
-	static void DumpObjects(const String& filename, int attributeTypes = FAState);
+	void MarkStateDirty();
+	void ResetStateDirty();
+	uint64_t GetStateVersion() const;
+
+	static size_t DumpObjects(const String& filename, int attributeTypes = FAState);
+	static size_t DumpModifiedObjects(const String& filename, int attributeTypes = FAState);
 	static void RestoreObjects(const String& filename, int attributeTypes = FAState);
+	static String GetStateJournalPath(const String& filename);
 	static void StopObjects();
 
 	static void DumpModifiedAttributes(const std::function<void(const ConfigObject::Ptr&, const String&, const Value&)>& callback);
@@ -98,8 +107,8 @@ public:
 
 private:
 	ConfigObject::Ptr m_Zone;
-
-	static void RestoreObject(const String& message, int attributeTypes);
+	std::atomic<bool> m_StateDirty{false};
+	std::atomic<uint64_t> m_StateVersion{0};
 };
 
 #define DECLARE_OBJECTNAME(klass)						\
@@ -26,28 +26,43 @@ using namespace icinga;
 ConfigType::~ConfigType()
 { }
 
+size_t ConfigType::HashName(const String& name)
+{
+	return std::hash<std::string>()(name.GetData());
+}
+
 ConfigObject::Ptr ConfigType::GetObject(const String& name) const
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	size_t hash = HashName(name);
+	const ObjectShard& shard = m_ObjectShards[hash % ObjectShardCount];
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
-	auto nt = m_ObjectMap.find(name);
+	auto range = shard.Objects.equal_range(hash);
 
-	if (nt == m_ObjectMap.end())
-		return nullptr;
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second->GetName() == name)
+			return it->second;
+	}
 
-	return nt->second;
+	return nullptr;
 }
 
 void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 {
 	String name = object->GetName();
+	size_t hash = HashName(name);
+	ObjectShard& shard = m_ObjectShards[hash % ObjectShardCount];
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		boost::mutex::scoped_lock lock(shard.Mutex);
+
+		auto range = shard.Objects.equal_range(hash);
 
-		auto it = m_ObjectMap.find(name);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second->GetName() != name)
+				continue;
 
-		if (it != m_ObjectMap.end()) {
 			if (it->second == object)
 				return;
 
@@ -58,32 +73,71 @@ void ConfigType::RegisterObject(const ConfigObject::Ptr& object)
 				object->GetDebugInfo()));
 		}
 
-		m_ObjectMap[name] = object;
+		shard.Objects.emplace(hash, object);
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
 		m_ObjectVector.push_back(object);
+		m_ObjectSnapshot.reset();
 	}
 }
 
 void ConfigType::UnregisterObject(const ConfigObject::Ptr& object)
 {
 	String name = object->GetName();
+	size_t hash = HashName(name);
+	ObjectShard& shard = m_ObjectShards[hash % ObjectShardCount];
+
+	{
+		boost::mutex::scoped_lock lock(shard.Mutex);
+
+		auto range = shard.Objects.equal_range(hash);
+
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second->GetName() == name) {
+				shard.Objects.erase(it);
+				break;
+			}
+		}
+	}
 
 	{
 		boost::mutex::scoped_lock lock(m_Mutex);
 
-		m_ObjectMap.erase(name);
 		m_ObjectVector.erase(std::remove(m_ObjectVector.begin(), m_ObjectVector.end(), object), m_ObjectVector.end());
+		m_ObjectSnapshot.reset();
 	}
 }
 
 std::vector<ConfigObject::Ptr> ConfigType::GetObjects() const
+{
+	return *GetObjectSnapshot();
+}
+
+ConfigObjectView<ConfigObject> ConfigType::GetObjectView() const
+{
+	return ConfigObjectView<ConfigObject>(GetObjectSnapshot());
+}
+
+/**
+ * Returns the current object list. The list is only copied once after
+ * objects were registered or unregistered, readers share the copy.
+ */
+std::shared_ptr<const ConfigType::ObjectVector> ConfigType::GetObjectSnapshot() const
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
-	return m_ObjectVector;
+
+	if (!m_ObjectSnapshot)
+		m_ObjectSnapshot = std::make_shared<const ObjectVector>(m_ObjectVector);
+
+	return m_ObjectSnapshot;
 }
 
-std::vector<ConfigObject::Ptr> ConfigType::GetObjectsHelper(Type *type)
+std::shared_ptr<const ConfigType::ObjectVector> ConfigType::GetObjectsHelper(Type *type)
 {
-	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjects();
+	return static_cast<TypeImpl<ConfigObject> *>(type)->GetObjectSnapshot();
 }
 
 int ConfigType::GetObjectCount() const
@@ -91,3 +145,54 @@ int ConfigType::GetObjectCount() const
 	boost::mutex::scoped_lock lock(m_Mutex);
 	return m_ObjectVector.size();
 }
+
+/**
+ * Registers an index which can be used to find the candidate objects
+ * for a filter condition without scanning all objects of the type.
+ *
+ * @param op The filter operator.
+ * @param attribute The attribute path relative to the object, e.g. "host.name".
+ * @param lookup The lookup function.
+ */
+void ConfigType::RegisterIndex(IndexOperator op, const String& attribute, const IndexLookup& lookup)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_Indexes[std::make_pair(op, attribute)] = lookup;
+}
+
+/**
+ * Finds the candidate objects for a filter condition. The result is a
+ * superset of the objects which satisfy the condition.
+ *
+ * @returns true if an index was available for the condition.
+ */
+bool ConfigType::LookupIndex(IndexOperator op, const String& attribute, const Value& value,
+	std::vector<ConfigObject::Ptr>& objects) const
+{
+	if (op == IndexEqual && attribute == "__name") {
+		if (!value.IsString())
+			return false;
+
+		ConfigObject::Ptr object = GetObject(value);
+
+		if (object)
+			objects.push_back(object);
+
+		return true;
+	}
+
+	IndexLookup lookup;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		auto it = m_Indexes.find(std::make_pair(op, attribute));
+
+		if (it == m_Indexes.end())
+			return false;
+
+		lookup = it->second;
+	}
+
+	return lookup(value, objects);
+}
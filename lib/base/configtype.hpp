@@ -25,15 +25,116 @@
 #include "base/type.hpp"
 #include "base/dictionary.hpp"
 #include <boost/thread/mutex.hpp>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <unordered_map>
 
 namespace icinga
 {
 
 class ConfigObject;
 
+/**
+ * A read-only view of the objects of a config type. The view shares the
+ * type's current object list instead of copying it and isn't affected by
+ * objects which are registered or unregistered afterwards.
+ *
+ * The iterators return raw pointers, the view keeps the objects alive.
+ */
+template<typename T>
+class ConfigObjectView
+{
+public:
+	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
+
+	class Iterator
+	{
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T *value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef T **pointer;
+		typedef T *reference;
+
+		explicit Iterator(ObjectVector::const_iterator it)
+			: m_It(it)
+		{ }
+
+		T *operator*() const
+		{
+			return static_cast<T *>(m_It->get());
+		}
+
+		Iterator& operator++()
+		{
+			++m_It;
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator result = *this;
+			++m_It;
+			return result;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return m_It == other.m_It;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return m_It != other.m_It;
+		}
+
+	private:
+		ObjectVector::const_iterator m_It;
+	};
+
+	explicit ConfigObjectView(std::shared_ptr<const ObjectVector> objects)
+		: m_Objects(std::move(objects))
+	{ }
+
+	Iterator begin() const
+	{
+		return Iterator(m_Objects->begin());
+	}
+
+	Iterator end() const
+	{
+		return Iterator(m_Objects->end());
+	}
+
+	size_t GetLength() const
+	{
+		return m_Objects->size();
+	}
+
+private:
+	std::shared_ptr<const ObjectVector> m_Objects;
+};
+
 class ConfigType
 {
 public:
+	/**
+	 * The filter condition an index can answer.
+	 */
+	enum IndexOperator
+	{
+		IndexEqual, /**< attribute == value */
+		IndexContains /**< value in attribute */
+	};
+
+	/**
+	 * Adds all objects which may satisfy a filter condition to the list.
+	 * Returns false if the index can't answer the lookup.
+	 */
+	typedef std::function<bool (const Value& value, std::vector<intrusive_ptr<ConfigObject> >& objects)> IndexLookup;
+
 	virtual ~ConfigType();
 
 	intrusive_ptr<ConfigObject> GetObject(const String& name) const;
@@ -42,6 +143,7 @@ public:
 	void UnregisterObject(const intrusive_ptr<ConfigObject>& object);
 
 	std::vector<intrusive_ptr<ConfigObject> > GetObjects() const;
+	ConfigObjectView<ConfigObject> GetObjectView() const;
 
 	template<typename T>
 	static TypeImpl<T> *Get()
@@ -53,26 +155,70 @@ public:
 	template<typename T>
 	static std::vector<intrusive_ptr<T> > GetObjectsByType()
 	{
-		std::vector<intrusive_ptr<ConfigObject> > objects = GetObjectsHelper(T::TypeInstance.get());
+		std::shared_ptr<const ObjectVector> objects = GetObjectsHelper(T::TypeInstance.get());
 		std::vector<intrusive_ptr<T> > result;
-		result.reserve(objects.size());
-for (const auto& object : objects) {
+		result.reserve(objects->size());
+		for (const auto& object : *objects) {
 			result.push_back(static_pointer_cast<T>(object));
 		}
 		return result;
 	}
 
+	/**
+	 * Returns the objects of a type without copying the object list.
+	 * Prefer this over GetObjectsByType() in frequently called code.
+	 */
+	template<typename T>
+	static ConfigObjectView<T> GetObjectViewByType()
+	{
+		return ConfigObjectView<T>(GetObjectsHelper(T::TypeInstance.get()));
+	}
+
 	int GetObjectCount() const;
 
+	void RegisterIndex(IndexOperator op, const String& attribute, const IndexLookup& lookup);
+	bool LookupIndex(IndexOperator op, const String& attribute, const Value& value,
+		std::vector<intrusive_ptr<ConfigObject> >& objects) const;
+
 private:
-	typedef std::map<String, intrusive_ptr<ConfigObject> > ObjectMap;
 	typedef std::vector<intrusive_ptr<ConfigObject> > ObjectVector;
 
+	struct IdentityHash
+	{
+		size_t operator()(size_t hash) const
+		{
+			return hash;
+		}
+	};
+
+	/**
+	 * A part of the name index. Objects are keyed by the hash of their name,
+	 * so the name only needs to be hashed once per lookup.
+	 */
+	struct ObjectShard
+	{
+		mutable boost::mutex Mutex;
+		std::unordered_multimap<size_t, intrusive_ptr<ConfigObject>, IdentityHash> Objects;
+	};
+
+	static const size_t ObjectShardCount = 64;
+
+	/* Lookups by name only lock the shard the name belongs to. */
+	ObjectShard m_ObjectShards[ObjectShardCount];
+
 	mutable boost::mutex m_Mutex;
-	ObjectMap m_ObjectMap;
 	ObjectVector m_ObjectVector;
 
-	static std::vector<intrusive_ptr<ConfigObject> > GetObjectsHelper(Type *type);
+	/* Shared copy of m_ObjectVector, created on demand and dropped when objects are (un)registered */
+	mutable std::shared_ptr<const ObjectVector> m_ObjectSnapshot;
+
+	std::map<std::pair<IndexOperator, String>, IndexLookup> m_Indexes;
+
+	std::shared_ptr<const ObjectVector> GetObjectSnapshot() const;
+
+	static size_t HashName(const String& name);
+
+	static std::shared_ptr<const ObjectVector> GetObjectsHelper(Type *type);
 };
 
 }
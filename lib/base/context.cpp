@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "base/context.hpp"
+#include "base/profiler.hpp"
 #include <boost/thread/tss.hpp>
 #include <iostream>
 
@@ -27,11 +28,16 @@ static boost::thread_specific_ptr<std::list<String> > l_Frames;
 
 ContextFrame::ContextFrame(const String& message)
 {
-	GetFrames().push_front(message);
+	std::list<String>& frames = GetFrames();
+	frames.push_front(message);
+
+	/* List nodes don't move, so the string stays put until the frame is popped. */
+	Profiler::PushFrame(frames.front().CStr());
 }
 
 ContextFrame::~ContextFrame()
 {
+	Profiler::PopFrame();
 	GetFrames().pop_front();
 }
 
@@ -20,9 +20,14 @@
 #include "base/convert.hpp"
 #include "base/datetime.hpp"
 #include <boost/lexical_cast.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 
 using namespace icinga;
 
+static const double l_ConvertPowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
 String Convert::ToString(const String& val)
 {
 	return val;
@@ -37,15 +42,178 @@ String Convert::ToString(double val)
 {
 	double integral;
 	double fractional = std::modf(val, &integral);
+	char buffer[FormatBufferSize];
+
+	if (fractional == 0) {
+		if (std::fabs(val) < 9e18)
+			return String(buffer, buffer + FormatInteger(static_cast<long long>(val), buffer));
 
-	if (fractional == 0)
 		return Convert::ToString(static_cast<long long>(val));
+	}
+
+	size_t length = FormatFixed(val, buffer);
+
+	if (length > 0)
+		return String(buffer, buffer + length);
 
 	std::ostringstream msgbuf;
+	msgbuf.imbue(std::locale::classic());
 	msgbuf << std::fixed << val;
 	return msgbuf.str();
 }
 
+/**
+ * Writes an integer in decimal notation.
+ *
+ * @param val The number.
+ * @param buffer The buffer, must have room for FormatBufferSize characters.
+ * @returns The number of characters written, the buffer isn't NUL-terminated.
+ */
+size_t Convert::FormatInteger(long long val, char *buffer)
+{
+	unsigned long long uval = val;
+	char *p = buffer;
+
+	if (val < 0) {
+		*p++ = '-';
+		uval = 0 - uval;
+	}
+
+	char digits[20];
+	size_t count = 0;
+
+	do {
+		digits[count++] = '0' + uval % 10;
+		uval /= 10;
+	} while (uval > 0);
+
+	while (count > 0)
+		*p++ = digits[--count];
+
+	return p - buffer;
+}
+
+/**
+ * Writes the fractional part of a number with exactly the given count of digits.
+ */
+static char *FormatFraction(unsigned long long fraction, int digits, char *p)
+{
+	*p++ = '.';
+
+	for (int i = digits - 1; i >= 0; i--) {
+		p[i] = '0' + fraction % 10;
+		fraction /= 10;
+	}
+
+	return p + digits;
+}
+
+/**
+ * Writes a number with six decimal places, i.e. just like std::fixed would,
+ * but without a stream and regardless of the locale.
+ *
+ * @param val The number.
+ * @param buffer The buffer, must have room for FormatBufferSize characters.
+ * @returns The number of characters written or 0 for numbers which need to
+ * be formatted by the C++ library, i.e. very large numbers, infinity, NaN and
+ * numbers which are too close to a rounding tie.
+ */
+size_t Convert::FormatFixed(double val, char *buffer)
+{
+	if (!(std::fabs(val) < 1e15))
+		return 0;
+
+	double integral;
+	double fractional = std::fabs(std::modf(val, &integral));
+
+	/* The product is off by less than 1e-10, which only matters if the digits
+	 * after the sixth decimal place are (almost) exactly 5. */
+	double scaled = fractional * 1e6;
+	double truncated = std::floor(scaled);
+	double rest = scaled - truncated;
+
+	if (std::fabs(rest - 0.5) < 1e-9)
+		return 0;
+
+	unsigned long long whole = static_cast<unsigned long long>(std::fabs(integral));
+	unsigned long long fraction = static_cast<unsigned long long>(truncated) + (rest > 0.5 ? 1 : 0);
+
+	if (fraction == 1000000) {
+		whole++;
+		fraction = 0;
+	}
+
+	char *p = buffer;
+
+	if (std::signbit(val))
+		*p++ = '-';
+
+	p += FormatInteger(whole, p);
+	p = FormatFraction(fraction, 6, p);
+
+	return p - buffer;
+}
+
+/**
+ * Writes the shortest representation of a number which reads back as the
+ * same number.
+ *
+ * Numbers with up to nine decimal places, e.g. most performance data values
+ * and timestamps, are found by scaling them with powers of ten. The division
+ * which checks the result is correctly rounded just like parsing the decimal
+ * string is. Other numbers are formatted with 15 to 17 significant digits,
+ * whichever is enough.
+ *
+ * @param val The number.
+ * @param buffer The buffer, must have room for FormatBufferSize characters.
+ * @returns The number of characters written or 0 for infinity and NaN.
+ */
+size_t Convert::FormatShortest(double val, char *buffer)
+{
+	if (!std::isfinite(val))
+		return 0;
+
+	double absval = std::fabs(val);
+
+	if (absval < 9007199254740992.0) {
+		for (int digits = 0; digits < static_cast<int>(sizeof(l_ConvertPowersOf10) / sizeof(l_ConvertPowersOf10[0])); digits++) {
+			double scaled = std::round(absval * l_ConvertPowersOf10[digits]);
+
+			if (scaled >= 9007199254740992.0)
+				break;
+
+			if (scaled / l_ConvertPowersOf10[digits] != absval)
+				continue;
+
+			unsigned long long number = static_cast<unsigned long long>(scaled);
+			unsigned long long power = static_cast<unsigned long long>(l_ConvertPowersOf10[digits]);
+			char *p = buffer;
+
+			if (std::signbit(val) && number > 0)
+				*p++ = '-';
+
+			p += FormatInteger(number / power, p);
+
+			if (digits > 0)
+				p = FormatFraction(number % power, digits, p);
+
+			return p - buffer;
+		}
+	}
+
+	/* Icinga doesn't change the C locale, so the decimal point is always a '.'. */
+	int length = 0;
+
+	for (int precision = 15; precision <= 17; precision++) {
+		length = snprintf(buffer, FormatBufferSize, "%.*g", precision, val);
+
+		if (strtod(buffer, nullptr) == val)
+			break;
+	}
+
+	return length;
+}
+
 double Convert::ToDateTimeValue(double val)
 {
 	return val;
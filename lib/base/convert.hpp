@@ -84,6 +84,13 @@ public:
 	static String ToString(const Value& val);
 	static String ToString(double val);
 
+	/* Large enough for all numbers written by the Format*() functions. */
+	static const size_t FormatBufferSize = 32;
+
+	static size_t FormatInteger(long long val, char *buffer);
+	static size_t FormatFixed(double val, char *buffer);
+	static size_t FormatShortest(double val, char *buffer);
+
 	static double ToDateTimeValue(double val);
 	static double ToDateTimeValue(const Value& val);
 
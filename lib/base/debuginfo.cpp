@@ -19,10 +19,120 @@
 
 #include "base/debuginfo.hpp"
 #include "base/convert.hpp"
+#include <boost/thread/mutex.hpp>
 #include <fstream>
+#include <unordered_set>
 
 using namespace icinga;
 
+struct DebugInfoPathHash
+{
+	size_t operator()(const String& path) const
+	{
+		return std::hash<std::string>()(path.GetData());
+	}
+};
+
+static boost::mutex l_DebugInfoPathsMutex;
+static std::unordered_set<String, DebugInfoPathHash> *l_DebugInfoPaths;
+
+static const String *InternDebugInfoPath(const char *path)
+{
+	if (!path[0])
+		return nullptr;
+
+	/* The parser creates debug info for every token of the same file in a row. */
+	static thread_local const String *lastPath = nullptr;
+
+	if (lastPath && strcmp(lastPath->CStr(), path) == 0)
+		return lastPath;
+
+	boost::mutex::scoped_lock lock(l_DebugInfoPathsMutex);
+
+	/* Debug info is also created during static initialization. */
+	if (!l_DebugInfoPaths)
+		l_DebugInfoPaths = new std::unordered_set<String, DebugInfoPathHash>();
+
+	lastPath = &*l_DebugInfoPaths->insert(path).first;
+
+	return lastPath;
+}
+
+DebugInfoPath::DebugInfoPath(const String& path)
+	: m_Path(InternDebugInfoPath(path.CStr()))
+{ }
+
+DebugInfoPath::DebugInfoPath(const char *path)
+	: m_Path(InternDebugInfoPath(path))
+{ }
+
+const String& DebugInfoPath::GetString() const
+{
+	static const String empty;
+
+	return m_Path ? *m_Path : empty;
+}
+
+DebugInfoPath::operator const String&() const
+{
+	return GetString();
+}
+
+bool DebugInfoPath::IsEmpty() const
+{
+	return !m_Path;
+}
+
+String::SizeType DebugInfoPath::GetLength() const
+{
+	return GetString().GetLength();
+}
+
+const char *DebugInfoPath::CStr() const
+{
+	return GetString().CStr();
+}
+
+bool icinga::operator==(const DebugInfoPath& lhs, const DebugInfoPath& rhs)
+{
+	return lhs.m_Path == rhs.m_Path;
+}
+
+bool icinga::operator==(const DebugInfoPath& lhs, const String& rhs)
+{
+	return lhs.GetString() == rhs;
+}
+
+bool icinga::operator==(const String& lhs, const DebugInfoPath& rhs)
+{
+	return lhs == rhs.GetString();
+}
+
+bool icinga::operator!=(const DebugInfoPath& lhs, const DebugInfoPath& rhs)
+{
+	return !(lhs == rhs);
+}
+
+bool icinga::operator!=(const DebugInfoPath& lhs, const String& rhs)
+{
+	return !(lhs == rhs);
+}
+
+bool icinga::operator!=(const String& lhs, const DebugInfoPath& rhs)
+{
+	return !(lhs == rhs);
+}
+
+String icinga::operator+(const DebugInfoPath& lhs, const char *rhs)
+{
+	return lhs.GetString() + rhs;
+}
+
+std::ostream& icinga::operator<<(std::ostream& stream, const DebugInfoPath& path)
+{
+	return stream << path.GetString();
+}
+
 /**
  * Outputs a DebugInfo struct to a stream.
  *
@@ -26,6 +26,42 @@
 namespace icinga
 {
 
+/**
+ * The path of a configuration file. Paths are interned, i.e. all
+ * DebugInfo objects for the same file (one for each expression of the
+ * file's AST) share a single copy of the string, which is never freed.
+ *
+ * @ingroup config
+ */
+class DebugInfoPath
+{
+public:
+	DebugInfoPath() = default;
+	DebugInfoPath(const String& path);
+	DebugInfoPath(const char *path);
+
+	const String& GetString() const;
+	operator const String&() const;
+
+	bool IsEmpty() const;
+	String::SizeType GetLength() const;
+	const char *CStr() const;
+
+private:
+	const String *m_Path{nullptr};
+
+	friend bool operator==(const DebugInfoPath& lhs, const DebugInfoPath& rhs);
+};
+
+bool operator==(const DebugInfoPath& lhs, const DebugInfoPath& rhs);
+bool operator==(const DebugInfoPath& lhs, const String& rhs);
+bool operator==(const String& lhs, const DebugInfoPath& rhs);
+bool operator!=(const DebugInfoPath& lhs, const DebugInfoPath& rhs);
+bool operator!=(const DebugInfoPath& lhs, const String& rhs);
+bool operator!=(const String& lhs, const DebugInfoPath& rhs);
+String operator+(const DebugInfoPath& lhs, const char *rhs);
+std::ostream& operator<<(std::ostream& stream, const DebugInfoPath& path);
+
 /**
  * Debug information for a configuration element.
  *
@@ -33,7 +69,7 @@ namespace icinga
  */
 struct DebugInfo
 {
-	String Path;
+	DebugInfoPath Path;
 
 	int FirstLine{0};
 	int FirstColumn{0};
@@ -21,20 +21,38 @@
 
 using namespace icinga;
 
-boost::mutex DependencyGraph::m_Mutex;
-std::map<Object *, std::map<Object *, int> > DependencyGraph::m_Dependencies;
+DependencyGraph::Shard DependencyGraph::m_Shards[DependencyGraph::ShardCount];
+
+DependencyGraph::Shard& DependencyGraph::GetShard(Object *child)
+{
+	/* Objects are heap-allocated, so the low bits of their address don't tell them apart. */
+	uintptr_t addr = reinterpret_cast<uintptr_t>(child);
+	addr ^= addr >> 17;
+	addr ^= addr >> 7;
+
+	return m_Shards[(addr / alignof(std::max_align_t)) % ShardCount];
+}
 
 void DependencyGraph::AddDependency(Object *parent, Object *child)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Dependencies[child][parent]++;
+	Shard& shard = GetShard(child);
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
+	shard.Dependencies[child][parent]++;
 }
 
 void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	Shard& shard = GetShard(child);
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
-	auto& refs = m_Dependencies[child];
+	auto rit = shard.Dependencies.find(child);
+
+	if (rit == shard.Dependencies.end())
+		return;
+
+	auto& refs = rit->second;
 	auto it = refs.find(parent);
 
 	if (it == refs.end())
@@ -46,17 +64,21 @@ void DependencyGraph::RemoveDependency(Object *parent, Object *child)
 		refs.erase(it);
 
 	if (refs.empty())
-		m_Dependencies.erase(child);
+		shard.Dependencies.erase(rit);
 }
 
 std::vector<Object::Ptr> DependencyGraph::GetParents(const Object::Ptr& child)
 {
 	std::vector<Object::Ptr> objects;
 
-	boost::mutex::scoped_lock lock(m_Mutex);
-	auto it = m_Dependencies.find(child.get());
+	Shard& shard = GetShard(child.get());
+
+	boost::mutex::scoped_lock lock(shard.Mutex);
+	auto it = shard.Dependencies.find(child.get());
+
+	if (it != shard.Dependencies.end()) {
+		objects.reserve(it->second.size());
 
-	if (it != m_Dependencies.end()) {
 		typedef std::pair<Object *, int> kv_pair;
 		for (const kv_pair& kv : it->second) {
 			objects.emplace_back(kv.first);
@@ -24,12 +24,17 @@
 #include "base/object.hpp"
 #include <boost/thread/mutex.hpp>
 #include <map>
+#include <unordered_map>
 
 namespace icinga {
 
 /**
  * A graph that tracks dependencies between objects.
  *
+ * The graph is split into shards by the child object's address so that
+ * threads which activate or modify unrelated objects don't contend for
+ * the same lock.
+ *
  * @ingroup base
  */
 class DependencyGraph
@@ -42,8 +47,16 @@ public:
 private:
 	DependencyGraph();
 
-	static boost::mutex m_Mutex;
-	static std::map<Object *, std::map<Object *, int> > m_Dependencies;
+	struct Shard
+	{
+		boost::mutex Mutex;
+		std::unordered_map<Object *, std::map<Object *, int> > Dependencies;
+	};
+
+	static const size_t ShardCount = 64;
+	static Shard m_Shards[ShardCount];
+
+	static Shard& GetShard(Object *child);
 };
 
 }
@@ -23,28 +23,69 @@
 #include "base/primitivetype.hpp"
 #include "base/configwriter.hpp"
 #include <sstream>
+#include <algorithm>
 
 using namespace icinga;
 
-template class std::map<String, Value>;
+template class std::vector<std::pair<String, Value> >;
 
 REGISTER_PRIMITIVE_TYPE(Dictionary, Object, Dictionary::GetPrototype());
 
+static bool KeyLessThan(const Dictionary::Pair& a, const Dictionary::Pair& b)
+{
+	return a.first < b.first;
+}
+
+static bool KeyEqual(const Dictionary::Pair& a, const Dictionary::Pair& b)
+{
+	return a.first == b.first;
+}
+
 Dictionary::Dictionary(const DictionaryData& other)
+	: m_Data(other)
 {
-	for (const auto& kv : other)
-		m_Data.insert(kv);
+	Sort();
 }
 
 Dictionary::Dictionary(DictionaryData&& other)
+	: m_Data(std::move(other))
 {
-	for (auto& kv : other)
-		m_Data.insert(std::move(kv));
+	Sort();
 }
 
 Dictionary::Dictionary(std::initializer_list<Dictionary::Pair> init)
 	: m_Data(init)
-{ }
+{
+	Sort();
+}
+
+/**
+ * Sorts the initial data by key. For duplicate keys the first value wins.
+ */
+void Dictionary::Sort()
+{
+	if (std::is_sorted(m_Data.begin(), m_Data.end(), KeyLessThan) &&
+		std::adjacent_find(m_Data.begin(), m_Data.end(), KeyEqual) == m_Data.end())
+		return;
+
+	std::stable_sort(m_Data.begin(), m_Data.end(), KeyLessThan);
+	m_Data.erase(std::unique(m_Data.begin(), m_Data.end(), KeyEqual), m_Data.end());
+}
+
+/**
+ * Finds the position of a key, i.e. the first element whose key isn't less than the key.
+ */
+DictionaryData::iterator Dictionary::FindKey(const String& key)
+{
+	return std::lower_bound(m_Data.begin(), m_Data.end(), key,
+		[](const Dictionary::Pair& kv, const String& key) { return kv.first < key; });
+}
+
+DictionaryData::const_iterator Dictionary::FindKey(const String& key) const
+{
+	return std::lower_bound(m_Data.begin(), m_Data.end(), key,
+		[](const Dictionary::Pair& kv, const String& key) { return kv.first < key; });
+}
 
 /**
  * Retrieves a value from a dictionary.
@@ -56,9 +97,9 @@ Value Dictionary::Get(const String& key) const
 {
 	ObjectLock olock(this);
 
-	auto it = m_Data.find(key);
+	auto it = FindKey(key);
 
-	if (it == m_Data.end())
+	if (it == m_Data.end() || it->first != key)
 		return Empty;
 
 	return it->second;
@@ -75,15 +116,41 @@ bool Dictionary::Get(const String& key, Value *result) const
 {
 	ObjectLock olock(this);
 
-	auto it = m_Data.find(key);
+	auto it = FindKey(key);
 
-	if (it == m_Data.end())
+	if (it == m_Data.end() || it->first != key)
 		return false;
 
 	*result = it->second;
 	return true;
 }
 
+/**
+ * Sets a value in the dictionary. The key is only copied (or moved) when
+ * it doesn't exist yet.
+ */
+template<typename K>
+void Dictionary::SetInternal(K&& key, Value&& value)
+{
+	ObjectLock olock(this);
+
+	if (m_Frozen)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
+
+	/* Keys are often added in order, e.g. by JsonDecode(). */
+	if (m_Data.empty() || m_Data.back().first < key) {
+		m_Data.emplace_back(std::forward<K>(key), std::move(value));
+		return;
+	}
+
+	auto it = FindKey(key);
+
+	if (it != m_Data.end() && it->first == key)
+		it->second = std::move(value);
+	else
+		m_Data.emplace(it, std::forward<K>(key), std::move(value));
+}
+
 /**
  * Sets a value in the dictionary.
  *
@@ -92,12 +159,18 @@ bool Dictionary::Get(const String& key, Value *result) const
  */
 void Dictionary::Set(const String& key, Value value)
 {
-	ObjectLock olock(this);
-
-	if (m_Frozen)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
+	SetInternal(key, std::move(value));
+}
 
-	m_Data[key] = std::move(value);
+/**
+ * Sets a value in the dictionary.
+ *
+ * @param key The key.
+ * @param value The value.
+ */
+void Dictionary::Set(String&& key, Value value)
+{
+	SetInternal(std::move(key), std::move(value));
 }
 
 /**
@@ -122,7 +195,9 @@ bool Dictionary::Contains(const String& key) const
 {
 	ObjectLock olock(this);
 
-	return (m_Data.find(key) != m_Data.end());
+	auto it = FindKey(key);
+
+	return it != m_Data.end() && it->first == key;
 }
 
 /**
@@ -180,10 +255,9 @@ void Dictionary::Remove(const String& key)
 	if (m_Frozen)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Dictionary must not be modified."));
 
-	Dictionary::Iterator it;
-	it = m_Data.find(key);
+	auto it = FindKey(key);
 
-	if (it == m_Data.end())
+	if (it == m_Data.end() || it->first != key)
 		return;
 
 	m_Data.erase(it);
@@ -206,6 +280,16 @@ void Dictionary::CopyTo(const Dictionary::Ptr& dest) const
 {
 	ObjectLock olock(this);
 
+	/* Copying into an empty dictionary doesn't need to look up any keys. */
+	{
+		ObjectLock dlock(dest);
+
+		if (dest->m_Data.empty() && !dest->m_Frozen) {
+			dest->m_Data = m_Data;
+			return;
+		}
+	}
+
 	for (const Dictionary::Pair& kv : m_Data) {
 		dest->Set(kv.first, kv.second);
 	}
@@ -278,6 +362,12 @@ void Dictionary::Freeze()
 	m_Frozen = true;
 }
 
+bool Dictionary::IsFrozen() const
+{
+	ObjectLock olock(this);
+	return m_Frozen;
+}
+
 Value Dictionary::GetFieldByName(const String& field, bool, const DebugInfo& debugInfo) const
 {
 	Value value;
@@ -22,9 +22,9 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include "base/objectpool.hpp"
 #include "base/value.hpp"
 #include <boost/range/iterator.hpp>
-#include <map>
 #include <vector>
 
 namespace icinga
@@ -35,21 +35,26 @@ typedef std::vector<std::pair<String, Value> > DictionaryData;
 /**
  * A container that holds key-value pairs.
  *
+ * The pairs are stored in a vector which is sorted by key. Most dictionaries
+ * only have a few keys, for those a binary search over contiguous memory is
+ * faster than a tree and needs a single allocation. Iteration is in key order.
+ *
  * @ingroup base
  */
 class Dictionary final : public Object
 {
 public:
 	DECLARE_OBJECT(Dictionary);
+	DECLARE_POOLED_ALLOCATOR();
 
 	/**
 	 * An iterator that can be used to iterate over dictionary elements.
 	 */
-	typedef std::map<String, Value>::iterator Iterator;
+	typedef DictionaryData::iterator Iterator;
 
-	typedef std::map<String, Value>::size_type SizeType;
+	typedef DictionaryData::size_type SizeType;
 
-	typedef std::map<String, Value>::value_type Pair;
+	typedef DictionaryData::value_type Pair;
 
 	Dictionary() = default;
 	Dictionary(const DictionaryData& other);
@@ -59,6 +64,7 @@ public:
 	Value Get(const String& key) const;
 	bool Get(const String& key, Value *result) const;
 	void Set(const String& key, Value value);
+	void Set(String&& key, Value value);
 	bool Contains(const String& key) const;
 
 	Iterator Begin();
@@ -84,6 +90,7 @@ public:
 	String ToString() const override;
 
 	void Freeze();
+	bool IsFrozen() const;
 
 	Value GetFieldByName(const String& field, bool sandboxed, const DebugInfo& debugInfo) const override;
 	void SetFieldByName(const String& field, const Value& value, const DebugInfo& debugInfo) override;
@@ -91,8 +98,15 @@ public:
 	bool GetOwnField(const String& field, Value *result) const override;
 
 private:
-	std::map<String, Value> m_Data; /**< The data for the dictionary. */
+	DictionaryData m_Data; /**< The data for the dictionary, sorted by key. */
 	bool m_Frozen{false};
+
+	DictionaryData::iterator FindKey(const String& key);
+	DictionaryData::const_iterator FindKey(const String& key) const;
+	void Sort();
+
+	template<typename K>
+	void SetInternal(K&& key, Value&& value);
 };
 
 Dictionary::Iterator begin(const Dictionary::Ptr& x);
@@ -100,6 +114,6 @@ Dictionary::Iterator end(const Dictionary::Ptr& x);
 
 }
 
-extern template class std::map<icinga::String, icinga::Value>;
+extern template class std::vector<std::pair<icinga::String, icinga::Value> >;
 
 #endif /* DICTIONARY_H */
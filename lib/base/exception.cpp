@@ -212,7 +212,7 @@ String icinga::DiagnosticInformation(const std::exception& ex, bool verbose, Sta
 		if (messages && messages->GetLength() > 0) {
 			Array::Ptr message = messages->Get(messages->GetLength() - 1);
 
-			di.Path = message->Get(1);
+			di.Path = static_cast<String>(message->Get(1));
 			di.FirstLine = message->Get(2);
 			di.FirstColumn = message->Get(3);
 			di.LastLine = message->Get(4);
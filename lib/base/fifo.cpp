@@ -18,70 +18,104 @@
  ******************************************************************************/
 
 #include "base/fifo.hpp"
+#include <algorithm>
+#include <atomic>
 
 using namespace icinga;
 
+/* Bytes held by the chunks of all FIFOs, e.g. the send and receive buffers of TLS connections. */
+static std::atomic<size_t> l_AllocatedBytes{0};
+
+void FIFO::ChunkDeleter::operator()(char *data) const
+{
+	l_AllocatedBytes.fetch_sub(Size, std::memory_order_relaxed);
+	delete [] data;
+}
+
 /**
- * Destructor for the FIFO class.
+ * Returns the number of bytes which are allocated by all FIFOs.
  */
-FIFO::~FIFO()
+size_t FIFO::GetAllocatedBytes()
 {
-	free(m_Buffer);
+	return l_AllocatedBytes.load(std::memory_order_relaxed);
 }
 
 /**
- * Resizes the FIFO's buffer so that it is at least newSize bytes long.
+ * Appends a chunk which has room for at least count bytes. Chunks double in
+ * size while data keeps being added without being read.
  *
- * @param newSize The minimum new size of the FIFO buffer.
+ * @param count The minimum size of the chunk.
  */
-void FIFO::ResizeBuffer(size_t newSize, bool decrease)
+FIFO::Chunk& FIFO::AddChunk(size_t count)
 {
-	if (m_AllocSize >= newSize && !decrease)
-		return;
+	size_t size = MinChunkSize;
 
-	newSize = (newSize / FIFO::BlockSize + 1) * FIFO::BlockSize;
+	if (!m_Chunks.empty())
+		size = std::min(m_Chunks.back().Size * 2, MaxChunkSize);
 
-	if (newSize == m_AllocSize)
-		return;
+	size = std::max(size, count);
 
-	auto *newBuffer = static_cast<char *>(realloc(m_Buffer, newSize));
+	l_AllocatedBytes.fetch_add(size, std::memory_order_relaxed);
 
-	if (!newBuffer)
-		BOOST_THROW_EXCEPTION(std::bad_alloc());
+	m_Chunks.push_back(Chunk{std::unique_ptr<char[], ChunkDeleter>(new char[size], ChunkDeleter{size}), size, 0, 0});
 
-	m_Buffer = newBuffer;
-
-	m_AllocSize = newSize;
+	return m_Chunks.back();
 }
 
 /**
- * Optimizes memory usage of the FIFO buffer by reallocating
- * and moving the buffer.
+ * Copies data from the chunks into the buffer and optionally removes it.
+ * Chunks which have been read completely are freed, except for the last one
+ * which is kept for further writes.
  */
-void FIFO::Optimize()
+size_t FIFO::CopyOut(void *buffer, size_t count, bool consume)
 {
-	if (m_Offset > m_DataSize / 10 && m_Offset - m_DataSize > 1024) {
-		std::memmove(m_Buffer, m_Buffer + m_Offset, m_DataSize);
-		m_Offset = 0;
+	if (count > m_DataSize)
+		count = m_DataSize;
+
+	size_t copied = 0;
+
+	for (auto it = m_Chunks.begin(); copied < count;) {
+		size_t length = std::min(it->End - it->Begin, count - copied);
+
+		if (buffer)
+			std::memcpy(static_cast<char *>(buffer) + copied, it->Data.get() + it->Begin, length);
+
+		copied += length;
+
+		if (!consume) {
+			++it;
+			continue;
+		}
+
+		it->Begin += length;
+
+		if (it->Begin < it->End)
+			break;
+
+		if (m_Chunks.size() == 1) {
+			/* Don't hold on to the memory of a large burst. */
+			if (it->Size > 16 * MinChunkSize)
+				m_Chunks.clear();
+			else
+				it->Begin = it->End = 0;
 
-		if (m_DataSize > 0)
-			ResizeBuffer(m_DataSize, true);
+			break;
+		}
 
-		return;
+		it = m_Chunks.erase(it);
 	}
+
+	if (consume)
+		m_DataSize -= count;
+
+	return count;
 }
 
 size_t FIFO::Peek(void *buffer, size_t count, bool allow_partial)
 {
 	ASSERT(allow_partial);
 
-	if (count > m_DataSize)
-		count = m_DataSize;
-
-	if (buffer)
-		std::memcpy(buffer, m_Buffer + m_Offset, count);
-
-	return count;
+	return CopyOut(buffer, count, false);
 }
 
 /**
@@ -91,27 +125,86 @@ size_t FIFO::Read(void *buffer, size_t count, bool allow_partial)
 {
 	ASSERT(allow_partial);
 
-	if (count > m_DataSize)
-		count = m_DataSize;
+	return CopyOut(buffer, count, true);
+}
 
-	if (buffer)
-		std::memcpy(buffer, m_Buffer + m_Offset, count);
+/**
+ * Implements IOQueue::Write.
+ */
+void FIFO::Write(const void *buffer, size_t count)
+{
+	auto *data = static_cast<const char *>(buffer);
 
-	m_DataSize -= count;
-	m_Offset += count;
+	while (count > 0) {
+		if (m_Chunks.empty() || m_Chunks.back().End == m_Chunks.back().Size)
+			AddChunk(count);
 
-	Optimize();
+		Chunk& chunk = m_Chunks.back();
+		size_t length = std::min(chunk.Size - chunk.End, count);
 
-	return count;
+		std::memcpy(chunk.Data.get() + chunk.End, data, length);
+		chunk.End += length;
+		m_DataSize += length;
+
+		data += length;
+		count -= length;
+	}
+
+	SignalDataAvailable();
 }
 
 /**
- * Implements IOQueue::Write.
+ * Returns the first contiguous piece of the unread data. The pointer
+ * is only valid until the FIFO is modified.
+ *
+ * @param[out] count The length of the piece (optional).
+ * @returns A pointer to the data.
  */
-void FIFO::Write(const void *buffer, size_t count)
+const char *FIFO::GetReadBuffer(size_t *count) const
 {
-	ResizeBuffer(m_Offset + m_DataSize + count, false);
-	std::memcpy(m_Buffer + m_Offset + m_DataSize, buffer, count);
+	if (m_Chunks.empty()) {
+		if (count)
+			*count = 0;
+
+		return nullptr;
+	}
+
+	const Chunk& chunk = m_Chunks.front();
+
+	if (count)
+		*count = chunk.End - chunk.Begin;
+
+	return chunk.Data.get() + chunk.Begin;
+}
+
+/**
+ * Makes room for at least count contiguous bytes after the unread data so
+ * that the caller can write into the FIFO directly. The data has to be
+ * committed with CommitWrite().
+ *
+ * @param count The number of bytes.
+ * @returns A pointer to the free space.
+ */
+char *FIFO::GetWriteBuffer(size_t count)
+{
+	if (m_Chunks.empty() || m_Chunks.back().Size - m_Chunks.back().End < count)
+		AddChunk(count);
+
+	Chunk& chunk = m_Chunks.back();
+
+	return chunk.Data.get() + chunk.End;
+}
+
+/**
+ * Appends data which was written into the buffer returned by GetWriteBuffer().
+ *
+ * @param count The number of bytes.
+ */
+void FIFO::CommitWrite(size_t count)
+{
+	ASSERT(!m_Chunks.empty() && m_Chunks.back().End + count <= m_Chunks.back().Size);
+
+	m_Chunks.back().End += count;
 	m_DataSize += count;
 
 	SignalDataAvailable();
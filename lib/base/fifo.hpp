@@ -22,12 +22,16 @@
 
 #include "base/i2-base.hpp"
 #include "base/stream.hpp"
+#include <deque>
+#include <memory>
 
 namespace icinga
 {
 
 /**
- * A byte-based FIFO buffer.
+ * A byte-based FIFO buffer. The data is kept in a chain of chunks, so
+ * neither reading nor growing the buffer moves the data which is already
+ * in it.
  *
  * @ingroup base
  */
@@ -36,9 +40,8 @@ class FIFO final : public Stream
 public:
 	DECLARE_PTR_TYPEDEFS(FIFO);
 
-	static const size_t BlockSize = 512;
-
-	~FIFO() override;
+	static const size_t MinChunkSize = 4096;
+	static const size_t MaxChunkSize = 1024 * 1024;
 
 	size_t Peek(void *buffer, size_t count, bool allow_partial = false) override;
 	size_t Read(void *buffer, size_t count, bool allow_partial = false) override;
@@ -50,14 +53,33 @@ public:
 
 	size_t GetAvailableBytes() const;
 
+	static size_t GetAllocatedBytes();
+
+	const char *GetReadBuffer(size_t *count = nullptr) const;
+	char *GetWriteBuffer(size_t count);
+	void CommitWrite(size_t count);
+
 private:
-	char *m_Buffer{nullptr};
+	struct ChunkDeleter
+	{
+		size_t Size;
+
+		void operator()(char *data) const;
+	};
+
+	struct Chunk
+	{
+		std::unique_ptr<char[], ChunkDeleter> Data;
+		size_t Size;
+		size_t Begin;
+		size_t End;
+	};
+
+	std::deque<Chunk> m_Chunks;
 	size_t m_DataSize{0};
-	size_t m_AllocSize{0};
-	size_t m_Offset{0};
 
-	void ResizeBuffer(size_t newSize, bool decrease);
-	void Optimize();
+	Chunk& AddChunk(size_t count);
+	size_t CopyOut(void *buffer, size_t count, bool consume);
 };
 
 }
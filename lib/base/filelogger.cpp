@@ -22,7 +22,10 @@
 #include "base/configtype.hpp"
 #include "base/statsfunction.hpp"
 #include "base/application.hpp"
-#include <fstream>
+#include "base/perfdatavalue.hpp"
+#include "base/utility.hpp"
+#include "base/objectlock.hpp"
+#include <sstream>
 
 using namespace icinga;
 
@@ -30,12 +33,20 @@ REGISTER_TYPE(FileLogger);
 
 REGISTER_STATSFUNCTION(FileLogger, &FileLogger::StatsFunc);
 
-void FileLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void FileLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
-	for (const FileLogger::Ptr& filelogger : ConfigType::GetObjectsByType<FileLogger>()) {
-		nodes.emplace_back(filelogger->GetName(), 1); //add more stats
+	for (const FileLogger::Ptr& filelogger : ConfigType::GetObjectViewByType<FileLogger>()) {
+		unsigned long dropped = filelogger->m_DroppedEntries.load();
+
+		nodes.emplace_back(filelogger->GetName(), new Dictionary({
+			{ "async", filelogger->GetAsync() },
+			{ "dropped_entries", dropped }
+		}));
+
+		if (filelogger->GetAsync())
+			perfdata->Add(new PerfdataValue("filelogger_" + filelogger->GetName() + "_dropped_entries", dropped));
 	}
 
 	status->Set("filelogger", new Dictionary(std::move(nodes)));
@@ -46,7 +57,12 @@ void FileLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
  */
 void FileLogger::Start(bool runtimeCreated)
 {
-	ReopenLogFile();
+	if (GetAsync()) {
+		m_Queue.reserve(GetQueueSize());
+		m_PendingStream = OpenLogFile(GetPath(), GetFormat() == "binary");
+		m_WriterThread = std::thread(std::bind(&FileLogger::WriterThreadProc, this));
+	} else
+		ReopenLogFile();
 
 	Application::OnReopenLogs.connect(std::bind(&FileLogger::ReopenLogFile, this));
 
@@ -56,21 +72,194 @@ void FileLogger::Start(bool runtimeCreated)
 		<< "'" << GetName() << "' started.";
 }
 
+void FileLogger::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<FileLogger>::Stop(runtimeRemoved);
+
+	if (m_WriterThread.joinable()) {
+		{
+			boost::mutex::scoped_lock lock(m_QueueMutex);
+			m_Stopped = true;
+		}
+
+		m_QueueCV.notify_all();
+		m_SpaceCV.notify_all();
+		m_WriterThread.join();
+	}
+}
+
+std::unique_ptr<std::ofstream> FileLogger::OpenLogFile(const String& path, bool binary)
+{
+	std::unique_ptr<std::ofstream> stream(new std::ofstream());
+
+	std::ios_base::openmode mode = std::fstream::app | std::fstream::out;
+
+	if (binary)
+		mode |= std::fstream::binary;
+
+	stream->open(path.CStr(), mode);
+
+	if (!stream->good())
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open logfile '" + path + "'"));
+
+	return stream;
+}
+
 void FileLogger::ReopenLogFile()
 {
-	auto *stream = new std::ofstream();
+	std::unique_ptr<std::ofstream> stream = OpenLogFile(GetPath(), GetFormat() == "binary");
+
+	if (GetAsync()) {
+		/* The writer thread switches to the new file with its next batch. */
+		{
+			boost::mutex::scoped_lock lock(m_QueueMutex);
+			m_PendingStream = std::move(stream);
+		}
+
+		m_QueueCV.notify_all();
+		return;
+	}
+
+	ObjectLock olock(this);
+
+	BindStream(stream.release(), true);
+
+	if (GetFormat() == "binary")
+		m_BinaryWriter.WriteHeader(*GetStream());
+}
+
+void FileLogger::ProcessLogEntry(const LogEntry& entry)
+{
+	if (!GetAsync()) {
+		if (GetFormat() == "binary")
+			m_BinaryWriter.WriteEntry(*GetStream(), entry);
+		else
+			StreamLogger::ProcessLogEntry(entry);
+
+		return;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_QueueMutex);
+
+		size_t queueSize = GetQueueSize();
+
+		if (m_Queue.size() >= queueSize) {
+			if (GetOverflowPolicy() == "drop") {
+				m_DroppedEntries++;
+				return;
+			}
+
+			while (m_Queue.size() >= queueSize && !m_Stopped)
+				m_SpaceCV.wait(lock);
+		}
+
+		m_Queue.push_back(entry);
+	}
+
+	m_QueueCV.notify_one();
+}
+
+/**
+ * Waits until the writer thread has written all queued log entries.
+ */
+void FileLogger::Flush()
+{
+	if (!GetAsync()) {
+		StreamLogger::Flush();
+		return;
+	}
+
+	boost::mutex::scoped_lock lock(m_QueueMutex);
+
+	while ((!m_Queue.empty() || m_Writing) && m_WriterThread.joinable() && !m_Stopped)
+		m_SpaceCV.wait(lock);
+}
+
+void FileLogger::WriterThreadProc()
+{
+	Utility::SetThreadName("FileLogger");
+
+	std::unique_ptr<std::ofstream> stream;
+	std::vector<LogEntry> entries;
+	bool binary = (GetFormat() == "binary");
+	BinaryLogWriter binaryWriter;
+	entries.reserve(GetQueueSize());
+
+	/* This thread must not log anything itself, the entries would end up in its own queue. */
+	for (;;) {
+		bool stopped;
+
+		{
+			boost::mutex::scoped_lock lock(m_QueueMutex);
+
+			while (m_Queue.empty() && !m_PendingStream && !m_Stopped)
+				m_QueueCV.wait(lock);
+
+			entries.swap(m_Queue);
+			m_Writing = true;
+			stopped = m_Stopped;
+
+			if (m_PendingStream) {
+				stream = std::move(m_PendingStream);
 
-	String path = GetPath();
+				if (binary)
+					binaryWriter.WriteHeader(*stream);
+			}
+		}
 
-	try {
-		stream->open(path.CStr(), std::fstream::app | std::fstream::out);
+		/* Producers can continue while the batch is being written. */
+		m_SpaceCV.notify_all();
 
-		if (!stream->good())
-			BOOST_THROW_EXCEPTION(std::runtime_error("Could not open logfile '" + path + "'"));
-	} catch (...) {
-		delete stream;
-		throw;
+		if (!entries.empty() && stream) {
+			std::ostringstream buffer;
+
+			for (const LogEntry& entry : entries) {
+				if (binary)
+					binaryWriter.WriteEntry(buffer, entry);
+				else
+					StreamLogger::ProcessLogEntry(buffer, entry);
+			}
+
+			std::string data = buffer.str();
+			stream->write(data.c_str(), data.size());
+			stream->flush();
+		}
+
+		entries.clear();
+
+		{
+			boost::mutex::scoped_lock lock(m_QueueMutex);
+			m_Writing = false;
+		}
+
+		m_SpaceCV.notify_all();
+
+		if (stopped)
+			break;
 	}
+}
+
+void FileLogger::ValidateFormat(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<FileLogger>::ValidateFormat(lvalue, utils);
+
+	if (lvalue() != "text" && lvalue() != "binary")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "format" }, "Format must be 'text' or 'binary'."));
+}
+
+void FileLogger::ValidateQueueSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<FileLogger>::ValidateQueueSize(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "queue_size" }, "Queue size must be at least 1."));
+}
+
+void FileLogger::ValidateOverflowPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<FileLogger>::ValidateOverflowPolicy(lvalue, utils);
 
-	BindStream(stream, true);
+	if (lvalue() != "block" && lvalue() != "drop")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "overflow_policy" }, "Overflow policy must be 'block' or 'drop'."));
 }
@@ -22,6 +22,13 @@
 
 #include "base/i2-base.hpp"
 #include "base/filelogger-ti.hpp"
+#include "base/binarylog.hpp"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
 
 namespace icinga
 {
@@ -40,9 +47,33 @@ public:
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+	void ValidateFormat(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateQueueSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateOverflowPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	void ProcessLogEntry(const LogEntry& entry) override;
+	void Flush() override;
 
 private:
+	BinaryLogWriter m_BinaryWriter;
+
+	/* Async mode: log entries are queued and written in batches by m_WriterThread. */
+	std::thread m_WriterThread;
+	boost::mutex m_QueueMutex;
+	boost::condition_variable m_QueueCV;
+	boost::condition_variable m_SpaceCV;
+	std::vector<LogEntry> m_Queue;
+	std::unique_ptr<std::ofstream> m_PendingStream;
+	bool m_Writing{false};
+	bool m_Stopped{false};
+	std::atomic<unsigned long> m_DroppedEntries{0};
+
 	void ReopenLogFile();
+	static std::unique_ptr<std::ofstream> OpenLogFile(const String& path, bool binary);
+	void WriterThreadProc();
 };
 
 }
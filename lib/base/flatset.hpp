@@ -0,0 +1,115 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef FLATSET_H
+#define FLATSET_H
+
+#include "base/i2-base.hpp"
+#include <algorithm>
+#include <set>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * A set which keeps its elements in a sorted vector.
+ *
+ * An empty FlatSet is a third of the size of an empty std::set and the
+ * elements don't need a node allocation each. This is meant for relations
+ * which most objects don't have or only have a few of, e.g. the comments of
+ * a checkable. Insert() and Erase() are linear in the number of elements.
+ *
+ * @ingroup base
+ */
+template<typename T>
+class FlatSet
+{
+public:
+	typedef typename std::vector<T>::const_iterator Iterator;
+
+	bool Insert(const T& value)
+	{
+		auto it = std::lower_bound(m_Data.begin(), m_Data.end(), value);
+
+		if (it != m_Data.end() && !(value < *it))
+			return false;
+
+		m_Data.insert(it, value);
+		return true;
+	}
+
+	bool Erase(const T& value)
+	{
+		auto it = std::lower_bound(m_Data.begin(), m_Data.end(), value);
+
+		if (it == m_Data.end() || value < *it)
+			return false;
+
+		m_Data.erase(it);
+
+		/* Give the memory back once the last element is gone. */
+		if (m_Data.empty())
+			std::vector<T>().swap(m_Data);
+
+		return true;
+	}
+
+	bool Contains(const T& value) const
+	{
+		return std::binary_search(m_Data.begin(), m_Data.end(), value);
+	}
+
+	size_t GetLength() const
+	{
+		return m_Data.size();
+	}
+
+	bool IsEmpty() const
+	{
+		return m_Data.empty();
+	}
+
+	Iterator begin() const
+	{
+		return m_Data.begin();
+	}
+
+	Iterator end() const
+	{
+		return m_Data.end();
+	}
+
+	std::set<T> ToSet() const
+	{
+		return std::set<T>(m_Data.begin(), m_Data.end());
+	}
+
+	const std::vector<T>& ToVector() const
+	{
+		return m_Data;
+	}
+
+private:
+	std::vector<T> m_Data;
+};
+
+}
+
+#endif /* FLATSET_H */
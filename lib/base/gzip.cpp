@@ -0,0 +1,75 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/gzip.hpp"
+#include "base/exception.hpp"
+#ifdef HAVE_ZLIB
+#	include <zlib.h>
+#endif /* HAVE_ZLIB */
+
+using namespace icinga;
+
+/**
+ * Returns whether this build supports gzip compression.
+ */
+bool Gzip::IsSupported()
+{
+#ifdef HAVE_ZLIB
+	return true;
+#else /* HAVE_ZLIB */
+	return false;
+#endif /* HAVE_ZLIB */
+}
+
+/**
+ * Compresses data using the gzip format (RFC 1952).
+ *
+ * @param data The uncompressed data.
+ * @returns The compressed data.
+ */
+String Gzip::Compress(const String& data)
+{
+#ifdef HAVE_ZLIB
+	z_stream stream = {};
+
+	/* 15 window bits plus 16 selects the gzip header instead of zlib's. */
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		BOOST_THROW_EXCEPTION(std::runtime_error("deflateInit2() failed."));
+
+	std::string result;
+	result.resize(deflateBound(&stream, data.GetLength()));
+
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.CStr()));
+	stream.avail_in = data.GetLength();
+	stream.next_out = reinterpret_cast<Bytef *>(&result[0]);
+	stream.avail_out = result.size();
+
+	int rc = deflate(&stream, Z_FINISH);
+
+	result.resize(stream.total_out);
+	deflateEnd(&stream);
+
+	if (rc != Z_STREAM_END)
+		BOOST_THROW_EXCEPTION(std::runtime_error("deflate() failed."));
+
+	return result;
+#else /* HAVE_ZLIB */
+	BOOST_THROW_EXCEPTION(std::runtime_error("Gzip compression is not supported by this build."));
+#endif /* HAVE_ZLIB */
+}
@@ -23,15 +23,27 @@
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
+#include "base/stream.hpp"
 #include <boost/exception_ptr.hpp>
 #include <yajl/yajl_version.h>
 #include <yajl/yajl_gen.h>
 #include <yajl/yajl_parse.h>
-#include <stack>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#ifdef _MSC_VER
+#	include <intrin.h>
+#endif /* _MSC_VER */
 
 using namespace icinga;
 
-static void Encode(yajl_gen handle, const Value& value);
+static void Encode(yajl_gen handle, const Value& value, const Stream::Ptr& stream);
 
 #if YAJL_MAJOR < 2
 typedef unsigned int yajl_size;
@@ -39,37 +51,77 @@ typedef unsigned int yajl_size;
 typedef size_t yajl_size;
 #endif /* YAJL_MAJOR */
 
-static void EncodeDictionary(yajl_gen handle, const Dictionary::Ptr& dict)
+/* Streamed output is written once the yajl buffer has grown beyond this size. */
+static const yajl_size l_JsonStreamBufferSize = 64 * 1024;
+
+static void FlushEncodeBuffer(yajl_gen handle, const Stream::Ptr& stream, bool force)
+{
+	if (!stream)
+		return;
+
+	const unsigned char *buf;
+	yajl_size len;
+
+	yajl_gen_get_buf(handle, &buf, &len);
+
+	if (len == 0 || (!force && len < l_JsonStreamBufferSize))
+		return;
+
+	stream->Write(buf, len);
+
+	yajl_gen_clear(handle);
+}
+
+static void EncodeDictionary(yajl_gen handle, const Dictionary::Ptr& dict, const Stream::Ptr& stream)
 {
 	yajl_gen_map_open(handle);
 
 	ObjectLock olock(dict);
 	for (const Dictionary::Pair& kv : dict) {
 		yajl_gen_string(handle, reinterpret_cast<const unsigned char *>(kv.first.CStr()), kv.first.GetLength());
-		Encode(handle, kv.second);
+		Encode(handle, kv.second, stream);
+		FlushEncodeBuffer(handle, stream, false);
 	}
 
 	yajl_gen_map_close(handle);
 }
 
-static void EncodeArray(yajl_gen handle, const Array::Ptr& arr)
+static void EncodeArray(yajl_gen handle, const Array::Ptr& arr, const Stream::Ptr& stream)
 {
 	yajl_gen_array_open(handle);
 
 	ObjectLock olock(arr);
 	for (const Value& value : arr) {
-		Encode(handle, value);
+		Encode(handle, value, stream);
+		FlushEncodeBuffer(handle, stream, false);
 	}
 
 	yajl_gen_array_close(handle);
 }
 
-static void Encode(yajl_gen handle, const Value& value)
+static void Encode(yajl_gen handle, const Value& value, const Stream::Ptr& stream)
 {
 	switch (value.GetType()) {
 		case ValueNumber:
-			if (yajl_gen_double(handle, value.Get<double>()) == yajl_gen_invalid_number)
-				yajl_gen_double(handle, 0);
+			{
+				char buffer[Convert::FormatBufferSize + 3];
+				size_t length = Convert::FormatShortest(value.Get<double>(), buffer);
+
+				if (length == 0) {
+					yajl_gen_double(handle, 0);
+					break;
+				}
+
+				/* Just like yajl_gen_double() integral numbers end in ".0". */
+				buffer[length] = '\0';
+
+				if (strspn(buffer, "0123456789-") == length) {
+					memcpy(buffer + length, ".0", 2);
+					length += 2;
+				}
+
+				yajl_gen_number(handle, buffer, length);
+			}
 
 			break;
 		case ValueBoolean:
@@ -86,14 +138,14 @@ static void Encode(yajl_gen handle, const Value& value)
 				Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(obj);
 
 				if (dict) {
-					EncodeDictionary(handle, dict);
+					EncodeDictionary(handle, dict, stream);
 					break;
 				}
 
 				Array::Ptr arr = dynamic_pointer_cast<Array>(obj);
 
 				if (arr) {
-					EncodeArray(handle, arr);
+					EncodeArray(handle, arr, stream);
 					break;
 				}
 			}
@@ -110,7 +162,7 @@ static void Encode(yajl_gen handle, const Value& value)
 	}
 }
 
-String icinga::JsonEncode(const Value& value, bool pretty_print)
+static yajl_gen AllocEncoder(bool pretty_print)
 {
 #if YAJL_MAJOR < 2
 	yajl_gen_config conf = { pretty_print, "" };
@@ -121,7 +173,14 @@ String icinga::JsonEncode(const Value& value, bool pretty_print)
 		yajl_gen_config(handle, yajl_gen_beautify, 1);
 #endif /* YAJL_MAJOR */
 
-	Encode(handle, value);
+	return handle;
+}
+
+String icinga::JsonEncode(const Value& value, bool pretty_print)
+{
+	yajl_gen handle = AllocEncoder(pretty_print);
+
+	Encode(handle, value, nullptr);
 
 	const unsigned char *buf;
 	yajl_size len;
@@ -135,63 +194,138 @@ String icinga::JsonEncode(const Value& value, bool pretty_print)
 	return result;
 }
 
+/**
+ * Encodes a value and writes it to a stream while encoding, so that only
+ * a small part of the encoded document has to be kept in memory.
+ *
+ * @param value The value.
+ * @param stream The stream.
+ * @param pretty_print Whether to pretty-print the output.
+ */
+void icinga::JsonEncode(const Value& value, const Stream::Ptr& stream, bool pretty_print)
+{
+	yajl_gen handle = AllocEncoder(pretty_print);
+
+	try {
+		Encode(handle, value, stream);
+		FlushEncodeBuffer(handle, stream, true);
+	} catch (...) {
+		yajl_gen_free(handle);
+		throw;
+	}
+
+	yajl_gen_free(handle);
+}
+
+/**
+ * A container which is still being decoded. Its items are collected in
+ * plain vectors and the Dictionary/Array is only created once the container
+ * is complete, so decoding doesn't lock or reallocate the objects for each item.
+ */
 struct JsonElement
 {
+	bool IsDictionary{false};
 	String Key;
-	bool KeySet{false};
-	Value EValue;
+	DictionaryData Items;
+	ArrayData Values;
 };
 
+/**
+ * Sorts the items by key. For duplicate keys the last value wins, as if
+ * the items had been added with Dictionary::Set().
+ */
+static void SortDictionaryItems(DictionaryData& items)
+{
+	auto notLess = [](const Dictionary::Pair& a, const Dictionary::Pair& b) { return !(a.first < b.first); };
+
+	/* Objects we've encoded ourselves are already sorted. */
+	if (std::adjacent_find(items.begin(), items.end(), notLess) == items.end())
+		return;
+
+	std::stable_sort(items.begin(), items.end(),
+		[](const Dictionary::Pair& a, const Dictionary::Pair& b) { return a.first < b.first; });
+
+	auto out = items.begin();
+
+	for (auto it = items.begin(); it != items.end();) {
+		auto next = it + 1;
+
+		while (next != items.end() && next->first == it->first)
+			++next;
+
+		if (out != next - 1)
+			*out = std::move(*(next - 1));
+
+		++out;
+		it = next;
+	}
+
+	items.erase(out, items.end());
+}
+
 struct JsonContext
 {
 public:
-	void Push(const Value& value)
+	void PushDictionary()
 	{
-		JsonElement element;
-		element.EValue = value;
+		m_Stack.emplace_back();
+		m_Stack.back().IsDictionary = true;
+	}
 
-		m_Stack.push(element);
+	void PushArray()
+	{
+		m_Stack.emplace_back();
 	}
 
-	JsonElement Pop()
+	void Pop()
 	{
-		JsonElement value = m_Stack.top();
-		m_Stack.pop();
-		return value;
+		JsonElement element = std::move(m_Stack.back());
+		m_Stack.pop_back();
+
+		if (element.IsDictionary) {
+			SortDictionaryItems(element.Items);
+			AddValue(new Dictionary(std::move(element.Items)));
+		} else
+			AddValue(new Array(std::move(element.Values)));
 	}
 
-	void AddValue(const Value& value)
+	bool IsNested() const
+	{
+		return !m_Stack.empty();
+	}
+
+	bool InDictionary() const
+	{
+		return !m_Stack.empty() && m_Stack.back().IsDictionary;
+	}
+
+	void SetKey(String key)
+	{
+		if (m_Stack.empty() || !m_Stack.back().IsDictionary)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add key to JSON element."));
+
+		m_Stack.back().Key = std::move(key);
+	}
+
+	void AddValue(Value value)
 	{
 		if (m_Stack.empty()) {
-			JsonElement element;
-			element.EValue = value;
-			m_Stack.push(element);
+			m_Result = std::move(value);
 			return;
 		}
 
-		JsonElement& element = m_Stack.top();
+		JsonElement& element = m_Stack.back();
 
-		if (element.EValue.IsObjectType<Dictionary>()) {
-			if (!element.KeySet) {
-				element.Key = value;
-				element.KeySet = true;
-			} else {
-				Dictionary::Ptr dict = element.EValue;
-				dict->Set(element.Key, value);
-				element.KeySet = false;
-			}
-		} else if (element.EValue.IsObjectType<Array>()) {
-			Array::Ptr arr = element.EValue;
-			arr->Add(value);
-		} else {
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot add value to JSON element."));
-		}
+		if (element.IsDictionary)
+			element.Items.emplace_back(std::move(element.Key), std::move(value));
+		else
+			element.Values.emplace_back(std::move(value));
 	}
 
-	Value GetValue() const
+	Value TakeValue()
 	{
-		ASSERT(m_Stack.size() == 1);
-		return m_Stack.top().EValue;
+		ASSERT(m_Stack.empty());
+		return std::move(m_Result);
 	}
 
 	void SaveException()
@@ -206,8 +340,8 @@ public:
 	}
 
 private:
-	std::stack<JsonElement> m_Stack;
-	Value m_Key;
+	std::vector<JsonElement> m_Stack;
+	Value m_Result;
 	boost::exception_ptr m_Exception;
 };
 
@@ -244,8 +378,17 @@ static int DecodeNumber(void *ctx, const char *str, yajl_size len)
 	auto *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		String jstr = String(str, str + len);
-		context->AddValue(Convert::ToDouble(jstr));
+		/* yajl has already validated the number, most of them fit into the stack buffer. */
+		char buf[64];
+
+		if (len < sizeof(buf)) {
+			memcpy(buf, str, len);
+			buf[len] = '\0';
+			context->AddValue(strtod(buf, nullptr));
+		} else {
+			String jstr = String(str, str + len);
+			context->AddValue(Convert::ToDouble(jstr));
+		}
 	} catch (...) {
 		context->SaveException();
 		return 0;
@@ -268,12 +411,26 @@ static int DecodeString(void *ctx, const unsigned char *str, yajl_size len)
 	return 1;
 }
 
+static int DecodeMapKey(void *ctx, const unsigned char *str, yajl_size len)
+{
+	auto *context = static_cast<JsonContext *>(ctx);
+
+	try {
+		context->SetKey(String(str, str + len));
+	} catch (...) {
+		context->SaveException();
+		return 0;
+	}
+
+	return 1;
+}
+
 static int DecodeStartMap(void *ctx)
 {
 	auto *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->Push(new Dictionary());
+		context->PushDictionary();
 	} catch (...) {
 		context->SaveException();
 		return 0;
@@ -287,7 +444,7 @@ static int DecodeEndMapOrArray(void *ctx)
 	auto *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->AddValue(context->Pop().EValue);
+		context->Pop();
 	} catch (...) {
 		context->SaveException();
 		return 0;
@@ -301,7 +458,7 @@ static int DecodeStartArray(void *ctx)
 	auto *context = static_cast<JsonContext *>(ctx);
 
 	try {
-		context->Push(new Array());
+		context->PushArray();
 	} catch (...) {
 		context->SaveException();
 		return 0;
@@ -310,7 +467,515 @@ static int DecodeStartArray(void *ctx)
 	return 1;
 }
 
+/*
+ * Decoding with a structural index: The first stage classifies the input in
+ * blocks of 64 bytes and records the offsets of all quotes and of the structural
+ * characters outside of strings. The second stage walks these offsets and builds
+ * the values. Anything that isn't plain JSON (comments, lone surrogates, invalid
+ * input, ...) is left to yajl, so errors and extensions behave the same.
+ */
+
+struct JsonBlockMasks
+{
+	uint64_t Quotes{0};
+	uint64_t Backslashes{0};
+	uint64_t Structurals{0};
+	uint64_t Controls{0};
+};
+
+static void ClassifyJsonBlock(const char *block, JsonBlockMasks& masks)
+{
+#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i colon = _mm_set1_epi8(':');
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i lowercase = _mm_set1_epi8(0x20);
+	const __m128i openBrace = _mm_set1_epi8('{');
+	const __m128i closeBrace = _mm_set1_epi8('}');
+	const __m128i controlMax = _mm_set1_epi8(0x1f);
+
+	for (int i = 0; i < 4; i++) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+
+		/* '[' and ']' only differ from '{' and '}' in bit 0x20. */
+		__m128i folded = _mm_or_si128(chunk, lowercase);
+		__m128i structurals = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(folded, openBrace), _mm_cmpeq_epi8(folded, closeBrace)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, comma)));
+		__m128i controls = _mm_cmpeq_epi8(_mm_max_epu8(chunk, controlMax), controlMax);
+
+		int shift = i * 16;
+		masks.Quotes |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote))) << shift;
+		masks.Backslashes |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash))) << shift;
+		masks.Structurals |= static_cast<uint64_t>(_mm_movemask_epi8(structurals)) << shift;
+		masks.Controls |= static_cast<uint64_t>(_mm_movemask_epi8(controls)) << shift;
+	}
+#else /* __SSE2__ */
+	for (int i = 0; i < 64; i++) {
+		uint64_t bit = static_cast<uint64_t>(1) << i;
+		auto ch = static_cast<unsigned char>(block[i]);
+
+		if (ch == '"')
+			masks.Quotes |= bit;
+		else if (ch == '\\')
+			masks.Backslashes |= bit;
+		else if (ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ':' || ch == ',')
+			masks.Structurals |= bit;
+		else if (ch < 0x20)
+			masks.Controls |= bit;
+	}
+#endif /* __SSE2__ */
+}
+
+static inline int CountTrailingZeros(uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return index;
+#else /* _MSC_VER */
+	return __builtin_ctzll(bits);
+#endif /* _MSC_VER */
+}
+
+/**
+ * Sets all bits from each set bit up to (but not including) the next one.
+ */
+static inline uint64_t PrefixXor(uint64_t bits)
+{
+	bits ^= bits << 1;
+	bits ^= bits << 2;
+	bits ^= bits << 4;
+	bits ^= bits << 8;
+	bits ^= bits << 16;
+	bits ^= bits << 32;
+	return bits;
+}
+
+/**
+ * First stage: Finds the offsets of all unescaped quotes and of the structural
+ * characters which aren't part of a string.
+ */
+static bool IndexJsonStructurals(const char *input, size_t length, std::vector<uint32_t>& indices)
+{
+	if (length >= UINT32_MAX)
+		return false;
+
+	indices.reserve(length / 4);
+
+	uint64_t inString = 0;
+	bool escapeNext = false;
+	char tail[64];
+
+	for (size_t offset = 0; offset < length; offset += 64) {
+		const char *block = input + offset;
+
+		if (length - offset < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, block, length - offset);
+			block = tail;
+		}
+
+		JsonBlockMasks masks;
+		ClassifyJsonBlock(block, masks);
+
+		/* Backslashes are rare, so their escapes are resolved one by one. */
+		uint64_t escaped = 0;
+		uint64_t backslashes = masks.Backslashes;
+
+		if (escapeNext) {
+			escaped = 1;
+			backslashes &= ~static_cast<uint64_t>(1);
+			escapeNext = false;
+		}
+
+		while (backslashes) {
+			int bit = CountTrailingZeros(backslashes);
+
+			if (bit == 63) {
+				escapeNext = true;
+				break;
+			}
+
+			escaped |= static_cast<uint64_t>(1) << (bit + 1);
+			backslashes &= ~(static_cast<uint64_t>(3) << bit);
+		}
+
+		uint64_t quotes = masks.Quotes & ~escaped;
+		uint64_t strings = PrefixXor(quotes) ^ inString;
+		inString = (strings >> 63) ? ~static_cast<uint64_t>(0) : 0;
+
+		/* yajl decides what to do with unescaped control characters in strings. */
+		if (masks.Controls & strings)
+			return false;
+
+		uint64_t bits = (masks.Structurals & ~strings) | quotes;
+
+		while (bits) {
+			indices.push_back(offset + CountTrailingZeros(bits));
+			bits &= bits - 1;
+		}
+	}
+
+	return inString == 0;
+}
+
+static inline bool IsJsonWhitespace(char ch)
+{
+	return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+static inline bool IsJsonDigit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+static bool DecodeJsonScalar(const char *begin, const char *end, Value& value)
+{
+	size_t length = end - begin;
+
+	if (length == 4 && memcmp(begin, "true", 4) == 0) {
+		value = true;
+		return true;
+	} else if (length == 5 && memcmp(begin, "false", 5) == 0) {
+		value = false;
+		return true;
+	} else if (length == 4 && memcmp(begin, "null", 4) == 0) {
+		value = Empty;
+		return true;
+	}
+
+	/* strtod() accepts more than JSON numbers, e.g. hex numbers and "inf". */
+	const char *p = begin;
+
+	if (p != end && *p == '-')
+		p++;
+
+	if (p == end)
+		return false;
+
+	if (*p == '0')
+		p++;
+	else if (IsJsonDigit(*p)) {
+		while (p != end && IsJsonDigit(*p))
+			p++;
+	} else
+		return false;
+
+	if (p != end && *p == '.') {
+		const char *digits = ++p;
+
+		while (p != end && IsJsonDigit(*p))
+			p++;
+
+		if (p == digits)
+			return false;
+	}
+
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		p++;
+
+		if (p != end && (*p == '+' || *p == '-'))
+			p++;
+
+		const char *digits = p;
+
+		while (p != end && IsJsonDigit(*p))
+			p++;
+
+		if (p == digits)
+			return false;
+	}
+
+	if (p != end)
+		return false;
+
+	char buf[64];
+
+	if (length < sizeof(buf)) {
+		memcpy(buf, begin, length);
+		buf[length] = '\0';
+		value = strtod(buf, nullptr);
+	} else
+		value = Convert::ToDouble(String(begin, end));
+
+	return true;
+}
+
+static bool ReadJsonHex4(const char *p, const char *end, unsigned long& value)
+{
+	if (end - p < 4)
+		return false;
+
+	value = 0;
+
+	for (int i = 0; i < 4; i++) {
+		char ch = p[i];
+		value <<= 4;
+
+		if (ch >= '0' && ch <= '9')
+			value |= ch - '0';
+		else if (ch >= 'a' && ch <= 'f')
+			value |= ch - 'a' + 10;
+		else if (ch >= 'A' && ch <= 'F')
+			value |= ch - 'A' + 10;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+static void AppendUtf8(std::string& out, unsigned long codepoint)
+{
+	if (codepoint < 0x80)
+		out += static_cast<char>(codepoint);
+	else if (codepoint < 0x800) {
+		out += static_cast<char>(0xC0 | (codepoint >> 6));
+		out += static_cast<char>(0x80 | (codepoint & 0x3F));
+	} else if (codepoint < 0x10000) {
+		out += static_cast<char>(0xE0 | (codepoint >> 12));
+		out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (codepoint & 0x3F));
+	} else {
+		out += static_cast<char>(0xF0 | (codepoint >> 18));
+		out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+		out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		out += static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+}
+
+static bool DecodeJsonString(const char *begin, const char *end, String& result)
+{
+	auto *backslash = static_cast<const char *>(memchr(begin, '\\', end - begin));
+
+	if (!backslash) {
+		result = String(begin, end);
+		return true;
+	}
+
+	std::string out;
+	out.reserve(end - begin);
+	out.append(begin, backslash);
+
+	for (const char *p = backslash; p < end; p++) {
+		if (*p != '\\') {
+			out += *p;
+			continue;
+		}
+
+		if (++p == end)
+			return false;
+
+		switch (*p) {
+			case '"':
+			case '\\':
+			case '/':
+				out += *p;
+				break;
+			case 'b':
+				out += '\b';
+				break;
+			case 'f':
+				out += '\f';
+				break;
+			case 'n':
+				out += '\n';
+				break;
+			case 'r':
+				out += '\r';
+				break;
+			case 't':
+				out += '\t';
+				break;
+			case 'u': {
+				unsigned long codepoint, low;
+
+				if (!ReadJsonHex4(p + 1, end, codepoint))
+					return false;
+
+				p += 4;
+
+				/* yajl replaces lone surrogates with '?'. */
+				if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+					return false;
+
+				if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+					if (end - p < 7 || p[1] != '\\' || p[2] != 'u' || !ReadJsonHex4(p + 3, end, low) || low < 0xDC00 || low > 0xDFFF)
+						return false;
+
+					p += 6;
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				AppendUtf8(out, codepoint);
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+
+	result = String(std::move(out));
+	return true;
+}
+
+/**
+ * Second stage: Walks the structural index and builds the values.
+ */
+static bool DecodeJsonIndexed(const char *input, size_t length, JsonContext& context)
+{
+	std::vector<uint32_t> indices;
+
+	if (!IndexJsonStructurals(input, length, indices))
+		return false;
+
+	enum {
+		ExpectValue,
+		ExpectValueOrEnd,
+		ExpectKey,
+		ExpectKeyOrEnd,
+		ExpectColon,
+		AfterValue
+	} state = ExpectValue;
+
+	size_t pos = 0;
+
+	for (size_t i = 0;; i++) {
+		size_t next = i < indices.size() ? indices[i] : length;
+
+		/* Literals and numbers aren't indexed, they're whatever is between two structurals. */
+		const char *gap = input + pos;
+		const char *gapEnd = input + next;
+
+		while (gap < gapEnd && IsJsonWhitespace(*gap))
+			gap++;
+
+		if (gap < gapEnd) {
+			if (state != ExpectValue && state != ExpectValueOrEnd)
+				return false;
+
+			while (IsJsonWhitespace(gapEnd[-1]))
+				gapEnd--;
+
+			Value value;
+
+			if (!DecodeJsonScalar(gap, gapEnd, value))
+				return false;
+
+			context.AddValue(std::move(value));
+			state = AfterValue;
+		}
+
+		if (next == length)
+			return state == AfterValue && !context.IsNested();
+
+		pos = next + 1;
+
+		switch (input[next]) {
+			case '"': {
+				/* The next index is always the closing quote. */
+				size_t close = indices[++i];
+				String str;
+
+				if (!DecodeJsonString(input + next + 1, input + close, str))
+					return false;
+
+				pos = close + 1;
+
+				if (state == ExpectValue || state == ExpectValueOrEnd) {
+					context.AddValue(std::move(str));
+					state = AfterValue;
+				} else if (state == ExpectKey || state == ExpectKeyOrEnd) {
+					context.SetKey(std::move(str));
+					state = ExpectColon;
+				} else
+					return false;
+
+				break;
+			}
+			case '{':
+				if (state != ExpectValue && state != ExpectValueOrEnd)
+					return false;
+
+				context.PushDictionary();
+				state = ExpectKeyOrEnd;
+				break;
+			case '[':
+				if (state != ExpectValue && state != ExpectValueOrEnd)
+					return false;
+
+				context.PushArray();
+				state = ExpectValueOrEnd;
+				break;
+			case '}':
+				if ((state != ExpectKeyOrEnd && state != AfterValue) || !context.InDictionary())
+					return false;
+
+				context.Pop();
+				state = AfterValue;
+				break;
+			case ']':
+				if ((state != ExpectValueOrEnd && state != AfterValue) || !context.IsNested() || context.InDictionary())
+					return false;
+
+				context.Pop();
+				state = AfterValue;
+				break;
+			case ':':
+				if (state != ExpectColon)
+					return false;
+
+				state = ExpectValue;
+				break;
+			case ',':
+				if (state != AfterValue || !context.IsNested())
+					return false;
+
+				state = context.InDictionary() ? ExpectKey : ExpectValue;
+				break;
+			default:
+				return false;
+		}
+	}
+}
+
+/**
+ * Decodes plain JSON with the structural index parser.
+ *
+ * @param data The JSON document.
+ * @param result The decoded value (only set on success).
+ * @returns false if the document needs the full parser, e.g. because it is
+ *          invalid or contains comments, true otherwise.
+ */
+bool icinga::JsonDecodeIndexed(const String& data, Value *result)
+{
+	ThreadConfinedScope confined;
+
+	JsonContext context;
+
+	if (!DecodeJsonIndexed(data.CStr(), data.GetLength(), context))
+		return false;
+
+	*result = context.TakeValue();
+	return true;
+}
+
 Value icinga::JsonDecode(const String& data)
+{
+	return JsonDecode(data.CStr(), data.GetLength());
+}
+
+/**
+ * Decodes a JSON document which doesn't have to be in a String, e.g. a
+ * message in a stream's read buffer.
+ *
+ * @param data The document.
+ * @param length The length of the document.
+ * @returns The decoded value.
+ */
+Value icinga::JsonDecode(const char *data, size_t length)
 {
 	static const yajl_callbacks callbacks = {
 		DecodeNull,
@@ -320,7 +985,7 @@ Value icinga::JsonDecode(const String& data)
 		DecodeNumber,
 		DecodeString,
 		DecodeStartMap,
-		DecodeString,
+		DecodeMapKey,
 		DecodeEndMapOrArray,
 		DecodeStartArray,
 		DecodeEndMapOrArray
@@ -330,6 +995,19 @@ Value icinga::JsonDecode(const String& data)
 #if YAJL_MAJOR < 2
 	yajl_parser_config cfg = { 1, 0 };
 #endif /* YAJL_MAJOR */
+
+	/* None of the decoded objects are visible to other threads before we return. */
+	ThreadConfinedScope confined;
+
+#ifdef ICINGA2_SIMD_JSON
+	{
+		JsonContext context;
+
+		if (DecodeJsonIndexed(data, length, context))
+			return context.TakeValue();
+	}
+#endif /* ICINGA2_SIMD_JSON */
+
 	JsonContext context;
 
 #if YAJL_MAJOR < 2
@@ -340,14 +1018,14 @@ Value icinga::JsonDecode(const String& data)
 	yajl_config(handle, yajl_allow_comments, 1);
 #endif /* YAJL_MAJOR */
 
-	yajl_parse(handle, reinterpret_cast<const unsigned char *>(data.CStr()), data.GetLength());
+	yajl_parse(handle, reinterpret_cast<const unsigned char *>(data), length);
 
 #if YAJL_MAJOR < 2
 	if (yajl_parse_complete(handle) != yajl_status_ok) {
 #else /* YAJL_MAJOR */
 	if (yajl_complete_parse(handle) != yajl_status_ok) {
 #endif /* YAJL_MAJOR */
-		unsigned char *internal_err_str = yajl_get_error(handle, 1, reinterpret_cast<const unsigned char *>(data.CStr()), data.GetLength());
+		unsigned char *internal_err_str = yajl_get_error(handle, 1, reinterpret_cast<const unsigned char *>(data), length);
 		String msg = reinterpret_cast<char *>(internal_err_str);
 		yajl_free_error(handle, internal_err_str);
 
@@ -361,5 +1039,5 @@ Value icinga::JsonDecode(const String& data)
 
 	yajl_free(handle);
 
-	return context.GetValue();
+	return context.TakeValue();
 }
@@ -21,6 +21,7 @@
 #define JSON_H
 
 #include "base/i2-base.hpp"
+#include "base/stream.hpp"
 
 namespace icinga
 {
@@ -29,7 +30,10 @@ class String;
 class Value;
 
 String JsonEncode(const Value& value, bool pretty_print = false);
+void JsonEncode(const Value& value, const Stream::Ptr& stream, bool pretty_print = false);
 Value JsonDecode(const String& data);
+Value JsonDecode(const char *data, size_t length);
+bool JsonDecodeIndexed(const String& data, Value *result);
 
 }
 
@@ -0,0 +1,186 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/latencyhistogram.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <set>
+
+using namespace icinga;
+
+REGISTER_STATSFUNCTION(LatencyHistogram, &LatencyHistogram::StatsFunc);
+
+/* Values below this are counted exactly, everything above gets eight buckets per power of two. */
+#define LATENCY_HISTOGRAM_LINEAR 8
+#define LATENCY_HISTOGRAM_SHIFT 3
+
+static boost::mutex& GetHistogramsMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+static std::set<LatencyHistogram *>& GetHistograms()
+{
+	static std::set<LatencyHistogram *> histograms;
+	return histograms;
+}
+
+LatencyHistogram::LatencyHistogram(String name)
+	: m_Name(std::move(name))
+{
+	for (auto& bucket : m_Buckets)
+		bucket.store(0, std::memory_order_relaxed);
+
+	boost::mutex::scoped_lock lock(GetHistogramsMutex());
+	GetHistograms().insert(this);
+}
+
+LatencyHistogram::~LatencyHistogram()
+{
+	boost::mutex::scoped_lock lock(GetHistogramsMutex());
+	GetHistograms().erase(this);
+}
+
+const String& LatencyHistogram::GetName() const
+{
+	return m_Name;
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t usec)
+{
+	if (usec < LATENCY_HISTOGRAM_LINEAR)
+		return usec;
+
+	size_t exponent = 63;
+
+	while (!(usec & (UINT64_C(1) << exponent)))
+		exponent--;
+
+	size_t sub = (usec >> (exponent - LATENCY_HISTOGRAM_SHIFT)) & (LATENCY_HISTOGRAM_LINEAR - 1);
+	size_t bucket = LATENCY_HISTOGRAM_LINEAR + (exponent - LATENCY_HISTOGRAM_SHIFT) * LATENCY_HISTOGRAM_LINEAR + sub;
+
+	return std::min<size_t>(bucket, LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+/**
+ * Returns the largest latency (in seconds) which is counted in a bucket.
+ */
+double LatencyHistogram::GetBucketUpperBound(size_t bucket)
+{
+	if (bucket < LATENCY_HISTOGRAM_LINEAR)
+		return bucket / 1000000.0;
+
+	size_t exponent = (bucket - LATENCY_HISTOGRAM_LINEAR) / LATENCY_HISTOGRAM_LINEAR + LATENCY_HISTOGRAM_SHIFT;
+	size_t sub = (bucket - LATENCY_HISTOGRAM_LINEAR) % LATENCY_HISTOGRAM_LINEAR;
+
+	uint64_t upper = ((LATENCY_HISTOGRAM_LINEAR + sub + 1) << (exponent - LATENCY_HISTOGRAM_SHIFT)) - 1;
+
+	return upper / 1000000.0;
+}
+
+/**
+ * Records a latency.
+ *
+ * @param latency The latency in seconds.
+ */
+void LatencyHistogram::Record(double latency)
+{
+	uint64_t usec = latency > 0 ? static_cast<uint64_t>(latency * 1000000 + 0.5) : 0;
+
+	m_Buckets[GetBucket(usec)].fetch_add(1, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint_fast64_t LatencyHistogram::GetCount() const
+{
+	return m_Count.load(std::memory_order_relaxed);
+}
+
+/**
+ * Calculates a percentile of the recorded latencies.
+ *
+ * @param percentile The percentile (e.g. 99.9).
+ * @returns The latency in seconds, or 0 if nothing was recorded yet.
+ */
+double LatencyHistogram::GetPercentile(double percentile) const
+{
+	uint_fast64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+	uint_fast64_t count = 0;
+
+	/* Use the bucket counts for the total, m_Count might be updated concurrently. */
+	for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+		count += buckets[i];
+	}
+
+	if (count == 0)
+		return 0;
+
+	uint_fast64_t rank = static_cast<uint_fast64_t>(count * percentile / 100.0 + 0.5);
+
+	if (rank < 1)
+		rank = 1;
+
+	uint_fast64_t seen = 0;
+
+	for (size_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+		seen += buckets[i];
+
+		if (seen >= rank)
+			return GetBucketUpperBound(i);
+	}
+
+	return GetBucketUpperBound(LATENCY_HISTOGRAM_BUCKETS - 1);
+}
+
+void LatencyHistogram::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	boost::mutex::scoped_lock lock(GetHistogramsMutex());
+
+	for (LatencyHistogram *histogram : GetHistograms()) {
+		const String& name = histogram->GetName();
+		double p50 = histogram->GetPercentile(50);
+		double p99 = histogram->GetPercentile(99);
+		double p999 = histogram->GetPercentile(99.9);
+
+		status->Set(name, new Dictionary({
+			{ "count", histogram->GetCount() },
+			{ "p50", p50 },
+			{ "p99", p99 },
+			{ "p999", p999 }
+		}));
+
+		perfdata->Add(new PerfdataValue(name + "_p50", p50));
+		perfdata->Add(new PerfdataValue(name + "_p99", p99));
+		perfdata->Add(new PerfdataValue(name + "_p999", p999));
+	}
+}
+
+LatencyTimer::LatencyTimer(LatencyHistogram& histogram)
+	: m_Histogram(histogram), m_Start(Utility::GetTime())
+{ }
+
+LatencyTimer::~LatencyTimer()
+{
+	m_Histogram.Record(Utility::GetTime() - m_Start);
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace icinga
+{
+
+#define LATENCY_HISTOGRAM_BUCKETS 312
+
+/**
+ * A lock-free histogram for latencies between 1 microsecond and several hours.
+ *
+ * Buckets are log-linear (eight buckets per power of two) so percentiles
+ * are accurate to about 12%. Histograms register themselves by name and
+ * are reported by the LatencyHistogram stats function.
+ *
+ * @ingroup base
+ */
+class LatencyHistogram
+{
+public:
+	explicit LatencyHistogram(String name);
+	~LatencyHistogram();
+
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	const String& GetName() const;
+
+	void Record(double latency);
+
+	uint_fast64_t GetCount() const;
+	double GetPercentile(double percentile) const;
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+private:
+	String m_Name;
+	std::atomic<uint_fast64_t> m_Count{0};
+	std::atomic<uint_fast64_t> m_Buckets[LATENCY_HISTOGRAM_BUCKETS];
+
+	static size_t GetBucket(uint64_t usec);
+	static double GetBucketUpperBound(size_t bucket);
+};
+
+/**
+ * Records the time between its construction and destruction in a histogram.
+ *
+ * @ingroup base
+ */
+class LatencyTimer
+{
+public:
+	explicit LatencyTimer(LatencyHistogram& histogram);
+	~LatencyTimer();
+
+	LatencyTimer(const LatencyTimer&) = delete;
+	LatencyTimer& operator=(const LatencyTimer&) = delete;
+
+private:
+	LatencyHistogram& m_Histogram;
+	double m_Start;
+};
+
+}
+
+#endif /* LATENCYHISTOGRAM_H */
@@ -43,6 +43,8 @@ template Log& Log::operator<<(const double&);
 REGISTER_TYPE(Logger);
 
 std::set<Logger::Ptr> Logger::m_Loggers;
+Logger::LoggerList Logger::m_LoggerList;
+std::atomic<LogSeverity> Logger::m_MinLogSeverity(LogInformation);
 boost::mutex Logger::m_Mutex;
 bool Logger::m_ConsoleLogEnabled = true;
 bool Logger::m_TimestampEnabled = true;
@@ -54,6 +56,10 @@ INITIALIZE_ONCE([]() {
 	ScriptGlobal::Set("LogInformation", LogInformation);
 	ScriptGlobal::Set("LogWarning", LogWarning);
 	ScriptGlobal::Set("LogCritical", LogCritical);
+
+	Logger::OnSeverityChanged.connect([](const Logger::Ptr&, const Value&) {
+		Logger::UpdateMinLogSeverity();
+	});
 });
 
 /**
@@ -63,8 +69,12 @@ void Logger::Start(bool runtimeCreated)
 {
 	ObjectImpl<Logger>::Start(runtimeCreated);
 
-	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Loggers.insert(this);
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_Loggers.insert(this);
+	}
+
+	UpdateLoggers();
 }
 
 void Logger::Stop(bool runtimeRemoved)
@@ -74,6 +84,8 @@ void Logger::Stop(bool runtimeRemoved)
 		m_Loggers.erase(this);
 	}
 
+	UpdateLoggers();
+
 	ObjectImpl<Logger>::Stop(runtimeRemoved);
 }
 
@@ -83,6 +95,48 @@ std::set<Logger::Ptr> Logger::GetLoggers()
 	return m_Loggers;
 }
 
+/**
+ * Returns an immutable snapshot of the active loggers. Log entries use
+ * this instead of GetLoggers() so they don't have to copy the set.
+ */
+Logger::LoggerList Logger::GetLoggerList()
+{
+	return std::atomic_load(&m_LoggerList);
+}
+
+void Logger::UpdateLoggers()
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		std::atomic_store(&m_LoggerList, LoggerList(new std::vector<Logger::Ptr>(m_Loggers.begin(), m_Loggers.end())));
+	}
+
+	UpdateMinLogSeverity();
+}
+
+/**
+ * Updates the cached minimum severity which Log uses to skip formatting
+ * messages nobody would receive.
+ */
+void Logger::UpdateMinLogSeverity()
+{
+	LogSeverity minSeverity = LogCritical;
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	for (const Logger::Ptr& logger : m_Loggers) {
+		LogSeverity severity = logger->GetMinSeverity();
+
+		if (severity < minSeverity)
+			minSeverity = severity;
+	}
+
+	if (m_ConsoleLogEnabled && m_ConsoleLogSeverity < minSeverity)
+		minSeverity = m_ConsoleLogSeverity;
+
+	m_MinLogSeverity.store(minSeverity, std::memory_order_relaxed);
+}
+
 /**
  * Retrieves the minimum severity for this logger.
  *
@@ -151,11 +205,13 @@ LogSeverity Logger::StringToSeverity(const String& severity)
 void Logger::DisableConsoleLog()
 {
 	m_ConsoleLogEnabled = false;
+	UpdateMinLogSeverity();
 }
 
 void Logger::EnableConsoleLog()
 {
 	m_ConsoleLogEnabled = true;
+	UpdateMinLogSeverity();
 }
 
 bool Logger::IsConsoleLogEnabled()
@@ -166,6 +222,7 @@ bool Logger::IsConsoleLogEnabled()
 void Logger::SetConsoleLogSeverity(LogSeverity logSeverity)
 {
 	m_ConsoleLogSeverity = logSeverity;
+	UpdateMinLogSeverity();
 }
 
 LogSeverity Logger::GetConsoleLogSeverity()
@@ -200,13 +257,14 @@ void Logger::ValidateSeverity(const Lazy<String>& lvalue, const ValidationUtils&
 }
 
 Log::Log(LogSeverity severity, String facility, const String& message)
-	: m_Severity(severity), m_Facility(std::move(facility))
+	: m_Severity(severity), m_Facility(std::move(facility)), m_IsNoOp(!Logger::IsLogLevelEnabled(severity))
 {
-	m_Buffer << message;
+	if (!m_IsNoOp)
+		m_Buffer << message;
 }
 
 Log::Log(LogSeverity severity, String facility)
-	: m_Severity(severity), m_Facility(std::move(facility))
+	: m_Severity(severity), m_Facility(std::move(facility)), m_IsNoOp(!Logger::IsLogLevelEnabled(severity))
 { }
 
 /**
@@ -214,6 +272,9 @@ Log::Log(LogSeverity severity, String facility)
  */
 Log::~Log()
 {
+	if (m_IsNoOp)
+		return;
+
 	LogEntry entry;
 	entry.Timestamp = Utility::GetTime();
 	entry.Severity = m_Severity;
@@ -230,19 +291,25 @@ Log::~Log()
 		}
 	}
 
-	for (const Logger::Ptr& logger : Logger::GetLoggers()) {
-		ObjectLock llock(logger);
+	Logger::LoggerList loggers = Logger::GetLoggerList();
 
-		if (!logger->IsActive())
-			continue;
+	if (loggers) {
+		for (const Logger::Ptr& logger : *loggers) {
+			if (entry.Severity < logger->GetMinSeverity())
+				continue;
+
+			ObjectLock llock(logger);
+
+			if (!logger->IsActive())
+				continue;
 
-		if (entry.Severity >= logger->GetMinSeverity())
 			logger->ProcessLogEntry(entry);
 
 #ifdef I2_DEBUG /* I2_DEBUG */
-		/* Always flush, don't depend on the timer. Enable this for development sprints. */
-		//logger->Flush();
+			/* Always flush, don't depend on the timer. Enable this for development sprints. */
+			//logger->Flush();
 #endif /* I2_DEBUG */
+		}
 	}
 
 	if (Logger::IsConsoleLogEnabled() && entry.Severity >= Logger::GetConsoleLogSeverity())
@@ -251,6 +318,8 @@ Log::~Log()
 
 Log& Log::operator<<(const char *val)
 {
-	m_Buffer << val;
+	if (!m_IsNoOp)
+		m_Buffer << val;
+
 	return *this;
 }
@@ -22,7 +22,10 @@
 
 #include "base/i2-base.hpp"
 #include "base/logger-ti.hpp"
+#include <atomic>
+#include <memory>
 #include <set>
+#include <vector>
 #include <iosfwd>
 
 namespace icinga
@@ -81,6 +84,18 @@ public:
 
 	static std::set<Logger::Ptr> GetLoggers();
 
+	/**
+	 * Checks whether any logger (including the console) would process
+	 * a log entry with the specified severity.
+	 *
+	 * @param severity The severity.
+	 * @returns true if the entry would be logged, false otherwise.
+	 */
+	static bool IsLogLevelEnabled(LogSeverity severity)
+	{
+		return severity >= m_MinLogSeverity.load(std::memory_order_relaxed);
+	}
+
 	static void DisableConsoleLog();
 	static void EnableConsoleLog();
 	static bool IsConsoleLogEnabled();
@@ -98,11 +113,21 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
+	friend class Log;
+
+	typedef std::shared_ptr<const std::vector<Logger::Ptr> > LoggerList;
+
 	static boost::mutex m_Mutex;
 	static std::set<Logger::Ptr> m_Loggers;
+	static LoggerList m_LoggerList;
+	static std::atomic<LogSeverity> m_MinLogSeverity;
 	static bool m_ConsoleLogEnabled;
 	static bool m_TimestampEnabled;
 	static LogSeverity m_ConsoleLogSeverity;
+
+	static LoggerList GetLoggerList();
+	static void UpdateLoggers();
+	static void UpdateMinLogSeverity();
 };
 
 class Log
@@ -120,7 +145,9 @@ public:
 	template<typename T>
 	Log& operator<<(const T& val)
 	{
-		m_Buffer << val;
+		if (!m_IsNoOp)
+			m_Buffer << val;
+
 		return *this;
 	}
 
@@ -129,6 +156,7 @@ public:
 private:
 	LogSeverity m_Severity;
 	String m_Facility;
+	bool m_IsNoOp;
 	std::ostringstream m_Buffer;
 };
 
@@ -0,0 +1,162 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/mappedfile.hpp"
+#include "base/exception.hpp"
+
+#ifndef _WIN32
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+/**
+ * Maps the specified file into memory.
+ *
+ * @param path The path of the file.
+ */
+MappedFile::MappedFile(const String& path)
+{
+#ifndef _WIN32
+	int fd = open(path.CStr(), O_RDONLY);
+
+	if (fd < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("open")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(path));
+	}
+
+	struct stat statbuf;
+
+	if (fstat(fd, &statbuf) < 0) {
+		int error = errno;
+		close(fd);
+
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("fstat")
+			<< boost::errinfo_errno(error)
+			<< boost::errinfo_file_name(path));
+	}
+
+	m_Size = statbuf.st_size;
+
+	/* mmap() doesn't support empty mappings. */
+	if (m_Size > 0) {
+		void *data = mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, fd, 0);
+
+		if (data == MAP_FAILED) {
+			int error = errno;
+			close(fd);
+
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("mmap")
+				<< boost::errinfo_errno(error)
+				<< boost::errinfo_file_name(path));
+		}
+
+		m_Data = static_cast<const char *>(data);
+
+		(void) madvise(data, m_Size, MADV_SEQUENTIAL);
+	}
+
+	/* The mapping stays valid after the file descriptor is closed. */
+	close(fd);
+#else /* _WIN32 */
+	m_File = CreateFile(path.CStr(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (m_File == INVALID_HANDLE_VALUE) {
+		BOOST_THROW_EXCEPTION(win32_error()
+			<< boost::errinfo_api_function("CreateFile")
+			<< errinfo_win32_error(GetLastError())
+			<< boost::errinfo_file_name(path));
+	}
+
+	LARGE_INTEGER size;
+
+	if (!GetFileSizeEx(m_File, &size)) {
+		DWORD error = GetLastError();
+		CloseHandle(m_File);
+
+		BOOST_THROW_EXCEPTION(win32_error()
+			<< boost::errinfo_api_function("GetFileSizeEx")
+			<< errinfo_win32_error(error)
+			<< boost::errinfo_file_name(path));
+	}
+
+	m_Size = size.QuadPart;
+
+	/* CreateFileMapping() doesn't support empty mappings. */
+	if (m_Size > 0) {
+		m_Mapping = CreateFileMapping(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!m_Mapping) {
+			DWORD error = GetLastError();
+			CloseHandle(m_File);
+
+			BOOST_THROW_EXCEPTION(win32_error()
+				<< boost::errinfo_api_function("CreateFileMapping")
+				<< errinfo_win32_error(error)
+				<< boost::errinfo_file_name(path));
+		}
+
+		m_Data = static_cast<const char *>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+
+		if (!m_Data) {
+			DWORD error = GetLastError();
+			CloseHandle(m_Mapping);
+			CloseHandle(m_File);
+
+			BOOST_THROW_EXCEPTION(win32_error()
+				<< boost::errinfo_api_function("MapViewOfFile")
+				<< errinfo_win32_error(error)
+				<< boost::errinfo_file_name(path));
+		}
+	}
+#endif /* _WIN32 */
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (m_Data)
+		(void) munmap(const_cast<char *>(m_Data), m_Size);
+#else /* _WIN32 */
+	if (m_Data)
+		UnmapViewOfFile(m_Data);
+
+	if (m_Mapping)
+		CloseHandle(m_Mapping);
+
+	CloseHandle(m_File);
+#endif /* _WIN32 */
+}
+
+const char *MappedFile::GetData() const
+{
+	return m_Data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_Size;
+}
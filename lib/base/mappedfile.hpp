@@ -0,0 +1,59 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "base/i2-base.hpp"
+#include "base/object.hpp"
+#include "base/string.hpp"
+
+namespace icinga
+{
+
+/**
+ * A read-only memory mapping of a file. Mappings of the same file share
+ * the operating system's page cache.
+ *
+ * @ingroup base
+ */
+class MappedFile final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(MappedFile);
+
+	MappedFile(const String& path);
+	~MappedFile() override;
+
+	const char *GetData() const;
+	size_t GetSize() const;
+
+private:
+	const char *m_Data{nullptr};
+	size_t m_Size{0};
+
+#ifdef _WIN32
+	HANDLE m_File{INVALID_HANDLE_VALUE};
+	HANDLE m_Mapping{nullptr};
+#endif /* _WIN32 */
+};
+
+}
+
+#endif /* MAPPEDFILE_H */
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "base/memoryusage.hpp"
+#include "base/fifo.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#ifdef __GLIBC__
+#	include <malloc.h>
+#endif /* __GLIBC__ */
+
+using namespace icinga;
+
+REGISTER_STATSFUNCTION(Memory, &MemoryUsage::StatsFunc);
+
+bool MemoryUsage::m_TypeAccounting = false;
+
+struct TypeUsage
+{
+	const std::type_info *Type;
+	std::atomic<int_fast64_t> Objects{0};
+	std::atomic<int_fast64_t> Bytes{0};
+
+	explicit TypeUsage(const std::type_info& type)
+		: Type(&type)
+	{ }
+};
+
+/* Entries are never removed, so the counters can be updated without holding the lock. */
+static boost::shared_mutex l_TypeUsageMutex;
+static std::unordered_map<std::type_index, std::unique_ptr<TypeUsage> > l_TypeUsage;
+
+static TypeUsage& GetTypeUsage(const std::type_info& type)
+{
+	std::type_index index(type);
+
+	{
+		boost::shared_lock<boost::shared_mutex> lock(l_TypeUsageMutex);
+
+		auto it = l_TypeUsage.find(index);
+
+		if (it != l_TypeUsage.end())
+			return *it->second;
+	}
+
+	boost::unique_lock<boost::shared_mutex> lock(l_TypeUsageMutex);
+
+	std::unique_ptr<TypeUsage>& usage = l_TypeUsage[index];
+
+	if (!usage)
+		usage.reset(new TypeUsage(type));
+
+	return *usage;
+}
+
+/**
+ * Returns the number of bytes the allocator reserved for the object, including
+ * padding and the rounding done by the ObjectPool.
+ */
+static size_t GetAllocationSize(Object *object)
+{
+#ifdef __GLIBC__
+	return malloc_usable_size(dynamic_cast<void *>(object));
+#else /* __GLIBC__ */
+	return 0;
+#endif /* __GLIBC__ */
+}
+
+/**
+ * Enables accounting per object type. This must be called before any
+ * threads are started. Objects which already exist at that point aren't
+ * accounted for.
+ */
+void MemoryUsage::EnableTypeAccounting()
+{
+	m_TypeAccounting = true;
+}
+
+void MemoryUsage::AddObject(Object *object)
+{
+	TypeUsage& usage = GetTypeUsage(typeid(*object));
+
+	usage.Objects.fetch_add(1, std::memory_order_relaxed);
+	usage.Bytes.fetch_add(GetAllocationSize(object), std::memory_order_relaxed);
+}
+
+void MemoryUsage::RemoveObject(Object *object)
+{
+	TypeUsage& usage = GetTypeUsage(typeid(*object));
+
+	usage.Objects.fetch_sub(1, std::memory_order_relaxed);
+	usage.Bytes.fetch_sub(GetAllocationSize(object), std::memory_order_relaxed);
+}
+
+void MemoryUsage::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	size_t rss = Utility::GetResidentMemorySize();
+	size_t fifoBytes = FIFO::GetAllocatedBytes();
+
+	Dictionary::Ptr memory = new Dictionary({
+		{ "rss", rss },
+		{ "fifo_buffers", fifoBytes }
+	});
+
+	perfdata->Add(new PerfdataValue("memory_rss", rss));
+	perfdata->Add(new PerfdataValue("memory_fifo_buffers", fifoBytes));
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 mi = mallinfo2();
+
+	/* Memory which is free but still held by the allocator indicates fragmentation. */
+	memory->Set("heap", new Dictionary({
+		{ "arena", mi.arena + mi.hblkhd },
+		{ "in_use", mi.uordblks + mi.hblkhd },
+		{ "free", mi.fordblks }
+	}));
+
+	perfdata->Add(new PerfdataValue("memory_heap_in_use", mi.uordblks + mi.hblkhd));
+	perfdata->Add(new PerfdataValue("memory_heap_free", mi.fordblks));
+#endif /* __GLIBC__ */
+
+	if (m_TypeAccounting) {
+		/* Types with the same name (e.g. template instances) are reported together. */
+		std::map<String, std::pair<int_fast64_t, int_fast64_t> > types;
+
+		{
+			boost::shared_lock<boost::shared_mutex> lock(l_TypeUsageMutex);
+
+			for (const auto& kv : l_TypeUsage) {
+				auto& usage = types[Utility::GetTypeName(*kv.second->Type)];
+				usage.first += kv.second->Objects.load(std::memory_order_relaxed);
+				usage.second += kv.second->Bytes.load(std::memory_order_relaxed);
+			}
+		}
+
+		DictionaryData typeStats;
+
+		for (const auto& kv : types) {
+			/* Objects which were created before accounting was enabled make these negative. */
+			if (kv.second.first <= 0)
+				continue;
+
+			typeStats.emplace_back(kv.first, new Dictionary({
+				{ "objects", kv.second.first },
+				{ "bytes", std::max<int_fast64_t>(kv.second.second, 0) }
+			}));
+		}
+
+		memory->Set("types", new Dictionary(std::move(typeStats)));
+	}
+
+	status->Set("memory", memory);
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+
+namespace icinga
+{
+
+/**
+ * Memory usage statistics which are reported by the Memory stats function.
+ *
+ * Accounting per object type is optional because it has to look up the
+ * type of every object which is created or destroyed.
+ *
+ * @ingroup base
+ */
+class MemoryUsage
+{
+public:
+	static void EnableTypeAccounting();
+
+	static inline bool IsTypeAccountingEnabled()
+	{
+		return m_TypeAccounting;
+	}
+
+	static void AddObject(Object *object);
+	static void RemoveObject(Object *object);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+private:
+	MemoryUsage();
+
+	static bool m_TypeAccounting;
+};
+
+}
+
+#endif /* MEMORYUSAGE_H */
@@ -24,20 +24,78 @@
 using namespace icinga;
 
 /**
- * Reads data from a stream in netstring format.
+ * Reads the rest of a netstring which was started by ReadStringViewFromStream()
+ * directly from the stream into the context's pending string, so large messages
+ * are copied only once instead of going through the context's buffer.
+ */
+static StreamReadStatus ReadPendingString(const Stream::Ptr& stream, const char **data, size_t *length,
+	StreamReadContext& context, bool may_wait)
+{
+	if (may_wait && stream->SupportsWaiting())
+		stream->WaitForData();
+
+	std::string& pending = context.Pending.GetData();
+
+	while (context.PendingOffset < pending.size()) {
+		if (stream->IsEof()) {
+			context.Eof = true;
+			return StatusEof;
+		}
+
+		size_t rc = stream->Read(&pending[context.PendingOffset], pending.size() - context.PendingOffset, true);
+
+		if (rc == 0)
+			return StatusNeedData;
+
+		context.PendingOffset += rc;
+	}
+
+	if (pending.back() != ',')
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
+
+	pending.pop_back();
+
+	*data = pending.c_str();
+	*length = pending.size();
+	context.PendingDone = true;
+
+	return StatusNewItem;
+}
+
+/**
+ * Reads data from a stream in netstring format without copying it.
+ *
+ * The returned view points into the context's buffer (or into its pending
+ * string for messages which didn't fit into the buffer) and stays valid
+ * until the next read from the same context.
  *
  * @param stream The stream to read from.
- * @param[out] str The String that has been read from the IOQueue.
- * @returns true if a complete String was read from the IOQueue, false otherwise.
+ * @param[out] data The beginning of the message.
+ * @param[out] length The length of the message.
+ * @returns StatusNewItem if a complete message was read, another status otherwise.
  * @exception invalid_argument The input stream is invalid.
  * @see https://github.com/PeterScott/netstring-c/blob/master/netstring.c
  */
-StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, String *str, StreamReadContext& context,
-	bool may_wait, ssize_t maxMessageLength)
+StreamReadStatus NetString::ReadStringViewFromStream(const Stream::Ptr& stream, const char **data, size_t *length,
+	StreamReadContext& context, bool may_wait, ssize_t maxMessageLength)
 {
+	if (context.PendingDone) {
+		context.Pending = String();
+		context.PendingOffset = 0;
+		context.PendingDone = false;
+	}
+
+	if (context.DropCount > 0) {
+		context.DropData(context.DropCount);
+		context.DropCount = 0;
+	}
+
 	if (context.Eof)
 		return StatusEof;
 
+	if (!context.Pending.IsEmpty())
+		return ReadPendingString(stream, data, length, context, may_wait);
+
 	if (context.MustRead) {
 		if (!context.FillFromStream(stream, may_wait)) {
 			context.Eof = true;
@@ -92,23 +150,127 @@ StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, Stri
 		BOOST_THROW_EXCEPTION(std::invalid_argument(errorMessage.str()));
 	}
 
-	char *data = context.Buffer + header_length + 1;
+	char *message = context.Buffer + header_length + 1;
 
 	if (context.Size < header_length + 1 + data_length) {
+		/* Move what we have into the string, the rest is read directly into it. */
+		size_t available = context.Size - header_length - 1;
+
+		context.Pending.GetData().resize(data_length);
+		memcpy(&context.Pending.GetData()[0], message, available);
+		context.PendingOffset = available;
+
+		context.DropData(context.Size);
 		context.MustRead = true;
-		return StatusNeedData;
+
+		return ReadPendingString(stream, data, length, context, false);
 	}
 
-	if (data[len] != ',')
+	if (message[len] != ',')
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
 
-	*str = String(&data[0], &data[len]);
+	*data = message;
+	*length = len;
 
-	context.DropData(header_length + 1 + len + 1);
+	/* The message stays in the buffer until the caller reads the next one. */
+	context.DropCount = header_length + 1 + len + 1;
 
 	return StatusNewItem;
 }
 
+/**
+ * Reads data from a stream in netstring format.
+ *
+ * @param stream The stream to read from.
+ * @param[out] str The String that has been read from the IOQueue.
+ * @returns true if a complete String was read from the IOQueue, false otherwise.
+ * @exception invalid_argument The input stream is invalid.
+ * @see https://github.com/PeterScott/netstring-c/blob/master/netstring.c
+ */
+StreamReadStatus NetString::ReadStringFromStream(const Stream::Ptr& stream, String *str, StreamReadContext& context,
+	bool may_wait, ssize_t maxMessageLength)
+{
+	const char *data;
+	size_t length;
+
+	StreamReadStatus status = ReadStringViewFromStream(stream, &data, &length, context, may_wait, maxMessageLength);
+
+	if (status != StatusNewItem)
+		return status;
+
+	if (context.PendingDone) {
+		*str = std::move(context.Pending);
+		context.Pending = String();
+		context.PendingOffset = 0;
+		context.PendingDone = false;
+	} else {
+		*str = String(data, data + length);
+		context.DropData(context.DropCount);
+		context.DropCount = 0;
+	}
+
+	return StatusNewItem;
+}
+
+/**
+ * Reads data in netstring format from a memory buffer.
+ *
+ * @param buffer The buffer to read from.
+ * @param size The size of the buffer.
+ * @param[out] str The String that has been read from the buffer.
+ * @returns The number of bytes consumed or 0 if the buffer doesn't contain a complete String.
+ * @exception invalid_argument The input is invalid.
+ */
+size_t NetString::ReadStringFromBuffer(const char *buffer, size_t size, String *str)
+{
+	size_t header_length = 0;
+
+	for (size_t i = 0; i < size; i++) {
+		if (buffer[i] == ':') {
+			header_length = i;
+
+			/* make sure there's a header */
+			if (header_length == 0)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (no length specifier)"));
+
+			break;
+		} else if (i > 16)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing :)"));
+	}
+
+	if (header_length == 0)
+		return 0;
+
+	/* no leading zeros allowed */
+	if (buffer[0] == '0' && isdigit(buffer[1]))
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (leading zero)"));
+
+	size_t len = 0;
+
+	for (size_t i = 0; i < header_length; i++) {
+		if (!isdigit(buffer[i]))
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (invalid length specifier)"));
+
+		/* length specifier must have at most 9 characters */
+		if (i >= 9)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Length specifier must not exceed 9 characters"));
+
+		len = len * 10 + (buffer[i] - '0');
+	}
+
+	if (size < header_length + 1 + len + 1)
+		return 0;
+
+	const char *data = buffer + header_length + 1;
+
+	if (data[len] != ',')
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid NetString (missing ,)"));
+
+	*str = String(&data[0], &data[len]);
+
+	return header_length + 1 + len + 1;
+}
+
 /**
  * Writes data into a stream using the netstring format and returns bytes written.
  *
@@ -38,8 +38,11 @@ class String;
 class NetString
 {
 public:
+	static StreamReadStatus ReadStringViewFromStream(const Stream::Ptr& stream, const char **data, size_t *length,
+		StreamReadContext& context, bool may_wait = false, ssize_t maxMessageLength = -1);
 	static StreamReadStatus ReadStringFromStream(const Stream::Ptr& stream, String *message, StreamReadContext& context,
 		bool may_wait = false, ssize_t maxMessageLength = -1);
+	static size_t ReadStringFromBuffer(const char *buffer, size_t size, String *message);
 	static size_t WriteStringToStream(const Stream::Ptr& stream, const String& message);
 	static void WriteStringToStream(std::ostream& stream, const String& message);
 
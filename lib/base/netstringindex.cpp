@@ -0,0 +1,183 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/netstringindex.hpp"
+#include "base/netstring.hpp"
+#include "base/stdiostream.hpp"
+#include "base/json.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include <fstream>
+#include <sys/stat.h>
+
+using namespace icinga;
+
+/* Increment this when the format of the index file changes. */
+static const int l_NetStringIndexVersion = 1;
+
+String NetStringIndex::GetIndexPath(const String& filename)
+{
+	return filename + ".idx";
+}
+
+/**
+ * Writes the index for a netstring file. The index records the file's
+ * size and modification time so that stale indexes can be detected.
+ *
+ * @param filename The netstring file.
+ * @param entries The index entries.
+ */
+void NetStringIndex::WriteToFile(const String& filename, const std::vector<NetStringIndexEntry>& entries)
+{
+	struct stat statbuf;
+
+	if (stat(filename.CStr(), &statbuf) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("stat")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(filename));
+	}
+
+	String indexPath = GetIndexPath(filename);
+
+	std::fstream fp;
+	String tempFilename = Utility::CreateTempFile(indexPath + ".XXXXXX", 0600, fp);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + tempFilename + "' file"));
+
+	Dictionary::Ptr header = new Dictionary({
+		{ "version", l_NetStringIndexVersion },
+		{ "size", static_cast<double>(statbuf.st_size) },
+		{ "mtime", static_cast<double>(statbuf.st_mtime) }
+	});
+
+	NetString::WriteStringToStream(fp, JsonEncode(header));
+
+	for (const NetStringIndexEntry& entry : entries) {
+		Array::Ptr record = new Array({ entry.Type, entry.Name, entry.FullName, static_cast<double>(entry.Offset) });
+		NetString::WriteStringToStream(fp, JsonEncode(record));
+	}
+
+	fp.close();
+
+#ifdef _WIN32
+	_unlink(indexPath.CStr());
+#endif /* _WIN32 */
+
+	if (rename(tempFilename.CStr(), indexPath.CStr()) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("rename")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(tempFilename));
+	}
+}
+
+/**
+ * Reads the index for a netstring file.
+ *
+ * @param filename The netstring file.
+ * @param[out] entries The index entries.
+ * @returns false if there's no index or it doesn't match the file.
+ */
+bool NetStringIndex::ReadFromFile(const String& filename, std::vector<NetStringIndexEntry>& entries)
+{
+	struct stat statbuf;
+
+	if (stat(filename.CStr(), &statbuf) < 0)
+		return false;
+
+	std::fstream fp;
+	fp.open(GetIndexPath(filename).CStr(), std::ios_base::in);
+
+	if (!fp)
+		return false;
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	String message;
+	StreamReadContext src;
+	bool haveHeader = false;
+
+	entries.clear();
+
+	try {
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			if (!haveHeader) {
+				Dictionary::Ptr header = JsonDecode(message);
+
+				if (header->Get("version") != l_NetStringIndexVersion ||
+					static_cast<off_t>(header->Get("size")) != statbuf.st_size ||
+					static_cast<time_t>(header->Get("mtime")) != statbuf.st_mtime)
+					return false;
+
+				haveHeader = true;
+				continue;
+			}
+
+			Array::Ptr record = JsonDecode(message);
+
+			entries.push_back({ record->Get(0), record->Get(1), record->Get(2), static_cast<uint_least64_t>(record->Get(3)) });
+		}
+	} catch (const std::exception&) {
+		entries.clear();
+		return false;
+	}
+
+	return haveHeader;
+}
+
+/**
+ * Reads the netstring record at the specified offset.
+ *
+ * @param fp The netstring file.
+ * @param offset The record's offset from the index.
+ * @returns The record.
+ */
+String NetStringIndex::ReadRecord(std::iostream& fp, uint_least64_t offset)
+{
+	fp.clear();
+	fp.seekg(offset);
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	String message;
+	StreamReadContext src;
+
+	for (;;) {
+		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+		if (srs == StatusNewItem)
+			return message;
+
+		if (srs == StatusEof)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Unexpected end of file while reading record at offset " + Convert::ToString(offset)));
+	}
+}
@@ -0,0 +1,68 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef NETSTRINGINDEX_H
+#define NETSTRINGINDEX_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+#include <iosfwd>
+#include <vector>
+
+namespace icinga
+{
+
+/**
+ * An entry in the index of a netstring file.
+ *
+ * @ingroup base
+ */
+struct NetStringIndexEntry
+{
+	String Type;
+	String Name;
+	String FullName;
+	uint_least64_t Offset;
+};
+
+/**
+ * Sidecar index files for files which consist of netstring records
+ * (e.g. the objects and vars files). They map the record's type and name
+ * to its offset so that single records can be read without parsing
+ * the whole file.
+ *
+ * @ingroup base
+ */
+class NetStringIndex
+{
+public:
+	static String GetIndexPath(const String& filename);
+
+	static void WriteToFile(const String& filename, const std::vector<NetStringIndexEntry>& entries);
+	static bool ReadFromFile(const String& filename, std::vector<NetStringIndexEntry>& entries);
+
+	static String ReadRecord(std::iostream& fp, uint_least64_t offset);
+
+private:
+	NetStringIndex();
+};
+
+}
+
+#endif /* NETSTRINGINDEX_H */
@@ -22,6 +22,7 @@
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
 #include "base/objectlock.hpp"
+#include <stdexcept>
 #include <algorithm>
 #include <climits>
 #include <cstdint>
@@ -266,3 +267,164 @@ String icinga::PackObject(const Value& value)
 	result.insert(result.End(), builder.begin(), builder.end());
 	return std::move(result);
 }
+
+/**
+ * Helper for reading a value produced by PackObject()
+ */
+class PackedObjectReader
+{
+public:
+	PackedObjectReader(const char *begin, const char *end)
+		: m_Position(begin), m_End(end)
+	{ }
+
+	Value ReadAny(int depth = 0);
+
+	bool AtEnd() const
+	{
+		return m_Position == m_End;
+	}
+
+private:
+	const char *m_Position;
+	const char *m_End;
+
+	void Require(uint_least64_t length)
+	{
+		if (static_cast<uint_least64_t>(m_End - m_Position) < length)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object is truncated."));
+	}
+
+	unsigned char ReadByte()
+	{
+		Require(1);
+		return static_cast<unsigned char>(*m_Position++);
+	}
+
+	uint_least64_t ReadUInt64BE()
+	{
+		Require(8);
+
+		uint_least64_t i = 0;
+
+		for (int n = 0; n < 8; n++)
+			i = (i << 8u) | static_cast<unsigned char>(*m_Position++);
+
+		return i;
+	}
+
+	double ReadFloat64BE()
+	{
+		Require(8);
+
+		Double2BytesConverter converter;
+		std::copy(m_Position, m_Position + 8, converter.buf);
+		m_Position += 8;
+
+		if (MACHINE_LITTLE_ENDIAN) {
+			SwapBytes(converter.buf[0], converter.buf[7]);
+			SwapBytes(converter.buf[1], converter.buf[6]);
+			SwapBytes(converter.buf[2], converter.buf[5]);
+			SwapBytes(converter.buf[3], converter.buf[4]);
+		}
+
+		return converter.f;
+	}
+
+	String ReadString()
+	{
+		uint_least64_t length = ReadUInt64BE();
+		Require(length);
+
+		String result(m_Position, m_Position + length);
+		m_Position += length;
+		return result;
+	}
+};
+
+Value PackedObjectReader::ReadAny(int depth)
+{
+	/* Guard against stack exhaustion caused by malicious input. */
+	if (depth > 128)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object is nested too deeply."));
+
+	switch (ReadByte()) {
+		case 0:
+			return Empty;
+
+		case 1:
+			return false;
+
+		case 2:
+			return true;
+
+		case 3:
+			return ReadFloat64BE();
+
+		case 4:
+			return ReadString();
+
+		case 5:
+			{
+				uint_least64_t length = ReadUInt64BE();
+
+				/* Every element takes at least one byte. */
+				Require(length);
+
+				ArrayData items;
+				items.reserve(length);
+
+				for (uint_least64_t i = 0; i < length; i++)
+					items.emplace_back(ReadAny(depth + 1));
+
+				return new Array(std::move(items));
+			}
+
+		case 6:
+			{
+				uint_least64_t length = ReadUInt64BE();
+
+				/* Every key-value pair takes at least nine bytes. */
+				Require(length);
+
+				Dictionary::Ptr dict = new Dictionary();
+
+				for (uint_least64_t i = 0; i < length; i++) {
+					String key = ReadString();
+					dict->Set(key, ReadAny(depth + 1));
+				}
+
+				return dict;
+			}
+
+		default:
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object contains an invalid type tag."));
+	}
+}
+
+/**
+ * Unpack a value produced by PackObject()
+ *
+ * Throws std::invalid_argument if the input is not a valid packed object.
+ */
+Value icinga::UnpackObject(const String& packed)
+{
+	return UnpackObject(packed.CStr(), packed.GetLength());
+}
+
+/**
+ * Unpack a value produced by PackObject() from a memory buffer
+ *
+ * Throws std::invalid_argument if the input is not a valid packed object.
+ */
+Value icinga::UnpackObject(const char *packed, size_t length)
+{
+	PackedObjectReader reader(packed, packed + length);
+
+	Value result = reader.ReadAny();
+
+	if (!reader.AtEnd())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("Packed object contains trailing data."));
+
+	return result;
+}
@@ -29,6 +29,8 @@ class String;
 class Value;
 
 String PackObject(const Value& value);
+Value UnpackObject(const String& packed);
+Value UnpackObject(const char *packed, size_t length);
 
 }
 
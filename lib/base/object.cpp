@@ -25,8 +25,9 @@
 #include "base/timer.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include "base/objectlock.hpp"
+#include "base/memoryusage.hpp"
 #include <boost/lexical_cast.hpp>
-#include <boost/thread/recursive_mutex.hpp>
 
 using namespace icinga;
 
@@ -38,13 +39,36 @@ static std::map<String, int> l_ObjectCounts;
 static Timer::Ptr l_ObjectCountTimer;
 #endif /* I2_LEAK_DEBUG */
 
+static std::atomic<uint32_t> l_NextConfinedScope{1};
+static thread_local uint32_t l_ConfinedScope = 0;
+
+ThreadConfinedScope::ThreadConfinedScope()
+	: m_Outermost(l_ConfinedScope == 0)
+{
+	if (m_Outermost) {
+		/* 0 means "not confined", skip it when the counter wraps around. */
+		do {
+			l_ConfinedScope = l_NextConfinedScope.fetch_add(1, std::memory_order_relaxed);
+		} while (l_ConfinedScope == 0);
+	}
+}
+
+ThreadConfinedScope::~ThreadConfinedScope()
+{
+	/* Scope IDs are only reused once the counter wraps around, so this turns all of the scope's objects into shared ones. */
+	if (m_Outermost)
+		l_ConfinedScope = 0;
+}
+
+Object::Object()
+	: m_ConfinedScope(l_ConfinedScope)
+{ }
+
 /**
  * Destructor for the Object class.
  */
 Object::~Object()
-{
-	delete reinterpret_cast<boost::recursive_mutex *>(m_Mutex);
-}
+{ }
 
 /**
  * Returns a string representation for the object.
@@ -62,15 +86,7 @@ String Object::ToString() const
  */
 bool Object::OwnsLock() const
 {
-#ifdef _WIN32
-	DWORD tid = InterlockedExchangeAdd(&m_LockOwner, 0);
-
-	return (tid == GetCurrentThreadId());
-#else /* _WIN32 */
-	pthread_t tid = __sync_fetch_and_add(&m_LockOwner, 0);
-
-	return (tid == pthread_self());
-#endif /* _WIN32 */
+	return m_LockOwner.load(std::memory_order_relaxed) == ObjectLock::GetThreadToken();
 }
 #endif /* I2_DEBUG */
 
@@ -90,6 +106,32 @@ Value Object::GetField(int id) const
 		BOOST_THROW_EXCEPTION(std::runtime_error("Invalid field ID."));
 }
 
+/**
+ * Calls the visitor for each field whose attributes match the attribute
+ * types (or for all fields if attributeTypes is 0), in the order of their
+ * field IDs. Generated classes read their fields directly instead of
+ * resolving each field ID through GetField().
+ *
+ * @param attributeTypes The field attributes, e.g. FAConfig | FAState.
+ * @param visitor The callback.
+ */
+void Object::VisitFields(int attributeTypes, const FieldVisitor& visitor) const
+{
+	Type::Ptr type = GetReflectionType();
+
+	if (!type)
+		return;
+
+	for (int i = 0; i < type->GetFieldCount(); i++) {
+		Field field = type->GetFieldInfo(i);
+
+		if (attributeTypes != 0 && (field.Attributes & attributeTypes) == 0)
+			continue;
+
+		visitor(field, GetField(i));
+	}
+}
+
 bool Object::HasOwnField(const String& field) const
 {
 	Type::Ptr type = GetReflectionType();
@@ -247,11 +289,34 @@ static void TypeInfoTimerHandler()
 INITIALIZE_ONCE([]() {
 	l_ObjectCountTimer = new Timer();
 	l_ObjectCountTimer->SetInterval(10);
+	l_ObjectCountTimer->SetSlack(1);
 	l_ObjectCountTimer->OnTimerExpired.connect(std::bind(TypeInfoTimerHandler));
 	l_ObjectCountTimer->Start();
 });
 #endif /* I2_LEAK_DEBUG */
 
+/**
+ * Returns the number of references to this object. The result is only
+ * meaningful when the caller holds one of those references and no other
+ * thread can obtain a new one, e.g. for objects which are private to the
+ * current thread.
+ *
+ * @returns The reference count.
+ */
+uintptr_t Object::GetReferenceCount() const
+{
+	return m_References;
+}
+
+/**
+ * Returns whether an object which was created in the specified scope may use
+ * non-atomic reference counting on the current thread.
+ */
+static inline bool IsCurrentConfinedScope(uint32_t scope)
+{
+	return scope != 0 && scope == l_ConfinedScope;
+}
+
 void icinga::intrusive_ptr_add_ref(Object *object)
 {
 #ifdef I2_LEAK_DEBUG
@@ -259,6 +324,14 @@ void icinga::intrusive_ptr_add_ref(Object *object)
 		TypeAddObject(object);
 #endif /* I2_LEAK_DEBUG */
 
+	if (unlikely(MemoryUsage::IsTypeAccountingEnabled()) && object->m_References == 0)
+		MemoryUsage::AddObject(object);
+
+	if (IsCurrentConfinedScope(object->m_ConfinedScope)) {
+		object->m_References++;
+		return;
+	}
+
 #ifdef _WIN32
 	InterlockedIncrement(&object->m_References);
 #else /* _WIN32 */
@@ -270,17 +343,24 @@ void icinga::intrusive_ptr_release(Object *object)
 {
 	uintptr_t refs;
 
+	if (IsCurrentConfinedScope(object->m_ConfinedScope))
+		refs = --object->m_References;
+	else {
 #ifdef _WIN32
-	refs = InterlockedDecrement(&object->m_References);
+		refs = InterlockedDecrement(&object->m_References);
 #else /* _WIN32 */
-	refs = __sync_sub_and_fetch(&object->m_References, 1);
+		refs = __sync_sub_and_fetch(&object->m_References, 1);
 #endif /* _WIN32 */
+	}
 
 	if (unlikely(refs == 0)) {
 #ifdef I2_LEAK_DEBUG
 		TypeRemoveObject(object);
 #endif /* I2_LEAK_DEBUG */
 
+		if (unlikely(MemoryUsage::IsTypeAccountingEnabled()))
+			MemoryUsage::RemoveObject(object);
+
 		delete object;
 	}
 }
@@ -23,7 +23,10 @@
 #include "base/i2-base.hpp"
 #include "base/debug.hpp"
 #include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
 using boost::intrusive_ptr;
@@ -38,10 +41,13 @@ class Object;
 class Type;
 class String;
 struct DebugInfo;
+struct Field;
 class ValidationUtils;
 
 extern Value Empty;
 
+typedef std::function<void (const Field& field, const Value& value)> FieldVisitor;
+
 #define DECLARE_PTR_TYPEDEFS(klass) \
 	typedef intrusive_ptr<klass> Ptr
 
@@ -160,6 +166,27 @@ private:
 	friend struct Lazy;
 };
 
+/**
+ * Objects which are created while a ThreadConfinedScope is active use
+ * non-atomic reference counting on the creating thread until the outermost
+ * scope ends. Afterwards they are ordinary objects again. Such objects must
+ * not be made available to other threads while the scope is active.
+ *
+ * @ingroup base
+ */
+class ThreadConfinedScope
+{
+public:
+	ThreadConfinedScope();
+	~ThreadConfinedScope();
+
+private:
+	ThreadConfinedScope(const ThreadConfinedScope& other) = delete;
+	ThreadConfinedScope& operator=(const ThreadConfinedScope& rhs) = delete;
+
+	bool m_Outermost;
+};
+
 /**
  * Base class for all heap-allocated objects. At least one of its methods
  * has to be virtual for RTTI to work.
@@ -171,7 +198,7 @@ class Object
 public:
 	DECLARE_PTR_TYPEDEFS(Object);
 
-	Object() = default;
+	Object();
 	virtual ~Object();
 
 	virtual String ToString() const;
@@ -189,6 +216,7 @@ public:
 	virtual void ValidateField(int id, const Lazy<Value>& lvalue, const ValidationUtils& utils);
 	virtual void NotifyField(int id, const Value& cookie = Empty);
 	virtual Object::Ptr NavigateField(int id) const;
+	virtual void VisitFields(int attributeTypes, const FieldVisitor& visitor) const;
 
 #ifdef I2_DEBUG
 	bool OwnsLock() const;
@@ -198,6 +226,8 @@ public:
 
 	virtual Object::Ptr Clone() const;
 
+	uintptr_t GetReferenceCount() const;
+
 	static intrusive_ptr<Type> TypeInstance;
 
 private:
@@ -205,16 +235,14 @@ private:
 	Object& operator=(const Object& rhs) = delete;
 
 	uintptr_t m_References{0};
-	mutable uintptr_t m_Mutex{0};
 
-#ifdef I2_DEBUG
-#	ifndef _WIN32
-	mutable pthread_t m_LockOwner;
-#	else /* _WIN32 */
-	mutable DWORD m_LockOwner;
-#	endif /* _WIN32 */
-	mutable size_t m_LockCount = 0;
-#endif /* I2_DEBUG */
+	/* See ObjectLock for how these are used. They're 32 bits each so that
+	 * they fit into 16 bytes together with the scope. */
+	mutable std::atomic<uint32_t> m_LockWord{0};
+	mutable std::atomic<uint32_t> m_LockOwner{0};
+	mutable uint32_t m_LockDepth{0};
+
+	uint32_t m_ConfinedScope;
 
 	friend struct ObjectLock;
 
@@ -18,12 +18,86 @@
  ******************************************************************************/
 
 #include "base/objectlock.hpp"
-#include <boost/thread/recursive_mutex.hpp>
+#include <algorithm>
+#include <thread>
+#ifdef __linux__
+#	include <linux/futex.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#else /* __linux__ */
+#	include <boost/thread/mutex.hpp>
+#	include <boost/thread/condition_variable.hpp>
+#endif /* __linux__ */
 
 using namespace icinga;
 
-#define I2MUTEX_UNLOCKED 0
-#define I2MUTEX_LOCKED 1
+#if defined(__i386__) || defined(__x86_64__)
+#	define SPIN_PAUSE() __builtin_ia32_pause()
+#elif defined(_MSC_VER)
+#	define SPIN_PAUSE() YieldProcessor()
+#endif
+
+enum LockState : uint32_t
+{
+	LockUnlocked = 0,
+	LockLocked = 1,
+	LockContended = 2
+};
+
+/* How often a thread tries to get a lock before it goes to sleep. */
+static const unsigned int l_MaxSpins = 100;
+
+static std::atomic<uint32_t> l_NextThreadToken{1};
+static thread_local uint32_t l_ThreadToken = 0;
+
+#ifndef __linux__
+/**
+ * Threads which wait for an object lock sleep on one of these, depending on
+ * the address of the lock word.
+ */
+struct LockWaitBucket
+{
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+};
+
+static LockWaitBucket& GetLockWaitBucket(const std::atomic<uint32_t>& word)
+{
+	static LockWaitBucket buckets[64];
+
+	return buckets[(reinterpret_cast<uintptr_t>(&word) / sizeof(word)) % 64];
+}
+#endif /* __linux__ */
+
+/**
+ * Sleeps until the lock word was changed from LockContended by WakeLockWord().
+ * This may return spuriously.
+ */
+static void WaitLockWord(std::atomic<uint32_t>& word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, LockContended, nullptr, nullptr, 0);
+#else /* __linux__ */
+	LockWaitBucket& bucket = GetLockWaitBucket(word);
+	boost::mutex::scoped_lock lock(bucket.Mutex);
+
+	if (word.load() == LockContended)
+		bucket.CV.wait(lock);
+#endif /* __linux__ */
+}
+
+static void WakeLockWord(std::atomic<uint32_t>& word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else /* __linux__ */
+	LockWaitBucket& bucket = GetLockWaitBucket(word);
+	boost::mutex::scoped_lock lock(bucket.Mutex);
+
+	/* Other locks may share the bucket, so every waiter has to check its lock word again. */
+	bucket.CV.notify_all();
+#endif /* __linux__ */
+}
 
 ObjectLock::~ObjectLock()
 {
@@ -44,41 +118,65 @@ ObjectLock::ObjectLock(const Object *object)
 		Lock();
 }
 
+/**
+ * Returns a value which identifies the calling thread and is never 0.
+ */
+uint32_t ObjectLock::GetThreadToken()
+{
+	if (unlikely(l_ThreadToken == 0))
+		l_ThreadToken = l_NextThreadToken.fetch_add(1, std::memory_order_relaxed);
+
+	return l_ThreadToken;
+}
+
 void ObjectLock::LockMutex(const Object *object)
 {
-	unsigned int it = 0;
-
-#ifdef _WIN32
-#	ifdef _WIN64
-	while (likely(InterlockedCompareExchange64((LONGLONG *)&object->m_Mutex, I2MUTEX_LOCKED, I2MUTEX_UNLOCKED) != I2MUTEX_UNLOCKED)) {
-#	else /* _WIN64 */
-	while (likely(InterlockedCompareExchange(&object->m_Mutex, I2MUTEX_LOCKED, I2MUTEX_UNLOCKED) != I2MUTEX_UNLOCKED)) {
-#	endif /* _WIN64 */
-#else /* _WIN32 */
-	while (likely(!__sync_bool_compare_and_swap(&object->m_Mutex, I2MUTEX_UNLOCKED, I2MUTEX_LOCKED))) {
-#endif /* _WIN32 */
-		if (likely(object->m_Mutex > I2MUTEX_LOCKED)) {
-			auto *mtx = reinterpret_cast<boost::recursive_mutex *>(object->m_Mutex);
-			mtx->lock();
-
-			return;
+	uint32_t self = GetThreadToken();
+
+	if (object->m_LockOwner.load(std::memory_order_relaxed) == self) {
+		object->m_LockDepth++;
+		return;
+	}
+
+	uint32_t state = LockUnlocked;
+
+	if (unlikely(!object->m_LockWord.compare_exchange_strong(state, LockLocked, std::memory_order_acquire))) {
+		static const bool multiCore = std::thread::hardware_concurrency() > 1;
+
+		/* As long as nobody waits for the lock the owner is likely to release it soon. */
+		for (unsigned int it = 0; multiCore && state == LockLocked && it < l_MaxSpins; it++) {
+			Spin(it);
+
+			state = LockUnlocked;
+
+			if (object->m_LockWord.compare_exchange_weak(state, LockLocked, std::memory_order_acquire))
+				break;
 		}
 
-		Spin(it);
-		it++;
+		if (state != LockUnlocked) {
+			if (state != LockContended)
+				state = object->m_LockWord.exchange(LockContended, std::memory_order_acquire);
+
+			while (state != LockUnlocked) {
+				WaitLockWord(object->m_LockWord);
+				state = object->m_LockWord.exchange(LockContended, std::memory_order_acquire);
+			}
+		}
 	}
 
-	auto *mtx = new boost::recursive_mutex();
-	mtx->lock();
-#ifdef _WIN32
-#	ifdef _WIN64
-	InterlockedCompareExchange64((LONGLONG *)&object->m_Mutex, reinterpret_cast<LONGLONG>(mtx), I2MUTEX_LOCKED);
-#	else /* _WIN64 */
-	InterlockedCompareExchange(&object->m_Mutex, reinterpret_cast<LONG>(mtx), I2MUTEX_LOCKED);
-#	endif /* _WIN64 */
-#else /* _WIN32 */
-	__sync_bool_compare_and_swap(&object->m_Mutex, I2MUTEX_LOCKED, reinterpret_cast<uintptr_t>(mtx));
-#endif /* _WIN32 */
+	object->m_LockOwner.store(self, std::memory_order_relaxed);
+	object->m_LockDepth = 1;
+}
+
+void ObjectLock::UnlockMutex(const Object *object)
+{
+	if (--object->m_LockDepth > 0)
+		return;
+
+	object->m_LockOwner.store(0, std::memory_order_relaxed);
+
+	if (object->m_LockWord.exchange(LockUnlocked, std::memory_order_release) == LockContended)
+		WakeLockWord(object->m_LockWord);
 }
 
 void ObjectLock::Lock()
@@ -88,51 +186,21 @@ void ObjectLock::Lock()
 	LockMutex(m_Object);
 
 	m_Locked = true;
-
-#ifdef I2_DEBUG
-	if (++m_Object->m_LockCount == 1u) {
-#	ifdef _WIN32
-		InterlockedExchange(&m_Object->m_LockOwner, GetCurrentThreadId());
-#	else /* _WIN32 */
-		__sync_lock_test_and_set(&m_Object->m_LockOwner, pthread_self());
-#	endif /* _WIN32 */
-	}
-#endif /* I2_DEBUG */
 }
 
 void ObjectLock::Spin(unsigned int it)
 {
-	if (it < 8) {
-		/* Do nothing. */
-	}
 #ifdef SPIN_PAUSE
-	else if (it < 16) {
+	/* Back off a little more each time. */
+	for (unsigned int i = 0; i < std::min(it + 1, 16u); i++)
 		SPIN_PAUSE();
-	}
 #endif /* SPIN_PAUSE */
-	else {
-#ifdef _WIN32
-		Sleep(0);
-#else /* _WIN32 */
-		sched_yield();
-#endif /* _WIN32 */
-	}
 }
 
 void ObjectLock::Unlock()
 {
-#ifdef I2_DEBUG
-	if (m_Locked && !--m_Object->m_LockCount) {
-#	ifdef _WIN32
-		InterlockedExchange(&m_Object->m_LockOwner, 0);
-#	else /* _WIN32 */
-		__sync_lock_release(&m_Object->m_LockOwner);
-#	endif /* _WIN32 */
-	}
-#endif /* I2_DEBUG */
-
 	if (m_Locked) {
-		reinterpret_cast<boost::recursive_mutex *>(m_Object->m_Mutex)->unlock();
+		UnlockMutex(m_Object);
 		m_Locked = false;
 	}
 }
@@ -27,6 +27,12 @@ namespace icinga
 
 /**
  * A scoped lock for Objects.
+ *
+ * The lock is recursive and lives inside the object: a 32-bit lock word
+ * (unlocked, locked or locked with waiters), the owning thread and the
+ * recursion depth. Threads which don't get the lock spin briefly as long
+ * as nobody else waits for it, then they sleep on the lock word (a futex on
+ * Linux, a small table of condition variables elsewhere).
  */
 struct ObjectLock
 {
@@ -37,6 +43,7 @@ public:
 	~ObjectLock();
 
 	static void LockMutex(const Object *object);
+	static void UnlockMutex(const Object *object);
 
 	void Lock();
 
@@ -44,6 +51,8 @@ public:
 
 	void Unlock();
 
+	static uint32_t GetThreadToken();
+
 private:
 	const Object *m_Object{nullptr};
 	bool m_Locked{false};
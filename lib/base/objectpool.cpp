@@ -0,0 +1,116 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/objectpool.hpp"
+#include <new>
+
+using namespace icinga;
+
+static const size_t l_PoolGranularity = 16;
+static const size_t l_PoolClasses = ObjectPool::MaxBlockSize / l_PoolGranularity;
+
+/* How many bytes each thread keeps around at most per size class. */
+static const size_t l_PoolClassLimit = 128 * 1024;
+
+struct PoolBlock
+{
+	PoolBlock *Next;
+};
+
+struct PoolFreeList
+{
+	PoolBlock *Head{nullptr};
+	size_t Count{0};
+};
+
+struct ThreadPool
+{
+	PoolFreeList Lists[l_PoolClasses];
+
+	~ThreadPool();
+};
+
+/* Blocks which are freed while (or after) a thread's pool is destroyed go straight back to the heap. */
+static thread_local bool l_ThreadPoolDestroyed = false;
+static thread_local ThreadPool l_ThreadPool;
+
+ThreadPool::~ThreadPool()
+{
+	l_ThreadPoolDestroyed = true;
+
+	for (PoolFreeList& list : Lists) {
+		while (list.Head) {
+			PoolBlock *block = list.Head;
+			list.Head = block->Next;
+			::operator delete(block);
+		}
+	}
+}
+
+static inline size_t GetSizeClass(size_t size)
+{
+	return (size + l_PoolGranularity - 1) / l_PoolGranularity - 1;
+}
+
+void *ObjectPool::Allocate(size_t size)
+{
+	if (size == 0 || size > MaxBlockSize)
+		return ::operator new(size);
+
+	size_t sizeClass = GetSizeClass(size);
+
+	if (!l_ThreadPoolDestroyed) {
+		PoolFreeList& list = l_ThreadPool.Lists[sizeClass];
+
+		if (list.Head) {
+			PoolBlock *block = list.Head;
+			list.Head = block->Next;
+			list.Count--;
+
+			return block;
+		}
+	}
+
+	/* The block may be freed by another thread and end up in its free list. */
+	return ::operator new((sizeClass + 1) * l_PoolGranularity);
+}
+
+void ObjectPool::Free(void *ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	if (size == 0 || size > MaxBlockSize || l_ThreadPoolDestroyed) {
+		::operator delete(ptr);
+		return;
+	}
+
+	size_t sizeClass = GetSizeClass(size);
+	PoolFreeList& list = l_ThreadPool.Lists[sizeClass];
+
+	if (list.Count >= l_PoolClassLimit / ((sizeClass + 1) * l_PoolGranularity)) {
+		::operator delete(ptr);
+		return;
+	}
+
+	auto *block = static_cast<PoolBlock *>(ptr);
+	block->Next = list.Head;
+	list.Head = block;
+	list.Count++;
+}
@@ -23,6 +23,8 @@
 #include "base/exception.hpp"
 #include "base/logger.hpp"
 #include "base/function.hpp"
+#include <algorithm>
+#include <cstring>
 
 using namespace icinga;
 
@@ -43,6 +45,121 @@ PerfdataValue::PerfdataValue(const String& label, double value, bool counter,
 	SetMax(max, true);
 }
 
+/**
+ * Parses a plain decimal number without going through a stream. Only handles
+ * values which can be converted exactly (i.e. at most 19 significant digits
+ * and a small decimal exponent), returns false for everything else.
+ */
+static bool ParseNumberFast(const char *begin, const char *end, double *result)
+{
+	static const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char *p = begin;
+	bool negative = false;
+
+	if (p != end && (*p == '+' || *p == '-')) {
+		negative = (*p == '-');
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool seenDigit = false;
+
+	for (; p != end && *p >= '0' && *p <= '9'; p++) {
+		seenDigit = true;
+
+		if (mantissa == 0 && *p == '0')
+			continue;
+
+		if (++digits > 19)
+			return false;
+
+		mantissa = mantissa * 10 + (*p - '0');
+	}
+
+	if (p != end && *p == '.') {
+		p++;
+
+		for (; p != end && *p >= '0' && *p <= '9'; p++) {
+			seenDigit = true;
+			exponent--;
+
+			if (mantissa == 0 && *p == '0')
+				continue;
+
+			if (++digits > 19)
+				return false;
+
+			mantissa = mantissa * 10 + (*p - '0');
+		}
+	}
+
+	if (!seenDigit)
+		return false;
+
+	if (p != end && *p == 'e') {
+		p++;
+
+		bool negativeExp = false;
+
+		if (p != end && (*p == '+' || *p == '-')) {
+			negativeExp = (*p == '-');
+			p++;
+		}
+
+		if (p == end)
+			return false;
+
+		int exp = 0;
+
+		for (; p != end && *p >= '0' && *p <= '9'; p++) {
+			if (exp > 1000)
+				return false;
+
+			exp = exp * 10 + (*p - '0');
+		}
+
+		exponent += negativeExp ? -exp : exp;
+	}
+
+	if (p != end)
+		return false;
+
+	/* Both the mantissa and the power of ten are exact doubles, so a single
+	 * multiplication or division yields the correctly rounded result. */
+	if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22)
+		return false;
+
+	double value = static_cast<double>(mantissa);
+
+	if (exponent < 0)
+		value /= powersOf10[-exponent];
+	else
+		value *= powersOf10[exponent];
+
+	*result = negative ? -value : value;
+	return true;
+}
+
+static double ParseNumber(const char *begin, const char *end)
+{
+	double value;
+
+	if (ParseNumberFast(begin, end, &value))
+		return value;
+
+	return Convert::ToDouble(std::string(begin, end));
+}
+
+static bool IsNumberChar(char ch)
+{
+	return (ch >= '0' && ch <= '9') || ch == '+' || ch == '-' || ch == '.' || ch == 'e';
+}
+
 PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 {
 	size_t eqp = perfdata.FindLastOf('=');
@@ -50,30 +167,54 @@ PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 	if (eqp == String::NPos)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data value: " + perfdata));
 
-	String label = perfdata.SubStr(0, eqp);
+	const char *data = perfdata.CStr();
+
+	size_t labelBegin = 0, labelEnd = eqp;
+
+	if (eqp > 2 && data[0] == '\'' && data[eqp - 1] == '\'') {
+		labelBegin++;
+		labelEnd--;
+	}
 
-	if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
-		label = label.SubStr(1, label.GetLength() - 2);
+	String label(data + labelBegin, data + labelEnd);
 
 	size_t spq = perfdata.FindFirstOf(' ', eqp);
 
 	if (spq == String::NPos)
 		spq = perfdata.GetLength();
 
-	String valueStr = perfdata.SubStr(eqp + 1, spq - eqp - 1);
+	const char *valueBegin = data + eqp + 1;
+	const char *valueEnd = data + spq;
 
-	size_t pos = valueStr.FindFirstNotOf("+-0123456789.e");
+	/* Split the value into its ';' separated tokens without copying them. */
+	const char *tokenBegin[5], *tokenEnd[5];
+	int tokenCount = 0;
 
-	double value = Convert::ToDouble(valueStr.SubStr(0, pos));
+	for (const char *p = valueBegin; tokenCount < 5; p++) {
+		const char *next = static_cast<const char *>(memchr(p, ';', valueEnd - p));
 
-	std::vector<String> tokens = valueStr.Split(";");
+		if (!next)
+			next = valueEnd;
 
-	bool counter = false;
-	String unit;
-	Value warn, crit, min, max;
+		tokenBegin[tokenCount] = p;
+		tokenEnd[tokenCount] = next;
+		tokenCount++;
+
+		if (next == valueEnd)
+			break;
+
+		p = next;
+	}
+
+	const char *numberEnd = tokenBegin[0];
+
+	while (numberEnd != tokenEnd[0] && IsNumberChar(*numberEnd))
+		numberEnd++;
 
-	if (pos != String::NPos)
-		unit = valueStr.SubStr(pos, tokens[0].GetLength() - pos);
+	double value = ParseNumber(tokenBegin[0], numberEnd);
+
+	bool counter = false;
+	String unit(numberEnd, tokenEnd[0]);
 
 	unit = unit.ToLower();
 
@@ -110,10 +251,16 @@ PerfdataValue::Ptr PerfdataValue::Parse(const String& perfdata)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid performance data unit: " + unit));
 	}
 
-	warn = ParseWarnCritMinMaxToken(tokens, 1, "warning");
-	crit = ParseWarnCritMinMaxToken(tokens, 2, "critical");
-	min = ParseWarnCritMinMaxToken(tokens, 3, "minimum");
-	max = ParseWarnCritMinMaxToken(tokens, 4, "maximum");
+	Value warn, crit, min, max;
+
+	if (tokenCount > 1)
+		warn = ParseWarnCritMinMaxToken(tokenBegin[1], tokenEnd[1], "warning");
+	if (tokenCount > 2)
+		crit = ParseWarnCritMinMaxToken(tokenBegin[2], tokenEnd[2], "critical");
+	if (tokenCount > 3)
+		min = ParseWarnCritMinMaxToken(tokenBegin[3], tokenEnd[3], "minimum");
+	if (tokenCount > 4)
+		max = ParseWarnCritMinMaxToken(tokenBegin[4], tokenEnd[4], "maximum");
 
 	value = value * base;
 
@@ -175,14 +322,15 @@ String PerfdataValue::Format() const
 	return result.str();
 }
 
-Value PerfdataValue::ParseWarnCritMinMaxToken(const std::vector<String>& tokens, std::vector<String>::size_type index, const String& description)
+Value PerfdataValue::ParseWarnCritMinMaxToken(const char *begin, const char *end, const String& description)
 {
-	if (tokens.size() > index && tokens[index] != "U" && tokens[index] != "" && tokens[index].FindFirstNotOf("+-0123456789.e") == String::NPos)
-		return Convert::ToDouble(tokens[index]);
-	else {
-		if (tokens.size() > index && tokens[index] != "")
-			Log(LogDebug, "PerfdataValue")
-				<< "Ignoring unsupported perfdata " << description << " range, value: '" << tokens[index] << "'.";
+	if (begin == end)
 		return Empty;
-	}
+
+	if (!(end - begin == 1 && *begin == 'U') && std::all_of(begin, end, IsNumberChar))
+		return ParseNumber(begin, end);
+
+	Log(LogDebug, "PerfdataValue")
+		<< "Ignoring unsupported perfdata " << description << " range, value: '" << std::string(begin, end) << "'.";
+	return Empty;
 }
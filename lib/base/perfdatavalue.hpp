@@ -21,6 +21,7 @@
 #define PERFDATAVALUE_H
 
 #include "base/i2-base.hpp"
+#include "base/objectpool.hpp"
 #include "base/perfdatavalue-ti.hpp"
 
 namespace icinga
@@ -35,6 +36,7 @@ class PerfdataValue final : public ObjectImpl<PerfdataValue>
 {
 public:
 	DECLARE_OBJECT(PerfdataValue);
+	DECLARE_POOLED_ALLOCATOR();
 
 	PerfdataValue() = default;
 
@@ -46,8 +48,7 @@ public:
 	String Format() const;
 
 private:
-	static Value ParseWarnCritMinMaxToken(const std::vector<String>& tokens,
-		std::vector<String>::size_type index, const String& description);
+	static Value ParseWarnCritMinMaxToken(const char *begin, const char *end, const String& description);
 };
 
 }
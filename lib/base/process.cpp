@@ -28,10 +28,16 @@
 #include "base/utility.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/json.hpp"
+#include "base/socketevents.hpp"
+#include "base/application.hpp"
+#include "base/latencyhistogram.hpp"
 #include <boost/algorithm/string/join.hpp>
 #include <boost/thread/once.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <thread>
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
 
 #ifndef _WIN32
 #	include <execvpe.h>
@@ -50,21 +56,59 @@ using namespace icinga;
 
 #define IOTHREADS 4
 
+#ifndef _WIN32
+namespace icinga
+{
+
+/**
+ * Forwards socket events for a process' output pipe.
+ *
+ * @ingroup base
+ */
+class ProcessOutputEvents final : public SocketEvents
+{
+public:
+	ProcessOutputEvents(Process *process)
+		: SocketEvents(process->m_OutputSocket, process), m_Process(process)
+	{ }
+
+	void OnEvent(int) override
+	{
+		m_Process->OnOutputEvent();
+	}
+
+private:
+	Process *m_Process;
+};
+
+}
+#endif /* _WIN32 */
+
 static boost::mutex l_ProcessMutex[IOTHREADS];
 static std::map<Process::ProcessHandle, Process::Ptr> l_Processes[IOTHREADS];
 #ifdef _WIN32
 static HANDLE l_Events[IOTHREADS];
 #else /* _WIN32 */
-static int l_EventFDs[IOTHREADS][2];
-static std::map<Process::ConsoleHandle, Process::ProcessHandle> l_FDs[IOTHREADS];
+static boost::condition_variable l_ProcessCV[IOTHREADS];
+static std::multimap<double, Process::Ptr> l_ProcessDeadlines[IOTHREADS];
+static std::deque<Process::Ptr> l_FinishedProcesses[IOTHREADS];
 
 static boost::mutex l_ProcessControlMutex;
 static int l_ProcessControlFD = -1;
 static pid_t l_ProcessControlPID;
 #endif /* _WIN32 */
 static boost::once_flag l_ProcessOnceFlag = BOOST_ONCE_INIT;
+
+/* Latency samples for the most recent process spawns, see GetSpawnLatencyPercentiles(). */
+static const size_t l_SpawnLatencySamples = 1024;
+static boost::mutex l_SpawnLatencyMutex;
+static std::vector<double> l_SpawnLatencies;
+static size_t l_SpawnLatencyIndex = 0;
 static boost::once_flag l_SpawnHelperOnceFlag = BOOST_ONCE_INIT;
 
+/* Time from spawning a process until it has exited and its output was read. */
+static LatencyHistogram l_ProcessRuntime("process_runtime");
+
 Process::Process(Process::Arguments arguments, Dictionary::Ptr extraEnvironment)
 	: m_Arguments(std::move(arguments)), m_ExtraEnvironment(std::move(extraEnvironment)), m_Timeout(600), m_AdjustPriority(false)
 #ifdef _WIN32
@@ -84,60 +128,131 @@ Process::~Process()
 }
 
 #ifndef _WIN32
-static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& request)
+/* Spawn requests use a compact binary encoding instead of JSON:
+ *
+ * 'S', adjustPriority (1 byte), argc (uint32_t), envc (uint32_t),
+ * followed by argc arguments and envc "key=value" strings, each of which
+ * is terminated by a NUL byte.
+ */
+static const char l_SpawnRequestTag = 'S';
+
+struct ProcessSpawnResponse
 {
+	pid_t rc;
+	int error;
+};
+
+/**
+ * The environment which child processes inherit from the spawn helper. The
+ * helper's environment doesn't change after it was started, so this is only
+ * built once; spawn requests just carry the variables from the command's
+ * env attribute.
+ */
+struct BaseEnvironment
+{
+	std::vector<char *> Strings;
+	std::unordered_map<std::string, size_t> Index;
+};
+
+static std::string GetEnvironmentName(const char *str)
+{
+	const char *eqp = strchr(str, '=');
+
+	return eqp ? std::string(str, eqp) : std::string(str);
+}
+
+static BaseEnvironment BuildBaseEnvironment()
+{
+	BaseEnvironment env;
+
+	for (int i = 0; environ[i]; i++)
+		env.Strings.push_back(environ[i]);
+
+	static char lcNumeric[] = "LC_NUMERIC=C";
+	env.Strings.push_back(lcNumeric);
+
+	/* getenv() returns the first match, so that's the one which is replaced. */
+	for (size_t i = 0; i < env.Strings.size(); i++)
+		env.Index.emplace(GetEnvironmentName(env.Strings[i]), i);
+
+	return env;
+}
+
+static ProcessSpawnResponse ProcessSpawnImpl(struct msghdr *msgh, const char *request, size_t length)
+{
+	ProcessSpawnResponse response = { -1, EINVAL };
+
 	struct cmsghdr *cmsg = CMSG_FIRSTHDR(msgh);
 
 	if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 3)) {
 		std::cerr << "Invalid 'spawn' request: FDs missing" << std::endl;
-		return Empty;
+		return response;
 	}
 
 	auto *fds = (int *)CMSG_DATA(cmsg);
 
-	Array::Ptr arguments = request->Get("arguments");
-	Dictionary::Ptr extraEnvironment = request->Get("extraEnvironment");
-	bool adjustPriority = request->Get("adjustPriority");
-
-	// build argv
-	auto **argv = new char *[arguments->GetLength() + 1];
+	uint32_t argc, envc;
+	size_t offset = 2 + sizeof(argc) + sizeof(envc);
 
-	for (unsigned int i = 0; i < arguments->GetLength(); i++) {
-		String arg = arguments->Get(i);
-		argv[i] = strdup(arg.CStr());
+	if (length < offset) {
+		std::cerr << "Invalid 'spawn' request: Header missing" << std::endl;
+		return response;
 	}
 
-	argv[arguments->GetLength()] = nullptr;
+	bool adjustPriority = request[1];
+	memcpy(&argc, request + 2, sizeof(argc));
+	memcpy(&envc, request + 2 + sizeof(argc), sizeof(envc));
 
-	// build envp
-	int envc = 0;
-
-	/* count existing environment variables */
-	while (environ[envc])
-		envc++;
+	/* The strings are used in-place, the request already contains the NUL bytes. */
+	std::vector<char *> strings;
+	strings.reserve(argc + envc);
 
-	auto **envp = new char *[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0) + 2];
+	while (offset < length && strings.size() < argc + envc) {
+		auto *str = const_cast<char *>(request + offset);
+		auto *end = static_cast<const char *>(memchr(str, '\0', length - offset));
 
-	for (int i = 0; i < envc; i++)
-		envp[i] = strdup(environ[i]);
+		if (!end)
+			break;
 
-	if (extraEnvironment) {
-		ObjectLock olock(extraEnvironment);
+		strings.push_back(str);
+		offset = end - request + 1;
+	}
 
-		int index = envc;
-		for (const Dictionary::Pair& kv : extraEnvironment) {
-			String skv = kv.first + "=" + Convert::ToString(kv.second);
-			envp[index] = strdup(skv.CStr());
-			index++;
-		}
+	if (argc == 0 || strings.size() != argc + envc) {
+		std::cerr << "Invalid 'spawn' request: Arguments missing" << std::endl;
+		return response;
 	}
 
-	envp[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0)] = strdup("LC_NUMERIC=C");
-	envp[envc + (extraEnvironment ? extraEnvironment->GetLength() : 0) + 1] = nullptr;
+	// build argv
+	std::vector<char *> argv(strings.begin(), strings.begin() + argc);
+	argv.push_back(nullptr);
+
+	// build envp
+	static const BaseEnvironment baseEnv = BuildBaseEnvironment();
+
+	std::vector<char *> envp;
+	envp.reserve(baseEnv.Strings.size() + envc + 1);
+	envp = baseEnv.Strings;
 
-	extraEnvironment.reset();
+	/* Variables from the request replace inherited ones, just like on Windows. */
+	for (auto it = strings.begin() + argc; it != strings.end(); it++) {
+		auto pos = baseEnv.Index.find(GetEnvironmentName(*it));
 
+		if (pos != baseEnv.Index.end())
+			envp[pos->second] = *it;
+		else
+			envp.push_back(*it);
+	}
+
+	envp.push_back(nullptr);
+
+	/* The helper is single-threaded and the child only calls exec() or _exit()
+	 * after the setup below, so vfork() can be used to avoid copying the page tables. */
+#ifdef HAVE_VFORK
+	pid_t pid = vfork();
+#else /* HAVE_VFORK */
 	pid_t pid = fork();
+#endif /* HAVE_VFORK */
 
 	int errorCode = 0;
 
@@ -172,7 +287,7 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 		sigemptyset(&mask);
 		sigprocmask(SIG_SETMASK, &mask, nullptr);
 
-		if (icinga2_execvpe(argv[0], argv, envp) < 0) {
+		if (icinga2_execvpe(argv[0], argv.data(), envp.data()) < 0) {
 			char errmsg[512];
 			strcpy(errmsg, "execvpe(");
 			strncat(errmsg, argv[0], sizeof(errmsg) - strlen(errmsg) - 1);
@@ -189,22 +304,8 @@ static Value ProcessSpawnImpl(struct msghdr *msgh, const Dictionary::Ptr& reques
 	(void)close(fds[1]);
 	(void)close(fds[2]);
 
-	// free arguments
-	for (int i = 0; argv[i]; i++)
-		free(argv[i]);
-
-	delete[] argv;
-
-	// free environment
-	for (int i = 0; envp[i]; i++)
-		free(envp[i]);
-
-	delete[] envp;
-
-	Dictionary::Ptr response = new Dictionary({
-		{ "rc", pid },
-		{ "errno", errorCode }
-	});
+	response.rc = pid;
+	response.error = errorCode;
 
 	return response;
 }
@@ -305,6 +406,20 @@ static void ProcessHandler()
 				break;
 		}
 
+		if (count > 0 && mbuf[0] == l_SpawnRequestTag) {
+			ProcessSpawnResponse response = ProcessSpawnImpl(&msg, mbuf, count);
+
+			delete [] mbuf;
+
+			if (send(l_ProcessControlFD, &response, sizeof(response), 0) < 0) {
+				BOOST_THROW_EXCEPTION(posix_error()
+					<< boost::errinfo_api_function("send")
+					<< boost::errinfo_errno(errno));
+			}
+
+			continue;
+		}
+
 		String jrequest = String(mbuf, mbuf + count);
 
 		delete [] mbuf;
@@ -315,9 +430,7 @@ static void ProcessHandler()
 
 		Value response;
 
-		if (command == "spawn")
-			response = ProcessSpawnImpl(&msg, request);
-		else if (command == "waitpid")
+		if (command == "waitpid")
 			response = ProcessWaitPIDImpl(&msg, request);
 		else if (command == "kill")
 			response = ProcessKillImpl(&msg, request);
@@ -378,15 +491,39 @@ static void StartSpawnProcessHelper()
 
 static pid_t ProcessSpawn(const std::vector<String>& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3])
 {
-	Dictionary::Ptr request = new Dictionary({
-		{ "command", "spawn" },
-		{ "arguments", Array::FromVector(arguments) },
-		{ "extraEnvironment", extraEnvironment },
-		{ "adjustPriority", adjustPriority }
-	});
+	uint32_t argc = arguments.size();
+	uint32_t envc = extraEnvironment ? extraEnvironment->GetLength() : 0;
 
-	String jrequest = JsonEncode(request);
-	size_t length = jrequest.GetLength();
+	size_t argLength = 0;
+
+	for (const String& arg : arguments) {
+		argLength += arg.GetLength() + 1;
+	}
+
+	std::string request;
+	request.reserve(2 + sizeof(argc) + sizeof(envc) + argLength + envc * 64);
+	request += l_SpawnRequestTag;
+	request += static_cast<char>(adjustPriority);
+	request.append(reinterpret_cast<const char *>(&argc), sizeof(argc));
+	request.append(reinterpret_cast<const char *>(&envc), sizeof(envc));
+
+	for (const String& arg : arguments) {
+		request.append(arg.CStr(), arg.GetLength() + 1);
+	}
+
+	if (extraEnvironment) {
+		ObjectLock olock(extraEnvironment);
+
+		for (const Dictionary::Pair& kv : extraEnvironment) {
+			request.append(kv.first.CStr(), kv.first.GetLength());
+			request += '=';
+
+			String value = Convert::ToString(kv.second);
+			request.append(value.CStr(), value.GetLength() + 1);
+		}
+	}
+
+	size_t length = request.size();
 
 	boost::mutex::scoped_lock lock(l_ProcessControlMutex);
 
@@ -417,24 +554,20 @@ send_message:
 	while (sendmsg(l_ProcessControlFD, &msg, 0) < 0)
 		StartSpawnProcessHelper();
 
-	if (send(l_ProcessControlFD, jrequest.CStr(), jrequest.GetLength(), 0) < 0)
+	if (send(l_ProcessControlFD, request.c_str(), request.size(), 0) < 0)
 		goto send_message;
 
-	char buf[4096];
+	ProcessSpawnResponse response;
 
-	ssize_t rc = recv(l_ProcessControlFD, buf, sizeof(buf), 0);
+	ssize_t rc = recv(l_ProcessControlFD, &response, sizeof(response), MSG_WAITALL);
 
-	if (rc <= 0)
+	if (rc != sizeof(response))
 		return -1;
 
-	String jresponse = String(buf, buf + rc);
-
-	Dictionary::Ptr response = JsonDecode(jresponse);
-
-	if (response->Get("rc") == -1)
-		errno = response->Get("errno");
+	if (response.rc == -1)
+		errno = response.error;
 
-	return response->Get("rc");
+	return response.rc;
 }
 
 static int ProcessKill(pid_t pid, int signum)
@@ -508,41 +641,45 @@ void Process::InitializeSpawnHelper()
 	if (l_ProcessControlFD == -1)
 		StartSpawnProcessHelper();
 }
+
+/**
+ * Spawns a process using the spawn helper. Unlike Run() the caller is
+ * responsible for the process' file descriptors and for reaping it.
+ *
+ * @param arguments The arguments.
+ * @param extraEnvironment Additional environment variables.
+ * @param adjustPriority Whether to lower the process' priority.
+ * @param fds The file descriptors for stdin, stdout and stderr.
+ * @returns The PID or -1 if the process couldn't be spawned (errno is set).
+ */
+pid_t Process::Spawn(const Arguments& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3])
+{
+	boost::call_once(l_SpawnHelperOnceFlag, &Process::InitializeSpawnHelper);
+
+	return ProcessSpawn(arguments, extraEnvironment, adjustPriority, fds);
+}
+
+int Process::Kill(pid_t pid, int signum)
+{
+	return ProcessKill(pid, signum);
+}
+
+int Process::WaitPID(pid_t pid, int *status)
+{
+	return ProcessWaitPID(pid, status);
+}
 #endif /* _WIN32 */
 
+#ifdef _WIN32
 static void InitializeProcess()
 {
-#ifdef _WIN32
 	for (auto& event : l_Events) {
 		event = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 	}
-#else /* _WIN32 */
-	for (auto& eventFD : l_EventFDs) {
-#	ifdef HAVE_PIPE2
-		if (pipe2(eventFD, O_CLOEXEC) < 0) {
-			if (errno == ENOSYS) {
-#	endif /* HAVE_PIPE2 */
-				if (pipe(eventFD) < 0) {
-					BOOST_THROW_EXCEPTION(posix_error()
-						<< boost::errinfo_api_function("pipe")
-						<< boost::errinfo_errno(errno));
-				}
-
-				Utility::SetCloExec(eventFD[0]);
-				Utility::SetCloExec(eventFD[1]);
-#	ifdef HAVE_PIPE2
-			} else {
-				BOOST_THROW_EXCEPTION(posix_error()
-					<< boost::errinfo_api_function("pipe2")
-					<< boost::errinfo_errno(errno));
-			}
-		}
-#	endif /* HAVE_PIPE2 */
-	}
-#endif /* _WIN32 */
 }
 
 INITIALIZE_ONCE(InitializeProcess);
+#endif /* _WIN32 */
 
 void Process::ThreadInitialize()
 {
@@ -606,19 +743,33 @@ bool Process::GetAdjustPriority() const
 	return m_AdjustPriority;
 }
 
+/**
+ * Sets the maximum number of output bytes which are kept.
+ *
+ * @param size The limit in bytes, 0 for no limit.
+ */
+void Process::SetMaxOutputSize(size_t size)
+{
+	m_MaxOutputSize = size;
+}
+
+size_t Process::GetMaxOutputSize() const
+{
+	return m_MaxOutputSize;
+}
+
 void Process::IOThreadProc(int tid)
 {
+	Utility::SetThreadName("ProcessIO");
+
+	Application::SetThreadAffinity(tid);
+
 #ifdef _WIN32
 	HANDLE *handles = nullptr;
 	HANDLE *fhandles = nullptr;
-#else /* _WIN32 */
-	pollfd *pfds = nullptr;
-#endif /* _WIN32 */
 	int count = 0;
 	double now;
 
-	Utility::SetThreadName("ProcessIO");
-
 	for (;;) {
 		double timeout = -1;
 
@@ -628,25 +779,15 @@ void Process::IOThreadProc(int tid)
 			boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
 
 			count = 1 + l_Processes[tid].size();
-#ifdef _WIN32
 			handles = reinterpret_cast<HANDLE *>(realloc(handles, sizeof(HANDLE) * count));
 			fhandles = reinterpret_cast<HANDLE *>(realloc(fhandles, sizeof(HANDLE) * count));
 
 			fhandles[0] = l_Events[tid];
 
-#else /* _WIN32 */
-			pfds = reinterpret_cast<pollfd *>(realloc(pfds, sizeof(pollfd) * count));
-
-			pfds[0].fd = l_EventFDs[tid][0];
-			pfds[0].events = POLLIN;
-			pfds[0].revents = 0;
-#endif /* _WIN32 */
-
 			int i = 1;
 			typedef std::pair<ProcessHandle, Process::Ptr> kv_pair;
 			for (const kv_pair& kv : l_Processes[tid]) {
 				const Process::Ptr& process = kv.second;
-#ifdef _WIN32
 				handles[i] = kv.first;
 
 				if (!process->m_ReadPending) {
@@ -660,11 +801,6 @@ void Process::IOThreadProc(int tid)
 				}
 
 				fhandles[i] = process->m_Overlapped.hEvent;
-#else /* _WIN32 */
-				pfds[i].fd = process->m_FD;
-				pfds[i].events = POLLIN;
-				pfds[i].revents = 0;
-#endif /* _WIN32 */
 
 				if (process->m_Timeout != 0) {
 					double delta = process->m_Timeout - (now - process->m_Result.ExecutionStart);
@@ -682,42 +818,18 @@ void Process::IOThreadProc(int tid)
 
 		timeout *= 1000;
 
-#ifdef _WIN32
 		DWORD rc = WaitForMultipleObjects(count, fhandles, FALSE, timeout == -1 ? INFINITE : static_cast<DWORD>(timeout));
-#else /* _WIN32 */
-		int rc = poll(pfds, count, timeout);
-
-		if (rc < 0)
-			continue;
-#endif /* _WIN32 */
 
 		now = Utility::GetTime();
 
 		{
 			boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
 
-#ifdef _WIN32
 			if (rc == WAIT_OBJECT_0)
 				ResetEvent(l_Events[tid]);
-#else /* _WIN32 */
-			if (pfds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
-				char buffer[512];
-				if (read(l_EventFDs[tid][0], buffer, sizeof(buffer)) < 0)
-					Log(LogCritical, "base", "Read from event FD failed.");
-			}
-#endif /* _WIN32 */
 
 			for (int i = 1; i < count; i++) {
-#ifdef _WIN32
 				auto it = l_Processes[tid].find(handles[i]);
-#else /* _WIN32 */
-				auto it2 = l_FDs[tid].find(pfds[i].fd);
-
-				if (it2 == l_FDs[tid].end())
-					continue; /* This should never happen. */
-
-				auto it = l_Processes[tid].find(it2->second);
-#endif /* _WIN32 */
 
 				if (it == l_Processes[tid].end())
 					continue; /* This should never happen. */
@@ -731,26 +843,168 @@ void Process::IOThreadProc(int tid)
 						is_timeout = true;
 				}
 
-#ifdef _WIN32
 				if (rc == WAIT_OBJECT_0 + i || is_timeout) {
-#else /* _WIN32 */
-				if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR) || is_timeout) {
-#endif /* _WIN32 */
 					if (!it->second->DoEvents()) {
-#ifdef _WIN32
 						CloseHandle(it->first);
 						CloseHandle(it->second->m_FD);
-#else /* _WIN32 */
-						l_FDs[tid].erase(it->second->m_FD);
-						(void)close(it->second->m_FD);
-#endif /* _WIN32 */
 						l_Processes[tid].erase(it);
 					}
 				}
 			}
 		}
 	}
+#else /* _WIN32 */
+	/* The output is read by the socket event engine. This thread only handles
+	 * timeouts and finished processes because waitpid() may block. */
+	for (;;) {
+		Process::Ptr process;
+		bool timedOut = false;
+
+		{
+			boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+
+			for (;;) {
+				if (!l_FinishedProcesses[tid].empty()) {
+					process = l_FinishedProcesses[tid].front();
+					l_FinishedProcesses[tid].pop_front();
+					break;
+				}
+
+				auto& deadlines = l_ProcessDeadlines[tid];
+
+				if (deadlines.empty()) {
+					l_ProcessCV[tid].wait(lock);
+					continue;
+				}
+
+				double delta = deadlines.begin()->first - Utility::GetTime();
+
+				if (delta < 0) {
+					process = deadlines.begin()->second;
+					deadlines.erase(deadlines.begin());
+					timedOut = true;
+					break;
+				}
+
+				l_ProcessCV[tid].timed_wait(lock, boost::posix_time::milliseconds(static_cast<long>(delta * 1000) + 1));
+			}
+		}
+
+		/* The process might have finished while we were waiting for the lock. */
+		if (timedOut && !process->StopOutputEvents())
+			continue;
+
+		process->DoEvents();
+
+		process->m_OutputSocket->Close();
+
+		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+
+		if (!timedOut && process->m_Timeout != 0) {
+			auto range = l_ProcessDeadlines[tid].equal_range(process->m_Result.ExecutionStart + process->m_Timeout);
+
+			for (auto it = range.first; it != range.second; it++) {
+				if (it->second == process) {
+					l_ProcessDeadlines[tid].erase(it);
+					break;
+				}
+			}
+		}
+
+		l_Processes[tid].erase(process->m_FD);
+	}
+#endif /* _WIN32 */
+}
+
+/**
+ * Appends to the process' output. Output beyond the limit set with
+ * SetMaxOutputSize() is discarded.
+ */
+void Process::AppendOutput(const char *data, size_t length)
+{
+	if (m_MaxOutputSize != 0 && m_OutputSize + length > m_MaxOutputSize) {
+		size_t keep = m_MaxOutputSize - m_OutputSize;
+
+		m_DiscardedOutput += length - keep;
+		length = keep;
+	}
+
+	m_OutputStream.write(data, length);
+	m_OutputSize += length;
+}
+
+#ifndef _WIN32
+/* Each I/O thread reads process output into its own buffer. */
+static thread_local char l_OutputReadBuffer[16 * 1024];
+
+/**
+ * Reads all available output from the process' pipe.
+ *
+ * @returns true if more output may follow, false if the pipe was closed.
+ */
+bool Process::ReadOutput()
+{
+	for (;;) {
+		int rc = read(m_FD, l_OutputReadBuffer, sizeof(l_OutputReadBuffer));
+
+		if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+
+		if (rc > 0) {
+			AppendOutput(l_OutputReadBuffer, rc);
+			continue;
+		}
+
+		return false;
+	}
+}
+
+/**
+ * Reads the process' output. Called by the socket event engine.
+ */
+void Process::OnOutputEvent()
+{
+	{
+		ObjectLock olock(this);
+
+		if (m_OutputFinished)
+			return;
+
+		if (ReadOutput())
+			return;
+	}
+
+	if (!StopOutputEvents())
+		return;
+
+	int tid = GetTID();
+
+	boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+	l_FinishedProcesses[tid].push_back(this);
+	l_ProcessCV[tid].notify_all();
+}
+
+/**
+ * Stops reading the process' output.
+ *
+ * @returns true if this call stopped it, false if it had been stopped already.
+ */
+bool Process::StopOutputEvents()
+{
+	{
+		ObjectLock olock(this);
+
+		if (m_OutputFinished)
+			return false;
+
+		m_OutputFinished = true;
+	}
+
+	m_OutputEvents->Unregister();
+
+	return true;
 }
+#endif /* _WIN32 */
 
 String Process::PrettyPrintArguments(const Process::Arguments& arguments)
 {
@@ -919,6 +1173,8 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 
 	envp[offset] = '\0';
 
+	double spawnStart = Utility::GetTime();
+
 	if (!CreateProcess(nullptr, args, nullptr, nullptr, TRUE,
 		0 /*EXTENDED_STARTUPINFO_PRESENT*/, envp, nullptr, &si.StartupInfo, &pi)) {
 		DWORD error = GetLastError();
@@ -941,6 +1197,8 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 		return;
 	}
 
+	RecordSpawnLatency(Utility::GetTime() - spawnStart);
+
 	delete [] args;
 	free(envp);
 /*	DeleteProcThreadAttributeList(lpAttributeList);
@@ -986,9 +1244,13 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 	fds[1] = outfds[1];
 	fds[2] = outfds[1];
 
+	double spawnStart = Utility::GetTime();
+
 	m_Process = ProcessSpawn(m_Arguments, m_ExtraEnvironment, m_AdjustPriority, fds);
 	m_PID = m_Process;
 
+	RecordSpawnLatency(Utility::GetTime() - spawnStart);
+
 	if (m_PID == -1) {
 		m_OutputStream << "Fork failed with error code " << errno << " (" << Utility::FormatErrorNumber(errno) << ")";
 		Log(LogCritical, "Process", m_OutputStream.str());
@@ -1008,22 +1270,77 @@ void Process::Run(const std::function<void(const ProcessResult&)>& callback)
 
 	int tid = GetTID();
 
+#ifdef _WIN32
 	{
 		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
 		l_Processes[tid][m_Process] = this;
-#ifndef _WIN32
-		l_FDs[tid][m_FD] = m_Process;
-#endif /* _WIN32 */
 	}
 
-#ifdef _WIN32
 	SetEvent(l_Events[tid]);
 #else /* _WIN32 */
-	if (write(l_EventFDs[tid][1], "T", 1) < 0 && errno != EINTR && errno != EAGAIN)
-		Log(LogCritical, "base", "Write to event FD failed.");
+	m_OutputSocket = new Socket(m_FD);
+	m_OutputEvents.reset(new ProcessOutputEvents(this));
+
+	{
+		boost::mutex::scoped_lock lock(l_ProcessMutex[tid]);
+
+		/* The PID isn't unique when spawning the process failed, use the FD instead. */
+		l_Processes[tid][m_FD] = this;
+
+		if (m_Timeout != 0) {
+			l_ProcessDeadlines[tid].insert(std::make_pair(m_Result.ExecutionStart + m_Timeout, this));
+			l_ProcessCV[tid].notify_all();
+		}
+	}
+
+	m_OutputEvents->ChangeEvents(POLLIN);
 #endif /* _WIN32 */
 }
 
+static void RecordSpawnLatency(double latency)
+{
+	boost::mutex::scoped_lock lock(l_SpawnLatencyMutex);
+
+	if (l_SpawnLatencies.size() < l_SpawnLatencySamples)
+		l_SpawnLatencies.push_back(latency);
+	else
+		l_SpawnLatencies[l_SpawnLatencyIndex] = latency;
+
+	l_SpawnLatencyIndex = (l_SpawnLatencyIndex + 1) % l_SpawnLatencySamples;
+}
+
+/**
+ * Calculates percentiles of the time it took to spawn the most recent processes.
+ *
+ * @param percentiles The percentiles (between 0 and 100).
+ * @returns The latency in seconds for each percentile, 0 if no processes were spawned yet.
+ */
+std::vector<double> Process::GetSpawnLatencyPercentiles(const std::vector<double>& percentiles)
+{
+	std::vector<double> latencies;
+
+	{
+		boost::mutex::scoped_lock lock(l_SpawnLatencyMutex);
+		latencies = l_SpawnLatencies;
+	}
+
+	std::vector<double> result;
+
+	if (latencies.empty()) {
+		result.resize(percentiles.size(), 0);
+		return result;
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	for (double percentile : percentiles) {
+		size_t index = static_cast<size_t>(percentile / 100 * (latencies.size() - 1) + 0.5);
+		result.push_back(latencies[std::min(index, latencies.size() - 1)]);
+	}
+
+	return result;
+}
+
 bool Process::DoEvents()
 {
 	bool is_timeout = false;
@@ -1062,29 +1379,25 @@ bool Process::DoEvents()
 
 		DWORD rc;
 		if (!m_ReadFailed && GetOverlappedResult(m_FD, &m_Overlapped, &rc, TRUE) && rc > 0) {
-			m_OutputStream.write(m_ReadBuffer, rc);
+			AppendOutput(m_ReadBuffer, rc);
 			return true;
 		}
 #else /* _WIN32 */
-		char buffer[512];
-		for (;;) {
-			int rc = read(m_FD, buffer, sizeof(buffer));
-
-			if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
-				return true;
-
-			if (rc > 0) {
-				m_OutputStream.write(buffer, rc);
-				continue;
-			}
-
-			break;
-		}
+		if (ReadOutput())
+			return true;
 #endif /* _WIN32 */
 	}
 
 	String output = m_OutputStream.str();
 
+	if (m_DiscardedOutput > 0) {
+		Log(LogWarning, "Process")
+			<< "Discarded " << m_DiscardedOutput << " bytes of output from PID " << m_PID << " ("
+			<< PrettyPrintArguments(m_Arguments) << ") which exceeded the limit of " << m_MaxOutputSize << " bytes";
+
+		output += "\n<Output truncated, " + Convert::ToString(m_DiscardedOutput) + " bytes discarded.>";
+	}
+
 #ifdef _WIN32
 	WaitForSingleObject(m_Process, INFINITE);
 
@@ -1136,6 +1449,8 @@ bool Process::DoEvents()
 	m_Result.ExitStatus = exitcode;
 	m_Result.Output = output;
 
+	l_ProcessRuntime.Record(m_Result.ExecutionEnd - m_Result.ExecutionStart);
+
 	if (m_Callback)
 		Utility::QueueAsyncCallback(std::bind(m_Callback, m_Result));
 
@@ -22,14 +22,20 @@
 
 #include "base/i2-base.hpp"
 #include "base/dictionary.hpp"
+#include "base/socket.hpp"
 #include <iosfwd>
 #include <deque>
+#include <memory>
 #include <vector>
 #include <sstream>
 
 namespace icinga
 {
 
+#ifndef _WIN32
+class ProcessOutputEvents;
+#endif /* _WIN32 */
+
 /**
  * The result of a Process task.
  *
@@ -76,6 +82,9 @@ public:
 	void SetAdjustPriority(bool adjust);
 	bool GetAdjustPriority() const;
 
+	void SetMaxOutputSize(size_t size);
+	size_t GetMaxOutputSize() const;
+
 	void Run(const std::function<void (const ProcessResult&)>& callback = std::function<void (const ProcessResult&)>());
 
 	pid_t GetPID() const;
@@ -86,8 +95,14 @@ public:
 
 	static String PrettyPrintArguments(const Arguments& arguments);
 
+	static std::vector<double> GetSpawnLatencyPercentiles(const std::vector<double>& percentiles);
+
 #ifndef _WIN32
 	static void InitializeSpawnHelper();
+
+	static pid_t Spawn(const Arguments& arguments, const Dictionary::Ptr& extraEnvironment, bool adjustPriority, int fds[3]);
+	static int Kill(pid_t pid, int signum);
+	static int WaitPID(pid_t pid, int *status);
 #endif /* _WIN32 */
 
 private:
@@ -96,6 +111,7 @@ private:
 
 	double m_Timeout;
 	bool m_AdjustPriority;
+	size_t m_MaxOutputSize{0};
 
 	ProcessHandle m_Process;
 	pid_t m_PID;
@@ -106,15 +122,30 @@ private:
 	bool m_ReadFailed;
 	OVERLAPPED m_Overlapped;
 	char m_ReadBuffer[1024];
+#else /* _WIN32 */
+	Socket::Ptr m_OutputSocket;
+	std::unique_ptr<ProcessOutputEvents> m_OutputEvents;
+	bool m_OutputFinished{false};
 #endif /* _WIN32 */
 
 	std::ostringstream m_OutputStream;
+	size_t m_OutputSize{0};
+	size_t m_DiscardedOutput{0};
 	std::function<void (const ProcessResult&)> m_Callback;
 	ProcessResult m_Result;
 
 	static void IOThreadProc(int tid);
 	bool DoEvents();
 	int GetTID() const;
+	void AppendOutput(const char *data, size_t length);
+
+#ifndef _WIN32
+	bool ReadOutput();
+	void OnOutputEvent();
+	bool StopOutputEvents();
+
+	friend class ProcessOutputEvents;
+#endif /* _WIN32 */
 };
 
 }
@@ -0,0 +1,354 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/profiler.hpp"
+#include "base/exception.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <vector>
+#ifndef _WIN32
+#	include <signal.h>
+#	include <sys/time.h>
+#endif /* _WIN32 */
+
+using namespace icinga;
+
+#define PROFILER_MAX_DEPTH 16
+#define PROFILER_RING_SIZE 64
+#define PROFILER_STACK_SIZE 256
+
+namespace
+{
+
+struct ProfilerSample
+{
+	char Stack[PROFILER_STACK_SIZE];
+};
+
+/* Everything the signal handler touches lives in this block. States are
+ * recycled instead of freed when their thread exits so that a late signal
+ * can never write to freed memory. */
+struct ProfilerThreadState
+{
+	bool InUse{true};
+	char Name[32];
+
+	/* Depth may exceed PROFILER_MAX_DEPTH, deeper frames aren't recorded. */
+	const char *Frames[PROFILER_MAX_DEPTH];
+	std::atomic<unsigned> Depth{0};
+
+	/* Single producer (the signal handler), single consumer (DrainSamples). */
+	ProfilerSample Ring[PROFILER_RING_SIZE];
+	std::atomic<unsigned> Head{0};
+	std::atomic<unsigned> Tail{0};
+	std::atomic<unsigned> Dropped{0};
+};
+
+}
+
+static boost::mutex l_StatesMutex;
+static std::vector<ProfilerThreadState *> l_States;
+static boost::mutex l_SessionMutex;
+static std::atomic<unsigned> l_UnattributedSamples{0};
+
+/* libbase is linked at startup so this lives in the static TLS block and is
+ * safe to read from a signal handler. */
+static thread_local ProfilerThreadState *l_ThreadState;
+
+static void ReleaseThreadState(ProfilerThreadState *state)
+{
+	l_ThreadState = nullptr;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+
+	state->Depth.store(0, std::memory_order_relaxed);
+
+	boost::mutex::scoped_lock lock(l_StatesMutex);
+	state->InUse = false;
+}
+
+static boost::thread_specific_ptr<ProfilerThreadState> l_ThreadStateOwner(&ReleaseThreadState);
+
+static ProfilerThreadState *GetThreadState()
+{
+	if (l_ThreadState)
+		return l_ThreadState;
+
+	ProfilerThreadState *state = nullptr;
+
+	{
+		boost::mutex::scoped_lock lock(l_StatesMutex);
+
+		for (ProfilerThreadState *candidate : l_States) {
+			if (!candidate->InUse) {
+				state = candidate;
+				break;
+			}
+		}
+
+		if (!state) {
+			state = new ProfilerThreadState();
+			l_States.push_back(state);
+		}
+
+		state->InUse = true;
+	}
+
+	state->Name[0] = '\0';
+	state->Depth.store(0, std::memory_order_relaxed);
+
+	l_ThreadStateOwner.reset(state);
+
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	l_ThreadState = state;
+
+	return state;
+}
+
+void Profiler::SetThreadName(const String& name)
+{
+	ProfilerThreadState *state = GetThreadState();
+
+	/* A sample taken while the name is being copied gets a mangled name; the
+	 * terminating NUL is never overwritten so it can't run off the end. */
+	strncpy(state->Name, name.CStr(), sizeof(state->Name) - 1);
+	state->Name[sizeof(state->Name) - 1] = '\0';
+}
+
+/**
+ * Publishes a context frame to the profiler. The string must stay valid
+ * until the matching PopFrame() call.
+ */
+void Profiler::PushFrame(const char *frame)
+{
+	ProfilerThreadState *state = GetThreadState();
+	unsigned depth = state->Depth.load(std::memory_order_relaxed);
+
+	if (depth < PROFILER_MAX_DEPTH)
+		state->Frames[depth] = frame;
+
+	std::atomic_signal_fence(std::memory_order_release);
+	state->Depth.store(depth + 1, std::memory_order_relaxed);
+}
+
+void Profiler::PopFrame()
+{
+	ProfilerThreadState *state = l_ThreadState;
+
+	if (!state)
+		return;
+
+	unsigned depth = state->Depth.load(std::memory_order_relaxed);
+
+	if (depth > 0)
+		state->Depth.store(depth - 1, std::memory_order_relaxed);
+
+	std::atomic_signal_fence(std::memory_order_release);
+}
+
+#ifndef _WIN32
+/* Only async-signal-safe code from here on until DrainSamples(). */
+static void AppendToSample(char *& p, char *end, const char *text, bool frame)
+{
+	char *start = p;
+
+	for (; *text && p < end; text++) {
+		char ch = *text;
+
+		/* Object names would make almost every stack unique. */
+		if (frame && (ch == '\'' || ch == '"'))
+			break;
+
+		if (ch == ';')
+			ch = ':';
+		else if (ch == '\n' || ch == '\t')
+			ch = ' ';
+
+		*p++ = ch;
+	}
+
+	while (p > start && p[-1] == ' ')
+		p--;
+}
+
+static void ProfilerSignalHandler(int)
+{
+	ProfilerThreadState *state = l_ThreadState;
+
+	if (!state) {
+		l_UnattributedSamples.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	unsigned head = state->Head.load(std::memory_order_relaxed);
+
+	if (head - state->Tail.load(std::memory_order_acquire) >= PROFILER_RING_SIZE) {
+		state->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ProfilerSample& sample = state->Ring[head % PROFILER_RING_SIZE];
+	char *p = sample.Stack;
+	char *end = sample.Stack + sizeof(sample.Stack) - 1;
+
+	AppendToSample(p, end, state->Name[0] ? state->Name : "[unnamed]", false);
+
+	unsigned depth = std::min(state->Depth.load(std::memory_order_relaxed), (unsigned)PROFILER_MAX_DEPTH);
+	std::atomic_signal_fence(std::memory_order_acquire);
+
+	for (unsigned i = 0; i < depth && p < end; i++) {
+		char *frameStart = p;
+
+		*p++ = ';';
+		AppendToSample(p, end, state->Frames[i], true);
+
+		if (p == frameStart + 1)
+			p = frameStart;
+	}
+
+	*p = '\0';
+
+	state->Head.store(head + 1, std::memory_order_release);
+}
+#endif /* _WIN32 */
+
+static void DrainSamples(std::map<String, unsigned long> *stacks, unsigned long *dropped)
+{
+	boost::mutex::scoped_lock lock(l_StatesMutex);
+
+	for (ProfilerThreadState *state : l_States) {
+		unsigned tail = state->Tail.load(std::memory_order_relaxed);
+		unsigned head = state->Head.load(std::memory_order_acquire);
+
+		for (; tail != head; tail++) {
+			if (stacks)
+				(*stacks)[state->Ring[tail % PROFILER_RING_SIZE].Stack]++;
+		}
+
+		state->Tail.store(tail, std::memory_order_release);
+
+		unsigned threadDropped = state->Dropped.exchange(0);
+
+		if (dropped)
+			*dropped += threadDropped;
+	}
+}
+
+bool Profiler::IsSupported()
+{
+#ifndef _WIN32
+	return true;
+#else /* _WIN32 */
+	return false;
+#endif /* _WIN32 */
+}
+
+/**
+ * Samples all threads for the specified duration and returns the
+ * aggregated folded stacks, one "thread;frame;... count" line per stack.
+ * Only one profiling session can run at a time.
+ *
+ * @param seconds The sampling duration.
+ * @param frequency Samples per second of consumed CPU time.
+ * @returns The folded stacks.
+ */
+String Profiler::Profile(double seconds, int frequency)
+{
+#ifndef _WIN32
+	boost::mutex::scoped_lock sessionLock(l_SessionMutex, boost::try_to_lock);
+
+	if (!sessionLock.owns_lock())
+		BOOST_THROW_EXCEPTION(std::runtime_error("Another profiling session is already running."));
+
+	frequency = std::max(1, std::min(frequency, 1000));
+
+	std::map<String, unsigned long> stacks;
+	unsigned long dropped = 0;
+
+	/* Throw away whatever a previous session left behind. */
+	DrainSamples(nullptr, nullptr);
+	l_UnattributedSamples.store(0);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = &ProfilerSignalHandler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(SIGPROF, &sa, nullptr) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("sigaction")
+			<< boost::errinfo_errno(errno));
+	}
+
+	itimerval timer;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000000 / frequency;
+	timer.it_value = timer.it_interval;
+
+	int rc = setitimer(ITIMER_PROF, &timer, nullptr);
+	int savedErrno = errno;
+
+	if (rc >= 0) {
+		double deadline = Utility::GetTime() + seconds;
+
+		while (Utility::GetTime() < deadline) {
+			Utility::Sleep(std::min(0.1, std::max(0.0, deadline - Utility::GetTime())));
+			DrainSamples(&stacks, &dropped);
+		}
+
+		memset(&timer, 0, sizeof(timer));
+		(void) setitimer(ITIMER_PROF, &timer, nullptr);
+	}
+
+	/* SIGPROF terminates the process by default and a signal might still be pending. */
+	sa.sa_handler = SIG_IGN;
+	(void) sigaction(SIGPROF, &sa, nullptr);
+
+	if (rc < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("setitimer")
+			<< boost::errinfo_errno(savedErrno));
+	}
+
+	DrainSamples(&stacks, &dropped);
+
+	std::ostringstream msgbuf;
+
+	for (const auto& kv : stacks)
+		msgbuf << kv.first << " " << kv.second << "\n";
+
+	unsigned unattributed = l_UnattributedSamples.load();
+
+	if (unattributed > 0)
+		msgbuf << "[unknown] " << unattributed << "\n";
+
+	if (dropped > 0)
+		msgbuf << "[dropped] " << dropped << "\n";
+
+	return msgbuf.str();
+#else /* _WIN32 */
+	BOOST_THROW_EXCEPTION(std::runtime_error("The profiler is not supported on this platform."));
+#endif /* _WIN32 */
+}
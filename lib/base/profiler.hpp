@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "base/i2-base.hpp"
+#include "base/string.hpp"
+
+namespace icinga
+{
+
+/**
+ * A sampling profiler which attributes CPU time to thread names and
+ * context frames.
+ *
+ * Threads publish their name and a shadow copy of their ContextFrame
+ * stack; while a profiling session is active a SIGPROF timer samples
+ * whichever thread is burning CPU and the samples are aggregated into
+ * folded stacks ("thread;frame;frame count") suitable for flamegraph.pl.
+ *
+ * @ingroup base
+ */
+class Profiler
+{
+public:
+	static void SetThreadName(const String& name);
+
+	static void PushFrame(const char *frame);
+	static void PopFrame();
+
+	static bool IsSupported();
+	static String Profile(double seconds, int frequency = 100);
+};
+
+}
+
+#endif /* PROFILER_H */
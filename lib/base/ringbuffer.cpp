@@ -25,17 +25,26 @@
 using namespace icinga;
 
 RingBuffer::RingBuffer(RingBuffer::SizeType slots)
-	: m_Slots(slots, 0), m_TimeValue(0), m_InsertedValues(0)
-{ }
+	: m_Slots(slots), m_TimeValue(0), m_InsertedValues(0)
+{
+	for (std::atomic<int>& slot : m_Slots)
+		slot.store(0);
+}
 
 RingBuffer::SizeType RingBuffer::GetLength() const
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
 	return m_Slots.size();
 }
 
 void RingBuffer::InsertValue(RingBuffer::SizeType tv, int num)
 {
+	SizeType timeValue = m_TimeValue.load(std::memory_order_acquire);
+
+	if (timeValue != 0 && tv <= timeValue) {
+		m_Slots[tv % m_Slots.size()].fetch_add(num, std::memory_order_relaxed);
+		return;
+	}
+
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	InsertValueUnlocked(tv, num);
@@ -48,7 +57,15 @@ void RingBuffer::InsertValueUnlocked(RingBuffer::SizeType tv, int num)
 	if (m_TimeValue == 0)
 		m_InsertedValues = 1;
 
-	if (tv > m_TimeValue) {
+	if (m_TimeValue != 0 && tv >= m_TimeValue + m_Slots.size()) {
+		/* more than a full lap has passed, reset all slots */
+		for (std::atomic<int>& slot : m_Slots)
+			slot.store(0, std::memory_order_relaxed);
+
+		m_InsertedValues = m_Slots.size();
+
+		m_TimeValue.store(tv, std::memory_order_release);
+	} else if (tv > m_TimeValue) {
 		RingBuffer::SizeType offset = m_TimeValue % m_Slots.size();
 
 		/* walk towards the target offset, resetting slots to 0 */
@@ -58,16 +75,17 @@ void RingBuffer::InsertValueUnlocked(RingBuffer::SizeType tv, int num)
 			if (offset >= m_Slots.size())
 				offset = 0;
 
-			m_Slots[offset] = 0;
+			m_Slots[offset].store(0, std::memory_order_relaxed);
 
 			if (m_TimeValue != 0 && m_InsertedValues < m_Slots.size())
 				m_InsertedValues++;
 		}
 
-		m_TimeValue = tv;
+		/* Publish the new time value only after the slots have been reset. */
+		m_TimeValue.store(tv, std::memory_order_release);
 	}
 
-	m_Slots[offsetTarget] += num;
+	m_Slots[offsetTarget].fetch_add(num, std::memory_order_relaxed);
 }
 
 int RingBuffer::UpdateAndGetValues(RingBuffer::SizeType tv, RingBuffer::SizeType span)
@@ -87,7 +105,7 @@ int RingBuffer::UpdateAndGetValuesUnlocked(RingBuffer::SizeType tv, RingBuffer::
 	int off = m_TimeValue % m_Slots.size();
 	int sum = 0;
 	while (span > 0) {
-		sum += m_Slots[off];
+		sum += m_Slots[off].load(std::memory_order_relaxed);
 
 		if (off == 0)
 			off = m_Slots.size();
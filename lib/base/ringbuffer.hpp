@@ -23,6 +23,7 @@
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
 #include <boost/thread/mutex.hpp>
+#include <atomic>
 #include <vector>
 
 namespace icinga
@@ -31,6 +32,10 @@ namespace icinga
 /**
  * A ring buffer that holds a pre-defined number of integers.
  *
+ * Values for the current (or an earlier) time value are added atomically
+ * without taking the lock. Only advancing the time value, which resets the
+ * slots in between, and reading the values are serialized.
+ *
  * @ingroup base
  */
 class RingBuffer final
@@ -49,8 +54,8 @@ public:
 
 private:
 	mutable boost::mutex m_Mutex;
-	std::vector<int> m_Slots;
-	SizeType m_TimeValue;
+	std::vector<std::atomic<int> > m_Slots;
+	std::atomic<SizeType> m_TimeValue;
 	SizeType m_InsertedValues;
 
 	void InsertValueUnlocked(SizeType tv, int num);
@@ -23,9 +23,13 @@
 
 using namespace icinga;
 
-boost::thread_specific_ptr<std::stack<ScriptFrame *> > ScriptFrame::m_ScriptFrames;
+boost::thread_specific_ptr<std::vector<ScriptFrame *> > ScriptFrame::m_ScriptFrames;
+boost::thread_specific_ptr<std::vector<Dictionary::Ptr> > ScriptFrame::m_LocalsPool;
 Array::Ptr ScriptFrame::m_Imports;
 
+/* Upper bound for the number of locals dictionaries which are kept per thread. */
+static const size_t l_LocalsPoolSize = 32;
+
 INITIALIZE_ONCE_WITH_PRIORITY([]() {
 	Dictionary::Ptr systemNS = new Dictionary();
 	ScriptGlobal::Set("System", systemNS);
@@ -41,23 +45,23 @@ INITIALIZE_ONCE_WITH_PRIORITY([]() {
 }, 50);
 
 ScriptFrame::ScriptFrame(bool allocLocals)
-	: Locals(allocLocals ? new Dictionary() : nullptr), Self(ScriptGlobal::GetGlobals()), Sandboxed(false), Depth(0)
+	: Locals(allocLocals ? AllocateLocals() : nullptr), Self(ScriptGlobal::GetGlobals()), Sandboxed(false), Depth(0)
 {
 	InitializeFrame();
 }
 
 ScriptFrame::ScriptFrame(bool allocLocals, Value self)
-	: Locals(allocLocals ? new Dictionary() : nullptr), Self(std::move(self)), Sandboxed(false), Depth(0)
+	: Locals(allocLocals ? AllocateLocals() : nullptr), Self(std::move(self)), Sandboxed(false), Depth(0)
 {
 	InitializeFrame();
 }
 
 void ScriptFrame::InitializeFrame()
 {
-	std::stack<ScriptFrame *> *frames = m_ScriptFrames.get();
+	std::vector<ScriptFrame *> *frames = m_ScriptFrames.get();
 
 	if (frames && !frames->empty()) {
-		ScriptFrame *frame = frames->top();
+		ScriptFrame *frame = frames->back();
 
 		Sandboxed = frame->Sandboxed;
 	}
@@ -69,6 +73,9 @@ ScriptFrame::~ScriptFrame()
 {
 	ScriptFrame *frame = PopFrame();
 	ASSERT(frame == this);
+
+	if (Locals)
+		ReleaseLocals(Locals);
 }
 
 void ScriptFrame::IncreaseStackDepth()
@@ -86,39 +93,82 @@ void ScriptFrame::DecreaseStackDepth()
 
 ScriptFrame *ScriptFrame::GetCurrentFrame()
 {
-	std::stack<ScriptFrame *> *frames = m_ScriptFrames.get();
+	std::vector<ScriptFrame *> *frames = m_ScriptFrames.get();
 
 	ASSERT(!frames->empty());
-	return frames->top();
+	return frames->back();
 }
 
 ScriptFrame *ScriptFrame::PopFrame()
 {
-	std::stack<ScriptFrame *> *frames = m_ScriptFrames.get();
+	std::vector<ScriptFrame *> *frames = m_ScriptFrames.get();
 
 	ASSERT(!frames->empty());
 
-	ScriptFrame *frame = frames->top();
-	frames->pop();
+	ScriptFrame *frame = frames->back();
+	frames->pop_back();
 
 	return frame;
 }
 
+/**
+ * Returns an empty dictionary for a frame's local variables. Dictionaries
+ * from finished frames are reused so that function calls don't have to
+ * allocate a new one each time.
+ *
+ * @returns An empty dictionary.
+ */
+Dictionary::Ptr ScriptFrame::AllocateLocals()
+{
+	std::vector<Dictionary::Ptr> *pool = m_LocalsPool.get();
+
+	if (!pool || pool->empty())
+		return new Dictionary();
+
+	Dictionary::Ptr locals = std::move(pool->back());
+	pool->pop_back();
+
+	return locals;
+}
+
+void ScriptFrame::ReleaseLocals(Dictionary::Ptr& locals)
+{
+	/* Someone else still has a reference, e.g. a function which returned 'locals'. */
+	if (locals->GetReferenceCount() != 1 || locals->IsFrozen())
+		return;
+
+	std::vector<Dictionary::Ptr> *pool = m_LocalsPool.get();
+
+	if (!pool) {
+		pool = new std::vector<Dictionary::Ptr>();
+		pool->reserve(l_LocalsPoolSize);
+		m_LocalsPool.reset(pool);
+	}
+
+	if (pool->size() >= l_LocalsPoolSize)
+		return;
+
+	/* Clear() keeps the capacity, the values are released right away though. */
+	locals->Clear();
+	pool->push_back(std::move(locals));
+}
+
 void ScriptFrame::PushFrame(ScriptFrame *frame)
 {
-	std::stack<ScriptFrame *> *frames = m_ScriptFrames.get();
+	std::vector<ScriptFrame *> *frames = m_ScriptFrames.get();
 
 	if (!frames) {
-		frames = new std::stack<ScriptFrame *>();
+		frames = new std::vector<ScriptFrame *>();
+		frames->reserve(64);
 		m_ScriptFrames.reset(frames);
 	}
 
 	if (!frames->empty()) {
-		ScriptFrame *parent = frames->top();
+		ScriptFrame *parent = frames->back();
 		frame->Depth += parent->Depth;
 	}
 
-	frames->push(frame);
+	frames->push_back(frame);
 }
 
 Array::Ptr ScriptFrame::GetImports()
@@ -24,7 +24,7 @@
 #include "base/dictionary.hpp"
 #include "base/array.hpp"
 #include <boost/thread/tss.hpp>
-#include <stack>
+#include <vector>
 
 namespace icinga
 {
@@ -45,15 +45,19 @@ struct ScriptFrame
 
 	static ScriptFrame *GetCurrentFrame();
 
+	static Dictionary::Ptr AllocateLocals();
+
 	static Array::Ptr GetImports();
 	static void AddImport(const Object::Ptr& import);
 
 private:
-	static boost::thread_specific_ptr<std::stack<ScriptFrame *> > m_ScriptFrames;
+	static boost::thread_specific_ptr<std::vector<ScriptFrame *> > m_ScriptFrames;
+	static boost::thread_specific_ptr<std::vector<Dictionary::Ptr> > m_LocalsPool;
 	static Array::Ptr m_Imports;
 
 	static void PushFrame(ScriptFrame *frame);
 	static ScriptFrame *PopFrame();
+	static void ReleaseLocals(Dictionary::Ptr& locals);
 
 	void InitializeFrame();
 };
@@ -22,6 +22,7 @@
 #include "base/logger.hpp"
 #include "base/stdiostream.hpp"
 #include "base/netstring.hpp"
+#include "base/netstringindex.hpp"
 #include "base/json.hpp"
 #include "base/convert.hpp"
 #include "base/objectlock.hpp"
@@ -101,6 +102,8 @@ void ScriptGlobal::WriteToFile(const String& filename)
 
 	StdioStream::Ptr sfp = new StdioStream(&fp, false);
 
+	std::vector<NetStringIndexEntry> index;
+
 	ObjectLock olock(m_Globals);
 	for (const Dictionary::Pair& kv : m_Globals) {
 		Value value = kv.second;
@@ -115,6 +118,7 @@ void ScriptGlobal::WriteToFile(const String& filename)
 
 		String json = JsonEncode(persistentVariable);
 
+		index.push_back({ String(), kv.first, kv.first, static_cast<uint_least64_t>(fp.tellp()) });
 		NetString::WriteStringToStream(sfp, json);
 	}
 
@@ -132,5 +136,7 @@ void ScriptGlobal::WriteToFile(const String& filename)
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(tempFilename));
 	}
+
+	NetStringIndex::WriteToFile(filename, index);
 }
 
@@ -31,7 +31,9 @@
 #include "base/dependencygraph.hpp"
 #include "base/initialize.hpp"
 #include <boost/regex.hpp>
+#include <boost/thread/mutex.hpp>
 #include <algorithm>
+#include <list>
 #include <set>
 #ifdef _WIN32
 #include <msi.h>
@@ -105,6 +107,70 @@ bool ScriptUtils::CastBool(const Value& value)
 	return value.ToBool();
 }
 
+typedef std::shared_ptr<const boost::regex> CompiledRegex;
+typedef std::list<std::pair<String, CompiledRegex> > RegexCacheList;
+
+static boost::mutex l_RegexCacheMutex;
+static RegexCacheList l_RegexCacheList; /* most recently used first */
+static std::map<String, RegexCacheList::iterator> l_RegexCache;
+static const size_t l_RegexCacheSize = 1024;
+
+/**
+ * Returns the compiled regular expression for a pattern. The most recently
+ * used expressions are kept so that assign rules and filters don't have to
+ * compile the same few patterns again for each object.
+ */
+static CompiledRegex GetCompiledRegex(const String& pattern)
+{
+	{
+		boost::mutex::scoped_lock lock(l_RegexCacheMutex);
+
+		auto it = l_RegexCache.find(pattern);
+
+		if (it != l_RegexCache.end()) {
+			l_RegexCacheList.splice(l_RegexCacheList.begin(), l_RegexCacheList, it->second);
+			return it->second->second;
+		}
+	}
+
+	/* Compile without holding the lock, invalid patterns throw and aren't cached. */
+	CompiledRegex expr = std::make_shared<const boost::regex>(pattern.GetData());
+
+	boost::mutex::scoped_lock lock(l_RegexCacheMutex);
+
+	auto it = l_RegexCache.find(pattern);
+
+	if (it != l_RegexCache.end())
+		return it->second->second;
+
+	l_RegexCacheList.emplace_front(pattern, expr);
+	l_RegexCache[pattern] = l_RegexCacheList.begin();
+
+	if (l_RegexCacheList.size() > l_RegexCacheSize) {
+		l_RegexCache.erase(l_RegexCacheList.back().first);
+		l_RegexCacheList.pop_back();
+	}
+
+	return expr;
+}
+
+/**
+ * Compiles a regex() pattern ahead of time, e.g. when the config compiler
+ * finds a call with a constant pattern.
+ *
+ * @returns false if the pattern is invalid, the error is reported when the
+ * call is evaluated.
+ */
+bool ScriptUtils::PrecompileRegex(const String& pattern)
+{
+	try {
+		GetCompiledRegex(pattern);
+		return true;
+	} catch (const std::exception&) {
+		return false;
+	}
+}
+
 bool ScriptUtils::Regex(const std::vector<Value>& args)
 {
 	if (args.size() < 2)
@@ -123,7 +189,8 @@ bool ScriptUtils::Regex(const std::vector<Value>& args)
 	else
 		mode = MatchAll;
 
-	boost::regex expr(pattern.GetData());
+	CompiledRegex cexpr = GetCompiledRegex(pattern);
+	const boost::regex& expr = *cexpr;
 
 	Array::Ptr texts;
 
@@ -440,7 +507,7 @@ Array::Ptr ScriptUtils::GetObjects(const Type::Ptr& type)
 
 	ArrayData result;
 
-	for (const ConfigObject::Ptr& object : ctype->GetObjects())
+	for (const ConfigObject::Ptr& object : ctype->GetObjectView())
 		result.push_back(object);
 
 	return new Array(std::move(result));
@@ -41,6 +41,7 @@ public:
 	static double CastNumber(const Value& value);
 	static bool CastBool(const Value& value);
 	static bool Regex(const std::vector<Value>& args);
+	static bool PrecompileRegex(const String& pattern);
 	static bool Match(const std::vector<Value>& args);
 	static bool CidrMatch(const std::vector<Value>& args);
 	static double Len(const Value& value);
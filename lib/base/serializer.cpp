@@ -31,7 +31,7 @@ using namespace icinga;
 struct SerializeStackEntry
 {
 	String Name;
-	Value Val;
+	const Object *Obj;
 };
 
 CircularReferenceError::CircularReferenceError(String message, std::vector<String> path)
@@ -52,16 +52,12 @@ struct SerializeStack
 {
 	std::deque<SerializeStackEntry> Entries;
 
-	inline void Push(const String& name, const Value& val)
+	/* The objects are kept alive by their parents, which are further up in the stack. */
+	inline void Push(String name, const Object *obj)
 	{
-		Object::Ptr obj;
-
-		if (val.IsObject())
-			obj = val;
-
 		if (obj) {
 			for (const auto& entry : Entries) {
-				if (entry.Val == obj) {
+				if (entry.Obj == obj) {
 					std::vector<String> path;
 					for (const auto& entry : Entries)
 						path.push_back(entry.Name);
@@ -71,7 +67,7 @@ struct SerializeStack
 			}
 		}
 
-		Entries.push_back({ name, obj });
+		Entries.push_back({ std::move(name), obj });
 	}
 
 	inline void Pop()
@@ -93,9 +89,15 @@ static Array::Ptr SerializeArray(const Array::Ptr& input, int attributeTypes, Se
 	int index = 0;
 
 	for (const Value& value : input) {
-		stack.Push(Convert::ToString(index), value);
-		result.emplace_back(SerializeInternal(value, attributeTypes, stack));
-		stack.Pop();
+		/* Scalars can't refer back to their parents. */
+		if (!value.IsObject())
+			result.emplace_back(value);
+		else {
+			stack.Push(Convert::ToString(index), value.Get<Object::Ptr>().get());
+			result.emplace_back(SerializeInternal(value, attributeTypes, stack));
+			stack.Pop();
+		}
+
 		index++;
 	}
 
@@ -111,9 +113,13 @@ static Dictionary::Ptr SerializeDictionary(const Dictionary::Ptr& input, int att
 	ObjectLock olock(input);
 
 	for (const Dictionary::Pair& kv : input) {
-		stack.Push(kv.first, kv.second);
-		result.emplace_back(kv.first, SerializeInternal(kv.second, attributeTypes, stack));
-		stack.Pop();
+		if (!kv.second.IsObject())
+			result.emplace_back(kv.first, kv.second);
+		else {
+			stack.Push(kv.first, kv.second.Get<Object::Ptr>().get());
+			result.emplace_back(kv.first, SerializeInternal(kv.second, attributeTypes, stack));
+			stack.Pop();
+		}
 	}
 
 	return new Dictionary(std::move(result));
@@ -129,20 +135,18 @@ static Object::Ptr SerializeObject(const Object::Ptr& input, int attributeTypes,
 	DictionaryData fields;
 	fields.reserve(type->GetFieldCount() + 1);
 
-	for (int i = 0; i < type->GetFieldCount(); i++) {
-		Field field = type->GetFieldInfo(i);
-
-		if (attributeTypes != 0 && (field.Attributes & attributeTypes) == 0)
-			continue;
-
+	input->VisitFields(attributeTypes, [attributeTypes, &fields, &stack](const Field& field, const Value& value) {
 		if (strcmp(field.Name, "type") == 0)
-			continue;
-
-		Value value = input->GetField(i);
-		stack.Push(field.Name, value);
-		fields.emplace_back(field.Name, SerializeInternal(input->GetField(i), attributeTypes, stack));
-		stack.Pop();
-	}
+			return;
+
+		if (!value.IsObject())
+			fields.emplace_back(field.Name, value);
+		else {
+			stack.Push(field.Name, value.Get<Object::Ptr>().get());
+			fields.emplace_back(field.Name, SerializeInternal(value, attributeTypes, stack));
+			stack.Pop();
+		}
+	});
 
 	fields.emplace_back("type", type->GetName());
 
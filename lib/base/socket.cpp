@@ -384,7 +384,10 @@ bool Socket::Poll(bool read, bool write, struct timeval *timeout)
 	pfd.events = (read ? POLLIN : 0) | (write ? POLLOUT : 0);
 	pfd.revents = 0;
 
-	rc = poll(&pfd, 1, timeout ? (timeout->tv_sec + 1000 + timeout->tv_usec / 1000) : -1);
+	/* SIGPROF from the profiler may interrupt the call. */
+	do {
+		rc = poll(&pfd, 1, timeout ? (timeout->tv_sec + 1000 + timeout->tv_usec / 1000) : -1);
+	} while (rc < 0 && errno == EINTR);
 
 	if (rc < 0) {
 		Log(LogCritical, "Socket")
@@ -29,12 +29,15 @@ using namespace icinga;
 
 void SocketEventEngineEpoll::InitializeThread(int tid)
 {
+	if (!m_PollFDs)
+		m_PollFDs.reset(new SOCKET[m_ThreadCount]);
+
 	m_PollFDs[tid] = epoll_create(128);
 	Utility::SetCloExec(m_PollFDs[tid]);
 
 	SocketEventDescriptor sed;
 
-	m_Sockets[tid][m_EventFDs[tid][0]] = sed;
+	m_Sockets[tid].Set(m_EventFDs[tid][0], sed);
 	m_FDChanged[tid] = true;
 
 	epoll_event event;
@@ -110,9 +113,14 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 				if ((pevents[i].events & (EPOLLIN | EPOLLOUT | EPOLLHUP | EPOLLERR)) == 0)
 					continue;
 
+				SocketEventDescriptor *desc = m_Sockets[tid].Find(pevents[i].data.fd);
+
+				if (!desc)
+					continue;
+
 				EventDescription event;
 				event.REvents = SocketEventEngineEpoll::EpollToPoll(pevents[i].events);
-				event.Descriptor = m_Sockets[tid][pevents[i].data.fd];
+				event.Descriptor = *desc;
 				event.LifesupportReference = event.Descriptor.LifesupportObject;
 				VERIFY(event.LifesupportReference);
 
@@ -120,6 +128,8 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 			}
 		}
 
+		RecordEvents(tid, events.size());
+
 		for (const EventDescription& event : events) {
 			try {
 				event.Descriptor.EventInterface->OnEvent(event.REvents);
@@ -136,7 +146,7 @@ void SocketEventEngineEpoll::ThreadProc(int tid)
 
 void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObject)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_TID;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -147,9 +157,9 @@ void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObjec
 		desc.EventInterface = se;
 		desc.LifesupportObject = lifesupportObject;
 
-		VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+		VERIFY(!m_Sockets[tid].Find(se->m_FD));
 
-		m_Sockets[tid][se->m_FD] = desc;
+		m_Sockets[tid].Set(se->m_FD, desc);
 
 		epoll_event event;
 		memset(&event, 0, sizeof(event));
@@ -163,7 +173,7 @@ void SocketEventEngineEpoll::Register(SocketEvents *se, Object *lifesupportObjec
 
 void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_TID;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -171,7 +181,7 @@ void SocketEventEngineEpoll::Unregister(SocketEvents *se)
 		if (se->m_FD == INVALID_SOCKET)
 			return;
 
-		m_Sockets[tid].erase(se->m_FD);
+		m_Sockets[tid].Erase(se->m_FD);
 		m_FDChanged[tid] = true;
 
 		epoll_ctl(m_PollFDs[tid], EPOLL_CTL_DEL, se->m_FD, nullptr);
@@ -188,14 +198,12 @@ void SocketEventEngineEpoll::ChangeEvents(SocketEvents *se, int events)
 	if (se->m_FD == INVALID_SOCKET)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
 
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_TID;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-		auto it = m_Sockets[tid].find(se->m_FD);
-
-		if (it == m_Sockets[tid].end())
+		if (!m_Sockets[tid].Find(se->m_FD))
 			return;
 
 		epoll_event event;
@@ -0,0 +1,443 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/socketevents.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#ifdef HAVE_LINUX_IO_URING_H
+#	include <linux/io_uring.h>
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+
+using namespace icinga;
+
+#define IOURING_ENTRIES 4096
+
+/* user_data for requests whose completions are ignored */
+#define IOURING_IGNORE_COMPLETION (~static_cast<uint64_t>(0))
+
+namespace icinga
+{
+
+struct IoUringPoll
+{
+	int Mask{0};
+	uint32_t Generation{0};
+	bool Armed{false};
+};
+
+/**
+ * The io_uring instance of an I/O thread.
+ */
+struct IoUringThread
+{
+	int RingFD{-1};
+
+	unsigned *SQHead;
+	unsigned *SQTail;
+	unsigned SQMask;
+	unsigned SQEntries;
+	unsigned *SQArray;
+	io_uring_sqe *SQEs;
+	unsigned SQLocalTail{0};
+
+	unsigned *CQHead;
+	unsigned *CQTail;
+	unsigned CQMask;
+	io_uring_cqe *CQEs;
+
+	/* Only used by the I/O thread. */
+	std::vector<IoUringPoll> Polls;
+
+	/* File descriptors whose poll request has to be updated, protected by the thread's event mutex. */
+	std::vector<SOCKET> Dirty;
+};
+
+}
+
+static int IoUringSetup(unsigned entries, io_uring_params *params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+	return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static void IoUringMap(IoUringThread& ring, const io_uring_params& params)
+{
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	bool singleMmap = false;
+
+#ifdef IORING_FEAT_SINGLE_MMAP
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		singleMmap = true;
+		sqSize = cqSize = std::max(sqSize, cqSize);
+	}
+#endif /* IORING_FEAT_SINGLE_MMAP */
+
+	auto *sq = static_cast<char *>(mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.RingFD, IORING_OFF_SQ_RING));
+
+	if (sq == MAP_FAILED) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("mmap")
+			<< boost::errinfo_errno(errno));
+	}
+
+	char *cq = sq;
+
+	if (!singleMmap) {
+		cq = static_cast<char *>(mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.RingFD, IORING_OFF_CQ_RING));
+
+		if (cq == MAP_FAILED) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("mmap")
+				<< boost::errinfo_errno(errno));
+		}
+	}
+
+	auto *sqes = static_cast<io_uring_sqe *>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.RingFD, IORING_OFF_SQES));
+
+	if (sqes == MAP_FAILED) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("mmap")
+			<< boost::errinfo_errno(errno));
+	}
+
+	ring.SQHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+	ring.SQTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+	ring.SQMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+	ring.SQEntries = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+	ring.SQArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+	ring.SQEs = sqes;
+	ring.SQLocalTail = *ring.SQTail;
+
+	ring.CQHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+	ring.CQTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+	ring.CQMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+	ring.CQEs = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+/**
+ * Passes the queued requests to the kernel and optionally waits for a completion.
+ */
+static void IoUringSubmit(IoUringThread& ring, bool wait)
+{
+	__atomic_store_n(ring.SQTail, ring.SQLocalTail, __ATOMIC_RELEASE);
+
+	for (;;) {
+		unsigned toSubmit = ring.SQLocalTail - __atomic_load_n(ring.SQHead, __ATOMIC_ACQUIRE);
+
+		if (toSubmit == 0 && !wait)
+			return;
+
+		int rc = IoUringEnter(ring.RingFD, toSubmit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+
+		if (rc >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY))
+			return;
+
+		/* Interrupted while waiting, let the caller process what we've got so far. */
+		if (errno == EINTR && wait)
+			return;
+	}
+}
+
+static io_uring_sqe *IoUringGetSQE(IoUringThread& ring)
+{
+	/* The submission queue is full, pass the requests to the kernel first. */
+	while (ring.SQLocalTail - __atomic_load_n(ring.SQHead, __ATOMIC_ACQUIRE) >= ring.SQEntries)
+		IoUringSubmit(ring, false);
+
+	unsigned index = ring.SQLocalTail & ring.SQMask;
+	ring.SQArray[index] = index;
+	ring.SQLocalTail++;
+
+	io_uring_sqe *sqe = &ring.SQEs[index];
+	memset(sqe, 0, sizeof(*sqe));
+
+	return sqe;
+}
+
+static uint64_t IoUringUserData(SOCKET fd, uint32_t generation)
+{
+	return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+bool SocketEventEngineIoUring::IsSupported()
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	int fd = IoUringSetup(2, &params);
+
+	if (fd < 0)
+		return false;
+
+	close(fd);
+
+	return true;
+}
+
+void SocketEventEngineIoUring::InitializeThread(int tid)
+{
+	if (!m_Rings)
+		m_Rings = new IoUringThread[m_ThreadCount];
+
+	IoUringThread& ring = m_Rings[tid];
+
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ring.RingFD = IoUringSetup(IOURING_ENTRIES, &params);
+
+	if (ring.RingFD < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("io_uring_setup")
+			<< boost::errinfo_errno(errno));
+	}
+
+	Utility::SetCloExec(ring.RingFD);
+
+	IoUringMap(ring, params);
+
+	SocketEventDescriptor sed;
+
+	m_Sockets[tid].Set(m_EventFDs[tid][0], sed);
+	ring.Dirty.push_back(m_EventFDs[tid][0]);
+	m_FDChanged[tid] = true;
+}
+
+/**
+ * Updates the poll requests for all sockets whose events have changed.
+ *
+ * Note: Caller must hold the thread's event mutex.
+ */
+void SocketEventEngineIoUring::ApplyChanges(int tid)
+{
+	IoUringThread& ring = m_Rings[tid];
+
+	for (SOCKET fd : ring.Dirty) {
+		SocketEventDescriptor *desc = m_Sockets[tid].Find(fd);
+
+		int wanted = 0;
+
+		if (desc) {
+			wanted = desc->Events;
+
+			if (desc->EventInterface && !desc->EventInterface->m_Events)
+				wanted = 0;
+		}
+
+		if (static_cast<size_t>(fd) >= ring.Polls.size())
+			ring.Polls.resize(std::max<size_t>(fd + 1, ring.Polls.size() * 2));
+
+		IoUringPoll& poll = ring.Polls[fd];
+
+		if (poll.Armed && poll.Mask == wanted)
+			continue;
+
+		if (poll.Armed) {
+			io_uring_sqe *sqe = IoUringGetSQE(ring);
+			sqe->opcode = IORING_OP_POLL_REMOVE;
+			sqe->fd = -1;
+			sqe->addr = IoUringUserData(fd, poll.Generation);
+			sqe->user_data = IOURING_IGNORE_COMPLETION;
+
+			poll.Armed = false;
+		}
+
+		if (wanted != 0) {
+			poll.Generation++;
+			poll.Mask = wanted;
+			poll.Armed = true;
+
+			io_uring_sqe *sqe = IoUringGetSQE(ring);
+			sqe->opcode = IORING_OP_POLL_ADD;
+			sqe->fd = fd;
+			sqe->poll_events = wanted;
+			sqe->user_data = IoUringUserData(fd, poll.Generation);
+		}
+	}
+
+	ring.Dirty.clear();
+
+	if (m_FDChanged[tid]) {
+		m_FDChanged[tid] = false;
+		m_CV[tid].notify_all();
+	}
+}
+
+void SocketEventEngineIoUring::ThreadProc(int tid)
+{
+	Utility::SetThreadName("SocketIO");
+
+	IoUringThread& ring = m_Rings[tid];
+
+	for (;;) {
+		{
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+			ApplyChanges(tid);
+		}
+
+		/* Submits the changed poll requests and waits for events in one system call. */
+		IoUringSubmit(ring, true);
+
+		std::vector<EventDescription> events;
+
+		{
+			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+			unsigned head = *ring.CQHead;
+			unsigned tail = __atomic_load_n(ring.CQTail, __ATOMIC_ACQUIRE);
+
+			for (; head != tail; head++) {
+				const io_uring_cqe& cqe = ring.CQEs[head & ring.CQMask];
+
+				if (cqe.user_data == IOURING_IGNORE_COMPLETION)
+					continue;
+
+				auto fd = static_cast<SOCKET>(cqe.user_data & 0xffffffff);
+				auto generation = static_cast<uint32_t>(cqe.user_data >> 32);
+
+				if (static_cast<size_t>(fd) >= ring.Polls.size())
+					continue;
+
+				IoUringPoll& poll = ring.Polls[fd];
+
+				/* The request was replaced or removed in the meantime. */
+				if (!poll.Armed || poll.Generation != generation)
+					continue;
+
+				/* Poll requests are one-shot, the next ApplyChanges() call re-arms it. */
+				poll.Armed = false;
+				ring.Dirty.push_back(fd);
+
+				if (cqe.res < 0)
+					continue;
+
+				if (fd == m_EventFDs[tid][0]) {
+					char buffer[512];
+					if (recv(m_EventFDs[tid][0], buffer, sizeof(buffer), 0) < 0 && errno != EAGAIN)
+						Log(LogCritical, "SocketEvents", "Read from event FD failed.");
+
+					continue;
+				}
+
+				SocketEventDescriptor *desc = m_Sockets[tid].Find(fd);
+
+				if (!desc || (cqe.res & (POLLIN | POLLOUT | POLLHUP | POLLERR)) == 0)
+					continue;
+
+				EventDescription event;
+				event.REvents = cqe.res;
+				event.Descriptor = *desc;
+				event.LifesupportReference = event.Descriptor.LifesupportObject;
+				VERIFY(event.LifesupportReference);
+
+				events.emplace_back(std::move(event));
+			}
+
+			__atomic_store_n(ring.CQHead, head, __ATOMIC_RELEASE);
+		}
+
+		RecordEvents(tid, events.size());
+
+		for (const EventDescription& event : events) {
+			try {
+				event.Descriptor.EventInterface->OnEvent(event.REvents);
+			} catch (const std::exception& ex) {
+				Log(LogCritical, "SocketEvents")
+					<< "Exception thrown in socket I/O handler:\n"
+					<< DiagnosticInformation(ex);
+			} catch (...) {
+				Log(LogCritical, "SocketEvents", "Exception of unknown type thrown in socket I/O handler.");
+			}
+		}
+	}
+}
+
+void SocketEventEngineIoUring::Register(SocketEvents *se, Object *lifesupportObject)
+{
+	int tid = se->m_TID;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		VERIFY(se->m_FD != INVALID_SOCKET);
+
+		SocketEventDescriptor desc;
+		desc.Events = 0;
+		desc.EventInterface = se;
+		desc.LifesupportObject = lifesupportObject;
+
+		VERIFY(!m_Sockets[tid].Find(se->m_FD));
+
+		m_Sockets[tid].Set(se->m_FD, desc);
+
+		se->m_Events = true;
+	}
+}
+
+void SocketEventEngineIoUring::Unregister(SocketEvents *se)
+{
+	int tid = se->m_TID;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		if (se->m_FD == INVALID_SOCKET)
+			return;
+
+		m_Sockets[tid].Erase(se->m_FD);
+		m_Rings[tid].Dirty.push_back(se->m_FD);
+		m_FDChanged[tid] = true;
+
+		se->m_FD = INVALID_SOCKET;
+		se->m_Events = false;
+	}
+
+	WakeUpThread(tid, true);
+}
+
+void SocketEventEngineIoUring::ChangeEvents(SocketEvents *se, int events)
+{
+	if (se->m_FD == INVALID_SOCKET)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
+
+	int tid = se->m_TID;
+
+	{
+		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
+
+		SocketEventDescriptor *desc = m_Sockets[tid].Find(se->m_FD);
+
+		if (!desc || desc->Events == events)
+			return;
+
+		desc->Events = events;
+		m_Rings[tid].Dirty.push_back(se->m_FD);
+	}
+
+	WakeUpThread(tid, false);
+}
+#endif /* HAVE_LINUX_IO_URING_H */
@@ -30,7 +30,7 @@ void SocketEventEnginePoll::InitializeThread(int tid)
 	SocketEventDescriptor sed;
 	sed.Events = POLLIN;
 
-	m_Sockets[tid][m_EventFDs[tid][0]] = sed;
+	m_Sockets[tid].Set(m_EventFDs[tid][0], sed);
 	m_FDChanged[tid] = true;
 }
 
@@ -46,32 +46,30 @@ void SocketEventEnginePoll::ThreadProc(int tid)
 			boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
 			if (m_FDChanged[tid]) {
-				pfds.resize(m_Sockets[tid].size());
-				descriptors.resize(m_Sockets[tid].size());
+				pfds.resize(m_Sockets[tid].GetLength());
+				descriptors.resize(m_Sockets[tid].GetLength());
 
 				int i = 0;
 
-				typedef std::map<SOCKET, SocketEventDescriptor>::value_type kv_pair;
+				m_Sockets[tid].ForEach([&pfds, &descriptors, &i](SOCKET fd, const SocketEventDescriptor& desc) {
+					if (desc.Events == 0)
+						return;
 
-				for (const kv_pair& desc : m_Sockets[tid]) {
-					if (desc.second.Events == 0)
-						continue;
+					int events = desc.Events;
 
-					int events = desc.second.Events;
+					if (desc.EventInterface) {
+						desc.EventInterface->m_EnginePrivate = &pfds[i];
 
-					if (desc.second.EventInterface) {
-						desc.second.EventInterface->m_EnginePrivate = &pfds[i];
-
-						if (!desc.second.EventInterface->m_Events)
+						if (!desc.EventInterface->m_Events)
 							events = 0;
 					}
 
-					pfds[i].fd = desc.first;
+					pfds[i].fd = fd;
 					pfds[i].events = events;
-					descriptors[i] = desc.second;
+					descriptors[i] = desc;
 
 					i++;
-				}
+				});
 
 				pfds.resize(i);
 
@@ -118,6 +116,8 @@ void SocketEventEnginePoll::ThreadProc(int tid)
 			}
 		}
 
+		RecordEvents(tid, events.size());
+
 		for (const EventDescription& event : events) {
 			try {
 				event.Descriptor.EventInterface->OnEvent(event.REvents);
@@ -134,7 +134,7 @@ void SocketEventEnginePoll::ThreadProc(int tid)
 
 void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_TID;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -146,9 +146,9 @@ void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject
 		desc.EventInterface = se;
 		desc.LifesupportObject = lifesupportObject;
 
-		VERIFY(m_Sockets[tid].find(se->m_FD) == m_Sockets[tid].end());
+		VERIFY(!m_Sockets[tid].Find(se->m_FD));
 
-		m_Sockets[tid][se->m_FD] = desc;
+		m_Sockets[tid].Set(se->m_FD, desc);
 
 		m_FDChanged[tid] = true;
 
@@ -160,7 +160,7 @@ void SocketEventEnginePoll::Register(SocketEvents *se, Object *lifesupportObject
 
 void SocketEventEnginePoll::Unregister(SocketEvents *se)
 {
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_TID;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
@@ -168,7 +168,7 @@ void SocketEventEnginePoll::Unregister(SocketEvents *se)
 		if (se->m_FD == INVALID_SOCKET)
 			return;
 
-		m_Sockets[tid].erase(se->m_FD);
+		m_Sockets[tid].Erase(se->m_FD);
 		m_FDChanged[tid] = true;
 
 		se->m_FD = INVALID_SOCKET;
@@ -183,20 +183,20 @@ void SocketEventEnginePoll::ChangeEvents(SocketEvents *se, int events)
 	if (se->m_FD == INVALID_SOCKET)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Tried to read/write from a closed socket."));
 
-	int tid = se->m_ID % SOCKET_IOTHREADS;
+	int tid = se->m_TID;
 
 	{
 		boost::mutex::scoped_lock lock(m_EventMutex[tid]);
 
-		auto it = m_Sockets[tid].find(se->m_FD);
+		SocketEventDescriptor *desc = m_Sockets[tid].Find(se->m_FD);
 
-		if (it == m_Sockets[tid].end())
+		if (!desc)
 			return;
 
-		if (it->second.Events == events)
+		if (desc->Events == events)
 			return;
 
-		it->second.Events = events;
+		desc->Events = events;
 
 		if (se->m_EnginePrivate && std::this_thread::get_id() == m_Threads[tid].get_id())
 			((pollfd *)se->m_EnginePrivate)->events = events;
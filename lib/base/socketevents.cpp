@@ -22,6 +22,7 @@
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/utility.hpp"
 #include <boost/thread/once.hpp>
 #include <map>
 #ifdef __linux__
@@ -33,11 +34,83 @@ using namespace icinga;
 static boost::once_flag l_SocketIOOnceFlag = BOOST_ONCE_INIT;
 static SocketEventEngine *l_SocketIOEngine;
 
-int SocketEvents::m_NextID = 0;
+SocketEventDescriptor *SocketEventDescriptorTable::Find(SOCKET fd)
+{
+#ifndef _WIN32
+	if (fd < 0 || static_cast<size_t>(fd) >= m_Descriptors.size() || !m_Used[fd])
+		return nullptr;
+
+	return &m_Descriptors[fd];
+#else /* _WIN32 */
+	auto it = m_Descriptors.find(fd);
+
+	if (it == m_Descriptors.end())
+		return nullptr;
+
+	return &it->second;
+#endif /* _WIN32 */
+}
+
+void SocketEventDescriptorTable::Set(SOCKET fd, const SocketEventDescriptor& desc)
+{
+#ifndef _WIN32
+	if (static_cast<size_t>(fd) >= m_Descriptors.size()) {
+		size_t size = std::max<size_t>(fd + 1, m_Descriptors.size() * 2);
+		m_Descriptors.resize(size);
+		m_Used.resize(size, 0);
+	}
+
+	if (!m_Used[fd]) {
+		m_Used[fd] = 1;
+		m_Count++;
+	}
+
+	m_Descriptors[fd] = desc;
+#else /* _WIN32 */
+	m_Descriptors[fd] = desc;
+#endif /* _WIN32 */
+}
 
-void SocketEventEngine::Start()
+void SocketEventDescriptorTable::Erase(SOCKET fd)
 {
-	for (int tid = 0; tid < SOCKET_IOTHREADS; tid++) {
+#ifndef _WIN32
+	if (fd < 0 || static_cast<size_t>(fd) >= m_Descriptors.size() || !m_Used[fd])
+		return;
+
+	m_Used[fd] = 0;
+	m_Descriptors[fd] = SocketEventDescriptor();
+	m_Count--;
+#else /* _WIN32 */
+	m_Descriptors.erase(fd);
+#endif /* _WIN32 */
+}
+
+size_t SocketEventDescriptorTable::GetLength() const
+{
+#ifndef _WIN32
+	return m_Count;
+#else /* _WIN32 */
+	return m_Descriptors.size();
+#endif /* _WIN32 */
+}
+
+void SocketEventEngine::Start(int threadCount)
+{
+	m_ThreadCount = threadCount;
+	m_Threads.reset(new std::thread[threadCount]);
+	m_EventFDs.reset(new SOCKET[threadCount][2]);
+	m_FDChanged.reset(new bool[threadCount]());
+	m_EventMutex.reset(new boost::mutex[threadCount]);
+	m_CV.reset(new boost::condition_variable[threadCount]);
+	m_Sockets.reset(new SocketEventDescriptorTable[threadCount]);
+	m_SocketCounts.reset(new std::atomic<int>[threadCount]);
+
+	for (int tid = 0; tid < threadCount; tid++) {
+		m_SocketCounts[tid] = 0;
+		m_EventRates.emplace_back(new RingBuffer(15));
+	}
+
+	for (int tid = 0; tid < threadCount; tid++) {
 		Socket::SocketPair(m_EventFDs[tid]);
 
 		Utility::SetNonBlockingSocket(m_EventFDs[tid][0]);
@@ -50,14 +123,15 @@ void SocketEventEngine::Start()
 
 		InitializeThread(tid);
 
-		m_Threads[tid] = std::thread(std::bind(&SocketEventEngine::ThreadProc, this, tid));
+		m_Threads[tid] = std::thread([this, tid]() {
+			Application::SetThreadAffinity(tid);
+			ThreadProc(tid);
+		});
 	}
 }
 
-void SocketEventEngine::WakeUpThread(int sid, bool wait)
+void SocketEventEngine::WakeUpThread(int tid, bool wait)
 {
-	int tid = sid % SOCKET_IOTHREADS;
-
 	if (std::this_thread::get_id() == m_Threads[tid].get_id())
 		return;
 
@@ -94,6 +168,19 @@ void SocketEvents::InitializeEngine()
 	else if (eventEngine == "epoll")
 		l_SocketIOEngine = new SocketEventEngineEpoll();
 #endif /* __linux__ */
+#ifdef HAVE_LINUX_IO_URING_H
+	else if (eventEngine == "iouring") {
+		if (SocketEventEngineIoUring::IsSupported())
+			l_SocketIOEngine = new SocketEventEngineIoUring();
+		else {
+			Log(LogWarning, "SocketEvents", "The kernel does not support io_uring - Falling back to 'epoll'");
+
+			eventEngine = "epoll";
+
+			l_SocketIOEngine = new SocketEventEngineEpoll();
+		}
+	}
+#endif /* HAVE_LINUX_IO_URING_H */
 	else {
 		Log(LogWarning, "SocketEvents")
 			<< "Invalid event engine selected: " << eventEngine << " - Falling back to 'poll'";
@@ -103,25 +190,84 @@ void SocketEvents::InitializeEngine()
 		l_SocketIOEngine = new SocketEventEnginePoll();
 	}
 
-	l_SocketIOEngine->Start();
+	/* One I/O thread per core by default, but at least as many as we used to have. */
+	Value defaultThreads = std::max(8, std::min(Application::GetConcurrency(), 64));
+	int threads = ScriptGlobal::Get("EventEngineThreads", &defaultThreads);
+
+	if (threads < 1)
+		threads = 1;
+
+	l_SocketIOEngine->Start(threads);
 
 	ScriptGlobal::Set("EventEngine", eventEngine);
+
+	Log(LogNotice, "SocketEvents")
+		<< "Started " << threads << " socket I/O threads for event engine '" << eventEngine << "'.";
+}
+
+int SocketEventEngine::GetThreadCount() const
+{
+	return m_ThreadCount;
+}
+
+/**
+ * Picks the thread for a new socket: the one which handled the fewest
+ * events recently, or the one with the fewest sockets if there's a tie.
+ *
+ * @returns The thread ID.
+ */
+int SocketEventEngine::AssignThread()
+{
+	auto now = static_cast<RingBuffer::SizeType>(Utility::GetTime());
+
+	int bestTid = 0;
+	int bestEvents = 0, bestSockets = 0;
+
+	for (int tid = 0; tid < m_ThreadCount; tid++) {
+		int events = m_EventRates[tid]->UpdateAndGetValues(now, 10);
+		int sockets = m_SocketCounts[tid];
+
+		if (tid == 0 || events < bestEvents || (events == bestEvents && sockets < bestSockets)) {
+			bestTid = tid;
+			bestEvents = events;
+			bestSockets = sockets;
+		}
+	}
+
+	m_SocketCounts[bestTid]++;
+
+	return bestTid;
+}
+
+void SocketEventEngine::ReleaseThread(int tid)
+{
+	m_SocketCounts[tid]--;
+}
+
+void SocketEventEngine::RecordEvents(int tid, int count)
+{
+	if (count > 0)
+		m_EventRates[tid]->InsertValue(static_cast<RingBuffer::SizeType>(Utility::GetTime()), count);
 }
 
 /**
  * Constructor for the SocketEvents class.
  */
 SocketEvents::SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject)
-	: m_ID(m_NextID++), m_FD(socket->GetFD()), m_EnginePrivate(nullptr)
+	: m_FD(socket->GetFD()), m_EnginePrivate(nullptr)
 {
 	boost::call_once(l_SocketIOOnceFlag, &SocketEvents::InitializeEngine);
 
+	m_TID = l_SocketIOEngine->AssignThread();
+
 	Register(lifesupportObject);
 }
 
 SocketEvents::~SocketEvents()
 {
 	VERIFY(m_FD == INVALID_SOCKET);
+
+	l_SocketIOEngine->ReleaseThread(m_TID);
 }
 
 void SocketEvents::Register(Object *lifesupportObject)
@@ -146,8 +292,7 @@ boost::mutex& SocketEventEngine::GetMutex(int tid)
 
 bool SocketEvents::IsHandlingEvents() const
 {
-	int tid = m_ID % SOCKET_IOTHREADS;
-	boost::mutex::scoped_lock lock(l_SocketIOEngine->GetMutex(tid));
+	boost::mutex::scoped_lock lock(l_SocketIOEngine->GetMutex(m_TID));
 	return m_Events;
 }
 
@@ -22,8 +22,13 @@
 
 #include "base/i2-base.hpp"
 #include "base/socket.hpp"
+#include "base/ringbuffer.hpp"
 #include <boost/thread/condition_variable.hpp>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <map>
 
 #ifndef _WIN32
 #	include <poll.h>
@@ -57,13 +62,11 @@ protected:
 	SocketEvents(const Socket::Ptr& socket, Object *lifesupportObject);
 
 private:
-	int m_ID;
+	int m_TID;
 	SOCKET m_FD;
 	bool m_Events;
 	void *m_EnginePrivate;
 
-	static int m_NextID;
-
 	static void InitializeEngine();
 
 	void WakeUpThread(bool wait = false);
@@ -72,10 +75,9 @@ private:
 
 	friend class SocketEventEnginePoll;
 	friend class SocketEventEngineEpoll;
+	friend class SocketEventEngineIoUring;
 };
 
-#define SOCKET_IOTHREADS 8
-
 struct SocketEventDescriptor
 {
 	int Events{POLLIN};
@@ -83,6 +85,45 @@ struct SocketEventDescriptor
 	Object *LifesupportObject{nullptr};
 };
 
+/**
+ * The sockets of an I/O thread. File descriptors are small integers on
+ * POSIX systems so they're used as indexes into a flat array. Windows
+ * socket handles aren't, they're kept in a map instead.
+ *
+ * @ingroup base
+ */
+class SocketEventDescriptorTable
+{
+public:
+	SocketEventDescriptor *Find(SOCKET fd);
+	void Set(SOCKET fd, const SocketEventDescriptor& desc);
+	void Erase(SOCKET fd);
+	size_t GetLength() const;
+
+	template<typename F>
+	void ForEach(const F& func) const
+	{
+#ifndef _WIN32
+		for (SOCKET fd = 0; fd < static_cast<SOCKET>(m_Descriptors.size()); fd++) {
+			if (m_Used[fd])
+				func(fd, m_Descriptors[fd]);
+		}
+#else /* _WIN32 */
+		for (const auto& kv : m_Descriptors)
+			func(kv.first, kv.second);
+#endif /* _WIN32 */
+	}
+
+private:
+#ifndef _WIN32
+	std::vector<SocketEventDescriptor> m_Descriptors;
+	std::vector<char> m_Used;
+	size_t m_Count{0};
+#else /* _WIN32 */
+	std::map<SOCKET, SocketEventDescriptor> m_Descriptors;
+#endif /* _WIN32 */
+};
+
 struct EventDescription
 {
 	int REvents;
@@ -93,12 +134,16 @@ struct EventDescription
 class SocketEventEngine
 {
 public:
-	void Start();
+	virtual ~SocketEventEngine() = default;
+
+	void Start(int threadCount);
 
-	void WakeUpThread(int sid, bool wait);
+	void WakeUpThread(int tid, bool wait);
 
 	boost::mutex& GetMutex(int tid);
 
+	int GetThreadCount() const;
+
 protected:
 	virtual void InitializeThread(int tid) = 0;
 	virtual void ThreadProc(int tid) = 0;
@@ -106,12 +151,21 @@ protected:
 	virtual void Unregister(SocketEvents *se) = 0;
 	virtual void ChangeEvents(SocketEvents *se, int events) = 0;
 
-	std::thread m_Threads[SOCKET_IOTHREADS];
-	SOCKET m_EventFDs[SOCKET_IOTHREADS][2];
-	bool m_FDChanged[SOCKET_IOTHREADS];
-	boost::mutex m_EventMutex[SOCKET_IOTHREADS];
-	boost::condition_variable m_CV[SOCKET_IOTHREADS];
-	std::map<SOCKET, SocketEventDescriptor> m_Sockets[SOCKET_IOTHREADS];
+	int AssignThread();
+	void ReleaseThread(int tid);
+	void RecordEvents(int tid, int count);
+
+	int m_ThreadCount{0};
+	std::unique_ptr<std::thread[]> m_Threads;
+	std::unique_ptr<SOCKET[][2]> m_EventFDs;
+	std::unique_ptr<bool[]> m_FDChanged;
+	std::unique_ptr<boost::mutex[]> m_EventMutex;
+	std::unique_ptr<boost::condition_variable[]> m_CV;
+	std::unique_ptr<SocketEventDescriptorTable[]> m_Sockets;
+
+	/* Used for placing new sockets on the least busy thread. */
+	std::unique_ptr<std::atomic<int>[]> m_SocketCounts;
+	std::vector<std::unique_ptr<RingBuffer> > m_EventRates;
 
 	friend class SocketEvents;
 };
@@ -141,13 +195,43 @@ protected:
 	virtual void ThreadProc(int tid);
 
 private:
-	SOCKET m_PollFDs[SOCKET_IOTHREADS];
+	std::unique_ptr<SOCKET[]> m_PollFDs;
 
 	static int PollToEpoll(int events);
 	static int EpollToPoll(int events);
 };
 #endif /* __linux__ */
 
+#ifdef HAVE_LINUX_IO_URING_H
+struct IoUringThread;
+
+/**
+ * Socket event engine which waits for events with io_uring. Poll requests
+ * are submitted in batches together with waiting for completions, so each
+ * loop iteration needs a single system call.
+ *
+ * @ingroup base
+ */
+class SocketEventEngineIoUring final : public SocketEventEngine
+{
+public:
+	void Register(SocketEvents *se, Object *lifesupportObject) override;
+	void Unregister(SocketEvents *se) override;
+	void ChangeEvents(SocketEvents *se, int events) override;
+
+	static bool IsSupported();
+
+protected:
+	void InitializeThread(int tid) override;
+	void ThreadProc(int tid) override;
+
+private:
+	IoUringThread *m_Rings{nullptr};
+
+	void ApplyChanges(int tid);
+};
+#endif /* HAVE_LINUX_IO_URING_H */
+
 }
 
 #endif /* SOCKETEVENTS_H */
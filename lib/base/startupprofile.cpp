@@ -0,0 +1,204 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/startupprofile.hpp"
+#include "base/array.hpp"
+#include "base/utility.hpp"
+#include <boost/thread/mutex.hpp>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <vector>
+#ifndef _WIN32
+#	include <sys/resource.h>
+#endif /* _WIN32 */
+#ifdef HAVE_MALLINFO2
+#	include <malloc.h>
+#endif /* HAVE_MALLINFO2 */
+
+using namespace icinga;
+
+namespace
+{
+
+struct StartupPhaseStats
+{
+	String Name;
+	double WallTime;
+	double CpuTime;
+	int64_t HeapDelta;
+};
+
+}
+
+static boost::mutex l_ProfileMutex;
+static std::vector<StartupPhaseStats> l_Phases;
+static std::map<String, double> l_WorkerTimes;
+static bool l_Finished = false;
+
+void StartupProfile::RecordPhase(const String& name, double wallTime, double cpuTime, int64_t heapDelta)
+{
+	boost::mutex::scoped_lock lock(l_ProfileMutex);
+
+	if (l_Finished)
+		return;
+
+	l_Phases.push_back({ name, wallTime, cpuTime, heapDelta });
+}
+
+/**
+ * Adds time which was spent on a task by any number of threads, i.e. it
+ * may exceed the wall time of the surrounding phase.
+ */
+void StartupProfile::AddWorkerTime(const String& name, double time)
+{
+	boost::mutex::scoped_lock lock(l_ProfileMutex);
+
+	if (l_Finished)
+		return;
+
+	l_WorkerTimes[name] += time;
+}
+
+void StartupProfile::Finish()
+{
+	boost::mutex::scoped_lock lock(l_ProfileMutex);
+	l_Finished = true;
+}
+
+Dictionary::Ptr StartupProfile::ToDictionary()
+{
+	boost::mutex::scoped_lock lock(l_ProfileMutex);
+
+	ArrayData phases;
+
+	for (const StartupPhaseStats& phase : l_Phases) {
+		DictionaryData data {
+			{ "name", phase.Name },
+			{ "wall_time", phase.WallTime },
+			{ "cpu_time", phase.CpuTime }
+		};
+
+#ifdef HAVE_MALLINFO2
+		data.emplace_back("heap_delta", static_cast<double>(phase.HeapDelta));
+#endif /* HAVE_MALLINFO2 */
+
+		phases.push_back(new Dictionary(std::move(data)));
+	}
+
+	DictionaryData workerTimes;
+
+	for (const auto& kv : l_WorkerTimes)
+		workerTimes.emplace_back(kv.first, kv.second);
+
+	return new Dictionary({
+		{ "phases", new Array(std::move(phases)) },
+		{ "worker_times", new Dictionary(std::move(workerTimes)) }
+	});
+}
+
+void StartupProfile::WriteToFile(const String& path)
+{
+	Utility::SaveJsonFile(path, 0644, ToDictionary());
+}
+
+void StartupProfile::Print(std::ostream& fp)
+{
+	boost::mutex::scoped_lock lock(l_ProfileMutex);
+
+	fp << std::left << std::setw(40) << "Phase" << std::right << std::setw(12) << "Wall" << std::setw(12) << "CPU";
+#ifdef HAVE_MALLINFO2
+	fp << std::setw(14) << "Heap (MiB)";
+#endif /* HAVE_MALLINFO2 */
+	fp << "\n";
+
+	fp << std::fixed << std::setprecision(3);
+
+	for (const StartupPhaseStats& phase : l_Phases) {
+		fp << std::left << std::setw(40) << phase.Name << std::right
+			<< std::setw(11) << phase.WallTime << "s" << std::setw(11) << phase.CpuTime << "s";
+#ifdef HAVE_MALLINFO2
+		fp << std::setw(14) << phase.HeapDelta / 1048576.0;
+#endif /* HAVE_MALLINFO2 */
+		fp << "\n";
+	}
+
+	if (!l_WorkerTimes.empty()) {
+		fp << "\n" << std::left << std::setw(40) << "Worker time (all threads)" << "\n";
+
+		for (const auto& kv : l_WorkerTimes)
+			fp << std::left << std::setw(40) << kv.first << std::right << std::setw(11) << kv.second << "s\n";
+	}
+
+	fp.unsetf(std::ios_base::floatfield);
+}
+
+/**
+ * Returns the user and system CPU time the process has used so far.
+ */
+double StartupProfile::GetCpuTime()
+{
+#ifndef _WIN32
+	rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0;
+
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1000000.0
+		+ usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1000000.0;
+#else /* _WIN32 */
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		return 0;
+
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernelTime.dwLowDateTime;
+	kernel.HighPart = kernelTime.dwHighDateTime;
+	user.LowPart = userTime.dwLowDateTime;
+	user.HighPart = userTime.dwHighDateTime;
+
+	return (kernel.QuadPart + user.QuadPart) / 10000000.0;
+#endif /* _WIN32 */
+}
+
+/**
+ * Returns the number of bytes currently allocated on the heap, or 0 if the
+ * allocator can't tell.
+ */
+int64_t StartupProfile::GetHeapSize()
+{
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 info = mallinfo2();
+	return static_cast<int64_t>(info.uordblks + info.hblkhd);
+#else /* HAVE_MALLINFO2 */
+	return 0;
+#endif /* HAVE_MALLINFO2 */
+}
+
+StartupPhase::StartupPhase(String name)
+	: m_Name(std::move(name)), m_WallStart(Utility::GetTime()), m_CpuStart(StartupProfile::GetCpuTime()),
+	m_HeapStart(StartupProfile::GetHeapSize())
+{ }
+
+StartupPhase::~StartupPhase()
+{
+	StartupProfile::RecordPhase(m_Name, Utility::GetTime() - m_WallStart,
+		StartupProfile::GetCpuTime() - m_CpuStart, StartupProfile::GetHeapSize() - m_HeapStart);
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include "base/i2-base.hpp"
+#include "base/dictionary.hpp"
+#include <cstdint>
+#include <iosfwd>
+
+namespace icinga
+{
+
+/**
+ * Records how much time and memory the phases of the startup take.
+ *
+ * Phases are measured in wall time, process CPU time and (where available)
+ * the change in allocated heap memory. Work which is spread over many
+ * objects and threads, e.g. validation, is additionally accumulated as
+ * worker time. Recording stops once Finish() has been called.
+ *
+ * @ingroup base
+ */
+class StartupProfile
+{
+public:
+	static void RecordPhase(const String& name, double wallTime, double cpuTime, int64_t heapDelta);
+	static void AddWorkerTime(const String& name, double time);
+
+	static void Finish();
+
+	static Dictionary::Ptr ToDictionary();
+	static void WriteToFile(const String& path);
+	static void Print(std::ostream& fp);
+
+	static double GetCpuTime();
+	static int64_t GetHeapSize();
+};
+
+/**
+ * Measures a startup phase from its construction until its destruction.
+ *
+ * @ingroup base
+ */
+class StartupPhase
+{
+public:
+	explicit StartupPhase(String name);
+	~StartupPhase();
+
+	StartupPhase(const StartupPhase&) = delete;
+	StartupPhase& operator=(const StartupPhase&) = delete;
+
+private:
+	String m_Name;
+	double m_WallStart;
+	double m_CpuStart;
+	int64_t m_HeapStart;
+};
+
+}
+
+#endif /* STARTUPPROFILE_H */
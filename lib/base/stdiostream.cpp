@@ -63,6 +63,16 @@ void StdioStream::Close()
 	}
 }
 
+/**
+ * Writes buffered data to the underlying file.
+ */
+void StdioStream::Flush()
+{
+	ObjectLock olock(this);
+
+	m_InnerStream->flush();
+}
+
 bool StdioStream::IsDataAvailable() const
 {
 	return !IsEof();
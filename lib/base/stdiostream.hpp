@@ -38,6 +38,7 @@ public:
 	void Write(const void *buffer, size_t size) override;
 
 	void Close() override;
+	void Flush();
 
 	bool IsDataAvailable() const override;
 	bool IsEof() const override;
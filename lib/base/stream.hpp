@@ -22,6 +22,7 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include "base/string.hpp"
 #include <boost/signals2.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -52,6 +53,15 @@ struct StreamReadContext
 	size_t Size{0};
 	bool MustRead{true};
 	bool Eof{false};
+
+	/* A netstring whose length is known but which hasn't been read completely yet. */
+	String Pending;
+	size_t PendingOffset{0};
+	bool PendingDone{false};
+
+	/* Data which was returned by NetString::ReadStringViewFromStream() and
+	 * is dropped with the next read. */
+	size_t DropCount{0};
 };
 
 enum StreamReadStatus
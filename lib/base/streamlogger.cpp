@@ -62,6 +62,11 @@ void StreamLogger::Flush()
 		m_Stream->flush();
 }
 
+std::ostream *StreamLogger::GetStream() const
+{
+	return m_Stream;
+}
+
 void StreamLogger::BindStream(std::ostream *stream, bool ownsStream)
 {
 	ObjectLock olock(this);
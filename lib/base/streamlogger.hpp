@@ -46,8 +46,10 @@ public:
 	static void ProcessLogEntry(std::ostream& stream, const LogEntry& entry);
 
 protected:
-	void ProcessLogEntry(const LogEntry& entry) final;
-	void Flush() final;
+	void ProcessLogEntry(const LogEntry& entry) override;
+	void Flush() override;
+
+	std::ostream *GetStream() const;
 
 private:
 	static boost::mutex m_Mutex;
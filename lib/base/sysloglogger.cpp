@@ -82,7 +82,7 @@ void SyslogLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
 {
 	DictionaryData nodes;
 
-	for (const SyslogLogger::Ptr& sysloglogger : ConfigType::GetObjectsByType<SyslogLogger>()) {
+	for (const SyslogLogger::Ptr& sysloglogger : ConfigType::GetObjectViewByType<SyslogLogger>()) {
 		nodes.emplace_back(sysloglogger->GetName(), 1); //add more stats
 	}
 
@@ -27,13 +27,22 @@
 
 using namespace icinga;
 
+/* The minimum number of worker threads. */
+static const size_t l_MinThreads = 4;
+
+/* The maximum number of worker threads which are spawned or killed at once. */
+static const int l_MaxAdjustment = 8;
+
 int ThreadPool::m_NextID = 1;
 
+/* The worker state is owned by the pool, don't delete it when the thread exits. */
+boost::thread_specific_ptr<ThreadPool::WorkerThread> ThreadPool::m_CurrentWorker([](WorkerThread *) { });
+
 ThreadPool::ThreadPool(size_t max_threads)
 	: m_ID(m_NextID++), m_MaxThreads(max_threads)
 {
-	if (m_MaxThreads != UINT_MAX && m_MaxThreads < sizeof(m_Queues) / sizeof(m_Queues[0]))
-		m_MaxThreads = sizeof(m_Queues) / sizeof(m_Queues[0]);
+	if (m_MaxThreads != UINT_MAX && m_MaxThreads < l_MinThreads)
+		m_MaxThreads = l_MinThreads;
 
 	Start();
 }
@@ -50,8 +59,12 @@ void ThreadPool::Start()
 
 	m_Stopped = false;
 
-	for (auto& queue : m_Queues)
-		queue.SpawnWorker(m_ThreadGroup);
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		for (size_t i = 0; i < l_MinThreads; i++)
+			SpawnWorker();
+	}
 
 	m_MgmtThread = std::thread(std::bind(&ThreadPool::ManagerThreadProc, this));
 }
@@ -70,18 +83,29 @@ void ThreadPool::Stop()
 	if (m_MgmtThread.joinable())
 		m_MgmtThread.join();
 
-	for (auto& queue : m_Queues) {
-		boost::mutex::scoped_lock lock(queue.Mutex);
-		queue.Stopped = true;
-		queue.CV.notify_all();
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_WorkersStopped = true;
+		m_CV.notify_all();
 	}
 
 	m_ThreadGroup.join_all();
 	m_ThreadGroup.~thread_group();
 	new (&m_ThreadGroup) boost::thread_group();
 
-	for (auto& queue : m_Queues)
-		queue.Stopped = false;
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		/* Zombie threads might still be finishing up, keep their state around. */
+		for (auto& thread : m_Threads) {
+			boost::mutex::scoped_lock tlock(thread->Mutex);
+
+			if (thread->State == ThreadDead)
+				thread->Thread = nullptr;
+		}
+
+		m_WorkersStopped = false;
+	}
 
 	m_Stopped = true;
 }
@@ -89,37 +113,39 @@ void ThreadPool::Stop()
 /**
  * Waits for work items and processes them.
  */
-void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
+void ThreadPool::WorkerThread::ThreadProc(ThreadPool& pool)
 {
 	std::ostringstream idbuf;
-	idbuf << "Q #" << &queue << " W #" << this;
+	idbuf << "TP #" << pool.m_ID << " W #" << this;
 	Utility::SetThreadName(idbuf.str());
 
+	m_CurrentWorker.reset(this);
+
+	Application::SetThreadAffinity(Node);
+
 	for (;;) {
 		WorkItem wi;
+		bool local = false;
 
 		{
-			boost::mutex::scoped_lock lock(queue.Mutex);
+			boost::mutex::scoped_lock lock(Mutex);
 
-			UpdateUtilization(ThreadIdle);
+			if (!Items.empty()) {
+				wi = std::move(Items.front());
+				Items.pop_front();
 
-			while (queue.Items.empty() && !queue.Stopped && !Zombie) {
-				if (queue.Items.empty())
-					queue.CVStarved.notify_all();
+				UpdateUtilization(ThreadBusy);
 
-				queue.CV.wait(lock);
+				pool.m_Pending--;
+				local = true;
 			}
+		}
 
-			if (Zombie)
-				break;
+		if (!local) {
+			boost::mutex::scoped_lock lock(pool.m_Mutex);
 
-			if (queue.Items.empty() && queue.Stopped)
+			if (!pool.GetWorkItem(*this, wi, lock))
 				break;
-
-			wi = queue.Items.front();
-			queue.Items.pop_front();
-
-			UpdateUtilization(ThreadBusy);
 		}
 
 		double st = Utility::GetTime();
@@ -147,11 +173,11 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 		double latency = st - wi.Timestamp;
 
 		{
-			boost::mutex::scoped_lock lock(queue.Mutex);
+			boost::mutex::scoped_lock lock(Mutex);
 
-			queue.WaitTime += latency;
-			queue.ServiceTime += et - st;
-			queue.TaskCount++;
+			WaitTime += latency;
+			ServiceTime += et - st;
+			TaskCount++;
 		}
 
 #ifdef I2_DEBUG
@@ -183,13 +209,107 @@ void ThreadPool::WorkerThread::ThreadProc(Queue& queue)
 #endif /* I2_DEBUG */
 	}
 
-	boost::mutex::scoped_lock lock(queue.Mutex);
+	boost::mutex::scoped_lock lock(pool.m_Mutex);
+	boost::mutex::scoped_lock tlock(Mutex);
+
+	/* Hand over work items which were left behind to the other workers. */
+	if (!Items.empty()) {
+		for (auto& item : Items)
+			pool.m_Injector.emplace_back(std::move(item));
+
+		Items.clear();
+		pool.m_CV.notify_all();
+	}
+
 	UpdateUtilization(ThreadDead);
 	Zombie = false;
 }
 
 /**
- * Appends a work item to the work queue. Work items will be processed in FIFO order.
+ * Retrieves a work item from the injector queue or another worker's queue,
+ * waiting until one becomes available.
+ *
+ * Note: Caller must hold m_Mutex.
+ *
+ * @returns false if the worker should terminate, true otherwise.
+ */
+bool ThreadPool::GetWorkItem(ThreadPool::WorkerThread& worker, ThreadPool::WorkItem& wi, boost::mutex::scoped_lock& lock)
+{
+	{
+		boost::mutex::scoped_lock tlock(worker.Mutex);
+		worker.UpdateUtilization(ThreadIdle);
+	}
+
+	for (;;) {
+		if (worker.Zombie)
+			return false;
+
+		bool found = false;
+
+		if (!m_Injector.empty()) {
+			wi = std::move(m_Injector.front());
+			m_Injector.pop_front();
+			found = true;
+		} else
+			found = StealWorkItem(worker, wi);
+
+		if (found) {
+			m_Pending--;
+
+			boost::mutex::scoped_lock tlock(worker.Mutex);
+			worker.UpdateUtilization(ThreadBusy);
+
+			return true;
+		}
+
+		if (m_WorkersStopped && m_Pending == 0)
+			return false;
+
+		m_IdleThreads++;
+
+		if (m_Pending == 0 && !m_WorkersStopped)
+			m_CV.wait(lock);
+
+		m_IdleThreads--;
+	}
+}
+
+/**
+ * Takes the oldest work item from one of the worker queues, starting with
+ * a randomly chosen worker.
+ *
+ * Note: Caller must hold m_Mutex.
+ */
+bool ThreadPool::StealWorkItem(const ThreadPool::WorkerThread& thief, ThreadPool::WorkItem& wi)
+{
+	if (m_Threads.empty())
+		return false;
+
+	size_t start = Utility::Random() % m_Threads.size();
+
+	for (size_t i = 0; i < m_Threads.size(); i++) {
+		WorkerThread& victim = *m_Threads[(start + i) % m_Threads.size()];
+
+		if (&victim == &thief)
+			continue;
+
+		boost::mutex::scoped_lock lock(victim.Mutex);
+
+		if (victim.Items.empty())
+			continue;
+
+		wi = std::move(victim.Items.front());
+		victim.Items.pop_front();
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Appends a work item to the work queue. Work items posted from one of the
+ * pool's worker threads are preferably processed by the same thread.
  *
  * @param callback The callback function for the work item.
  * @param policy The scheduling policy
@@ -201,19 +321,37 @@ bool ThreadPool::Post(const ThreadPool::WorkFunction& callback, SchedulerPolicy
 	wi.Callback = callback;
 	wi.Timestamp = Utility::GetTime();
 
-	Queue& queue = m_Queues[Utility::Random() % (sizeof(m_Queues) / sizeof(m_Queues[0]))];
+	WorkerThread *worker = m_CurrentWorker.get();
+
+	if (worker && worker->Pool == this && policy == DefaultScheduler) {
+		m_Pending++;
+
+		{
+			boost::mutex::scoped_lock lock(worker->Mutex);
+			worker->Items.emplace_back(std::move(wi));
+		}
+
+		/* Only wake up other workers if there are any which might steal this item. */
+		if (m_IdleThreads > 0) {
+			boost::mutex::scoped_lock lock(m_Mutex);
+			m_CV.notify_one();
+		}
+
+		return true;
+	}
 
 	{
-		boost::mutex::scoped_lock lock(queue.Mutex);
+		boost::mutex::scoped_lock lock(m_Mutex);
 
-		if (queue.Stopped)
+		if (m_WorkersStopped)
 			return false;
 
-		if (policy == LowLatencyScheduler)
-			queue.SpawnWorker(m_ThreadGroup);
+		if (policy == LowLatencyScheduler && m_IdleThreads == 0)
+			SpawnWorker();
 
-		queue.Items.emplace_back(std::move(wi));
-		queue.CV.notify_one();
+		m_Pending++;
+		m_Injector.emplace_back(std::move(wi));
+		m_CV.notify_one();
 	}
 
 	return true;
@@ -228,10 +366,6 @@ void ThreadPool::ManagerThreadProc()
 	double lastStats = 0;
 
 	for (;;) {
-		size_t total_pending = 0, total_alive = 0;
-		double total_avg_latency = 0;
-		double total_utilization = 0;
-
 		{
 			boost::mutex::scoped_lock lock(m_MgmtMutex);
 
@@ -242,29 +376,40 @@ void ThreadPool::ManagerThreadProc()
 				break;
 		}
 
-		for (auto& queue : m_Queues) {
-			size_t pending, alive = 0;
-			double avg_latency;
-			double utilization = 0;
+		size_t pending, alive = 0;
+		double avg_latency;
+		double utilization = 0;
+		double wait_time = 0;
+		int task_count = 0;
 
-				boost::mutex::scoped_lock lock(queue.Mutex);
+		{
+			boost::mutex::scoped_lock lock(m_Mutex);
 
-			for (auto& thread : queue.Threads)
-				thread.UpdateUtilization();
+			pending = m_Pending;
 
-			pending = queue.Items.size();
+			for (auto& thread : m_Threads) {
+				boost::mutex::scoped_lock tlock(thread->Mutex);
 
-			for (auto& thread : queue.Threads) {
-				if (thread.State != ThreadDead && !thread.Zombie) {
+				thread->UpdateUtilization();
+
+				if (thread->State != ThreadDead && !thread->Zombie) {
 					alive++;
-					utilization += thread.Utilization * 100;
+					utilization += thread->Utilization * 100;
 				}
+
+				wait_time += thread->WaitTime;
+				task_count += thread->TaskCount;
+
+				thread->WaitTime = 0;
+				thread->ServiceTime = 0;
+				thread->TaskCount = 0;
 			}
 
-			utilization /= alive;
+			if (alive > 0)
+				utilization /= alive;
 
-			if (queue.TaskCount > 0)
-				avg_latency = queue.WaitTime / (queue.TaskCount * 1.0);
+			if (task_count > 0)
+				avg_latency = wait_time / (task_count * 1.0);
 			else
 				avg_latency = 0;
 
@@ -273,20 +418,20 @@ void ThreadPool::ManagerThreadProc()
 
 				int tthreads = wthreads - alive;
 
-				/* Make sure there is at least one thread per queue */
-				if (alive + tthreads < 1)
-					tthreads = 1 - alive;
+				/* Make sure there is a minimum number of threads */
+				if (alive + tthreads < l_MinThreads)
+					tthreads = l_MinThreads - alive;
 
-				/* Don't kill more than 2 threads at once. */
-				if (tthreads < -2)
-					tthreads = -2;
+				/* Don't kill too many threads at once. */
+				if (tthreads < -l_MaxAdjustment)
+					tthreads = -l_MaxAdjustment;
 
 				/* Spawn more workers if there are outstanding work items. */
 				if (tthreads > 0 && pending > 0)
-					tthreads = 2;
+					tthreads = l_MaxAdjustment;
 
-				if (m_MaxThreads != UINT_MAX && (alive + tthreads) * (sizeof(m_Queues) / sizeof(m_Queues[0])) > m_MaxThreads)
-					tthreads = m_MaxThreads / (sizeof(m_Queues) / sizeof(m_Queues[0])) - alive;
+				if (m_MaxThreads != UINT_MAX && alive + tthreads > m_MaxThreads)
+					tthreads = m_MaxThreads - alive;
 
 				if (tthreads != 0) {
 					Log(LogNotice, "ThreadPool")
@@ -294,20 +439,11 @@ void ThreadPool::ManagerThreadProc()
 				}
 
 				for (int i = 0; i < -tthreads; i++)
-					queue.KillWorker(m_ThreadGroup);
+					KillWorker();
 
 				for (int i = 0; i < tthreads; i++)
-					queue.SpawnWorker(m_ThreadGroup);
+					SpawnWorker();
 			}
-
-			queue.WaitTime = 0;
-			queue.ServiceTime = 0;
-			queue.TaskCount = 0;
-
-			total_pending += pending;
-			total_alive += alive;
-			total_avg_latency += avg_latency;
-			total_utilization += utilization;
 		}
 
 		double now = Utility::GetTime();
@@ -316,10 +452,10 @@ void ThreadPool::ManagerThreadProc()
 			lastStats = now;
 
 			Log(LogNotice, "ThreadPool")
-				<< "Pool #" << m_ID << ": Pending tasks: " << total_pending << "; Average latency: "
-				<< (long)(total_avg_latency * 1000 / (sizeof(m_Queues) / sizeof(m_Queues[0]))) << "ms"
-				<< "; Threads: " << total_alive
-				<< "; Pool utilization: " << (total_utilization / (sizeof(m_Queues) / sizeof(m_Queues[0]))) << "%";
+				<< "Pool #" << m_ID << ": Pending tasks: " << pending << "; Average latency: "
+				<< (long)(avg_latency * 1000) << "ms"
+				<< "; Threads: " << alive
+				<< "; Pool utilization: " << utilization << "%";
 		}
 	}
 }
@@ -327,35 +463,58 @@ void ThreadPool::ManagerThreadProc()
 /**
  * Note: Caller must hold m_Mutex
  */
-void ThreadPool::Queue::SpawnWorker(boost::thread_group& group)
+void ThreadPool::SpawnWorker()
 {
-	for (auto& thread : Threads) {
-		if (thread.State == ThreadDead) {
-			Log(LogDebug, "ThreadPool", "Spawning worker thread.");
+	WorkerThread *worker = nullptr;
+	int index = 0;
 
-			thread = WorkerThread(ThreadIdle);
-			thread.Thread = group.create_thread(std::bind(&ThreadPool::WorkerThread::ThreadProc, std::ref(thread), std::ref(*this)));
+	for (auto& thread : m_Threads) {
+		boost::mutex::scoped_lock tlock(thread->Mutex);
 
+		if (thread->State == ThreadDead && !thread->Zombie) {
+			worker = thread.get();
 			break;
 		}
+
+		index++;
+	}
+
+	if (!worker) {
+		m_Threads.emplace_back(new WorkerThread());
+		worker = m_Threads.back().get();
 	}
+
+	Log(LogDebug, "ThreadPool", "Spawning worker thread.");
+
+	boost::mutex::scoped_lock tlock(worker->Mutex);
+
+	worker->State = ThreadIdle;
+	worker->Utilization = 0;
+	worker->LastUpdate = 0;
+	worker->Pool = this;
+	/* Spread the workers evenly across the NUMA nodes. */
+	worker->Node = m_ID + index;
+	worker->Thread = m_ThreadGroup.create_thread(std::bind(&ThreadPool::WorkerThread::ThreadProc, worker, std::ref(*this)));
 }
 
 /**
- * Note: Caller must hold Mutex.
+ * Note: Caller must hold m_Mutex.
  */
-void ThreadPool::Queue::KillWorker(boost::thread_group& group)
+void ThreadPool::KillWorker()
 {
-	for (auto& thread : Threads) {
-		if (thread.State == ThreadIdle && !thread.Zombie) {
+	for (auto& thread : m_Threads) {
+		boost::mutex::scoped_lock tlock(thread->Mutex);
+
+		if (thread->State == ThreadIdle && !thread->Zombie) {
 			Log(LogDebug, "ThreadPool", "Killing worker thread.");
 
-			group.remove_thread(thread.Thread);
-			thread.Thread->detach();
-			delete thread.Thread;
+			m_ThreadGroup.remove_thread(thread->Thread);
+			thread->Thread->detach();
+			delete thread->Thread;
+			thread->Thread = nullptr;
 
-			thread.Zombie = true;
-			CV.notify_all();
+			thread->Zombie = true;
+			m_CV.notify_all();
 
 			break;
 		}
@@ -363,7 +522,7 @@ void ThreadPool::Queue::KillWorker(boost::thread_group& group)
 }
 
 /**
- * Note: Caller must hold queue Mutex.
+ * Note: Caller must hold the worker's Mutex.
  */
 void ThreadPool::WorkerThread::UpdateUtilization(ThreadState state)
 {
@@ -24,14 +24,16 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+#include <atomic>
 #include <deque>
+#include <memory>
 #include <thread>
+#include <vector>
 
 namespace icinga
 {
 
-#define QUEUECOUNT 4U
-
 enum SchedulerPolicy
 {
 	DefaultScheduler,
@@ -39,7 +41,13 @@ enum SchedulerPolicy
 };
 
 /**
- * A thread pool.
+ * A work-stealing thread pool.
+ *
+ * Each worker thread has its own queue. Work items which are posted from
+ * one of the pool's worker threads are added to that thread's queue, all
+ * other work items are added to a shared injector queue. Workers which
+ * run out of work take items from the injector queue or steal them from
+ * other workers.
  *
  * @ingroup base
  */
@@ -71,8 +79,6 @@ private:
 		double Timestamp;
 	};
 
-	struct Queue;
-
 	struct WorkerThread
 	{
 		ThreadState State{ThreadDead};
@@ -80,34 +86,22 @@ private:
 		double Utilization{0};
 		double LastUpdate{0};
 		boost::thread *Thread{nullptr};
+		int Node{0};
 
-		WorkerThread(ThreadState state = ThreadDead)
-			: State(state)
-		{ }
-
-		void UpdateUtilization(ThreadState state = ThreadUnspecified);
-
-		void ThreadProc(Queue& queue);
-	};
+		ThreadPool *Pool{nullptr};
 
-	struct Queue
-	{
+		/* Protects the work items, the state and the statistics. When both
+		 * locks are needed the pool's m_Mutex has to be acquired first. */
 		boost::mutex Mutex;
-		boost::condition_variable CV;
-		boost::condition_variable CVStarved;
-
 		std::deque<WorkItem> Items;
 
 		double WaitTime{0};
 		double ServiceTime{0};
 		int TaskCount{0};
 
-		bool Stopped{false};
-
-		WorkerThread Threads[16];
+		void UpdateUtilization(ThreadState state = ThreadUnspecified);
 
-		void SpawnWorker(boost::thread_group& group);
-		void KillWorker(boost::thread_group& group);
+		void ThreadProc(ThreadPool& pool);
 	};
 
 	int m_ID;
@@ -122,7 +116,24 @@ private:
 	boost::condition_variable m_MgmtCV;
 	bool m_Stopped{true};
 
-	Queue m_Queues[QUEUECOUNT];
+	/* Protects the injector queue and the list of workers. */
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	bool m_WorkersStopped{false};
+
+	std::deque<WorkItem> m_Injector;
+	std::vector<std::unique_ptr<WorkerThread> > m_Threads;
+
+	std::atomic<size_t> m_Pending{0};
+	std::atomic<size_t> m_IdleThreads{0};
+
+	static boost::thread_specific_ptr<WorkerThread> m_CurrentWorker;
+
+	bool GetWorkItem(WorkerThread& worker, WorkItem& wi, boost::mutex::scoped_lock& lock);
+	bool StealWorkItem(const WorkerThread& thief, WorkItem& wi);
+
+	void SpawnWorker();
+	void KillWorker();
 
 	void ManagerThreadProc();
 };
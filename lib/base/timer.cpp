@@ -21,59 +21,43 @@
 #include "base/debug.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
+#include "base/application.hpp"
+#include "base/exception.hpp"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/key_extractors.hpp>
+#include <algorithm>
+#include <cmath>
 #include <thread>
 
 using namespace icinga;
 
-namespace icinga {
-
-class TimerHolder {
-public:
-	TimerHolder(Timer *timer)
-		: m_Timer(timer)
-	{ }
+static boost::mutex l_TimerMutex;
+static boost::condition_variable l_TimerCV;
+static std::thread l_TimerThread;
+static bool l_StopTimerThread;
+static TimerWheel l_Timers(0.01);
+static int l_AliveTimers = 0;
 
-	inline Timer *GetObject() const
-	{
-		return m_Timer;
-	}
+/* The batch of timers the current thread is calling and the index of the timer it is calling. */
+static thread_local const std::vector<Timer::Ptr> *l_CurrentBatch = nullptr;
+static thread_local size_t l_CurrentBatchIndex = 0;
 
-	inline double GetNextUnlocked() const
-	{
-		return m_Timer->m_Next;
-	}
+/**
+ * Checks whether a timer is still to be called by the current thread's batch.
+ */
+static bool IsPendingInCurrentBatch(const Timer *timer)
+{
+	if (!l_CurrentBatch)
+		return false;
 
-	operator Timer *() const
-	{
-		return m_Timer;
+	for (size_t i = l_CurrentBatchIndex + 1; i < l_CurrentBatch->size(); i++) {
+		if ((*l_CurrentBatch)[i].get() == timer)
+			return true;
 	}
 
-private:
-	Timer *m_Timer;
-};
-
+	return false;
 }
 
-typedef boost::multi_index_container<
-	TimerHolder,
-	boost::multi_index::indexed_by<
-		boost::multi_index::ordered_unique<boost::multi_index::const_mem_fun<TimerHolder, Timer *, &TimerHolder::GetObject> >,
-		boost::multi_index::ordered_non_unique<boost::multi_index::const_mem_fun<TimerHolder, double, &TimerHolder::GetNextUnlocked> >
-	>
-> TimerSet;
-
-static boost::mutex l_TimerMutex;
-static boost::condition_variable l_TimerCV;
-static std::thread l_TimerThread;
-static bool l_StopTimerThread;
-static TimerSet l_Timers;
-static int l_AliveTimers = 0;
-
 /**
  * Destructor for the Timer class.
  */
@@ -159,6 +143,30 @@ double Timer::GetInterval() const
 	return m_Interval;
 }
 
+/**
+ * Sets how much later than scheduled the timer may run. Timers with slack
+ * are due at the next multiple of their slack, so that timers which are due
+ * at about the same time expire together.
+ *
+ * @param slack The slack in seconds.
+ */
+void Timer::SetSlack(double slack)
+{
+	boost::mutex::scoped_lock lock(l_TimerMutex);
+	m_Slack = slack;
+}
+
+/**
+ * Retrieves the slack for this timer.
+ *
+ * @returns The slack.
+ */
+double Timer::GetSlack() const
+{
+	boost::mutex::scoped_lock lock(l_TimerMutex);
+	return m_Slack;
+}
+
 /**
  * Registers the timer and starts processing events for it.
  */
@@ -191,12 +199,13 @@ void Timer::Stop(bool wait)
 	}
 
 	m_Started = false;
-	l_Timers.erase(this);
+	l_Timers.Remove(this);
 
 	/* Notify the worker thread that we've disabled a timer. */
 	l_TimerCV.notify_all();
 
-	while (wait && m_Running)
+	/* Timers which are still to be called by this thread's batch are skipped instead. */
+	while (wait && m_Running && !IsPendingInCurrentBatch(this))
 		l_TimerCV.wait(lock);
 }
 
@@ -227,12 +236,13 @@ void Timer::InternalReschedule(bool completed, double next)
 		next = Utility::GetTime() + m_Interval;
 	}
 
+	if (m_Slack > 0)
+		next = std::ceil(next / m_Slack) * m_Slack;
+
 	m_Next = next;
 
 	if (m_Started && !m_Running) {
-		/* Remove and re-add the timer to update the index. */
-		l_Timers.erase(this);
-		l_Timers.insert(this);
+		l_Timers.Reschedule(this, m_Next);
 
 		/* Notify the worker that we've rescheduled a timer. */
 		l_TimerCV.notify_all();
@@ -262,28 +272,57 @@ void Timer::AdjustTimers(double adjustment)
 
 	double now = Utility::GetTime();
 
-	typedef boost::multi_index::nth_index<TimerSet, 1>::type TimerView;
-	TimerView& idx = boost::get<1>(l_Timers);
+	for (TimerWheelEntry *entry : l_Timers.GetEntries()) {
+		Timer *timer = static_cast<Timer *>(entry);
 
-	std::vector<Timer *> timers;
-
-	for (Timer *timer : idx) {
 		if (std::fabs(now - (timer->m_Next + adjustment)) <
 			std::fabs(now - timer->m_Next)) {
 			timer->m_Next += adjustment;
-			timers.push_back(timer);
+			l_Timers.Reschedule(timer, timer->m_Next);
 		}
 	}
 
-	for (Timer *timer : timers) {
-		l_Timers.erase(timer);
-		l_Timers.insert(timer);
-	}
-
 	/* Notify the worker that we've rescheduled some timers. */
 	l_TimerCV.notify_all();
 }
 
+/**
+ * Calls timers which expired at the same time one after another.
+ */
+void Timer::CallBatch(const std::vector<Timer::Ptr>& timers)
+{
+	l_CurrentBatch = &timers;
+
+	for (size_t i = 0; i < timers.size(); i++) {
+		const Timer::Ptr& timer = timers[i];
+
+		l_CurrentBatchIndex = i;
+
+		{
+			boost::mutex::scoped_lock lock(l_TimerMutex);
+
+			/* The timer was stopped by one of the previous timers. */
+			if (!timer->m_Started) {
+				timer->m_Running = false;
+				l_TimerCV.notify_all();
+				continue;
+			}
+		}
+
+		try {
+			timer->Call();
+		} catch (const std::exception& ex) {
+			Log(LogCritical, "Timer")
+				<< "Exception thrown in timer handler:\n"
+				<< DiagnosticInformation(ex);
+		} catch (...) {
+			Log(LogCritical, "Timer", "Exception of unknown type thrown in timer handler.");
+		}
+	}
+
+	l_CurrentBatch = nullptr;
+}
+
 /**
  * Worker thread proc for Timer objects.
  */
@@ -296,39 +335,48 @@ void Timer::TimerThreadProc()
 	for (;;) {
 		boost::mutex::scoped_lock lock(l_TimerMutex);
 
-		typedef boost::multi_index::nth_index<TimerSet, 1>::type NextTimerView;
-		NextTimerView& idx = boost::get<1>(l_Timers);
-
 		/* Wait until there is at least one timer. */
-		while (idx.empty() && !l_StopTimerThread)
+		while (l_Timers.IsEmpty() && !l_StopTimerThread)
 			l_TimerCV.wait(lock);
 
 		if (l_StopTimerThread)
 			break;
 
-		auto it = idx.begin();
-		Timer *timer = *it;
+		double now = Utility::GetTime();
+
+		/* Removing the timers from the wheel makes sure they don't get
+		 * called again until the current call is completed. */
+		std::vector<Timer::Ptr> expired;
 
-		double wait = timer->m_Next - Utility::GetTime();
+		while (Timer *timer = static_cast<Timer *>(l_Timers.PopExpired(now))) {
+			timer->m_Running = true;
+			expired.emplace_back(timer);
+		}
 
-		if (wait > 0.01) {
+		if (expired.empty()) {
 			/* Wait for the next timer. */
-			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
+			double wait = l_Timers.GetNextExpiry() - now;
+			l_TimerCV.timed_wait(lock, boost::posix_time::milliseconds(long(std::ceil(wait * 1000))));
 
 			continue;
 		}
 
-		Timer::Ptr ptimer = timer;
+		lock.unlock();
 
-		/* Remove the timer from the list so it doesn't get called again
-		 * until the current call is completed. */
-		l_Timers.erase(timer);
+		/* Asynchronously call the timers. Timers which expired at the same time
+		 * are distributed over at most as many callbacks as there are cores. */
+		if (expired.size() == 1) {
+			Utility::QueueAsyncCallback(std::bind(&Timer::Call, expired[0]));
+			continue;
+		}
 
-		timer->m_Running = true;
+		size_t batchCount = std::min<size_t>(expired.size(), std::max(1, Application::GetConcurrency()));
+		std::vector<std::vector<Timer::Ptr> > batches(batchCount);
 
-		lock.unlock();
+		for (size_t i = 0; i < expired.size(); i++)
+			batches[i % batchCount].push_back(std::move(expired[i]));
 
-		/* Asynchronously call the timer. */
-		Utility::QueueAsyncCallback(std::bind(&Timer::Call, ptimer));
+		for (auto& batch : batches)
+			Utility::QueueAsyncCallback(std::bind(&Timer::CallBatch, std::move(batch)));
 	}
 }
@@ -22,18 +22,18 @@
 
 #include "base/i2-base.hpp"
 #include "base/object.hpp"
+#include "base/timerwheel.hpp"
 #include <boost/signals2.hpp>
+#include <vector>
 
 namespace icinga {
 
-class TimerHolder;
-
 /**
  * A timer that periodically triggers an event.
  *
  * @ingroup base
  */
-class Timer final : public Object
+class Timer final : public Object, private TimerWheelEntry
 {
 public:
 	DECLARE_PTR_TYPEDEFS(Timer);
@@ -48,6 +48,9 @@ public:
 	void SetInterval(double interval);
 	double GetInterval() const;
 
+	void SetSlack(double slack);
+	double GetSlack() const;
+
 	static void AdjustTimers(double adjustment);
 
 	void Start();
@@ -61,15 +64,15 @@ public:
 private:
 	double m_Interval{0}; /**< The interval of the timer. */
 	double m_Next{0}; /**< When the next event should happen. */
+	double m_Slack{0}; /**< How much later than scheduled the timer may run. */
 	bool m_Started{false}; /**< Whether the timer is enabled. */
 	bool m_Running{false}; /**< Whether the timer proc is currently running. */
 
 	void Call();
 	void InternalReschedule(bool completed, double next = -1);
 
+	static void CallBatch(const std::vector<Timer::Ptr>& timers);
 	static void TimerThreadProc();
-
-	friend class TimerHolder;
 };
 
 }
@@ -0,0 +1,404 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/timerwheel.hpp"
+#include "base/debug.hpp"
+#include <cmath>
+#include <limits>
+
+using namespace icinga;
+
+TimerWheelEntry::~TimerWheelEntry()
+{
+	if (m_Wheel)
+		m_Wheel->Remove(this);
+}
+
+/**
+ * Checks whether the entry is currently scheduled in a timer wheel.
+ *
+ * @returns true if the entry is scheduled, false otherwise.
+ */
+bool TimerWheelEntry::IsScheduled() const
+{
+	return m_Wheel != nullptr;
+}
+
+/**
+ * Retrieves the timestamp the entry was last scheduled for.
+ *
+ * @returns The timestamp.
+ */
+double TimerWheelEntry::GetWhen() const
+{
+	return m_When;
+}
+
+/**
+ * Constructor for the TimerWheel class.
+ *
+ * @param resolution The length of a tick in seconds.
+ */
+TimerWheel::TimerWheel(double resolution)
+	: m_Resolution(resolution)
+{
+	for (int level = 0; level < Levels; level++) {
+		for (int slot = 0; slot < SlotsPerLevel; slot++) {
+			TimerWheelEntry *list = &m_Slots[level][slot];
+			list->m_Prev = list;
+			list->m_Next = list;
+		}
+
+		m_Occupied[level] = 0;
+	}
+
+	m_Overflow.m_Prev = &m_Overflow;
+	m_Overflow.m_Next = &m_Overflow;
+	m_Expired.m_Prev = &m_Expired;
+	m_Expired.m_Next = &m_Expired;
+}
+
+TimerWheel::~TimerWheel()
+{
+	for (TimerWheelEntry *entry : GetEntries()) {
+		Unlink(entry);
+		entry->m_Wheel = nullptr;
+	}
+}
+
+/**
+ * Schedules an entry. The entry must not be scheduled already.
+ *
+ * @param entry The entry.
+ * @param when When the entry is due.
+ */
+void TimerWheel::Insert(TimerWheelEntry *entry, double when)
+{
+	ASSERT(!entry->m_Wheel);
+
+	uint64_t tick = 0;
+
+	if (when > 0)
+		tick = static_cast<uint64_t>(std::ceil(when / m_Resolution));
+
+	entry->m_Wheel = this;
+	entry->m_When = when;
+	entry->m_Tick = tick;
+
+	InsertTick(entry);
+
+	m_Length++;
+}
+
+/**
+ * Removes an entry from the wheel. Does nothing if the entry isn't
+ * scheduled.
+ *
+ * @param entry The entry.
+ */
+void TimerWheel::Remove(TimerWheelEntry *entry)
+{
+	if (!entry->m_Wheel)
+		return;
+
+	ASSERT(entry->m_Wheel == this);
+
+	Unlink(entry);
+
+	if (entry->m_Level >= 0) {
+		TimerWheelEntry *list = GetList(entry->m_Level, entry->m_Tick);
+
+		if (list->m_Next == list)
+			m_Occupied[entry->m_Level] &= ~(UINT64_C(1) << (list - m_Slots[entry->m_Level]));
+	}
+
+	entry->m_Wheel = nullptr;
+	m_Length--;
+}
+
+/**
+ * Changes when an entry is due, scheduling the entry if necessary.
+ *
+ * @param entry The entry.
+ * @param when When the entry is due.
+ */
+void TimerWheel::Reschedule(TimerWheelEntry *entry, double when)
+{
+	Remove(entry);
+	Insert(entry, when);
+}
+
+/**
+ * Removes and returns an entry which is due.
+ *
+ * @param now The current time.
+ * @returns The entry or nullptr if no entry is due.
+ */
+TimerWheelEntry *TimerWheel::PopExpired(double now)
+{
+	if (m_Expired.m_Next == &m_Expired && now >= 0)
+		Advance(static_cast<uint64_t>(std::floor(now / m_Resolution)));
+
+	TimerWheelEntry *entry = m_Expired.m_Next;
+
+	if (entry == &m_Expired)
+		return nullptr;
+
+	Unlink(entry);
+	entry->m_Wheel = nullptr;
+	m_Length--;
+
+	return entry;
+}
+
+/**
+ * Retrieves the earliest time at which one of the entries might become
+ * due. This is a lower bound which is suitable for sleeping until the next
+ * PopExpired() call.
+ *
+ * @returns The timestamp, or infinity if the wheel is empty.
+ */
+double TimerWheel::GetNextExpiry() const
+{
+	if (m_Length == 0)
+		return std::numeric_limits<double>::infinity();
+
+	if (m_Expired.m_Next != &m_Expired)
+		return 0;
+
+	if (m_Occupied[0] & (UINT64_C(1) << (m_CurrentTick & (SlotsPerLevel - 1))))
+		return m_CurrentTick * m_Resolution;
+
+	uint64_t tick = GetNextOccupiedTick();
+
+	if (tick == std::numeric_limits<uint64_t>::max())
+		return std::numeric_limits<double>::infinity();
+
+	return tick * m_Resolution;
+}
+
+TimerWheel::SizeType TimerWheel::GetLength() const
+{
+	return m_Length;
+}
+
+bool TimerWheel::IsEmpty() const
+{
+	return m_Length == 0;
+}
+
+/**
+ * Retrieves all scheduled entries in no particular order.
+ *
+ * @returns The entries.
+ */
+std::vector<TimerWheelEntry *> TimerWheel::GetEntries() const
+{
+	std::vector<TimerWheelEntry *> entries;
+	entries.reserve(m_Length);
+
+	auto collect = [&entries](const TimerWheelEntry *list) {
+		for (TimerWheelEntry *entry = list->m_Next; entry != list; entry = entry->m_Next)
+			entries.push_back(entry);
+	};
+
+	for (int level = 0; level < Levels; level++) {
+		for (int slot = 0; slot < SlotsPerLevel; slot++)
+			collect(&m_Slots[level][slot]);
+	}
+
+	collect(&m_Overflow);
+	collect(&m_Expired);
+
+	return entries;
+}
+
+TimerWheelEntry *TimerWheel::GetList(int level, uint64_t tick)
+{
+	return &m_Slots[level][(tick >> (level * LevelBits)) & (SlotsPerLevel - 1)];
+}
+
+/**
+ * Links an entry into the list it belongs to based on its tick and the
+ * current tick.
+ */
+void TimerWheel::InsertTick(TimerWheelEntry *entry)
+{
+	if (entry->m_Tick < m_CurrentTick) {
+		entry->m_Level = LevelExpired;
+		Link(&m_Expired, entry);
+		return;
+	}
+
+	/* The level is determined by the most significant digit in which
+	 * the entry's tick differs from the current tick. */
+	uint64_t diff = entry->m_Tick ^ m_CurrentTick;
+	int level = 0;
+
+	while (diff >= SlotsPerLevel) {
+		diff >>= LevelBits;
+		level++;
+	}
+
+	if (level >= Levels) {
+		entry->m_Level = LevelOverflow;
+		Link(&m_Overflow, entry);
+		return;
+	}
+
+	TimerWheelEntry *list = GetList(level, entry->m_Tick);
+
+	entry->m_Level = level;
+	Link(list, entry);
+	m_Occupied[level] |= UINT64_C(1) << (list - m_Slots[level]);
+}
+
+/**
+ * Processes all ticks up to and including the target tick, moving entries
+ * which have become due to the list of expired entries.
+ */
+void TimerWheel::Advance(uint64_t target)
+{
+	while (m_CurrentTick <= target) {
+		TimerWheelEntry *list = GetList(0, m_CurrentTick);
+
+		if (list->m_Next != list) {
+			while (list->m_Next != list) {
+				TimerWheelEntry *entry = list->m_Next;
+				Unlink(entry);
+				entry->m_Level = LevelExpired;
+				Link(&m_Expired, entry);
+			}
+
+			m_Occupied[0] &= ~(UINT64_C(1) << (list - m_Slots[0]));
+		}
+
+		uint64_t next = GetNextOccupiedTick();
+
+		if (next > target)
+			next = target + 1;
+
+		SetCurrentTick(next);
+	}
+}
+
+/**
+ * Moves the current tick forward. There must not be any scheduled entries
+ * between the current tick and the new tick.
+ */
+void TimerWheel::SetCurrentTick(uint64_t tick)
+{
+	uint64_t previous = m_CurrentTick;
+	m_CurrentTick = tick;
+
+	if ((previous >> (Levels * LevelBits)) != (tick >> (Levels * LevelBits)))
+		Cascade(&m_Overflow);
+
+	/* Entries in the slots matching the new tick's digits have to be moved
+	 * to the lower levels, starting with the highest level. */
+	for (int level = Levels - 1; level > 0; level--) {
+		TimerWheelEntry *list = GetList(level, tick);
+
+		if (list->m_Next != list) {
+			m_Occupied[level] &= ~(UINT64_C(1) << (list - m_Slots[level]));
+			Cascade(list);
+		}
+	}
+}
+
+void TimerWheel::Cascade(TimerWheelEntry *list)
+{
+	TimerWheelEntry head;
+	head.m_Prev = &head;
+	head.m_Next = &head;
+
+	/* Move the entries to a temporary list first; InsertTick() might
+	 * put them back into the same list. */
+	while (list->m_Next != list) {
+		TimerWheelEntry *entry = list->m_Next;
+		Unlink(entry);
+		Link(&head, entry);
+	}
+
+	while (head.m_Next != &head) {
+		TimerWheelEntry *entry = head.m_Next;
+		Unlink(entry);
+		InsertTick(entry);
+	}
+}
+
+/**
+ * Finds the next tick after the current tick at which entries have to be
+ * processed, either because they're due or because they need to be moved
+ * to a lower level.
+ */
+uint64_t TimerWheel::GetNextOccupiedTick() const
+{
+	for (int level = 0; level < Levels; level++) {
+		int shift = level * LevelBits;
+		int digit = (m_CurrentTick >> shift) & (SlotsPerLevel - 1);
+
+		/* Only slots after the current one are of interest, those
+		 * before it would belong to the next rotation. */
+		uint64_t mask = (digit == SlotsPerLevel - 1) ? 0 : ~((UINT64_C(2) << digit) - 1);
+		uint64_t occupied = m_Occupied[level] & mask;
+
+		if (occupied != 0) {
+			uint64_t base = (m_CurrentTick >> (shift + LevelBits)) << (shift + LevelBits);
+			return base | (static_cast<uint64_t>(FindFirstSet(occupied)) << shift);
+		}
+	}
+
+	if (m_Overflow.m_Next != &m_Overflow)
+		return ((m_CurrentTick >> (Levels * LevelBits)) + 1) << (Levels * LevelBits);
+
+	return std::numeric_limits<uint64_t>::max();
+}
+
+void TimerWheel::Link(TimerWheelEntry *list, TimerWheelEntry *entry)
+{
+	entry->m_Prev = list->m_Prev;
+	entry->m_Next = list;
+	list->m_Prev->m_Next = entry;
+	list->m_Prev = entry;
+}
+
+void TimerWheel::Unlink(TimerWheelEntry *entry)
+{
+	entry->m_Prev->m_Next = entry->m_Next;
+	entry->m_Next->m_Prev = entry->m_Prev;
+	entry->m_Prev = nullptr;
+	entry->m_Next = nullptr;
+}
+
+int TimerWheel::FindFirstSet(uint64_t value)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(value);
+#else /* __GNUC__ */
+	int bit = 0;
+
+	while (!(value & 1)) {
+		value >>= 1;
+		bit++;
+	}
+
+	return bit;
+#endif /* __GNUC__ */
+}
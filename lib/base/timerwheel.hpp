@@ -0,0 +1,126 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "base/i2-base.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace icinga
+{
+
+class TimerWheel;
+
+/**
+ * An entry which can be scheduled in a timer wheel. Classes which want
+ * to be scheduled derive from this class; the wheel links the entries
+ * into its slots directly and does not allocate memory on its own.
+ *
+ * @ingroup base
+ */
+class TimerWheelEntry
+{
+public:
+	TimerWheelEntry() = default;
+	TimerWheelEntry(const TimerWheelEntry&) = delete;
+	TimerWheelEntry& operator=(const TimerWheelEntry&) = delete;
+	~TimerWheelEntry();
+
+	bool IsScheduled() const;
+	double GetWhen() const;
+
+private:
+	TimerWheelEntry *m_Prev{nullptr};
+	TimerWheelEntry *m_Next{nullptr};
+	TimerWheel *m_Wheel{nullptr};
+	double m_When{0};
+	uint64_t m_Tick{0};
+	int m_Level{0};
+
+	friend class TimerWheel;
+};
+
+/**
+ * A hierarchical timing wheel. Inserting, rescheduling and removing
+ * entries takes constant time.
+ *
+ * Entries are never returned before they are due; they may however
+ * be returned up to one tick (i.e. the resolution) late.
+ *
+ * @threadsafety Callers have to provide their own locking.
+ * @ingroup base
+ */
+class TimerWheel final
+{
+public:
+	typedef std::vector<TimerWheelEntry *>::size_type SizeType;
+
+	TimerWheel(double resolution);
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+	~TimerWheel();
+
+	void Insert(TimerWheelEntry *entry, double when);
+	void Remove(TimerWheelEntry *entry);
+	void Reschedule(TimerWheelEntry *entry, double when);
+
+	TimerWheelEntry *PopExpired(double now);
+	double GetNextExpiry() const;
+
+	SizeType GetLength() const;
+	bool IsEmpty() const;
+
+	std::vector<TimerWheelEntry *> GetEntries() const;
+
+private:
+	static const int LevelBits = 6;
+	static const int SlotsPerLevel = 1 << LevelBits;
+	static const int Levels = 6;
+
+	/* Pseudo levels for entries which aren't stored in a slot. */
+	static const int LevelExpired = -1;
+	static const int LevelOverflow = -2;
+
+	double m_Resolution;
+	uint64_t m_CurrentTick{0}; /**< All ticks before this one have been processed. */
+	SizeType m_Length{0};
+
+	TimerWheelEntry m_Slots[Levels][SlotsPerLevel];
+	uint64_t m_Occupied[Levels];
+	TimerWheelEntry m_Overflow;
+	TimerWheelEntry m_Expired;
+
+	TimerWheelEntry *GetList(int level, uint64_t tick);
+
+	void InsertTick(TimerWheelEntry *entry);
+	void Advance(uint64_t target);
+	void SetCurrentTick(uint64_t tick);
+	void Cascade(TimerWheelEntry *list);
+	uint64_t GetNextOccupiedTick() const;
+
+	static void Link(TimerWheelEntry *list, TimerWheelEntry *entry);
+	static void Unlink(TimerWheelEntry *entry);
+	static int FindFirstSet(uint64_t value);
+};
+
+}
+
+#endif /* TIMERWHEEL_H */
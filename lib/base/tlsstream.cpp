@@ -22,6 +22,8 @@
 #include "base/exception.hpp"
 #include "base/logger.hpp"
 #include <iostream>
+#include <atomic>
+#include <algorithm>
 
 #ifndef _WIN32
 #	include <poll.h>
@@ -29,11 +31,25 @@
 
 #define TLS_TIMEOUT_SECONDS 10
 
+/* The maximum amount of plaintext in a single TLS record. */
+#define TLS_RECORD_SIZE (16 * 1024)
+#define TLS_DEFAULT_READ_LIMIT (64 * 1024)
+#define TLS_MAX_READ_LIMIT (1024 * 1024)
+#define TLS_MAX_WRITE_PER_EVENT (256 * 1024)
+
 using namespace icinga;
 
 int TlsStream::m_SSLIndex;
 bool TlsStream::m_SSLIndexInitialized = false;
 
+static std::atomic<uint_fast64_t> l_ServerHandshakes(0);
+static std::atomic<uint_fast64_t> l_ServerResumedHandshakes(0);
+static std::atomic<uint_fast64_t> l_ClientHandshakes(0);
+static std::atomic<uint_fast64_t> l_ClientResumedHandshakes(0);
+
+/* Send queue data which is split across FIFO chunks is gathered here. */
+static thread_local char l_WriteRecord[TLS_RECORD_SIZE];
+
 /**
  * Constructor for the TlsStream class.
  *
@@ -116,6 +132,54 @@ String TlsStream::GetVerifyError() const
 	return m_VerifyError;
 }
 
+/**
+ * Offers a previous session to the server so that it can be resumed
+ * without a full handshake. Must be called before Handshake().
+ *
+ * @param session The session, see GetSession().
+ */
+void TlsStream::SetSession(const std::shared_ptr<SSL_SESSION>& session)
+{
+	ASSERT(m_Role == RoleClient);
+
+	SSL_set_session(m_SSL.get(), session.get());
+}
+
+std::shared_ptr<SSL_SESSION> TlsStream::GetSession() const
+{
+	SSL_SESSION *session = SSL_get1_session(m_SSL.get());
+
+	if (!session)
+		return nullptr;
+
+	return std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free);
+}
+
+bool TlsStream::IsSessionReused() const
+{
+	return SSL_session_reused(m_SSL.get());
+}
+
+/**
+ * Returns the number of full and resumed handshakes since the start.
+ */
+Dictionary::Ptr TlsStream::GetHandshakeStats()
+{
+	double serverHandshakes = l_ServerHandshakes;
+	double serverResumed = l_ServerResumedHandshakes;
+	double clientHandshakes = l_ClientHandshakes;
+	double clientResumed = l_ClientResumedHandshakes;
+
+	return new Dictionary({
+		{ "server_handshakes", serverHandshakes },
+		{ "server_resumed", serverResumed },
+		{ "server_resumption_rate", serverHandshakes > 0 ? serverResumed / serverHandshakes : 0 },
+		{ "client_handshakes", clientHandshakes },
+		{ "client_resumed", clientResumed },
+		{ "client_resumption_rate", clientHandshakes > 0 ? clientResumed / clientHandshakes : 0 }
+	});
+}
+
 /**
  * Retrieves the X509 certficate for this client.
  *
@@ -148,8 +212,6 @@ void TlsStream::OnEvent(int revents)
 	if (!m_SSL)
 		return;
 
-	char buffer[64 * 1024];
-
 	if (m_CurrentAction == TlsActionNone) {
 		bool corked = IsCorked();
 		if (!corked && (revents & (POLLIN | POLLERR | POLLHUP)))
@@ -178,13 +240,22 @@ void TlsStream::OnEvent(int revents)
 	switch (m_CurrentAction) {
 		case TlsActionRead:
 			do {
-				rc = SSL_read(m_SSL.get(), buffer, sizeof(buffer));
+				/* Read directly into the receive queue. A single TLS record
+				 * holds at most 16 KiB, grow the chunk up to that size while
+				 * the records are filling it. */
+				char *buffer = m_RecvQ->GetWriteBuffer(m_ReadChunkSize);
+				rc = SSL_read(m_SSL.get(), buffer, m_ReadChunkSize);
 
 				if (rc > 0) {
-					m_RecvQ->Write(buffer, rc);
+					m_RecvQ->CommitWrite(rc);
 					success = true;
 
 					readTotal += rc;
+
+					if (static_cast<size_t>(rc) == m_ReadChunkSize && m_ReadChunkSize < TLS_RECORD_SIZE)
+						m_ReadChunkSize *= 2;
+					else if (static_cast<size_t>(rc) < m_ReadChunkSize / 4 && m_ReadChunkSize > 4096)
+						m_ReadChunkSize /= 2;
 				}
 
 #ifdef I2_DEBUG /* I2_DEBUG */
@@ -194,7 +265,7 @@ void TlsStream::OnEvent(int revents)
 				/* Limit read size. We cannot do this check inside the while loop
 				 * since below should solely check whether OpenSSL has more data
 				 * or not. */
-				if (readTotal >= 64 * 1024) {
+				if (readTotal >= m_ReadLimit) {
 #ifdef I2_DEBUG /* I2_DEBUG */
 					Log(LogWarning, "TlsStream")
 						<< "Maximum read bytes exceeded: " << readTotal;
@@ -207,25 +278,77 @@ void TlsStream::OnEvent(int revents)
 			 */
 			} while (SSL_pending(m_SSL.get()));
 
+			/* Busy connections may read more per event, idle ones fall back to the default. */
+			if (readTotal >= m_ReadLimit)
+				m_ReadLimit = std::min<size_t>(m_ReadLimit * 2, TLS_MAX_READ_LIMIT);
+			else if (readTotal < m_ReadLimit / 4 && m_ReadLimit > TLS_DEFAULT_READ_LIMIT)
+				m_ReadLimit /= 2;
+
 			if (success)
 				m_CV.notify_all();
 
 			break;
 		case TlsActionWrite:
-			count = m_SendQ->Peek(buffer, sizeof(buffer), true);
+			/* Write everything that was queued since the last event in
+			 * full-sized TLS records. Messages which were queued together
+			 * share records instead of getting one record each. */
+			count = 0;
 
-			rc = SSL_write(m_SSL.get(), buffer, count);
+			do {
+				size_t length;
+				const char *buffer = m_SendQ->GetReadBuffer(&length);
 
-			if (rc > 0) {
-				m_SendQ->Read(nullptr, rc, true);
-				success = true;
-			}
+				/* Gather a full record if the data is split across chunks. */
+				if (length < TLS_RECORD_SIZE && length < m_SendQ->GetAvailableBytes()) {
+					length = m_SendQ->Peek(l_WriteRecord, TLS_RECORD_SIZE, true);
+					buffer = l_WriteRecord;
+				} else if (length > TLS_RECORD_SIZE)
+					length = TLS_RECORD_SIZE;
+
+				rc = SSL_write(m_SSL.get(), buffer, length);
+
+				/* A failed write has to be retried with the same data, see
+				 * SSL_write(3). Don't let the next event start a read instead. */
+				success = rc > 0;
+
+				if (success) {
+					m_SendQ->Read(nullptr, rc, true);
+					count += rc;
+				}
+			} while (success && m_SendQ->GetAvailableBytes() > 0 && count < TLS_MAX_WRITE_PER_EVENT);
 
 			break;
 		case TlsActionHandshake:
 			rc = SSL_do_handshake(m_SSL.get());
 
 			if (rc > 0) {
+				bool reused = SSL_session_reused(m_SSL.get());
+
+				/* The certificate isn't verified again for resumed sessions,
+				 * use the result from the original handshake instead. */
+				if (reused) {
+					long result = SSL_get_verify_result(m_SSL.get());
+
+					if (result != X509_V_OK) {
+						std::ostringstream msgbuf;
+						msgbuf << "code " << result << ": " << X509_verify_cert_error_string(result);
+						m_VerifyOK = false;
+						m_VerifyError = msgbuf.str();
+					}
+				}
+
+				if (m_Role == RoleServer) {
+					l_ServerHandshakes++;
+
+					if (reused)
+						l_ServerResumedHandshakes++;
+				} else {
+					l_ClientHandshakes++;
+
+					if (reused)
+						l_ClientResumedHandshakes++;
+				}
+
 				success = true;
 				m_HandshakeOK = true;
 				m_CV.notify_all();
@@ -276,6 +399,11 @@ void TlsStream::OnEvent(int revents)
 	}
 
 	if (success) {
+		std::function<void ()> sendQueueLowCallback;
+
+		if (m_CurrentAction == TlsActionWrite && m_SendQ->GetAvailableBytes() < m_SendQueueLowThreshold)
+			sendQueueLowCallback = m_SendQueueLowCallback;
+
 		m_CurrentAction = TlsActionNone;
 
 		if (!m_Eof) {
@@ -287,6 +415,9 @@ void TlsStream::OnEvent(int revents)
 
 		lock.unlock();
 
+		if (sendQueueLowCallback)
+			sendQueueLowCallback();
+
 		while (!IsCorked() && m_RecvQ->IsDataAvailable() && IsHandlingEvents())
 			SignalDataAvailable();
 	}
@@ -368,6 +499,28 @@ void TlsStream::Write(const void *buffer, size_t count)
 	ChangeEvents(POLLIN|POLLOUT);
 }
 
+/**
+ * Returns the number of bytes which have been written but not sent yet.
+ */
+size_t TlsStream::GetSendQueueLength() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	return m_SendQ->GetAvailableBytes();
+}
+
+/**
+ * Sets a callback which is invoked whenever data was sent and less than
+ * the threshold is left in the send queue.
+ */
+void TlsStream::SetSendQueueLowCallback(const std::function<void ()>& callback, size_t threshold)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_SendQueueLowCallback = callback;
+	m_SendQueueLowThreshold = threshold;
+}
+
 void TlsStream::Shutdown()
 {
 	m_Shutdown = true;
@@ -398,6 +551,9 @@ void TlsStream::CloseInternal(bool inDestructor)
 
 	boost::mutex::scoped_lock lock(m_Mutex);
 
+	/* The callback may hold a reference to the stream's owner. */
+	m_SendQueueLowCallback = nullptr;
+
 	if (!m_SSL)
 		return;
 
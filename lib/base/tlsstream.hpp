@@ -26,6 +26,8 @@
 #include "base/stream.hpp"
 #include "base/tlsutility.hpp"
 #include "base/fifo.hpp"
+#include "base/dictionary.hpp"
+#include <functional>
 
 namespace icinga
 {
@@ -72,9 +74,18 @@ public:
 
 	void SetCorked(bool corked) override;
 
+	size_t GetSendQueueLength() const;
+	void SetSendQueueLowCallback(const std::function<void ()>& callback, size_t threshold);
+
 	bool IsVerifyOK() const;
 	String GetVerifyError() const;
 
+	void SetSession(const std::shared_ptr<SSL_SESSION>& session);
+	std::shared_ptr<SSL_SESSION> GetSession() const;
+	bool IsSessionReused() const;
+
+	static Dictionary::Ptr GetHandshakeStats();
+
 private:
 	std::shared_ptr<SSL> m_SSL;
 	bool m_Eof;
@@ -92,10 +103,16 @@ private:
 	FIFO::Ptr m_SendQ;
 	FIFO::Ptr m_RecvQ;
 
+	std::function<void ()> m_SendQueueLowCallback;
+	size_t m_SendQueueLowThreshold{0};
+
 	TlsAction m_CurrentAction;
 	bool m_Retry;
 	bool m_Shutdown;
 
+	size_t m_ReadChunkSize{4096};
+	size_t m_ReadLimit{64 * 1024};
+
 	static int m_SSLIndex;
 	static bool m_SSLIndexInitialized;
 
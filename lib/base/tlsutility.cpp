@@ -101,6 +101,12 @@ std::shared_ptr<SSL_CTX> MakeSSLContext(const String& pubkey, const String& priv
 	SSL_CTX_set_mode(sslContext.get(), SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 	SSL_CTX_set_session_id_context(sslContext.get(), (const unsigned char *)"Icinga 2", 8);
 
+	/* Allow clients to resume their sessions (by ID or ticket) for an hour
+	 * so that reconnects don't need a full handshake. */
+	SSL_CTX_set_session_cache_mode(sslContext.get(), SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(sslContext.get(), 20480);
+	SSL_CTX_set_timeout(sslContext.get(), 3600);
+
 	if (!pubkey.IsEmpty()) {
 		if (!SSL_CTX_use_certificate_chain_file(sslContext.get(), pubkey.CStr())) {
 			Log(LogCritical, "SSL")
@@ -210,6 +216,64 @@ void SetTlsProtocolminToSSLContext(const std::shared_ptr<SSL_CTX>& context, cons
 	SSL_CTX_set_options(context.get(), flags);
 }
 
+/**
+ * Sets the keys which are used to encrypt TLS session tickets. The keys are
+ * kept in a file so that clients can still resume their sessions after a
+ * restart. They are replaced once they're older than maxAge.
+ *
+ * @param context The SSL context.
+ * @param keyPath The path to the key file.
+ * @param maxAge The maximum age of the keys in seconds.
+ */
+void SetSessionTicketKeysToSSLContext(const std::shared_ptr<SSL_CTX>& context, const String& keyPath, double maxAge)
+{
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEYS
+	unsigned char keys[48];
+	bool valid = false;
+
+	struct stat statbuf;
+
+	if (stat(keyPath.CStr(), &statbuf) == 0 && statbuf.st_mtime > Utility::GetTime() - maxAge) {
+		std::ifstream fp(keyPath.CStr(), std::ios::in | std::ios::binary);
+		valid = fp.read(reinterpret_cast<char *>(keys), sizeof(keys)) && fp.gcount() == sizeof(keys);
+	}
+
+	if (!valid) {
+		char errbuf[120];
+
+		if (RAND_bytes(keys, sizeof(keys)) != 1) {
+			Log(LogCritical, "SSL")
+				<< "Error while generating session ticket keys: " << ERR_peek_error() << ", \"" << ERR_error_string(ERR_peek_error(), errbuf) << "\"";
+			BOOST_THROW_EXCEPTION(openssl_error()
+				<< boost::errinfo_api_function("RAND_bytes")
+				<< errinfo_openssl_error(ERR_peek_error()));
+		}
+
+		std::fstream fp;
+		String tempPath = Utility::CreateTempFile(keyPath + ".XXXXXX", 0600, fp);
+		fp.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		fp.write(reinterpret_cast<const char *>(keys), sizeof(keys));
+		fp.close();
+
+#ifdef _WIN32
+		_unlink(keyPath.CStr());
+#endif /* _WIN32 */
+
+		if (rename(tempPath.CStr(), keyPath.CStr()) < 0) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("rename")
+				<< boost::errinfo_errno(errno)
+				<< boost::errinfo_file_name(tempPath));
+		}
+
+		Log(LogInformation, "SSL")
+			<< "Created new session ticket keys in '" << keyPath << "'.";
+	}
+
+	SSL_CTX_set_tlsext_ticket_keys(context.get(), keys, sizeof(keys));
+#endif /* SSL_CTRL_SET_TLSEXT_TICKET_KEYS */
+}
+
 /**
  * Loads a CRL and appends its certificates to the specified SSL context.
  *
@@ -41,6 +41,7 @@ std::shared_ptr<SSL_CTX> MakeSSLContext(const String& pubkey = String(), const S
 void AddCRLToSSLContext(const std::shared_ptr<SSL_CTX>& context, const String& crlPath);
 void SetCipherListToSSLContext(const std::shared_ptr<SSL_CTX>& context, const String& cipherList);
 void SetTlsProtocolminToSSLContext(const std::shared_ptr<SSL_CTX>& context, const String& tlsProtocolmin);
+void SetSessionTicketKeysToSSLContext(const std::shared_ptr<SSL_CTX>& context, const String& keyPath, double maxAge);
 String GetCertificateCN(const std::shared_ptr<X509>& certificate);
 std::shared_ptr<X509> GetX509Certificate(const String& pemfile);
 int MakeX509CSR(const String& cn, const String& keyfile, const String& csrfile = String(), const String& certfile = String(), bool ca = false);
@@ -40,6 +40,7 @@ enum FieldAttribute
 	FANoUserModify = 1024,
 	FANoUserView = 2048,
 	FADeprecated = 4096,
+	FALazyRestore = 65536,
 };
 
 class Type;
@@ -54,7 +55,7 @@ struct Field
 	int Attributes;
 	int ArrayRank;
 
-	Field(int id, const char *type, const char *name, const char *navigationName, const char *reftype, int attributes, int arrayRank)
+	constexpr Field(int id, const char *type, const char *name, const char *navigationName, const char *reftype, int attributes, int arrayRank)
 		: ID(id), TypeName(type), Name(name), NavigationName(navigationName), RefTypeName(reftype), Attributes(attributes), ArrayRank(arrayRank)
 	{ }
 };
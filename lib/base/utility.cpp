@@ -26,6 +26,7 @@
 #include "base/utility.hpp"
 #include "base/json.hpp"
 #include "base/objectlock.hpp"
+#include "base/profiler.hpp"
 #include <mmatch.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/tss.hpp>
@@ -33,6 +34,7 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/uuid_generators.hpp>
+#include <algorithm>
 #include <ios>
 #include <fstream>
 #include <iostream>
@@ -415,6 +417,24 @@ pid_t Utility::GetPid()
 #endif /* _WIN32 */
 }
 
+/**
+ * Returns the resident set size of the process.
+ *
+ * @returns The size in bytes, 0 if it isn't available on this platform.
+ */
+size_t Utility::GetResidentMemorySize()
+{
+#ifdef __linux__
+	std::ifstream fp("/proc/self/statm");
+	size_t size, resident;
+
+	if (fp >> size >> resident)
+		return resident * sysconf(_SC_PAGESIZE);
+#endif /* __linux__ */
+
+	return 0;
+}
+
 /**
  * Sleeps for the specified amount of time.
  *
@@ -1006,10 +1026,56 @@ String Utility::FormatDuration(double duration)
 	return NaturalJoin(tokens);
 }
 
+#ifndef _MSC_VER
+/* Changes whenever LocalTimeCached() notices that the time zone was changed, e.g. by tzset(). */
+static thread_local unsigned int l_LocalTimeZoneGeneration = 0;
+
+/**
+ * Converts a timestamp to local time. Each thread remembers the minute of
+ * its last conversion and derives timestamps within that minute from it,
+ * which avoids most localtime_r() calls and the time zone lock they take.
+ * Time zone offsets only change at minute boundaries.
+ */
+static tm *LocalTimeCached(time_t ts, tm *result)
+{
+	struct CachedLocalTime
+	{
+		time_t MinuteStart{-1};
+		tm Value;
+		std::string StandardZone;
+		std::string DaylightZone;
+	};
+
+	static thread_local CachedLocalTime cache;
+
+	if (cache.StandardZone != tzname[0] || cache.DaylightZone != tzname[1]) {
+		cache.MinuteStart = -1;
+		cache.StandardZone = tzname[0];
+		cache.DaylightZone = tzname[1];
+		l_LocalTimeZoneGeneration++;
+	}
+
+	if (cache.MinuteStart != -1 && ts >= cache.MinuteStart && ts < cache.MinuteStart + 60) {
+		*result = cache.Value;
+		result->tm_sec = ts - cache.MinuteStart;
+		return result;
+	}
+
+	if (!localtime_r(&ts, result))
+		return nullptr;
+
+	cache.MinuteStart = ts - result->tm_sec;
+	cache.Value = *result;
+
+	return result;
+}
+#endif /* _MSC_VER */
+
 String Utility::FormatDateTime(const char *format, double ts)
 {
-	char timestamp[128];
 	auto tempts = (time_t)ts; /* We don't handle sub-second timestamps here just yet. */
+
+	char timestamp[128];
 	tm tmthen;
 
 #ifdef _MSC_VER
@@ -1023,15 +1089,43 @@ String Utility::FormatDateTime(const char *format, double ts)
 
 	tmthen = *temp;
 #else /* _MSC_VER */
-	if (!localtime_r(&tempts, &tmthen)) {
+	if (!LocalTimeCached(tempts, &tmthen)) {
 		BOOST_THROW_EXCEPTION(posix_error()
 			<< boost::errinfo_api_function("localtime_r")
 			<< boost::errinfo_errno(errno));
 	}
+
+	/* Log messages and macros format the same few timestamps over and over
+	 * again, each thread keeps its most recent results. */
+	struct FormattedDateTime
+	{
+		std::string Format;
+		time_t Timestamp{-1};
+		unsigned int ZoneGeneration{0};
+		String Result;
+	};
+
+	static thread_local FormattedDateTime cache[4];
+	static thread_local size_t nextEntry = 0;
+
+	for (const FormattedDateTime& entry : cache) {
+		if (entry.Timestamp == tempts && entry.ZoneGeneration == l_LocalTimeZoneGeneration && entry.Format == format)
+			return entry.Result;
+	}
 #endif /* _MSC_VER */
 
 	strftime(timestamp, sizeof(timestamp), format, &tmthen);
 
+#ifndef _MSC_VER
+	FormattedDateTime& entry = cache[nextEntry];
+	nextEntry = (nextEntry + 1) % (sizeof(cache) / sizeof(cache[0]));
+
+	entry.Format = format;
+	entry.Timestamp = tempts;
+	entry.ZoneGeneration = l_LocalTimeZoneGeneration;
+	entry.Result = timestamp;
+#endif /* _MSC_VER */
+
 	return timestamp;
 }
 
@@ -1192,6 +1286,7 @@ static void WindowsSetThreadName(const char *name)
 void Utility::SetThreadName(const String& name, bool os)
 {
 	m_ThreadName.reset(new String(name));
+	Profiler::SetThreadName(name);
 
 	if (!os)
 		return;
@@ -1338,7 +1433,7 @@ tm Utility::LocalTime(time_t ts)
 #else /* _MSC_VER */
 	tm result;
 
-	if (!localtime_r(&ts, &result)) {
+	if (!LocalTimeCached(ts, &result)) {
 		BOOST_THROW_EXCEPTION(posix_error()
 			<< boost::errinfo_api_function("localtime_r")
 			<< boost::errinfo_errno(errno));
@@ -1722,6 +1817,12 @@ String Utility::GetPlatformArchitecture()
 
 String Utility::ValidateUTF8(const String& input)
 {
+	/* Plain ASCII strings don't have to be copied byte by byte. */
+	const std::string& data = input.GetData();
+
+	if (std::all_of(data.begin(), data.end(), [](char ch) { return (ch & 0x80) == 0; }))
+		return input;
+
 	String output;
 	size_t length = input.GetLength();
 
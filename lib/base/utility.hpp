@@ -74,6 +74,7 @@ public:
 	static double GetTime();
 
 	static pid_t GetPid();
+	static size_t GetResidentMemorySize();
 
 	static void Sleep(double timeout);
 
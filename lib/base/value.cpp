@@ -72,7 +72,7 @@ Value::Value(const String& value)
 { }
 
 Value::Value(String&& value)
-	: m_Value(value)
+	: m_Value(std::move(value))
 { }
 
 Value::Value(const char *value)
@@ -102,6 +102,12 @@ Value::Value(const intrusive_ptr<Object>& value)
 		m_Value = value;
 }
 
+Value::Value(intrusive_ptr<Object>&& value)
+{
+	if (value)
+		m_Value = std::move(value);
+}
+
 Value& Value::operator=(const Value& other)
 {
 	m_Value = other.m_Value;
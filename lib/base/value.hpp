@@ -70,6 +70,7 @@ public:
 	Value(Value&& other);
 	Value(Object *value);
 	Value(const intrusive_ptr<Object>& value);
+	Value(intrusive_ptr<Object>&& value);
 
 	template<typename T>
 	Value(const intrusive_ptr<T>& value)
@@ -78,6 +79,13 @@ public:
 		static_assert(!std::is_same<T, Object>::value, "T must not be Object");
 	}
 
+	template<typename T>
+	Value(intrusive_ptr<T>&& value)
+		: Value(intrusive_ptr<Object>(std::move(value)))
+	{
+		static_assert(!std::is_same<T, Object>::value, "T must not be Object");
+	}
+
 	bool ToBool() const;
 
 	operator double() const;
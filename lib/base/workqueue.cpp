@@ -23,7 +23,13 @@
 #include "base/convert.hpp"
 #include "base/application.hpp"
 #include "base/exception.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
 #include <boost/thread/tss.hpp>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
 #include <math.h>
 
 using namespace icinga;
@@ -31,6 +37,22 @@ using namespace icinga;
 std::atomic<int> WorkQueue::m_NextID(1);
 boost::thread_specific_ptr<WorkQueue *> l_ThreadWorkQueue;
 
+/* The maximum number of tasks in a work queue's ring buffer. */
+static const size_t l_MaxRingSize = 4096;
+
+static boost::mutex l_WorkQueuesMutex;
+static std::set<WorkQueue *> l_WorkQueues;
+
+REGISTER_STATSFUNCTION(WorkQueue, &WorkQueue::StatsFunc);
+
+static void UpdateMax(std::atomic<uint_fast64_t>& max, uint_fast64_t value)
+{
+	uint_fast64_t current = max.load(std::memory_order_relaxed);
+
+	while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		; /* empty loop body */
+}
+
 WorkQueue::WorkQueue(size_t maxItems, int threadCount)
 	: m_ID(m_NextID++), m_ThreadCount(threadCount), m_MaxItems(maxItems),
 	m_TaskStats(15 * 60)
@@ -40,12 +62,36 @@ WorkQueue::WorkQueue(size_t maxItems, int threadCount)
 
 	m_StatusTimer = new Timer();
 	m_StatusTimer->SetInterval(10);
+	m_StatusTimer->SetSlack(1);
 	m_StatusTimer->OnTimerExpired.connect(std::bind(&WorkQueue::StatusTimerHandler, this));
 	m_StatusTimer->Start();
+
+	if (m_ThreadCount == 1) {
+		size_t size = 2;
+
+		while (size < l_MaxRingSize && (m_MaxItems == 0 || size < m_MaxItems))
+			size <<= 1;
+
+		m_Ring.reset(new RingCell[size]);
+		m_RingMask = size - 1;
+
+		for (size_t i = 0; i < size; i++) {
+			m_Ring[i].Sequence.store(i, std::memory_order_relaxed);
+			m_Ring[i].Enqueued.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	boost::mutex::scoped_lock lock(l_WorkQueuesMutex);
+	l_WorkQueues.insert(this);
 }
 
 WorkQueue::~WorkQueue()
 {
+	{
+		boost::mutex::scoped_lock lock(l_WorkQueuesMutex);
+		l_WorkQueues.erase(this);
+	}
+
 	m_StatusTimer->Stop(true);
 
 	Join(true);
@@ -61,6 +107,15 @@ String WorkQueue::GetName() const
 	return m_Name;
 }
 
+/**
+ * Binds the worker threads to a NUMA node when a CPU affinity was set.
+ * Must be called before the first item is enqueued.
+ */
+void WorkQueue::SetNode(int node)
+{
+	m_Node = node;
+}
+
 boost::mutex::scoped_lock WorkQueue::AcquireLock()
 {
 	return boost::mutex::scoped_lock(m_Mutex);
@@ -72,25 +127,13 @@ boost::mutex::scoped_lock WorkQueue::AcquireLock()
  */
 void WorkQueue::EnqueueUnlocked(boost::mutex::scoped_lock& lock, std::function<void ()>&& function, WorkQueuePriority priority)
 {
-	if (!m_Spawned) {
-		Log(LogNotice, "WorkQueue")
-			<< "Spawning WorkQueue threads for '" << m_Name << "'";
+	SpawnThreads(lock);
 
-		for (int i = 0; i < m_ThreadCount; i++) {
-			m_Threads.create_thread(std::bind(&WorkQueue::WorkerThreadProc, this));
-		}
-
-		m_Spawned = true;
-	}
-
-	bool wq_thread = IsWorkerThread();
-
-	if (!wq_thread) {
-		while (m_Tasks.size() >= m_MaxItems && m_MaxItems != 0)
-			m_CVFull.wait(lock);
-	}
+	if (!IsWorkerThread())
+		WaitForSpace(lock);
 
-	m_Tasks.emplace(std::move(function), priority, ++m_NextTaskID);
+	m_Tasks.emplace(std::move(function), priority, ++m_NextTaskID, Utility::GetTime());
+	m_QueuedTasks++;
 
 	m_CVEmpty.notify_one();
 }
@@ -112,8 +155,40 @@ void WorkQueue::Enqueue(std::function<void ()>&& function, WorkQueuePriority pri
 		return;
 	}
 
+	if (!m_Ring || priority != PriorityNormal) {
+		auto lock = AcquireLock();
+		EnqueueUnlocked(lock, std::move(function), priority);
+		return;
+	}
+
+	if (!m_Spawned) {
+		auto lock = AcquireLock();
+		SpawnThreads(lock);
+	}
+
+	if (!wq_thread && m_MaxItems != 0 && GetLength() >= m_MaxItems) {
+		auto lock = AcquireLock();
+		WaitForSpace(lock);
+	}
+
+	Task task(std::move(function), priority, ++m_NextTaskID, Utility::GetTime());
+
+	if (PushRing(task)) {
+		/* The worker thread only needs to be woken up if it's waiting for tasks. */
+		if (m_WorkerSleeping) {
+			auto lock = AcquireLock();
+			m_CVEmpty.notify_one();
+		}
+
+		return;
+	}
+
+	/* The ring buffer is full, fall back to the priority queue. */
 	auto lock = AcquireLock();
-	EnqueueUnlocked(lock, std::move(function), priority);
+	m_Tasks.emplace(std::move(task));
+	m_QueuedTasks++;
+
+	m_CVEmpty.notify_one();
 }
 
 /**
@@ -126,7 +201,7 @@ void WorkQueue::Join(bool stop)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	while (m_Processing || !m_Tasks.empty())
+	while (m_Processing || GetLength() > 0)
 		m_CVStarved.wait(lock);
 
 	if (stop) {
@@ -201,9 +276,7 @@ void WorkQueue::ReportExceptions(const String& facility) const
 
 size_t WorkQueue::GetLength() const
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
-
-	return m_Tasks.size();
+	return m_QueuedTasks + m_RingTasks;
 }
 
 void WorkQueue::StatusTimerHandler()
@@ -212,7 +285,7 @@ void WorkQueue::StatusTimerHandler()
 
 	ASSERT(!m_Name.IsEmpty());
 
-	size_t pending = m_Tasks.size();
+	size_t pending = GetLength();
 
 	double now = Utility::GetTime();
 	double gradient = (pending - m_PendingTasks) / (now - m_PendingTasksTimestamp);
@@ -231,6 +304,10 @@ void WorkQueue::StatusTimerHandler()
 	m_PendingTasks = pending;
 	m_PendingTasksTimestamp = now;
 
+	lock.unlock();
+
+	double oldestTaskAge = GetOldestTaskAge();
+
 	/* Log if there are pending items, or 5 minute timeout is reached. */
 	if (pending > 0 || m_StatusTimerTimeout < now) {
 		Log(LogInformation, "WorkQueue")
@@ -238,6 +315,7 @@ void WorkQueue::StatusTimerHandler()
 			<< "items: " << pending << ", "
 			<< "rate: " << std::setw(2) << GetTaskCount(60) / 60.0 << "/s "
 			<< "(" << GetTaskCount(60) << "/min " << GetTaskCount(60 * 5) << "/5min " << GetTaskCount(60 * 15) << "/15min);"
+			<< (pending > 0 ? " oldest task: " + Utility::FormatDuration(oldestTaskAge) + ";" : "")
 			<< timeInfo;
 	}
 
@@ -247,6 +325,148 @@ void WorkQueue::StatusTimerHandler()
 	}
 }
 
+/**
+ * Returns how long the oldest pending task has been waiting. For queues with
+ * a ring buffer this is approximate as the ring buffer isn't locked.
+ *
+ * @returns The age in seconds, or 0 if no task is pending.
+ */
+double WorkQueue::GetOldestTaskAge() const
+{
+	double oldest = 0;
+
+	if (m_QueuedTasks > 0) {
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (!m_Tasks.empty())
+			oldest = m_Tasks.top().Enqueued;
+	}
+
+	if (m_Ring) {
+		size_t tasks = m_RingTasks.load();
+
+		if (tasks > 0) {
+			size_t head = m_RingTail.load() - tasks;
+			double enqueued = m_Ring[head & m_RingMask].Enqueued.load(std::memory_order_relaxed);
+
+			if (enqueued > 0 && (oldest == 0 || enqueued < oldest))
+				oldest = enqueued;
+		}
+	}
+
+	if (oldest == 0)
+		return 0;
+
+	double age = std::max(0.0, Utility::GetTime() - oldest);
+
+	const_cast<WorkQueue *>(this)->UpdateTaskAge(age);
+
+	return age;
+}
+
+void WorkQueue::UpdateTaskAge(double age)
+{
+	UpdateMax(m_MaxTaskAge, static_cast<uint_fast64_t>(age * 1000000));
+}
+
+/**
+ * Runs a task and updates the wait and service time statistics.
+ */
+void WorkQueue::RunTask(const Task& task)
+{
+	double start = Utility::GetTime();
+
+	RunTaskFunction(task.Function);
+
+	double end = Utility::GetTime();
+
+	auto waitTime = static_cast<uint_fast64_t>(std::max(0.0, start - task.Enqueued) * 1000000);
+	auto serviceTime = static_cast<uint_fast64_t>(std::max(0.0, end - start) * 1000000);
+
+	m_CompletedTasks.fetch_add(1, std::memory_order_relaxed);
+	m_TotalWaitTime.fetch_add(waitTime, std::memory_order_relaxed);
+	m_TotalServiceTime.fetch_add(serviceTime, std::memory_order_relaxed);
+	UpdateMax(m_MaxWaitTime, waitTime);
+	UpdateMax(m_MaxServiceTime, serviceTime);
+}
+
+void WorkQueue::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	struct QueueStats
+	{
+		size_t Queues{0};
+		size_t Items{0};
+		uint_fast64_t Tasks{0};
+		uint_fast64_t TotalWaitTime{0};
+		uint_fast64_t TotalServiceTime{0};
+		uint_fast64_t MaxWaitTime{0};
+		uint_fast64_t MaxServiceTime{0};
+		double OldestTaskAge{0};
+		uint_fast64_t MaxTaskAge{0};
+	};
+
+	/* Queues with the same name (e.g. one per HTTP connection) are reported together. */
+	std::map<String, QueueStats> stats;
+
+	{
+		boost::mutex::scoped_lock lock(l_WorkQueuesMutex);
+
+		for (WorkQueue *wq : l_WorkQueues) {
+			if (wq->m_Name.IsEmpty())
+				continue;
+
+			QueueStats& qs = stats[wq->m_Name];
+
+			qs.Queues++;
+			qs.Items += wq->GetLength();
+			qs.Tasks += wq->m_CompletedTasks.load(std::memory_order_relaxed);
+			qs.TotalWaitTime += wq->m_TotalWaitTime.load(std::memory_order_relaxed);
+			qs.TotalServiceTime += wq->m_TotalServiceTime.load(std::memory_order_relaxed);
+			qs.MaxWaitTime = std::max<uint_fast64_t>(qs.MaxWaitTime, wq->m_MaxWaitTime.load(std::memory_order_relaxed));
+			qs.MaxServiceTime = std::max<uint_fast64_t>(qs.MaxServiceTime, wq->m_MaxServiceTime.load(std::memory_order_relaxed));
+			qs.OldestTaskAge = std::max(qs.OldestTaskAge, wq->GetOldestTaskAge());
+			qs.MaxTaskAge = std::max<uint_fast64_t>(qs.MaxTaskAge, wq->m_MaxTaskAge.load(std::memory_order_relaxed));
+		}
+	}
+
+	DictionaryData queues;
+
+	for (const auto& kv : stats) {
+		const QueueStats& qs = kv.second;
+
+		double avgWaitTime = qs.Tasks > 0 ? qs.TotalWaitTime / 1000000.0 / qs.Tasks : 0;
+		double avgServiceTime = qs.Tasks > 0 ? qs.TotalServiceTime / 1000000.0 / qs.Tasks : 0;
+
+		queues.emplace_back(kv.first, new Dictionary({
+			{ "queues", qs.Queues },
+			{ "items", qs.Items },
+			{ "tasks", qs.Tasks },
+			{ "avg_wait_time", avgWaitTime },
+			{ "max_wait_time", qs.MaxWaitTime / 1000000.0 },
+			{ "avg_service_time", avgServiceTime },
+			{ "max_service_time", qs.MaxServiceTime / 1000000.0 },
+			{ "oldest_task_age", qs.OldestTaskAge },
+			{ "max_task_age", qs.MaxTaskAge / 1000000.0 }
+		}));
+
+		String label = "workqueue_";
+
+		for (char ch : kv.first) {
+			if (isalnum(static_cast<unsigned char>(ch)))
+				label += static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+			else if (label[label.GetLength() - 1] != '_')
+				label += '_';
+		}
+
+		perfdata->Add(new PerfdataValue(label + "_items", qs.Items));
+		perfdata->Add(new PerfdataValue(label + "_avg_wait_time", avgWaitTime));
+		perfdata->Add(new PerfdataValue(label + "_avg_service_time", avgServiceTime));
+		perfdata->Add(new PerfdataValue(label + "_oldest_task_age", qs.OldestTaskAge));
+	}
+
+	status->Set("workqueues", new Dictionary(std::move(queues)));
+}
+
 void WorkQueue::RunTaskFunction(const TaskFunction& func)
 {
 	try {
@@ -272,6 +492,8 @@ void WorkQueue::WorkerThreadProc()
 	idbuf << "WQ #" << m_ID;
 	Utility::SetThreadName(idbuf.str());
 
+	Application::SetThreadAffinity(m_Node);
+
 	l_ThreadWorkQueue.reset(new WorkQueue *(this));
 
 	boost::mutex::scoped_lock lock(m_Mutex);
@@ -288,12 +510,13 @@ void WorkQueue::WorkerThreadProc()
 
 		Task task = m_Tasks.top();
 		m_Tasks.pop();
+		m_QueuedTasks--;
 
 		m_Processing++;
 
 		lock.unlock();
 
-		RunTaskFunction(task.Function);
+		RunTask(task);
 
 		/* clear the task so whatever other resources it holds are released _before_ we re-acquire the mutex */
 		task = Task();
@@ -309,6 +532,194 @@ void WorkQueue::WorkerThreadProc()
 	}
 }
 
+void WorkQueue::RingWorkerThreadProc()
+{
+	std::ostringstream idbuf;
+	idbuf << "WQ #" << m_ID;
+	Utility::SetThreadName(idbuf.str());
+
+	Application::SetThreadAffinity(m_Node);
+
+	l_ThreadWorkQueue.reset(new WorkQueue *(this));
+
+	for (;;) {
+		Task task;
+
+		if (!PopTask(task)) {
+			/* Another thread is still in the middle of adding the next task. */
+			if (GetLength() > 0) {
+				boost::this_thread::yield();
+				continue;
+			}
+
+			boost::mutex::scoped_lock lock(m_Mutex);
+
+			m_WorkerSleeping = true;
+
+			while (GetLength() == 0 && !m_Stopped) {
+				m_CVStarved.notify_all();
+				m_CVEmpty.wait(lock);
+			}
+
+			m_WorkerSleeping = false;
+
+			if (m_Stopped)
+				break;
+
+			continue;
+		}
+
+		RunTask(task);
+
+		/* clear the task so whatever other resources it holds are released before the next task is run */
+		task = Task();
+
+		IncreaseTaskCount();
+
+		m_Processing--;
+	}
+}
+
+/**
+ * Note: Caller must hold m_Mutex.
+ */
+void WorkQueue::SpawnThreads(boost::mutex::scoped_lock&)
+{
+	if (m_Spawned)
+		return;
+
+	Log(LogNotice, "WorkQueue")
+		<< "Spawning WorkQueue threads for '" << m_Name << "'";
+
+	for (int i = 0; i < m_ThreadCount; i++) {
+		if (m_Ring)
+			m_Threads.create_thread(std::bind(&WorkQueue::RingWorkerThreadProc, this));
+		else
+			m_Threads.create_thread(std::bind(&WorkQueue::WorkerThreadProc, this));
+	}
+
+	m_Spawned = true;
+}
+
+/**
+ * Waits until the number of pending tasks drops below the queue's limit.
+ *
+ * Note: Caller must hold m_Mutex.
+ */
+void WorkQueue::WaitForSpace(boost::mutex::scoped_lock& lock)
+{
+	if (m_MaxItems == 0)
+		return;
+
+	m_FullWaiters++;
+
+	while (GetLength() >= m_MaxItems)
+		m_CVFull.wait(lock);
+
+	m_FullWaiters--;
+}
+
+/**
+ * Adds a task to the ring buffer. The task is left untouched if the ring
+ * buffer is full.
+ *
+ * @returns true if the task was added, false otherwise.
+ */
+bool WorkQueue::PushRing(Task& task)
+{
+	size_t pos = m_RingTail.load(std::memory_order_relaxed);
+	RingCell *cell;
+
+	for (;;) {
+		cell = &m_Ring[pos & m_RingMask];
+		size_t seq = cell->Sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+		if (diff == 0) {
+			if (m_RingTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0)
+			return false;
+		else
+			pos = m_RingTail.load(std::memory_order_relaxed);
+	}
+
+	/* Count the task before publishing it so GetLength() never underflows. */
+	m_RingTasks++;
+
+	cell->Enqueued.store(task.Enqueued, std::memory_order_relaxed);
+	cell->Item = std::move(task);
+	cell->Sequence.store(pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+/**
+ * Returns the cell for the oldest task in the ring buffer.
+ *
+ * Note: Must only be called from the worker thread.
+ *
+ * @returns The cell or nullptr if no task is available.
+ */
+WorkQueue::RingCell *WorkQueue::PeekRing()
+{
+	RingCell *cell = &m_Ring[m_RingHead & m_RingMask];
+
+	if (cell->Sequence.load(std::memory_order_acquire) != m_RingHead + 1)
+		return nullptr;
+
+	return cell;
+}
+
+/**
+ * Takes the next task from either the ring buffer or the priority queue,
+ * whichever has the task with the higher priority.
+ *
+ * Note: Must only be called from the worker thread.
+ *
+ * @returns true if a task was taken, false otherwise.
+ */
+bool WorkQueue::PopTask(Task& task)
+{
+	RingCell *cell = PeekRing();
+
+	if (m_QueuedTasks > 0) {
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (!m_Tasks.empty() && (!cell || cell->Item < m_Tasks.top())) {
+			task = m_Tasks.top();
+			m_Tasks.pop();
+
+			m_Processing++;
+			m_QueuedTasks--;
+
+			if (m_FullWaiters > 0)
+				m_CVFull.notify_all();
+
+			return true;
+		}
+	}
+
+	if (!cell)
+		return false;
+
+	task = std::move(cell->Item);
+	cell->Item = Task();
+
+	m_Processing++;
+
+	cell->Sequence.store(m_RingHead + m_RingMask + 1, std::memory_order_release);
+	m_RingHead++;
+	m_RingTasks--;
+
+	if (m_FullWaiters > 0) {
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_CVFull.notify_all();
+	}
+
+	return true;
+}
+
 void WorkQueue::IncreaseTaskCount()
 {
 	m_TaskStats.InsertValue(Utility::GetTime(), 1);
@@ -23,6 +23,8 @@
 #include "base/i2-base.hpp"
 #include "base/timer.hpp"
 #include "base/ringbuffer.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
@@ -30,6 +32,7 @@
 #include <queue>
 #include <deque>
 #include <atomic>
+#include <memory>
 
 namespace icinga
 {
@@ -47,13 +50,14 @@ struct Task
 {
 	Task() = default;
 
-	Task(TaskFunction function, WorkQueuePriority priority, int id)
-		: Function(std::move(function)), Priority(priority), ID(id)
+	Task(TaskFunction function, WorkQueuePriority priority, int id, double enqueued)
+		: Function(std::move(function)), Priority(priority), ID(id), Enqueued(enqueued)
 	{ }
 
 	TaskFunction Function;
 	WorkQueuePriority Priority{PriorityNormal};
 	int ID{-1};
+	double Enqueued{0};
 };
 
 bool operator<(const Task& a, const Task& b);
@@ -61,6 +65,12 @@ bool operator<(const Task& a, const Task& b);
 /**
  * A workqueue.
  *
+ * Work queues with a single worker thread use a bounded lock-free ring
+ * buffer for tasks with normal priority, so enqueuing such a task doesn't
+ * have to acquire the queue's mutex. Other tasks and tasks which don't fit
+ * into the ring buffer are queued in the priority queue, as they are for
+ * queues with more than one worker thread.
+ *
  * @ingroup base
  */
 class WorkQueue
@@ -74,6 +84,8 @@ public:
 	void SetName(const String& name);
 	String GetName() const;
 
+	void SetNode(int node);
+
 	boost::mutex::scoped_lock AcquireLock();
 	void EnqueueUnlocked(boost::mutex::scoped_lock& lock, TaskFunction&& function, WorkQueuePriority priority = PriorityNormal);
 	void Enqueue(TaskFunction&& function, WorkQueuePriority priority = PriorityNormal,
@@ -114,6 +126,9 @@ public:
 
 	size_t GetLength() const;
 	size_t GetTaskCount(RingBuffer::SizeType span);
+	double GetOldestTaskAge() const;
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
 	void SetExceptionCallback(const ExceptionCallback& callback);
 
@@ -127,9 +142,10 @@ protected:
 private:
 	int m_ID;
 	String m_Name;
+	int m_Node{-1};
 	static std::atomic<int> m_NextID;
 	int m_ThreadCount;
-	bool m_Spawned{false};
+	std::atomic<bool> m_Spawned{false};
 
 	mutable boost::mutex m_Mutex;
 	boost::condition_variable m_CVEmpty;
@@ -138,9 +154,26 @@ private:
 	boost::thread_group m_Threads;
 	size_t m_MaxItems;
 	bool m_Stopped{false};
-	int m_Processing{0};
+	std::atomic<int> m_Processing{0};
 	std::priority_queue<Task, std::deque<Task> > m_Tasks;
-	int m_NextTaskID{0};
+	std::atomic<size_t> m_QueuedTasks{0};
+	std::atomic<int> m_NextTaskID{0};
+
+	struct RingCell
+	{
+		std::atomic<size_t> Sequence;
+		std::atomic<double> Enqueued; /**< Copy of Item.Enqueued which other threads may read. */
+		Task Item;
+	};
+
+	/* The ring buffer is only used when there is exactly one worker thread. */
+	std::unique_ptr<RingCell[]> m_Ring;
+	size_t m_RingMask{0};
+	std::atomic<size_t> m_RingTail{0};
+	size_t m_RingHead{0}; /**< Only accessed by the worker thread. */
+	std::atomic<size_t> m_RingTasks{0};
+	std::atomic<bool> m_WorkerSleeping{false};
+	std::atomic<int> m_FullWaiters{0};
 	ExceptionCallback m_ExceptionCallback;
 	std::vector<boost::exception_ptr> m_Exceptions;
 	Timer::Ptr m_StatusTimer;
@@ -150,10 +183,28 @@ private:
 	size_t m_PendingTasks{0};
 	double m_PendingTasksTimestamp{0};
 
+	/* Task statistics (in microseconds) since the queue was created. */
+	std::atomic<uint_fast64_t> m_CompletedTasks{0};
+	std::atomic<uint_fast64_t> m_TotalWaitTime{0};
+	std::atomic<uint_fast64_t> m_TotalServiceTime{0};
+	std::atomic<uint_fast64_t> m_MaxWaitTime{0};
+	std::atomic<uint_fast64_t> m_MaxServiceTime{0};
+	std::atomic<uint_fast64_t> m_MaxTaskAge{0};
+
+	void SpawnThreads(boost::mutex::scoped_lock& lock);
+
+	bool PushRing(Task& task);
+	RingCell *PeekRing();
+	bool PopTask(Task& task);
+	void WaitForSpace(boost::mutex::scoped_lock& lock);
+
 	void WorkerThreadProc();
+	void RingWorkerThreadProc();
 	void StatusTimerHandler();
 
 	void RunTaskFunction(const TaskFunction& func);
+	void RunTask(const Task& task);
+	void UpdateTaskAge(double age);
 };
 
 }
@@ -26,10 +26,18 @@
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
+#include "base/process.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include "base/convert.hpp"
 #include "base/statsfunction.hpp"
+#include "base/latencyhistogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#ifndef _WIN32
+#	include <cstdlib>
+#endif /* _WIN32 */
 
 using namespace icinga;
 
@@ -37,20 +45,68 @@ REGISTER_TYPE(CheckerComponent);
 
 REGISTER_STATSFUNCTION(CheckerComponent, &CheckerComponent::StatsFunc);
 
+/* The maximum number of checks which are handed to the thread pool as a single work item. */
+static const std::vector<Checkable::Ptr>::size_type l_MaxBatchSize = 128;
+
+/* How late checks are dispatched compared to their scheduled time. */
+static LatencyHistogram l_SchedulingDelay("checker_scheduling_delay");
+
 void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
-	for (const CheckerComponent::Ptr& checker : ConfigType::GetObjectsByType<CheckerComponent>()) {
-		unsigned long idle = checker->GetIdleCheckables();
-		unsigned long pending = checker->GetPendingCheckables();
+	for (const CheckerComponent::Ptr& checker : ConfigType::GetObjectViewByType<CheckerComponent>()) {
+		unsigned long idle = 0;
+		unsigned long pending = 0;
+		ArrayData shards;
+
+		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
+
+		for (std::vector<std::unique_ptr<Shard> >::size_type i = 0; i < checker->m_Shards.size(); i++) {
+			Shard& shard = *checker->m_Shards[i];
+			unsigned long shardIdle, shardPending, smoothed, lastBatchSize;
+			double lag, avgBatchSize = 0;
+
+			{
+				boost::mutex::scoped_lock lock(shard.Mutex);
+				shardIdle = shard.IdleCheckables.GetLength();
+				shardPending = shard.PendingCheckables;
+				smoothed = shard.SmoothedChecks;
+				lag = shard.Lag;
+				lastBatchSize = shard.LastBatchSize;
+
+				if (shard.Batches > 0)
+					avgBatchSize = static_cast<double>(shard.BatchedChecks) / shard.Batches;
+			}
+
+			idle += shardIdle;
+			pending += shardPending;
+
+			shards.emplace_back(new Dictionary({
+				{ "idle", shardIdle },
+				{ "pending", shardPending },
+				{ "smoothed", smoothed },
+				{ "lag", lag },
+				{ "last_batch_size", lastBatchSize },
+				{ "avg_batch_size", avgBatchSize }
+			}));
+
+			String shard_prefix = perfdata_prefix + "shard_" + Convert::ToString(i) + "_";
+			perfdata->Add(new PerfdataValue(shard_prefix + "lag", lag));
+			perfdata->Add(new PerfdataValue(shard_prefix + "avg_batch_size", avgBatchSize));
+		}
+
+		int limit = checker->GetConcurrencyLimit();
 
 		nodes.emplace_back(checker->GetName(), new Dictionary({
 			{ "idle", idle },
-			{ "pending", pending }
+			{ "pending", pending },
+			{ "concurrency_limit", limit },
+			{ "shards", new Array(std::move(shards)) }
 		}));
 
-		String perfdata_prefix = "checkercomponent_" + checker->GetName() + "_";
+		perfdata->Add(new PerfdataValue(perfdata_prefix + "concurrency_limit", limit));
+
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "idle", Convert::ToDouble(idle)));
 		perfdata->Add(new PerfdataValue(perfdata_prefix + "pending", Convert::ToDouble(pending)));
 	}
@@ -60,10 +116,19 @@ void CheckerComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr
 
 void CheckerComponent::OnConfigLoaded()
 {
+	for (int i = 0; i < GetSchedulerThreads(); i++)
+		m_Shards.emplace_back(new Shard());
+
 	ConfigObject::OnActiveChanged.connect(std::bind(&CheckerComponent::ObjectHandler, this, _1));
 	ConfigObject::OnPausedChanged.connect(std::bind(&CheckerComponent::ObjectHandler, this, _1));
 
 	Checkable::OnNextCheckChanged.connect(std::bind(&CheckerComponent::NextCheckChangedHandler, this, _1));
+	Checkable::OnPendingChecksDecreased.connect(std::bind(&CheckerComponent::PendingChecksDecreasedHandler, this));
+
+	if (GetAdaptiveConcurrency()) {
+		m_ConcurrencyLimit = GetConcurrentChecks();
+		Checkable::OnNewCheckResult.connect(std::bind(&CheckerComponent::NewCheckResultHandler, this, _2, _3));
+	}
 }
 
 void CheckerComponent::Start(bool runtimeCreated)
@@ -74,12 +139,20 @@ void CheckerComponent::Start(bool runtimeCreated)
 		<< "'" << GetName() << "' started.";
 
 
-	m_Thread = std::thread(std::bind(&CheckerComponent::CheckThreadProc, this));
+	for (const std::unique_ptr<Shard>& shard : m_Shards)
+		shard->Thread = std::thread(std::bind(&CheckerComponent::CheckThreadProc, this, std::ref(*shard)));
 
 	m_ResultTimer = new Timer();
 	m_ResultTimer->SetInterval(5);
 	m_ResultTimer->OnTimerExpired.connect(std::bind(&CheckerComponent::ResultTimerHandler, this));
 	m_ResultTimer->Start();
+
+	if (GetAdaptiveConcurrency()) {
+		m_ConcurrencyTimer = new Timer();
+		m_ConcurrencyTimer->SetInterval(1);
+		m_ConcurrencyTimer->OnTimerExpired.connect(std::bind(&CheckerComponent::ConcurrencyTimerHandler, this));
+		m_ConcurrencyTimer->Start();
+	}
 }
 
 void CheckerComponent::Stop(bool runtimeRemoved)
@@ -87,132 +160,217 @@ void CheckerComponent::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CheckerComponent")
 		<< "'" << GetName() << "' stopped.";
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
-		m_Stopped = true;
-		m_CV.notify_all();
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		shard->Stopped = true;
+		shard->CV.notify_all();
 	}
 
 	m_ResultTimer->Stop();
-	m_Thread.join();
+
+	if (m_ConcurrencyTimer)
+		m_ConcurrencyTimer->Stop();
+
+	for (const std::unique_ptr<Shard>& shard : m_Shards)
+		shard->Thread.join();
 
 	ObjectImpl<CheckerComponent>::Stop(runtimeRemoved);
 }
 
-void CheckerComponent::CheckThreadProc()
+void CheckerComponent::CheckThreadProc(Shard& shard)
 {
 	Utility::SetThreadName("Check Scheduler");
 
-	boost::mutex::scoped_lock lock(m_Mutex);
+	boost::mutex::scoped_lock lock(shard.Mutex);
 
-	for (;;) {
-		typedef boost::multi_index::nth_index<CheckableSet, 1>::type CheckTimeView;
-		CheckTimeView& idx = boost::get<1>(m_IdleCheckables);
+	std::vector<CheckableScheduleInfo *> skipped;
+	std::vector<Checkable::Ptr> checks;
 
-		while (idx.begin() == idx.end() && !m_Stopped)
-			m_CV.wait(lock);
+	for (;;) {
+		while (shard.IdleCheckables.IsEmpty() && !shard.Stopped)
+			shard.CV.wait(lock);
 
-		if (m_Stopped)
+		if (shard.Stopped)
 			break;
 
-		auto it = idx.begin();
-		CheckableScheduleInfo csi = *it;
+		double now = Utility::GetTime();
+		int limit = GetConcurrencyLimit();
+		bool reserved = false;
+		bool throttled = false;
+
+		/* Collect all checkables which are due while we're holding the lock. The
+		 * slot for a check is taken before popping it, other shards compete for
+		 * the same limit. */
+		for (;;) {
+			if (!reserved) {
+				if (!Checkable::TryAquirePendingCheckSlot(limit)) {
+					throttled = true;
+					break;
+				}
+
+				reserved = true;
+			}
 
-		double wait = csi.NextCheck - Utility::GetTime();
+			CheckableScheduleInfo *csi = static_cast<CheckableScheduleInfo *>(shard.IdleCheckables.PopExpired(now));
 
-		if (Checkable::GetPendingChecks() >= GetConcurrentChecks())
-			wait = 0.5;
+			if (!csi)
+				break;
 
-		if (wait > 0) {
-			/* Wait for the next check. */
-			m_CV.timed_wait(lock, boost::posix_time::milliseconds(long(wait * 1000)));
+			ReleaseDispatchSlot(shard, *csi);
 
-			continue;
-		}
+			const Checkable::Ptr& checkable = csi->Object;
 
-		Checkable::Ptr checkable = csi.Object;
-
-		m_IdleCheckables.erase(checkable);
+			/* The check was postponed after it had been scheduled, see NextCheckChangedHandler(). */
+			if (checkable->GetNextCheck() > now) {
+				ScheduleCheckable(shard, *csi);
+				continue;
+			}
 
-		bool forced = checkable->GetForceNextCheck();
-		bool check = true;
+			shard.Lag = now - csi->GetWhen();
 
-		if (!forced) {
-			if (!checkable->IsReachable(DependencyCheckExecution)) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for object '" << checkable->GetName() << "': Dependency failed.";
-				check = false;
+			if (!checkable->GetForceNextCheck() && !CanExecuteCheck(checkable)) {
+				skipped.push_back(csi);
+				continue;
 			}
 
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
+			double nextCheck = checkable->GetNextCheck();
 
-			if (host && !service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableHostChecks())) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for host '" << host->GetName() << "': active host checks are disabled";
-				check = false;
-			}
-			if (host && service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableServiceChecks())) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for service '" << service->GetName() << "': active service checks are disabled";
-				check = false;
+			/* Don't format the timestamps unless somebody actually receives debug logs. */
+			if (Logger::IsLogLevelEnabled(LogDebug)) {
+				Log(LogDebug, "CheckerComponent")
+					<< "Scheduling info for checkable '" << checkable->GetName() << "' ("
+					<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", nextCheck) << "): Object '"
+					<< csi->Object->GetName() << "', Next Check: "
+					<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", nextCheck) << "(" << nextCheck << ").";
 			}
 
-			TimePeriod::Ptr tp = checkable->GetCheckPeriod();
+			l_SchedulingDelay.Record(shard.Lag);
 
-			if (tp && !tp->IsInside(Utility::GetTime())) {
-				Log(LogNotice, "CheckerComponent")
-					<< "Skipping check for object '" << checkable->GetName()
-					<< "': not in check period '" << tp->GetName() << "'";
-				check = false;
-			}
+			csi->Pending = true;
+			shard.PendingCheckables++;
+
+			checks.push_back(checkable);
+			reserved = false;
 		}
 
-		/* reschedule the checkable if checks are disabled */
-		if (!check) {
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
-			lock.unlock();
+		if (reserved)
+			Checkable::ReleasePendingCheckSlot();
 
-			Log(LogDebug, "CheckerComponent")
-				<< "Checks for checkable '" << checkable->GetName() << "' are disabled. Rescheduling check.";
+		if (checks.empty() && skipped.empty()) {
+			double wait;
 
-			checkable->UpdateNextCheck();
+			if (!throttled)
+				wait = shard.IdleCheckables.GetNextExpiry() - now;
+			else {
+				/* PendingChecksDecreasedHandler() wakes us up as soon as a check finishes. */
+				m_Throttled = true;
+				wait = 0.5;
+			}
 
-			lock.lock();
+			/* Wait for the next check. */
+			shard.CV.timed_wait(lock, boost::posix_time::milliseconds(long(std::ceil(wait * 1000))));
 
 			continue;
 		}
 
+		/* reschedule the checkables if checks are disabled; this has to happen after
+		 * draining the wheel as their next check timestamps are still in the past */
+		std::vector<Checkable::Ptr> rescheduled;
+		rescheduled.reserve(skipped.size());
 
-		csi = GetCheckableScheduleInfo(checkable);
+		for (CheckableScheduleInfo *csi : skipped) {
+			ScheduleCheckable(shard, *csi);
+			rescheduled.push_back(csi->Object);
+		}
 
-		Log(LogDebug, "CheckerComponent")
-			<< "Scheduling info for checkable '" << checkable->GetName() << "' ("
-			<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", checkable->GetNextCheck()) << "): Object '"
-			<< csi.Object->GetName() << "', Next Check: "
-			<< Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", csi.NextCheck) << "(" << csi.NextCheck << ").";
+		skipped.clear();
 
-		m_PendingCheckables.insert(csi);
+		if (!checks.empty()) {
+			shard.LastBatchSize = checks.size();
+			shard.Batches++;
+			shard.BatchedChecks += checks.size();
+		}
 
 		lock.unlock();
 
-		if (forced) {
-			ObjectLock olock(checkable);
-			checkable->SetForceNextCheck(false);
+		for (const Checkable::Ptr& checkable : rescheduled) {
+			Log(LogDebug, "CheckerComponent")
+				<< "Checks for checkable '" << checkable->GetName() << "' are disabled. Rescheduling check.";
+
+			checkable->UpdateNextCheck();
 		}
 
-		Log(LogDebug, "CheckerComponent")
-			<< "Executing check for '" << checkable->GetName() << "'";
+		for (const Checkable::Ptr& checkable : checks) {
+			if (checkable->GetForceNextCheck()) {
+				ObjectLock olock(checkable);
+				checkable->SetForceNextCheck(false);
+			}
 
-		Checkable::IncreasePendingChecks();
+			Log(LogDebug, "CheckerComponent")
+				<< "Executing check for '" << checkable->GetName() << "'";
+		}
+
+		/* Hand the checks to the thread pool in chunks so they can still be
+		 * spread across the worker threads. */
+		for (std::vector<Checkable::Ptr>::size_type i = 0; i < checks.size(); i += l_MaxBatchSize) {
+			std::vector<Checkable::Ptr> batch(checks.begin() + i, checks.begin() + std::min(i + l_MaxBatchSize, checks.size()));
+			Utility::QueueAsyncCallback(std::bind(&CheckerComponent::ExecuteCheckBatch, CheckerComponent::Ptr(this), std::move(batch)));
+		}
 
-		Utility::QueueAsyncCallback(std::bind(&CheckerComponent::ExecuteCheckHelper, CheckerComponent::Ptr(this), checkable));
+		checks.clear();
 
 		lock.lock();
 	}
 }
 
+/**
+ * Checks whether the checkable's check should be executed, i.e. whether its
+ * dependencies are reachable, active checks are enabled and it is inside
+ * its check period.
+ */
+bool CheckerComponent::CanExecuteCheck(const Checkable::Ptr& checkable)
+{
+	bool check = true;
+
+	if (!checkable->IsReachable(DependencyCheckExecution)) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for object '" << checkable->GetName() << "': Dependency failed.";
+		check = false;
+	}
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	if (host && !service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableHostChecks())) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for host '" << host->GetName() << "': active host checks are disabled";
+		check = false;
+	}
+	if (host && service && (!checkable->GetEnableActiveChecks() || !IcingaApplication::GetInstance()->GetEnableServiceChecks())) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for service '" << service->GetName() << "': active service checks are disabled";
+		check = false;
+	}
+
+	TimePeriod::Ptr tp = checkable->GetCheckPeriod();
+
+	if (tp && !tp->IsInside(Utility::GetTime())) {
+		Log(LogNotice, "CheckerComponent")
+			<< "Skipping check for object '" << checkable->GetName()
+			<< "': not in check period '" << tp->GetName() << "'";
+		check = false;
+	}
+
+	return check;
+}
+
+void CheckerComponent::ExecuteCheckBatch(const std::vector<Checkable::Ptr>& checkables)
+{
+	for (const Checkable::Ptr& checkable : checkables)
+		ExecuteCheckHelper(checkable);
+}
+
 void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 {
 	try {
@@ -238,20 +396,24 @@ void CheckerComponent::ExecuteCheckHelper(const Checkable::Ptr& checkable)
 	Checkable::DecreasePendingChecks();
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		boost::mutex::scoped_lock lock(shard.Mutex);
 
 		/* remove the object from the list of pending objects; if it's not in the
 		 * list this was a manual (i.e. forced) check and we must not re-add the
 		 * object to the list because it's already there. */
-		auto it = m_PendingCheckables.find(checkable);
+		auto it = shard.Checkables.find(checkable.get());
 
-		if (it != m_PendingCheckables.end()) {
-			m_PendingCheckables.erase(it);
+		if (it != shard.Checkables.end() && it->second.Pending) {
+			it->second.Pending = false;
+			shard.PendingCheckables--;
 
 			if (checkable->IsActive())
-				m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
+				ScheduleCheckable(shard, it->second);
+			else
+				shard.Checkables.erase(it);
 
-			m_CV.notify_all();
+			shard.CV.notify_all();
 		}
 	}
 
@@ -263,14 +425,124 @@ void CheckerComponent::ResultTimerHandler()
 {
 	std::ostringstream msgbuf;
 
-	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+	msgbuf << "Pending checkables: " << GetPendingCheckables() << "; Idle checkables: " << GetIdleCheckables() << "; Checks/s: "
+		<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
+
+	Log(LogNotice, "CheckerComponent", msgbuf.str());
+}
+
+/**
+ * Returns the number of checks which may run at the same time.
+ */
+int CheckerComponent::GetConcurrencyLimit() const
+{
+	if (GetAdaptiveConcurrency())
+		return m_ConcurrencyLimit;
+	else
+		return GetConcurrentChecks();
+}
 
-		msgbuf << "Pending checkables: " << m_PendingCheckables.size() << "; Idle checkables: " << m_IdleCheckables.size() << "; Checks/s: "
-			<< (CIB::GetActiveHostChecksStatistics(60) + CIB::GetActiveServiceChecksStatistics(60)) / 60.0;
+void CheckerComponent::PendingChecksDecreasedHandler()
+{
+	if (!m_Throttled.exchange(false))
+		return;
+
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		shard->CV.notify_all();
 	}
+}
 
-	Log(LogNotice, "CheckerComponent", msgbuf.str());
+void CheckerComponent::NewCheckResultHandler(const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
+{
+	/* Only checks which were executed by this endpoint tell us something about its load. */
+	if (origin || !cr->GetActive())
+		return;
+
+	double latency = cr->CalculateExecutionTime();
+
+	boost::mutex::scoped_lock lock(m_LatencyMutex);
+
+	if (m_LongLatency == 0) {
+		m_ShortLatency = latency;
+		m_LongLatency = latency;
+	} else {
+		m_ShortLatency = 0.9 * m_ShortLatency + 0.1 * latency;
+		m_LongLatency = 0.999 * m_LongLatency + 0.001 * latency;
+	}
+}
+
+/**
+ * Returns the number of runnable tasks on the system, or -1 if unknown.
+ */
+static int GetRunQueueLength()
+{
+#ifndef _WIN32
+	double load;
+
+#ifdef __linux__
+	/* The fourth field is "runnable/total", e.g. "0.50 0.40 0.30 3/456 12345". */
+	std::ifstream fp("/proc/loadavg");
+	int runnable;
+
+	if (fp >> load >> load >> load >> runnable)
+		return runnable;
+#endif /* __linux__ */
+
+	if (getloadavg(&load, 1) == 1)
+		return static_cast<int>(load + 0.5);
+#endif /* _WIN32 */
+
+	return -1;
+}
+
+/**
+ * Adjusts the concurrency limit like TCP congestion control (AIMD): it is
+ * cut by a quarter when the system is overloaded, i.e. when there are more
+ * runnable tasks than twice the number of CPU cores, the spawn helper needs
+ * more than half a second to start processes or the checks recently took
+ * twice as long as usual. Otherwise it grows by the number of CPU cores per
+ * second while the limit is actually reached. The limit stays between the
+ * number of CPU cores and four times concurrent_checks.
+ */
+void CheckerComponent::ConcurrencyTimerHandler()
+{
+	int cores = std::max(1, Application::GetConcurrency());
+	int configured = GetConcurrentChecks();
+	int minLimit = std::min(cores, configured);
+	int maxLimit = std::max(configured * 4, minLimit);
+
+	int runQueue = GetRunQueueLength();
+	double spawnLatency = Process::GetSpawnLatencyPercentiles({ 90 })[0];
+	double shortLatency, longLatency;
+
+	{
+		boost::mutex::scoped_lock lock(m_LatencyMutex);
+		shortLatency = m_ShortLatency;
+		longLatency = m_LongLatency;
+	}
+
+	bool overloaded = runQueue > 2 * cores || spawnLatency > 0.5 || (longLatency > 0 && shortLatency > 2 * longLatency);
+
+	int limit = m_ConcurrencyLimit;
+	int newLimit = limit;
+
+	if (overloaded)
+		newLimit = std::max(minLimit, limit * 3 / 4);
+	else if (Checkable::GetPendingChecks() >= limit * 9 / 10)
+		newLimit = std::min(maxLimit, limit + cores);
+
+	if (newLimit == limit)
+		return;
+
+	m_ConcurrencyLimit = newLimit;
+
+	Log(LogNotice, "CheckerComponent")
+		<< "Changed the concurrency limit from " << limit << " to " << newLimit << " (run queue: " << runQueue
+		<< ", spawn latency: " << spawnLatency << "s, check latency: " << shortLatency << "s/" << longLatency << "s).";
+
+	if (newLimit > limit)
+		PendingChecksDecreasedHandler();
 }
 
 void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
@@ -284,61 +556,178 @@ void CheckerComponent::ObjectHandler(const ConfigObject::Ptr& object)
 	bool same_zone = (!zone || Zone::GetLocalZone() == zone);
 
 	{
-		boost::mutex::scoped_lock lock(m_Mutex);
+		Shard& shard = GetShard(checkable);
+		boost::mutex::scoped_lock lock(shard.Mutex);
+
+		auto it = shard.Checkables.find(checkable.get());
 
 		if (object->IsActive() && !object->IsPaused() && same_zone) {
-			if (m_PendingCheckables.find(checkable) != m_PendingCheckables.end())
+			if (it != shard.Checkables.end())
 				return;
 
-			m_IdleCheckables.insert(GetCheckableScheduleInfo(checkable));
-		} else {
-			m_IdleCheckables.erase(checkable);
-			m_PendingCheckables.erase(checkable);
+			CheckableScheduleInfo& csi = shard.Checkables[checkable.get()];
+			csi.Object = checkable;
+			ScheduleCheckable(shard, csi);
+		} else if (it != shard.Checkables.end()) {
+			if (it->second.Pending)
+				shard.PendingCheckables--;
+			else
+				ReleaseDispatchSlot(shard, it->second);
+
+			shard.IdleCheckables.Remove(&it->second);
+			shard.Checkables.erase(it);
 		}
 
-		m_CV.notify_all();
+		shard.CV.notify_all();
 	}
 }
 
-CheckableScheduleInfo CheckerComponent::GetCheckableScheduleInfo(const Checkable::Ptr& checkable)
+void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
 {
-	CheckableScheduleInfo csi;
-	csi.Object = checkable;
-	csi.NextCheck = checkable->GetNextCheck();
-	return csi;
+	Shard& shard = GetShard(checkable);
+	boost::mutex::scoped_lock lock(shard.Mutex);
+
+	auto it = shard.Checkables.find(checkable.get());
+
+	if (it == shard.Checkables.end() || it->second.Pending)
+		return;
+
+	/* Postponed checks keep their place in the wheel and are moved when they
+	 * expire. Check results (e.g. passive ones which keep a service fresh)
+	 * postpone the next check every time, and most of them arrive before
+	 * the check would have to run. */
+	if (checkable->GetNextCheck() >= it->second.GetWhen())
+		return;
+
+	ReleaseDispatchSlot(shard, it->second);
+	ScheduleCheckable(shard, it->second, true);
+
+	shard.CV.notify_all();
 }
 
-void CheckerComponent::NextCheckChangedHandler(const Checkable::Ptr& checkable)
+unsigned long CheckerComponent::GetIdleCheckables()
+{
+	unsigned long count = 0;
+
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->IdleCheckables.GetLength();
+	}
+
+	return count;
+}
+
+unsigned long CheckerComponent::GetPendingCheckables()
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	unsigned long count = 0;
+
+	for (const std::unique_ptr<Shard>& shard : m_Shards) {
+		boost::mutex::scoped_lock lock(shard->Mutex);
+		count += shard->PendingCheckables;
+	}
+
+	return count;
+}
+
+/**
+ * Puts an idle checkable into the timer wheel. With scheduling_jitter set,
+ * checks which aren't forced may be dispatched up to that many seconds (but
+ * at most a tenth of their check interval) later than their next_check, in
+ * the second which has the fewest dispatches. This spreads out checks which
+ * became due at the same time, e.g. after a reload or a bulk reschedule,
+ * and they keep the new offset because the next check is scheduled relative
+ * to the last one.
+ *
+ * The caller must hold the shard's mutex.
+ */
+void CheckerComponent::ScheduleCheckable(Shard& shard, CheckableScheduleInfo& csi, bool reschedule)
+{
+	const Checkable::Ptr& checkable = csi.Object;
+	double when = checkable->GetNextCheck();
+	double window = std::min(GetSchedulingJitter(), checkable->GetCheckInterval() / 10);
+
+	if (window >= 1 && !checkable->GetForceNextCheck()) {
+		double base = std::max(when, Utility::GetTime());
+		auto first = static_cast<int64_t>(std::floor(base));
+		auto last = first + static_cast<int64_t>(window);
+
+		int64_t best = first;
+		unsigned long bestCount = 0;
+		auto it = shard.DispatchSlots.lower_bound(first);
 
-	/* remove and re-insert the object from the set in order to force an index update */
-	typedef boost::multi_index::nth_index<CheckableSet, 0>::type CheckableView;
-	CheckableView& idx = boost::get<0>(m_IdleCheckables);
+		for (int64_t second = first; second <= last; second++) {
+			unsigned long count = 0;
 
-	auto it = idx.find(checkable);
+			if (it != shard.DispatchSlots.end() && it->first == second) {
+				count = it->second;
+				++it;
+			}
+
+			if (second == first || count < bestCount) {
+				best = second;
+				bestCount = count;
+			}
+
+			if (count == 0)
+				break;
+		}
+
+		if (best != first) {
+			when = base + (best - first);
+			shard.SmoothedChecks++;
+		}
+	}
+
+	if (reschedule)
+		shard.IdleCheckables.Reschedule(&csi, when);
+	else
+		shard.IdleCheckables.Insert(&csi, when);
 
-	if (it == idx.end())
+	shard.DispatchSlots[static_cast<int64_t>(std::floor(csi.GetWhen()))]++;
+}
+
+/**
+ * Removes an idle checkable from the dispatch histogram. The caller must
+ * hold the shard's mutex.
+ */
+void CheckerComponent::ReleaseDispatchSlot(Shard& shard, const CheckableScheduleInfo& csi)
+{
+	auto it = shard.DispatchSlots.find(static_cast<int64_t>(std::floor(csi.GetWhen())));
+
+	if (it == shard.DispatchSlots.end())
 		return;
 
-	idx.erase(checkable);
+	if (--it->second == 0)
+		shard.DispatchSlots.erase(it);
+}
 
-	CheckableScheduleInfo csi = GetCheckableScheduleInfo(checkable);
-	idx.insert(csi);
+/**
+ * Returns the shard which is responsible for scheduling the specified
+ * checkable. Services are assigned to the same shard as their host.
+ */
+CheckerComponent::Shard& CheckerComponent::GetShard(const Checkable::Ptr& checkable)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	size_t hash = std::hash<std::string>()(host->GetName().GetData());
 
-	m_CV.notify_all();
+	return *m_Shards[hash % m_Shards.size()];
 }
 
-unsigned long CheckerComponent::GetIdleCheckables()
+void CheckerComponent::ValidateSchedulerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	ObjectImpl<CheckerComponent>::ValidateSchedulerThreads(lvalue, utils);
 
-	return m_IdleCheckables.size();
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "scheduler_threads" }, "Value must be greater than 0."));
 }
 
-unsigned long CheckerComponent::GetPendingCheckables()
+void CheckerComponent::ValidateSchedulingJitter(const Lazy<double>& lvalue, const ValidationUtils& utils)
 {
-	boost::mutex::scoped_lock lock(m_Mutex);
+	ObjectImpl<CheckerComponent>::ValidateSchedulingJitter(lvalue, utils);
 
-	return m_PendingCheckables.size();
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "scheduling_jitter" }, "Value must not be negative."));
 }
@@ -24,40 +24,30 @@
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include "base/timerwheel.hpp"
 #include "base/utility.hpp"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/key_extractors.hpp>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <thread>
+#include <unordered_map>
 
 namespace icinga
 {
 
 /**
+ * Scheduling state for a checkable. The entry is linked into the timer
+ * wheel while the checkable is idle.
+ *
  * @ingroup checker
  */
-struct CheckableScheduleInfo
+struct CheckableScheduleInfo : public TimerWheelEntry
 {
 	Checkable::Ptr Object;
-	double NextCheck;
-};
-
-/**
- * @ingroup checker
- */
-struct CheckableNextCheckExtractor
-{
-	typedef double result_type;
-
-	/**
-	 * @threadsafety Always.
-	 */
-	double operator()(const CheckableScheduleInfo& csi)
-	{
-		return csi.NextCheck;
-	}
+	bool Pending{false};
 };
 
 /**
@@ -69,14 +59,6 @@ public:
 	DECLARE_OBJECT(CheckerComponent);
 	DECLARE_OBJECTNAME(CheckerComponent);
 
-	typedef boost::multi_index_container<
-		CheckableScheduleInfo,
-		boost::multi_index::indexed_by<
-			boost::multi_index::ordered_unique<boost::multi_index::member<CheckableScheduleInfo, Checkable::Ptr, &CheckableScheduleInfo::Object> >,
-			boost::multi_index::ordered_non_unique<CheckableNextCheckExtractor>
-		>
-	> CheckableSet;
-
 	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
@@ -84,21 +66,67 @@ public:
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 	unsigned long GetIdleCheckables();
 	unsigned long GetPendingCheckables();
+	int GetConcurrencyLimit() const;
+
+	void ValidateSchedulerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateSchedulingJitter(const Lazy<double>& lvalue, const ValidationUtils& utils) override;
 
 private:
-	boost::mutex m_Mutex;
-	boost::condition_variable m_CV;
-	bool m_Stopped{false};
-	std::thread m_Thread;
+	/**
+	 * A partition of the checkables handled by this checker. Each shard
+	 * is served by its own scheduler thread.
+	 */
+	struct Shard
+	{
+		boost::mutex Mutex;
+		boost::condition_variable CV;
+		bool Stopped{false};
+		std::thread Thread;
+
+		std::unordered_map<Checkable *, CheckableScheduleInfo> Checkables;
+		TimerWheel IdleCheckables{0.01};
+		unsigned long PendingCheckables{0};
+
+		/* Number of idle checkables per second of their dispatch time. */
+		std::map<int64_t, unsigned long> DispatchSlots;
+		unsigned long SmoothedChecks{0};
+
+		/* How late (in seconds) the most recently dispatched check was. */
+		double Lag{0};
+
+		unsigned long LastBatchSize{0};
+		unsigned long Batches{0};
+		unsigned long BatchedChecks{0};
+	};
 
-	CheckableSet m_IdleCheckables;
-	CheckableSet m_PendingCheckables;
+	std::vector<std::unique_ptr<Shard> > m_Shards;
 
 	Timer::Ptr m_ResultTimer;
+	Timer::Ptr m_ConcurrencyTimer;
 
-	void CheckThreadProc();
+	/* The limit which is used instead of concurrent_checks with adaptive_concurrency. */
+	std::atomic<int> m_ConcurrencyLimit{0};
+
+	/* Whether a scheduler thread waits for running checks to finish. */
+	std::atomic<bool> m_Throttled{false};
+
+	boost::mutex m_LatencyMutex;
+	double m_ShortLatency{0};
+	double m_LongLatency{0};
+
+	Shard& GetShard(const Checkable::Ptr& checkable);
+
+	void ScheduleCheckable(Shard& shard, CheckableScheduleInfo& csi, bool reschedule = false);
+	static void ReleaseDispatchSlot(Shard& shard, const CheckableScheduleInfo& csi);
+
+	void CheckThreadProc(Shard& shard);
 	void ResultTimerHandler();
+	void ConcurrencyTimerHandler();
+	void PendingChecksDecreasedHandler();
+	void NewCheckResultHandler(const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin);
 
+	bool CanExecuteCheck(const Checkable::Ptr& checkable);
+	void ExecuteCheckBatch(const std::vector<Checkable::Ptr>& checkables);
 	void ExecuteCheckHelper(const Checkable::Ptr& checkable);
 
 	void AdjustCheckTimer();
@@ -107,8 +135,6 @@ private:
 	void NextCheckChangedHandler(const Checkable::Ptr& checkable);
 
 	void RescheduleCheckTimer();
-
-	static CheckableScheduleInfo GetCheckableScheduleInfo(const Checkable::Ptr& checkable);
 };
 
 }
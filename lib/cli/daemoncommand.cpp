@@ -21,6 +21,8 @@
 #include "cli/daemonutility.hpp"
 #include "remote/apilistener.hpp"
 #include "remote/configobjectutility.hpp"
+#include "config/applyrule.hpp"
+#include "config/configcache.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
 #include "config/configitembuilder.hpp"
@@ -32,6 +34,7 @@
 #include "base/convert.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/context.hpp"
+#include "base/startupprofile.hpp"
 #include "config.h"
 #include <boost/program_options.hpp>
 #include <boost/tuple/tuple.hpp>
@@ -156,6 +159,9 @@ void DaemonCommand::InitParameters(boost::program_options::options_description&
 		("config,c", po::value<std::vector<std::string> >(), "parse a configuration file")
 		("no-config,z", "start without a configuration file")
 		("validate,C", "exit after validating the configuration")
+		("timings", "print how long the startup phases took")
+		("config-cache", "load the configuration from the config cache if it is up to date")
+		("incremental-reload", "apply changes to files which only contain object definitions without starting a new process")
 		("errorlog,e", po::value<std::string>(), "log fatal errors to the specified log file (only works in combination with --daemonize)")
 #ifndef _WIN32
 		("daemonize,d", "detach from the controlling terminal")
@@ -211,11 +217,43 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 
 	std::vector<ConfigItem::Ptr> newItems;
 
-	if (!DaemonUtility::LoadConfigFiles(configs, newItems, Application::GetObjectsPath(), Application::GetVarsPath()))
-		return EXIT_FAILURE;
+	bool useConfigCache = vm.count("config-cache");
+	String configCachePath = Utility::DirName(Application::GetObjectsPath()) + "/icinga2.cache";
+
+	if (useConfigCache)
+		ConfigCache::CaptureGlobals();
+
+	if (vm.count("timings"))
+		ApplyRule::EnableProfiling();
+
+	bool compiled = false;
+
+	/* The configuration is always compiled when validating it. */
+	if (!useConfigCache || vm.count("validate") || !DaemonUtility::LoadConfigCache(configCachePath, newItems)) {
+		if (!DaemonUtility::LoadConfigFiles(configs, newItems, Application::GetObjectsPath(), Application::GetVarsPath()))
+			return EXIT_FAILURE;
+
+		compiled = true;
+
+		if (useConfigCache) {
+			try {
+				ConfigCache::WriteCache(configCachePath, newItems);
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "cli")
+					<< "Could not write config cache '" << configCachePath << "': " << DiagnosticInformation(ex, false);
+			}
+		}
+	}
 
 	if (vm.count("validate")) {
 		Log(LogInformation, "cli", "Finished validating the configuration file(s).");
+
+		if (vm.count("timings")) {
+			StartupProfile::Print(std::cout);
+			std::cout << "\n";
+			ApplyRule::PrintSlowestRules(std::cout, 10);
+		}
+
 		return EXIT_SUCCESS;
 	}
 
@@ -253,6 +291,7 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 
 	/* restore the previous program state */
 	try {
+		StartupPhase phase("restore_objects");
 		ConfigObject::RestoreObjects(Application::GetStatePath());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "cli")
@@ -264,6 +303,8 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		WorkQueue upq(25000, Application::GetConcurrency());
 		upq.SetName("DaemonCommand::Run");
 
+		StartupPhase phase("activate_items");
+
 		// activate config only after daemonization: it starts threads and that is not compatible with fork()
 		if (!ConfigItem::ActivateItems(upq, newItems, false, false, true)) {
 			Log(LogCritical, "cli", "Error activating configuration.");
@@ -271,6 +312,15 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 		}
 	}
 
+	if (vm.count("incremental-reload")) {
+		/* Files which were loaded from the config cache cannot be compiled again on their own. */
+		if (compiled) {
+			ConfigCache::SnapshotInputs();
+			Application::SetReloadHandler(&DaemonUtility::ReloadChangedConfigFiles);
+		} else
+			Log(LogWarning, "cli", "Incremental reloads are not available because the configuration was loaded from the config cache.");
+	}
+
 	if (vm.count("daemonize")) {
 		String errorLog;
 		if (vm.count("errorlog"))
@@ -290,7 +340,27 @@ int DaemonCommand::Run(const po::variables_map& vm, const std::vector<std::strin
 	sigaction(SIGHUP, &sa, nullptr);
 #endif /* _WIN32 */
 
-	ApiListener::UpdateObjectAuthority();
+	{
+		StartupPhase phase("update_object_authority");
+		ApiListener::UpdateObjectAuthority();
+	}
+
+	StartupProfile::Finish();
+
+	if (vm.count("timings")) {
+		StartupProfile::Print(std::cout);
+		std::cout << "\n";
+		ApplyRule::PrintSlowestRules(std::cout, 10);
+	}
+
+	String startupProfilePath = Utility::DirName(Application::GetPidPath()) + "/icinga2.startup.json";
+
+	try {
+		StartupProfile::WriteToFile(startupProfilePath);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "cli")
+			<< "Could not write startup profile '" << startupProfilePath << "': " << DiagnosticInformation(ex, false);
+	}
 
 	return Application::GetInstance()->Run();
 }
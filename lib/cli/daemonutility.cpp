@@ -21,9 +21,20 @@
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/application.hpp"
+#include "base/configtype.hpp"
+#include "base/dependencygraph.hpp"
+#include "base/process.hpp"
+#include "base/serializer.hpp"
+#include "base/startupprofile.hpp"
+#include "config/applyrule.hpp"
+#include "config/configcache.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configcompilercontext.hpp"
 #include "config/configitembuilder.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+#include <fstream>
+#include <set>
 
 
 using namespace icinga;
@@ -51,8 +62,13 @@ static void IncludeZoneDirRecursive(const String& path, const String& package, b
 	/* register this zone path for cluster config sync */
 	ConfigCompiler::RegisterZoneDir("_etc", path, zoneName);
 
+	ConfigCache::AddRecursiveGlobInput(path, "*.conf", GlobFile);
+
+	std::vector<String> files;
+	Utility::GlobRecursive(path, "*.conf", [&files](const String& file) { files.push_back(file); }, GlobFile);
+
 	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(path, "*.conf", std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zoneName, package), GlobFile);
+	ConfigCompiler::CompileFiles(expressions, files, zoneName, package);
 	DictExpression expr(std::move(expressions));
 	if (!ExecuteExpression(&expr))
 		success = false;
@@ -65,6 +81,8 @@ static void IncludeNonLocalZone(const String& zonePath, const String& package, b
 
 	String zoneName = Utility::BaseName(zonePath);
 
+	ConfigCache::AddFileInput(zonePath + "/.authoritative");
+
 	/* Check whether this node already has an authoritative config version
 	 * from zones.d in etc or api package directory, or a local marker file)
 	 */
@@ -74,8 +92,13 @@ static void IncludeNonLocalZone(const String& zonePath, const String& package, b
 		return;
 	}
 
+	ConfigCache::AddRecursiveGlobInput(zonePath, "*.conf", GlobFile);
+
+	std::vector<String> files;
+	Utility::GlobRecursive(zonePath, "*.conf", [&files](const String& file) { files.push_back(file); }, GlobFile);
+
 	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(zonePath, "*.conf", std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zoneName, package), GlobFile);
+	ConfigCompiler::CompileFiles(expressions, files, zoneName, package);
 	DictExpression expr(std::move(expressions));
 	if (!ExecuteExpression(&expr))
 		success = false;
@@ -87,6 +110,8 @@ static void IncludePackage(const String& packagePath, bool& success)
 	 * for config sync inside their generated config. */
 	String packageName = Utility::BaseName(packagePath);
 
+	ConfigCache::AddFileInput(packagePath + "/include.conf");
+
 	if (Utility::PathExists(packagePath + "/include.conf")) {
 		std::unique_ptr<Expression> expr = ConfigCompiler::CompileFile(packagePath + "/include.conf",
 			String(), packageName);
@@ -122,6 +147,7 @@ bool DaemonUtility::ValidateConfigFiles(const std::vector<std::string>& configs,
 	success = true;
 
 	String zonesEtcDir = Application::GetZonesDir();
+	ConfigCache::AddGlobInput(zonesEtcDir + "/*", GlobDirectory);
 	if (!zonesEtcDir.IsEmpty() && Utility::PathExists(zonesEtcDir))
 		Utility::Glob(zonesEtcDir + "/*", std::bind(&IncludeZoneDirRecursive, _1, "_etc", std::ref(success)), GlobDirectory);
 
@@ -131,6 +157,7 @@ bool DaemonUtility::ValidateConfigFiles(const std::vector<std::string>& configs,
 	/* Load package config files - they may contain additional zones which
 	 * are authoritative on this node and are checked in HasZoneConfigAuthority(). */
 	String packagesVarDir = Application::GetLocalStateDir() + "/lib/icinga2/api/packages";
+	ConfigCache::AddGlobInput(packagesVarDir + "/*", GlobDirectory);
 	if (Utility::PathExists(packagesVarDir))
 		Utility::Glob(packagesVarDir + "/*", std::bind(&IncludePackage, _1, std::ref(success)), GlobDirectory);
 
@@ -139,6 +166,7 @@ bool DaemonUtility::ValidateConfigFiles(const std::vector<std::string>& configs,
 
 	/* Load cluster synchronized configuration files */
 	String zonesVarDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
+	ConfigCache::AddGlobInput(zonesVarDir + "/*", GlobDirectory);
 	if (Utility::PathExists(zonesVarDir))
 		Utility::Glob(zonesVarDir + "/*", std::bind(&IncludeNonLocalZone, _1, "_cluster", std::ref(success)), GlobDirectory);
 
@@ -165,14 +193,27 @@ bool DaemonUtility::LoadConfigFiles(const std::vector<std::string>& configs,
 {
 	ActivationScope ascope;
 
-	if (!DaemonUtility::ValidateConfigFiles(configs, objectsFile)) {
+	bool validated;
+
+	{
+		StartupPhase phase("config_compile");
+		validated = DaemonUtility::ValidateConfigFiles(configs, objectsFile);
+	}
+
+	if (!validated) {
 		ConfigCompilerContext::GetInstance()->CancelObjectsFile();
 		return false;
 	}
 
 	WorkQueue upq(25000, Application::GetConcurrency());
 	upq.SetName("DaemonUtility::LoadConfigFiles");
-	bool result = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
+
+	bool result;
+
+	{
+		StartupPhase phase("commit_items");
+		result = ConfigItem::CommitItems(ascope.GetContext(), upq, newItems);
+	}
 
 	if (!result) {
 		ConfigCompilerContext::GetInstance()->CancelObjectsFile();
@@ -190,3 +231,369 @@ bool DaemonUtility::LoadConfigFiles(const std::vector<std::string>& configs,
 
 	return true;
 }
+
+/**
+ * Loads the config items from the config cache instead of compiling the
+ * configuration files.
+ *
+ * @returns false if the cache is outdated or could not be loaded.
+ */
+bool DaemonUtility::LoadConfigCache(const String& cacheFile, std::vector<ConfigItem::Ptr>& newItems)
+{
+	ActivationScope ascope;
+
+	try {
+		StartupPhase phase("config_cache_load");
+
+		if (!ConfigCache::LoadCache(cacheFile))
+			return false;
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "cli")
+			<< "Could not read config cache '" << cacheFile << "': " << DiagnosticInformation(ex, false);
+		return false;
+	}
+
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("DaemonUtility::LoadConfigCache");
+
+	StartupPhase phase("commit_items");
+
+	if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems)) {
+		newItems.clear();
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Validates the configuration in a new process, just like a regular reload does.
+ */
+static bool ValidateConfigInChildProcess()
+{
+	ArrayData args;
+	args.push_back(Application::GetExePath(Application::GetArgV()[0]));
+
+	for (int i = 1; i < Application::GetArgC(); i++) {
+		if (std::string(Application::GetArgV()[i]) != "--reload-internal")
+			args.push_back(Application::GetArgV()[i]);
+		else
+			i++; // the next parameter after --reload-internal is the pid, remove that too
+	}
+
+	args.push_back("--validate");
+
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	bool finished = false;
+	ProcessResult result;
+
+	Process::Ptr process = new Process(Process::PrepareCommand(new Array(std::move(args))));
+	process->SetTimeout(300);
+	process->Run([&mutex, &cv, &finished, &result](const ProcessResult& pr) {
+		boost::mutex::scoped_lock lock(mutex);
+		result = pr;
+		finished = true;
+		cv.notify_all();
+	});
+
+	boost::mutex::scoped_lock lock(mutex);
+
+	while (!finished)
+		cv.wait(lock);
+
+	return result.ExitStatus == 0;
+}
+
+/**
+ * Checks whether an object was created by an apply rule rather than an object definition.
+ */
+static bool IsCreatedByApplyRule(const ConfigObject::Ptr& object)
+{
+	DebugInfo di = object->GetDebugInfo();
+
+	for (const ApplyRule& rule : ApplyRule::GetRules(object->GetReflectionType()->GetName())) {
+		DebugInfo rdi = rule.GetDebugInfo();
+
+		if (rdi.Path == di.Path && rdi.FirstLine == di.FirstLine && rdi.FirstColumn == di.FirstColumn)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Objects which were created by apply rules are only re-created if the
+ * host or service they were applied to is re-created as well.
+ */
+static bool IsApplyTargetReloaded(const ConfigObject::Ptr& object, const std::set<ConfigObject::Ptr>& objects)
+{
+	Type::Ptr type = object->GetReflectionType();
+
+	String prefix;
+	int hostField = type->GetFieldId("host_name");
+
+	if (hostField == -1) {
+		prefix = "child_";
+		hostField = type->GetFieldId("child_host_name");
+	}
+
+	if (hostField == -1)
+		return false;
+
+	String hostName = object->GetField(hostField);
+	String serviceName;
+
+	int serviceField = type->GetFieldId(prefix + "service_name");
+
+	if (serviceField != -1)
+		serviceName = object->GetField(serviceField);
+
+	ConfigObject::Ptr target;
+
+	if (serviceName.IsEmpty())
+		target = ConfigObject::GetObject("Host", hostName);
+	else
+		target = ConfigObject::GetObject("Service", hostName + "!" + serviceName);
+
+	return target && objects.find(target) != objects.end();
+}
+
+/**
+ * Checks whether the config file an object was defined in can be compiled again on its own.
+ */
+static bool GetReloadableFileInfo(const ConfigObject::Ptr& object, ConfigFileInfo *info)
+{
+	String path = object->GetDebugInfo().Path;
+
+	if (ConfigCompiler::GetConfigFileInfo(path, info))
+		return info->ObjectsOnly && info->Zone.IsEmpty();
+
+	/* Objects which were created using the API have their own config file. */
+	if (object->GetPackage() == "_api" && Utility::PathExists(path)) {
+		*info = { String(), "_api", true };
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Applies changes to config files which only contain object definitions to
+ * the running process: The objects from these files (and the objects which
+ * depend on them) are deleted and created again. The new configuration is
+ * validated in a child process first.
+ *
+ * @returns false if a new process has to be started to reload the configuration.
+ */
+bool DaemonUtility::ReloadChangedConfigFiles()
+{
+	double start = Utility::GetTime();
+
+	std::vector<String> changedFiles;
+
+	/* Objects created using the API don't require a reload. */
+	if (!ConfigCache::GetChangedFiles(changedFiles, Application::GetLocalStateDir() + "/lib/icinga2/api/packages/_api")) {
+		Log(LogInformation, "cli", "Config files were added or removed, starting a new process.");
+		return false;
+	}
+
+	if (changedFiles.empty()) {
+		Log(LogInformation, "cli", "No config files have changed, starting a new process.");
+		return false;
+	}
+
+	std::map<String, ConfigFileInfo> files;
+	std::deque<String> pending;
+
+	for (const String& path : changedFiles) {
+		ConfigFileInfo info;
+
+		if (!ConfigCompiler::GetConfigFileInfo(path, &info) || !info.ObjectsOnly || !info.Zone.IsEmpty()) {
+			Log(LogInformation, "cli")
+				<< "Config file '" << path << "' doesn't only contain object definitions, starting a new process.";
+			return false;
+		}
+
+		files[path] = info;
+		pending.push_back(path);
+	}
+
+	std::map<String, std::vector<ConfigObject::Ptr> > objectsByPath;
+
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!ctype)
+			continue;
+
+		for (const ConfigObject::Ptr& object : ctype->GetObjectView())
+			objectsByPath[object->GetDebugInfo().Path].push_back(object);
+	}
+
+	/* Objects which depend on other objects are deleted first. */
+	std::vector<ConfigObject::Ptr> objects;
+	std::set<ConfigObject::Ptr> seen;
+
+	std::function<bool (const ConfigObject::Ptr&)> collectObject = [&](const ConfigObject::Ptr& object) {
+		if (!seen.insert(object).second)
+			return true;
+
+		for (const Object::Ptr& pobj : DependencyGraph::GetParents(object)) {
+			ConfigObject::Ptr parent = dynamic_pointer_cast<ConfigObject>(pobj);
+
+			if (!parent)
+				continue;
+
+			String path = parent->GetDebugInfo().Path;
+
+			if (files.find(path) == files.end() && !IsCreatedByApplyRule(parent)) {
+				ConfigFileInfo info;
+
+				if (!GetReloadableFileInfo(parent, &info)) {
+					Log(LogInformation, "cli")
+						<< "Object '" << parent->GetName() << "' of type '" << parent->GetReflectionType()->GetName()
+						<< "' depends on '" << object->GetName() << "' and cannot be re-created, starting a new process.";
+					return false;
+				}
+
+				files[path] = info;
+				pending.push_back(path);
+			}
+
+			if (!collectObject(parent))
+				return false;
+		}
+
+		objects.push_back(object);
+		return true;
+	};
+
+	while (!pending.empty()) {
+		String path = pending.front();
+		pending.pop_front();
+
+		for (const ConfigObject::Ptr& object : objectsByPath[path]) {
+			if (!collectObject(object))
+				return false;
+		}
+	}
+
+	for (const ConfigObject::Ptr& object : objects) {
+		if (files.find(object->GetDebugInfo().Path) == files.end() && !IsApplyTargetReloaded(object, seen)) {
+			Log(LogInformation, "cli")
+				<< "Object '" << object->GetName() << "' of type '" << object->GetReflectionType()->GetName()
+				<< "' was created by an apply rule for an object which isn't re-created, starting a new process.";
+			return false;
+		}
+	}
+
+	/* Compile the files before touching any objects. */
+	std::vector<std::unique_ptr<Expression> > expressions;
+
+	for (const auto& kv : files) {
+		std::ifstream fp(kv.first.CStr(), std::ifstream::in | std::ifstream::binary);
+
+		if (!fp)
+			return false;
+
+		String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+
+		std::unique_ptr<Expression> expression = ConfigCompiler::CompileText(kv.first, content, kv.second.Zone, kv.second.Package);
+
+		if (!ConfigCompiler::IsObjectsOnly(expression.get())) {
+			Log(LogInformation, "cli")
+				<< "Config file '" << kv.first << "' doesn't only contain object definitions, starting a new process.";
+			return false;
+		}
+
+		expressions.push_back(std::move(expression));
+	}
+
+	Log(LogInformation, "cli")
+		<< "Validating the configuration before reloading " << files.size() << " config files in this process.";
+
+	if (!ValidateConfigInChildProcess()) {
+		Application::SetLastReloadFailed(Utility::GetTime());
+		Log(LogCritical, "Application", "Found error in config: reloading aborted");
+		return true;
+	}
+
+	/* Remember the state and the modified attributes so that they can be restored for the new objects. */
+	typedef std::pair<Type::Ptr, String> ObjectKey;
+
+	std::map<ObjectKey, Dictionary::Ptr> states;
+	std::map<ObjectKey, std::vector<std::pair<String, Value> > > modifiedAttributes;
+
+	for (const ConfigObject::Ptr& object : objects)
+		states[ObjectKey(object->GetReflectionType(), object->GetName())] = Serialize(object, FAState);
+
+	ConfigObject::DumpModifiedAttributes([&seen, &modifiedAttributes](const ConfigObject::Ptr& object, const String& attr, const Value& value) {
+		if (seen.find(object) != seen.end())
+			modifiedAttributes[ObjectKey(object->GetReflectionType(), object->GetName())].emplace_back(attr, value);
+	});
+
+	for (const ConfigObject::Ptr& object : objects) {
+		object->Deactivate(true);
+
+		ConfigItem::Ptr item = ConfigItem::GetByTypeAndName(object->GetReflectionType(), object->GetName());
+
+		if (item)
+			item->Unregister();
+		else
+			object->Unregister();
+	}
+
+	ActivationScope ascope;
+
+	for (const std::unique_ptr<Expression>& expression : expressions) {
+		if (!ExecuteExpression(expression.get())) {
+			Log(LogCritical, "cli", "Could not reload the changed config files, starting a new process.");
+			return false;
+		}
+	}
+
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("DaemonUtility::ReloadChangedConfigFiles");
+
+	std::vector<ConfigItem::Ptr> newItems;
+
+	if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems, true)) {
+		Log(LogCritical, "cli", "Could not reload the changed config files, starting a new process.");
+		return false;
+	}
+
+	for (const ConfigItem::Ptr& item : newItems) {
+		ConfigObject::Ptr object = item->GetObject();
+
+		if (!object)
+			continue;
+
+		ObjectKey key(object->GetReflectionType(), object->GetName());
+
+		auto it = states.find(key);
+
+		if (it != states.end())
+			Deserialize(object, it->second, false, FAState);
+
+		auto it2 = modifiedAttributes.find(key);
+
+		if (it2 != modifiedAttributes.end()) {
+			for (const auto& attr : it2->second)
+				object->ModifyAttribute(attr.first, attr.second, false);
+		}
+	}
+
+	if (!ConfigItem::ActivateItems(upq, newItems, true, true)) {
+		Log(LogCritical, "cli", "Could not activate the reloaded objects, starting a new process.");
+		return false;
+	}
+
+	ConfigCache::SnapshotInputs();
+
+	Log(LogInformation, "cli")
+		<< "Reloaded " << files.size() << " config files in this process: Deleted " << objects.size()
+		<< " and created " << newItems.size() << " objects in " << Utility::FormatDuration(Utility::GetTime() - start) << ".";
+
+	return true;
+}
@@ -37,6 +37,8 @@ public:
 	static bool ValidateConfigFiles(const std::vector<std::string>& configs, const String& objectsFile = String());
 	static bool LoadConfigFiles(const std::vector<std::string>& configs, std::vector<ConfigItem::Ptr>& newItems,
 		const String& objectsFile = String(), const String& varsfile = String());
+	static bool LoadConfigCache(const String& cacheFile, std::vector<ConfigItem::Ptr>& newItems);
+	static bool ReloadChangedConfigFiles();
 };
 
 }
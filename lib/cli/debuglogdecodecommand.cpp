@@ -0,0 +1,111 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "cli/debuglogdecodecommand.hpp"
+#include "base/binarylog.hpp"
+#include "base/logger.hpp"
+#include "base/streamlogger.hpp"
+#include "base/utility.hpp"
+#include <fstream>
+#include <iostream>
+
+using namespace icinga;
+namespace po = boost::program_options;
+
+REGISTER_CLICOMMAND("debuglog/decode", DebugLogDecodeCommand);
+
+String DebugLogDecodeCommand::GetDescription() const
+{
+	return "Renders a binary debug log file as text.";
+}
+
+String DebugLogDecodeCommand::GetShortDescription() const
+{
+	return "decodes a binary debug log";
+}
+
+int DebugLogDecodeCommand::GetMinArguments() const
+{
+	return 1;
+}
+
+int DebugLogDecodeCommand::GetMaxArguments() const
+{
+	return -1;
+}
+
+void DebugLogDecodeCommand::InitParameters(boost::program_options::options_description& visibleDesc,
+	boost::program_options::options_description& hiddenDesc) const
+{
+	visibleDesc.add_options()
+		("facility,f", po::value<std::string>(), "filter by facility matches")
+		("severity,s", po::value<std::string>(), "minimum severity (default: debug)");
+}
+
+/**
+ * The entry point for the "debuglog decode" CLI command.
+ *
+ * @returns An exit status.
+ */
+int DebugLogDecodeCommand::Run(const boost::program_options::variables_map& vm, const std::vector<std::string>& ap) const
+{
+	String facilityFilter;
+	LogSeverity minSeverity = LogDebug;
+
+	if (vm.count("facility"))
+		facilityFilter = vm["facility"].as<std::string>();
+
+	if (vm.count("severity"))
+		minSeverity = Logger::StringToSeverity(vm["severity"].as<std::string>());
+
+	for (const std::string& path : ap) {
+		std::ifstream fp(path.c_str(), std::ios_base::in | std::ios_base::binary);
+
+		if (!fp) {
+			Log(LogCritical, "cli")
+				<< "Cannot open binary log file '" << path << "'.";
+			return 1;
+		}
+
+		BinaryLogReader reader;
+		LogEntry entry;
+
+		try {
+			while (reader.ReadEntry(fp, &entry)) {
+				if (entry.Severity < minSeverity)
+					continue;
+
+				if (!facilityFilter.IsEmpty() && !Utility::Match(facilityFilter, entry.Facility))
+					continue;
+
+				StreamLogger::ProcessLogEntry(std::cout, entry);
+			}
+		} catch (const std::exception& ex) {
+			std::cout.flush();
+
+			Log(LogCritical, "cli")
+				<< "Failed to decode binary log file '" << path << "': " << ex.what();
+			return 1;
+		}
+	}
+
+	std::cout.flush();
+
+	return 0;
+}
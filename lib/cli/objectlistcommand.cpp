@@ -26,6 +26,7 @@
 #include "base/configtype.hpp"
 #include "base/json.hpp"
 #include "base/netstring.hpp"
+#include "base/netstringindex.hpp"
 #include "base/stdiostream.hpp"
 #include "base/debug.hpp"
 #include "base/objectlock.hpp"
@@ -79,7 +80,6 @@ int ObjectListCommand::Run(const boost::program_options::variables_map& vm, cons
 	std::fstream fp;
 	fp.open(objectfile.CStr(), std::ios_base::in);
 
-	StdioStream::Ptr sfp = new StdioStream(&fp, false);
 	unsigned long objects_count = 0;
 	std::map<String, int> type_count;
 
@@ -92,22 +92,41 @@ int ObjectListCommand::Run(const boost::program_options::variables_map& vm, cons
 
 	bool first = true;
 
-	String message;
-	StreamReadContext src;
-	for (;;) {
-		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+	std::vector<NetStringIndexEntry> index;
 
-		if (srs == StatusEof)
-			break;
+	/* Use the index to skip objects which don't match the filters. */
+	if ((!name_filter.IsEmpty() || !type_filter.IsEmpty()) && NetStringIndex::ReadFromFile(objectfile, index)) {
+		for (const NetStringIndexEntry& entry : index) {
+			if (!name_filter.IsEmpty() && !Utility::Match(name_filter, entry.Name) && !Utility::Match(name_filter, entry.FullName))
+				continue;
+			if (!type_filter.IsEmpty() && !Utility::Match(type_filter, entry.Type))
+				continue;
 
-		if (srs != StatusNewItem)
-			continue;
+			ObjectListUtility::PrintObject(std::cout, first, NetStringIndex::ReadRecord(fp, entry.Offset), type_count, name_filter, type_filter);
+		}
 
-		ObjectListUtility::PrintObject(std::cout, first, message, type_count, name_filter, type_filter);
-		objects_count++;
+		objects_count = index.size();
+	} else {
+		StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+		String message;
+		StreamReadContext src;
+		for (;;) {
+			StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			ObjectListUtility::PrintObject(std::cout, first, message, type_count, name_filter, type_filter);
+			objects_count++;
+		}
+
+		sfp->Close();
 	}
 
-	sfp->Close();
 	fp.close();
 
 	if (vm.count("count")) {
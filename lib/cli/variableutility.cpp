@@ -23,6 +23,7 @@
 #include "base/utility.hpp"
 #include "base/stdiostream.hpp"
 #include "base/netstring.hpp"
+#include "base/netstringindex.hpp"
 #include "base/json.hpp"
 #include "remote/jsonrpc.hpp"
 #include <fstream>
@@ -36,6 +37,20 @@ Value VariableUtility::GetVariable(const String& name)
 	std::fstream fp;
 	fp.open(varsfile.CStr(), std::ios_base::in);
 
+	std::vector<NetStringIndexEntry> index;
+
+	if (NetStringIndex::ReadFromFile(varsfile, index)) {
+		for (const NetStringIndexEntry& entry : index) {
+			if (entry.Name != name)
+				continue;
+
+			Dictionary::Ptr variable = JsonDecode(NetStringIndex::ReadRecord(fp, entry.Offset));
+			return variable->Get("value");
+		}
+
+		return Empty;
+	}
+
 	StdioStream::Ptr sfp = new StdioStream(&fp, false);
 
 	String message;
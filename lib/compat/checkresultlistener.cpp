@@ -0,0 +1,462 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "compat/checkresultlistener.hpp"
+#include "compat/checkresultlistener-ti.cpp"
+#include "icinga/host.hpp"
+#include "icinga/service.hpp"
+#include "icinga/pluginutility.hpp"
+#include "base/configtype.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/unixsocket.hpp"
+#include "base/utility.hpp"
+#include <functional>
+
+using namespace icinga;
+
+REGISTER_TYPE(CheckResultListener);
+
+REGISTER_STATSFUNCTION(CheckResultListener, &CheckResultListener::StatsFunc);
+
+/* Records which are larger than this are treated as a protocol error. */
+#define CHECKRESULT_MAX_RECORD_SIZE (1024 * 1024)
+
+namespace icinga
+{
+
+/**
+ * A decoded check result record.
+ */
+struct CheckResultRecord
+{
+	uint32_t Sequence;
+	int ExitStatus;
+	double ExecutionStart;
+	double ExecutionEnd;
+	String HostName;
+	String ServiceName;
+	String Output;
+	String PerformanceData;
+};
+
+struct CheckResultListenerClient
+{
+	Socket::Ptr Client;
+	boost::mutex WriteMutex;
+	bool Failed{false};
+};
+
+}
+
+void CheckResultListener::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData nodes;
+
+	for (const CheckResultListener::Ptr& listener : ConfigType::GetObjectViewByType<CheckResultListener>()) {
+		size_t clients;
+
+		{
+			boost::mutex::scoped_lock lock(listener->m_ClientsMutex);
+			clients = listener->m_Clients.size();
+		}
+
+		size_t pending = 0;
+
+		for (const auto& queue : listener->m_Queues)
+			pending += queue->GetLength();
+
+		nodes.emplace_back(listener->GetName(), new Dictionary({
+			{ "clients", clients },
+			{ "pending_results", pending },
+			{ "processed_results", listener->m_Processed.load() },
+			{ "failed_results", listener->m_Failed.load() }
+		}));
+
+		perfdata->Add(new PerfdataValue("checkresultlistener_" + listener->GetName() + "_clients", clients));
+		perfdata->Add(new PerfdataValue("checkresultlistener_" + listener->GetName() + "_pending_results", pending));
+		perfdata->Add(new PerfdataValue("checkresultlistener_" + listener->GetName() + "_processed_results", listener->m_Processed.load()));
+	}
+
+	status->Set("checkresultlistener", new Dictionary(std::move(nodes)));
+}
+
+/**
+ * Starts the component.
+ */
+void CheckResultListener::Start(bool runtimeCreated)
+{
+	ObjectImpl<CheckResultListener>::Start(runtimeCreated);
+
+	Log(LogInformation, "CheckResultListener")
+		<< "'" << GetName() << "' started.";
+
+#ifndef _WIN32
+	for (int i = 0; i < GetWorkerThreads(); i++) {
+		m_Queues.emplace_back(new WorkQueue(25000));
+		m_Queues.back()->SetName("CheckResultListener, " + GetName());
+	}
+
+	UnixSocket::Ptr socket = new UnixSocket();
+
+	try {
+		socket->Bind(GetSocketPath());
+	} catch (const std::exception&) {
+		Log(LogCritical, "CheckResultListener")
+			<< "Cannot bind UNIX socket to '" << GetSocketPath() << "'.";
+		return;
+	}
+
+	/* group must be able to write */
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP;
+
+	if (chmod(GetSocketPath().CStr(), mode) < 0) {
+		Log(LogCritical, "CheckResultListener")
+			<< "chmod() on unix socket '" << GetSocketPath() << "' failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return;
+	}
+
+	m_Listener = socket;
+
+	m_Thread = std::thread(std::bind(&CheckResultListener::ServerThreadProc, this));
+
+	Log(LogInformation, "CheckResultListener")
+		<< "Created UNIX socket in '" << GetSocketPath() << "'.";
+#else /* _WIN32 */
+	/* no UNIX sockets on windows */
+	Log(LogCritical, "CheckResultListener", "Unix sockets are not supported on Windows.");
+#endif /* _WIN32 */
+}
+
+/**
+ * Stops the component.
+ */
+void CheckResultListener::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<CheckResultListener>::Stop(runtimeRemoved);
+
+	Log(LogInformation, "CheckResultListener")
+		<< "'" << GetName() << "' stopped.";
+
+	if (m_Listener)
+		m_Listener->Close();
+
+	if (m_Thread.joinable())
+		m_Thread.join();
+
+	std::set<Socket::Ptr> clients;
+
+	{
+		boost::mutex::scoped_lock lock(m_ClientsMutex);
+		clients = m_Clients;
+	}
+
+	for (const Socket::Ptr& client : clients)
+		client->Close();
+
+	for (const auto& queue : m_Queues)
+		queue->Join();
+}
+
+void CheckResultListener::ServerThreadProc()
+{
+	Utility::SetThreadName("CR Listener");
+
+	m_Listener->Listen();
+
+	try {
+		for (;;) {
+			timeval tv = { 0, 500000 };
+
+			if (m_Listener->Poll(true, false, &tv)) {
+				Socket::Ptr client = m_Listener->Accept();
+
+				Log(LogNotice, "CheckResultListener", "Client connected");
+
+				{
+					boost::mutex::scoped_lock lock(m_ClientsMutex);
+					m_Clients.insert(client);
+				}
+
+				std::thread thread(std::bind(&CheckResultListener::ClientThreadProc, CheckResultListener::Ptr(this), client));
+				thread.detach();
+			}
+
+			if (!IsActive())
+				break;
+		}
+	} catch (const std::exception&) {
+		Log(LogCritical, "CheckResultListener", "Cannot accept new connection.");
+	}
+
+	m_Listener->Close();
+}
+
+static uint16_t ReadUInt16(const unsigned char *data)
+{
+	return (data[0] << 8) | data[1];
+}
+
+static uint32_t ReadUInt32(const unsigned char *data)
+{
+	return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static uint64_t ReadUInt64(const unsigned char *data)
+{
+	return (static_cast<uint64_t>(ReadUInt32(data)) << 32) | ReadUInt32(data + 4);
+}
+
+static void WriteUInt16(unsigned char *data, uint16_t value)
+{
+	data[0] = value >> 8;
+	data[1] = value;
+}
+
+static void WriteUInt32(unsigned char *data, uint32_t value)
+{
+	data[0] = value >> 24;
+	data[1] = value >> 16;
+	data[2] = value >> 8;
+	data[3] = value;
+}
+
+/**
+ * Decodes a record's payload.
+ *
+ * Layout (integers are big-endian, times are microseconds since the epoch, 0 if unknown):
+ * u32 sequence, u8 exit status, u8 reserved, u64 execution start, u64 execution end,
+ * u16 + host name, u16 + service name (empty for hosts), u32 + output, u32 + performance data
+ */
+static bool DecodeRecord(const unsigned char *data, size_t length, CheckResultRecord& record)
+{
+	const unsigned char *end = data + length;
+
+	if (length < 22)
+		return false;
+
+	record.Sequence = ReadUInt32(data);
+	record.ExitStatus = data[4];
+	record.ExecutionStart = ReadUInt64(data + 6) / 1000000.0;
+	record.ExecutionEnd = ReadUInt64(data + 14) / 1000000.0;
+	data += 22;
+
+	String *fields[] = { &record.HostName, &record.ServiceName, &record.Output, &record.PerformanceData };
+
+	for (int i = 0; i < 4; i++) {
+		size_t prefix = i < 2 ? 2 : 4;
+
+		if (static_cast<size_t>(end - data) < prefix)
+			return false;
+
+		size_t fieldLength = prefix == 2 ? ReadUInt16(data) : ReadUInt32(data);
+		data += prefix;
+
+		if (static_cast<size_t>(end - data) < fieldLength)
+			return false;
+
+		*fields[i] = String(data, data + fieldLength);
+		data += fieldLength;
+	}
+
+	return data == end;
+}
+
+/**
+ * Sends an acknowledgement for a record: u32 length, u32 sequence, u16 code, u16 + message
+ */
+static void SendAck(const std::shared_ptr<CheckResultListenerClient>& client, uint32_t sequence, int code, const String& message)
+{
+	size_t messageLength = std::min<size_t>(message.GetLength(), 0xffff);
+
+	std::vector<unsigned char> ack(12 + messageLength);
+	WriteUInt32(&ack[0], ack.size() - 4);
+	WriteUInt32(&ack[4], sequence);
+	WriteUInt16(&ack[8], code);
+	WriteUInt16(&ack[10], messageLength);
+	std::copy(message.Begin(), message.Begin() + messageLength, ack.begin() + 12);
+
+	boost::mutex::scoped_lock lock(client->WriteMutex);
+
+	if (client->Failed)
+		return;
+
+	try {
+		size_t offset = 0;
+
+		while (offset < ack.size())
+			offset += client->Client->Write(&ack[offset], ack.size() - offset);
+	} catch (const std::exception&) {
+		client->Failed = true;
+		client->Client->Close();
+	}
+}
+
+void CheckResultListener::ClientThreadProc(const Socket::Ptr& socket)
+{
+	Utility::SetThreadName("CR Client");
+
+	auto client = std::make_shared<CheckResultListenerClient>();
+	client->Client = socket;
+
+	std::vector<unsigned char> buffer(64 * 1024);
+	size_t size = 0;
+
+	try {
+		for (;;) {
+			if (size == buffer.size())
+				buffer.resize(buffer.size() * 2);
+
+			size_t rc = socket->Read(&buffer[size], buffer.size() - size);
+
+			if (rc == 0)
+				break;
+
+			size += rc;
+
+			/* Process all complete records in the buffer. */
+			size_t offset = 0;
+
+			while (size - offset >= 4) {
+				size_t length = ReadUInt32(&buffer[offset]);
+
+				if (length > CHECKRESULT_MAX_RECORD_SIZE)
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Check result record exceeds the maximum size."));
+
+				if (size - offset - 4 < length) {
+					if (buffer.size() < length + 4)
+						buffer.resize(length + 4);
+
+					break;
+				}
+
+				CheckResultRecord record;
+
+				if (!DecodeRecord(&buffer[offset + 4], length, record))
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid check result record."));
+
+				offset += 4 + length;
+
+				ProcessRecord(client, record);
+			}
+
+			if (offset > 0) {
+				std::copy(buffer.begin() + offset, buffer.begin() + size, buffer.begin());
+				size -= offset;
+			}
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "CheckResultListener")
+			<< "Closing check result connection: " << DiagnosticInformation(ex, false);
+	}
+
+	{
+		boost::mutex::scoped_lock lock(m_ClientsMutex);
+		m_Clients.erase(socket);
+	}
+
+	Log(LogNotice, "CheckResultListener", "Client disconnected");
+
+	/* Acknowledgements for queued records are dropped once the socket is closed. */
+	{
+		boost::mutex::scoped_lock lock(client->WriteMutex);
+		client->Failed = true;
+	}
+
+	socket->Close();
+}
+
+void CheckResultListener::ProcessRecord(const std::shared_ptr<CheckResultListenerClient>& client, const CheckResultRecord& record)
+{
+	Checkable::Ptr checkable;
+
+	if (record.ServiceName.IsEmpty())
+		checkable = Host::GetByName(record.HostName);
+	else
+		checkable = Service::GetByNamePair(record.HostName, record.ServiceName);
+
+	if (!checkable) {
+		m_Failed++;
+		SendAck(client, record.Sequence, 404, "Object does not exist.");
+		return;
+	}
+
+	size_t queue = std::hash<std::string>()(checkable->GetName().GetData()) % m_Queues.size();
+
+	m_Queues[queue]->Enqueue([this, client, record, checkable]() {
+		if (!checkable->GetEnablePassiveChecks()) {
+			m_Failed++;
+			SendAck(client, record.Sequence, 403, "Passive checks are disabled for object '" + checkable->GetName() + "'.");
+			return;
+		}
+
+		ServiceState state;
+
+		if (record.ServiceName.IsEmpty()) {
+			if (record.ExitStatus == 0)
+				state = ServiceOK;
+			else if (record.ExitStatus == 1)
+				state = ServiceCritical;
+			else {
+				m_Failed++;
+				SendAck(client, record.Sequence, 400, "Invalid exit status for Host " + checkable->GetName() + ".");
+				return;
+			}
+		} else {
+			state = PluginUtility::ExitStatusToState(record.ExitStatus);
+		}
+
+		CheckResult::Ptr cr = new CheckResult();
+		cr->SetOutput(record.Output);
+		cr->SetState(state);
+
+		if (record.ExecutionStart > 0)
+			cr->SetExecutionStart(record.ExecutionStart);
+
+		if (record.ExecutionEnd > 0)
+			cr->SetExecutionEnd(record.ExecutionEnd);
+
+		if (!record.PerformanceData.IsEmpty())
+			cr->SetPerformanceData(PluginUtility::SplitPerfdata(record.PerformanceData));
+
+		/* Mark this check result as passive. */
+		cr->SetActive(false);
+
+		try {
+			checkable->ProcessCheckResult(cr);
+		} catch (const std::exception& ex) {
+			m_Failed++;
+			SendAck(client, record.Sequence, 500, DiagnosticInformation(ex, false));
+			return;
+		}
+
+		m_Processed++;
+		SendAck(client, record.Sequence, 200, String());
+	});
+}
+
+void CheckResultListener::ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<CheckResultListener>::ValidateWorkerThreads(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "worker_threads" }, "Number of worker threads must be at least 1."));
+}
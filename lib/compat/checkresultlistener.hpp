@@ -0,0 +1,78 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CHECKRESULTLISTENER_H
+#define CHECKRESULTLISTENER_H
+
+#include "compat/checkresultlistener-ti.hpp"
+#include "base/socket.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace icinga
+{
+
+struct CheckResultRecord;
+struct CheckResultListenerClient;
+
+/**
+ * Accepts passive check results as a stream of length-prefixed binary
+ * records on a UNIX socket.
+ *
+ * @ingroup compat
+ */
+class CheckResultListener final : public ObjectImpl<CheckResultListener>
+{
+public:
+	DECLARE_OBJECT(CheckResultListener);
+	DECLARE_OBJECTNAME(CheckResultListener);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
+protected:
+	void Start(bool runtimeCreated) override;
+	void Stop(bool runtimeRemoved) override;
+
+private:
+	Socket::Ptr m_Listener;
+	std::thread m_Thread;
+
+	/* Results for the same checkable always end up in the same queue, so they're processed in order. */
+	std::vector<std::unique_ptr<WorkQueue> > m_Queues;
+
+	boost::mutex m_ClientsMutex;
+	std::set<Socket::Ptr> m_Clients;
+
+	std::atomic<uint_fast64_t> m_Processed{0};
+	std::atomic<uint_fast64_t> m_Failed{0};
+
+	void ServerThreadProc();
+	void ClientThreadProc(const Socket::Ptr& client);
+	void ProcessRecord(const std::shared_ptr<CheckResultListenerClient>& client, const CheckResultRecord& record);
+};
+
+}
+
+#endif /* CHECKRESULTLISTENER_H */
@@ -33,6 +33,11 @@
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
 #include <fstream>
+#ifdef HAVE_SYS_INOTIFY_H
+#	include <sys/inotify.h>
+#	include <poll.h>
+#	include <unistd.h>
+#endif /* HAVE_SYS_INOTIFY_H */
 
 using namespace icinga;
 
@@ -44,7 +49,7 @@ void CheckResultReader::StatsFunc(const Dictionary::Ptr& status, const Array::Pt
 {
 	DictionaryData nodes;
 
-	for (const CheckResultReader::Ptr& checkresultreader : ConfigType::GetObjectsByType<CheckResultReader>()) {
+	for (const CheckResultReader::Ptr& checkresultreader : ConfigType::GetObjectViewByType<CheckResultReader>()) {
 		nodes.emplace_back(checkresultreader->GetName(), 1); //add more stats
 	}
 
@@ -65,10 +70,22 @@ void CheckResultReader::Start(bool runtimeCreated)
 		<< "The CheckResultReader feature is DEPRECATED and will be removed in Icinga v2.11.";
 
 #ifndef _WIN32
+	m_Queue.reset(new WorkQueue(25000, Application::GetConcurrency()));
+	m_Queue->SetName("CheckResultReader, " + GetName());
+
+	double interval = 5;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	/* New files are picked up right away, the timer only catches the ones which inotify missed. */
+	if (StartNotifyThread())
+		interval = 60;
+#endif /* HAVE_SYS_INOTIFY_H */
+
 	m_ReadTimer = new Timer();
 	m_ReadTimer->OnTimerExpired.connect(std::bind(&CheckResultReader::ReadTimerHandler, this));
-	m_ReadTimer->SetInterval(5);
+	m_ReadTimer->SetInterval(interval);
 	m_ReadTimer->Start();
+	m_ReadTimer->Reschedule(0);
 #endif /* _WIN32 */
 }
 
@@ -80,17 +97,125 @@ void CheckResultReader::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CheckResultReader")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_ReadTimer)
+		m_ReadTimer->Stop(true);
+
+#ifdef HAVE_SYS_INOTIFY_H
+	m_StopNotify = true;
+
+	if (m_NotifyThread.joinable())
+		m_NotifyThread.join();
+#endif /* HAVE_SYS_INOTIFY_H */
+
+	if (m_Queue)
+		m_Queue->Join();
+
 	ObjectImpl<CheckResultReader>::Stop(runtimeRemoved);
 }
 
 /**
  * @threadsafety Always.
  */
-void CheckResultReader::ReadTimerHandler() const
+void CheckResultReader::ReadTimerHandler()
 {
 	CONTEXT("Processing check result files in '" + GetSpoolDir() + "'");
 
-	Utility::Glob(GetSpoolDir() + "/c??????.ok", std::bind(&CheckResultReader::ProcessCheckResultFile, this, _1), GlobFile);
+	Utility::Glob(GetSpoolDir() + "/c??????.ok", std::bind(&CheckResultReader::EnqueueCheckResultFile, this, _1), GlobFile);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+bool CheckResultReader::StartNotifyThread()
+{
+	int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+
+	if (fd < 0) {
+		Log(LogWarning, "CheckResultReader")
+			<< "inotify_init1() failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		return false;
+	}
+
+	/* Writers create the .ok file after the check result file has been written. */
+	if (inotify_add_watch(fd, GetSpoolDir().CStr(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		Log(LogWarning, "CheckResultReader")
+			<< "inotify_add_watch() for '" << GetSpoolDir() << "' failed with error code " << errno << ", \"" << Utility::FormatErrorNumber(errno) << "\"";
+		close(fd);
+		return false;
+	}
+
+	m_NotifyThread = std::thread(std::bind(&CheckResultReader::NotifyThreadProc, this, fd));
+
+	return true;
+}
+
+void CheckResultReader::NotifyThreadProc(int fd)
+{
+	Utility::SetThreadName("CR Spool");
+
+	String spoolDir = GetSpoolDir();
+
+	while (!m_StopNotify) {
+		pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+
+		if (poll(&pfd, 1, 500) <= 0)
+			continue;
+
+		alignas(inotify_event) char buffer[16 * 1024];
+		ssize_t rc = read(fd, buffer, sizeof(buffer));
+
+		if (rc <= 0)
+			continue;
+
+		for (char *ptr = buffer; ptr < buffer + rc; ) {
+			auto *event = reinterpret_cast<inotify_event *>(ptr);
+			ptr += sizeof(inotify_event) + event->len;
+
+			/* Some events were lost, fall back to scanning the directory. */
+			if (event->mask & IN_Q_OVERFLOW) {
+				Utility::Glob(spoolDir + "/c??????.ok", std::bind(&CheckResultReader::EnqueueCheckResultFile, this, _1), GlobFile);
+				continue;
+			}
+
+			if (event->len == 0)
+				continue;
+
+			String name = event->name;
+
+			if (Utility::Match("c??????.ok", name))
+				EnqueueCheckResultFile(spoolDir + "/" + name);
+		}
+	}
+
+	close(fd);
+}
+#endif /* HAVE_SYS_INOTIFY_H */
+
+/**
+ * Processes a check result file on the work queue unless it's already being processed.
+ */
+void CheckResultReader::EnqueueCheckResultFile(const String& path)
+{
+	{
+		boost::mutex::scoped_lock lock(m_PendingMutex);
+
+		if (!m_PendingFiles.insert(path).second)
+			return;
+	}
+
+	m_Queue->Enqueue([this, path]() {
+		try {
+			/* The file may have been processed already after an earlier event. */
+			if (Utility::PathExists(path))
+				ProcessCheckResultFile(path);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "CheckResultReader")
+				<< "Failed to process check result file '" << path << "': " << DiagnosticInformation(ex, false);
+		}
+
+		boost::mutex::scoped_lock lock(m_PendingMutex);
+		m_PendingFiles.erase(path);
+	});
 }
 
 void CheckResultReader::ProcessCheckResultFile(const String& path) const
@@ -22,7 +22,12 @@
 
 #include "compat/checkresultreader-ti.hpp"
 #include "base/timer.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
 #include <fstream>
+#include <memory>
+#include <set>
+#include <thread>
 
 namespace icinga
 {
@@ -46,7 +51,21 @@ protected:
 
 private:
 	Timer::Ptr m_ReadTimer;
-	void ReadTimerHandler() const;
+	std::unique_ptr<WorkQueue> m_Queue;
+
+	boost::mutex m_PendingMutex;
+	std::set<String> m_PendingFiles;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	std::thread m_NotifyThread;
+	std::atomic<bool> m_StopNotify{false};
+
+	bool StartNotifyThread();
+	void NotifyThreadProc(int fd);
+#endif /* HAVE_SYS_INOTIFY_H */
+
+	void ReadTimerHandler();
+	void EnqueueCheckResultFile(const String& path);
 	void ProcessCheckResultFile(const String& path) const;
 };
 
@@ -35,6 +35,7 @@
 #include "base/utility.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
+#include <sstream>
 
 using namespace icinga;
 
@@ -42,11 +43,14 @@ REGISTER_TYPE(CompatLogger);
 
 REGISTER_STATSFUNCTION(CompatLogger, &CompatLogger::StatsFunc);
 
+/* Buffered lines are written by the flush timer unless the buffer grows beyond this size. */
+static const size_t l_CompatLogBufferSize = 1024 * 1024;
+
 void CompatLogger::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
 {
 	DictionaryData nodes;
 
-	for (const CompatLogger::Ptr& compat_logger : ConfigType::GetObjectsByType<CompatLogger>()) {
+	for (const CompatLogger::Ptr& compat_logger : ConfigType::GetObjectViewByType<CompatLogger>()) {
 		nodes.emplace_back(compat_logger->GetName(), 1); // add more stats
 	}
 
@@ -81,6 +85,11 @@ void CompatLogger::Start(bool runtimeCreated)
 	m_RotationTimer->OnTimerExpired.connect(std::bind(&CompatLogger::RotationTimerHandler, this));
 	m_RotationTimer->Start();
 
+	m_FlushTimer = new Timer();
+	m_FlushTimer->SetInterval(1);
+	m_FlushTimer->OnTimerExpired.connect(std::bind(&CompatLogger::FlushTimerHandler, this));
+	m_FlushTimer->Start();
+
 	ReopenFile(false);
 	ScheduleNextRotation();
 }
@@ -93,6 +102,13 @@ void CompatLogger::Stop(bool runtimeRemoved)
 	Log(LogInformation, "CompatLogger")
 		<< "'" << GetName() << "' stopped.";
 
+	m_FlushTimer->Stop(true);
+
+	{
+		ObjectLock olock(this);
+		FlushBuffer();
+	}
+
 	ObjectImpl<CompatLogger>::Stop(runtimeRemoved);
 }
 
@@ -153,11 +169,7 @@ void CompatLogger::CheckResultHandler(const Checkable::Ptr& checkable, const Che
 
 	}
 
-	{
-		ObjectLock olock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -189,11 +201,7 @@ void CompatLogger::TriggerDowntimeHandler(const Downtime::Ptr& downtime)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -236,11 +244,7 @@ void CompatLogger::RemoveDowntimeHandler(const Downtime::Ptr& downtime)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -300,11 +304,7 @@ void CompatLogger::NotificationSentHandler(const Notification::Ptr& notification
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 /**
@@ -344,11 +344,7 @@ void CompatLogger::FlappingChangedHandler(const Checkable::Ptr& checkable)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 void CompatLogger::EnableFlappingChangedHandler(const Checkable::Ptr& checkable)
@@ -380,11 +376,7 @@ void CompatLogger::EnableFlappingChangedHandler(const Checkable::Ptr& checkable)
 			<< "";
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 void CompatLogger::ExternalCommandHandler(const String& command, const std::vector<String>& arguments)
@@ -395,11 +387,7 @@ void CompatLogger::ExternalCommandHandler(const String& command, const std::vect
 		<< boost::algorithm::join(arguments, ";")
 		<< "";
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 void CompatLogger::EventCommandHandler(const Checkable::Ptr& checkable)
@@ -431,11 +419,7 @@ void CompatLogger::EventCommandHandler(const Checkable::Ptr& checkable)
 			<< event_command_name;
 	}
 
-	{
-		ObjectLock oLock(this);
-		WriteLine(msgbuf.str());
-		Flush();
-	}
+	WriteLine(msgbuf.str());
 }
 
 String CompatLogger::GetHostStateString(const Host::Ptr& host)
@@ -446,24 +430,98 @@ String CompatLogger::GetHostStateString(const Host::Ptr& host)
 	return Host::StateToString(host->GetState());
 }
 
+/**
+ * Writes an index entry "<timestamp> <offset> <end>" for each line which is
+ * read from the stream, starting at the specified file offset. Livestatus
+ * uses the index instead of reading the whole log file. Empty lines are
+ * counted towards the preceding line.
+ */
+static void WriteLogIndex(std::istream& in, std::streamoff offset, std::ostream& index)
+{
+	std::string line;
+	long ts = 0, entryTs = 0;
+	std::streamoff entryOffset = -1;
+
+	while (std::getline(in, line)) {
+		/* Incomplete lines are indexed once they've been written completely. */
+		if (in.eof())
+			break;
+
+		if (!line.empty()) {
+			if (entryOffset != -1)
+				index << entryTs << " " << entryOffset << " " << offset << "\n";
+
+			if (line[0] == '[')
+				ts = atol(line.c_str() + 1);
+
+			entryTs = ts;
+			entryOffset = offset;
+		}
+
+		offset += line.size() + 1;
+	}
+
+	if (entryOffset != -1)
+		index << entryTs << " " << entryOffset << " " << offset << "\n";
+}
+
+/**
+ * Adds a line to the buffer. The buffer is written to the log file by the
+ * flush timer, i.e. the threads which report events don't wait for I/O.
+ *
+ * @threadsafety Always.
+ */
 void CompatLogger::WriteLine(const String& line)
 {
-	ASSERT(OwnsLock());
+	String entry = "[" + Convert::ToString((long)Utility::GetTime()) + "] " + line + "\n";
+	bool full;
 
-	if (!m_OutputFile.good())
-		return;
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
+		m_Buffer.append(entry.CStr(), entry.GetLength());
+		full = m_Buffer.size() >= l_CompatLogBufferSize;
+	}
 
-	m_OutputFile << "[" << (long)Utility::GetTime() << "] " << line << "\n";
+	if (full) {
+		ObjectLock olock(this);
+		FlushBuffer();
+	}
 }
 
-void CompatLogger::Flush()
+/**
+ * Writes the buffered lines to the log file and updates its index.
+ */
+void CompatLogger::FlushBuffer()
 {
 	ASSERT(OwnsLock());
 
-	if (!m_OutputFile.good())
+	std::string buffer;
+
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
+		buffer.swap(m_Buffer);
+	}
+
+	if (buffer.empty() || !m_OutputFile.good())
 		return;
 
-	m_OutputFile << std::flush;
+	m_OutputFile.write(buffer.c_str(), buffer.size());
+	m_OutputFile.flush();
+
+	/* The index is written after the log file so that it never refers to lines which don't exist yet. */
+	if (m_IndexFile.good()) {
+		std::istringstream in(buffer);
+		WriteLogIndex(in, m_FileOffset, m_IndexFile);
+		m_IndexFile.flush();
+	}
+
+	m_FileOffset += buffer.size();
+}
+
+void CompatLogger::FlushTimerHandler()
+{
+	ObjectLock olock(this);
+	FlushBuffer();
 }
 
 /**
@@ -474,9 +532,14 @@ void CompatLogger::ReopenFile(bool rotate)
 	ObjectLock olock(this);
 
 	String tempFile = GetLogDir() + "/icinga.log";
+	String indexFile = tempFile + ".idx";
 
 	if (m_OutputFile) {
+		/* Lines which were logged before the rotation belong into the old file. */
+		FlushBuffer();
+
 		m_OutputFile.close();
+		m_IndexFile.close();
 
 		if (rotate) {
 			String archiveFile = GetLogDir() + "/archives/icinga-" + Utility::FormatDateTime("%m-%d-%Y-%H", Utility::GetTime()) + ".log";
@@ -485,10 +548,11 @@ void CompatLogger::ReopenFile(bool rotate)
 				<< "Rotating compat log file '" << tempFile << "' -> '" << archiveFile << "'";
 
 			(void) rename(tempFile.CStr(), archiveFile.CStr());
+			(void) rename(indexFile.CStr(), (archiveFile + ".idx").CStr());
 		}
 	}
 
-	m_OutputFile.open(tempFile.CStr(), std::ofstream::app);
+	m_OutputFile.open(tempFile.CStr(), std::ofstream::app | std::ofstream::binary);
 
 	if (!m_OutputFile) {
 		Log(LogWarning, "CompatLogger")
@@ -497,28 +561,42 @@ void CompatLogger::ReopenFile(bool rotate)
 		return;
 	}
 
-	WriteLine("LOG ROTATION: " + GetRotationMethod());
-	WriteLine("LOG VERSION: 2.0");
+	m_OutputFile.seekp(0, std::ios::end);
+	m_FileOffset = m_OutputFile.tellp();
+
+	/* We don't know whether an existing index is complete, so it's rebuilt from the log file. */
+	m_IndexFile.open(indexFile.CStr(), std::ofstream::trunc | std::ofstream::binary);
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
+	if (!m_IndexFile) {
+		Log(LogWarning, "CompatLogger")
+			<< "Could not open compat log index file '" << indexFile << "' for writing.";
+	} else if (m_FileOffset > 0) {
+		std::ifstream in(tempFile.CStr(), std::ifstream::in | std::ifstream::binary);
+		WriteLogIndex(in, 0, m_IndexFile);
+	}
+
+	std::ostringstream header;
+	long now = Utility::GetTime();
+
+	header << "[" << now << "] LOG ROTATION: " << GetRotationMethod() << "\n"
+		<< "[" << now << "] LOG VERSION: 2.0" << "\n";
+
+	for (const Host::Ptr& host : ConfigType::GetObjectViewByType<Host>()) {
 		String output;
 		CheckResult::Ptr cr = host->GetLastCheckResult();
 
 		if (cr)
 			output = CompatUtility::GetCheckResultOutput(cr);
 
-		std::ostringstream msgbuf;
-		msgbuf << "CURRENT HOST STATE: "
+		header << "[" << now << "] CURRENT HOST STATE: "
 			<< host->GetName() << ";"
 			<< GetHostStateString(host) << ";"
 			<< Host::StateTypeToString(host->GetStateType()) << ";"
 			<< host->GetCheckAttempt() << ";"
-			<< output << "";
-
-		WriteLine(msgbuf.str());
+			<< output << "" << "\n";
 	}
 
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
+	for (const Service::Ptr& service : ConfigType::GetObjectViewByType<Service>()) {
 		Host::Ptr host = service->GetHost();
 
 		String output;
@@ -527,19 +605,22 @@ void CompatLogger::ReopenFile(bool rotate)
 		if (cr)
 			output = CompatUtility::GetCheckResultOutput(cr);
 
-		std::ostringstream msgbuf;
-		msgbuf << "CURRENT SERVICE STATE: "
+		header << "[" << now << "] CURRENT SERVICE STATE: "
 			<< host->GetName() << ";"
 			<< service->GetShortName() << ";"
 			<< Service::StateToString(service->GetState()) << ";"
 			<< Service::StateTypeToString(service->GetStateType()) << ";"
 			<< service->GetCheckAttempt() << ";"
-			<< output << "";
+			<< output << "" << "\n";
+	}
 
-		WriteLine(msgbuf.str());
+	/* Events which were logged in the meantime go after the header. */
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
+		m_Buffer.insert(0, header.str());
 	}
 
-	Flush();
+	FlushBuffer();
 }
 
 void CompatLogger::ScheduleNextRotation()
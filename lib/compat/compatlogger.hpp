@@ -23,6 +23,7 @@
 #include "compat/compatlogger-ti.hpp"
 #include "icinga/service.hpp"
 #include "base/timer.hpp"
+#include <boost/thread/mutex.hpp>
 #include <fstream>
 
 namespace icinga
@@ -49,7 +50,7 @@ protected:
 
 private:
 	void WriteLine(const String& line);
-	void Flush();
+	void FlushBuffer();
 
 	void CheckResultHandler(const Checkable::Ptr& service, const CheckResult::Ptr& cr);
 	void NotificationSentHandler(const Notification::Ptr& notification, const Checkable::Ptr& service,
@@ -68,7 +69,14 @@ private:
 	void RotationTimerHandler();
 	void ScheduleNextRotation();
 
+	boost::mutex m_BufferMutex;
+	std::string m_Buffer;
+	Timer::Ptr m_FlushTimer;
+	void FlushTimerHandler();
+
 	std::ofstream m_OutputFile;
+	std::ofstream m_IndexFile;
+	std::streamoff m_FileOffset{0};
 	void ReopenFile(bool rotate);
 };
 
@@ -25,6 +25,7 @@
 #include "base/exception.hpp"
 #include "base/application.hpp"
 #include "base/statsfunction.hpp"
+#include <functional>
 
 using namespace icinga;
 
@@ -36,7 +37,7 @@ void ExternalCommandListener::StatsFunc(const Dictionary::Ptr& status, const Arr
 {
 	DictionaryData nodes;
 
-	for (const ExternalCommandListener::Ptr& externalcommandlistener : ConfigType::GetObjectsByType<ExternalCommandListener>()) {
+	for (const ExternalCommandListener::Ptr& externalcommandlistener : ConfigType::GetObjectViewByType<ExternalCommandListener>()) {
 		nodes.emplace_back(externalcommandlistener->GetName(), 1); //add more stats
 	}
 
@@ -54,6 +55,11 @@ void ExternalCommandListener::Start(bool runtimeCreated)
 		<< "'" << GetName() << "' started.";
 
 #ifndef _WIN32
+	for (int i = 0; i < GetWorkerThreads(); i++) {
+		m_Queues.emplace_back(new WorkQueue(25000));
+		m_Queues.back()->SetName("ExternalCommandListener, " + GetName());
+	}
+
 	m_CommandThread = std::thread(std::bind(&ExternalCommandListener::CommandPipeThread, this, GetCommandPath()));
 	m_CommandThread.detach();
 #endif /* _WIN32 */
@@ -151,19 +157,73 @@ void ExternalCommandListener::CommandPipeThread(const String& commandPath)
 				if (srs != StatusNewItem)
 					break;
 
-				try {
-					Log(LogInformation, "ExternalCommandListener")
-						<< "Executing external command: " << command;
-
-					ExternalCommandProcessor::Execute(command);
-				} catch (const std::exception& ex) {
-					Log(LogWarning, "ExternalCommandListener")
-						<< "External command failed: " << DiagnosticInformation(ex, false);
-					Log(LogNotice, "ExternalCommandListener")
-						<< "External command failed: " << DiagnosticInformation(ex, true);
-				}
+				DispatchCommand(command);
 			}
 		}
 	}
 }
+
+static void ExecuteCommand(double time, const String& command, const std::vector<String>& arguments)
+{
+	try {
+		ExternalCommandProcessor::Execute(time, command, arguments);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, false);
+		Log(LogNotice, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, true);
+	}
+}
+
+/**
+ * Parses a command on the reader thread and hands it over to a worker.
+ *
+ * Passive check results are spread across the work queues by their host name,
+ * so results for the same host and its services keep their order. All other
+ * commands may affect several objects; they wait until the queues are empty
+ * and run on the reader thread.
+ */
+void ExternalCommandListener::DispatchCommand(const String& line)
+{
+	if (line.IsEmpty())
+		return;
+
+	Log(LogInformation, "ExternalCommandListener")
+		<< "Executing external command: " << line;
+
+	double time;
+	String command;
+	std::vector<String> arguments;
+
+	try {
+		ExternalCommandProcessor::Parse(line, &time, &command, &arguments);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ExternalCommandListener")
+			<< "External command failed: " << DiagnosticInformation(ex, false);
+		return;
+	}
+
+	if ((command == "PROCESS_HOST_CHECK_RESULT" || command == "PROCESS_SERVICE_CHECK_RESULT") && !arguments.empty()) {
+		size_t queue = std::hash<std::string>()(arguments[0].GetData()) % m_Queues.size();
+
+		m_Queues[queue]->Enqueue([time, command, arguments]() {
+			ExecuteCommand(time, command, arguments);
+		});
+
+		return;
+	}
+
+	for (const auto& queue : m_Queues)
+		queue->Join();
+
+	ExecuteCommand(time, command, arguments);
+}
 #endif /* _WIN32 */
+
+void ExternalCommandListener::ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ExternalCommandListener>::ValidateWorkerThreads(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "worker_threads" }, "Number of worker threads must be at least 1."));
+}
@@ -24,6 +24,8 @@
 #include "base/objectlock.hpp"
 #include "base/timer.hpp"
 #include "base/utility.hpp"
+#include "base/workqueue.hpp"
+#include <memory>
 #include <thread>
 #include <iostream>
 
@@ -41,6 +43,8 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void ValidateWorkerThreads(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
@@ -49,7 +53,11 @@ private:
 #ifndef _WIN32
 	std::thread m_CommandThread;
 
+	/* Check results are spread across the queues by their host name. */
+	std::vector<std::unique_ptr<WorkQueue> > m_Queues;
+
 	void CommandPipeThread(const String& commandPath);
+	void DispatchCommand(const String& line);
 #endif /* _WIN32 */
 };
 
@@ -39,6 +39,7 @@
 #include "base/application.hpp"
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
+#include "base/workqueue.hpp"
 #include <boost/tuple/tuple.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -50,11 +51,17 @@ REGISTER_TYPE(StatusDataWriter);
 
 REGISTER_STATSFUNCTION(StatusDataWriter, &StatusDataWriter::StatsFunc);
 
+/* Cached status blocks are rendered again after this many seconds even if the object didn't change. */
+static const double l_MaxStatusBlockAge = 60;
+
+/* The status blocks are written in chunks of about this size. */
+static const std::string::size_type l_StatusWriteSize = 1024 * 1024;
+
 void StatusDataWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
 {
 	DictionaryData nodes;
 
-	for (const StatusDataWriter::Ptr& statusdatawriter : ConfigType::GetObjectsByType<StatusDataWriter>()) {
+	for (const StatusDataWriter::Ptr& statusdatawriter : ConfigType::GetObjectViewByType<StatusDataWriter>()) {
 		nodes.emplace_back(statusdatawriter->GetName(), 1); //add more stats
 	}
 
@@ -209,10 +216,7 @@ void StatusDataWriter::DumpHostStatus(std::ostream& fp, const Host::Ptr& host)
 {
 	fp << "hoststatus {" "\n" "\t" "host_name=" << host->GetName() << "\n";
 
-	{
-		ObjectLock olock(host);
-		DumpCheckableStatusAttrs(fp, host);
-	}
+	DumpCheckableStatusAttrs(fp, host);
 
 	/* ugly but cgis parse only that */
 	fp << "\t" "last_time_up=" << host->GetLastStateUp() << "\n"
@@ -334,7 +338,9 @@ void StatusDataWriter::DumpHostObject(std::ostream& fp, const Host::Ptr& host)
 
 void StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkable::Ptr& checkable)
 {
-	CheckResult::Ptr cr = checkable->GetLastCheckResult();
+	/* Use a consistent view of the state without blocking the check result processing. */
+	CheckableStateSnapshot::Ptr state = checkable->GetStateSnapshot();
+	CheckResult::Ptr cr = state->LastCheckResult;
 
 	EventCommand::Ptr eventcommand = checkable->GetEventCommand();
 	CheckCommand::Ptr checkcommand = checkable->GetCheckCommand();
@@ -361,25 +367,25 @@ void StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkabl
 	tie(host, service) = GetHostService(checkable);
 
 	if (service) {
-		fp << "\t" "current_state=" << service->GetState() << "\n"
-			"\t" "last_hard_state=" << service->GetLastHardState() << "\n"
+		fp << "\t" "current_state=" << state->StateRaw << "\n"
+			"\t" "last_hard_state=" << state->LastHardStateRaw << "\n"
 			"\t" "last_time_ok=" << static_cast<int>(service->GetLastStateOK()) << "\n"
 			"\t" "last_time_warn=" << static_cast<int>(service->GetLastStateWarning()) << "\n"
 			"\t" "last_time_critical=" << static_cast<int>(service->GetLastStateCritical()) << "\n"
 			"\t" "last_time_unknown=" << static_cast<int>(service->GetLastStateUnknown()) << "\n";
 	} else {
-		int currentState = host->GetState();
+		int currentState = Host::CalculateState(state->StateRaw);
 
 		if (currentState != HostUp && !host->IsReachable())
 			currentState = 2; /* hardcoded compat state */
 
 		fp << "\t" "current_state=" << currentState << "\n"
-			"\t" "last_hard_state=" << host->GetLastHardState() << "\n"
+			"\t" "last_hard_state=" << Host::CalculateState(state->LastHardStateRaw) << "\n"
 			"\t" "last_time_up=" << static_cast<int>(host->GetLastStateUp()) << "\n"
 			"\t" "last_time_down=" << static_cast<int>(host->GetLastStateDown()) << "\n";
 	}
 
-	fp << "\t" "state_type=" << checkable->GetStateType() << "\n"
+	fp << "\t" "state_type=" << state->CurrentStateType << "\n"
 		"\t" "last_check=" << static_cast<long>(host->GetLastCheck()) << "\n";
 
 	if (cr) {
@@ -389,20 +395,20 @@ void StatusDataWriter::DumpCheckableStatusAttrs(std::ostream& fp, const Checkabl
 	}
 
 	fp << "\t" << "next_check=" << static_cast<long>(checkable->GetNextCheck()) << "\n"
-		"\t" "current_attempt=" << checkable->GetCheckAttempt() << "\n"
+		"\t" "current_attempt=" << state->CheckAttempt << "\n"
 		"\t" "max_attempts=" << checkable->GetMaxCheckAttempts() << "\n"
-		"\t" "last_state_change=" << static_cast<long>(checkable->GetLastStateChange()) << "\n"
-		"\t" "last_hard_state_change=" << static_cast<long>(checkable->GetLastHardStateChange()) << "\n"
+		"\t" "last_state_change=" << static_cast<long>(state->LastStateChange) << "\n"
+		"\t" "last_hard_state_change=" << static_cast<long>(state->LastHardStateChange) << "\n"
 		"\t" "last_update=" << static_cast<long>(Utility::GetTime()) << "\n"
 		"\t" "notifications_enabled=" << Convert::ToLong(checkable->GetEnableNotifications()) << "\n"
 		"\t" "active_checks_enabled=" << Convert::ToLong(checkable->GetEnableActiveChecks()) << "\n"
 		"\t" "passive_checks_enabled=" << Convert::ToLong(checkable->GetEnablePassiveChecks()) << "\n"
 		"\t" "flap_detection_enabled=" << Convert::ToLong(checkable->GetEnableFlapping()) << "\n"
-		"\t" "is_flapping=" << Convert::ToLong(checkable->IsFlapping()) << "\n"
+		"\t" "is_flapping=" << Convert::ToLong(state->Flapping) << "\n"
 		"\t" "percent_state_change=" << checkable->GetFlappingCurrent() << "\n"
-		"\t" "problem_has_been_acknowledged=" << (checkable->GetAcknowledgement() != AcknowledgementNone ? 1 : 0) << "\n"
-		"\t" "acknowledgement_type=" << checkable->GetAcknowledgement() << "\n"
-		"\t" "acknowledgement_end_time=" << checkable->GetAcknowledgementExpiry() << "\n"
+		"\t" "problem_has_been_acknowledged=" << (state->IsAcknowledged() ? 1 : 0) << "\n"
+		"\t" "acknowledgement_type=" << state->GetAcknowledgement() << "\n"
+		"\t" "acknowledgement_end_time=" << state->AcknowledgementExpiry << "\n"
 		"\t" "scheduled_downtime_depth=" << checkable->GetDowntimeDepth() << "\n"
 		"\t" "last_notification=" << CompatUtility::GetCheckableNotificationLastNotification(checkable) << "\n"
 		"\t" "next_notification=" << CompatUtility::GetCheckableNotificationNextNotification(checkable) << "\n"
@@ -418,10 +424,7 @@ void StatusDataWriter::DumpServiceStatus(std::ostream& fp, const Service::Ptr& s
 		"\t" "host_name=" << host->GetName() << "\n"
 		"\t" "service_description=" << service->GetShortName() << "\n";
 
-	{
-		ObjectLock olock(service);
-		DumpCheckableStatusAttrs(fp, service);
-	}
+	DumpCheckableStatusAttrs(fp, service);
 
 	fp << "\t" "}" "\n" "\n";
 
@@ -570,13 +573,13 @@ void StatusDataWriter::UpdateObjectsCache()
 			"# This file is auto-generated. Do not modify this file." "\n"
 			"\n";
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
+	for (const Host::Ptr& host : ConfigType::GetObjectViewByType<Host>()) {
 		std::ostringstream tempobjectfp;
 		tempobjectfp << std::fixed;
 		DumpHostObject(tempobjectfp, host);
 		objectfp << tempobjectfp.str();
 
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			std::ostringstream tempobjectfp;
 			tempobjectfp << std::fixed;
 			DumpServiceObject(tempobjectfp, service);
@@ -584,7 +587,7 @@ void StatusDataWriter::UpdateObjectsCache()
 		}
 	}
 
-	for (const HostGroup::Ptr& hg : ConfigType::GetObjectsByType<HostGroup>()) {
+	for (const HostGroup::Ptr& hg : ConfigType::GetObjectViewByType<HostGroup>()) {
 		std::ostringstream tempobjectfp;
 		tempobjectfp << std::fixed;
 
@@ -614,7 +617,7 @@ void StatusDataWriter::UpdateObjectsCache()
 		objectfp << tempobjectfp.str();
 	}
 
-	for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectsByType<ServiceGroup>()) {
+	for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectViewByType<ServiceGroup>()) {
 		std::ostringstream tempobjectfp;
 		tempobjectfp << std::fixed;
 
@@ -654,7 +657,7 @@ void StatusDataWriter::UpdateObjectsCache()
 		objectfp << tempobjectfp.str();
 	}
 
-	for (const User::Ptr& user : ConfigType::GetObjectsByType<User>()) {
+	for (const User::Ptr& user : ConfigType::GetObjectViewByType<User>()) {
 		std::ostringstream tempobjectfp;
 		tempobjectfp << std::fixed;
 
@@ -682,7 +685,7 @@ void StatusDataWriter::UpdateObjectsCache()
 		objectfp << tempobjectfp.str();
 	}
 
-	for (const UserGroup::Ptr& ug : ConfigType::GetObjectsByType<UserGroup>()) {
+	for (const UserGroup::Ptr& ug : ConfigType::GetObjectViewByType<UserGroup>()) {
 		std::ostringstream tempobjectfp;
 		tempobjectfp << std::fixed;
 
@@ -698,23 +701,23 @@ void StatusDataWriter::UpdateObjectsCache()
 		objectfp << tempobjectfp.str();
 	}
 
-	for (const Command::Ptr& command : ConfigType::GetObjectsByType<CheckCommand>()) {
+	for (const Command::Ptr& command : ConfigType::GetObjectViewByType<CheckCommand>()) {
 		DumpCommand(objectfp, command);
 	}
 
-	for (const Command::Ptr& command : ConfigType::GetObjectsByType<NotificationCommand>()) {
+	for (const Command::Ptr& command : ConfigType::GetObjectViewByType<NotificationCommand>()) {
 		DumpCommand(objectfp, command);
 	}
 
-	for (const Command::Ptr& command : ConfigType::GetObjectsByType<EventCommand>()) {
+	for (const Command::Ptr& command : ConfigType::GetObjectViewByType<EventCommand>()) {
 		DumpCommand(objectfp, command);
 	}
 
-	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectsByType<TimePeriod>()) {
+	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectViewByType<TimePeriod>()) {
 		DumpTimePeriod(objectfp, tp);
 	}
 
-	for (const Dependency::Ptr& dep : ConfigType::GetObjectsByType<Dependency>()) {
+	for (const Dependency::Ptr& dep : ConfigType::GetObjectViewByType<Dependency>()) {
 		Checkable::Ptr parent = dep->GetParent();
 
 		if (!parent) {
@@ -845,17 +848,21 @@ void StatusDataWriter::StatusTimerHandler()
 	statusfp << "\t" "}" "\n"
 			"\n";
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		std::ostringstream tempstatusfp;
-		tempstatusfp << std::fixed;
-		DumpHostStatus(tempstatusfp, host);
-		statusfp << tempstatusfp.str();
-
-		for (const Service::Ptr& service : host->GetServices()) {
+	if (GetIncrementalUpdate()) {
+		DumpStatusBlocks(statusfp);
+	} else {
+		for (const Host::Ptr& host : ConfigType::GetObjectViewByType<Host>()) {
 			std::ostringstream tempstatusfp;
 			tempstatusfp << std::fixed;
-			DumpServiceStatus(tempstatusfp, service);
+			DumpHostStatus(tempstatusfp, host);
 			statusfp << tempstatusfp.str();
+
+			for (const Service::Ptr& service : host->GetServiceView()) {
+				std::ostringstream tempstatusfp;
+				tempstatusfp << std::fixed;
+				DumpServiceStatus(tempstatusfp, service);
+				statusfp << tempstatusfp.str();
+			}
 		}
 	}
 
@@ -876,6 +883,108 @@ void StatusDataWriter::StatusTimerHandler()
 		<< "Writing status.dat file took " << Utility::FormatDuration(Utility::GetTime() - start);
 }
 
+/**
+ * Writes the status of all hosts and services. The blocks are rendered on
+ * the thread pool and cached; a block is only rendered again when the state
+ * of the object, its downtimes, comments or notifications changed or when
+ * it is older than l_MaxStatusBlockAge.
+ */
+void StatusDataWriter::DumpStatusBlocks(std::ostream& fp)
+{
+	std::vector<StatusBlock *> blocks;
+
+	for (const Host::Ptr& host : ConfigType::GetObjectViewByType<Host>()) {
+		StatusBlock *block = &m_StatusBlocks[host.get()];
+		block->Object = host;
+		blocks.push_back(block);
+
+		for (const Service::Ptr& service : host->GetServiceView()) {
+			block = &m_StatusBlocks[service.get()];
+			block->Object = service;
+			blocks.push_back(block);
+		}
+	}
+
+	double now = Utility::GetTime();
+
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("StatusDataWriter");
+
+	upq.ParallelFor(blocks, [this, now](StatusBlock *block) {
+		uint64_t fingerprint = GetStatusFingerprint(block->Object);
+
+		if (!block->Data.empty() && block->Fingerprint == fingerprint && now - block->RenderTime < l_MaxStatusBlockAge)
+			return;
+
+		std::ostringstream tempstatusfp;
+		tempstatusfp << std::fixed;
+
+		Host::Ptr host;
+		Service::Ptr service;
+		tie(host, service) = GetHostService(block->Object);
+
+		if (service)
+			DumpServiceStatus(tempstatusfp, service);
+		else
+			DumpHostStatus(tempstatusfp, host);
+
+		block->Data = tempstatusfp.str();
+		block->Fingerprint = fingerprint;
+		block->RenderTime = now;
+	});
+
+	upq.Join();
+
+	if (upq.HasExceptions())
+		upq.ReportExceptions("StatusDataWriter");
+
+	std::string buffer;
+	buffer.reserve(l_StatusWriteSize);
+
+	for (StatusBlock *block : blocks) {
+		block->Seen = true;
+
+		if (!buffer.empty() && buffer.size() + block->Data.size() > l_StatusWriteSize) {
+			fp.write(buffer.data(), buffer.size());
+			buffer.clear();
+		}
+
+		buffer += block->Data;
+	}
+
+	fp.write(buffer.data(), buffer.size());
+
+	/* Forget the blocks of deleted objects. */
+	for (auto it = m_StatusBlocks.begin(); it != m_StatusBlocks.end(); ) {
+		if (!it->second.Seen) {
+			it = m_StatusBlocks.erase(it);
+		} else {
+			it->second.Seen = false;
+			++it;
+		}
+	}
+}
+
+/**
+ * Combines the state versions of the objects whose state is part of a
+ * checkable's status block.
+ */
+uint64_t StatusDataWriter::GetStatusFingerprint(const Checkable::Ptr& checkable)
+{
+	uint64_t fingerprint = checkable->GetStateVersion();
+
+	for (const Downtime::Ptr& downtime : checkable->GetDowntimes())
+		fingerprint = fingerprint * 31 + downtime->GetStateVersion() + 1;
+
+	for (const Comment::Ptr& comment : checkable->GetComments())
+		fingerprint = fingerprint * 31 + comment->GetStateVersion() + 1;
+
+	for (const Notification::Ptr& notification : checkable->GetNotifications())
+		fingerprint = fingerprint * 31 + notification->GetStateVersion() + 1;
+
+	return fingerprint;
+}
+
 void StatusDataWriter::ObjectHandler()
 {
 	m_ObjectsCacheOutdated = true;
@@ -29,6 +29,7 @@
 #include "base/timer.hpp"
 #include "base/utility.hpp"
 #include <iostream>
+#include <unordered_map>
 
 namespace icinga
 {
@@ -49,8 +50,21 @@ protected:
 	void Stop(bool runtimeRemoved) override;
 
 private:
+	/**
+	 * The rendered status of a host or service, including its downtimes and comments.
+	 */
+	struct StatusBlock
+	{
+		Checkable::Ptr Object;
+		uint64_t Fingerprint{0};
+		double RenderTime{0};
+		bool Seen{false};
+		std::string Data;
+	};
+
 	Timer::Ptr m_StatusTimer;
 	bool m_ObjectsCacheOutdated;
+	std::unordered_map<Checkable *, StatusBlock> m_StatusBlocks;
 
 	void DumpCommand(std::ostream& fp, const Command::Ptr& command);
 	void DumpTimePeriod(std::ostream& fp, const TimePeriod::Ptr& tp);
@@ -94,6 +108,9 @@ private:
 
 	void DumpCustomAttributes(std::ostream& fp, const CustomVarObject::Ptr& object);
 
+	void DumpStatusBlocks(std::ostream& fp);
+	static uint64_t GetStatusFingerprint(const Checkable::Ptr& checkable);
+
 	void UpdateObjectsCache();
 	void StatusTimerHandler();
 	void ObjectHandler();
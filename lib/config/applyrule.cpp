@@ -18,20 +18,147 @@
  ******************************************************************************/
 
 #include "config/applyrule.hpp"
+#include "config/vmops.hpp"
 #include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
 #include <set>
 
 using namespace icinga;
 
+namespace icinga
+{
+
+struct ApplyRuleStats
+{
+	std::atomic<uint64_t> Evaluations{0};
+	std::atomic<uint64_t> Matches{0};
+	std::atomic<uint64_t> Time{0}; /* microseconds */
+};
+
+}
+
 ApplyRule::RuleMap ApplyRule::m_Rules;
 ApplyRule::TypeMap ApplyRule::m_Types;
+bool ApplyRule::m_Profiling = false;
+boost::mutex ApplyRule::m_IndexMutex;
+std::map<String, std::shared_ptr<ApplyRuleIndex> > ApplyRule::m_Indexes;
+
+namespace icinga
+{
+
+/**
+ * Rules whose filter starts with the same attribute path, by the value
+ * they compare the attribute with.
+ */
+struct ApplyRuleIndexPath
+{
+	std::vector<String> Path;
+	bool Contains;
+	std::map<String, std::vector<size_t> > Rules;
+};
+
+/**
+ * Inverted index for the apply rules of a type. Rules without an indexable
+ * condition are evaluated for every object.
+ */
+struct ApplyRuleIndex
+{
+	size_t RuleCount;
+	std::vector<size_t> Unindexed;
+	std::vector<ApplyRuleIndexPath> Paths;
+};
+
+}
+
+/**
+ * Converts an expression like host.vars.os into its attribute path.
+ */
+static bool GetAttributePath(const Expression *expr, std::vector<String>& path)
+{
+	path.clear();
+
+	while (auto *iexpr = dynamic_cast<const IndexerExpression *>(expr)) {
+		auto *index = dynamic_cast<const LiteralExpression *>(iexpr->GetOperand2());
+
+		if (!index || !index->GetValue().IsString())
+			return false;
+
+		path.push_back(index->GetValue());
+		expr = iexpr->GetOperand1();
+	}
+
+	auto *vexpr = dynamic_cast<const VariableExpression *>(expr);
+
+	if (!vexpr || path.empty())
+		return false;
+
+	path.push_back(vexpr->GetVariable());
+	std::reverse(path.begin(), path.end());
+
+	return true;
+}
+
+static bool IsStringLiteral(const Expression *expr, String *value)
+{
+	auto *lexpr = dynamic_cast<const LiteralExpression *>(expr);
+
+	if (!lexpr || !lexpr->GetValue().IsString())
+		return false;
+
+	*value = lexpr->GetValue();
+	return true;
+}
 
 ApplyRule::ApplyRule(String targetType, String name, std::shared_ptr<Expression> expression,
 	std::shared_ptr<Expression> filter, String package, String fkvar, String fvvar, std::shared_ptr<Expression> fterm,
 	bool ignoreOnError, DebugInfo di, Dictionary::Ptr scope)
 	: m_TargetType(std::move(targetType)), m_Name(std::move(name)), m_Expression(std::move(expression)), m_Filter(std::move(filter)), m_Package(std::move(package)), m_FKVar(std::move(fkvar)),
-	m_FVVar(std::move(fvvar)), m_FTerm(std::move(fterm)), m_IgnoreOnError(ignoreOnError), m_DebugInfo(std::move(di)), m_Scope(std::move(scope)), m_HasMatches(false)
-{ }
+	m_FVVar(std::move(fvvar)), m_FTerm(std::move(fterm)), m_IgnoreOnError(ignoreOnError), m_DebugInfo(std::move(di)), m_Scope(std::move(scope)), m_HasMatches(false),
+	m_Stats(std::make_shared<ApplyRuleStats>())
+{
+	AnalyzeFilter();
+}
+
+/**
+ * Finds the condition the filter evaluates first, if it's an equality
+ * check or an 'in' check of an attribute against a string literal. When
+ * that condition is false the rest of the filter is never evaluated, so
+ * the rule can be skipped for objects which don't satisfy it.
+ */
+void ApplyRule::AnalyzeFilter()
+{
+	/* The filter is evaluated once per instance for 'for' loops and may use the loop variables. */
+	if (m_FTerm || !m_Filter)
+		return;
+
+	const Expression *expr = m_Filter.get();
+
+	while (auto *aexpr = dynamic_cast<const LogicalAndExpression *>(expr))
+		expr = aexpr->GetOperand1();
+
+	std::vector<String> path;
+	String value;
+
+	if (auto *eexpr = dynamic_cast<const EqualExpression *>(expr)) {
+		if (!(IsStringLiteral(eexpr->GetOperand2(), &value) && GetAttributePath(eexpr->GetOperand1(), path)) &&
+			!(IsStringLiteral(eexpr->GetOperand1(), &value) && GetAttributePath(eexpr->GetOperand2(), path)))
+			return;
+
+		m_IndexContains = false;
+	} else if (auto *iexpr = dynamic_cast<const InExpression *>(expr)) {
+		if (!IsStringLiteral(iexpr->GetOperand1(), &value) || !GetAttributePath(iexpr->GetOperand2(), path))
+			return;
+
+		m_IndexContains = true;
+	} else
+		return;
+
+	m_IndexPath = std::move(path);
+	m_IndexValue = value;
+}
 
 String ApplyRule::GetTargetType() const
 {
@@ -141,6 +268,9 @@ std::vector<String> ApplyRule::GetTargetTypes(const String& sourceType)
 void ApplyRule::AddMatch()
 {
 	m_HasMatches = true;
+
+	if (m_Profiling)
+		m_Stats->Matches++;
 }
 
 bool ApplyRule::HasMatches() const
@@ -158,6 +288,128 @@ std::vector<ApplyRule>& ApplyRule::GetRules(const String& type)
 	return it->second;
 }
 
+std::shared_ptr<ApplyRuleIndex> ApplyRule::GetIndex(const String& type)
+{
+	std::vector<ApplyRule>& rules = GetRules(type);
+
+	boost::mutex::scoped_lock lock(m_IndexMutex);
+
+	std::shared_ptr<ApplyRuleIndex>& index = m_Indexes[type];
+
+	if (index && index->RuleCount == rules.size())
+		return index;
+
+	index = std::make_shared<ApplyRuleIndex>();
+	index->RuleCount = rules.size();
+
+	for (size_t i = 0; i < rules.size(); i++) {
+		const ApplyRule& rule = rules[i];
+
+		if (rule.m_IndexPath.empty()) {
+			index->Unindexed.push_back(i);
+			continue;
+		}
+
+		auto it = std::find_if(index->Paths.begin(), index->Paths.end(), [&rule](const ApplyRuleIndexPath& ipath) {
+			return ipath.Path == rule.m_IndexPath && ipath.Contains == rule.m_IndexContains;
+		});
+
+		if (it == index->Paths.end()) {
+			ApplyRuleIndexPath ipath;
+			ipath.Path = rule.m_IndexPath;
+			ipath.Contains = rule.m_IndexContains;
+			index->Paths.push_back(std::move(ipath));
+			it = index->Paths.end() - 1;
+		}
+
+		it->Rules[rule.m_IndexValue].push_back(i);
+	}
+
+	return index;
+}
+
+static void AddIndexedRules(const ApplyRuleIndexPath& ipath, const String& value, std::vector<size_t>& candidates)
+{
+	auto it = ipath.Rules.find(value);
+
+	if (it != ipath.Rules.end())
+		candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+}
+
+static void AddAllIndexedRules(const ApplyRuleIndexPath& ipath, std::vector<size_t>& candidates)
+{
+	for (const auto& kv : ipath.Rules)
+		candidates.insert(candidates.end(), kv.second.begin(), kv.second.end());
+}
+
+/**
+ * Returns the rules whose filter may match for an object, in their original order.
+ * Rules which are skipped would have been rejected by the first condition
+ * of their filter.
+ *
+ * @param type The type of the rules.
+ * @param vars The variables which are set for the filter, e.g. 'host'.
+ * @returns The rules.
+ */
+std::vector<ApplyRule *> ApplyRule::GetCandidateRules(const String& type, const Dictionary::Ptr& vars)
+{
+	std::vector<ApplyRule>& rules = GetRules(type);
+	std::shared_ptr<ApplyRuleIndex> index = GetIndex(type);
+
+	std::vector<size_t> candidates = index->Unindexed;
+
+	for (const ApplyRuleIndexPath& ipath : index->Paths) {
+		Value value;
+
+		/* Other variables come from the rule's scope or the globals. */
+		if (!vars->Get(ipath.Path[0], &value)) {
+			AddAllIndexedRules(ipath, candidates);
+			continue;
+		}
+
+		try {
+			for (std::vector<String>::size_type i = 1; i < ipath.Path.size(); i++)
+				value = VMOps::GetField(value, ipath.Path[i]);
+		} catch (const std::exception&) {
+			/* Let the filter report the error. */
+			AddAllIndexedRules(ipath, candidates);
+			continue;
+		}
+
+		/* Mirrors Value::operator== for string literals: an empty value equals "". */
+		if (!ipath.Contains) {
+			if (value.IsString() || value.IsEmpty())
+				AddIndexedRules(ipath, value, candidates);
+			else
+				AddAllIndexedRules(ipath, candidates);
+		} else if (value.IsObjectType<Array>()) {
+			Array::Ptr arr = value;
+
+			ObjectLock olock(arr);
+			for (const Value& item : arr) {
+				if (item.IsString() || item.IsEmpty())
+					AddIndexedRules(ipath, item, candidates);
+				else {
+					AddAllIndexedRules(ipath, candidates);
+					break;
+				}
+			}
+		} else if (!value.IsEmpty())
+			AddAllIndexedRules(ipath, candidates);
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	std::vector<ApplyRule *> result;
+	result.reserve(candidates.size());
+
+	for (size_t i : candidates)
+		result.push_back(&rules[i]);
+
+	return result;
+}
+
 void ApplyRule::CheckMatches()
 {
 	for (const RuleMap::value_type& kv : m_Rules) {
@@ -168,3 +420,68 @@ void ApplyRule::CheckMatches()
 		}
 	}
 }
+
+/**
+ * Enables counting the evaluations and matches of apply rules and the time
+ * they take. Must be called before the configuration is committed.
+ */
+void ApplyRule::EnableProfiling()
+{
+	m_Profiling = true;
+}
+
+bool ApplyRule::IsProfilingEnabled()
+{
+	return m_Profiling;
+}
+
+/**
+ * Prints the apply rules which took the most time to evaluate.
+ */
+void ApplyRule::PrintSlowestRules(std::ostream& fp, size_t count)
+{
+	std::vector<std::pair<String, const ApplyRule *> > rules;
+
+	for (const RuleMap::value_type& kv : m_Rules) {
+		for (const ApplyRule& rule : kv.second) {
+			if (rule.m_Stats->Evaluations > 0)
+				rules.emplace_back(kv.first, &rule);
+		}
+	}
+
+	std::sort(rules.begin(), rules.end(), [](const std::pair<String, const ApplyRule *>& a, const std::pair<String, const ApplyRule *>& b) {
+		return a.second->m_Stats->Time > b.second->m_Stats->Time;
+	});
+
+	if (rules.size() > count)
+		rules.resize(count);
+
+	fp << std::left << std::setw(50) << "Apply rule" << std::right << std::setw(12) << "Evaluations"
+		<< std::setw(10) << "Matches" << std::setw(12) << "Time" << "\n";
+
+	fp << std::fixed << std::setprecision(3);
+
+	for (const auto& kv : rules) {
+		const ApplyRule *rule = kv.second;
+
+		fp << std::left << std::setw(50) << (kv.first + " '" + rule->GetName() + "'") << std::right
+			<< std::setw(12) << rule->m_Stats->Evaluations << std::setw(10) << rule->m_Stats->Matches
+			<< std::setw(11) << rule->m_Stats->Time / 1000000.0 << "s\n"
+			<< "  " << rule->GetDebugInfo() << "\n";
+	}
+
+	fp.unsetf(std::ios_base::floatfield);
+}
+
+ApplyRuleEvaluation::ApplyRuleEvaluation(const ApplyRule& rule)
+	: m_Rule(rule), m_Start(ApplyRule::m_Profiling ? Utility::GetTime() : 0)
+{ }
+
+ApplyRuleEvaluation::~ApplyRuleEvaluation()
+{
+	if (!ApplyRule::m_Profiling)
+		return;
+
+	m_Rule.m_Stats->Evaluations++;
+	m_Rule.m_Stats->Time += static_cast<uint64_t>((Utility::GetTime() - m_Start) * 1000000);
+}
@@ -23,10 +23,14 @@
 #include "config/i2-config.hpp"
 #include "config/expression.hpp"
 #include "base/debuginfo.hpp"
+#include <boost/thread/mutex.hpp>
 
 namespace icinga
 {
 
+struct ApplyRuleIndex;
+struct ApplyRuleStats;
+
 /**
  * @ingroup config
  */
@@ -56,6 +60,7 @@ public:
 		const std::shared_ptr<Expression>& filter, const String& package, const String& fkvar, const String& fvvar, const std::shared_ptr<Expression>& fterm,
 		bool ignoreOnError, const DebugInfo& di, const Dictionary::Ptr& scope);
 	static std::vector<ApplyRule>& GetRules(const String& type);
+	static std::vector<ApplyRule *> GetCandidateRules(const String& type, const Dictionary::Ptr& vars);
 
 	static void RegisterType(const String& sourceType, const std::vector<String>& targetTypes);
 	static bool IsValidSourceType(const String& sourceType);
@@ -64,6 +69,10 @@ public:
 
 	static void CheckMatches();
 
+	static void EnableProfiling();
+	static bool IsProfilingEnabled();
+	static void PrintSlowestRules(std::ostream& fp, size_t count);
+
 private:
 	String m_TargetType;
 	String m_Name;
@@ -77,13 +86,50 @@ private:
 	DebugInfo m_DebugInfo;
 	Dictionary::Ptr m_Scope;
 	bool m_HasMatches;
+	std::shared_ptr<ApplyRuleStats> m_Stats;
+
+	/* The condition the filter checks first, e.g. host.vars.os == "Linux" */
+	std::vector<String> m_IndexPath;
+	bool m_IndexContains{false};
+	String m_IndexValue;
 
 	static TypeMap m_Types;
 	static RuleMap m_Rules;
 
+	static bool m_Profiling;
+
+	static boost::mutex m_IndexMutex;
+	static std::map<String, std::shared_ptr<ApplyRuleIndex> > m_Indexes;
+
+	void AnalyzeFilter();
+	static std::shared_ptr<ApplyRuleIndex> GetIndex(const String& type);
+
 	ApplyRule(String targetType, String name, std::shared_ptr<Expression> expression,
 		std::shared_ptr<Expression> filter, String package, String fkvar, String fvvar, std::shared_ptr<Expression> fterm,
 		bool ignoreOnError, DebugInfo di, Dictionary::Ptr scope);
+
+	friend class ApplyRuleEvaluation;
+};
+
+/**
+ * Accounts one evaluation of an apply rule for an object, i.e. the filter,
+ * the 'for' expansion and building the new config items, while profiling
+ * is enabled.
+ *
+ * @ingroup config
+ */
+class ApplyRuleEvaluation
+{
+public:
+	explicit ApplyRuleEvaluation(const ApplyRule& rule);
+	~ApplyRuleEvaluation();
+
+	ApplyRuleEvaluation(const ApplyRuleEvaluation&) = delete;
+	ApplyRuleEvaluation& operator=(const ApplyRuleEvaluation&) = delete;
+
+private:
+	const ApplyRule& m_Rule;
+	double m_Start;
 };
 
 }
@@ -30,6 +30,7 @@
 #include "base/exception.hpp"
 #include "base/configtype.hpp"
 #include "base/exception.hpp"
+#include "base/scriptutils.hpp"
 #include <sstream>
 #include <stack>
 
@@ -813,6 +814,16 @@ else_if_branches: /* empty */
 
 rterm_side_effect: rterm '(' rterm_items ')'
 	{
+		/* Compile constant regex() patterns once while parsing, e.g. for assign rules. */
+		auto *fname = dynamic_cast<VariableExpression *>($1);
+
+		if (fname && fname->GetVariable() == "regex" && !$3->empty()) {
+			auto *pattern = dynamic_cast<LiteralExpression *>((*$3)[0].get());
+
+			if (pattern && pattern->GetValue().IsString())
+				ScriptUtils::PrecompileRegex(pattern->GetValue());
+		}
+
 		$$ = new FunctionCallExpression(std::unique_ptr<Expression>($1), std::move(*$3), @$);
 		delete $3;
 	}
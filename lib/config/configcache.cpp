@@ -0,0 +1,629 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/configcache.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitembuilder.hpp"
+#include "config/expression.hpp"
+#include "base/application.hpp"
+#include "base/configobject.hpp"
+#include "base/function.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/netstring.hpp"
+#include "base/objectlock.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/stdiostream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include "base/exception.hpp"
+#include <boost/exception/errinfo_api_function.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <boost/exception/errinfo_file_name.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+using namespace icinga;
+
+boost::mutex ConfigCache::m_Mutex;
+Array::Ptr ConfigCache::m_Inputs = new Array();
+Dictionary::Ptr ConfigCache::m_Globals;
+std::vector<String> ConfigCache::m_InputStates;
+
+/* Bump this whenever the format of the cache file changes. */
+static const int l_ConfigCacheVersion = 1;
+
+typedef std::map<Function *, String> FunctionNameMap;
+
+/**
+ * Sets the fields of a config object from a cache record.
+ */
+class CachedObjectExpression final : public DebuggableExpression
+{
+public:
+	CachedObjectExpression(Dictionary::Ptr properties, const DebugInfo& debugInfo = DebugInfo())
+		: DebuggableExpression(debugInfo), m_Properties(std::move(properties))
+	{ }
+
+protected:
+	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
+
+private:
+	Dictionary::Ptr m_Properties;
+};
+
+/**
+ * Collects the names of the functions which are available before the
+ * configuration is loaded, i.e. the built-in functions.
+ */
+static void CollectFunctionNames(const Dictionary::Ptr& scope, const String& prefix, int depth, FunctionNameMap& functions)
+{
+	ObjectLock olock(scope);
+	for (const Dictionary::Pair& kv : scope) {
+		if (!kv.second.IsObject())
+			continue;
+
+		Object::Ptr object = kv.second;
+
+		Function::Ptr func = dynamic_pointer_cast<Function>(object);
+
+		if (func) {
+			functions.insert(std::make_pair(func.get(), prefix + kv.first));
+			continue;
+		}
+
+		Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(object);
+
+		if (dict && depth > 0)
+			CollectFunctionNames(dict, prefix + kv.first + ".", depth - 1, functions);
+	}
+}
+
+/**
+ * Converts a value into a form which can be written to the cache. Functions
+ * can only be cached when they are built-in functions which are referred to
+ * by their name.
+ *
+ * @returns false if the value cannot be cached.
+ */
+static bool EncodeValue(const Value& value, const FunctionNameMap& functions, Value& result)
+{
+	if (!value.IsObject()) {
+		result = value;
+		return true;
+	}
+
+	Object::Ptr object = value;
+
+	Dictionary::Ptr dict = dynamic_pointer_cast<Dictionary>(object);
+
+	if (dict) {
+		DictionaryData data;
+
+		ObjectLock olock(dict);
+		for (const Dictionary::Pair& kv : dict) {
+			Value item;
+
+			if (!EncodeValue(kv.second, functions, item))
+				return false;
+
+			data.emplace_back(kv.first, item);
+		}
+
+		result = new Dictionary(std::move(data));
+		return true;
+	}
+
+	Array::Ptr arr = dynamic_pointer_cast<Array>(object);
+
+	if (arr) {
+		ArrayData data;
+
+		ObjectLock olock(arr);
+		for (const Value& value : arr) {
+			Value item;
+
+			if (!EncodeValue(value, functions, item))
+				return false;
+
+			data.push_back(item);
+		}
+
+		result = new Array(std::move(data));
+		return true;
+	}
+
+	Function::Ptr func = dynamic_pointer_cast<Function>(object);
+
+	if (func) {
+		auto it = functions.find(func.get());
+
+		if (it == functions.end())
+			return false;
+
+		result = new Dictionary({ { "__function", it->second } });
+		return true;
+	}
+
+	return false;
+}
+
+static Value DecodeValue(const Value& value)
+{
+	if (value.IsObjectType<Array>()) {
+		Array::Ptr arr = value;
+		ArrayData data;
+
+		ObjectLock olock(arr);
+		for (const Value& item : arr) {
+			data.push_back(DecodeValue(item));
+		}
+
+		return new Array(std::move(data));
+	}
+
+	if (value.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr dict = value;
+
+		if (dict->GetLength() == 1 && dict->Contains("__function")) {
+			String name = dict->Get("__function");
+			Value result = ScriptGlobal::GetGlobals();
+
+			for (const String& token : name.Split(".")) {
+				Dictionary::Ptr scope = result;
+
+				if (!scope || !scope->Get(token, &result))
+					BOOST_THROW_EXCEPTION(std::invalid_argument("Function '" + name + "' does not exist."));
+			}
+
+			return result;
+		}
+
+		DictionaryData data;
+
+		ObjectLock olock(dict);
+		for (const Dictionary::Pair& kv : dict) {
+			data.emplace_back(kv.first, DecodeValue(kv.second));
+		}
+
+		return new Dictionary(std::move(data));
+	}
+
+	return value;
+}
+
+ExpressionResult CachedObjectExpression::DoEvaluate(ScriptFrame& frame, DebugHint *) const
+{
+	ConfigObject::Ptr object = frame.Self;
+	Type::Ptr type = object->GetReflectionType();
+
+	ObjectLock olock(m_Properties);
+	for (const Dictionary::Pair& kv : m_Properties) {
+		int fid = type->GetFieldId(kv.first);
+
+		if (fid < 0)
+			continue;
+
+		object->SetField(fid, DecodeValue(kv.second));
+	}
+
+	return Empty;
+}
+
+void ConfigCache::AddInput(const Array::Ptr& input)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_Inputs->Add(input);
+}
+
+/**
+ * Records a file which was read while loading the configuration.
+ * Files which don't exist are recorded as well.
+ */
+void ConfigCache::AddFileInput(const String& path)
+{
+	AddInput(new Array({ "file", path }));
+}
+
+/**
+ * Records a directory listing which was used while loading the configuration.
+ */
+void ConfigCache::AddGlobInput(const String& pathSpec, int type)
+{
+	AddInput(new Array({ "glob", pathSpec, type }));
+}
+
+/**
+ * Records a recursive directory listing which was used while loading the configuration.
+ */
+void ConfigCache::AddRecursiveGlobInput(const String& path, const String& pattern, int type)
+{
+	AddInput(new Array({ "glob_recursive", path, pattern, type }));
+}
+
+/**
+ * Remembers the global variables which are set before the configuration is
+ * loaded, i.e. the built-in ones and the constants from the command line.
+ */
+void ConfigCache::CaptureGlobals()
+{
+	m_Globals = ScriptGlobal::GetGlobals()->ShallowClone();
+}
+
+static String HashFile(const String& path)
+{
+	std::ifstream fp(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		return "missing";
+
+	std::string content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+	return SHA256(content);
+}
+
+/**
+ * Describes the current state of an input, i.e. the file's hash or the
+ * sorted directory listing.
+ */
+static String GetInputState(const Array::Ptr& input)
+{
+	std::ostringstream msgbuf;
+
+	String kind = input->Get(0);
+
+	msgbuf << kind;
+
+	std::vector<String> paths;
+	auto addPath = [&paths](const String& path) { paths.push_back(path); };
+
+	if (kind == "file") {
+		String path = input->Get(1);
+		msgbuf << "\t" << path << "\t" << HashFile(path);
+	} else if (kind == "glob")
+		Utility::Glob(input->Get(1), addPath, input->Get(2));
+	else if (kind == "glob_recursive")
+		Utility::GlobRecursive(input->Get(1), input->Get(2), addPath, input->Get(3));
+
+	std::sort(paths.begin(), paths.end());
+
+	for (const String& path : paths)
+		msgbuf << "\t" << path;
+
+	return msgbuf.str();
+}
+
+/**
+ * Computes a hash over the application version, the constants and the
+ * current state of all recorded inputs.
+ */
+String ConfigCache::ComputeFingerprint(const Array::Ptr& inputs)
+{
+	std::ostringstream msgbuf;
+
+	msgbuf << l_ConfigCacheVersion << "\n" << Application::GetAppVersion() << "\n";
+
+	{
+		ObjectLock olock(m_Globals);
+		for (const Dictionary::Pair& kv : m_Globals) {
+			if (!kv.second.IsObject())
+				msgbuf << kv.first << "=" << JsonEncode(kv.second) << "\n";
+		}
+	}
+
+	ObjectLock olock(inputs);
+	for (const Array::Ptr& input : inputs)
+		msgbuf << GetInputState(input) << "\n";
+
+	return SHA256(msgbuf.str());
+}
+
+/**
+ * Writes the evaluated configuration to the cache file. The cache is removed
+ * if the configuration cannot be cached, e.g. because it contains lambdas or
+ * user-defined functions.
+ */
+void ConfigCache::WriteCache(const String& filename, const std::vector<ConfigItem::Ptr>& items)
+{
+	if (!m_Globals)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("The global variables must be captured before the configuration is loaded."));
+
+	double start = Utility::GetTime();
+
+	FunctionNameMap functions;
+	CollectFunctionNames(m_Globals, "", 1, functions);
+
+	/* Globals which were added or changed by the configuration. */
+	Dictionary::Ptr globals = new Dictionary();
+	String reason;
+
+	{
+		Dictionary::Ptr current = ScriptGlobal::GetGlobals();
+
+		ObjectLock olock(current);
+		for (const Dictionary::Pair& kv : current) {
+			Value oldValue;
+
+			if (m_Globals->Get(kv.first, &oldValue) && oldValue.GetType() == kv.second.GetType() && oldValue == kv.second)
+				continue;
+
+			Value value;
+
+			if (!EncodeValue(kv.second, functions, value)) {
+				reason = "global variable '" + kv.first + "'";
+				break;
+			}
+
+			globals->Set(kv.first, value);
+		}
+	}
+
+	std::vector<Dictionary::Ptr> records;
+
+	for (const ConfigItem::Ptr& item : items) {
+		if (!reason.IsEmpty())
+			break;
+
+		ConfigObject::Ptr object = item->GetObject();
+
+		if (!object)
+			continue;
+
+		Type::Ptr type = object->GetReflectionType();
+		Dictionary::Ptr properties = new Dictionary();
+
+		for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+			Field field = type->GetFieldInfo(fid);
+
+			if (!(field.Attributes & FAConfig))
+				continue;
+
+			Value value;
+
+			if (!EncodeValue(object->GetField(fid), functions, value)) {
+				reason = "attribute '" + String(field.Name) + "' of object '" + object->GetName() + "'";
+				break;
+			}
+
+			properties->Set(field.Name, value);
+		}
+
+		DebugInfo di = item->GetDebugInfo();
+
+		records.push_back(new Dictionary({
+			{ "type", type->GetName() },
+			{ "name", item->GetName() },
+			{ "properties", properties },
+			{ "debug_info", new Array({ di.Path.GetString(), di.FirstLine, di.FirstColumn, di.LastLine, di.LastColumn }) }
+		}));
+	}
+
+	if (!reason.IsEmpty()) {
+		Log(LogNotice, "ConfigCache")
+			<< "Not caching the configuration: The " << reason << " uses a function which is defined in the configuration.";
+
+		(void) unlink(filename.CStr());
+		return;
+	}
+
+	Array::Ptr zoneDirs = new Array();
+
+	for (const auto& kv : ConfigCompiler::GetAllZoneDirs()) {
+		for (const ZoneFragment& zf : kv.second) {
+			zoneDirs->Add(new Array({ zf.Tag, zf.Path, kv.first }));
+		}
+	}
+
+	Array::Ptr inputs;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		inputs = m_Inputs->ShallowClone();
+	}
+
+	Dictionary::Ptr header = new Dictionary({
+		{ "version", l_ConfigCacheVersion },
+		{ "fingerprint", ComputeFingerprint(inputs) },
+		{ "inputs", inputs },
+		{ "globals", globals },
+		{ "zone_dirs", zoneDirs }
+	});
+
+	std::fstream fp;
+	String tempFilename = Utility::CreateTempFile(filename + ".XXXXXX", 0600, fp);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open '" + tempFilename + "' file"));
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	NetString::WriteStringToStream(sfp, JsonEncode(header));
+
+	for (const Dictionary::Ptr& record : records) {
+		NetString::WriteStringToStream(sfp, JsonEncode(record));
+	}
+
+	sfp->Close();
+
+	fp.close();
+
+#ifdef _WIN32
+	_unlink(filename.CStr());
+#endif /* _WIN32 */
+
+	if (rename(tempFilename.CStr(), filename.CStr()) < 0) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("rename")
+			<< boost::errinfo_errno(errno)
+			<< boost::errinfo_file_name(tempFilename));
+	}
+
+	Log(LogInformation, "ConfigCache")
+		<< "Cached " << records.size() << " config objects in '" << filename << "' in "
+		<< Utility::FormatDuration(Utility::GetTime() - start) << ".";
+}
+
+/**
+ * Registers the config items from the cache file. Nothing is registered
+ * unless the cache is up to date.
+ *
+ * @returns true if the cache was loaded.
+ */
+bool ConfigCache::LoadCache(const String& filename)
+{
+	if (!m_Globals)
+		BOOST_THROW_EXCEPTION(std::invalid_argument("The global variables must be captured before the configuration is loaded."));
+
+	if (!Utility::PathExists(filename))
+		return false;
+
+	std::fstream fp;
+	fp.open(filename.CStr(), std::ios_base::in);
+
+	StdioStream::Ptr sfp = new StdioStream(&fp, false);
+
+	String message;
+	StreamReadContext src;
+
+	if (NetString::ReadStringFromStream(sfp, &message, src) != StatusNewItem) {
+		sfp->Close();
+		return false;
+	}
+
+	Dictionary::Ptr header = JsonDecode(message);
+	Array::Ptr inputs = header->Get("inputs");
+
+	if (header->Get("version") != l_ConfigCacheVersion || !inputs || header->Get("fingerprint") != ComputeFingerprint(inputs)) {
+		Log(LogInformation, "ConfigCache")
+			<< "The configuration has changed since the cache '" << filename << "' was written.";
+
+		sfp->Close();
+		return false;
+	}
+
+	Log(LogInformation, "ConfigCache")
+		<< "Loading the configuration from the cache '" << filename << "'.";
+
+	Dictionary::Ptr globals = header->Get("globals");
+
+	{
+		ObjectLock olock(globals);
+		for (const Dictionary::Pair& kv : globals) {
+			ScriptGlobal::Set(kv.first, DecodeValue(kv.second));
+		}
+	}
+
+	Array::Ptr zoneDirs = header->Get("zone_dirs");
+
+	{
+		ObjectLock olock(zoneDirs);
+		for (const Array::Ptr& zoneDir : zoneDirs) {
+			ConfigCompiler::RegisterZoneDir(zoneDir->Get(0), zoneDir->Get(1), zoneDir->Get(2));
+		}
+	}
+
+	for (;;) {
+		StreamReadStatus srs = NetString::ReadStringFromStream(sfp, &message, src);
+
+		if (srs == StatusEof)
+			break;
+
+		if (srs != StatusNewItem)
+			continue;
+
+		Dictionary::Ptr record = JsonDecode(message);
+		Dictionary::Ptr properties = record->Get("properties");
+		Array::Ptr debugInfo = record->Get("debug_info");
+
+		DebugInfo di;
+		di.Path = static_cast<String>(debugInfo->Get(0));
+		di.FirstLine = debugInfo->Get(1);
+		di.FirstColumn = debugInfo->Get(2);
+		di.LastLine = debugInfo->Get(3);
+		di.LastColumn = debugInfo->Get(4);
+
+		ConfigItemBuilder builder(di);
+		builder.SetType(Type::GetByName(record->Get("type")));
+		builder.SetName(record->Get("name"));
+		builder.SetZone(properties->Get("zone"));
+		builder.SetPackage(properties->Get("package"));
+		builder.AddExpression(new CachedObjectExpression(properties, di));
+
+		ConfigItem::Ptr item = builder.Compile();
+		item->Register();
+	}
+
+	sfp->Close();
+
+	return true;
+}
+
+/**
+ * Remembers the current state of all recorded inputs. GetChangedFiles()
+ * compares the inputs against this snapshot.
+ */
+void ConfigCache::SnapshotInputs()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	m_InputStates.clear();
+
+	ObjectLock olock(m_Inputs);
+	for (const Array::Ptr& input : m_Inputs)
+		m_InputStates.push_back(GetInputState(input));
+}
+
+/**
+ * Determines which config files have changed since SnapshotInputs() was called.
+ *
+ * @param[out] files The files whose content has changed.
+ * @param ignoredDir Inputs in this directory are ignored.
+ * @returns false if files were added or removed.
+ */
+bool ConfigCache::GetChangedFiles(std::vector<String>& files, const String& ignoredDir)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	ObjectLock olock(m_Inputs);
+
+	for (std::vector<String>::size_type i = 0; i < m_InputStates.size(); i++) {
+		Array::Ptr input = m_Inputs->Get(i);
+
+		String inputPath = input->Get(1);
+
+		if (!ignoredDir.IsEmpty() && inputPath.Find(ignoredDir) == 0)
+			continue;
+
+		if (GetInputState(input) == m_InputStates[i])
+			continue;
+
+		if (input->Get(0) != "file")
+			return false;
+
+		if (!Utility::PathExists(inputPath))
+			return false;
+
+		if (std::find(files.begin(), files.end(), inputPath) == files.end())
+			files.push_back(inputPath);
+	}
+
+	return true;
+}
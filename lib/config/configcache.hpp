@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include "config/i2-config.hpp"
+#include "config/configitem.hpp"
+#include "base/array.hpp"
+#include "base/dictionary.hpp"
+#include <boost/thread/mutex.hpp>
+
+namespace icinga
+{
+
+/**
+ * A cache for the evaluated configuration. It is only used while none of
+ * the files and directories which were read for the configuration changed.
+ *
+ * @ingroup config
+ */
+class ConfigCache
+{
+public:
+	static void AddFileInput(const String& path);
+	static void AddGlobInput(const String& pathSpec, int type);
+	static void AddRecursiveGlobInput(const String& path, const String& pattern, int type);
+
+	static void CaptureGlobals();
+
+	static void SnapshotInputs();
+	static bool GetChangedFiles(std::vector<String>& files, const String& ignoredDir = String());
+
+	static void WriteCache(const String& filename, const std::vector<ConfigItem::Ptr>& items);
+	static bool LoadCache(const String& filename);
+
+private:
+	ConfigCache();
+
+	static boost::mutex m_Mutex;
+	static Array::Ptr m_Inputs;
+	static Dictionary::Ptr m_Globals;
+	static std::vector<String> m_InputStates;
+
+	static void AddInput(const Array::Ptr& input);
+	static String ComputeFingerprint(const Array::Ptr& inputs);
+};
+
+}
+
+#endif /* CONFIGCACHE_H */
@@ -19,11 +19,14 @@
 
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
+#include "config/configcache.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/loader.hpp"
 #include "base/context.hpp"
 #include "base/exception.hpp"
+#include "base/application.hpp"
+#include "base/workqueue.hpp"
 #include <fstream>
 
 using namespace icinga;
@@ -31,6 +34,8 @@ using namespace icinga;
 std::vector<String> ConfigCompiler::m_IncludeSearchDirs;
 boost::mutex ConfigCompiler::m_ZoneDirsMutex;
 std::map<String, std::vector<ZoneFragment> > ConfigCompiler::m_ZoneDirs;
+boost::mutex ConfigCompiler::m_ConfigFilesMutex;
+std::map<String, ConfigFileInfo> ConfigCompiler::m_ConfigFiles;
 
 /**
  * Constructor for the ConfigCompiler class.
@@ -121,6 +126,51 @@ void ConfigCompiler::CollectIncludes(std::vector<std::unique_ptr<Expression> >&
 	}
 }
 
+/**
+ * Compiles a list of files on the thread pool. The expressions are added
+ * in the same order as the files so that the evaluation order doesn't
+ * change. Files which can't be compiled are skipped with a warning.
+ *
+ * @param expressions The list the expressions are added to.
+ * @param files The files.
+ * @param zone The zone.
+ * @param package The package.
+ */
+void ConfigCompiler::CompileFiles(std::vector<std::unique_ptr<Expression> >& expressions,
+	const std::vector<String>& files, const String& zone, const String& package)
+{
+	if (files.size() < 2) {
+		for (const String& file : files)
+			CollectIncludes(expressions, file, zone, package);
+
+		return;
+	}
+
+	std::vector<std::unique_ptr<Expression> > results(files.size());
+	std::vector<std::vector<String>::size_type> indices(files.size());
+
+	for (std::vector<String>::size_type i = 0; i < files.size(); i++)
+		indices[i] = i;
+
+	WorkQueue upq(25000, Application::GetConcurrency());
+	upq.SetName("ConfigCompiler");
+
+	upq.ParallelFor(indices, [&files, &results, &zone, &package](std::vector<String>::size_type i) {
+		std::vector<std::unique_ptr<Expression> > expression;
+		CollectIncludes(expression, files[i], zone, package);
+
+		if (!expression.empty())
+			results[i] = std::move(expression[0]);
+	});
+
+	upq.Join();
+
+	for (auto& expression : results) {
+		if (expression)
+			expressions.emplace_back(std::move(expression));
+	}
+}
+
 /**
  * Handles an include directive.
  *
@@ -152,14 +202,19 @@ std::unique_ptr<Expression> ConfigCompiler::HandleInclude(const String& relative
 		}
 	}
 
-	std::vector<std::unique_ptr<Expression> > expressions;
+	ConfigCache::AddGlobInput(includePath, GlobFile);
+
+	std::vector<String> files;
 
-	if (!Utility::Glob(includePath, std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zone, package), GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
+	if (!Utility::Glob(includePath, [&files](const String& file) { files.push_back(file); }, GlobFile) && includePath.FindFirstOf("*?") == String::NPos) {
 		std::ostringstream msgbuf;
 		msgbuf << "Include file '" + path + "' does not exist";
 		BOOST_THROW_EXCEPTION(ScriptError(msgbuf.str(), debuginfo));
 	}
 
+	std::vector<std::unique_ptr<Expression> > expressions;
+	CompileFiles(expressions, files, zone, package);
+
 	std::unique_ptr<DictExpression> expr{new DictExpression(std::move(expressions))};
 	expr->MakeInline();
 	return std::move(expr);
@@ -183,8 +238,13 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeRecursive(const String&
 	else
 		ppath = relativeBase + "/" + path;
 
+	ConfigCache::AddRecursiveGlobInput(ppath, pattern, GlobFile);
+
+	std::vector<String> files;
+	Utility::GlobRecursive(ppath, pattern, [&files](const String& file) { files.push_back(file); }, GlobFile);
+
 	std::vector<std::unique_ptr<Expression> > expressions;
-	Utility::GlobRecursive(ppath, pattern, std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zone, package), GlobFile);
+	CompileFiles(expressions, files, zone, package);
 
 	std::unique_ptr<DictExpression> dict{new DictExpression(std::move(expressions))};
 	dict->MakeInline();
@@ -204,7 +264,12 @@ void ConfigCompiler::HandleIncludeZone(const String& relativeBase, const String&
 
 	RegisterZoneDir(tag, ppath, zoneName);
 
-	Utility::GlobRecursive(ppath, pattern, std::bind(&ConfigCompiler::CollectIncludes, std::ref(expressions), _1, zoneName, package), GlobFile);
+	ConfigCache::AddRecursiveGlobInput(ppath, pattern, GlobFile);
+
+	std::vector<String> files;
+	Utility::GlobRecursive(ppath, pattern, [&files](const String& file) { files.push_back(file); }, GlobFile);
+
+	CompileFiles(expressions, files, zoneName, package);
 }
 
 /**
@@ -229,6 +294,8 @@ std::unique_ptr<Expression> ConfigCompiler::HandleIncludeZones(const String& rel
 		newRelativeBase = ".";
 	}
 
+	ConfigCache::AddGlobInput(ppath + "/*", GlobDirectory);
+
 	std::vector<std::unique_ptr<Expression> > expressions;
 	Utility::Glob(ppath + "/*", std::bind(&ConfigCompiler::HandleIncludeZone, newRelativeBase, tag, _1, pattern, package, std::ref(expressions)), GlobDirectory);
 	return std::unique_ptr<Expression>(new DictExpression(std::move(expressions)));
@@ -270,6 +337,8 @@ std::unique_ptr<Expression> ConfigCompiler::CompileFile(const String& path, cons
 {
 	CONTEXT("Compiling configuration file '" + path + "'");
 
+	ConfigCache::AddFileInput(path);
+
 	std::ifstream stream(path.CStr(), std::ifstream::in);
 
 	if (!stream)
@@ -281,7 +350,55 @@ std::unique_ptr<Expression> ConfigCompiler::CompileFile(const String& path, cons
 	Log(LogNotice, "ConfigCompiler")
 		<< "Compiling config file: " << path;
 
-	return CompileStream(path, &stream, zone, package);
+	std::unique_ptr<Expression> expression = CompileStream(path, &stream, zone, package);
+
+	{
+		boost::mutex::scoped_lock lock(m_ConfigFilesMutex);
+		m_ConfigFiles[path] = { zone, package, IsObjectsOnly(expression.get()) };
+	}
+
+	return expression;
+}
+
+/**
+ * Retrieves the zone and package a config file was compiled for.
+ *
+ * @param path The path.
+ * @param[out] info Information about the file.
+ * @returns false if the file wasn't compiled using CompileFile().
+ */
+bool ConfigCompiler::GetConfigFileInfo(const String& path, ConfigFileInfo *info)
+{
+	boost::mutex::scoped_lock lock(m_ConfigFilesMutex);
+
+	auto it = m_ConfigFiles.find(path);
+
+	if (it == m_ConfigFiles.end())
+		return false;
+
+	*info = it->second;
+	return true;
+}
+
+/**
+ * Checks whether a compiled file only contains object definitions, i.e. no
+ * templates, apply rules, includes or variables.
+ */
+bool ConfigCompiler::IsObjectsOnly(const Expression *expression)
+{
+	auto *dexpr = dynamic_cast<const DictExpression *>(expression);
+
+	if (!dexpr)
+		return false;
+
+	for (const std::unique_ptr<Expression>& expr : dexpr->GetExpressions()) {
+		auto *oexpr = dynamic_cast<const ObjectExpression *>(expr.get());
+
+		if (!oexpr || oexpr->IsAbstract())
+			return false;
+	}
+
+	return true;
 }
 
 /**
@@ -321,6 +438,12 @@ std::vector<ZoneFragment> ConfigCompiler::GetZoneDirs(const String& zone)
 		return it->second;
 }
 
+std::map<String, std::vector<ZoneFragment> > ConfigCompiler::GetAllZoneDirs()
+{
+	boost::mutex::scoped_lock lock(m_ZoneDirsMutex);
+	return m_ZoneDirs;
+}
+
 void ConfigCompiler::RegisterZoneDir(const String& tag, const String& ppath, const String& zoneName)
 {
 	ZoneFragment zf;
@@ -328,7 +451,15 @@ void ConfigCompiler::RegisterZoneDir(const String& tag, const String& ppath, con
 	zf.Path = ppath;
 
 	boost::mutex::scoped_lock lock(m_ZoneDirsMutex);
-	m_ZoneDirs[zoneName].push_back(zf);
+
+	std::vector<ZoneFragment>& zoneDirs = m_ZoneDirs[zoneName];
+
+	for (const ZoneFragment& existing : zoneDirs) {
+		if (existing.Tag == tag && existing.Path == ppath)
+			return;
+	}
+
+	zoneDirs.push_back(zf);
 }
 
 bool ConfigCompiler::HasZoneConfigAuthority(const String& zoneName)
@@ -77,6 +77,16 @@ struct ZoneFragment
 	String Path;
 };
 
+/**
+ * Information about a config file which was compiled while loading the configuration.
+ */
+struct ConfigFileInfo
+{
+	String Zone;
+	String Package;
+	bool ObjectsOnly; /**< Whether the file only contains object definitions. */
+};
+
 /**
  * The configuration compiler can be used to compile a configuration file
  * into a number of configuration items.
@@ -111,6 +121,8 @@ public:
 
 	static void CollectIncludes(std::vector<std::unique_ptr<Expression> >& expressions,
 		const String& file, const String& zone, const String& package);
+	static void CompileFiles(std::vector<std::unique_ptr<Expression> >& expressions,
+		const std::vector<String>& files, const String& zone, const String& package);
 
 	static std::unique_ptr<Expression> HandleInclude(const String& relativeBase, const String& path, bool search,
 		const String& zone, const String& package, const DebugInfo& debuginfo = DebugInfo());
@@ -123,10 +135,14 @@ public:
 	void *GetScanner() const;
 
 	static std::vector<ZoneFragment> GetZoneDirs(const String& zone);
+	static std::map<String, std::vector<ZoneFragment> > GetAllZoneDirs();
 	static void RegisterZoneDir(const String& tag, const String& ppath, const String& zoneName);
 
 	static bool HasZoneConfigAuthority(const String& zoneName);
 
+	static bool GetConfigFileInfo(const String& path, ConfigFileInfo *info);
+	static bool IsObjectsOnly(const Expression *expression);
+
 private:
 	std::promise<std::shared_ptr<Expression> > m_Promise;
 
@@ -140,6 +156,8 @@ private:
 	static std::vector<String> m_IncludeSearchDirs;
 	static boost::mutex m_ZoneDirsMutex;
 	static std::map<String, std::vector<ZoneFragment> > m_ZoneDirs;
+	static boost::mutex m_ConfigFilesMutex;
+	static std::map<String, ConfigFileInfo> m_ConfigFiles;
 
 	void InitializeScanner();
 	void DestroyScanner();
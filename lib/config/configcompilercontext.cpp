@@ -56,8 +56,15 @@ void ConfigCompilerContext::WriteObject(const Dictionary::Ptr& object)
 
 	String json = JsonEncode(object);
 
+	Dictionary::Ptr properties = object->Get("properties");
+	String fullName;
+
+	if (properties)
+		fullName = properties->Get("__name");
+
 	{
 		boost::mutex::scoped_lock lock(m_Mutex);
+		m_ObjectsIndex.push_back({ object->Get("type"), object->Get("name"), fullName, static_cast<uint_least64_t>(m_ObjectsFP->tellp()) });
 		NetString::WriteStringToStream(*m_ObjectsFP, json);
 	}
 }
@@ -66,6 +73,7 @@ void ConfigCompilerContext::CancelObjectsFile()
 {
 	delete m_ObjectsFP;
 	m_ObjectsFP = nullptr;
+	m_ObjectsIndex.clear();
 
 #ifdef _WIN32
 	_unlink(m_ObjectsTempFile.CStr());
@@ -89,5 +97,15 @@ void ConfigCompilerContext::FinishObjectsFile()
 			<< boost::errinfo_errno(errno)
 			<< boost::errinfo_file_name(m_ObjectsTempFile));
 	}
+
+	/* The index is optional, 'icinga2 object list' falls back to reading the whole file. */
+	try {
+		NetStringIndex::WriteToFile(m_ObjectsPath, m_ObjectsIndex);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "cli")
+			<< "Could not write index for objects file '" << m_ObjectsPath << "': " << DiagnosticInformation(ex, false);
+	}
+
+	m_ObjectsIndex.clear();
 }
 
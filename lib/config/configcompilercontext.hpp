@@ -22,6 +22,7 @@
 
 #include "config/i2-config.hpp"
 #include "base/dictionary.hpp"
+#include "base/netstringindex.hpp"
 #include <boost/thread/mutex.hpp>
 #include <fstream>
 
@@ -45,6 +46,7 @@ private:
 	String m_ObjectsPath;
 	String m_ObjectsTempFile;
 	std::fstream *m_ObjectsFP{nullptr};
+	std::vector<NetStringIndexEntry> m_ObjectsIndex;
 
 	mutable boost::mutex m_Mutex;
 };
@@ -36,9 +36,13 @@
 #include "base/json.hpp"
 #include "base/exception.hpp"
 #include "base/function.hpp"
+#include "base/startupprofile.hpp"
 #include <boost/algorithm/string/join.hpp>
+#include <atomic>
 #include <sstream>
 #include <fstream>
+#include <set>
+#include <unordered_map>
 
 using namespace icinga;
 
@@ -48,6 +52,27 @@ ConfigItem::TypeMap ConfigItem::m_DefaultTemplates;
 ConfigItem::ItemList ConfigItem::m_UnnamedItems;
 ConfigItem::IgnoredItemList ConfigItem::m_IgnoredItems;
 
+/* Time spent in Validate() by all threads, in microseconds. */
+static std::atomic<uint64_t> l_ValidationTime{0};
+
+static uint64_t GetMicroseconds(double start)
+{
+	return static_cast<uint64_t>((Utility::GetTime() - start) * 1000000);
+}
+
+/* Items which are created while validating the objects for a package on this thread. */
+struct ConfigItemValidation
+{
+	String Package;
+	std::map<Type::Ptr, std::map<String, ConfigItem::Ptr> > Items;
+	std::vector<ConfigItem::Ptr> UnnamedItems;
+};
+
+static thread_local ConfigItemValidation *l_Validation = nullptr;
+
+static boost::mutex l_SharedTemplatesMutex;
+static std::unordered_map<std::string, Array::Ptr> l_SharedTemplates;
+
 REGISTER_SCRIPTFUNCTION_NS(Internal, run_with_activation_context, &ConfigItem::RunWithActivationContext, "func");
 
 /**
@@ -173,6 +198,45 @@ public:
  *
  * @returns The ConfigObject that was created/updated.
  */
+/**
+ * Replaces the object's list of templates with an identical, frozen array
+ * which is shared between all objects that imported the same templates.
+ * Usually there are only a few distinct lists for all objects.
+ */
+static void ShareTemplates(const ConfigObject::Ptr& object)
+{
+	int fid = object->GetReflectionType()->GetFieldId("templates");
+
+	if (fid == -1)
+		return;
+
+	Array::Ptr templates = object->GetField(fid);
+
+	if (!templates)
+		return;
+
+	std::string key;
+
+	{
+		ObjectLock olock(templates);
+
+		for (const String& name : templates) {
+			key += name.GetData();
+			key += '\0';
+		}
+	}
+
+	boost::mutex::scoped_lock lock(l_SharedTemplatesMutex);
+
+	auto it = l_SharedTemplates.find(key);
+
+	if (it == l_SharedTemplates.end()) {
+		templates->Freeze();
+		l_SharedTemplates.emplace(std::move(key), templates);
+	} else
+		object->SetField(fid, it->second, true);
+}
+
 ConfigObject::Ptr ConfigItem::Commit(bool discard)
 {
 	Type::Ptr type = GetType();
@@ -253,8 +317,12 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	Dictionary::Ptr dhint = debugHints.ToDictionary();
 
 	try {
+		double validationStart = Utility::GetTime();
+
 		DefaultValidationUtils utils;
 		dobj->Validate(FAConfig, utils);
+
+		l_ValidationTime += GetMicroseconds(validationStart);
 	} catch (ValidationError& ex) {
 		if (m_IgnoreOnError) {
 			Log(LogNotice, "ConfigObject")
@@ -290,6 +358,12 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 		throw;
 	}
 
+	/* Objects which are only validated are neither loaded nor registered. */
+	if (l_Validation)
+		return dobj;
+
+	ShareTemplates(dobj);
+
 	Value serializedObject;
 
 	try {
@@ -301,10 +375,10 @@ ConfigObject::Ptr ConfigItem::Commit(bool discard)
 	Dictionary::Ptr persistentItem = new Dictionary({
 		{ "type", type->GetName() },
 		{ "name", GetName() },
-		{ "properties", Serialize(dobj, FAConfig) },
+		{ "properties", serializedObject },
 		{ "debug_hints", dhint },
 		{ "debug_info", new Array({
-			m_DebugInfo.Path,
+			m_DebugInfo.Path.GetString(),
 			m_DebugInfo.FirstLine,
 			m_DebugInfo.FirstColumn,
 			m_DebugInfo.LastLine,
@@ -331,6 +405,15 @@ void ConfigItem::Register()
 {
 	m_ActivationContext = ActivationContext::GetCurrentContext();
 
+	if (l_Validation) {
+		if (!m_Abstract && dynamic_cast<NameComposer *>(m_Type.get()))
+			l_Validation->UnnamedItems.emplace_back(this);
+		else
+			l_Validation->Items[m_Type][m_Name] = this;
+
+		return;
+	}
+
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	/* If this is a non-abstract object with a composite name
@@ -382,6 +465,18 @@ void ConfigItem::Unregister()
  */
 ConfigItem::Ptr ConfigItem::GetByTypeAndName(const Type::Ptr& type, const String& name)
 {
+	/* While validating the objects for a package they replace the package's registered items. */
+	if (l_Validation) {
+		auto it = l_Validation->Items.find(type);
+
+		if (it != l_Validation->Items.end()) {
+			auto it2 = it->second.find(name);
+
+			if (it2 != it->second.end())
+				return it2->second;
+		}
+	}
+
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	auto it = m_Items.find(type);
@@ -394,6 +489,9 @@ ConfigItem::Ptr ConfigItem::GetByTypeAndName(const Type::Ptr& type, const String
 	if (it2 == it->second.end())
 		return nullptr;
 
+	if (l_Validation && it2->second->m_Package == l_Validation->Package)
+		return nullptr;
+
 	return it2->second;
 }
 
@@ -446,9 +544,16 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 
 	upq.Join();
 
+	StartupProfile::AddWorkerTime("validation", l_ValidationTime.exchange(0) / 1000000.0);
+
 	if (upq.HasExceptions())
 		return false;
 
+	std::map<Type::Ptr, std::vector<ItemPair> > itemsByType;
+
+	for (const ItemPair& ip : items)
+		itemsByType[ip.first->m_Type].push_back(ip);
+
 	std::set<Type::Ptr> types;
 
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
@@ -459,6 +564,10 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 	std::set<Type::Ptr> completed_types;
 
 	while (types.size() != completed_types.size()) {
+		/* All types whose load dependencies are resolved are loaded at the same time. */
+		std::vector<Type::Ptr> wave;
+		std::vector<ItemPair> waveItems;
+
 		for (const Type::Ptr& type : types) {
 			if (completed_types.find(type) != completed_types.end())
 				continue;
@@ -477,57 +586,108 @@ bool ConfigItem::CommitNewItems(const ActivationContext::Ptr& context, WorkQueue
 			if (unresolved_dep)
 				continue;
 
-			upq.ParallelFor(items, [&type](const ItemPair& ip) {
-				const ConfigItem::Ptr& item = ip.first;
+			wave.push_back(type);
 
-				if (!item->m_Object || item->m_Type != type)
-					return;
+			auto it = itemsByType.find(type);
 
-				try {
-					item->m_Object->OnAllConfigLoaded();
-				} catch (const std::exception& ex) {
-					if (!item->m_IgnoreOnError)
-						throw;
+			if (it != itemsByType.end())
+				waveItems.insert(waveItems.end(), it->second.begin(), it->second.end());
+		}
 
-					Log(LogNotice, "ConfigObject")
-						<< "Ignoring config object '" << item->m_Name << "' of type '" << item->m_Type->GetName() << "' due to errors: " << DiagnosticInformation(ex);
+		ASSERT(!wave.empty());
 
-					item->Unregister();
+		double start = Utility::GetTime();
 
-					{
-						boost::mutex::scoped_lock lock(item->m_Mutex);
-						item->m_IgnoredItems.push_back(item->m_DebugInfo.Path);
-					}
+		/* Per-type times in microseconds; the maps aren't modified while the work queue runs. */
+		std::map<Type::Ptr, std::atomic<uint64_t> > loadTimes, applyTimes;
+
+		for (const Type::Ptr& type : wave) {
+			loadTimes[type];
+			applyTimes[type];
+		}
+
+		upq.ParallelFor(waveItems, [&loadTimes](const ItemPair& ip) {
+			const ConfigItem::Ptr& item = ip.first;
+
+			if (!item->m_Object)
+				return;
+
+			try {
+				double loadStart = Utility::GetTime();
+
+				item->m_Object->OnAllConfigLoaded();
+
+				loadTimes.find(item->m_Type)->second += GetMicroseconds(loadStart);
+			} catch (const std::exception& ex) {
+				if (!item->m_IgnoreOnError)
+					throw;
+
+				Log(LogNotice, "ConfigObject")
+					<< "Ignoring config object '" << item->m_Name << "' of type '" << item->m_Type->GetName() << "' due to errors: " << DiagnosticInformation(ex);
+
+				item->Unregister();
+
+				{
+					boost::mutex::scoped_lock lock(item->m_Mutex);
+					item->m_IgnoredItems.push_back(item->m_DebugInfo.Path);
 				}
-			});
+			}
+		});
 
-			completed_types.insert(type);
+		upq.Join();
 
-			upq.Join();
+		if (upq.HasExceptions())
+			return false;
 
-			if (upq.HasExceptions())
-				return false;
+		completed_types.insert(wave.begin(), wave.end());
 
+		for (const Type::Ptr& type : wave) {
 			for (const String& loadDep : type->GetLoadDependencies()) {
-				upq.ParallelFor(items, [loadDep, &type](const ItemPair& ip) {
+				auto it = itemsByType.find(Type::GetByName(loadDep));
+
+				if (it == itemsByType.end())
+					continue;
+
+				std::atomic<uint64_t>& applyTime = applyTimes.find(type)->second;
+
+				upq.ParallelFor(it->second, [&type, &applyTime](const ItemPair& ip) {
 					const ConfigItem::Ptr& item = ip.first;
 
-					if (!item->m_Object || item->m_Type->GetName() != loadDep)
+					if (!item->m_Object)
 						return;
 
+					double applyStart = Utility::GetTime();
+
 					ActivationScope ascope(item->m_ActivationContext);
 					item->m_Object->CreateChildObjects(type);
+
+					applyTime += GetMicroseconds(applyStart);
 				});
 			}
+		}
 
-			upq.Join();
+		upq.Join();
 
-			if (upq.HasExceptions())
-				return false;
+		for (const Type::Ptr& type : wave) {
+			uint64_t loadTime = loadTimes[type];
+			uint64_t applyTime = applyTimes[type];
 
-			if (!CommitNewItems(context, upq, newItems))
-				return false;
+			if (loadTime > 0)
+				StartupProfile::AddWorkerTime("on_all_config_loaded/" + type->GetName(), loadTime / 1000000.0);
+
+			if (applyTime > 0)
+				StartupProfile::AddWorkerTime("apply_rules/" + type->GetName(), applyTime / 1000000.0);
 		}
+
+		if (upq.HasExceptions())
+			return false;
+
+		Log(LogNotice, "ConfigItem")
+			<< "Loaded " << waveItems.size() << " config items of " << wave.size() << " types in "
+			<< Utility::FormatDuration(Utility::GetTime() - start) << ".";
+
+		if (!CommitNewItems(context, upq, newItems))
+			return false;
 	}
 
 	return true;
@@ -538,6 +698,8 @@ bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& u
 	if (!silent)
 		Log(LogInformation, "ConfigItem", "Committing config item(s).");
 
+	double start = Utility::GetTime();
+
 	if (!CommitNewItems(context, upq, newItems)) {
 		upq.ReportExceptions("config");
 
@@ -551,6 +713,9 @@ bool ConfigItem::CommitItems(const ActivationContext::Ptr& context, WorkQueue& u
 	ApplyRule::CheckMatches();
 
 	if (!silent) {
+		Log(LogInformation, "ConfigItem")
+			<< "Committed " << newItems.size() << " config items in " << Utility::FormatDuration(Utility::GetTime() - start) << ".";
+
 		/* log stats for external parsers */
 		typedef std::map<Type::Ptr, int> ItemCountMap;
 		ItemCountMap itemCounts;
@@ -612,33 +777,53 @@ bool ConfigItem::ActivateItems(WorkQueue& upq, const std::vector<ConfigItem::Ptr
 		Log(LogInformation, "ConfigItem", "Triggering Start signal for config items");
 
 	/* Activate objects in priority order. */
-	std::vector<Type::Ptr> types = Type::GetAllTypes();
+	std::map<int, std::vector<ConfigObject::Ptr> > objectsByPriority;
 
-	std::sort(types.begin(), types.end(), [](const Type::Ptr& a, const Type::Ptr& b) {
-		if (a->GetActivationPriority() < b->GetActivationPriority())
-			return true;
-		return false;
-	});
+	for (const ConfigItem::Ptr& item : newItems) {
+		if (!item->m_Object)
+			continue;
 
-	for (const Type::Ptr& type : types) {
-		for (const ConfigItem::Ptr& item : newItems) {
-			if (!item->m_Object)
-				continue;
+		ConfigObject::Ptr object = item->m_Object;
+		objectsByPriority[object->GetReflectionType()->GetActivationPriority()].push_back(object);
+	}
 
-			ConfigObject::Ptr object = item->m_Object;
-			Type::Ptr objectType = object->GetReflectionType();
+	for (const auto& kv : objectsByPriority) {
+		int priority = kv.first;
+		const std::vector<ConfigObject::Ptr>& objects = kv.second;
 
-			if (objectType != type)
-				continue;
+		double start = Utility::GetTime();
 
+		auto activate = [runtimeCreated](const ConfigObject::Ptr& object) {
 #ifdef I2_DEBUG
 			Log(LogDebug, "ConfigItem")
 				<< "Activating object '" << object->GetName() << "' of type '"
-				<< objectType->GetName() << "' with priority "
-				<< objectType->GetActivationPriority();
+				<< object->GetReflectionType()->GetName() << "' with priority "
+				<< object->GetReflectionType()->GetActivationPriority();
 #endif /* I2_DEBUG */
 
 			object->Activate(runtimeCreated);
+		};
+
+		/* Types with a non-default priority (loggers, features, listeners) expect to be
+		 * started one after the other. All other objects are independent of each other. */
+		if (priority == 0) {
+			upq.ParallelFor(objects, activate);
+
+			upq.Join();
+
+			if (upq.HasExceptions()) {
+				upq.ReportExceptions("ConfigItem");
+				return false;
+			}
+		} else {
+			for (const ConfigObject::Ptr& object : objects)
+				activate(object);
+		}
+
+		if (!silent) {
+			Log(LogNotice, "ConfigItem")
+				<< "Activated " << objects.size() << " objects with priority " << priority
+				<< " in " << Utility::FormatDuration(Utility::GetTime() - start) << ".";
 		}
 	}
 
@@ -729,6 +914,75 @@ std::vector<ConfigItem::Ptr> ConfigItem::GetDefaultTemplates(const Type::Ptr& ty
 	return items;
 }
 
+/**
+ * Evaluates the expressions and validates the objects they define as if they
+ * replaced the objects of the specified package. The objects are neither
+ * registered nor loaded, i.e. OnConfigLoaded() and OnAllConfigLoaded() aren't
+ * called for them and apply rules aren't evaluated.
+ *
+ * @param package The package the objects belong to.
+ * @param expressions The expressions which define the objects.
+ * @returns The validated objects.
+ */
+std::vector<ConfigObject::Ptr> ConfigItem::ValidateItems(const String& package, const std::vector<std::unique_ptr<Expression> >& expressions)
+{
+	ConfigItemValidation validation;
+	validation.Package = package;
+
+	std::vector<ConfigObject::Ptr> objects;
+
+	l_Validation = &validation;
+
+	try {
+		ActivationScope ascope;
+
+		for (const std::unique_ptr<Expression>& expression : expressions) {
+			ScriptFrame frame(true);
+			expression->Evaluate(frame);
+		}
+
+		std::vector<ConfigItem::Ptr> items;
+
+		for (const auto& kv : validation.Items) {
+			for (const ItemMap::value_type& kv2 : kv.second)
+				items.push_back(kv2.second);
+		}
+
+		items.insert(items.end(), validation.UnnamedItems.begin(), validation.UnnamedItems.end());
+
+		std::set<std::pair<Type::Ptr, String> > names;
+
+		for (const ConfigItem::Ptr& item : items) {
+			if (item->m_Abstract)
+				continue;
+
+			ConfigObject::Ptr object = item->Commit(false);
+
+			if (!object)
+				continue;
+
+			/* Objects with composite names can only be checked for duplicates now. */
+			Type::Ptr type = object->GetReflectionType();
+			auto *ctype = dynamic_cast<ConfigType *>(type.get());
+			ConfigObject::Ptr existing = ctype->GetObject(object->GetName());
+
+			if (!names.insert(std::make_pair(type, object->GetName())).second || (existing && existing->GetPackage() != package)) {
+				BOOST_THROW_EXCEPTION(ScriptError("Object '" + object->GetName() + "' of type '" + type->GetName()
+					+ "' re-defined.", item->m_DebugInfo));
+			}
+
+			objects.push_back(object);
+		}
+	} catch (...) {
+		l_Validation = nullptr;
+		throw;
+	}
+
+	l_Validation = nullptr;
+
+	return objects;
+}
+
 void ConfigItem::RemoveIgnoredItems(const String& allowedConfigPath)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
@@ -79,6 +79,8 @@ public:
 
 	static void RemoveIgnoredItems(const String& allowedConfigPath);
 
+	static std::vector<ConfigObject::Ptr> ValidateItems(const String& package, const std::vector<std::unique_ptr<Expression> >& expressions);
+
 private:
 	Type::Ptr m_Type; /**< The object type. */
 	String m_Name; /**< The name. */
@@ -28,7 +28,9 @@
 #include "base/exception.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/loader.hpp"
+#include "base/configobject.hpp"
 #include <boost/exception_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/exception/errinfo_nested_exception.hpp>
 
 using namespace icinga;
@@ -393,7 +395,7 @@ ExpressionResult LogicalAndExpression::DoEvaluate(ScriptFrame& frame, DebugHint
 		ExpressionResult operand2 = m_Operand2->Evaluate(frame);
 		CHECK_RESULT(operand2);
 
-		return operand2.GetValue();
+		return operand2;
 	}
 }
 
@@ -408,7 +410,7 @@ ExpressionResult LogicalOrExpression::DoEvaluate(ScriptFrame& frame, DebugHint *
 		ExpressionResult operand2 = m_Operand2->Evaluate(frame);
 		CHECK_RESULT(operand2);
 
-		return operand2.GetValue();
+		return operand2;
 	}
 }
 
@@ -423,7 +425,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 		ExpressionResult vfuncres = m_FName->Evaluate(frame);
 		CHECK_RESULT(vfuncres);
 
-		vfunc = vfuncres.GetValue();
+		vfunc = vfuncres.TakeValue();
 	}
 
 	if (vfunc.IsObjectType<Type>()) {
@@ -433,7 +435,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 			ExpressionResult argres = arg->Evaluate(frame);
 			CHECK_RESULT(argres);
 
-			arguments.push_back(argres.GetValue());
+			arguments.push_back(argres.TakeValue());
 		}
 
 		return VMOps::ConstructorCall(vfunc, arguments, m_DebugInfo);
@@ -453,7 +455,7 @@ ExpressionResult FunctionCallExpression::DoEvaluate(ScriptFrame& frame, DebugHin
 		ExpressionResult argres = arg->Evaluate(frame);
 		CHECK_RESULT(argres);
 
-		arguments.push_back(argres.GetValue());
+		arguments.push_back(argres.TakeValue());
 	}
 
 	return VMOps::FunctionCall(frame, self, func, arguments);
@@ -468,7 +470,7 @@ ExpressionResult ArrayExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhin
 		ExpressionResult element = aexpr->Evaluate(frame);
 		CHECK_RESULT(element);
 
-		result.push_back(element.GetValue());
+		result.push_back(element.TakeValue());
 	}
 
 	return new Array(std::move(result));
@@ -489,7 +491,7 @@ ExpressionResult DictExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint
 		for (const auto& aexpr : m_Expressions) {
 			ExpressionResult element = aexpr->Evaluate(frame, m_Inline ? dhint : nullptr);
 			CHECK_RESULT(element);
-			result = element.GetValue();
+			result = element.TakeValue();
 		}
 	} catch (...) {
 		if (!m_Inline)
@@ -615,7 +617,7 @@ ExpressionResult ReturnExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhi
 	ExpressionResult operand = m_Operand->Evaluate(frame);
 	CHECK_RESULT(operand);
 
-	return ExpressionResult(operand.GetValue(), ResultReturn);
+	return ExpressionResult(operand.TakeValue(), ResultReturn);
 }
 
 ExpressionResult BreakExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
@@ -628,11 +630,71 @@ ExpressionResult ContinueExpression::DoEvaluate(ScriptFrame& frame, DebugHint *d
 	return ExpressionResult(Empty, ResultContinue);
 }
 
+/* Protects IndexerExpression::m_FieldCacheEntries, only taken when a field ID is looked up. */
+static boost::mutex l_IndexerFieldCacheMutex;
+
+/* Expressions which see more types than this (e.g. in functions) use the uncached lookup. */
+static const size_t l_IndexerFieldCacheSize = 4;
+
+IndexerExpression::IndexerExpression(std::unique_ptr<Expression> operand1, std::unique_ptr<Expression> operand2, const DebugInfo& debugInfo)
+	: BinaryExpression(std::move(operand1), std::move(operand2), debugInfo)
+{
+	auto *lexpr = dynamic_cast<LiteralExpression *>(m_Operand2.get());
+	m_ConstantIndex = lexpr && lexpr->GetValue().IsString();
+}
+
+const IndexerExpression::FieldCacheEntry *IndexerExpression::GetFieldCacheEntry(const Type *type, const String& field) const
+{
+	const FieldCacheEntry *entry = m_FieldCache.load(std::memory_order_acquire);
+
+	if (entry && entry->CachedType == type)
+		return entry;
+
+	boost::mutex::scoped_lock lock(l_IndexerFieldCacheMutex);
+
+	for (const auto& centry : m_FieldCacheEntries) {
+		if (centry->CachedType == type) {
+			m_FieldCache.store(centry.get(), std::memory_order_release);
+			return centry.get();
+		}
+	}
+
+	if (m_FieldCacheEntries.size() >= l_IndexerFieldCacheSize)
+		return nullptr;
+
+	std::unique_ptr<FieldCacheEntry> nentry{new FieldCacheEntry()};
+	nentry->CachedType = type;
+	nentry->FieldId = type->GetFieldId(field);
+	nentry->NoUserView = nentry->FieldId != -1 && (type->GetFieldInfo(nentry->FieldId).Attributes & FANoUserView);
+
+	entry = nentry.get();
+	m_FieldCacheEntries.push_back(std::move(nentry));
+	m_FieldCache.store(entry, std::memory_order_release);
+
+	return entry;
+}
+
 ExpressionResult IndexerExpression::DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const
 {
 	ExpressionResult operand1 = m_Operand1->Evaluate(frame, dhint);
 	CHECK_RESULT(operand1);
 
+	/* Skip the field name lookup for attributes of config objects. Dictionaries
+	 * and arrays have their own field semantics and use the generic path.
+	 */
+	if (m_ConstantIndex && operand1.GetValue().IsObject()) {
+		auto *object = dynamic_cast<ConfigObject *>(operand1.GetValue().Get<Object::Ptr>().get());
+
+		if (object) {
+			const String& field = static_cast<LiteralExpression *>(m_Operand2.get())->GetValue().Get<String>();
+			Type::Ptr type = object->GetReflectionType();
+			const FieldCacheEntry *entry = GetFieldCacheEntry(type.get(), field);
+
+			if (entry && entry->FieldId != -1 && !(frame.Sandboxed && entry->NoUserView))
+				return object->GetField(entry->FieldId);
+		}
+	}
+
 	ExpressionResult operand2 = m_Operand2->Evaluate(frame, dhint);
 	CHECK_RESULT(operand2);
 
@@ -664,11 +726,11 @@ bool IndexerExpression::GetReference(ScriptFrame& frame, bool init_dict, Value *
 		free_psd = true;
 	} else {
 		ExpressionResult operand1 = m_Operand1->Evaluate(frame);
-		*parent = operand1.GetValue();
+		*parent = operand1.TakeValue();
 	}
 
 	ExpressionResult operand2 = m_Operand2->Evaluate(frame);
-	*index = operand2.GetValue();
+	*index = operand2.TakeValue();
 
 	if (dhint) {
 		if (psdhint)
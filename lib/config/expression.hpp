@@ -28,6 +28,7 @@
 #include "base/exception.hpp"
 #include "base/scriptframe.hpp"
 #include "base/convert.hpp"
+#include <atomic>
 #include <map>
 
 namespace icinga
@@ -46,7 +47,7 @@ public:
 
 	void AddMessage(const String& message, const DebugInfo& di)
 	{
-		GetMessages()->Add(new Array({ message, di.Path, di.FirstLine, di.FirstColumn, di.LastLine, di.LastColumn }));
+		GetMessages()->Add(new Array({ message, di.Path.GetString(), di.FirstLine, di.FirstColumn, di.LastLine, di.LastColumn }));
 	}
 
 	DebugHint GetChild(const String& name)
@@ -168,6 +169,12 @@ public:
 		return m_Value;
 	}
 
+	/* For results which aren't needed afterwards, saves copying the value. */
+	Value TakeValue()
+	{
+		return std::move(m_Value);
+	}
+
 	ExpressionResultCode GetCode() const
 	{
 		return m_Code;
@@ -286,6 +293,11 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand(std::move(operand))
 	{ }
 
+	const Expression *GetOperand() const
+	{
+		return m_Operand.get();
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand;
 };
@@ -297,6 +309,16 @@ public:
 		: DebuggableExpression(debugInfo), m_Operand1(std::move(operand1)), m_Operand2(std::move(operand2))
 	{ }
 
+	const Expression *GetOperand1() const
+	{
+		return m_Operand1.get();
+	}
+
+	const Expression *GetOperand2() const
+	{
+		return m_Operand2.get();
+	}
+
 protected:
 	std::unique_ptr<Expression> m_Operand1;
 	std::unique_ptr<Expression> m_Operand2;
@@ -604,6 +626,16 @@ public:
 
 	void MakeInline();
 
+	bool IsInline() const
+	{
+		return m_Inline;
+	}
+
+	const std::vector<std::unique_ptr<Expression> >& GetExpressions() const
+	{
+		return m_Expressions;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
@@ -712,15 +744,30 @@ private:
 class IndexerExpression final : public BinaryExpression
 {
 public:
-	IndexerExpression(std::unique_ptr<Expression> operand1, std::unique_ptr<Expression> operand2, const DebugInfo& debugInfo = DebugInfo())
-		: BinaryExpression(std::move(operand1), std::move(operand2), debugInfo)
-	{ }
+	IndexerExpression(std::unique_ptr<Expression> operand1, std::unique_ptr<Expression> operand2, const DebugInfo& debugInfo = DebugInfo());
 
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 	bool GetReference(ScriptFrame& frame, bool init_dict, Value *parent, String *index, DebugHint **dhint) const override;
 
 	friend void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
+
+private:
+	struct FieldCacheEntry
+	{
+		const Type *CachedType;
+		int FieldId;
+		bool NoUserView;
+	};
+
+	/* Field IDs for constant indexes (e.g. host.vars) on config objects, by type.
+	 * Entries are immutable and owned by the expression, so readers don't need a lock.
+	 */
+	bool m_ConstantIndex{false};
+	mutable std::atomic<const FieldCacheEntry *> m_FieldCache{nullptr};
+	mutable std::vector<std::unique_ptr<FieldCacheEntry> > m_FieldCacheEntries;
+
+	const FieldCacheEntry *GetFieldCacheEntry(const Type *type, const String& field) const;
 };
 
 void BindToScope(std::unique_ptr<Expression>& expr, ScopeSpecifier scopeSpec);
@@ -824,6 +871,11 @@ public:
 		m_IgnoreOnError(ignoreOnError), m_ClosedVars(std::move(closedVars)), m_Expression(std::move(expression))
 	{ }
 
+	bool IsAbstract() const
+	{
+		return m_Abstract;
+	}
+
 protected:
 	ExpressionResult DoEvaluate(ScriptFrame& frame, DebugHint *dhint) const override;
 
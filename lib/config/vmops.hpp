@@ -119,7 +119,8 @@ public:
 
 			ScriptFrame *frame = ScriptFrame::GetCurrentFrame();
 
-			frame->Locals = new Dictionary();
+			/* Recycled from an earlier call on this thread where possible. */
+			frame->Locals = ScriptFrame::AllocateLocals();
 
 			if (evaluatedClosedVars)
 				evaluatedClosedVars->CopyTo(frame->Locals);
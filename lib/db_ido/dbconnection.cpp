@@ -29,6 +29,7 @@
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
+#include <algorithm>
 
 using namespace icinga;
 
@@ -91,8 +92,16 @@ void DbConnection::Resume()
 
 	m_CleanUpTimer = new Timer();
 	m_CleanUpTimer->SetInterval(60);
+	m_CleanUpTimer->SetSlack(1);
 	m_CleanUpTimer->OnTimerExpired.connect(std::bind(&DbConnection::CleanUpHandler, this));
 	m_CleanUpTimer->Start();
+
+	if (GetCleanupChunkSize() > 0) {
+		m_CleanUpChunkTimer = new Timer();
+		m_CleanUpChunkTimer->SetInterval(GetCleanupChunkInterval());
+		m_CleanUpChunkTimer->OnTimerExpired.connect(std::bind(&DbConnection::CleanUpChunkTimerHandler, this));
+		m_CleanUpChunkTimer->Start();
+	}
 }
 
 void DbConnection::Pause()
@@ -103,6 +112,13 @@ void DbConnection::Pause()
 		<< "Pausing IDO connection: " << GetName();
 
 	m_CleanUpTimer.reset();
+	m_CleanUpChunkTimer.reset();
+
+	{
+		boost::mutex::scoped_lock lock(m_CleanUpMutex);
+		m_CleanUpTasks.clear();
+		m_CleanUpChunkPending = false;
+	}
 
 	DbQuery query1;
 	query1.Table = "programstatus";
@@ -239,7 +255,20 @@ void DbConnection::CleanUpHandler()
 		if (max_age == 0)
 			continue;
 
-		CleanUpExecuteQuery(table.name, table.time_column, now - max_age);
+		if (GetCleanupChunkSize() > 0) {
+			boost::mutex::scoped_lock lock(m_CleanUpMutex);
+
+			auto it = std::find_if(m_CleanUpTasks.begin(), m_CleanUpTasks.end(),
+				[&table](const DbCleanUpTask& task) { return task.Table == table.name; });
+
+			/* A table which is still being cleaned up keeps its place in the queue. */
+			if (it != m_CleanUpTasks.end())
+				it->MaxAge = now - max_age;
+			else
+				m_CleanUpTasks.push_back({ table.name, table.time_column, now - max_age });
+		} else
+			CleanUpExecuteQuery(table.name, table.time_column, now - max_age);
+
 		Log(LogNotice, "DbConnection")
 			<< "Cleanup (" << table.name << "): " << max_age
 			<< " now: " << now
@@ -248,11 +277,85 @@ void DbConnection::CleanUpHandler()
 
 }
 
+/**
+ * Deletes at most one chunk of old rows at a time. The next chunk is
+ * deleted on the next timer run after the previous one has finished,
+ * which limits the rate at which rows are deleted.
+ */
+void DbConnection::CleanUpChunkTimerHandler()
+{
+	DbCleanUpTask task;
+
+	{
+		boost::mutex::scoped_lock lock(m_CleanUpMutex);
+
+		if (m_CleanUpChunkPending || m_CleanUpTasks.empty())
+			return;
+
+		task = m_CleanUpTasks.front();
+		m_CleanUpChunkPending = true;
+	}
+
+	CleanUpExecuteChunk(task.Table, task.TimeColumn, task.MaxAge, GetCleanupChunkSize());
+}
+
+/**
+ * Must be called by the connection when a chunk has been deleted.
+ *
+ * @param table The table.
+ * @param rows The number of deleted rows, or -1 if the chunk couldn't be deleted.
+ */
+void DbConnection::FinishCleanUpChunk(const String& table, int rows)
+{
+	boost::mutex::scoped_lock lock(m_CleanUpMutex);
+
+	m_CleanUpChunkPending = false;
+
+	if (rows < 0)
+		return;
+
+	m_CleanUpStats.InsertValue(Utility::GetTime(), rows);
+
+	/* Fewer rows than requested means there are no old rows left. */
+	if (rows < GetCleanupChunkSize() && !m_CleanUpTasks.empty() && m_CleanUpTasks.front().Table == table) {
+		m_CleanUpTasks.pop_front();
+
+		Log(LogNotice, "DbConnection")
+			<< "Finished cleanup of table '" << table << "' for '" << GetName() << "'.";
+	}
+}
+
 void DbConnection::CleanUpExecuteQuery(const String&, const String&, double)
 {
 	/* Default handler does nothing. */
 }
 
+void DbConnection::CleanUpExecuteChunk(const String& table, const String&, double, int)
+{
+	/* Default handler does nothing. */
+	FinishCleanUpChunk(table, 0);
+}
+
+/**
+ * Returns the number of rows which were deleted by chunked cleanups.
+ *
+ * @param span The time span in seconds.
+ */
+int DbConnection::GetCleanUpRowCount(RingBuffer::SizeType span)
+{
+	boost::mutex::scoped_lock lock(m_CleanUpMutex);
+	return m_CleanUpStats.UpdateAndGetValues(Utility::GetTime(), span);
+}
+
+/**
+ * Returns the number of tables whose chunked cleanup hasn't finished yet.
+ */
+size_t DbConnection::GetCleanUpPendingTables()
+{
+	boost::mutex::scoped_lock lock(m_CleanUpMutex);
+	return m_CleanUpTasks.size();
+}
+
 void DbConnection::SetConfigHash(const DbObject::Ptr& dbobj, const String& hash)
 {
 	SetConfigHash(dbobj->GetType(), GetObjectID(dbobj), hash);
@@ -355,6 +458,7 @@ bool DbConnection::GetObjectActive(const DbObject::Ptr& dbobj) const
 void DbConnection::ClearIDCache()
 {
 	SetIDCacheValid(false);
+	m_IDCacheTypes.clear();
 
 	m_ObjectIDs.clear();
 	m_InsertIDs.clear();
@@ -435,16 +539,32 @@ void DbConnection::UpdateAllObjects()
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
 			UpdateObject(object);
 		}
 	}
 }
 
+/**
+ * Updates the objects whose type matches the database object type.
+ */
+void DbConnection::UpdateObjectsByType(const DbType::Ptr& type)
+{
+	auto *dtype = dynamic_cast<ConfigType *>(Type::GetByName(type->GetName()).get());
+
+	if (!dtype)
+		return;
+
+	for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
+		UpdateObject(object);
+	}
+}
+
 void DbConnection::PrepareDatabase()
 {
 	for (const DbType::Ptr& type : DbType::GetAllTypes()) {
 		FillIDCache(type);
+		SetIDCacheValid(type);
 	}
 }
 
@@ -456,6 +576,22 @@ void DbConnection::ValidateFailoverTimeout(const Lazy<double>& lvalue, const Val
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "failover_timeout" }, "Failover timeout minimum is 60s."));
 }
 
+void DbConnection::ValidateCleanupChunkSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<DbConnection>::ValidateCleanupChunkSize(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "cleanup_chunk_size" }, "Cleanup chunk size must not be negative."));
+}
+
+void DbConnection::ValidateCleanupChunkInterval(const Lazy<double>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<DbConnection>::ValidateCleanupChunkInterval(lvalue, utils);
+
+	if (lvalue() <= 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "cleanup_chunk_interval" }, "Cleanup chunk interval must be greater than 0."));
+}
+
 void DbConnection::ValidateCategories(const Lazy<Array::Ptr>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<DbConnection>::ValidateCategories(lvalue, utils);
@@ -483,6 +619,57 @@ int DbConnection::GetQueryCount(RingBuffer::SizeType span)
 	return m_QueryStats.UpdateAndGetValues(Utility::GetTime(), span);
 }
 
+/**
+ * Checks whether a newer version of a query may replace the queued one.
+ * This is the case for status updates, which are upserts of a whole row.
+ */
+bool DbConnection::CanCoalesceQuery(const DbQuery& query)
+{
+	return query.StatusUpdate && query.Object && query.Type == (DbQueryInsert | DbQueryUpdate);
+}
+
+/**
+ * Remembers the latest status update for an object and table.
+ *
+ * @param query The status update.
+ * @returns true if a task needs to be queued for the update, false if it
+ *          replaced an update which is still waiting in the queue.
+ */
+bool DbConnection::QueueStatusUpdate(const DbQuery& query)
+{
+	boost::mutex::scoped_lock lock(m_StatusUpdatesMutex);
+
+	auto key = std::make_pair(query.Object, query.Table);
+	auto it = m_QueuedStatusUpdates.find(key);
+
+	if (it != m_QueuedStatusUpdates.end()) {
+		it->second = query;
+		return false;
+	}
+
+	m_QueuedStatusUpdates.emplace(std::move(key), query);
+	return true;
+}
+
+/**
+ * Retrieves and forgets the latest status update for an object and table.
+ *
+ * @returns true if there was a status update, false otherwise.
+ */
+bool DbConnection::TakeStatusUpdate(const DbObject::Ptr& dbobj, const String& table, DbQuery *query)
+{
+	boost::mutex::scoped_lock lock(m_StatusUpdatesMutex);
+
+	auto it = m_QueuedStatusUpdates.find(std::make_pair(dbobj, table));
+
+	if (it == m_QueuedStatusUpdates.end())
+		return false;
+
+	*query = std::move(it->second);
+	m_QueuedStatusUpdates.erase(it);
+	return true;
+}
+
 bool DbConnection::IsIDCacheValid() const
 {
 	return m_IDCacheValid;
@@ -493,6 +680,19 @@ void DbConnection::SetIDCacheValid(bool valid)
 	m_IDCacheValid = valid;
 }
 
+/**
+ * Checks whether the insert IDs and config hashes for a type have been loaded.
+ */
+bool DbConnection::IsIDCacheValid(const DbType::Ptr& type) const
+{
+	return m_IDCacheTypes.find(type) != m_IDCacheTypes.end();
+}
+
+void DbConnection::SetIDCacheValid(const DbType::Ptr& type)
+{
+	m_IDCacheTypes.insert(type);
+}
+
 int DbConnection::GetSessionToken()
 {
 	return Application::GetStartTime();
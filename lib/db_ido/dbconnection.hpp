@@ -28,6 +28,7 @@
 #include "base/ringbuffer.hpp"
 #include <boost/thread/once.hpp>
 #include <boost/thread/mutex.hpp>
+#include <deque>
 
 #define IDO_CURRENT_SCHEMA_VERSION "1.14.3"
 #define IDO_COMPAT_SCHEMA_VERSION "1.14.3"
@@ -35,6 +36,18 @@
 namespace icinga
 {
 
+/**
+ * A history table which is cleaned up in chunks.
+ *
+ * @ingroup db_ido
+ */
+struct DbCleanUpTask
+{
+	String Table;
+	String TimeColumn;
+	double MaxAge;
+};
+
 /**
  * A database connection.
  *
@@ -74,7 +87,12 @@ public:
 	int GetQueryCount(RingBuffer::SizeType span);
 	virtual int GetPendingQueryCount() const = 0;
 
+	int GetCleanUpRowCount(RingBuffer::SizeType span);
+	size_t GetCleanUpPendingTables();
+
 	void ValidateFailoverTimeout(const Lazy<double>& lvalue, const ValidationUtils& utils) final;
+	void ValidateCleanupChunkSize(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+	void ValidateCleanupChunkInterval(const Lazy<double>& lvalue, const ValidationUtils& utils) final;
 	void ValidateCategories(const Lazy<Array::Ptr>& lvalue, const ValidationUtils& utils) final;
 
 protected:
@@ -90,11 +108,14 @@ protected:
 	virtual void DeactivateObject(const DbObject::Ptr& dbobj) = 0;
 
 	virtual void CleanUpExecuteQuery(const String& table, const String& time_column, double max_age);
+	virtual void CleanUpExecuteChunk(const String& table, const String& time_column, double max_age, int limit);
+	void FinishCleanUpChunk(const String& table, int rows);
 	virtual void FillIDCache(const DbType::Ptr& type) = 0;
 	virtual void NewTransaction() = 0;
 
 	void UpdateObject(const ConfigObject::Ptr& object);
 	void UpdateAllObjects();
+	void UpdateObjectsByType(const DbType::Ptr& type);
 
 	void PrepareDatabase();
 
@@ -102,6 +123,12 @@ protected:
 
 	bool IsIDCacheValid() const;
 	void SetIDCacheValid(bool valid);
+	bool IsIDCacheValid(const DbType::Ptr& type) const;
+	void SetIDCacheValid(const DbType::Ptr& type);
+
+	static bool CanCoalesceQuery(const DbQuery& query);
+	bool QueueStatusUpdate(const DbQuery& query);
+	bool TakeStatusUpdate(const DbObject::Ptr& dbobj, const String& table, DbQuery *query);
 
 	void EnableActiveChangedHandler();
 
@@ -111,6 +138,7 @@ protected:
 
 private:
 	bool m_IDCacheValid{false};
+	std::set<DbType::Ptr> m_IDCacheTypes;
 	std::map<std::pair<DbType::Ptr, DbReference>, String> m_ConfigHashes;
 	std::map<DbObject::Ptr, DbReference> m_ObjectIDs;
 	std::map<std::pair<DbType::Ptr, DbReference>, DbReference> m_InsertIDs;
@@ -118,8 +146,15 @@ private:
 	std::set<DbObject::Ptr> m_ConfigUpdates;
 	std::set<DbObject::Ptr> m_StatusUpdates;
 	Timer::Ptr m_CleanUpTimer;
+	Timer::Ptr m_CleanUpChunkTimer;
+
+	boost::mutex m_CleanUpMutex;
+	std::deque<DbCleanUpTask> m_CleanUpTasks;
+	bool m_CleanUpChunkPending{false};
+	RingBuffer m_CleanUpStats{15 * 60};
 
 	void CleanUpHandler();
+	void CleanUpChunkTimerHandler();
 
 	static Timer::Ptr m_ProgramStatusTimer;
 	static boost::once_flag m_OnceFlag;
@@ -128,6 +163,9 @@ private:
 
 	mutable boost::mutex m_StatsMutex;
 	RingBuffer m_QueryStats{15 * 60};
+
+	boost::mutex m_StatusUpdatesMutex;
+	std::map<std::pair<DbObject::Ptr, String>, DbQuery> m_QueuedStatusUpdates;
 	bool m_ActiveChangedHandler{false};
 };
 
@@ -200,6 +200,10 @@ void DbEvents::ReachabilityChangedHandler(const Checkable::Ptr& checkable, const
 	Log(LogDebug, "DbEvents")
 		<< "Updating reachability for checkable '" << checkable->GetName() << "': " << (is_reachable ? "" : "not" ) << " reachable for " << children.size() << " children.";
 
+	/* Send the updates for all children as one batch. */
+	std::vector<DbQuery> queries;
+	queries.reserve(children.size());
+
 	for (const Checkable::Ptr& child : children) {
 		Log(LogDebug, "DbEvents")
 			<< "Updating reachability for checkable '" << child->GetName() << "': " << (is_reachable ? "" : "not" ) << " reachable.";
@@ -230,8 +234,10 @@ void DbEvents::ReachabilityChangedHandler(const Checkable::Ptr& checkable, const
 
 		query1.WhereCriteria->Set("instance_id", 0); /* DbConnection class fills in real ID */
 
-		DbObject::OnQuery(query1);
+		queries.emplace_back(std::move(query1));
 	}
+
+	DbObject::OnMultipleQueries(queries);
 }
 
 /* enable changed events */
@@ -91,18 +91,21 @@ Dictionary::Ptr HostDbObject::GetConfigFields() const
 
 Dictionary::Ptr HostDbObject::GetStatusFields() const
 {
-	Dictionary::Ptr fields = new Dictionary();
+	/* Collect the columns first, so the dictionary only has to be sorted once. */
+	DictionaryData fields;
+	fields.reserve(48);
+
 	Host::Ptr host = static_pointer_cast<Host>(GetObject());
 
 	CheckResult::Ptr cr = host->GetLastCheckResult();
 
 	if (cr) {
-		fields->Set("output", CompatUtility::GetCheckResultOutput(cr));
-		fields->Set("long_output", CompatUtility::GetCheckResultLongOutput(cr));
-		fields->Set("perfdata", PluginUtility::FormatPerfdata(cr->GetPerformanceData()));
-		fields->Set("check_source", cr->GetCheckSource());
-		fields->Set("latency", cr->CalculateLatency());
-		fields->Set("execution_time", cr->CalculateExecutionTime());
+		fields.emplace_back("output", CompatUtility::GetCheckResultOutput(cr));
+		fields.emplace_back("long_output", CompatUtility::GetCheckResultLongOutput(cr));
+		fields.emplace_back("perfdata", PluginUtility::FormatPerfdata(cr->GetPerformanceData()));
+		fields.emplace_back("check_source", cr->GetCheckSource());
+		fields.emplace_back("latency", cr->CalculateLatency());
+		fields.emplace_back("execution_time", cr->CalculateExecutionTime());
 	}
 
 	int currentState = host->GetState();
@@ -110,53 +113,53 @@ Dictionary::Ptr HostDbObject::GetStatusFields() const
 	if (currentState != HostUp && !host->IsReachable())
 		currentState = 2; /* hardcoded compat state */
 
-	fields->Set("current_state", currentState);
-	fields->Set("has_been_checked", host->HasBeenChecked());
-	fields->Set("should_be_scheduled", host->GetEnableActiveChecks());
-	fields->Set("current_check_attempt", host->GetCheckAttempt());
-	fields->Set("max_check_attempts", host->GetMaxCheckAttempts());
-	fields->Set("last_check", DbValue::FromTimestamp(host->GetLastCheck()));
-	fields->Set("next_check", DbValue::FromTimestamp(host->GetNextCheck()));
-	fields->Set("check_type", !host->GetEnableActiveChecks()); /* 0 .. active, 1 .. passive */
-	fields->Set("last_state_change", DbValue::FromTimestamp(host->GetLastStateChange()));
-	fields->Set("last_hard_state_change", DbValue::FromTimestamp(host->GetLastHardStateChange()));
-	fields->Set("last_hard_state", host->GetLastHardState());
-	fields->Set("last_time_up", DbValue::FromTimestamp(host->GetLastStateUp()));
-	fields->Set("last_time_down", DbValue::FromTimestamp(host->GetLastStateDown()));
-	fields->Set("last_time_unreachable", DbValue::FromTimestamp(host->GetLastStateUnreachable()));
-	fields->Set("state_type", host->GetStateType());
-	fields->Set("notifications_enabled", host->GetEnableNotifications());
-	fields->Set("problem_has_been_acknowledged", host->GetAcknowledgement() != AcknowledgementNone);
-	fields->Set("acknowledgement_type", host->GetAcknowledgement());
-	fields->Set("passive_checks_enabled", host->GetEnablePassiveChecks());
-	fields->Set("active_checks_enabled", host->GetEnableActiveChecks());
-	fields->Set("event_handler_enabled", host->GetEnableEventHandler());
-	fields->Set("flap_detection_enabled", host->GetEnableFlapping());
-	fields->Set("is_flapping", host->IsFlapping());
-	fields->Set("percent_state_change", host->GetFlappingCurrent());
-	fields->Set("scheduled_downtime_depth", host->GetDowntimeDepth());
-	fields->Set("process_performance_data", host->GetEnablePerfdata());
-	fields->Set("normal_check_interval", host->GetCheckInterval() / 60.0);
-	fields->Set("retry_check_interval", host->GetRetryInterval() / 60.0);
-	fields->Set("check_timeperiod_object_id", host->GetCheckPeriod());
-	fields->Set("is_reachable", host->IsReachable());
-	fields->Set("original_attributes", JsonEncode(host->GetOriginalAttributes()));
-
-	fields->Set("current_notification_number", CompatUtility::GetCheckableNotificationNotificationNumber(host));
-	fields->Set("last_notification", DbValue::FromTimestamp(CompatUtility::GetCheckableNotificationLastNotification(host)));
-	fields->Set("next_notification", DbValue::FromTimestamp(CompatUtility::GetCheckableNotificationNextNotification(host)));
+	fields.emplace_back("current_state", currentState);
+	fields.emplace_back("has_been_checked", host->HasBeenChecked());
+	fields.emplace_back("should_be_scheduled", host->GetEnableActiveChecks());
+	fields.emplace_back("current_check_attempt", host->GetCheckAttempt());
+	fields.emplace_back("max_check_attempts", host->GetMaxCheckAttempts());
+	fields.emplace_back("last_check", DbValue::FromTimestamp(host->GetLastCheck()));
+	fields.emplace_back("next_check", DbValue::FromTimestamp(host->GetNextCheck()));
+	fields.emplace_back("check_type", !host->GetEnableActiveChecks()); /* 0 .. active, 1 .. passive */
+	fields.emplace_back("last_state_change", DbValue::FromTimestamp(host->GetLastStateChange()));
+	fields.emplace_back("last_hard_state_change", DbValue::FromTimestamp(host->GetLastHardStateChange()));
+	fields.emplace_back("last_hard_state", host->GetLastHardState());
+	fields.emplace_back("last_time_up", DbValue::FromTimestamp(host->GetLastStateUp()));
+	fields.emplace_back("last_time_down", DbValue::FromTimestamp(host->GetLastStateDown()));
+	fields.emplace_back("last_time_unreachable", DbValue::FromTimestamp(host->GetLastStateUnreachable()));
+	fields.emplace_back("state_type", host->GetStateType());
+	fields.emplace_back("notifications_enabled", host->GetEnableNotifications());
+	fields.emplace_back("problem_has_been_acknowledged", host->GetAcknowledgement() != AcknowledgementNone);
+	fields.emplace_back("acknowledgement_type", host->GetAcknowledgement());
+	fields.emplace_back("passive_checks_enabled", host->GetEnablePassiveChecks());
+	fields.emplace_back("active_checks_enabled", host->GetEnableActiveChecks());
+	fields.emplace_back("event_handler_enabled", host->GetEnableEventHandler());
+	fields.emplace_back("flap_detection_enabled", host->GetEnableFlapping());
+	fields.emplace_back("is_flapping", host->IsFlapping());
+	fields.emplace_back("percent_state_change", host->GetFlappingCurrent());
+	fields.emplace_back("scheduled_downtime_depth", host->GetDowntimeDepth());
+	fields.emplace_back("process_performance_data", host->GetEnablePerfdata());
+	fields.emplace_back("normal_check_interval", host->GetCheckInterval() / 60.0);
+	fields.emplace_back("retry_check_interval", host->GetRetryInterval() / 60.0);
+	fields.emplace_back("check_timeperiod_object_id", host->GetCheckPeriod());
+	fields.emplace_back("is_reachable", host->IsReachable());
+	fields.emplace_back("original_attributes", JsonEncode(host->GetOriginalAttributes()));
+
+	fields.emplace_back("current_notification_number", CompatUtility::GetCheckableNotificationNotificationNumber(host));
+	fields.emplace_back("last_notification", DbValue::FromTimestamp(CompatUtility::GetCheckableNotificationLastNotification(host)));
+	fields.emplace_back("next_notification", DbValue::FromTimestamp(CompatUtility::GetCheckableNotificationNextNotification(host)));
 
 	EventCommand::Ptr eventCommand = host->GetEventCommand();
 
 	if (eventCommand)
-		fields->Set("event_handler", eventCommand->GetName());
+		fields.emplace_back("event_handler", eventCommand->GetName());
 
 	CheckCommand::Ptr checkCommand = host->GetCheckCommand();
 
 	if (checkCommand)
-		fields->Set("check_command", checkCommand->GetName());
+		fields.emplace_back("check_command", checkCommand->GetName());
 
-	return fields;
+	return new Dictionary(std::move(fields));
 }
 
 void HostDbObject::OnConfigUpdateHeavy()
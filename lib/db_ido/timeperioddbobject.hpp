@@ -43,6 +43,8 @@ protected:
 	Dictionary::Ptr GetStatusFields() const override;
 
 	void OnConfigUpdateHeavy() override;
+
+	String CalculateConfigHash(const Dictionary::Ptr& configFields) const override;
 };
 
 }
@@ -38,6 +38,9 @@ using namespace icinga;
 REGISTER_TYPE(IdoMysqlConnection);
 REGISTER_STATSFUNCTION(IdoMysqlConnection, &IdoMysqlConnection::StatsFunc);
 
+/* Maximum number of sessions which load the ID cache in parallel. */
+static const size_t l_IDCacheLoaders = 4;
+
 void IdoMysqlConnection::OnConfigLoaded()
 {
 	ObjectImpl<IdoMysqlConnection>::OnConfigLoaded();
@@ -57,16 +60,19 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 {
 	DictionaryData nodes;
 
-	for (const IdoMysqlConnection::Ptr& idomysqlconnection : ConfigType::GetObjectsByType<IdoMysqlConnection>()) {
+	for (const IdoMysqlConnection::Ptr& idomysqlconnection : ConfigType::GetObjectViewByType<IdoMysqlConnection>()) {
 		size_t queryQueueItems = idomysqlconnection->m_QueryQueue.GetLength();
 		double queryQueueItemRate = idomysqlconnection->m_QueryQueue.GetTaskCount(60) / 60.0;
+		double batchRowsPerStatement = idomysqlconnection->GetBatchRowsPerStatement(60);
 
 		nodes.emplace_back(idomysqlconnection->GetName(), new Dictionary({
 			{ "version", idomysqlconnection->GetSchemaVersion() },
 			{ "instance_name", idomysqlconnection->GetInstanceName() },
 			{ "connected", idomysqlconnection->GetConnected() },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "batch_rows_per_statement", batchRowsPerStatement },
+			{ "cleanup_pending_tables", idomysqlconnection->GetCleanUpPendingTables() }
 		}));
 
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_queries_rate", idomysqlconnection->GetQueryCount(60) / 60.0));
@@ -75,11 +81,50 @@ void IdoMysqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_queries_15mins", idomysqlconnection->GetQueryCount(15 * 60)));
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_items", queryQueueItems));
 		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_query_queue_item_rate", queryQueueItemRate));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_batch_rows_per_statement", batchRowsPerStatement));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_cleanup_rows_1min", idomysqlconnection->GetCleanUpRowCount(60)));
+		perfdata->Add(new PerfdataValue("idomysqlconnection_" + idomysqlconnection->GetName() + "_cleanup_pending_tables", idomysqlconnection->GetCleanUpPendingTables()));
 	}
 
 	status->Set("idomysqlconnection", new Dictionary(std::move(nodes)));
 }
 
+/**
+ * Returns the average number of rows per multi-row statement.
+ *
+ * @param span The time span in seconds.
+ * @returns The number of rows, or 0 if no multi-row statements were sent.
+ */
+double IdoMysqlConnection::GetBatchRowsPerStatement(RingBuffer::SizeType span)
+{
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_BatchStatsMutex);
+
+	int statements = m_BatchStatementStats.UpdateAndGetValues(now, span);
+
+	if (statements == 0)
+		return 0;
+
+	return m_BatchRowStats.UpdateAndGetValues(now, span) / static_cast<double>(statements);
+}
+
+void IdoMysqlConnection::ValidateBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IdoMysqlConnection>::ValidateBatchSize(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "batch_size" }, "Batch size must be at least 1."));
+}
+
+void IdoMysqlConnection::ValidateHistoryConnections(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IdoMysqlConnection>::ValidateHistoryConnections(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "history_connections" }, "Number of history connections must not be negative."));
+}
+
 void IdoMysqlConnection::Resume()
 {
 	DbConnection::Resume();
@@ -91,6 +136,13 @@ void IdoMysqlConnection::Resume()
 
 	m_QueryQueue.SetExceptionCallback(std::bind(&IdoMysqlConnection::ExceptionHandler, this, _1));
 
+	for (int i = 0; i < GetHistoryConnections(); i++) {
+		m_Writers.emplace_back(new IdoMysqlWriter(this, m_Mysql.get(), i + 1));
+	}
+
+	if (GetCleanupChunkSize() > 0)
+		m_CleanUpWriter = new IdoMysqlWriter(this, m_Mysql.get(), 0);
+
 	m_TxTimer = new Timer();
 	m_TxTimer->SetInterval(1);
 	m_TxTimer->OnTimerExpired.connect(std::bind(&IdoMysqlConnection::TxTimerHandler, this));
@@ -98,6 +150,7 @@ void IdoMysqlConnection::Resume()
 
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
+	m_ReconnectTimer->SetSlack(1);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&IdoMysqlConnection::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
@@ -121,6 +174,23 @@ void IdoMysqlConnection::Pause()
 
 	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::Disconnect, this), PriorityHigh);
 	m_QueryQueue.Join();
+
+	/* Neither the main queue nor the transaction timer use the writers anymore. */
+	if (m_TxTimer)
+		m_TxTimer->Stop(true);
+
+	for (const IdoMysqlWriter::Ptr& writer : m_Writers) {
+		writer->Stop();
+	}
+
+	m_Writers.clear();
+
+	StopIDCacheLoaders();
+
+	if (m_CleanUpWriter) {
+		m_CleanUpWriter->Stop();
+		m_CleanUpWriter.reset();
+	}
 }
 
 void IdoMysqlConnection::ExceptionHandler(boost::exception_ptr exp)
@@ -158,6 +228,10 @@ void IdoMysqlConnection::Disconnect()
 void IdoMysqlConnection::TxTimerHandler()
 {
 	NewTransaction();
+
+	for (const IdoMysqlWriter::Ptr& writer : m_Writers) {
+		writer->Flush();
+	}
 }
 
 void IdoMysqlConnection::NewTransaction()
@@ -403,9 +477,6 @@ void IdoMysqlConnection::Reconnect()
 		+ Convert::ToString(static_cast<long>(m_InstanceID)) + ", NOW(), NOW(), 'icinga2 db_ido_mysql', '" + Escape(Application::GetAppVersion())
 		+ "', '" + (reconnect ? "RECONNECT" : "INITIAL") + "', NOW())");
 
-	/* clear config tables for the initial config dump */
-	PrepareDatabase();
-
 	std::ostringstream q1buf;
 	q1buf << "SELECT object_id, objecttype_id, name1, name2, is_active FROM " + GetTablePrefix() + "objects WHERE instance_id = " << static_cast<long>(m_InstanceID);
 	result = Query(q1buf.str());
@@ -441,16 +512,88 @@ void IdoMysqlConnection::Reconnect()
 		DeactivateObject(dbobj);
 	}
 
-	UpdateAllObjects();
-
 #ifdef I2_DEBUG /* I2_DEBUG */
 	Log(LogDebug, "IdoMysqlConnection")
-		<< "Scheduling session table clear and finish connect task.";
+		<< "Scheduling session table clear task.";
 #endif /* I2_DEBUG */
 
 	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::ClearTablesBySession, this), PriorityLow);
 
-	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::FinishConnect, this, startTime), PriorityLow);
+	LoadIDCaches(startTime);
+}
+
+/**
+ * Loads the insert IDs and config hashes for all types in parallel on
+ * separate sessions. The objects of a type are updated as soon as its
+ * cache has been loaded, other queries for the type are deferred until then.
+ */
+void IdoMysqlConnection::LoadIDCaches(double startTime)
+{
+	AssertOnWorkQueue();
+
+	StopIDCacheLoaders();
+
+	int generation = ++m_IDCacheGeneration;
+
+	std::set<DbType::Ptr> types = DbType::GetAllTypes();
+	m_IDCachePendingTypes = types.size();
+
+	if (types.empty()) {
+		m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::FinishConnect, this, startTime), PriorityLow);
+		return;
+	}
+
+	for (size_t i = 0; i < std::min(types.size(), l_IDCacheLoaders); i++) {
+		m_IDCacheLoaders.emplace_back(new IdoMysqlWriter(this, m_Mysql.get(), GetHistoryConnections() + i + 1));
+	}
+
+	size_t index = 0;
+
+	for (const DbType::Ptr& type : types) {
+		String query = "SELECT " + type->GetIDColumn() + ", " + type->GetTable() + "_id, config_hash FROM " + GetTablePrefix() + type->GetTable() + "s";
+
+		m_IDCacheLoaders[index++ % m_IDCacheLoaders.size()]->Select(query, [this, generation, type, startTime](bool success, IdoMysqlRows&& rows) {
+			auto data = std::make_shared<IdoMysqlRows>(std::move(rows));
+			m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::FinishIDCache, this, generation, type, success, data, startTime), PriorityHigh);
+		});
+	}
+}
+
+void IdoMysqlConnection::FinishIDCache(int generation, const DbType::Ptr& type, bool success, const std::shared_ptr<IdoMysqlRows>& rows, double startTime)
+{
+	AssertOnWorkQueue();
+
+	/* The connection was lost or re-established in the meantime. */
+	if (generation != m_IDCacheGeneration || !GetConnected())
+		return;
+
+	if (success) {
+		for (const std::vector<String>& row : *rows) {
+			DbReference dbref(Convert::ToLong(row[0]));
+			SetInsertID(type, dbref, DbReference(Convert::ToLong(row[1])));
+			SetConfigHash(type, dbref, row[2]);
+		}
+	} else
+		FillIDCache(type);
+
+	SetIDCacheValid(type);
+
+	UpdateObjectsByType(type);
+
+	if (--m_IDCachePendingTypes == 0) {
+		StopIDCacheLoaders();
+
+		m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::FinishConnect, this, startTime), PriorityLow);
+	}
+}
+
+void IdoMysqlConnection::StopIDCacheLoaders()
+{
+	for (const IdoMysqlWriter::Ptr& loader : m_IDCacheLoaders) {
+		loader->Stop();
+	}
+
+	m_IDCacheLoaders.clear();
 }
 
 void IdoMysqlConnection::FinishConnect(double startTime)
@@ -483,16 +626,88 @@ void IdoMysqlConnection::ClearTableBySession(const String& table)
 		Convert::ToString(GetSessionToken()));
 }
 
-void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<void (const IdoMysqlResult&)>& callback)
+void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<void (const IdoMysqlResult&)>& callback, const String& table)
 {
 	AssertOnWorkQueue();
 
+	/* Rows must not be moved in front of this query. */
+	CloseAsyncBatches(table);
+
 	IdoAsyncQuery aq;
 	aq.Query = query;
 	/* XXX: Important: The callback must not immediately execute a query, but enqueue it!
 	 * See https://github.com/Icinga/icinga2/issues/4603 for details.
 	 */
 	aq.Callback = callback;
+	AddAsyncQuery(std::move(aq));
+}
+
+/**
+ * Adds a row to a multi-row INSERT statement for the table and columns.
+ * Upserts use ON DUPLICATE KEY UPDATE and therefore require a unique key.
+ */
+void IdoMysqlConnection::AsyncBatchQuery(const String& table, const std::vector<String>& columns, const String& values,
+	bool upsert, const IdoAsyncCallback& callback)
+{
+	AssertOnWorkQueue();
+
+	std::ostringstream prefixbuf, suffixbuf;
+	prefixbuf << "INSERT INTO " << GetTablePrefix() << table << " (";
+
+	bool first = true;
+	for (const String& column : columns) {
+		if (!first) {
+			prefixbuf << ", ";
+			suffixbuf << ", ";
+		}
+
+		prefixbuf << column;
+		suffixbuf << column << " = VALUES(" << column << ")";
+
+		first = false;
+	}
+
+	prefixbuf << ") VALUES ";
+
+	String prefix = prefixbuf.str();
+	String suffix = upsert ? " ON DUPLICATE KEY UPDATE " + suffixbuf.str() : "";
+	String row = "(" + values + ")";
+
+	String key = prefix + suffix;
+	auto it = m_AsyncBatches.find(key);
+
+	if (it != m_AsyncBatches.end()) {
+		IdoAsyncBatch& batch = it->second;
+		IdoAsyncQuery& aq = m_AsyncQueries[batch.Index];
+
+		if (aq.Rows.size() < static_cast<size_t>(GetBatchSize()) && batch.Length + row.GetLength() + 2 < m_MaxPacketSize / 2) {
+			batch.Length += row.GetLength() + 2;
+			aq.Rows.emplace_back(std::move(row));
+			aq.RowCallbacks.push_back(callback);
+			return;
+		}
+
+		m_AsyncBatches.erase(it);
+	}
+
+	IdoAsyncQuery aq;
+	aq.Query = prefix;
+	aq.Suffix = suffix;
+	aq.Rows.push_back(row);
+	aq.RowCallbacks.push_back(callback);
+
+	IdoAsyncBatch batch;
+	batch.Table = table;
+	batch.Index = m_AsyncQueries.size();
+	batch.Length = prefix.GetLength() + suffix.GetLength() + row.GetLength();
+
+	m_AsyncBatches[key] = batch;
+
+	AddAsyncQuery(std::move(aq));
+}
+
+void IdoMysqlConnection::AddAsyncQuery(IdoAsyncQuery&& aq)
+{
 	m_AsyncQueries.emplace_back(std::move(aq));
 
 	if (m_AsyncQueries.size() > 25000) {
@@ -501,10 +716,64 @@ void IdoMysqlConnection::AsyncQuery(const String& query, const std::function<voi
 	}
 }
 
+/**
+ * Stops adding rows to the multi-row statements for a table.
+ *
+ * @param table The table, or an empty string for all tables.
+ */
+void IdoMysqlConnection::CloseAsyncBatches(const String& table)
+{
+	if (table.IsEmpty()) {
+		m_AsyncBatches.clear();
+		return;
+	}
+
+	for (auto it = m_AsyncBatches.begin(); it != m_AsyncBatches.end(); ) {
+		if (it->second.Table == table)
+			it = m_AsyncBatches.erase(it);
+		else
+			++it;
+	}
+}
+
 void IdoMysqlConnection::FinishAsyncQueries()
 {
 	std::vector<IdoAsyncQuery> queries;
 	m_AsyncQueries.swap(queries);
+	m_AsyncBatches.clear();
+
+	int batchRows = 0, batchStatements = 0;
+
+	for (IdoAsyncQuery& aq : queries) {
+		if (aq.Rows.empty())
+			continue;
+
+		std::ostringstream querybuf;
+		querybuf << aq.Query;
+
+		bool first = true;
+		for (const String& row : aq.Rows) {
+			if (!first)
+				querybuf << ", ";
+
+			querybuf << row;
+			first = false;
+		}
+
+		querybuf << aq.Suffix;
+		aq.Query = querybuf.str();
+
+		batchRows += aq.Rows.size();
+		batchStatements++;
+	}
+
+	if (batchStatements > 0) {
+		double now = Utility::GetTime();
+
+		boost::mutex::scoped_lock lock(m_BatchStatsMutex);
+		m_BatchRowStats.InsertValue(now, batchRows);
+		m_BatchStatementStats.InsertValue(now, batchStatements);
+	}
 
 	std::vector<IdoAsyncQuery>::size_type offset = 0;
 
@@ -578,6 +847,11 @@ void IdoMysqlConnection::FinishAsyncQueries()
 			if (aq.Callback)
 				aq.Callback(iresult);
 
+			for (const IdoAsyncCallback& callback : aq.RowCallbacks) {
+				if (callback)
+					callback(iresult);
+			}
+
 			if (m_Mysql->next_result(&m_Connection) > 0) {
 				std::ostringstream msgbuf;
 				String message = m_Mysql->error(&m_Connection);
@@ -666,13 +940,11 @@ String IdoMysqlConnection::Escape(const String& s)
 	String utf8s = Utility::ValidateUTF8(s);
 
 	size_t length = utf8s.GetLength();
-	auto *to = new char[utf8s.GetLength() * 2 + 1];
-
-	m_Mysql->real_escape_string(&m_Connection, to, utf8s.CStr(), length);
-
-	String result = String(to);
 
-	delete [] to;
+	/* Escape into the result, which is shrunk to the escaped length afterwards. */
+	String result;
+	result.GetData().resize(length * 2 + 1);
+	result.GetData().resize(m_Mysql->real_escape_string(&m_Connection, &result.GetData()[0], utf8s.CStr(), length));
 
 	return result;
 }
@@ -807,6 +1079,9 @@ bool IdoMysqlConnection::FieldToEscapedString(const String& key, const Value& va
 		DbReference dbrefcol;
 
 		if (DbValue::IsObjectInsertID(value)) {
+			if (!IsIDCacheValid(dbobjcol->GetType()))
+				return false;
+
 			dbrefcol = GetInsertID(dbobjcol);
 
 			if (!dbrefcol.IsValid())
@@ -826,10 +1101,13 @@ bool IdoMysqlConnection::FieldToEscapedString(const String& key, const Value& va
 
 		*result = static_cast<long>(dbrefcol);
 	} else if (DbValue::IsTimestamp(value)) {
-		long ts = rawvalue;
-		std::ostringstream msgbuf;
-		msgbuf << "FROM_UNIXTIME(" << ts << ")";
-		*result = Value(msgbuf.str());
+		char buf[Convert::FormatBufferSize];
+		size_t len = Convert::FormatInteger(static_cast<long>(rawvalue), buf);
+
+		String ts = "FROM_UNIXTIME(";
+		ts.GetData().append(buf, len);
+		ts += ")";
+		*result = std::move(ts);
 	} else if (DbValue::IsTimestampNow(value)) {
 		*result = "NOW()";
 	} else if (DbValue::IsObjectInsertID(value)) {
@@ -840,16 +1118,13 @@ bool IdoMysqlConnection::FieldToEscapedString(const String& key, const Value& va
 
 		*result = id;
 		return true;
-	} else {
-		Value fvalue;
-
-		if (rawvalue.IsBoolean())
-			fvalue = Convert::ToLong(rawvalue);
-		else
-			fvalue = rawvalue;
-
-		*result = "'" + Escape(fvalue) + "'";
-	}
+	} else if (rawvalue.IsBoolean()) {
+		*result = rawvalue.ToBool() ? "'1'" : "'0'";
+	} else if (rawvalue.IsNumber()) {
+		/* Numbers don't need to be escaped. */
+		*result = "'" + Convert::ToString(rawvalue.Get<double>()) + "'";
+	} else
+		*result = "'" + Escape(rawvalue) + "'";
 
 	return true;
 }
@@ -863,9 +1138,24 @@ void IdoMysqlConnection::ExecuteQuery(const DbQuery& query)
 		<< "Scheduling execute query task, type " << query.Type << ", table '" << query.Table << "'.";
 #endif /* I2_DEBUG */
 
+	if (CanCoalesceQuery(query)) {
+		if (QueueStatusUpdate(query))
+			m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteStatusUpdate, this, query.Object, query.Table), query.Priority, true);
+
+		return;
+	}
+
 	m_QueryQueue.Enqueue(std::bind(&IdoMysqlConnection::InternalExecuteQuery, this, query, -1), query.Priority, true);
 }
 
+void IdoMysqlConnection::InternalExecuteStatusUpdate(const DbObject::Ptr& dbobj, const String& table)
+{
+	DbQuery query;
+
+	if (TakeStatusUpdate(dbobj, table, &query))
+		InternalExecuteQuery(query);
+}
+
 void IdoMysqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& queries)
 {
 	if (queries.empty())
@@ -881,7 +1171,7 @@ void IdoMysqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& quer
 
 bool IdoMysqlConnection::CanExecuteQuery(const DbQuery& query)
 {
-	if (query.Object && !IsIDCacheValid())
+	if (query.Object && (!IsIDCacheValid() || !IsIDCacheValid(query.Object->GetType())))
 		return false;
 
 	if (query.WhereCriteria) {
@@ -1006,6 +1296,15 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 	type = (typeOverride != -1) ? typeOverride : query.Type;
 
+	bool batch = CanBatchQuery(query, type);
+	bool batchUpsert = false;
+	bool history = IsHistoryQuery(query, type);
+
+	if (batch) {
+		batchUpsert = (type & DbQueryUpdate);
+		type = DbQueryInsert;
+	}
+
 	bool upsert = false;
 
 	if ((type & DbQueryInsert) && (type & DbQueryUpdate)) {
@@ -1027,7 +1326,7 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if ((type & DbQueryInsert) && (type & DbQueryDelete)) {
 		std::ostringstream qdel;
 		qdel << "DELETE FROM " << GetTablePrefix() << query.Table << where.str();
-		AsyncQuery(qdel.str());
+		AsyncQuery(qdel.str(), IdoAsyncCallback(), query.Table);
 
 		type = DbQueryInsert;
 	}
@@ -1048,6 +1347,7 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 	if (type == DbQueryInsert || type == DbQueryUpdate) {
 		std::ostringstream colbuf, valbuf;
+		std::vector<String> columns;
 
 		if (type == DbQueryUpdate && query.Fields->GetLength() == 0)
 			return;
@@ -1081,6 +1381,9 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 				colbuf << kv.first;
 				valbuf << value;
+
+				if (batch || history)
+					columns.push_back(kv.first);
 			} else {
 				if (!first)
 					qbuf << ", ";
@@ -1092,6 +1395,25 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 				first = false;
 		}
 
+		if (history) {
+			/* Rows for the same object are written by the same connection to keep them in order. */
+			size_t index;
+
+			if (query.Object)
+				index = std::hash<DbObject *>()(query.Object.get()) % m_Writers.size();
+			else
+				index = m_NextWriter++ % m_Writers.size();
+
+			m_Writers[index]->AddRow(query.Table, columns, valbuf.str());
+			return;
+		}
+
+		if (batch) {
+			AsyncBatchQuery(query.Table, columns, valbuf.str(), batchUpsert,
+				std::bind(&IdoMysqlConnection::FinishExecuteQuery, this, query, DbQueryInsert, false));
+			return;
+		}
+
 		if (type == DbQueryInsert)
 			qbuf << " (" << colbuf.str() << ") VALUES (" << valbuf.str() << ")";
 	}
@@ -1099,7 +1421,46 @@ void IdoMysqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
-	AsyncQuery(qbuf.str(), std::bind(&IdoMysqlConnection::FinishExecuteQuery, this, query, type, upsert));
+	AsyncQuery(qbuf.str(), std::bind(&IdoMysqlConnection::FinishExecuteQuery, this, query, type, upsert), query.Table);
+}
+
+/**
+ * Checks whether a query can be sent as a row of a multi-row INSERT statement.
+ */
+bool IdoMysqlConnection::CanBatchQuery(const DbQuery& query, int type) const
+{
+	if (GetBatchSize() < 2)
+		return false;
+
+	/* The insert ID is only known for the first row of a multi-row statement. */
+	if (type == DbQueryInsert)
+		return !(query.Object && query.ConfigUpdate) && !query.NotificationInsertID;
+
+	if (type != (DbQueryInsert | DbQueryUpdate) || !query.StatusUpdate || !query.Object || !query.WhereCriteria)
+		return false;
+
+	/* Upserts need a unique key on the object ID for ON DUPLICATE KEY UPDATE. */
+	if (query.Table != "hoststatus" && query.Table != "servicestatus")
+		return false;
+
+	String idColumn = query.Object->GetType()->GetIDColumn();
+
+	return query.WhereCriteria->GetLength() == 1 && query.WhereCriteria->Contains(idColumn) && query.Fields->Contains(idColumn);
+}
+
+/**
+ * Checks whether a query is a history insert which can be written by one of
+ * the additional connections. Their results aren't needed by any later query.
+ */
+bool IdoMysqlConnection::IsHistoryQuery(const DbQuery& query, int type) const
+{
+	if (m_Writers.empty() || type != DbQueryInsert)
+		return false;
+
+	if (query.ConfigUpdate || query.StatusUpdate || query.NotificationInsertID)
+		return false;
+
+	return (query.Category & (DbCatStateHistory | DbCatNotification | DbCatLog | DbCatCheck)) != 0;
 }
 
 void IdoMysqlConnection::FinishExecuteQuery(const DbQuery& query, int type, bool upsert)
@@ -1151,6 +1512,25 @@ void IdoMysqlConnection::InternalCleanUpExecuteQuery(const String& table, const
 		" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ")");
 }
 
+/**
+ * Deletes a chunk of old rows on a separate session, so the query queue
+ * isn't blocked while the rows are deleted.
+ */
+void IdoMysqlConnection::CleanUpExecuteChunk(const String& table, const String& time_column, double max_age, int limit)
+{
+	IdoMysqlWriter::Ptr writer = m_CleanUpWriter;
+
+	if (!writer || !GetConnected()) {
+		FinishCleanUpChunk(table, -1);
+		return;
+	}
+
+	writer->Delete("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
+		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
+		" < FROM_UNIXTIME(" + Convert::ToString(static_cast<long>(max_age)) + ") LIMIT " + Convert::ToString(limit),
+		std::bind(&IdoMysqlConnection::FinishCleanUpChunk, IdoMysqlConnection::Ptr(this), table, _1));
+}
+
 void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
 {
 	String query = "SELECT " + type->GetIDColumn() + " AS object_id, " + type->GetTable() + "_id, config_hash FROM " + GetTablePrefix() + type->GetTable() + "s";
@@ -1167,5 +1547,11 @@ void IdoMysqlConnection::FillIDCache(const DbType::Ptr& type)
 
 int IdoMysqlConnection::GetPendingQueryCount() const
 {
-	return m_QueryQueue.GetLength();
+	size_t count = m_QueryQueue.GetLength();
+
+	for (const IdoMysqlWriter::Ptr& writer : m_Writers) {
+		count += writer->GetPendingQueryCount();
+	}
+
+	return count;
 }
@@ -21,6 +21,7 @@
 #define IDOMYSQLCONNECTION_H
 
 #include "db_ido_mysql/idomysqlconnection-ti.hpp"
+#include "db_ido_mysql/idomysqlwriter.hpp"
 #include "mysql_shim/mysqlinterface.hpp"
 #include "base/array.hpp"
 #include "base/timer.hpp"
@@ -38,6 +39,22 @@ struct IdoAsyncQuery
 {
 	String Query;
 	IdoAsyncCallback Callback;
+
+	/* Multi-row statements: Query is the statement prefix and the rows
+	 * are joined when the statement is sent. */
+	std::vector<String> Rows;
+	std::vector<IdoAsyncCallback> RowCallbacks;
+	String Suffix;
+};
+
+/**
+ * A multi-row statement which further rows can be added to.
+ */
+struct IdoAsyncBatch
+{
+	String Table;
+	std::vector<IdoAsyncQuery>::size_type Index;
+	size_t Length;
 };
 
 /**
@@ -55,6 +72,9 @@ public:
 
 	int GetPendingQueryCount() const override;
 
+	void ValidateBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+	void ValidateHistoryConnections(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -65,6 +85,7 @@ protected:
 	void ExecuteQuery(const DbQuery& query) override;
 	void ExecuteMultipleQueries(const std::vector<DbQuery>& queries) override;
 	void CleanUpExecuteQuery(const String& table, const String& time_key, double time_value) override;
+	void CleanUpExecuteChunk(const String& table, const String& time_key, double time_value, int limit) override;
 	void FillIDCache(const DbType::Ptr& type) override;
 	void NewTransaction() override;
 
@@ -81,10 +102,26 @@ private:
 	unsigned int m_MaxPacketSize;
 
 	std::vector<IdoAsyncQuery> m_AsyncQueries;
+	std::map<String, IdoAsyncBatch> m_AsyncBatches;
+
+	boost::mutex m_BatchStatsMutex;
+	RingBuffer m_BatchRowStats{15 * 60};
+	RingBuffer m_BatchStatementStats{15 * 60};
 
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
+	std::vector<IdoMysqlWriter::Ptr> m_Writers;
+	size_t m_NextWriter{0};
+
+	/* Separate session for chunked cleanups */
+	IdoMysqlWriter::Ptr m_CleanUpWriter;
+
+	/* Sessions which load the ID cache after connecting */
+	std::vector<IdoMysqlWriter::Ptr> m_IDCacheLoaders;
+	int m_IDCacheGeneration{0};
+	size_t m_IDCachePendingTypes{0};
+
 	IdoMysqlResult Query(const String& query);
 	DbReference GetLastInsertID();
 	int GetAffectedRows();
@@ -92,9 +129,14 @@ private:
 	Dictionary::Ptr FetchRow(const IdoMysqlResult& result);
 	void DiscardRows(const IdoMysqlResult& result);
 
-	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback());
+	void AsyncQuery(const String& query, const IdoAsyncCallback& callback = IdoAsyncCallback(), const String& table = String());
+	void AsyncBatchQuery(const String& table, const std::vector<String>& columns, const String& values, bool upsert, const IdoAsyncCallback& callback);
+	void AddAsyncQuery(IdoAsyncQuery&& aq);
+	void CloseAsyncBatches(const String& table);
 	void FinishAsyncQueries();
 
+	double GetBatchRowsPerStatement(RingBuffer::SizeType span);
+
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
@@ -108,9 +150,12 @@ private:
 	void ReconnectTimerHandler();
 
 	bool CanExecuteQuery(const DbQuery& query);
+	bool CanBatchQuery(const DbQuery& query, int type) const;
+	bool IsHistoryQuery(const DbQuery& query, int type) const;
 
 	void InternalExecuteQuery(const DbQuery& query, int typeOverride = -1);
 	void InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries);
+	void InternalExecuteStatusUpdate(const DbObject::Ptr& dbobj, const String& table);
 
 	void FinishExecuteQuery(const DbQuery& query, int type, bool upsert);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
@@ -121,7 +166,13 @@ private:
 
 	void ExceptionHandler(boost::exception_ptr exp);
 
+	void LoadIDCaches(double startTime);
+	void FinishIDCache(int generation, const DbType::Ptr& type, bool success, const std::shared_ptr<IdoMysqlRows>& rows, double startTime);
+	void StopIDCacheLoaders();
+
 	void FinishConnect(double startTime);
+
+	friend class IdoMysqlWriter;
 };
 
 }
@@ -0,0 +1,344 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "db_ido_mysql/idomysqlwriter.hpp"
+#include "db_ido_mysql/idomysqlconnection.hpp"
+#include "base/logger.hpp"
+#include "base/convert.hpp"
+#include <sstream>
+
+using namespace icinga;
+
+IdoMysqlWriter::IdoMysqlWriter(IdoMysqlConnection *parent, const MysqlInterface *mysql, int id)
+	: m_Parent(parent), m_Mysql(mysql), m_ID(id)
+{
+	m_Queue.SetName("IdoMysqlWriter, " + parent->GetName() + " #" + Convert::ToString(id));
+}
+
+/**
+ * Queues a history row. The row is written with the next multi-row
+ * statement for the same table and columns.
+ *
+ * @param table The table without prefix.
+ * @param columns The column names.
+ * @param values The escaped values, separated by commas.
+ */
+void IdoMysqlWriter::AddRow(const String& table, const std::vector<String>& columns, const String& values)
+{
+	std::ostringstream prefixbuf;
+	prefixbuf << "INSERT INTO " << m_Parent->GetTablePrefix() << table << " (";
+
+	bool first = true;
+	for (const String& column : columns) {
+		if (!first)
+			prefixbuf << ", ";
+
+		prefixbuf << column;
+		first = false;
+	}
+
+	prefixbuf << ") VALUES ";
+
+	m_Queue.Enqueue(std::bind(&IdoMysqlWriter::InternalAddRow, IdoMysqlWriter::Ptr(this), String(prefixbuf.str()), "(" + values + ")"));
+}
+
+/**
+ * Executes a DELETE statement. Each statement is committed on its own,
+ * so locks are only held while the statement runs.
+ *
+ * @param query The query.
+ * @param callback Called with the number of deleted rows, or -1 if the
+ *                 statement failed.
+ */
+void IdoMysqlWriter::Delete(const String& query, const std::function<void (int)>& callback)
+{
+	m_Queue.Enqueue(std::bind(&IdoMysqlWriter::InternalDelete, IdoMysqlWriter::Ptr(this), query, callback));
+}
+
+/**
+ * Executes a SELECT statement. The rows are streamed from the server
+ * instead of being buffered by the client library first.
+ *
+ * @param query The query.
+ * @param callback Called with the rows, the first argument is false if
+ *                 the statement failed.
+ */
+void IdoMysqlWriter::Select(const String& query, const IdoMysqlSelectCallback& callback)
+{
+	m_Queue.Enqueue(std::bind(&IdoMysqlWriter::InternalSelect, IdoMysqlWriter::Ptr(this), query, callback));
+}
+
+void IdoMysqlWriter::Flush()
+{
+	m_Queue.Enqueue(std::bind(&IdoMysqlWriter::InternalFlush, IdoMysqlWriter::Ptr(this)));
+}
+
+/**
+ * Writes the queued rows and closes the connection.
+ */
+void IdoMysqlWriter::Stop()
+{
+	m_Queue.Enqueue([this]() {
+		InternalFlush();
+		Disconnect();
+	});
+
+	m_Queue.Join();
+}
+
+size_t IdoMysqlWriter::GetPendingQueryCount() const
+{
+	return m_Queue.GetLength();
+}
+
+bool IdoMysqlWriter::Connect()
+{
+	ASSERT(m_Queue.IsWorkerThread());
+
+	if (m_Connected)
+		return true;
+
+	String ihost = m_Parent->GetHost();
+	String isocket_path = m_Parent->GetSocketPath();
+	String iuser = m_Parent->GetUser();
+	String ipasswd = m_Parent->GetPassword();
+	String idb = m_Parent->GetDatabase();
+	String isslKey = m_Parent->GetSslKey();
+	String isslCert = m_Parent->GetSslCert();
+	String isslCa = m_Parent->GetSslCa();
+	String isslCaPath = m_Parent->GetSslCapath();
+	String isslCipher = m_Parent->GetSslCipher();
+
+	const char *host = (!ihost.IsEmpty()) ? ihost.CStr() : nullptr;
+	const char *socket_path = (!isocket_path.IsEmpty()) ? isocket_path.CStr() : nullptr;
+	const char *user = (!iuser.IsEmpty()) ? iuser.CStr() : nullptr;
+	const char *passwd = (!ipasswd.IsEmpty()) ? ipasswd.CStr() : nullptr;
+	const char *db = (!idb.IsEmpty()) ? idb.CStr() : nullptr;
+
+	if (!m_Mysql->init(&m_Connection)) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "mysql_init() failed: out of memory";
+
+		return false;
+	}
+
+	if (m_Parent->GetEnableSsl()) {
+		m_Mysql->ssl_set(&m_Connection,
+			(!isslKey.IsEmpty()) ? isslKey.CStr() : nullptr,
+			(!isslCert.IsEmpty()) ? isslCert.CStr() : nullptr,
+			(!isslCa.IsEmpty()) ? isslCa.CStr() : nullptr,
+			(!isslCaPath.IsEmpty()) ? isslCaPath.CStr() : nullptr,
+			(!isslCipher.IsEmpty()) ? isslCipher.CStr() : nullptr);
+	}
+
+	if (!m_Mysql->real_connect(&m_Connection, host, user, passwd, db, m_Parent->GetPort(), socket_path, 0)) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "History connection #" << m_ID << " to database '" << idb << "' failed: \"" << m_Mysql->error(&m_Connection) << "\"";
+
+		m_Mysql->close(&m_Connection);
+		return false;
+	}
+
+	/* FROM_UNIXTIME() in the rows depends on the session time zone. */
+	if (m_Mysql->query(&m_Connection, "SET SESSION TIME_ZONE='+00:00'") != 0 ||
+		m_Mysql->query(&m_Connection, "SET SESSION SQL_MODE='NO_AUTO_VALUE_ON_ZERO'") != 0 ||
+		m_Mysql->query(&m_Connection, "SELECT @@global.max_allowed_packet") != 0) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "Error \"" << m_Mysql->error(&m_Connection) << "\" when setting up history connection #" << m_ID;
+
+		m_Mysql->close(&m_Connection);
+		return false;
+	}
+
+	MYSQL_RES *result = m_Mysql->store_result(&m_Connection);
+
+	if (result) {
+		MYSQL_ROW row = m_Mysql->fetch_row(result);
+
+		if (row && row[0])
+			m_MaxPacketSize = Convert::ToLong(String(row[0]));
+
+		m_Mysql->free_result(result);
+	}
+
+	m_Connected = true;
+
+	Log(LogInformation, "IdoMysqlWriter")
+		<< "Opened history connection #" << m_ID << " for '" << m_Parent->GetName() << "'.";
+
+	return true;
+}
+
+void IdoMysqlWriter::Disconnect()
+{
+	ASSERT(m_Queue.IsWorkerThread());
+
+	if (!m_Connected)
+		return;
+
+	m_Mysql->close(&m_Connection);
+	m_Connected = false;
+}
+
+void IdoMysqlWriter::InternalAddRow(const String& prefix, const String& row)
+{
+	std::vector<String>& rows = m_Rows[prefix];
+	size_t& bytes = m_RowBytes[prefix];
+
+	if (!rows.empty() && prefix.GetLength() + bytes + row.GetLength() + 2 >= m_MaxPacketSize / 2)
+		FlushRows(prefix);
+
+	rows.push_back(row);
+	bytes += row.GetLength() + 2;
+
+	if (rows.size() >= static_cast<size_t>(m_Parent->GetBatchSize()))
+		FlushRows(prefix);
+}
+
+void IdoMysqlWriter::InternalFlush()
+{
+	for (const auto& kv : m_Rows) {
+		FlushRows(kv.first);
+	}
+}
+
+void IdoMysqlWriter::InternalDelete(const String& query, const std::function<void (int)>& callback)
+{
+	if (!Connect()) {
+		callback(-1);
+		return;
+	}
+
+	Log(LogDebug, "IdoMysqlWriter")
+		<< "Query: " << query;
+
+	m_Parent->IncreaseQueryCount();
+
+	if (m_Mysql->query(&m_Connection, query.CStr()) != 0) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "Error \"" << m_Mysql->error(&m_Connection) << "\" when executing query \"" << query << "\"";
+
+		Disconnect();
+		callback(-1);
+		return;
+	}
+
+	callback(static_cast<int>(m_Mysql->affected_rows(&m_Connection)));
+}
+
+void IdoMysqlWriter::InternalSelect(const String& query, const IdoMysqlSelectCallback& callback)
+{
+	IdoMysqlRows rows;
+
+	if (!Connect()) {
+		callback(false, std::move(rows));
+		return;
+	}
+
+	Log(LogDebug, "IdoMysqlWriter")
+		<< "Query: " << query;
+
+	m_Parent->IncreaseQueryCount();
+
+	MYSQL_RES *result = nullptr;
+
+	if (m_Mysql->query(&m_Connection, query.CStr()) != 0 || !(result = m_Mysql->use_result(&m_Connection))) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "Error \"" << m_Mysql->error(&m_Connection) << "\" when executing query \"" << query << "\"";
+
+		Disconnect();
+		callback(false, std::move(rows));
+		return;
+	}
+
+	unsigned int fields = m_Mysql->field_count(&m_Connection);
+	MYSQL_ROW row;
+
+	while ((row = m_Mysql->fetch_row(result))) {
+		unsigned long *lengths = m_Mysql->fetch_lengths(result);
+
+		std::vector<String> values;
+		values.reserve(fields);
+
+		for (unsigned int i = 0; i < fields; i++)
+			values.emplace_back(row[i] ? String(row[i], row[i] + lengths[i]) : String());
+
+		rows.emplace_back(std::move(values));
+	}
+
+	/* fetch_row() returns NULL on errors, too. */
+	bool success = m_Mysql->error(&m_Connection)[0] == '\0';
+
+	m_Mysql->free_result(result);
+
+	if (!success) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "Error \"" << m_Mysql->error(&m_Connection) << "\" when fetching rows for query \"" << query << "\"";
+
+		Disconnect();
+	}
+
+	callback(success, std::move(rows));
+}
+
+void IdoMysqlWriter::FlushRows(const String& prefix)
+{
+	std::vector<String>& rows = m_Rows[prefix];
+
+	if (rows.empty())
+		return;
+
+	std::ostringstream querybuf;
+	querybuf << prefix;
+
+	bool first = true;
+	for (const String& row : rows) {
+		if (!first)
+			querybuf << ", ";
+
+		querybuf << row;
+		first = false;
+	}
+
+	size_t count = rows.size();
+	rows.clear();
+	m_RowBytes[prefix] = 0;
+
+	/* History rows are lost if the database isn't reachable, just like
+	 * the queries of the main connection. */
+	if (!Connect()) {
+		Log(LogWarning, "IdoMysqlWriter")
+			<< "Discarding " << count << " history rows for '" << m_Parent->GetName() << "'.";
+		return;
+	}
+
+	String query = querybuf.str();
+
+	Log(LogDebug, "IdoMysqlWriter")
+		<< "Query: " << query;
+
+	m_Parent->IncreaseQueryCount();
+
+	if (m_Mysql->query(&m_Connection, query.CStr()) != 0) {
+		Log(LogCritical, "IdoMysqlWriter")
+			<< "Error \"" << m_Mysql->error(&m_Connection) << "\" when executing query \"" << query << "\"";
+
+		Disconnect();
+	}
+}
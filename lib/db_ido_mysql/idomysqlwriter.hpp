@@ -0,0 +1,86 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef IDOMYSQLWRITER_H
+#define IDOMYSQLWRITER_H
+
+#include "mysql_shim/mysqlinterface.hpp"
+#include "base/object.hpp"
+#include "base/workqueue.hpp"
+#include <map>
+#include <vector>
+
+namespace icinga
+{
+
+class IdoMysqlConnection;
+
+typedef std::vector<std::vector<String> > IdoMysqlRows;
+typedef std::function<void (bool, IdoMysqlRows&&)> IdoMysqlSelectCallback;
+
+/**
+ * An additional MySQL session which writes history rows for an IDO
+ * MySQL connection. Rows are sent as multi-row INSERT statements with
+ * autocommit enabled.
+ *
+ * @ingroup ido
+ */
+class IdoMysqlWriter final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(IdoMysqlWriter);
+
+	IdoMysqlWriter(IdoMysqlConnection *parent, const MysqlInterface *mysql, int id);
+
+	void AddRow(const String& table, const std::vector<String>& columns, const String& values);
+	void Delete(const String& query, const std::function<void (int)>& callback);
+	void Select(const String& query, const IdoMysqlSelectCallback& callback);
+	void Flush();
+	void Stop();
+
+	size_t GetPendingQueryCount() const;
+
+private:
+	IdoMysqlConnection *m_Parent;
+	const MysqlInterface *m_Mysql;
+	int m_ID;
+
+	WorkQueue m_Queue{1000000};
+
+	MYSQL m_Connection;
+	bool m_Connected{false};
+	unsigned int m_MaxPacketSize{64 * 1024};
+
+	/* Rows by statement prefix */
+	std::map<String, std::vector<String> > m_Rows;
+	std::map<String, size_t> m_RowBytes;
+
+	bool Connect();
+	void Disconnect();
+
+	void InternalAddRow(const String& prefix, const String& row);
+	void InternalFlush();
+	void InternalDelete(const String& query, const std::function<void (int)>& callback);
+	void InternalSelect(const String& query, const IdoMysqlSelectCallback& callback);
+	void FlushRows(const String& prefix);
+};
+
+}
+
+#endif /* IDOMYSQLWRITER_H */
@@ -40,6 +40,67 @@ REGISTER_TYPE(IdoPgsqlConnection);
 
 REGISTER_STATSFUNCTION(IdoPgsqlConnection, &IdoPgsqlConnection::StatsFunc);
 
+/**
+ * Formats a timestamp like TO_TIMESTAMP(ts) AT TIME ZONE 'UTC' does.
+ */
+static String FormatUTCTimestamp(double ts)
+{
+	char timestamp[128];
+	auto tempts = (time_t)ts;
+	tm tmthen;
+
+#ifdef _MSC_VER
+	tm *temp = gmtime(&tempts);
+
+	if (!temp) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("gmtime")
+			<< boost::errinfo_errno(errno));
+	}
+
+	tmthen = *temp;
+#else /* _MSC_VER */
+	if (!gmtime_r(&tempts, &tmthen)) {
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("gmtime_r")
+			<< boost::errinfo_errno(errno));
+	}
+#endif /* _MSC_VER */
+
+	strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tmthen);
+
+	return timestamp;
+}
+
+/**
+ * Escapes a value for the COPY text format.
+ */
+static String EscapeCopyString(const String& s)
+{
+	String result;
+
+	for (char ch : s.GetData()) {
+		switch (ch) {
+			case '\\':
+				result += "\\\\";
+				break;
+			case '\n':
+				result += "\\n";
+				break;
+			case '\r':
+				result += "\\r";
+				break;
+			case '\t':
+				result += "\\t";
+				break;
+			default:
+				result += ch;
+		}
+	}
+
+	return result;
+}
+
 IdoPgsqlConnection::IdoPgsqlConnection()
 {
 	m_QueryQueue.SetName("IdoPgsqlConnection, " + GetName());
@@ -64,16 +125,19 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 {
 	DictionaryData nodes;
 
-	for (const IdoPgsqlConnection::Ptr& idopgsqlconnection : ConfigType::GetObjectsByType<IdoPgsqlConnection>()) {
+	for (const IdoPgsqlConnection::Ptr& idopgsqlconnection : ConfigType::GetObjectViewByType<IdoPgsqlConnection>()) {
 		size_t queryQueueItems = idopgsqlconnection->m_QueryQueue.GetLength();
 		double queryQueueItemRate = idopgsqlconnection->m_QueryQueue.GetTaskCount(60) / 60.0;
+		double copyRowsPerStatement = idopgsqlconnection->GetCopyRowsPerStatement(60);
 
 		nodes.emplace_back(idopgsqlconnection->GetName(), new Dictionary({
 			{ "version", idopgsqlconnection->GetSchemaVersion() },
 			{ "instance_name", idopgsqlconnection->GetInstanceName() },
 			{ "connected", idopgsqlconnection->GetConnected() },
 			{ "query_queue_items", queryQueueItems },
-			{ "query_queue_item_rate", queryQueueItemRate }
+			{ "query_queue_item_rate", queryQueueItemRate },
+			{ "copy_rows_per_statement", copyRowsPerStatement },
+			{ "cleanup_pending_tables", idopgsqlconnection->GetCleanUpPendingTables() }
 		}));
 
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_rate", idopgsqlconnection->GetQueryCount(60) / 60.0));
@@ -82,11 +146,42 @@ void IdoPgsqlConnection::StatsFunc(const Dictionary::Ptr& status, const Array::P
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_queries_15mins", idopgsqlconnection->GetQueryCount(15 * 60)));
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_items", queryQueueItems));
 		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_query_queue_item_rate", queryQueueItemRate));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_copy_rows_per_statement", copyRowsPerStatement));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_cleanup_rows_1min", idopgsqlconnection->GetCleanUpRowCount(60)));
+		perfdata->Add(new PerfdataValue("idopgsqlconnection_" + idopgsqlconnection->GetName() + "_cleanup_pending_tables", idopgsqlconnection->GetCleanUpPendingTables()));
 	}
 
 	status->Set("idopgsqlconnection", new Dictionary(std::move(nodes)));
 }
 
+/**
+ * Returns the average number of rows per COPY statement.
+ *
+ * @param span The time span in seconds.
+ * @returns The number of rows, or 0 if no COPY statements were sent.
+ */
+double IdoPgsqlConnection::GetCopyRowsPerStatement(RingBuffer::SizeType span)
+{
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_CopyStatsMutex);
+
+	int statements = m_CopyStatementStats.UpdateAndGetValues(now, span);
+
+	if (statements == 0)
+		return 0;
+
+	return m_CopyRowStats.UpdateAndGetValues(now, span) / static_cast<double>(statements);
+}
+
+void IdoPgsqlConnection::ValidateBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<IdoPgsqlConnection>::ValidateBatchSize(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "batch_size" }, "Batch size must be at least 1."));
+}
+
 void IdoPgsqlConnection::Resume()
 {
 	DbConnection::Resume();
@@ -105,6 +200,7 @@ void IdoPgsqlConnection::Resume()
 
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
+	m_ReconnectTimer->SetSlack(1);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&IdoPgsqlConnection::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
@@ -150,6 +246,8 @@ void IdoPgsqlConnection::Disconnect()
 	if (!GetConnected())
 		return;
 
+	FlushCopyBatches();
+
 	Query("COMMIT");
 
 	m_Pgsql->finish(m_Connection);
@@ -173,6 +271,8 @@ void IdoPgsqlConnection::InternalNewTransaction()
 	if (!GetConnected())
 		return;
 
+	FlushCopyBatches();
+
 	Query("COMMIT");
 	Query("BEGIN");
 }
@@ -208,6 +308,13 @@ void IdoPgsqlConnection::Reconnect()
 
 	ClearIDCache();
 
+	/* Rows which were queued on the old connection are lost, just like its open transaction. */
+	m_CopyBatches.clear();
+	m_CopyStagingTables.clear();
+
+	/* Prepared statements only exist in the session which created them. */
+	m_PreparedStatements.clear();
+
 	String host = GetHost();
 	String port = GetPort();
 	String user = GetUser();
@@ -503,6 +610,97 @@ IdoPgsqlResult IdoPgsqlConnection::Query(const String& query)
 	return IdoPgsqlResult(result, std::bind(&PgsqlInterface::clear, std::cref(m_Pgsql), _1));
 }
 
+/**
+ * Executes a query with parameters. The query is prepared on first use and
+ * the prepared statement is re-used for all later queries with the same text.
+ */
+void IdoPgsqlConnection::QueryPrepared(const String& query, const std::vector<String>& params)
+{
+	AssertOnWorkQueue();
+
+	auto it = m_PreparedStatements.find(query);
+
+	if (it == m_PreparedStatements.end()) {
+		/* The number of distinct queries is bounded by the schema, this is just a safety net. */
+		if (m_PreparedStatements.size() >= 1000) {
+			Query("DEALLOCATE ALL");
+			m_PreparedStatements.clear();
+		}
+
+		String name = "icinga_stmt_" + Convert::ToString(m_PreparedStatements.size());
+		Log(LogDebug, "IdoPgsqlConnection")
+			<< "Prepare: " << query;
+
+		PGresult *result = m_Pgsql->prepare(m_Connection, name.CStr(), query.CStr(), 0, nullptr);
+
+		if (!result || m_Pgsql->resultStatus(result) != PGRES_COMMAND_OK) {
+			String message = result ? m_Pgsql->resultErrorMessage(result) : m_Pgsql->errorMessage(m_Connection);
+
+			if (result)
+				m_Pgsql->clear(result);
+
+			Log(LogCritical, "IdoPgsqlConnection")
+				<< "Error \"" << message << "\" when preparing query \"" << query << "\"";
+
+			BOOST_THROW_EXCEPTION(
+				database_error()
+				<< errinfo_message(message)
+				<< errinfo_database_query(query)
+			);
+		}
+
+		m_Pgsql->clear(result);
+
+		it = m_PreparedStatements.emplace(query, name).first;
+	}
+
+	Log(LogDebug, "IdoPgsqlConnection")
+		<< "Query: " << query << " (" << params.size() << " parameters)";
+
+	IncreaseQueryCount();
+
+	std::vector<const char *> values;
+	values.reserve(params.size());
+
+	for (const String& param : params) {
+		values.push_back(param.CStr());
+	}
+
+	PGresult *result = m_Pgsql->execPrepared(m_Connection, it->second.CStr(), values.size(), values.data(), nullptr, nullptr, 0);
+
+	if (!result) {
+		String message = m_Pgsql->errorMessage(m_Connection);
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	m_AffectedRows = atoi(m_Pgsql->cmdTuples(result));
+
+	ExecStatusType status = m_Pgsql->resultStatus(result);
+
+	if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK) {
+		String message = m_Pgsql->resultErrorMessage(result);
+		m_Pgsql->clear(result);
+
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	m_Pgsql->clear(result);
+}
+
 DbReference IdoPgsqlConnection::GetSequenceValue(const String& table, const String& column)
 {
 	AssertOnWorkQueue();
@@ -533,13 +731,11 @@ String IdoPgsqlConnection::Escape(const String& s)
 	String utf8s = Utility::ValidateUTF8(s);
 
 	size_t length = utf8s.GetLength();
-	auto *to = new char[utf8s.GetLength() * 2 + 1];
-
-	m_Pgsql->escapeStringConn(m_Connection, to, utf8s.CStr(), length, nullptr);
-
-	String result = String(to);
 
-	delete [] to;
+	/* Escape into the result, which is shrunk to the escaped length afterwards. */
+	String result;
+	result.GetData().resize(length * 2 + 1);
+	result.GetData().resize(m_Pgsql->escapeStringConn(m_Connection, &result.GetData()[0], utf8s.CStr(), length, nullptr));
 
 	return result;
 }
@@ -671,10 +867,13 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 
 		*result = static_cast<long>(dbrefcol);
 	} else if (DbValue::IsTimestamp(value)) {
-		long ts = rawvalue;
-		std::ostringstream msgbuf;
-		msgbuf << "TO_TIMESTAMP(" << ts << ") AT TIME ZONE 'UTC'";
-		*result = Value(msgbuf.str());
+		char buf[Convert::FormatBufferSize];
+		size_t len = Convert::FormatInteger(static_cast<long>(rawvalue), buf);
+
+		String ts = "TO_TIMESTAMP(";
+		ts.GetData().append(buf, len);
+		ts += ") AT TIME ZONE 'UTC'";
+		*result = std::move(ts);
 	} else if (DbValue::IsTimestampNow(value)) {
 		*result = "NOW()";
 	} else if (DbValue::IsObjectInsertID(value)) {
@@ -685,6 +884,87 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 
 		*result = id;
 		return true;
+	} else if (rawvalue.IsBoolean()) {
+		*result = rawvalue.ToBool() ? "E'1'" : "E'0'";
+	} else if (rawvalue.IsNumber()) {
+		/* Numbers don't need to be escaped. */
+		*result = "E'" + Convert::ToString(rawvalue.Get<double>()) + "'";
+	} else
+		*result = "E'" + Escape(rawvalue) + "'";
+
+	return true;
+}
+
+/**
+ * Converts a field value into the COPY text format.
+ */
+bool IdoPgsqlConnection::FieldToCopyString(const String& key, const Value& value, String *result)
+{
+	Value rawvalue = DbValue::ExtractValue(value);
+
+	if (DbValue::IsTimestamp(value)) {
+		*result = FormatUTCTimestamp(rawvalue);
+		return true;
+	} else if (DbValue::IsTimestampNow(value)) {
+		*result = FormatUTCTimestamp(Utility::GetTime());
+		return true;
+	} else if (key == "instance_id" || key == "session_token" || rawvalue.IsObjectType<ConfigObject>() || DbValue::IsObjectInsertID(value)) {
+		/* These are numbers. */
+		Value fvalue;
+
+		if (!FieldToEscapedString(key, value, &fvalue))
+			return false;
+
+		*result = fvalue;
+		return true;
+	}
+
+	Value fvalue;
+
+	if (rawvalue.IsBoolean())
+		fvalue = Convert::ToLong(rawvalue);
+	else
+		fvalue = rawvalue;
+
+	*result = EscapeCopyString(Utility::ValidateUTF8(fvalue));
+	return true;
+}
+
+/**
+ * Converts a field value into an SQL expression. When params is set the value
+ * is added to it as a query parameter and isn't escaped.
+ */
+bool IdoPgsqlConnection::FieldToQueryValue(const String& key, const Value& value, std::vector<String> *params, String *result)
+{
+	if (!params) {
+		Value fvalue;
+
+		if (!FieldToEscapedString(key, value, &fvalue))
+			return false;
+
+		*result = fvalue;
+		return true;
+	}
+
+	if (DbValue::IsTimestampNow(value)) {
+		*result = "NOW()";
+		return true;
+	}
+
+	Value rawvalue = DbValue::ExtractValue(value);
+
+	if (DbValue::IsTimestamp(value)) {
+		params->emplace_back(Convert::ToString(static_cast<long>(rawvalue)));
+		*result = "TO_TIMESTAMP($" + Convert::ToString(params->size()) + "::double precision) AT TIME ZONE 'UTC'";
+		return true;
+	} else if (key == "instance_id" || key == "session_token" || rawvalue.IsObjectType<ConfigObject>() || DbValue::IsObjectInsertID(value)) {
+		/* These are numbers. */
+		Value fvalue;
+
+		if (!FieldToEscapedString(key, value, &fvalue))
+			return false;
+
+		params->emplace_back(fvalue);
 	} else {
 		Value fvalue;
 
@@ -693,9 +973,10 @@ bool IdoPgsqlConnection::FieldToEscapedString(const String& key, const Value& va
 		else
 			fvalue = rawvalue;
 
-		*result = "E'" + Escape(fvalue) + "'";
+		params->emplace_back(Utility::ValidateUTF8(fvalue));
 	}
 
+	*result = "$" + Convert::ToString(params->size());
 	return true;
 }
 
@@ -703,9 +984,24 @@ void IdoPgsqlConnection::ExecuteQuery(const DbQuery& query)
 {
 	ASSERT(query.Category != DbCatInvalid);
 
+	if (CanCoalesceQuery(query)) {
+		if (QueueStatusUpdate(query))
+			m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteStatusUpdate, this, query.Object, query.Table), query.Priority, true);
+
+		return;
+	}
+
 	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority, true);
 }
 
+void IdoPgsqlConnection::InternalExecuteStatusUpdate(const DbObject::Ptr& dbobj, const String& table)
+{
+	DbQuery query;
+
+	if (TakeStatusUpdate(dbobj, table, &query))
+		InternalExecuteQuery(query);
+}
+
 void IdoPgsqlConnection::ExecuteMultipleQueries(const std::vector<DbQuery>& queries)
 {
 	if (queries.empty())
@@ -795,15 +1091,20 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	std::ostringstream qbuf, where;
 	int type;
 
+	bool prepared = GetEnablePreparedStatements();
+
+	/* The where criteria use the first parameters, the fields are added after them. */
+	std::vector<String> whereParams, params;
+
 	if (query.WhereCriteria) {
 		where << " WHERE ";
 
 		ObjectLock olock(query.WhereCriteria);
-		Value value;
+		String value;
 		bool first = true;
 
 		for (const Dictionary::Pair& kv : query.WhereCriteria) {
-			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
+			if (!FieldToQueryValue(kv.first, kv.second, prepared ? &whereParams : nullptr, &value)) {
 				m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
 				return;
 			}
@@ -820,6 +1121,14 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 	type = (typeOverride != -1) ? typeOverride : query.Type;
 
+	if (CanCopyQuery(query, type)) {
+		AddCopyRow(query, type != DbQueryInsert);
+		return;
+	}
+
+	/* Rows which are waiting to be copied must be written before any other query for the table. */
+	FlushCopyBatches(query.Table);
+
 	bool upsert = false;
 
 	if ((type & DbQueryInsert) && (type & DbQueryUpdate)) {
@@ -841,11 +1150,18 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if ((type & DbQueryInsert) && (type & DbQueryDelete)) {
 		std::ostringstream qdel;
 		qdel << "DELETE FROM " << GetTablePrefix() << query.Table << where.str();
-		Query(qdel.str());
+
+		if (prepared)
+			QueryPrepared(qdel.str(), whereParams);
+		else
+			Query(qdel.str());
 
 		type = DbQueryInsert;
 	}
 
+	if (type != DbQueryInsert)
+		params = whereParams;
+
 	switch (type) {
 		case DbQueryInsert:
 			qbuf << "INSERT INTO " << GetTablePrefix() << query.Table;
@@ -868,13 +1184,13 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 
 		ObjectLock olock(query.Fields);
 
-		Value value;
+		String value;
 		bool first = true;
 		for (const Dictionary::Pair& kv : query.Fields) {
 			if (kv.second.IsEmpty() && !kv.second.IsString())
 				continue;
 
-			if (!FieldToEscapedString(kv.first, kv.second, &value)) {
+			if (!FieldToQueryValue(kv.first, kv.second, prepared ? &params : nullptr, &value)) {
 				m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
 				return;
 			}
@@ -905,7 +1221,10 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	if (type != DbQueryInsert)
 		qbuf << where.str();
 
-	Query(qbuf.str());
+	if (prepared)
+		QueryPrepared(qbuf.str(), params);
+	else
+		Query(qbuf.str());
 
 	if (upsert && GetAffectedRows() == 0) {
 		InternalExecuteQuery(query, DbQueryDelete | DbQueryInsert);
@@ -933,6 +1252,286 @@ void IdoPgsqlConnection::InternalExecuteQuery(const DbQuery& query, int typeOver
 	}
 }
 
+/**
+ * Checks whether a query can be written with COPY. Status updates are
+ * copied into a staging table and merged into the table by their object ID.
+ */
+bool IdoPgsqlConnection::CanCopyQuery(const DbQuery& query, int type) const
+{
+	if (GetBatchSize() < 2)
+		return false;
+
+	/* The sequence value is only known for single-row inserts. */
+	if (type == DbQueryInsert)
+		return !(query.Object && query.ConfigUpdate) && !query.NotificationInsertID;
+
+	if (type != (DbQueryInsert | DbQueryUpdate) || !query.StatusUpdate || !query.Object || !query.WhereCriteria)
+		return false;
+
+	String idColumn = query.Object->GetType()->GetIDColumn();
+
+	return query.WhereCriteria->GetLength() == 1 && query.WhereCriteria->Contains(idColumn) && query.Fields->Contains(idColumn);
+}
+
+void IdoPgsqlConnection::AddCopyRow(const DbQuery& query, bool upsert)
+{
+	String keyColumn;
+
+	if (upsert)
+		keyColumn = query.Object->GetType()->GetIDColumn();
+
+	std::vector<String> columns;
+	std::ostringstream rowbuf;
+	String keyValue;
+
+	{
+		ObjectLock olock(query.Fields);
+
+		for (const Dictionary::Pair& kv : query.Fields) {
+			if (kv.second.IsEmpty() && !kv.second.IsString())
+				continue;
+
+			String value;
+
+			if (!FieldToCopyString(kv.first, kv.second, &value)) {
+				m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalExecuteQuery, this, query, -1), query.Priority);
+				return;
+			}
+
+			if (!columns.empty())
+				rowbuf << "\t";
+
+			rowbuf << value;
+			columns.push_back(kv.first);
+
+			if (kv.first == keyColumn)
+				keyValue = value;
+		}
+	}
+
+	if (columns.empty())
+		return;
+
+	auto it = m_CopyBatches.find(query.Table);
+
+	/* Keep the order of rows with different columns. */
+	if (it != m_CopyBatches.end() && (it->second.Columns != columns || it->second.KeyColumn != keyColumn)) {
+		FlushCopyBatch(it->second);
+		m_CopyBatches.erase(it);
+		it = m_CopyBatches.end();
+	}
+
+	if (it == m_CopyBatches.end()) {
+		IdoPgsqlCopyBatch batch;
+		batch.Table = query.Table;
+		batch.Columns = columns;
+		batch.KeyColumn = keyColumn;
+
+		it = m_CopyBatches.emplace(query.Table, std::move(batch)).first;
+	}
+
+	IdoPgsqlCopyBatch& batch = it->second;
+
+	if (upsert) {
+		/* A newer status update for the same object replaces the queued one. */
+		auto kit = batch.KeyRows.find(keyValue);
+
+		if (kit != batch.KeyRows.end())
+			batch.Rows[kit->second] = rowbuf.str();
+		else {
+			batch.KeyRows[keyValue] = batch.Rows.size();
+			batch.Rows.emplace_back(rowbuf.str());
+		}
+	} else
+		batch.Rows.emplace_back(rowbuf.str());
+
+	if (query.Object && query.StatusUpdate)
+		batch.StatusUpdateObjects.push_back(query.Object);
+
+	if (batch.Rows.size() >= static_cast<size_t>(GetBatchSize())) {
+		FlushCopyBatch(batch);
+		m_CopyBatches.erase(it);
+	}
+}
+
+/**
+ * Writes the rows which are waiting to be copied.
+ *
+ * @param table The table, or an empty string for all tables.
+ */
+void IdoPgsqlConnection::FlushCopyBatches(const String& table)
+{
+	if (table.IsEmpty()) {
+		std::map<String, IdoPgsqlCopyBatch> batches;
+		batches.swap(m_CopyBatches);
+
+		for (const auto& kv : batches)
+			FlushCopyBatch(kv.second);
+
+		return;
+	}
+
+	auto it = m_CopyBatches.find(table);
+
+	if (it == m_CopyBatches.end())
+		return;
+
+	IdoPgsqlCopyBatch batch = std::move(it->second);
+	m_CopyBatches.erase(it);
+
+	FlushCopyBatch(batch);
+}
+
+void IdoPgsqlConnection::FlushCopyBatch(const IdoPgsqlCopyBatch& batch)
+{
+	String table = GetTablePrefix() + batch.Table;
+
+	if (batch.KeyColumn.IsEmpty())
+		CopyRows(table, batch.Columns, batch.Rows);
+	else {
+		String stagingTable = "pg_temp." + table + "_copy";
+
+		std::ostringstream colbuf, setbuf;
+
+		bool first = true;
+		for (const String& column : batch.Columns) {
+			if (!first)
+				colbuf << ", ";
+
+			colbuf << column;
+
+			if (column != batch.KeyColumn) {
+				if (setbuf.tellp() > 0)
+					setbuf << ", ";
+
+				setbuf << column << " = s." << column;
+			}
+
+			first = false;
+		}
+
+		String columns = colbuf.str();
+
+		/* The staging table only has the copied columns, so it doesn't use the table's sequence. */
+		String& stagingColumns = m_CopyStagingTables[stagingTable];
+
+		if (stagingColumns != columns) {
+			Query("DROP TABLE IF EXISTS " + stagingTable);
+			Query("CREATE TEMP TABLE " + stagingTable + " AS SELECT " + columns + " FROM " + table + " WITH NO DATA");
+			stagingColumns = columns;
+		}
+
+		CopyRows(stagingTable, batch.Columns, batch.Rows);
+
+		String where = table + "." + batch.KeyColumn + " = s." + batch.KeyColumn;
+
+		if (setbuf.tellp() > 0)
+			Query("UPDATE " + table + " SET " + setbuf.str() + " FROM " + stagingTable + " s WHERE " + where);
+
+		Query("INSERT INTO " + table + " (" + columns + ") SELECT " + columns + " FROM " + stagingTable + " s"
+			" WHERE NOT EXISTS (SELECT 1 FROM " + table + " WHERE " + where + ")");
+		Query("DELETE FROM " + stagingTable);
+	}
+
+	for (const DbObject::Ptr& dbobj : batch.StatusUpdateObjects)
+		SetStatusUpdate(dbobj, true);
+
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_CopyStatsMutex);
+	m_CopyRowStats.InsertValue(now, batch.Rows.size());
+	m_CopyStatementStats.InsertValue(now, 1);
+}
+
+void IdoPgsqlConnection::CopyRows(const String& table, const std::vector<String>& columns, const std::vector<String>& rows)
+{
+	AssertOnWorkQueue();
+
+	std::ostringstream qbuf;
+	qbuf << "COPY " << table << " (";
+
+	bool first = true;
+	for (const String& column : columns) {
+		if (!first)
+			qbuf << ", ";
+
+		qbuf << column;
+		first = false;
+	}
+
+	qbuf << ") FROM STDIN";
+
+	String query = qbuf.str();
+
+	Log(LogDebug, "IdoPgsqlConnection")
+		<< "Query: " << query << " (" << rows.size() << " rows)";
+
+	IncreaseQueryCount();
+
+	PGresult *result = m_Pgsql->exec(m_Connection, query.CStr());
+
+	if (!result || m_Pgsql->resultStatus(result) != PGRES_COPY_IN) {
+		String message;
+
+		if (result) {
+			message = m_Pgsql->resultErrorMessage(result);
+			m_Pgsql->clear(result);
+		} else
+			message = m_Pgsql->errorMessage(m_Connection);
+
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	m_Pgsql->clear(result);
+
+	std::ostringstream databuf;
+
+	for (const String& row : rows)
+		databuf << row << "\n";
+
+	String data = databuf.str();
+
+	if (m_Pgsql->putCopyData(m_Connection, data.CStr(), data.GetLength()) != 1 || m_Pgsql->putCopyEnd(m_Connection, nullptr) != 1) {
+		String message = m_Pgsql->errorMessage(m_Connection);
+
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when sending data for query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+
+	String message;
+
+	while ((result = m_Pgsql->getResult(m_Connection))) {
+		if (message.IsEmpty() && m_Pgsql->resultStatus(result) != PGRES_COMMAND_OK)
+			message = m_Pgsql->resultErrorMessage(result);
+
+		m_Pgsql->clear(result);
+	}
+
+	if (!message.IsEmpty()) {
+		Log(LogCritical, "IdoPgsqlConnection")
+			<< "Error \"" << message << "\" when executing query \"" << query << "\"";
+
+		BOOST_THROW_EXCEPTION(
+			database_error()
+			<< errinfo_message(message)
+			<< errinfo_database_query(query)
+		);
+	}
+}
+
 void IdoPgsqlConnection::CleanUpExecuteQuery(const String& table, const String& time_column, double max_age)
 {
 	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalCleanUpExecuteQuery, this, table, time_column, max_age), PriorityLow, true);
@@ -945,11 +1544,48 @@ void IdoPgsqlConnection::InternalCleanUpExecuteQuery(const String& table, const
 	if (!GetConnected())
 		return;
 
+	FlushCopyBatches(table);
+
 	Query("DELETE FROM " + GetTablePrefix() + table + " WHERE instance_id = " +
 		Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
 		" < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ")");
 }
 
+/**
+ * Deletes a chunk of old rows. Other queries are executed between the
+ * chunks, so the query queue isn't blocked for the whole cleanup.
+ */
+void IdoPgsqlConnection::CleanUpExecuteChunk(const String& table, const String& time_column, double max_age, int limit)
+{
+	m_QueryQueue.Enqueue(std::bind(&IdoPgsqlConnection::InternalCleanUpExecuteChunk, this, table, time_column, max_age, limit), PriorityLow, true);
+}
+
+void IdoPgsqlConnection::InternalCleanUpExecuteChunk(const String& table, const String& time_column, double max_age, int limit)
+{
+	AssertOnWorkQueue();
+
+	if (!GetConnected()) {
+		FinishCleanUpChunk(table, -1);
+		return;
+	}
+
+	FlushCopyBatches(table);
+
+	String where = "instance_id = " + Convert::ToString(static_cast<long>(m_InstanceID)) + " AND " + time_column +
+		" < TO_TIMESTAMP(" + Convert::ToString(static_cast<long>(max_age)) + ")";
+
+	/* PostgreSQL doesn't support DELETE ... LIMIT. */
+	try {
+		Query("DELETE FROM " + GetTablePrefix() + table + " WHERE ctid IN (SELECT ctid FROM " +
+			GetTablePrefix() + table + " WHERE " + where + " LIMIT " + Convert::ToString(limit) + ")");
+	} catch (...) {
+		FinishCleanUpChunk(table, -1);
+		throw;
+	}
+
+	FinishCleanUpChunk(table, GetAffectedRows());
+}
+
 void IdoPgsqlConnection::FillIDCache(const DbType::Ptr& type)
 {
 	String query = "SELECT " + type->GetIDColumn() + " AS object_id, " + type->GetTable() + "_id, config_hash FROM " + GetTablePrefix() + type->GetTable() + "s";
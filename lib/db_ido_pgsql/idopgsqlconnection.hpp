@@ -26,12 +26,29 @@
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include "base/library.hpp"
+#include <set>
 
 namespace icinga
 {
 
 typedef std::shared_ptr<PGresult> IdoPgsqlResult;
 
+/**
+ * Rows which are waiting to be written to a table with COPY.
+ */
+struct IdoPgsqlCopyBatch
+{
+	String Table;
+	std::vector<String> Columns;
+
+	/* Set for status updates, which are merged into the table by this column. */
+	String KeyColumn;
+
+	std::vector<String> Rows;
+	std::map<String, std::vector<String>::size_type> KeyRows;
+	std::vector<DbObject::Ptr> StatusUpdateObjects;
+};
+
 /**
  * An IDO pgSQL database connection.
  *
@@ -49,6 +66,8 @@ public:
 
 	int GetPendingQueryCount() const override;
 
+	void ValidateBatchSize(const Lazy<int>& lvalue, const ValidationUtils& utils) final;
+
 protected:
 	void OnConfigLoaded() override;
 	void Resume() override;
@@ -59,6 +78,7 @@ protected:
 	void ExecuteQuery(const DbQuery& query) override;
 	void ExecuteMultipleQueries(const std::vector<DbQuery>& queries) override;
 	void CleanUpExecuteQuery(const String& table, const String& time_key, double time_value) override;
+	void CleanUpExecuteChunk(const String& table, const String& time_key, double time_value, int limit) override;
 	void FillIDCache(const DbType::Ptr& type) override;
 	void NewTransaction() override;
 
@@ -76,13 +96,26 @@ private:
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_TxTimer;
 
+	std::map<String, IdoPgsqlCopyBatch> m_CopyBatches;
+	std::map<String, String> m_CopyStagingTables;
+
+	/* Maps the SQL text of prepared statements to their names. */
+	std::map<String, String> m_PreparedStatements;
+
+	boost::mutex m_CopyStatsMutex;
+	RingBuffer m_CopyRowStats{15 * 60};
+	RingBuffer m_CopyStatementStats{15 * 60};
+
 	IdoPgsqlResult Query(const String& query);
+	void QueryPrepared(const String& query, const std::vector<String>& params);
 	DbReference GetSequenceValue(const String& table, const String& column);
 	int GetAffectedRows();
 	String Escape(const String& s);
 	Dictionary::Ptr FetchRow(const IdoPgsqlResult& result, int row);
 
 	bool FieldToEscapedString(const String& key, const Value& value, Value *result);
+	bool FieldToCopyString(const String& key, const Value& value, String *result);
+	bool FieldToQueryValue(const String& key, const Value& value, std::vector<String> *params, String *result);
 	void InternalActivateObject(const DbObject::Ptr& dbobj);
 	void InternalDeactivateObject(const DbObject::Ptr& dbobj);
 
@@ -98,10 +131,19 @@ private:
 	void StatsLoggerTimerHandler();
 
 	bool CanExecuteQuery(const DbQuery& query);
+	bool CanCopyQuery(const DbQuery& query, int type) const;
+
+	void AddCopyRow(const DbQuery& query, bool upsert);
+	void FlushCopyBatches(const String& table = String());
+	void FlushCopyBatch(const IdoPgsqlCopyBatch& batch);
+	void CopyRows(const String& table, const std::vector<String>& columns, const std::vector<String>& rows);
+	double GetCopyRowsPerStatement(RingBuffer::SizeType span);
 
 	void InternalExecuteQuery(const DbQuery& query, int typeOverride = -1);
 	void InternalExecuteMultipleQueries(const std::vector<DbQuery>& queries);
+	void InternalExecuteStatusUpdate(const DbObject::Ptr& dbobj, const String& table);
 	void InternalCleanUpExecuteQuery(const String& table, const String& time_key, double time_value);
+	void InternalCleanUpExecuteChunk(const String& table, const String& time_key, double time_value, int limit);
 
 	void ClearTableBySession(const String& table);
 	void ClearTablesBySession();
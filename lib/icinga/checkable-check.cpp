@@ -31,6 +31,11 @@
 #include "base/convert.hpp"
 #include "base/utility.hpp"
 #include "base/context.hpp"
+#include "base/application.hpp"
+#include "base/workqueue.hpp"
+#include "base/exception.hpp"
+#include "base/latencyhistogram.hpp"
+#include <boost/thread/once.hpp>
 
 using namespace icinga;
 
@@ -39,11 +44,34 @@ boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, St
 boost::signals2::signal<void (const Checkable::Ptr&, const CheckResult::Ptr&, std::set<Checkable::Ptr>, const MessageOrigin::Ptr&)> Checkable::OnReachabilityChanged;
 boost::signals2::signal<void (const Checkable::Ptr&, NotificationType, const CheckResult::Ptr&, const String&, const String&, const MessageOrigin::Ptr&)> Checkable::OnNotificationsRequested;
 boost::signals2::signal<void (const Checkable::Ptr&)> Checkable::OnNextCheckUpdated;
+boost::signals2::signal<void ()> Checkable::OnPendingChecksDecreased;
 
 boost::mutex Checkable::m_StatsMutex;
 int Checkable::m_PendingChecks = 0;
 boost::condition_variable Checkable::m_PendingChecksCV;
 
+static boost::once_flag l_PostProcessingQueuesOnce = BOOST_ONCE_INIT;
+static WorkQueue *l_PostProcessingQueues;
+static size_t l_PostProcessingQueueCount;
+
+/* The queues are created on first use rather than on startup, the
+ * concurrency isn't known before the configuration was loaded. */
+static void InitializePostProcessingQueues()
+{
+	boost::call_once(l_PostProcessingQueuesOnce, []() {
+		l_PostProcessingQueueCount = Application::GetConcurrency();
+		l_PostProcessingQueues = new WorkQueue[l_PostProcessingQueueCount];
+
+		for (size_t i = 0; i < l_PostProcessingQueueCount; i++) {
+			l_PostProcessingQueues[i].SetName("Checkable, post-processing #" + Convert::ToString(i));
+			l_PostProcessingQueues[i].SetExceptionCallback([](boost::exception_ptr exp) {
+				Log(LogCritical, "Checkable")
+					<< "Exception while processing check result: " << DiagnosticInformation(exp);
+			});
+		}
+	});
+}
+
 CheckCommand::Ptr Checkable::GetCheckCommand() const
 {
 	return dynamic_pointer_cast<CheckCommand>(NavigateCheckCommandRaw());
@@ -107,8 +135,12 @@ double Checkable::GetLastCheck() const
 	return schedule_end;
 }
 
+static LatencyHistogram l_ProcessCheckResultDuration("process_check_result");
+
 void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
 {
+	LatencyTimer timer(l_ProcessCheckResultDuration);
+
 	{
 		ObjectLock olock(this);
 		m_CheckRunning = false;
@@ -147,7 +179,7 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		if (listener) {
 			/* send message back to its origin */
 			Dictionary::Ptr message = ClusterEvents::MakeCheckResultMessage(this, cr);
-			listener->SyncSendMessage(command_endpoint, message);
+			ClusterEvents::SendAgentCheckResult(command_endpoint, message);
 		}
 
 		return;
@@ -188,8 +220,6 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 
 	long attempt = 1;
 
-	std::set<Checkable::Ptr> children = GetChildren();
-
 	if (IsStateOK(cr->GetState())) {
 		SetStateType(StateTypeHard); // NOT-OK -> HARD OK
 
@@ -198,10 +228,6 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 
 		ResetNotificationNumbers();
 		SaveLastState(ServiceOK, Utility::GetTime());
-
-		/* update reachability for child objects in OK state */
-		if (!children.empty())
-			OnReachabilityChanged(this, cr, children, origin);
 	} else {
 		/* OK -> NOT-OK change, first SOFT state. Reset attempt counter. */
 		if (IsStateOK(old_state)) {
@@ -224,10 +250,6 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		if (!IsStateOK(cr->GetState())) {
 			SaveLastState(cr->GetState(), Utility::GetTime());
 		}
-
-		/* update reachability for child objects in NOT-OK state */
-		if (!children.empty())
-			OnReachabilityChanged(this, cr, children, origin);
 	}
 
 	if (!reachable)
@@ -238,6 +260,14 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 	ServiceState new_state = cr->GetState();
 	SetStateRaw(new_state);
 
+	/* The reachability reported for the children only depends on whether this
+	 * checkable is OK. Check results which don't change that (e.g. during an
+	 * outage) don't need to update every child again. */
+	std::set<Checkable::Ptr> children;
+
+	if (IsStateOK(old_state) != IsStateOK(new_state))
+		children = GetChildren();
+
 	bool stateChange;
 
 	/* Exception on state change calculation for hosts. */
@@ -350,6 +380,10 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		SetNextCheck(Utility::GetTime() + offset, false, origin);
 	}
 
+	StateType new_stateType = GetStateType();
+
+	PublishStateSnapshot();
+
 	olock.Unlock();
 
 #ifdef I2_DEBUG /* I2_DEBUG */
@@ -362,58 +396,104 @@ void Checkable::ProcessCheckResult(const CheckResult::Ptr& cr, const MessageOrig
 		<< "% current: " << GetFlappingCurrent() << "%.";
 #endif /* I2_DEBUG */
 
-	OnNewCheckResult(this, cr, origin);
+	/* The state transition is complete at this point. Signal handlers (writers, IDO, cluster
+	 * relays, notifications) run on a post-processing queue so that slow subscribers don't
+	 * hold up check result ingestion. Results for the same checkable always end up on the
+	 * same queue which preserves their order. */
+	Checkable::Ptr self = this;
 
-	/* signal status updates to for example db_ido */
-	OnStateChanged(this);
+	GetPostProcessingQueue().Enqueue([self, this, cr, origin, children, checkableType, old_state, new_state, new_stateType,
+		stateChange, hardChange, recovery, is_volatile, in_downtime, was_flapping, is_flapping, send_notification]() {
+		/* update reachability for child objects */
+		if (!children.empty())
+			OnReachabilityChanged(this, cr, children, origin);
 
-	String old_state_str = (service ? Service::StateToString(old_state) : Host::StateToString(Host::CalculateState(old_state)));
-	String new_state_str = (service ? Service::StateToString(new_state) : Host::StateToString(Host::CalculateState(new_state)));
+		OnNewCheckResult(this, cr, origin);
 
-	/* Whether a hard state change or a volatile state change except OK -> OK happened. */
-	if (hardChange || (is_volatile && !(IsStateOK(old_state) && IsStateOK(new_state)))) {
-		OnStateChange(this, cr, StateTypeHard, origin);
-		Log(LogNotice, "Checkable")
-			<< "State Change: Checkable '" << GetName() << "' hard state change from " << old_state_str << " to " << new_state_str << " detected." << (is_volatile ? " Checkable is volatile." : "");
-	}
-	/* Whether a state change happened or the state type is SOFT (must be logged too). */
-	else if (stateChange || GetStateType() == StateTypeSoft) {
-		OnStateChange(this, cr, StateTypeSoft, origin);
-		Log(LogNotice, "Checkable")
-			<< "State Change: Checkable '" << GetName() << "' soft state change from " << old_state_str << " to " << new_state_str << " detected.";
-	}
+		/* signal status updates to for example db_ido */
+		OnStateChanged(this);
 
-	if (GetStateType() == StateTypeSoft || hardChange || recovery ||
-		(is_volatile && !(IsStateOK(old_state) && IsStateOK(new_state))))
-		ExecuteEventHandler();
+		String old_state_str = (checkableType == CheckableService ? Service::StateToString(old_state) : Host::StateToString(Host::CalculateState(old_state)));
+		String new_state_str = (checkableType == CheckableService ? Service::StateToString(new_state) : Host::StateToString(Host::CalculateState(new_state)));
 
-	/* Flapping start/end notifications */
-	if (!in_downtime && !was_flapping && is_flapping) {
-		/* FlappingStart notifications happen on state changes, not in downtimes */
-		if (!IsPaused())
-			OnNotificationsRequested(this, NotificationFlappingStart, cr, "", "", nullptr);
+		/* Whether a hard state change or a volatile state change except OK -> OK happened. */
+		if (hardChange || (is_volatile && !(IsStateOK(old_state) && IsStateOK(new_state)))) {
+			OnStateChange(this, cr, StateTypeHard, origin);
+			Log(LogNotice, "Checkable")
+				<< "State Change: Checkable '" << GetName() << "' hard state change from " << old_state_str << " to " << new_state_str << " detected." << (is_volatile ? " Checkable is volatile." : "");
+		}
+		/* Whether a state change happened or the state type is SOFT (must be logged too). */
+		else if (stateChange || new_stateType == StateTypeSoft) {
+			OnStateChange(this, cr, StateTypeSoft, origin);
+			Log(LogNotice, "Checkable")
+				<< "State Change: Checkable '" << GetName() << "' soft state change from " << old_state_str << " to " << new_state_str << " detected.";
+		}
 
-		Log(LogNotice, "Checkable")
-			<< "Flapping Start: Checkable '" << GetName() << "' started flapping (Current flapping value "
-			<< GetFlappingCurrent() << "% > high threshold " << GetFlappingThresholdHigh() << "%).";
+		if (new_stateType == StateTypeSoft || hardChange || recovery ||
+			(is_volatile && !(IsStateOK(old_state) && IsStateOK(new_state))))
+			QueueEventHandler();
 
-		NotifyFlapping(origin);
-	} else if (!in_downtime && was_flapping && !is_flapping) {
-		/* FlappingEnd notifications are independent from state changes, must not happen in downtine */
-		if (!IsPaused())
-			OnNotificationsRequested(this, NotificationFlappingEnd, cr, "", "", nullptr);
+		/* Flapping start/end notifications */
+		if (!in_downtime && !was_flapping && is_flapping) {
+			/* FlappingStart notifications happen on state changes, not in downtimes */
+			if (!IsPaused())
+				OnNotificationsRequested(this, NotificationFlappingStart, cr, "", "", nullptr);
 
-		Log(LogNotice, "Checkable")
-			<< "Flapping Stop: Checkable '" << GetName() << "' stopped flapping (Current flapping value "
-			<< GetFlappingCurrent() << "% < low threshold " << GetFlappingThresholdLow() << "%).";
+			Log(LogNotice, "Checkable")
+				<< "Flapping Start: Checkable '" << GetName() << "' started flapping (Current flapping value "
+				<< GetFlappingCurrent() << "% > high threshold " << GetFlappingThresholdHigh() << "%).";
 
-		NotifyFlapping(origin);
-	}
+			NotifyFlapping(origin);
+		} else if (!in_downtime && was_flapping && !is_flapping) {
+			/* FlappingEnd notifications are independent from state changes, must not happen in downtine */
+			if (!IsPaused())
+				OnNotificationsRequested(this, NotificationFlappingEnd, cr, "", "", nullptr);
 
-	if (send_notification && !is_flapping) {
-		if (!IsPaused())
-			OnNotificationsRequested(this, recovery ? NotificationRecovery : NotificationProblem, cr, "", "", nullptr);
-	}
+			Log(LogNotice, "Checkable")
+				<< "Flapping Stop: Checkable '" << GetName() << "' stopped flapping (Current flapping value "
+				<< GetFlappingCurrent() << "% < low threshold " << GetFlappingThresholdLow() << "%).";
+
+			NotifyFlapping(origin);
+		}
+
+		if (send_notification && !is_flapping) {
+			if (!IsPaused())
+				OnNotificationsRequested(this, recovery ? NotificationRecovery : NotificationProblem, cr, "", "", nullptr);
+		}
+	});
+}
+
+/**
+ * Returns the queue which runs the signal handlers for this checkable's check results.
+ */
+WorkQueue& Checkable::GetPostProcessingQueue() const
+{
+	InitializePostProcessingQueues();
+
+	return l_PostProcessingQueues[(reinterpret_cast<uintptr_t>(this) / sizeof(Checkable)) % l_PostProcessingQueueCount];
+}
+
+/**
+ * Waits until all check results which were processed so far have been post-processed.
+ */
+void Checkable::WaitForPostProcessing()
+{
+	InitializePostProcessingQueues();
+
+	for (size_t i = 0; i < l_PostProcessingQueueCount; i++)
+		l_PostProcessingQueues[i].Join();
+}
+
+size_t Checkable::GetPostProcessingQueueLength()
+{
+	InitializePostProcessingQueues();
+
+	size_t itemCount = 0;
+
+	for (size_t i = 0; i < l_PostProcessingQueueCount; i++)
+		itemCount += l_PostProcessingQueues[i].GetLength();
+
+	return itemCount;
 }
 
 void Checkable::ExecuteRemoteCheck(const Dictionary::Ptr& resolvedMacros)
@@ -434,6 +514,12 @@ void Checkable::ExecuteCheck()
 {
 	CONTEXT("Executing check for object '" + GetName() + "'");
 
+	/* The command endpoint runs this check on its own and sends us the check results. */
+	if (ClusterEvents::IsScheduledByAgent(this)) {
+		UpdateNextCheck();
+		return;
+	}
+
 	/* keep track of scheduling info in case the check type doesn't provide its own information */
 	double scheduled_start = GetNextCheck();
 	double before_check = Utility::GetTime();
@@ -495,10 +581,7 @@ void Checkable::ExecuteCheck()
 
 			params->Set("macros", macros);
 
-			ApiListener::Ptr listener = ApiListener::GetInstance();
-
-			if (listener)
-				listener->SyncSendMessage(endpoint, message);
+			ClusterEvents::SendExecuteCommand(endpoint, message);
 
 			/* Re-schedule the check so we don't run it again until after we've received
 			 * a check result from the remote instance. The check will be re-scheduled
@@ -557,9 +640,13 @@ void Checkable::IncreasePendingChecks()
 
 void Checkable::DecreasePendingChecks()
 {
-	boost::mutex::scoped_lock lock(m_StatsMutex);
-	m_PendingChecks--;
-	m_PendingChecksCV.notify_one();
+	{
+		boost::mutex::scoped_lock lock(m_StatsMutex);
+		m_PendingChecks--;
+		m_PendingChecksCV.notify_one();
+	}
+
+	OnPendingChecksDecreased();
 }
 
 int Checkable::GetPendingChecks()
@@ -568,6 +655,33 @@ int Checkable::GetPendingChecks()
 	return m_PendingChecks;
 }
 
+/**
+ * Counts a check as pending unless there are already maxPendingChecks.
+ *
+ * @returns Whether the slot was acquired.
+ */
+bool Checkable::TryAquirePendingCheckSlot(int maxPendingChecks)
+{
+	boost::mutex::scoped_lock lock(m_StatsMutex);
+
+	if (m_PendingChecks >= maxPendingChecks)
+		return false;
+
+	m_PendingChecks++;
+	return true;
+}
+
+/**
+ * Gives back a slot which was acquired but not used for a check. Unlike
+ * DecreasePendingChecks() this doesn't raise OnPendingChecksDecreased.
+ */
+void Checkable::ReleasePendingCheckSlot()
+{
+	boost::mutex::scoped_lock lock(m_StatsMutex);
+	m_PendingChecks--;
+	m_PendingChecksCV.notify_one();
+}
+
 void Checkable::AquirePendingCheckSlot(int maxPendingChecks)
 {
 	boost::mutex::scoped_lock lock(m_StatsMutex);
@@ -49,18 +49,18 @@ void Checkable::RemoveCommentsByType(int type)
 
 std::set<Comment::Ptr> Checkable::GetComments() const
 {
-	boost::mutex::scoped_lock lock(m_CommentMutex);
-	return m_Comments;
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	return m_Comments.ToSet();
 }
 
 void Checkable::RegisterComment(const Comment::Ptr& comment)
 {
-	boost::mutex::scoped_lock lock(m_CommentMutex);
-	m_Comments.insert(comment);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_Comments.Insert(comment);
 }
 
 void Checkable::UnregisterComment(const Comment::Ptr& comment)
 {
-	boost::mutex::scoped_lock lock(m_CommentMutex);
-	m_Comments.erase(comment);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_Comments.Erase(comment);
 }
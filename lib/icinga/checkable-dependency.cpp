@@ -19,86 +19,213 @@
 
 #include "icinga/service.hpp"
 #include "icinga/dependency.hpp"
+#include "icinga/cib.hpp"
 #include "base/logger.hpp"
 
 using namespace icinga;
 
 void Checkable::AddDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_Dependencies.insert(dep);
+	{
+		boost::mutex::scoped_lock lock(m_RelationsMutex);
+		m_Dependencies.Insert(dep);
+	}
+
+	InvalidateReachability();
 }
 
 void Checkable::RemoveDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_Dependencies.erase(dep);
+	{
+		boost::mutex::scoped_lock lock(m_RelationsMutex);
+		m_Dependencies.Erase(dep);
+	}
+
+	InvalidateReachability();
 }
 
 std::vector<Dependency::Ptr> Checkable::GetDependencies() const
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	return std::vector<Dependency::Ptr>(m_Dependencies.begin(), m_Dependencies.end());
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	return m_Dependencies.ToVector();
 }
 
 void Checkable::AddReverseDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_ReverseDependencies.insert(dep);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_ReverseDependencies.Insert(dep);
 }
 
 void Checkable::RemoveReverseDependency(const Dependency::Ptr& dep)
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	m_ReverseDependencies.erase(dep);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_ReverseDependencies.Erase(dep);
 }
 
 std::vector<Dependency::Ptr> Checkable::GetReverseDependencies() const
 {
-	boost::mutex::scoped_lock lock(m_DependencyMutex);
-	return std::vector<Dependency::Ptr>(m_ReverseDependencies.begin(), m_ReverseDependencies.end());
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	return m_ReverseDependencies.ToVector();
 }
 
 bool Checkable::IsReachable(DependencyType dt, Dependency::Ptr *failedDependency, int rstack) const
+{
+	bool cacheable;
+	return IsReachableInternal(dt, failedDependency, rstack, &cacheable);
+}
+
+/**
+ * Evaluates the reachability and caches the result. Results which depend on
+ * the current time (i.e. dependencies with a time period) are not cached.
+ */
+bool Checkable::IsReachableInternal(DependencyType dt, Dependency::Ptr *failedDependency, int rstack, bool *cacheable) const
 {
 	if (rstack > 20) {
 		Log(LogWarning, "Checkable")
 			<< "Too many nested dependencies for service '" << GetName() << "': Dependency failed.";
 
+		*cacheable = false;
 		return false;
 	}
 
+	unsigned long generation;
+
+	{
+		boost::mutex::scoped_lock lock(m_ReachabilityMutex);
+
+		const ReachabilityCacheEntry& entry = m_ReachabilityCache[dt];
+
+		if (entry.Valid) {
+			if (failedDependency)
+				*failedDependency = entry.FailedDependency;
+
+			*cacheable = true;
+			return entry.Reachable;
+		}
+
+		generation = m_ReachabilityGeneration;
+	}
+
+	bool reachable = true;
+	Dependency::Ptr failed;
+
+	*cacheable = true;
+
 	for (const Checkable::Ptr& checkable : GetParents()) {
-		if (!checkable->IsReachable(dt, failedDependency, rstack + 1))
-			return false;
+		bool parentCacheable;
+
+		if (!checkable->IsReachableInternal(dt, &failed, rstack + 1, &parentCacheable))
+			reachable = false;
+
+		if (!parentCacheable)
+			*cacheable = false;
+
+		if (!reachable)
+			break;
 	}
 
 	/* implicit dependency on host if this is a service */
 	const auto *service = dynamic_cast<const Service *>(this);
-	if (service && (dt == DependencyState || dt == DependencyNotification)) {
+	if (reachable && service && (dt == DependencyState || dt == DependencyNotification)) {
 		Host::Ptr host = service->GetHost();
 
 		if (host && host->GetState() != HostUp && host->GetStateType() == StateTypeHard) {
-			if (failedDependency)
-				*failedDependency = nullptr;
+			failed = nullptr;
+			reachable = false;
+		}
+	}
+
+	if (reachable) {
+		for (const Dependency::Ptr& dep : GetDependencies()) {
+			if (dep->GetPeriod())
+				*cacheable = false;
 
-			return false;
+			if (!dep->IsAvailable(dt)) {
+				failed = dep;
+				reachable = false;
+				break;
+			}
 		}
 	}
 
-	for (const Dependency::Ptr& dep : GetDependencies()) {
-		if (!dep->IsAvailable(dt)) {
-			if (failedDependency)
-				*failedDependency = dep;
+	if (reachable)
+		failed = nullptr;
+
+	if (*cacheable) {
+		boost::mutex::scoped_lock lock(m_ReachabilityMutex);
 
-			return false;
+		/* Don't store the result if a parent's state changed while evaluating it. */
+		if (generation == m_ReachabilityGeneration) {
+			ReachabilityCacheEntry& entry = m_ReachabilityCache[dt];
+			entry.Valid = true;
+			entry.Reachable = reachable;
+			entry.FailedDependency = failed;
 		}
 	}
 
 	if (failedDependency)
-		*failedDependency = nullptr;
+		*failedDependency = failed;
 
-	return true;
+	return reachable;
+}
+
+/**
+ * Invalidates the cached reachability of this checkable and everything which
+ * depends on it, either explicitly or (for services) through their host.
+ */
+void Checkable::InvalidateReachability()
+{
+	std::set<Checkable *> seen;
+	std::vector<Checkable::Ptr> pending { this };
+	std::vector<Checkable::Ptr> invalidated;
+
+	while (!pending.empty()) {
+		Checkable::Ptr checkable = pending.back();
+		pending.pop_back();
+
+		if (!seen.insert(checkable.get()).second)
+			continue;
+
+		invalidated.push_back(checkable);
+
+		{
+			boost::mutex::scoped_lock lock(checkable->m_ReachabilityMutex);
+
+			checkable->m_ReachabilityGeneration++;
+
+			for (ReachabilityCacheEntry& entry : checkable->m_ReachabilityCache) {
+				entry.Valid = false;
+				entry.FailedDependency = nullptr;
+			}
+		}
+
+		for (const Checkable::Ptr& child : checkable->GetChildren())
+			pending.push_back(child);
+
+		auto *host = dynamic_cast<Host *>(checkable.get());
+
+		if (host) {
+			for (const Service::Ptr& service : host->GetServiceView())
+				pending.push_back(service);
+		}
+	}
+
+	/* The unreachable counters depend on the cached reachability. */
+	for (const Checkable::Ptr& checkable : invalidated)
+		CIB::UpdateCheckableStats(checkable);
+}
+
+/**
+ * Called whenever one of the attributes the reachability of child objects
+ * depends on is set. Children are only invalidated if the state, state type
+ * or pending status actually changed.
+ */
+void Checkable::ReachabilityInputsChangedHandler(const Checkable::Ptr& checkable)
+{
+	int inputs = checkable->GetStateRaw() | (checkable->GetStateType() << 8) | (checkable->GetLastCheckResult() ? 1 << 16 : 0);
+
+	if (checkable->m_ReachabilityInputs.exchange(inputs) != inputs)
+		checkable->InvalidateReachability();
 }
 
 std::set<Checkable::Ptr> Checkable::GetParents() const
@@ -129,32 +256,28 @@ std::set<Checkable::Ptr> Checkable::GetChildren() const
 	return parents;
 }
 
+/**
+ * Returns all direct and indirect children. The dependency graph is walked
+ * breadth-first so that every child is only expanded once, even if it is
+ * reachable through several paths.
+ */
 std::set<Checkable::Ptr> Checkable::GetAllChildren() const
 {
 	std::set<Checkable::Ptr> children = GetChildren();
+	std::vector<Checkable::Ptr> level(children.begin(), children.end());
 
-	GetAllChildrenInternal(children, 0);
-
-	return children;
-}
-
-void Checkable::GetAllChildrenInternal(std::set<Checkable::Ptr>& children, int level) const
-{
-	if (level > 32)
-		return;
+	for (int depth = 0; depth < 32 && !level.empty(); depth++) {
+		std::vector<Checkable::Ptr> next;
 
-	std::set<Checkable::Ptr> localChildren;
-
-	for (const Checkable::Ptr& checkable : children) {
-		std::set<Checkable::Ptr> cChildren = checkable->GetChildren();
-
-		if (!cChildren.empty()) {
-			GetAllChildrenInternal(cChildren, level + 1);
-			localChildren.insert(cChildren.begin(), cChildren.end());
+		for (const Checkable::Ptr& checkable : level) {
+			for (const Checkable::Ptr& child : checkable->GetChildren()) {
+				if (child.get() != this && children.insert(child).second)
+					next.push_back(child);
+			}
 		}
 
-		localChildren.insert(checkable);
+		level.swap(next);
 	}
 
-	children.insert(localChildren.begin(), localChildren.end());
+	return children;
 }
@@ -23,6 +23,7 @@
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/convert.hpp"
+#include <limits>
 
 using namespace icinga;
 
@@ -42,40 +43,96 @@ void Checkable::TriggerDowntimes()
 
 bool Checkable::IsInDowntime() const
 {
-	for (const Downtime::Ptr& downtime : GetDowntimes()) {
-		if (downtime->IsInEffect())
-			return true;
+	return GetDowntimeDepth() > 0;
+}
+
+/**
+ * Checks whether a downtime is in effect, like Downtime::IsInEffect() does,
+ * and lowers validUntil to the next time at which this might change.
+ */
+static bool IsDowntimeInEffect(const Downtime::Ptr& downtime, double now, double *validUntil)
+{
+	double end;
+
+	if (downtime->GetFixed()) {
+		double start = downtime->GetStartTime();
+
+		if (now < start) {
+			*validUntil = std::min(*validUntil, start);
+			return false;
+		}
+
+		end = downtime->GetEndTime();
+	} else {
+		double triggerTime = downtime->GetTriggerTime();
+
+		/* Triggering the downtime invalidates the cached depth. */
+		if (triggerTime == 0)
+			return false;
+
+		end = triggerTime + downtime->GetDuration();
+	}
+
+	if (now < end) {
+		*validUntil = std::min(*validUntil, end);
+		return true;
 	}
 
 	return false;
 }
 
+/**
+ * Returns the number of downtimes which are currently in effect. The result
+ * is cached until the next downtime starts or ends.
+ */
 int Checkable::GetDowntimeDepth() const
 {
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+
+	if (now < m_DowntimeDepthValidUntil)
+		return m_DowntimeDepth;
+
 	int downtime_depth = 0;
+	double validUntil = std::numeric_limits<double>::infinity();
 
-	for (const Downtime::Ptr& downtime : GetDowntimes()) {
-		if (downtime->IsInEffect())
+	for (const Downtime::Ptr& downtime : m_Downtimes) {
+		if (IsDowntimeInEffect(downtime, now, &validUntil))
 			downtime_depth++;
 	}
 
+	m_DowntimeDepth = downtime_depth;
+	m_DowntimeDepthValidUntil = validUntil;
+
 	return downtime_depth;
 }
 
 std::set<Downtime::Ptr> Checkable::GetDowntimes() const
 {
-	boost::mutex::scoped_lock lock(m_DowntimeMutex);
-	return m_Downtimes;
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	return m_Downtimes.ToSet();
 }
 
 void Checkable::RegisterDowntime(const Downtime::Ptr& downtime)
 {
-	boost::mutex::scoped_lock lock(m_DowntimeMutex);
-	m_Downtimes.insert(downtime);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_Downtimes.Insert(downtime);
+	m_DowntimeDepthValidUntil = -1;
 }
 
 void Checkable::UnregisterDowntime(const Downtime::Ptr& downtime)
 {
-	boost::mutex::scoped_lock lock(m_DowntimeMutex);
-	m_Downtimes.erase(downtime);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_Downtimes.Erase(downtime);
+	m_DowntimeDepthValidUntil = -1;
+}
+
+/**
+ * Discards the cached downtime depth, e.g. after a downtime was triggered.
+ */
+void Checkable::InvalidateDowntimeDepth()
+{
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_DowntimeDepthValidUntil = -1;
 }
@@ -24,11 +24,57 @@
 #include "remote/apilistener.hpp"
 #include "base/logger.hpp"
 #include "base/context.hpp"
+#include "base/initialize.hpp"
+#include "base/scriptglobal.hpp"
+#include "base/utility.hpp"
+#include "base/workqueue.hpp"
+#include "base/exception.hpp"
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
 
 using namespace icinga;
 
 boost::signals2::signal<void (const Checkable::Ptr&)> Checkable::OnEventCommandExecuted;
 
+static WorkQueue *l_EventHandlerQueue;
+static boost::mutex l_EventHandlerMutex;
+static std::unordered_set<Checkable *> l_PendingEventHandlers;
+static double l_NextEventHandlerSlot = 0;
+static std::atomic<uint64_t> l_EventHandlersExecuted(0);
+static std::atomic<uint64_t> l_EventHandlersCoalesced(0);
+static std::atomic<uint64_t> l_EventHandlersDropped(0);
+
+INITIALIZE_ONCE([]() {
+	l_EventHandlerQueue = new WorkQueue();
+	l_EventHandlerQueue->SetName("Checkable, event handlers");
+	l_EventHandlerQueue->SetExceptionCallback([](boost::exception_ptr exp) {
+		Log(LogCritical, "Checkable")
+			<< "Exception while executing event handler: " << DiagnosticInformation(exp);
+	});
+});
+
+/**
+ * Limits the rate at which event handlers are started. Only called
+ * from the event handler queue's (single) worker thread.
+ */
+static void WaitForEventHandlerSlot()
+{
+	Value defaultRate = 0;
+	double rate = ScriptGlobal::Get("MaxEventHandlersPerSecond", &defaultRate);
+
+	if (rate <= 0)
+		return;
+
+	double now = Utility::GetTime();
+	double slot = std::max(l_NextEventHandlerSlot, now);
+
+	l_NextEventHandlerSlot = slot + 1.0 / rate;
+
+	if (slot > now)
+		Utility::Sleep(slot - now);
+}
+
 EventCommand::Ptr Checkable::GetEventCommand() const
 {
 	return EventCommand::GetByName(GetEventCommandRaw());
@@ -96,3 +142,72 @@ void Checkable::ExecuteEventHandler(const Dictionary::Ptr& resolvedMacros, bool
 
 	OnEventCommandExecuted(this);
 }
+
+/**
+ * Queues the event handler for asynchronous execution. While an event handler
+ * is waiting in the queue further requests for the same checkable are merged
+ * into it; macros are resolved when the event handler is actually executed.
+ */
+void Checkable::QueueEventHandler()
+{
+	if (!IcingaApplication::GetInstance()->GetEnableEventHandlers() || !GetEnableEventHandler() || !GetEventCommand())
+		return;
+
+	{
+		boost::mutex::scoped_lock lock(l_EventHandlerMutex);
+
+		if (l_PendingEventHandlers.find(this) != l_PendingEventHandlers.end()) {
+			l_EventHandlersCoalesced++;
+			return;
+		}
+
+		Value defaultMaxPending = 10000;
+		int maxPending = ScriptGlobal::Get("MaxPendingEventHandlers", &defaultMaxPending);
+
+		if (maxPending > 0 && l_PendingEventHandlers.size() >= static_cast<size_t>(maxPending)) {
+			l_EventHandlersDropped++;
+
+			Log(LogWarning, "Checkable")
+				<< "Too many pending event handlers (" << l_PendingEventHandlers.size()
+				<< "). Dropping event handler for checkable '" << GetName() << "'.";
+			return;
+		}
+
+		l_PendingEventHandlers.insert(this);
+	}
+
+	Checkable::Ptr self = this;
+
+	l_EventHandlerQueue->Enqueue([self]() {
+		{
+			boost::mutex::scoped_lock lock(l_EventHandlerMutex);
+			l_PendingEventHandlers.erase(self.get());
+		}
+
+		WaitForEventHandlerSlot();
+
+		self->ExecuteEventHandler();
+
+		l_EventHandlersExecuted++;
+	});
+}
+
+size_t Checkable::GetEventHandlerQueueLength()
+{
+	return l_EventHandlerQueue->GetLength();
+}
+
+uint64_t Checkable::GetEventHandlersExecuted()
+{
+	return l_EventHandlersExecuted;
+}
+
+uint64_t Checkable::GetEventHandlersCoalesced()
+{
+	return l_EventHandlersCoalesced;
+}
+
+uint64_t Checkable::GetEventHandlersDropped()
+{
+	return l_EventHandlersDropped;
+}
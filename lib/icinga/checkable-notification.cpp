@@ -84,18 +84,18 @@ void Checkable::SendNotifications(NotificationType type, const CheckResult::Ptr&
 
 std::set<Notification::Ptr> Checkable::GetNotifications() const
 {
-	boost::mutex::scoped_lock lock(m_NotificationMutex);
-	return m_Notifications;
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	return m_Notifications.ToSet();
 }
 
 void Checkable::RegisterNotification(const Notification::Ptr& notification)
 {
-	boost::mutex::scoped_lock lock(m_NotificationMutex);
-	m_Notifications.insert(notification);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_Notifications.Insert(notification);
 }
 
 void Checkable::UnregisterNotification(const Notification::Ptr& notification)
 {
-	boost::mutex::scoped_lock lock(m_NotificationMutex);
-	m_Notifications.erase(notification);
+	boost::mutex::scoped_lock lock(m_RelationsMutex);
+	m_Notifications.Erase(notification);
 }
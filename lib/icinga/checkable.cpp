@@ -24,6 +24,7 @@
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/exception.hpp"
+#include <algorithm>
 
 using namespace icinga;
 
@@ -41,6 +42,15 @@ void Checkable::StaticInitialize()
 	Downtime::OnDowntimeTriggered.connect(std::bind(&Checkable::NotifyFlexibleDowntimeStart, _1));
 	/* fixed/flexible downtime end */
 	Downtime::OnDowntimeRemoved.connect(std::bind(&Checkable::NotifyDowntimeEnd, _1));
+
+	/* invalidate the cached reachability of child objects */
+	Checkable::OnStateRawChanged.connect(std::bind(&Checkable::ReachabilityInputsChangedHandler, _1));
+	Checkable::OnStateTypeChanged.connect(std::bind(&Checkable::ReachabilityInputsChangedHandler, _1));
+	Checkable::OnLastCheckResultChanged.connect(std::bind(&Checkable::ReachabilityInputsChangedHandler, _1));
+
+	/* acknowledgements are changed outside of ProcessCheckResult() */
+	Checkable::OnAcknowledgementRawChanged.connect(std::bind(&Checkable::StateSnapshotChangedHandler, _1));
+	Checkable::OnAcknowledgementExpiryChanged.connect(std::bind(&Checkable::StateSnapshotChangedHandler, _1));
 }
 
 Checkable::Checkable()
@@ -124,6 +134,73 @@ bool Checkable::IsAcknowledged() const
 	return const_cast<Checkable *>(this)->GetAcknowledgement() != AcknowledgementNone;
 }
 
+/**
+ * Returns a consistent copy of the checkable's state attributes. This only
+ * takes the object lock if there is no current snapshot yet.
+ */
+CheckableStateSnapshot::Ptr Checkable::GetStateSnapshot() const
+{
+	{
+		boost::mutex::scoped_lock lock(m_StateSnapshotMutex);
+
+		if (m_StateSnapshot)
+			return m_StateSnapshot;
+	}
+
+	ObjectLock olock(this);
+	return PublishStateSnapshot();
+}
+
+/**
+ * Replaces the state snapshot. The caller must hold the object lock.
+ */
+CheckableStateSnapshot::Ptr Checkable::PublishStateSnapshot() const
+{
+	ASSERT(OwnsLock());
+
+	CheckableStateSnapshot::Ptr snapshot = new CheckableStateSnapshot();
+	snapshot->StateRaw = GetStateRaw();
+	snapshot->LastStateRaw = GetLastStateRaw();
+	snapshot->LastHardStateRaw = GetLastHardStateRaw();
+	snapshot->CurrentStateType = GetStateType();
+	snapshot->LastStateType = GetLastStateType();
+	snapshot->CheckAttempt = GetCheckAttempt();
+	snapshot->LastCheckResult = GetLastCheckResult();
+	snapshot->LastStateChange = GetLastStateChange();
+	snapshot->LastHardStateChange = GetLastHardStateChange();
+	snapshot->AcknowledgementRaw = static_cast<AcknowledgementType>(GetAcknowledgementRaw());
+	snapshot->AcknowledgementExpiry = GetAcknowledgementExpiry();
+	snapshot->Flapping = IsFlapping();
+
+	boost::mutex::scoped_lock lock(m_StateSnapshotMutex);
+	m_StateSnapshot = snapshot;
+
+	return snapshot;
+}
+
+void Checkable::StateSnapshotChangedHandler(const Checkable::Ptr& checkable)
+{
+	/* The next reader builds a new snapshot. */
+	boost::mutex::scoped_lock lock(checkable->m_StateSnapshotMutex);
+	checkable->m_StateSnapshot = nullptr;
+}
+
+/**
+ * Returns the acknowledgement type, taking the expiry into account.
+ */
+AcknowledgementType CheckableStateSnapshot::GetAcknowledgement() const
+{
+	if (AcknowledgementRaw != AcknowledgementNone && AcknowledgementExpiry != 0 && AcknowledgementExpiry < Utility::GetTime())
+		return AcknowledgementNone;
+
+	return AcknowledgementRaw;
+}
+
+bool CheckableStateSnapshot::IsAcknowledged() const
+{
+	return GetAcknowledgement() != AcknowledgementNone;
+}
+
 void Checkable::AcknowledgeProblem(const String& author, const String& comment, AcknowledgementType type, bool notify, bool persistent, double expiry, const MessageOrigin::Ptr& origin)
 {
 	SetAcknowledgementRaw(type);
@@ -154,6 +231,25 @@ int Checkable::GetSeverity() const
 	return 0;
 }
 
+/**
+ * Estimates the load of the active checks from the execution time of the
+ * last check and the check interval. Checks which run on a command endpoint
+ * don't cost the local endpoint anything.
+ */
+double Checkable::GetLoadEstimate() const
+{
+	if (!GetEnableActiveChecks() || GetCommandEndpoint())
+		return 0;
+
+	CheckResult::Ptr cr = GetLastCheckResult();
+	double interval = GetCheckInterval();
+
+	if (!cr || interval <= 0)
+		return 0;
+
+	return cr->CalculateExecutionTime() / interval;
+}
+
 void Checkable::NotifyFixedDowntimeStart(const Downtime::Ptr& downtime)
 {
 	if (!downtime->GetFixed())
@@ -205,3 +301,97 @@ void Checkable::ValidateMaxCheckAttempts(const Lazy<int>& lvalue, const Validati
 	if (lvalue() <= 0)
 		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_check_attempts" }, "Value must be greater than 0."));
 }
+
+CheckableStateCounts& CheckableStateCounts::operator+=(const CheckableStateCounts& other)
+{
+	Total += other.Total;
+	Pending += other.Pending;
+
+	for (int state = 0; state < 4; state++) {
+		States[state] += other.States[state];
+		HardStates[state] += other.HardStates[state];
+	}
+
+	return *this;
+}
+
+/**
+ * Encodes the attributes the counts are based on.
+ */
+int CheckableStateHistogram::GetKey(const Checkable::Ptr& checkable)
+{
+	int state = std::min(std::max<int>(checkable->GetStateRaw(), ServiceOK), ServiceUnknown);
+	int hard = checkable->GetStateType() == StateTypeHard ? 1 : 0;
+	int pending = checkable->GetLastCheckResult() ? 0 : 1;
+
+	return state | (hard << 2) | (pending << 3);
+}
+
+void CheckableStateHistogram::Add(const Checkable::Ptr& checkable)
+{
+	auto it = m_Keys.find(checkable.get());
+
+	if (it != m_Keys.end())
+		return;
+
+	int key = GetKey(checkable);
+	m_Keys[checkable.get()] = key;
+	m_Counts[key]++;
+}
+
+void CheckableStateHistogram::Remove(const Checkable::Ptr& checkable)
+{
+	auto it = m_Keys.find(checkable.get());
+
+	if (it == m_Keys.end())
+		return;
+
+	m_Counts[it->second]--;
+	m_Keys.erase(it);
+}
+
+/**
+ * Updates the counts after one of the attributes they're based on has
+ * changed. Checkables which weren't added are ignored.
+ */
+void CheckableStateHistogram::Update(const Checkable::Ptr& checkable)
+{
+	auto it = m_Keys.find(checkable.get());
+
+	if (it == m_Keys.end())
+		return;
+
+	int key = GetKey(checkable);
+
+	if (key == it->second)
+		return;
+
+	m_Counts[it->second]--;
+	m_Counts[key]++;
+	it->second = key;
+}
+
+CheckableStateCounts CheckableStateHistogram::GetCounts() const
+{
+	CheckableStateCounts counts;
+
+	for (int key = 0; key < 16; key++) {
+		int count = m_Counts[key];
+
+		if (count == 0)
+			continue;
+
+		int state = key & 3;
+
+		counts.Total += count;
+		counts.States[state] += count;
+
+		if (key & 4)
+			counts.HardStates[state] += count;
+
+		if (key & 8)
+			counts.Pending += count;
+	}
+
+	return counts;
+}
@@ -28,6 +28,9 @@
 #include "icinga/downtime.hpp"
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
+#include "base/flatset.hpp"
+#include <atomic>
+#include <unordered_map>
 
 namespace icinga
 {
@@ -72,6 +75,34 @@ enum SeverityFlag
 class CheckCommand;
 class EventCommand;
 class Dependency;
+class WorkQueue;
+
+/**
+ * An immutable copy of the state attributes of a checkable. Readers get a
+ * consistent view of these attributes without taking the object lock.
+ *
+ * @ingroup icinga
+ */
+struct CheckableStateSnapshot final : public Object
+{
+	DECLARE_PTR_TYPEDEFS(CheckableStateSnapshot);
+
+	ServiceState StateRaw;
+	ServiceState LastStateRaw;
+	ServiceState LastHardStateRaw;
+	StateType CurrentStateType;
+	StateType LastStateType;
+	int CheckAttempt;
+	CheckResult::Ptr LastCheckResult;
+	double LastStateChange;
+	double LastHardStateChange;
+	AcknowledgementType AcknowledgementRaw;
+	double AcknowledgementExpiry;
+	bool Flapping;
+
+	AcknowledgementType GetAcknowledgement() const;
+	bool IsAcknowledged() const;
+};
 
 /**
  * An Icinga service.
@@ -98,10 +129,13 @@ public:
 
 	AcknowledgementType GetAcknowledgement();
 
+	CheckableStateSnapshot::Ptr GetStateSnapshot() const;
+
 	void AcknowledgeProblem(const String& author, const String& comment, AcknowledgementType type, bool notify = true, bool persistent = false, double expiry = 0, const MessageOrigin::Ptr& origin = nullptr);
 	void ClearAcknowledgement(const MessageOrigin::Ptr& origin = nullptr);
 
 	int GetSeverity() const override;
+	double GetLoadEstimate() const override;
 
 	/* Checks */
 	intrusive_ptr<CheckCommand> GetCheckCommand() const;
@@ -143,6 +177,7 @@ public:
 	static boost::signals2::signal<void (const Checkable::Ptr&, const MessageOrigin::Ptr&)> OnAcknowledgementCleared;
 	static boost::signals2::signal<void (const Checkable::Ptr&)> OnNextCheckUpdated;
 	static boost::signals2::signal<void (const Checkable::Ptr&)> OnEventCommandExecuted;
+	static boost::signals2::signal<void ()> OnPendingChecksDecreased;
 
 	/* Downtimes */
 	int GetDowntimeDepth() const final;
@@ -155,6 +190,7 @@ public:
 	std::set<Downtime::Ptr> GetDowntimes() const;
 	void RegisterDowntime(const Downtime::Ptr& downtime);
 	void UnregisterDowntime(const Downtime::Ptr& downtime);
+	void InvalidateDowntimeDepth();
 
 	/* Comments */
 	void RemoveAllComments();
@@ -176,6 +212,7 @@ public:
 	/* Event Handler */
 	void ExecuteEventHandler(const Dictionary::Ptr& resolvedMacros = nullptr,
 		bool useResolvedMacros = false);
+	void QueueEventHandler();
 
 	intrusive_ptr<EventCommand> GetEventCommand() const;
 
@@ -198,6 +235,16 @@ public:
 	static void DecreasePendingChecks();
 	static int GetPendingChecks();
 	static void AquirePendingCheckSlot(int maxPendingChecks);
+	static bool TryAquirePendingCheckSlot(int maxPendingChecks);
+	static void ReleasePendingCheckSlot();
+
+	static void WaitForPostProcessing();
+	static size_t GetPostProcessingQueueLength();
+
+	static size_t GetEventHandlerQueueLength();
+	static uint64_t GetEventHandlersExecuted();
+	static uint64_t GetEventHandlersCoalesced();
+	static uint64_t GetEventHandlersDropped();
 
 	static Object::Ptr GetPrototype();
 
@@ -214,9 +261,23 @@ private:
 	static int m_PendingChecks;
 	static boost::condition_variable m_PendingChecksCV;
 
+	WorkQueue& GetPostProcessingQueue() const;
+
+	/* State snapshot, replaced whenever a check result was processed */
+	mutable boost::mutex m_StateSnapshotMutex;
+	mutable CheckableStateSnapshot::Ptr m_StateSnapshot;
+
+	CheckableStateSnapshot::Ptr PublishStateSnapshot() const;
+	static void StateSnapshotChangedHandler(const Checkable::Ptr& checkable);
+
+	/* Downtimes, comments, notifications and dependencies. Most checkables
+	 * have none or only a few of them, they share a single mutex. */
+	mutable boost::mutex m_RelationsMutex;
+
 	/* Downtimes */
-	std::set<Downtime::Ptr> m_Downtimes;
-	mutable boost::mutex m_DowntimeMutex;
+	FlatSet<Downtime::Ptr> m_Downtimes;
+	mutable int m_DowntimeDepth{0};
+	mutable double m_DowntimeDepthValidUntil{-1}; /**< The cached depth is valid until this timestamp. */
 
 	static void NotifyFixedDowntimeStart(const Downtime::Ptr& downtime);
 	static void NotifyFlexibleDowntimeStart(const Downtime::Ptr& downtime);
@@ -225,24 +286,75 @@ private:
 	static void NotifyDowntimeEnd(const Downtime::Ptr& downtime);
 
 	/* Comments */
-	std::set<Comment::Ptr> m_Comments;
-	mutable boost::mutex m_CommentMutex;
+	FlatSet<Comment::Ptr> m_Comments;
 
 	/* Notifications */
-	std::set<Notification::Ptr> m_Notifications;
-	mutable boost::mutex m_NotificationMutex;
+	FlatSet<Notification::Ptr> m_Notifications;
 
 	/* Dependencies */
-	mutable boost::mutex m_DependencyMutex;
-	std::set<intrusive_ptr<Dependency> > m_Dependencies;
-	std::set<intrusive_ptr<Dependency> > m_ReverseDependencies;
-
-	void GetAllChildrenInternal(std::set<Checkable::Ptr>& children, int level = 0) const;
+	FlatSet<intrusive_ptr<Dependency> > m_Dependencies;
+	FlatSet<intrusive_ptr<Dependency> > m_ReverseDependencies;
+
+	/* Reachability cache, indexed by DependencyType */
+	struct ReachabilityCacheEntry
+	{
+		bool Valid{false};
+		bool Reachable{false};
+		intrusive_ptr<Dependency> FailedDependency;
+	};
+
+	mutable boost::mutex m_ReachabilityMutex;
+	mutable ReachabilityCacheEntry m_ReachabilityCache[3];
+	unsigned long m_ReachabilityGeneration{0};
+	std::atomic<int> m_ReachabilityInputs{-1};
+
+	bool IsReachableInternal(DependencyType dt, intrusive_ptr<Dependency> *failedDependency, int rstack, bool *cacheable) const;
+	void InvalidateReachability();
+	static void ReachabilityInputsChangedHandler(const Checkable::Ptr& checkable);
 
 	/* Flapping */
 	void UpdateFlappingStatus(bool stateChange);
 };
 
+/**
+ * The number of checkables per raw state (see ServiceState). Checkables which
+ * haven't been checked yet are counted as pending and also in their current state.
+ *
+ * @ingroup icinga
+ */
+struct CheckableStateCounts
+{
+	int Total{0};
+	int Pending{0};
+	int States[4]{};
+	int HardStates[4]{};
+
+	CheckableStateCounts& operator+=(const CheckableStateCounts& other);
+};
+
+/**
+ * Counts checkables by state. The state each checkable is counted with is
+ * remembered, so the counts can be updated when it changes. The caller has
+ * to synchronize access.
+ *
+ * @ingroup icinga
+ */
+class CheckableStateHistogram
+{
+public:
+	void Add(const Checkable::Ptr& checkable);
+	void Remove(const Checkable::Ptr& checkable);
+	void Update(const Checkable::Ptr& checkable);
+
+	CheckableStateCounts GetCounts() const;
+
+private:
+	int m_Counts[16]{};
+	std::unordered_map<const Checkable *, int> m_Keys;
+
+	static int GetKey(const Checkable::Ptr& checkable);
+};
+
 }
 
 #endif /* CHECKABLE_H */
@@ -20,6 +20,12 @@
 #include "icinga/checkresult.hpp"
 #include "icinga/checkresult-ti.cpp"
 #include "base/scriptglobal.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/objectlock.hpp"
+#include "base/logger.hpp"
+#include "base/timer.hpp"
+#include <boost/thread/once.hpp>
+#include <unordered_map>
 
 using namespace icinga;
 
@@ -35,6 +41,218 @@ INITIALIZE_ONCE([]() {
 	ScriptGlobal::Set("HostDown", HostDown);
 })
 
+/* Check results of different checkables often have the same output, check
+ * source and command line. Those are shared instead of being copied into
+ * each check result. */
+struct SharedStringHash
+{
+	size_t operator()(const String *str) const
+	{
+		return std::hash<std::string>()(str->GetData());
+	}
+};
+
+struct SharedStringEqual
+{
+	bool operator()(const String *a, const String *b) const
+	{
+		return *a == *b;
+	}
+};
+
+typedef std::unordered_map<const String *, std::weak_ptr<const String>, SharedStringHash, SharedStringEqual> SharedStringMap;
+
+static boost::mutex l_SharedStringsMutex;
+
+/* Never destroyed, check results which are still alive during static destruction remove their strings from it. */
+static SharedStringMap& l_SharedStrings = *new SharedStringMap();
+
+static boost::mutex l_SharedCommandsMutex;
+static std::unordered_multimap<size_t, Array::Ptr> l_SharedCommands;
+static Timer::Ptr l_SharedCommandsTimer;
+
+/* Parsing performance data is rare enough that the check results can share a few mutexes. */
+static boost::mutex l_ParsedPerfdataMutexes[16];
+
+static std::shared_ptr<const String> ShareString(const String& value)
+{
+	if (value.IsEmpty())
+		return nullptr;
+
+	boost::mutex::scoped_lock lock(l_SharedStringsMutex);
+
+	auto it = l_SharedStrings.find(&value);
+
+	if (it != l_SharedStrings.end()) {
+		std::shared_ptr<const String> str = it->second.lock();
+
+		if (str)
+			return str;
+
+		/* The string is about to be deleted. */
+		l_SharedStrings.erase(it);
+	}
+
+	std::shared_ptr<const String> str(new String(value), [](const String *str) {
+		{
+			boost::mutex::scoped_lock lock(l_SharedStringsMutex);
+
+			auto it = l_SharedStrings.find(str);
+
+			/* The entry might have been replaced with a new string already. */
+			if (it != l_SharedStrings.end() && it->first == str)
+				l_SharedStrings.erase(it);
+		}
+
+		delete str;
+	});
+
+	l_SharedStrings.emplace(str.get(), str);
+
+	return str;
+}
+
+static void SharedCommandsTimerHandler()
+{
+	boost::mutex::scoped_lock lock(l_SharedCommandsMutex);
+
+	for (auto it = l_SharedCommands.begin(); it != l_SharedCommands.end(); ) {
+		/* No check result uses the command anymore. */
+		if (it->second->GetReferenceCount() == 1)
+			it = l_SharedCommands.erase(it);
+		else
+			it++;
+	}
+}
+
+/**
+ * Returns a frozen array with the same arguments as the command line which
+ * is shared with other check results.
+ */
+static Value ShareCommand(const Value& command)
+{
+	if (!command.IsObjectType<Array>())
+		return command;
+
+	static boost::once_flag once = BOOST_ONCE_INIT;
+
+	boost::call_once(once, []() {
+		l_SharedCommandsTimer = new Timer();
+		l_SharedCommandsTimer->SetInterval(300);
+		l_SharedCommandsTimer->SetSlack(1);
+		l_SharedCommandsTimer->OnTimerExpired.connect(std::bind(&SharedCommandsTimerHandler));
+		l_SharedCommandsTimer->Start();
+	});
+
+	Array::Ptr arguments = command;
+	ArrayData data;
+
+	{
+		ObjectLock olock(arguments);
+		data.reserve(arguments->GetLength());
+
+		for (const Value& argument : arguments)
+			data.push_back(argument);
+	}
+
+	size_t hash = data.size();
+
+	for (const Value& argument : data)
+		hash = hash * 31 + std::hash<std::string>()(static_cast<String>(argument).GetData());
+
+	boost::mutex::scoped_lock lock(l_SharedCommandsMutex);
+
+	auto range = l_SharedCommands.equal_range(hash);
+
+	for (auto it = range.first; it != range.second; it++) {
+		const Array::Ptr& shared = it->second;
+
+		if (shared->GetLength() != data.size())
+			continue;
+
+		bool equal = true;
+
+		for (ArrayData::size_type i = 0; i < data.size(); i++) {
+			Value argument = shared->Get(i);
+
+			if (argument.GetType() != data[i].GetType() || argument != data[i]) {
+				equal = false;
+				break;
+			}
+		}
+
+		if (equal)
+			return shared;
+	}
+
+	Array::Ptr shared = new Array(std::move(data));
+	shared->Freeze();
+
+	l_SharedCommands.emplace(hash, shared);
+
+	return shared;
+}
+
+/**
+ * Sets the state fields of an object from a freshly decoded message. Unlike
+ * Deserialize() this doesn't copy the values, they aren't used elsewhere.
+ */
+static void SetStateFields(const Object::Ptr& object, const Type::Ptr& type, const Dictionary::Ptr& data, int skipField = -1)
+{
+	ObjectLock olock(data);
+
+	for (const Dictionary::Pair& kv : data) {
+		int fid = type->GetFieldId(kv.first);
+
+		if (fid < 0 || fid == skipField || (type->GetFieldInfo(fid).Attributes & FAState) == 0)
+			continue;
+
+		try {
+			object->SetField(fid, kv.second, true);
+		} catch (const std::exception&) {
+			object->SetField(fid, Empty);
+		}
+	}
+}
+
+/**
+ * Creates a check result from the "cr" attribute of a cluster message. This
+ * is the equivalent of Deserialize(new CheckResult(), data, true) for the
+ * hot path of event::CheckResult messages.
+ */
+CheckResult::Ptr CheckResult::FromMessage(const Dictionary::Ptr& data)
+{
+	static const Type::Ptr perfdataType = PerfdataValue::TypeInstance;
+	static const int perfdataFieldId = TypeInstance->GetFieldId("performance_data");
+
+	CheckResult::Ptr cr = new CheckResult();
+
+	SetStateFields(cr, TypeInstance, data, perfdataFieldId);
+
+	ArrayData rperf;
+	Value vperf = data->Get("performance_data");
+
+	if (vperf.IsObjectType<Array>()) {
+		Array::Ptr perf = vperf;
+
+		ObjectLock olock(perf);
+		rperf.reserve(perf->GetLength());
+
+		for (const Value& vp : perf) {
+			if (vp.IsObjectType<Dictionary>()) {
+				PerfdataValue::Ptr val = new PerfdataValue();
+				SetStateFields(val, perfdataType, vp);
+				rperf.emplace_back(std::move(val));
+			} else
+				rperf.push_back(vp);
+		}
+	}
+
+	cr->SetPerformanceData(new Array(std::move(rperf)));
+
+	return cr;
+}
+
 double CheckResult::CalculateExecutionTime() const
 {
 	return GetExecutionEnd() - GetExecutionStart();
@@ -49,3 +267,82 @@ double CheckResult::CalculateLatency() const
 
 	return latency;
 }
+
+/**
+ * Returns the performance data as PerfdataValue objects. The values are only
+ * parsed once and the result is shared by all callers, e.g. the perfdata
+ * writers. Invalid values are skipped.
+ *
+ * @returns A frozen array of PerfdataValue objects.
+ */
+Array::Ptr CheckResult::GetParsedPerformanceData()
+{
+	Array::Ptr perfdata = GetPerformanceData();
+
+	if (!perfdata)
+		return nullptr;
+
+	boost::mutex::scoped_lock lock(l_ParsedPerfdataMutexes[reinterpret_cast<uintptr_t>(this) / sizeof(CheckResult) % 16]);
+
+	if (m_ParsedPerfdata && m_ParsedPerfdataSource == perfdata)
+		return m_ParsedPerfdata;
+
+	ArrayData values;
+
+	{
+		ObjectLock olock(perfdata);
+
+		values.reserve(perfdata->GetLength());
+
+		for (const Value& val : perfdata) {
+			if (val.IsObjectType<PerfdataValue>()) {
+				values.push_back(val);
+				continue;
+			}
+
+			try {
+				values.emplace_back(PerfdataValue::Parse(val));
+			} catch (const std::exception&) {
+				Log(LogWarning, "CheckResult")
+					<< "Ignoring invalid perfdata value: " << val;
+			}
+		}
+	}
+
+	m_ParsedPerfdata = new Array(std::move(values));
+	m_ParsedPerfdata->Freeze();
+	m_ParsedPerfdataSource = perfdata;
+
+	return m_ParsedPerfdata;
+}
+
+void CheckResult::SetCommand(const Value& value, bool suppress_events, const Value& cookie)
+{
+	ObjectImpl<CheckResult>::SetCommand(ShareCommand(value), suppress_events, cookie);
+}
+
+String CheckResult::GetOutput() const
+{
+	return m_Output ? *m_Output : String();
+}
+
+void CheckResult::SetOutput(const String& value, bool suppress_events, const Value& cookie)
+{
+	m_Output = ShareString(value);
+
+	if (!suppress_events)
+		NotifyOutput(cookie);
+}
+
+String CheckResult::GetCheckSource() const
+{
+	return m_CheckSource ? *m_CheckSource : String();
+}
+
+void CheckResult::SetCheckSource(const String& value, bool suppress_events, const Value& cookie)
+{
+	m_CheckSource = ShareString(value);
+
+	if (!suppress_events)
+		NotifyCheckSource(cookie);
+}
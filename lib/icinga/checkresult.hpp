@@ -22,6 +22,8 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkresult-ti.hpp"
+#include "base/objectpool.hpp"
+#include <memory>
 
 namespace icinga
 {
@@ -35,9 +37,30 @@ class CheckResult final : public ObjectImpl<CheckResult>
 {
 public:
 	DECLARE_OBJECT(CheckResult);
+	DECLARE_POOLED_ALLOCATOR();
+
+	static CheckResult::Ptr FromMessage(const Dictionary::Ptr& data);
 
 	double CalculateExecutionTime() const;
 	double CalculateLatency() const;
+
+	Array::Ptr GetParsedPerformanceData();
+
+	void SetCommand(const Value& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+	String GetOutput() const override;
+	void SetOutput(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+	String GetCheckSource() const override;
+	void SetCheckSource(const String& value, bool suppress_events = false, const Value& cookie = Empty) override;
+
+private:
+	/* Shared with other check results which have the same value. */
+	std::shared_ptr<const String> m_Output;
+	std::shared_ptr<const String> m_CheckSource;
+
+	Array::Ptr m_ParsedPerfdataSource;
+	Array::Ptr m_ParsedPerfdata;
 };
 
 }
@@ -0,0 +1,286 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/checkresultqueue.hpp"
+#include "icinga/icingaapplication.hpp"
+#include "icinga/checkcommand.hpp"
+#include "base/logger.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <iterator>
+#include <memory>
+
+using namespace icinga;
+
+static boost::mutex l_QueuesMutex;
+static bool l_QueuesConnected = false;
+
+/* Copy-on-write, so that dispatching a check result only needs the lock for copying the pointer. */
+static std::shared_ptr<const std::vector<CheckResultQueue::Ptr> > l_Queues;
+
+CheckResultMetrics::CheckResultMetrics(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+	: m_Checkable(checkable), m_Result(cr)
+{ }
+
+void CheckResultMetrics::Extract() const
+{
+	std::call_once(m_Extracted, [this]() {
+		tie(m_Host, m_Service) = GetHostService(m_Checkable);
+
+		CheckCommand::Ptr commandObj = m_Checkable->GetCheckCommand();
+
+		if (commandObj)
+			m_CheckCommand = commandObj->GetName();
+
+		m_PerfdataEnabled = IcingaApplication::GetInstance()->GetEnablePerfdata() && m_Checkable->GetEnablePerfdata();
+		m_State = m_Service ? static_cast<int>(m_Service->GetState()) : static_cast<int>(m_Host->GetState());
+		m_StateType = m_Checkable->GetStateType();
+		m_Reachable = m_Checkable->IsReachable();
+		m_DowntimeDepth = m_Checkable->GetDowntimeDepth();
+		m_Acknowledgement = m_Checkable->GetAcknowledgement();
+		m_CheckAttempt = m_Checkable->GetCheckAttempt();
+		m_MaxCheckAttempts = m_Checkable->GetMaxCheckAttempts();
+	});
+}
+
+const Host::Ptr& CheckResultMetrics::GetHost() const
+{
+	Extract();
+	return m_Host;
+}
+
+const Service::Ptr& CheckResultMetrics::GetService() const
+{
+	Extract();
+	return m_Service;
+}
+
+const String& CheckResultMetrics::GetCheckCommand() const
+{
+	Extract();
+	return m_CheckCommand;
+}
+
+bool CheckResultMetrics::IsPerfdataEnabled() const
+{
+	Extract();
+	return m_PerfdataEnabled;
+}
+
+/**
+ * Returns the parsed performance data. The check result parses it only once.
+ */
+Array::Ptr CheckResultMetrics::GetPerfdata() const
+{
+	return m_Result->GetParsedPerformanceData();
+}
+
+double CheckResultMetrics::GetTimestamp() const
+{
+	return m_Result->GetExecutionEnd();
+}
+
+int CheckResultMetrics::GetState() const
+{
+	Extract();
+	return m_State;
+}
+
+StateType CheckResultMetrics::GetStateType() const
+{
+	Extract();
+	return m_StateType;
+}
+
+bool CheckResultMetrics::IsReachable() const
+{
+	Extract();
+	return m_Reachable;
+}
+
+int CheckResultMetrics::GetDowntimeDepth() const
+{
+	Extract();
+	return m_DowntimeDepth;
+}
+
+int CheckResultMetrics::GetAcknowledgement() const
+{
+	Extract();
+	return m_Acknowledgement;
+}
+
+int CheckResultMetrics::GetCheckAttempt() const
+{
+	Extract();
+	return m_CheckAttempt;
+}
+
+int CheckResultMetrics::GetMaxCheckAttempts() const
+{
+	Extract();
+	return m_MaxCheckAttempts;
+}
+
+double CheckResultMetrics::GetLatency() const
+{
+	return m_Result->CalculateLatency();
+}
+
+double CheckResultMetrics::GetExecutionTime() const
+{
+	return m_Result->CalculateExecutionTime();
+}
+
+CheckResultQueue::CheckResultQueue(const String& name, WorkQueue& deliveryQueue, const BatchHandler& handler,
+	WorkQueuePriority priority, size_t maxItems, size_t batchSize)
+	: m_Name(name), m_DeliveryQueue(deliveryQueue), m_Handler(handler), m_Priority(priority),
+	m_MaxItems(maxItems), m_BatchSize(batchSize)
+{ }
+
+/**
+ * Subscribes to Checkable::OnNewCheckResult.
+ */
+void CheckResultQueue::Start()
+{
+	boost::mutex::scoped_lock lock(l_QueuesMutex);
+
+	if (!l_QueuesConnected) {
+		Checkable::OnNewCheckResult.connect(std::bind(&CheckResultQueue::DispatchCheckResult, _1, _2));
+		l_QueuesConnected = true;
+	}
+
+	std::shared_ptr<std::vector<CheckResultQueue::Ptr> > queues = l_Queues
+		? std::make_shared<std::vector<CheckResultQueue::Ptr> >(*l_Queues)
+		: std::make_shared<std::vector<CheckResultQueue::Ptr> >();
+
+	queues->emplace_back(this);
+	l_Queues = queues;
+}
+
+/**
+ * Unsubscribes from Checkable::OnNewCheckResult. Check results which were
+ * already queued are still delivered.
+ */
+void CheckResultQueue::Stop()
+{
+	boost::mutex::scoped_lock lock(l_QueuesMutex);
+
+	if (!l_Queues)
+		return;
+
+	std::shared_ptr<std::vector<CheckResultQueue::Ptr> > queues = std::make_shared<std::vector<CheckResultQueue::Ptr> >(*l_Queues);
+	queues->erase(std::remove(queues->begin(), queues->end(), CheckResultQueue::Ptr(this)), queues->end());
+	l_Queues = queues;
+}
+
+size_t CheckResultQueue::GetLength() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Events.size();
+}
+
+unsigned long CheckResultQueue::GetDroppedResults() const
+{
+	return m_DroppedResults;
+}
+
+unsigned long CheckResultQueue::GetDeliveredBatches() const
+{
+	return m_DeliveredBatches;
+}
+
+void CheckResultQueue::DispatchCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+{
+	std::shared_ptr<const std::vector<CheckResultQueue::Ptr> > queues;
+
+	{
+		boost::mutex::scoped_lock lock(l_QueuesMutex);
+		queues = l_Queues;
+	}
+
+	if (!queues || queues->empty())
+		return;
+
+	CheckResultMetrics::Ptr metrics = new CheckResultMetrics(checkable, cr);
+
+	for (const CheckResultQueue::Ptr& queue : *queues)
+		queue->Push({ checkable, cr, metrics });
+}
+
+void CheckResultQueue::Push(CheckResultEvent&& event)
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_MaxItems != 0 && m_Events.size() >= m_MaxItems) {
+			m_DroppedResults++;
+
+			double now = Utility::GetTime();
+
+			if (now - m_LastDropWarning > 60) {
+				m_LastDropWarning = now;
+
+				Log(LogWarning, "CheckResultQueue")
+					<< "Queue for '" << m_Name << "' is full (" << m_Events.size()
+					<< " check results), dropping new check results.";
+			}
+
+			return;
+		}
+
+		m_Events.push_back(std::move(event));
+
+		/* Only one delivery task is in flight at a time. It picks up everything
+		 * which was queued in the meantime. */
+		if (m_DeliveryPending)
+			return;
+
+		m_DeliveryPending = true;
+	}
+
+	m_DeliveryQueue.Enqueue(std::bind(&CheckResultQueue::DeliverBatch, CheckResultQueue::Ptr(this)), m_Priority);
+}
+
+void CheckResultQueue::DeliverBatch()
+{
+	std::vector<CheckResultEvent> batch;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		size_t count = std::min(m_Events.size(), m_BatchSize);
+
+		batch.reserve(count);
+		std::move(m_Events.begin(), m_Events.begin() + count, std::back_inserter(batch));
+		m_Events.erase(m_Events.begin(), m_Events.begin() + count);
+
+		if (m_Events.empty())
+			m_DeliveryPending = false;
+		else
+			m_DeliveryQueue.Enqueue(std::bind(&CheckResultQueue::DeliverBatch, CheckResultQueue::Ptr(this)), m_Priority);
+	}
+
+	if (batch.empty())
+		return;
+
+	m_DeliveredBatches++;
+
+	m_Handler(batch);
+}
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef CHECKRESULTQUEUE_H
+#define CHECKRESULTQUEUE_H
+
+#include "icinga/i2-icinga.hpp"
+#include "icinga/checkable.hpp"
+#include "icinga/service.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace icinga
+{
+
+/**
+ * The state of a checkable and the metrics of a check result. This is extracted
+ * once per check result (by whichever subscriber needs it first) and shared by
+ * all CheckResultQueue subscribers, i.e. the perfdata writers.
+ *
+ * @ingroup icinga
+ */
+class CheckResultMetrics final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CheckResultMetrics);
+
+	CheckResultMetrics(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+
+	const Host::Ptr& GetHost() const;
+	const Service::Ptr& GetService() const;
+	const String& GetCheckCommand() const;
+
+	bool IsPerfdataEnabled() const;
+	Array::Ptr GetPerfdata() const;
+
+	double GetTimestamp() const;
+	int GetState() const;
+	StateType GetStateType() const;
+	bool IsReachable() const;
+	int GetDowntimeDepth() const;
+	int GetAcknowledgement() const;
+	int GetCheckAttempt() const;
+	int GetMaxCheckAttempts() const;
+	double GetLatency() const;
+	double GetExecutionTime() const;
+
+private:
+	Checkable::Ptr m_Checkable;
+	CheckResult::Ptr m_Result;
+
+	mutable std::once_flag m_Extracted;
+	mutable Host::Ptr m_Host;
+	mutable Service::Ptr m_Service;
+	mutable String m_CheckCommand;
+	mutable bool m_PerfdataEnabled{false};
+	mutable int m_State{0};
+	mutable StateType m_StateType{StateTypeSoft};
+	mutable bool m_Reachable{false};
+	mutable int m_DowntimeDepth{0};
+	mutable int m_Acknowledgement{0};
+	mutable int m_CheckAttempt{0};
+	mutable int m_MaxCheckAttempts{0};
+
+	void Extract() const;
+};
+
+/**
+ * A check result as delivered to CheckResultQueue subscribers.
+ *
+ * @ingroup icinga
+ */
+struct CheckResultEvent
+{
+	Checkable::Ptr Subject;
+	CheckResult::Ptr Result;
+	CheckResultMetrics::Ptr Metrics;
+};
+
+/**
+ * A bounded per-subscriber queue for Checkable::OnNewCheckResult. Check results
+ * are collected without blocking the sender and handed to the subscriber in
+ * batches on the subscriber's own work queue, in the order they were received.
+ *
+ * All queues share a single subscription to the signal, the CheckResultMetrics
+ * for a check result are only extracted once for all of them.
+ *
+ * When the queue is full new check results are dropped and counted.
+ *
+ * @ingroup icinga
+ */
+class CheckResultQueue final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CheckResultQueue);
+
+	typedef std::function<void (const std::vector<CheckResultEvent>&)> BatchHandler;
+
+	CheckResultQueue(const String& name, WorkQueue& deliveryQueue, const BatchHandler& handler,
+		WorkQueuePriority priority = PriorityNormal, size_t maxItems = 1000000, size_t batchSize = 1000);
+
+	void Start();
+	void Stop();
+
+	size_t GetLength() const;
+	unsigned long GetDroppedResults() const;
+	unsigned long GetDeliveredBatches() const;
+
+private:
+	String m_Name;
+	WorkQueue& m_DeliveryQueue;
+	BatchHandler m_Handler;
+	WorkQueuePriority m_Priority;
+	size_t m_MaxItems;
+	size_t m_BatchSize;
+
+	mutable boost::mutex m_Mutex;
+	std::deque<CheckResultEvent> m_Events;
+	bool m_DeliveryPending{false};
+	double m_LastDropWarning{0};
+
+	std::atomic<unsigned long> m_DroppedResults{0};
+	std::atomic<unsigned long> m_DeliveredBatches{0};
+
+	static void DispatchCheckResult(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+
+	void Push(CheckResultEvent&& event);
+	void DeliverBatch();
+};
+
+}
+
+#endif /* CHECKRESULTQUEUE_H */
@@ -26,6 +26,10 @@
 #include "base/perfdatavalue.hpp"
 #include "base/configtype.hpp"
 #include "base/statsfunction.hpp"
+#include "base/initialize.hpp"
+#include "base/timer.hpp"
+#include <set>
+#include <unordered_map>
 
 using namespace icinga;
 
@@ -74,158 +78,293 @@ int CIB::GetPassiveServiceChecksStatistics(long timespan)
 	return m_PassiveServiceChecksStatistics.UpdateAndGetValues(Utility::GetTime(), timespan);
 }
 
-CheckableCheckStatistics CIB::CalculateHostCheckStats()
+namespace
 {
-	double min_latency = -1, max_latency = 0, sum_latency = 0;
-	int count_latency = 0;
-	double min_execution_time = -1, max_execution_time = 0, sum_execution_time = 0;
-	int count_execution_time = 0;
-	bool checkresult = false;
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		ObjectLock olock(host);
+/**
+ * What a single checkable currently contributes to the CIB statistics.
+ */
+struct CheckableStatsEntry
+{
+	bool IsHost{false};
+	int State{0};
+	bool HasCheckResult{false};
+	bool Reachable{true};
+	bool Flapping{false};
+	bool InDowntime{false};
+	bool Acknowledged{false};
+	double Latency{0};
+	double ExecutionTime{0};
+};
+
+/**
+ * Aggregated statistics for all hosts or all services.
+ */
+struct CheckableStatsAggregate
+{
+	double States[4]{};
+	double Pending{0};
+	double Unreachable{0};
+	double Flapping{0};
+	double InDowntime{0};
+	double Acknowledged{0};
+	std::multiset<double> Latencies;
+	std::multiset<double> ExecutionTimes;
+	double SumLatency{0};
+	double SumExecutionTime{0};
+};
 
-		CheckResult::Ptr cr = host->GetLastCheckResult();
+}
+
+static boost::mutex l_CheckableStatsMutex;
+static std::unordered_map<const Checkable *, CheckableStatsEntry> l_CheckableStats;
+static CheckableStatsAggregate l_HostStats;
+static CheckableStatsAggregate l_ServiceStats;
+static Timer::Ptr l_CheckableStatsReconcileTimer;
+
+static void ApplyCheckableStatsEntry(const CheckableStatsEntry& entry, int sign)
+{
+	CheckableStatsAggregate& agg = entry.IsHost ? l_HostStats : l_ServiceStats;
 
-		if (!cr)
-			continue;
+	if (entry.IsHost) {
+		/* Up and down are only counted for reachable hosts. */
+		if (entry.Reachable)
+			agg.States[entry.State] += sign;
+	} else
+		agg.States[entry.State] += sign;
 
-		/* set to true, we have a checkresult */
-		checkresult = true;
+	if (!entry.Reachable)
+		agg.Unreachable += sign;
 
-		/* latency */
-		double latency = cr->CalculateLatency();
+	if (!entry.HasCheckResult)
+		agg.Pending += sign;
 
-		if (min_latency == -1 || latency < min_latency)
-			min_latency = latency;
+	if (entry.Flapping)
+		agg.Flapping += sign;
 
-		if (latency > max_latency)
-			max_latency = latency;
+	if (entry.InDowntime)
+		agg.InDowntime += sign;
 
-		sum_latency += latency;
-		count_latency++;
+	if (entry.Acknowledged)
+		agg.Acknowledged += sign;
 
-		/* execution_time */
-		double execution_time = cr->CalculateExecutionTime();
+	if (entry.HasCheckResult) {
+		if (sign > 0) {
+			agg.Latencies.insert(entry.Latency);
+			agg.ExecutionTimes.insert(entry.ExecutionTime);
+		} else {
+			auto itLatency = agg.Latencies.find(entry.Latency);
 
-		if (min_execution_time == -1 || execution_time < min_execution_time)
-			min_execution_time = execution_time;
+			if (itLatency != agg.Latencies.end())
+				agg.Latencies.erase(itLatency);
 
-		if (execution_time > max_execution_time)
-			max_execution_time = execution_time;
+			auto itExecutionTime = agg.ExecutionTimes.find(entry.ExecutionTime);
 
-		sum_execution_time += execution_time;
-		count_execution_time++;
+			if (itExecutionTime != agg.ExecutionTimes.end())
+				agg.ExecutionTimes.erase(itExecutionTime);
+		}
+
+		agg.SumLatency += sign * entry.Latency;
+		agg.SumExecutionTime += sign * entry.ExecutionTime;
 	}
+}
+
+static CheckableStatsEntry CalculateCheckableStatsEntry(const Checkable::Ptr& checkable)
+{
+	CheckableStatsEntry entry;
+
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	entry.IsHost = !service;
+
+	if (service)
+		entry.State = service->GetState();
+	else
+		entry.State = host->GetState();
+
+	CheckResult::Ptr cr = checkable->GetLastCheckResult();
 
-	if (!checkresult) {
-		min_latency = 0;
-		min_execution_time = 0;
+	if (cr) {
+		entry.HasCheckResult = true;
+		entry.Latency = cr->CalculateLatency();
+		entry.ExecutionTime = cr->CalculateExecutionTime();
 	}
 
-	CheckableCheckStatistics ccs;
+	entry.Reachable = checkable->IsReachable();
+	entry.Flapping = checkable->IsFlapping();
+	entry.InDowntime = checkable->IsInDowntime();
+	entry.Acknowledged = checkable->IsAcknowledged();
 
-	ccs.min_latency = min_latency;
-	ccs.max_latency = max_latency;
-	ccs.avg_latency = sum_latency / count_latency;
-	ccs.min_execution_time = min_execution_time;
-	ccs.max_execution_time = max_execution_time;
-	ccs.avg_execution_time = sum_execution_time / count_execution_time;
+	return entry;
+}
 
-	return ccs;
+static void CheckableStatsObjectHandler(const ConfigObject::Ptr& object)
+{
+	Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+	if (!checkable)
+		return;
+
+	if (checkable->IsActive())
+		CIB::UpdateCheckableStats(checkable);
+	else
+		CIB::RemoveCheckableStats(checkable);
 }
 
-CheckableCheckStatistics CIB::CalculateServiceCheckStats()
+static void CheckableStatsDowntimeHandler(const Downtime::Ptr& downtime)
 {
-	double min_latency = -1, max_latency = 0, sum_latency = 0;
-	int count_latency = 0;
-	double min_execution_time = -1, max_execution_time = 0, sum_execution_time = 0;
-	int count_execution_time = 0;
-	bool checkresult = false;
+	Checkable::Ptr checkable = downtime->GetCheckable();
 
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
-		ObjectLock olock(service);
+	if (checkable)
+		CIB::UpdateCheckableStats(checkable);
+}
 
-		CheckResult::Ptr cr = service->GetLastCheckResult();
+/**
+ * Recalculates all entries. This picks up changes which aren't signalled,
+ * e.g. dependencies with time periods.
+ */
+static void CheckableStatsReconcileTimerHandler()
+{
+	std::vector<Checkable::Ptr> checkables;
 
-		if (!cr)
-			continue;
+	for (const Host::Ptr& host : ConfigType::GetObjectViewByType<Host>())
+		checkables.push_back(host);
 
-		/* set to true, we have a checkresult */
-		checkresult = true;
+	for (const Service::Ptr& service : ConfigType::GetObjectViewByType<Service>())
+		checkables.push_back(service);
 
-		/* latency */
-		double latency = cr->CalculateLatency();
+	std::unordered_map<const Checkable *, CheckableStatsEntry> stats;
+	stats.reserve(checkables.size());
 
-		if (min_latency == -1 || latency < min_latency)
-			min_latency = latency;
+	for (const Checkable::Ptr& checkable : checkables) {
+		if (checkable->IsActive())
+			stats[checkable.get()] = CalculateCheckableStatsEntry(checkable);
+	}
 
-		if (latency > max_latency)
-			max_latency = latency;
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
 
-		sum_latency += latency;
-		count_latency++;
+	l_CheckableStats = std::move(stats);
+	l_HostStats = CheckableStatsAggregate();
+	l_ServiceStats = CheckableStatsAggregate();
 
-		/* execution_time */
-		double execution_time = cr->CalculateExecutionTime();
+	for (const auto& kv : l_CheckableStats)
+		ApplyCheckableStatsEntry(kv.second, 1);
+}
 
-		if (min_execution_time == -1 || execution_time < min_execution_time)
-			min_execution_time = execution_time;
+INITIALIZE_ONCE([]() {
+	ConfigObject::OnActiveChanged.connect(std::bind(&CheckableStatsObjectHandler, _1));
 
-		if (execution_time > max_execution_time)
-			max_execution_time = execution_time;
+	Checkable::OnStateRawChanged.connect(std::bind(&CIB::UpdateCheckableStats, _1));
+	Checkable::OnLastCheckResultChanged.connect(std::bind(&CIB::UpdateCheckableStats, _1));
+	Checkable::OnFlappingChanged.connect(std::bind(&CIB::UpdateCheckableStats, _1));
+	Checkable::OnAcknowledgementRawChanged.connect(std::bind(&CIB::UpdateCheckableStats, _1));
 
-		sum_execution_time += execution_time;
-		count_execution_time++;
-	}
+	Downtime::OnDowntimeAdded.connect(&CheckableStatsDowntimeHandler);
+	Downtime::OnDowntimeRemoved.connect(&CheckableStatsDowntimeHandler);
+	Downtime::OnDowntimeStarted.connect(&CheckableStatsDowntimeHandler);
+	Downtime::OnDowntimeTriggered.connect(&CheckableStatsDowntimeHandler);
+});
 
-	if (!checkresult) {
-		min_latency = 0;
-		min_execution_time = 0;
-	}
+/**
+ * Updates the statistics for a checkable after one of the attributes they're
+ * based on has changed.
+ */
+void CIB::UpdateCheckableStats(const Checkable::Ptr& checkable)
+{
+	if (!checkable->IsActive())
+		return;
+
+	static boost::once_flag once = BOOST_ONCE_INIT;
 
+	boost::call_once(once, []() {
+		l_CheckableStatsReconcileTimer = new Timer();
+		l_CheckableStatsReconcileTimer->SetInterval(300);
+		l_CheckableStatsReconcileTimer->SetSlack(1);
+		l_CheckableStatsReconcileTimer->OnTimerExpired.connect(std::bind(&CheckableStatsReconcileTimerHandler));
+		l_CheckableStatsReconcileTimer->Start();
+	});
+
+	CheckableStatsEntry entry = CalculateCheckableStatsEntry(checkable);
+
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
+
+	auto it = l_CheckableStats.find(checkable.get());
+
+	if (it != l_CheckableStats.end()) {
+		ApplyCheckableStatsEntry(it->second, -1);
+		it->second = entry;
+	} else
+		l_CheckableStats[checkable.get()] = entry;
+
+	ApplyCheckableStatsEntry(entry, 1);
+}
+
+void CIB::RemoveCheckableStats(const Checkable::Ptr& checkable)
+{
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
+
+	auto it = l_CheckableStats.find(checkable.get());
+
+	if (it == l_CheckableStats.end())
+		return;
+
+	ApplyCheckableStatsEntry(it->second, -1);
+	l_CheckableStats.erase(it);
+}
+
+static CheckableCheckStatistics GetCheckStats(const CheckableStatsAggregate& agg)
+{
 	CheckableCheckStatistics ccs;
 
-	ccs.min_latency = min_latency;
-	ccs.max_latency = max_latency;
-	ccs.avg_latency = sum_latency / count_latency;
-	ccs.min_execution_time = min_execution_time;
-	ccs.max_execution_time = max_execution_time;
-	ccs.avg_execution_time = sum_execution_time / count_execution_time;
+	double count = agg.Latencies.size();
+
+	if (count == 0) {
+		ccs.min_latency = 0;
+		ccs.max_latency = 0;
+		ccs.min_execution_time = 0;
+		ccs.max_execution_time = 0;
+	} else {
+		ccs.min_latency = *agg.Latencies.begin();
+		ccs.max_latency = *agg.Latencies.rbegin();
+		ccs.min_execution_time = *agg.ExecutionTimes.begin();
+		ccs.max_execution_time = *agg.ExecutionTimes.rbegin();
+	}
+
+	ccs.avg_latency = agg.SumLatency / count;
+	ccs.avg_execution_time = agg.SumExecutionTime / count;
 
 	return ccs;
 }
 
+CheckableCheckStatistics CIB::CalculateHostCheckStats()
+{
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
+	return GetCheckStats(l_HostStats);
+}
+
+CheckableCheckStatistics CIB::CalculateServiceCheckStats()
+{
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
+	return GetCheckStats(l_ServiceStats);
+}
+
 ServiceStatistics CIB::CalculateServiceStats()
 {
 	ServiceStatistics ss = {};
 
-	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
-		ObjectLock olock(service);
-
-		CheckResult::Ptr cr = service->GetLastCheckResult();
-
-		if (service->GetState() == ServiceOK)
-			ss.services_ok++;
-		if (service->GetState() == ServiceWarning)
-			ss.services_warning++;
-		if (service->GetState() == ServiceCritical)
-			ss.services_critical++;
-		if (service->GetState() == ServiceUnknown)
-			ss.services_unknown++;
-
-		if (!cr)
-			ss.services_pending++;
-		if (!service->IsReachable())
-			ss.services_unreachable++;
-
-		if (service->IsFlapping())
-			ss.services_flapping++;
-		if (service->IsInDowntime())
-			ss.services_in_downtime++;
-		if (service->IsAcknowledged())
-			ss.services_acknowledged++;
-	}
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
+
+	ss.services_ok = l_ServiceStats.States[ServiceOK];
+	ss.services_warning = l_ServiceStats.States[ServiceWarning];
+	ss.services_critical = l_ServiceStats.States[ServiceCritical];
+	ss.services_unknown = l_ServiceStats.States[ServiceUnknown];
+	ss.services_pending = l_ServiceStats.Pending;
+	ss.services_unreachable = l_ServiceStats.Unreachable;
+	ss.services_flapping = l_ServiceStats.Flapping;
+	ss.services_in_downtime = l_ServiceStats.InDowntime;
+	ss.services_acknowledged = l_ServiceStats.Acknowledged;
 
 	return ss;
 }
@@ -234,27 +373,15 @@ HostStatistics CIB::CalculateHostStats()
 {
 	HostStatistics hs = {};
 
-	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
-		ObjectLock olock(host);
-
-		if (host->IsReachable()) {
-			if (host->GetState() == HostUp)
-				hs.hosts_up++;
-			if (host->GetState() == HostDown)
-				hs.hosts_down++;
-		} else
-			hs.hosts_unreachable++;
-
-		if (!host->GetLastCheckResult())
-			hs.hosts_pending++;
-
-		if (host->IsFlapping())
-			hs.hosts_flapping++;
-		if (host->IsInDowntime())
-			hs.hosts_in_downtime++;
-		if (host->IsAcknowledged())
-			hs.hosts_acknowledged++;
-	}
+	boost::mutex::scoped_lock lock(l_CheckableStatsMutex);
+
+	hs.hosts_up = l_HostStats.States[HostUp];
+	hs.hosts_down = l_HostStats.States[HostDown];
+	hs.hosts_unreachable = l_HostStats.Unreachable;
+	hs.hosts_pending = l_HostStats.Pending;
+	hs.hosts_flapping = l_HostStats.Flapping;
+	hs.hosts_in_downtime = l_HostStats.InDowntime;
+	hs.hosts_acknowledged = l_HostStats.Acknowledged;
 
 	return hs;
 }
@@ -341,4 +468,19 @@ void CIB::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata) {
 	status->Set("num_hosts_flapping", hs.hosts_flapping);
 	status->Set("num_hosts_in_downtime", hs.hosts_in_downtime);
 	status->Set("num_hosts_acknowledged", hs.hosts_acknowledged);
+
+	/* The size of the objects themselves, without strings, dictionaries etc. they refer to. */
+	status->Set("host_object_size", sizeof(Host));
+	status->Set("service_object_size", sizeof(Service));
+
+	size_t rss = Utility::GetResidentMemorySize();
+
+	if (rss > 0) {
+		status->Set("memory_resident", rss);
+
+		int numServices = ConfigType::Get<Service>()->GetObjectCount();
+
+		if (numServices > 0)
+			status->Set("memory_per_service", static_cast<double>(rss) / numServices);
+	}
 }
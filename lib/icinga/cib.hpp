@@ -28,6 +28,8 @@
 namespace icinga
 {
 
+class Checkable;
+
 struct CheckableCheckStatistics {
 	double min_latency;
 	double max_latency;
@@ -85,6 +87,9 @@ public:
 	static HostStatistics CalculateHostStats();
 	static ServiceStatistics CalculateServiceStats();
 
+	static void UpdateCheckableStats(const intrusive_ptr<Checkable>& checkable);
+	static void RemoveCheckableStats(const intrusive_ptr<Checkable>& checkable);
+
 	static std::pair<Dictionary::Ptr, Array::Ptr> GetFeatureStats();
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
@@ -62,6 +62,15 @@ void ClusterEvents::RemoteCheckThreadProc()
 }
 
 void ClusterEvents::EnqueueCheck(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	EnqueueChecks(origin, { params });
+}
+
+/**
+ * Queues commands for the remote check scheduler thread, which runs at most
+ * MaxConcurrentChecks of them at the same time.
+ */
+void ClusterEvents::EnqueueChecks(const MessageOrigin::Ptr& origin, const std::vector<Dictionary::Ptr>& checks)
 {
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
@@ -74,14 +83,16 @@ void ClusterEvents::EnqueueCheck(const MessageOrigin::Ptr& origin, const Diction
 
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	if (m_CheckRequestQueue.size() >= 25000) {
-		m_ChecksDroppedDuringInterval++;
-		return;
-	}
+	for (const Dictionary::Ptr& params : checks) {
+		if (m_CheckRequestQueue.size() >= 25000) {
+			m_ChecksDroppedDuringInterval++;
+			continue;
+		}
 
-	m_CheckRequestQueue.push_back(std::bind(ClusterEvents::ExecuteCheckFromQueue, origin, params));
+		m_CheckRequestQueue.push_back(std::bind(ClusterEvents::ExecuteCheckFromQueue, origin, params));
+	}
 
-	if (!m_CheckSchedulerRunning) {
+	if (!m_CheckRequestQueue.empty() && !m_CheckSchedulerRunning) {
 		std::thread t(ClusterEvents::RemoteCheckThreadProc);
 		t.detach();
 		m_CheckSchedulerRunning = true;
@@ -0,0 +1,411 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+
+#include "icinga/clusterevents.hpp"
+#include "icinga/service.hpp"
+#include "icinga/icingaapplication.hpp"
+#include "remote/apilistener.hpp"
+#include "remote/apifunction.hpp"
+#include "remote/zone.hpp"
+#include "base/configtype.hpp"
+#include "base/initialize.hpp"
+#include "base/json.hpp"
+#include "base/objectlock.hpp"
+#include "base/exception.hpp"
+#include "base/utility.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <set>
+
+using namespace icinga;
+
+REGISTER_APIFUNCTION(SetAgentSchedule, event, &ClusterEvents::AgentScheduleAPIHandler);
+
+/**
+ * The checks which were delegated to a command endpoint with
+ * agent_scheduling enabled (master side).
+ */
+struct AgentSchedule
+{
+	String Encoded;
+	std::set<Checkable::Ptr> Checkables;
+	double NextRefresh{0};
+};
+
+static boost::mutex l_AgentSchedulesMutex;
+static std::map<Endpoint::Ptr, AgentSchedule> l_AgentSchedules;
+
+/**
+ * A check which the parent endpoint asked us to run on our own (agent side).
+ */
+struct LocalScheduledCheck
+{
+	Dictionary::Ptr Params;
+	double Interval;
+	double NextCheck;
+};
+
+struct LocalSchedule
+{
+	MessageOrigin::Ptr Origin;
+	std::vector<LocalScheduledCheck> Checks;
+};
+
+static boost::mutex l_LocalSchedulesMutex;
+static std::map<Endpoint::Ptr, LocalSchedule> l_LocalSchedules;
+
+static std::once_flag l_AgentScheduleTimersOnce;
+static Timer::Ptr l_AgentScheduleTimer;
+static Timer::Ptr l_LocalScheduleTimer;
+
+/* Schedules are re-sent only if they changed, but they are rebuilt at least this often. */
+static const double l_AgentScheduleRefreshInterval = 300;
+
+static void AgentScheduleTimerHandler();
+static void LocalScheduleTimerHandler();
+
+static void StartAgentScheduleTimers()
+{
+	std::call_once(l_AgentScheduleTimersOnce, []() {
+		l_AgentScheduleTimer = new Timer();
+		l_AgentScheduleTimer->SetInterval(10);
+		l_AgentScheduleTimer->OnTimerExpired.connect(std::bind(&AgentScheduleTimerHandler));
+		l_AgentScheduleTimer->Start();
+
+		l_LocalScheduleTimer = new Timer();
+		l_LocalScheduleTimer->SetInterval(1);
+		l_LocalScheduleTimer->OnTimerExpired.connect(std::bind(&LocalScheduleTimerHandler));
+		l_LocalScheduleTimer->Start();
+	});
+}
+
+/**
+ * Rebuilds the schedule of the checkable's command endpoint with the next timer run.
+ */
+static void InvalidateAgentSchedule(const Checkable::Ptr& checkable)
+{
+	Endpoint::Ptr endpoint = checkable->GetCommandEndpoint();
+
+	if (!endpoint)
+		return;
+
+	boost::mutex::scoped_lock lock(l_AgentSchedulesMutex);
+
+	auto it = l_AgentSchedules.find(endpoint);
+
+	if (it != l_AgentSchedules.end())
+		it->second.NextRefresh = 0;
+}
+
+INITIALIZE_ONCE([]() {
+	Endpoint::OnConnected.connect([](const Endpoint::Ptr&, const JsonRpcConnection::Ptr&) {
+		StartAgentScheduleTimers();
+	});
+
+	Endpoint::OnDisconnected.connect([](const Endpoint::Ptr& endpoint, const JsonRpcConnection::Ptr&) {
+		{
+			boost::mutex::scoped_lock lock(l_AgentSchedulesMutex);
+			l_AgentSchedules.erase(endpoint);
+		}
+
+		boost::mutex::scoped_lock lock(l_LocalSchedulesMutex);
+		l_LocalSchedules.erase(endpoint);
+	});
+
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+		if (checkable)
+			InvalidateAgentSchedule(checkable);
+	});
+
+	Checkable::OnCheckCommandRawChanged.connect([](const Checkable::Ptr& checkable, const Value&) { InvalidateAgentSchedule(checkable); });
+	Checkable::OnCheckIntervalChanged.connect([](const Checkable::Ptr& checkable, const Value&) { InvalidateAgentSchedule(checkable); });
+	Checkable::OnCheckPeriodRawChanged.connect([](const Checkable::Ptr& checkable, const Value&) { InvalidateAgentSchedule(checkable); });
+	Checkable::OnEnableActiveChecksChanged.connect([](const Checkable::Ptr& checkable, const Value&) { InvalidateAgentSchedule(checkable); });
+	CustomVarObject::OnVarsChanged.connect([](const CustomVarObject::Ptr& object, const Value&) {
+		Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+		if (checkable)
+			InvalidateAgentSchedule(checkable);
+	});
+});
+
+/**
+ * Whether the checkable's command endpoint runs its checks on its own, in which
+ * case the local checker must not execute them.
+ */
+bool ClusterEvents::IsScheduledByAgent(const Checkable::Ptr& checkable)
+{
+	Endpoint::Ptr endpoint = checkable->GetCommandEndpoint();
+
+	if (!endpoint || !endpoint->GetAgentScheduling())
+		return false;
+
+	boost::mutex::scoped_lock lock(l_AgentSchedulesMutex);
+
+	auto it = l_AgentSchedules.find(endpoint);
+
+	return it != l_AgentSchedules.end() && it->second.Checkables.find(checkable) != it->second.Checkables.end();
+}
+
+static bool CanScheduleOnAgent(const Checkable::Ptr& checkable)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	IcingaApplication::Ptr app = IcingaApplication::GetInstance();
+
+	if (!checkable->IsActive() || !checkable->GetEnableActiveChecks())
+		return false;
+
+	if (service ? !app->GetEnableServiceChecks() : !app->GetEnableHostChecks())
+		return false;
+
+	/* The agent doesn't know about time periods. */
+	return !checkable->GetCheckPeriod();
+}
+
+/**
+ * Resolves the check command's macros like Checkable::ExecuteCheck() does for
+ * remote checks and returns the event::ExecuteCommand parameters plus the interval.
+ */
+static Dictionary::Ptr MakeAgentScheduleEntry(const Checkable::Ptr& checkable)
+{
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
+
+	CheckCommand::Ptr command = checkable->GetCheckCommand();
+	Dictionary::Ptr macros = new Dictionary();
+
+	command->Execute(checkable, new CheckResult(), macros, false);
+
+	Dictionary::Ptr params = new Dictionary({
+		{ "command_type", "check_command" },
+		{ "command", command->GetName() },
+		{ "host", host->GetName() },
+		{ "macros", macros },
+		{ "interval", checkable->GetCheckInterval() }
+	});
+
+	if (service)
+		params->Set("service", service->GetShortName());
+
+	return params;
+}
+
+static bool CanSendAgentSchedule(const Endpoint::Ptr& endpoint)
+{
+	std::set<JsonRpcConnection::Ptr> clients = endpoint->GetClients();
+
+	if (clients.empty())
+		return false;
+
+	for (const JsonRpcConnection::Ptr& client : clients) {
+		if (!client->GetAgentScheduling())
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Sends the checks of endpoints with agent_scheduling enabled to them, if the
+ * schedule changed since it was sent the last time.
+ */
+static void AgentScheduleTimerHandler()
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	double now = Utility::GetTime();
+	std::set<Endpoint::Ptr> endpoints;
+
+	{
+		boost::mutex::scoped_lock lock(l_AgentSchedulesMutex);
+
+		for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+			if (!endpoint->GetAgentScheduling() || !CanSendAgentSchedule(endpoint))
+				continue;
+
+			auto it = l_AgentSchedules.find(endpoint);
+
+			if (it == l_AgentSchedules.end() || it->second.NextRefresh <= now)
+				endpoints.insert(endpoint);
+		}
+	}
+
+	if (endpoints.empty())
+		return;
+
+	/* Group the checkables by command endpoint in a single pass. */
+	std::map<Endpoint::Ptr, std::vector<Checkable::Ptr> > checkables;
+
+	auto addCheckable = [&endpoints, &checkables](const Checkable::Ptr& checkable) {
+		Endpoint::Ptr endpoint = checkable->GetCommandEndpoint();
+
+		if (endpoint && endpoints.find(endpoint) != endpoints.end())
+			checkables[endpoint].push_back(checkable);
+	};
+
+	for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>())
+		addCheckable(host);
+
+	for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>())
+		addCheckable(service);
+
+	for (const Endpoint::Ptr& endpoint : endpoints) {
+		AgentSchedule schedule;
+		ArrayData checks;
+
+		for (const Checkable::Ptr& checkable : checkables[endpoint]) {
+			if (!CanScheduleOnAgent(checkable))
+				continue;
+
+			try {
+				checks.push_back(MakeAgentScheduleEntry(checkable));
+			} catch (const std::exception& ex) {
+				/* Keep scheduling the check locally, this reports the error as check result. */
+				Log(LogNotice, "ClusterEvents")
+					<< "Not delegating checks for '" << checkable->GetName() << "' to endpoint '"
+					<< endpoint->GetName() << "': " << DiagnosticInformation(ex, false);
+				continue;
+			}
+
+			schedule.Checkables.insert(checkable);
+		}
+
+		Dictionary::Ptr message = new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "event::SetAgentSchedule" },
+			{ "params", new Dictionary({
+				{ "checks", new Array(std::move(checks)) }
+			}) }
+		});
+
+		schedule.Encoded = JsonEncode(message->Get("params"));
+		schedule.NextRefresh = now + l_AgentScheduleRefreshInterval;
+
+		size_t count = schedule.Checkables.size();
+
+		bool changed;
+
+		{
+			boost::mutex::scoped_lock lock(l_AgentSchedulesMutex);
+
+			AgentSchedule& current = l_AgentSchedules[endpoint];
+			changed = current.Encoded != schedule.Encoded;
+			current = std::move(schedule);
+		}
+
+		if (changed) {
+			Log(LogInformation, "ClusterEvents")
+				<< "Sending schedule with " << count << " checks to endpoint '" << endpoint->GetName() << "'.";
+
+			listener->SyncSendMessage(endpoint, message);
+		}
+	}
+}
+
+/**
+ * Queues the checks from the parent endpoints' schedules which are due.
+ */
+static void LocalScheduleTimerHandler()
+{
+	double now = Utility::GetTime();
+	std::vector<std::pair<MessageOrigin::Ptr, std::vector<Dictionary::Ptr> > > due;
+
+	{
+		boost::mutex::scoped_lock lock(l_LocalSchedulesMutex);
+
+		for (auto& kv : l_LocalSchedules) {
+			std::vector<Dictionary::Ptr> checks;
+
+			for (LocalScheduledCheck& check : kv.second.Checks) {
+				if (check.NextCheck > now)
+					continue;
+
+				checks.push_back(check.Params);
+				check.NextCheck = now + check.Interval;
+			}
+
+			if (!checks.empty())
+				due.emplace_back(kv.second.Origin, std::move(checks));
+		}
+	}
+
+	for (auto& kv : due)
+		ClusterEvents::EnqueueChecks(kv.first, kv.second);
+}
+
+Value ClusterEvents::AgentScheduleAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+	if (!endpoint || (origin->FromZone && !Zone::GetLocalZone()->IsChildOf(origin->FromZone))) {
+		Log(LogNotice, "ClusterEvents")
+			<< "Discarding 'agent schedule' message from '" << origin->FromClient->GetIdentity() << "': Invalid endpoint origin (client not allowed).";
+		return Empty;
+	}
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener || !listener->GetAcceptCommands())
+		return Empty;
+
+	Array::Ptr checks = params->Get("checks");
+
+	if (!checks)
+		return Empty;
+
+	LocalSchedule schedule;
+	schedule.Origin = origin;
+
+	double now = Utility::GetTime();
+
+	{
+		ObjectLock olock(checks);
+
+		for (const Dictionary::Ptr& check : checks) {
+			double interval = check->Get("interval");
+
+			if (interval <= 0)
+				interval = 300;
+
+			/* Spread the first checks over the interval. */
+			double offset = Utility::Random() % std::max(1, static_cast<int>(interval * 1000)) / 1000.0;
+
+			schedule.Checks.push_back({ check, interval, now + offset });
+		}
+	}
+
+	Log(LogInformation, "ClusterEvents")
+		<< "Running " << schedule.Checks.size() << " checks for endpoint '" << endpoint->GetName() << "'.";
+
+	boost::mutex::scoped_lock lock(l_LocalSchedulesMutex);
+	l_LocalSchedules[endpoint] = std::move(schedule);
+
+	return Empty;
+}
@@ -33,20 +33,33 @@
 #include "base/initialize.hpp"
 #include "base/serializer.hpp"
 #include "base/json.hpp"
+#include "base/atom.hpp"
+#include "base/timer.hpp"
+#include "base/objectlock.hpp"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <unordered_map>
 
 using namespace icinga;
 
 INITIALIZE_ONCE(&ClusterEvents::StaticInitialize);
 
 REGISTER_APIFUNCTION(CheckResult, event, &ClusterEvents::CheckResultAPIHandler);
+REGISTER_APIFUNCTION(CheckResults, event, &ClusterEvents::CheckResultsAPIHandler);
 REGISTER_APIFUNCTION(SetNextCheck, event, &ClusterEvents::NextCheckChangedAPIHandler);
+REGISTER_APIFUNCTION(SetNextChecks, event, &ClusterEvents::NextChecksChangedAPIHandler);
 REGISTER_APIFUNCTION(SetNextNotification, event, &ClusterEvents::NextNotificationChangedAPIHandler);
 REGISTER_APIFUNCTION(SetForceNextCheck, event, &ClusterEvents::ForceNextCheckChangedAPIHandler);
 REGISTER_APIFUNCTION(SetForceNextNotification, event, &ClusterEvents::ForceNextNotificationChangedAPIHandler);
 REGISTER_APIFUNCTION(SetAcknowledgement, event, &ClusterEvents::AcknowledgementSetAPIHandler);
 REGISTER_APIFUNCTION(ClearAcknowledgement, event, &ClusterEvents::AcknowledgementClearedAPIHandler);
 REGISTER_APIFUNCTION(ExecuteCommand, event, &ClusterEvents::ExecuteCommandAPIHandler);
+REGISTER_APIFUNCTION(ExecuteCommands, event, &ClusterEvents::ExecuteCommandsAPIHandler);
 REGISTER_APIFUNCTION(SendNotifications, event, &ClusterEvents::SendNotificationsAPIHandler);
 REGISTER_APIFUNCTION(NotificationSentUser, event, &ClusterEvents::NotificationSentUserAPIHandler);
 REGISTER_APIFUNCTION(NotificationSentToAllUsers, event, &ClusterEvents::NotificationSentToAllUsersAPIHandler);
@@ -64,6 +77,11 @@ void ClusterEvents::StaticInitialize()
 
 	Checkable::OnAcknowledgementSet.connect(&ClusterEvents::AcknowledgementSetHandler);
 	Checkable::OnAcknowledgementCleared.connect(&ClusterEvents::AcknowledgementClearedHandler);
+
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		if (dynamic_pointer_cast<Host>(object))
+			l_HostCacheGeneration++;
+	});
 }
 
 Dictionary::Ptr ClusterEvents::MakeCheckResultMessage(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
@@ -93,74 +111,436 @@ Dictionary::Ptr ClusterEvents::MakeCheckResultMessage(const Checkable::Ptr& chec
 	return message;
 }
 
-void ClusterEvents::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
+/**
+ * Check results which are waiting to be sent as a single event::CheckResults
+ * message. All of them have the same target zone and origin.
+ */
+struct CheckResultBatch
+{
+	Zone::Ptr TargetZone;
+	MessageOrigin::Ptr Origin;
+	ArrayData Results;
+};
+
+typedef std::tuple<Zone *, JsonRpcConnection *, Zone *> CheckResultBatchKey;
+
+static boost::mutex l_CheckResultBatchesMutex;
+static std::map<CheckResultBatchKey, CheckResultBatch> l_CheckResultBatches;
+
+/* Checkables whose next check changed locally and hasn't been sent yet. */
+static boost::mutex l_PendingNextChecksMutex;
+static std::map<Checkable *, Checkable::Ptr> l_PendingNextChecks;
+
+static std::once_flag l_BatchTimerOnce;
+static Timer::Ptr l_BatchTimer;
+
+/* A batch is sent when it has this many entries or when the timer fires. */
+static const size_t l_BatchSize = 500;
+static const double l_BatchInterval = 0.5;
+
+static void BatchTimerHandler();
+
+static void StartBatchTimer()
+{
+	std::call_once(l_BatchTimerOnce, []() {
+		l_BatchTimer = new Timer();
+		l_BatchTimer->SetInterval(l_BatchInterval);
+		l_BatchTimer->OnTimerExpired.connect(std::bind(&BatchTimerHandler));
+		l_BatchTimer->Start();
+	});
+}
+
+/**
+ * Whether all endpoints which a message for the zone would be sent to
+ * understand event::CheckResults and event::SetNextChecks.
+ */
+static bool CanSendBatches(const Zone::Ptr& targetZone)
+{
+	if (targetZone->GetGlobal())
+		return false;
+
+	Zone::Ptr myZone = Zone::GetLocalZone();
+	Endpoint::Ptr myEndpoint = Endpoint::GetLocalEndpoint();
+
+	std::vector<Zone::Ptr> zones = targetZone->GetAllParents();
+	zones.push_back(targetZone);
+
+	for (const Zone::Ptr& zone : zones) {
+		/* see ApiListener::RelayMessageOne() */
+		if (zone != myZone && zone != myZone->GetParent() && zone->GetParent() != myZone)
+			continue;
+
+		for (const Endpoint::Ptr& endpoint : zone->GetEndpoints()) {
+			if (endpoint == myEndpoint)
+				continue;
+
+			/* Messages for disconnected endpoints end up in the replay log. */
+			if (!endpoint->GetConnected())
+				return false;
+
+			for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
+				if (!client->GetCheckResultBatches())
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void SendCheckResultBatch(CheckResultBatch& batch)
 {
 	ApiListener::Ptr listener = ApiListener::GetInstance();
 
-	if (!listener)
+	if (!listener || batch.Results.empty())
 		return;
 
-	Dictionary::Ptr message = MakeCheckResultMessage(checkable, cr);
-	listener->RelayMessage(origin, checkable, message, true);
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::CheckResults" },
+		{ "params", new Dictionary({
+			{ "results", new Array(std::move(batch.Results)) }
+		}) }
+	});
+
+	listener->RelayMessage(batch.Origin, batch.TargetZone, message, true);
 }
 
-Value ClusterEvents::CheckResultAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+static Dictionary::Ptr MakeNextCheckParams(const Checkable::Ptr& checkable)
 {
-	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+	Host::Ptr host;
+	Service::Ptr service;
+	tie(host, service) = GetHostService(checkable);
 
-	if (!endpoint) {
-		Log(LogNotice, "ClusterEvents")
-			<< "Discarding 'check result' message from '" << origin->FromClient->GetIdentity() << "': Invalid endpoint origin (client not allowed).";
-		return Empty;
+	Dictionary::Ptr params = new Dictionary();
+	params->Set("host", host->GetName());
+	if (service)
+		params->Set("service", service->GetShortName());
+	params->Set("next_check", checkable->GetNextCheck());
+
+	return params;
+}
+
+/**
+ * Sends the next check timestamps which changed since the last call,
+ * grouped by zone.
+ */
+static void SendPendingNextChecks()
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	std::map<Checkable *, Checkable::Ptr> pending;
+
+	{
+		boost::mutex::scoped_lock lock(l_PendingNextChecksMutex);
+		pending.swap(l_PendingNextChecks);
 	}
 
-	CheckResult::Ptr cr;
-	Array::Ptr vperf;
+	if (!listener)
+		return;
 
-	if (params->Contains("cr")) {
-		cr = new CheckResult();
-		Dictionary::Ptr vcr = params->Get("cr");
+	std::map<Zone::Ptr, ArrayData> batches;
 
-		if (vcr && vcr->Contains("performance_data")) {
-			vperf = vcr->Get("performance_data");
+	for (const auto& kv : pending) {
+		const Checkable::Ptr& checkable = kv.second;
 
-			if (vperf)
-				vcr->Remove("performance_data");
+		Zone::Ptr zone = static_pointer_cast<Zone>(checkable->GetZone());
 
-			Deserialize(cr, vcr, true);
+		if (!zone)
+			zone = Zone::GetLocalZone();
+
+		if (zone && CanSendBatches(zone)) {
+			batches[zone].push_back(MakeNextCheckParams(checkable));
+			continue;
 		}
+
+		listener->RelayMessage(nullptr, checkable, new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "event::SetNextCheck" },
+			{ "params", MakeNextCheckParams(checkable) }
+		}), true);
 	}
 
-	if (!cr)
-		return Empty;
+	for (auto& kv : batches) {
+		ArrayData& nextChecks = kv.second;
+
+		for (size_t offset = 0; offset < nextChecks.size(); offset += l_BatchSize) {
+			size_t end = std::min(offset + l_BatchSize, nextChecks.size());
+
+			listener->RelayMessage(nullptr, kv.first, new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "method", "event::SetNextChecks" },
+				{ "params", new Dictionary({
+					{ "next_checks", new Array(ArrayData(nextChecks.begin() + offset, nextChecks.begin() + end)) }
+				}) }
+			}), true);
+		}
+	}
+}
+
+/**
+ * Messages which are waiting to be sent to a single endpoint as one batch,
+ * i.e. commands for an agent and the agent's check results.
+ */
+struct EndpointBatch
+{
+	Endpoint::Ptr Target;
+	ArrayData Items;
+};
+
+static boost::mutex l_EndpointBatchesMutex;
+static std::map<Endpoint *, EndpointBatch> l_ExecuteCommandBatches;
+static std::map<Endpoint *, EndpointBatch> l_AgentCheckResultBatches;
+
+/**
+ * Whether the endpoint is connected and all of its connections support the capability.
+ */
+static bool EndpointSupports(const Endpoint::Ptr& endpoint, bool (JsonRpcConnection::*capability)() const)
+{
+	std::set<JsonRpcConnection::Ptr> clients = endpoint->GetClients();
+
+	if (clients.empty())
+		return false;
+
+	for (const JsonRpcConnection::Ptr& client : clients) {
+		if (!(client.get()->*capability)())
+			return false;
+	}
+
+	return true;
+}
+
+static void SendEndpointBatch(EndpointBatch& batch, const String& method, const String& key)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener || batch.Items.empty())
+		return;
+
+	listener->SyncSendMessage(batch.Target, new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", method },
+		{ "params", new Dictionary({
+			{ key, new Array(std::move(batch.Items)) }
+		}) }
+	}));
+}
+
+static void AddToEndpointBatch(std::map<Endpoint *, EndpointBatch>& batches, const Endpoint::Ptr& endpoint,
+	const Dictionary::Ptr& params, const String& method, const String& key)
+{
+	StartBatchTimer();
+
+	EndpointBatch fullBatch;
+
+	{
+		boost::mutex::scoped_lock lock(l_EndpointBatchesMutex);
+
+		EndpointBatch& batch = batches[endpoint.get()];
+		batch.Target = endpoint;
+		batch.Items.push_back(params);
+
+		if (batch.Items.size() >= l_BatchSize)
+			std::swap(fullBatch, batch);
+	}
+
+	SendEndpointBatch(fullBatch, method, key);
+}
+
+static void BatchTimerHandler()
+{
+	std::map<CheckResultBatchKey, CheckResultBatch> batches;
+	std::map<Endpoint *, EndpointBatch> commandBatches, agentResultBatches;
+
+	{
+		boost::mutex::scoped_lock lock(l_CheckResultBatchesMutex);
+		batches.swap(l_CheckResultBatches);
+	}
+
+	{
+		boost::mutex::scoped_lock lock(l_EndpointBatchesMutex);
+		commandBatches.swap(l_ExecuteCommandBatches);
+		agentResultBatches.swap(l_AgentCheckResultBatches);
+	}
+
+	for (auto& kv : batches)
+		SendCheckResultBatch(kv.second);
+
+	for (auto& kv : commandBatches)
+		SendEndpointBatch(kv.second, "event::ExecuteCommands", "commands");
+
+	for (auto& kv : agentResultBatches)
+		SendEndpointBatch(kv.second, "event::CheckResults", "results");
+
+	SendPendingNextChecks();
+}
+
+/**
+ * Sends an event::ExecuteCommand message to the command endpoint. Check commands
+ * for endpoints which support it are collected and sent as one event::ExecuteCommands
+ * message per endpoint and batch interval.
+ */
+void ClusterEvents::SendExecuteCommand(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	if (EndpointSupports(endpoint, &JsonRpcConnection::GetExecuteCommandBatches)) {
+		AddToEndpointBatch(l_ExecuteCommandBatches, endpoint, message->Get("params"), "event::ExecuteCommands", "commands");
+		return;
+	}
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
 
-	ArrayData rperf;
+	if (listener)
+		listener->SyncSendMessage(endpoint, message);
+}
+
+/**
+ * Sends the check result of a command which was executed for the endpoint
+ * back to it, batched like SendExecuteCommand() if the endpoint supports it.
+ */
+void ClusterEvents::SendAgentCheckResult(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	if (EndpointSupports(endpoint, &JsonRpcConnection::GetCheckResultBatches)) {
+		AddToEndpointBatch(l_AgentCheckResultBatches, endpoint, message->Get("params"), "event::CheckResults", "results");
+		return;
+	}
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (listener)
+		listener->SyncSendMessage(endpoint, message);
+}
+
+void ClusterEvents::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const MessageOrigin::Ptr& origin)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return;
+
+	/* The check result implies the next check timestamp. */
+	if (!origin) {
+		boost::mutex::scoped_lock lock(l_PendingNextChecksMutex);
+		l_PendingNextChecks.erase(checkable.get());
+	}
+
+	Dictionary::Ptr message = MakeCheckResultMessage(checkable, cr);
+
+	Zone::Ptr zone = static_pointer_cast<Zone>(checkable->GetZone());
+
+	if (!zone)
+		zone = Zone::GetLocalZone();
+
+	if (!zone || !CanSendBatches(zone)) {
+		listener->RelayMessage(origin, checkable, message, true);
+		return;
+	}
+
+	StartBatchTimer();
+
+	JsonRpcConnection::Ptr fromClient;
+	Zone::Ptr fromZone;
+
+	if (origin) {
+		fromClient = origin->FromClient;
+		fromZone = origin->FromZone;
+	}
 
-	if (vperf) {
-		ObjectLock olock(vperf);
-		for (const Value& vp : vperf) {
-			Value p;
+	CheckResultBatch fullBatch;
 
-			if (vp.IsObjectType<Dictionary>()) {
-				PerfdataValue::Ptr val = new PerfdataValue();
-				Deserialize(val, vp, true);
-				rperf.push_back(val);
-			} else
-				rperf.push_back(vp);
+	{
+		boost::mutex::scoped_lock lock(l_CheckResultBatchesMutex);
+
+		CheckResultBatch& batch = l_CheckResultBatches[std::make_tuple(zone.get(), fromClient.get(), fromZone.get())];
+
+		if (batch.Results.empty()) {
+			batch.TargetZone = zone;
+			batch.Origin = origin;
 		}
+
+		batch.Results.push_back(message->Get("params"));
+
+		if (batch.Results.size() >= l_BatchSize)
+			std::swap(fullBatch, batch);
 	}
 
-	cr->SetPerformanceData(new Array(std::move(rperf)));
+	SendCheckResultBatch(fullBatch);
+}
+
+/* Keys which are looked up for every check result message. */
+static const Atom l_AtomCr = "cr";
+static const Atom l_AtomHost = "host";
+static const Atom l_AtomService = "service";
 
-	Host::Ptr host = Host::GetByName(params->Get("host"));
+struct HostNameHash
+{
+	size_t operator()(const String& name) const
+	{
+		return std::hash<std::string>()(name.GetData());
+	}
+};
+
+/* Bumped whenever a host is (de)activated, see GetCachedHost(). */
+static std::atomic<uint_fast64_t> l_HostCacheGeneration{0};
+
+/**
+ * Looks up a host for a check result message. Each work queue thread keeps
+ * its own cache, messages are distributed by host name anyway, so looking
+ * up hosts doesn't contend on the type's object map.
+ */
+static Host::Ptr GetCachedHost(const String& name)
+{
+	struct HostCache
+	{
+		uint_fast64_t Generation{0};
+		std::unordered_map<String, Host::Ptr, HostNameHash> Hosts;
+	};
+
+	static thread_local HostCache cache;
+
+	uint_fast64_t generation = l_HostCacheGeneration;
+
+	if (cache.Generation != generation) {
+		cache.Hosts.clear();
+		cache.Generation = generation;
+	}
+
+	auto it = cache.Hosts.find(name);
+
+	if (it != cache.Hosts.end())
+		return it->second;
+
+	Host::Ptr host = Host::GetByName(name);
+
+	if (host)
+		cache.Hosts.emplace(name, host);
+
+	return host;
+}
+
+Value ClusterEvents::CheckResultAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+	if (!endpoint) {
+		Log(LogNotice, "ClusterEvents")
+			<< "Discarding 'check result' message from '" << origin->FromClient->GetIdentity() << "': Invalid endpoint origin (client not allowed).";
+		return Empty;
+	}
+
+	Dictionary::Ptr vcr = params->Get(l_AtomCr);
+
+	if (!vcr)
+		return Empty;
+
+	Host::Ptr host = GetCachedHost(params->Get(l_AtomHost));
 
 	if (!host)
 		return Empty;
 
 	Checkable::Ptr checkable;
 
-	if (params->Contains("service"))
-		checkable = host->GetServiceByShortName(params->Get("service"));
+	if (params->Contains(l_AtomService))
+		checkable = host->GetServiceByShortName(params->Get(l_AtomService));
 	else
 		checkable = host;
 
@@ -174,6 +554,8 @@ Value ClusterEvents::CheckResultAPIHandler(const MessageOrigin::Ptr& origin, con
 		return Empty;
 	}
 
+	CheckResult::Ptr cr = CheckResult::FromMessage(vcr);
+
 	if (!checkable->IsPaused() && Zone::GetLocalZone() == checkable->GetZone() && endpoint == checkable->GetCommandEndpoint())
 		checkable->ProcessCheckResult(cr);
 	else
@@ -182,6 +564,28 @@ Value ClusterEvents::CheckResultAPIHandler(const MessageOrigin::Ptr& origin, con
 	return Empty;
 }
 
+Value ClusterEvents::CheckResultsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Array::Ptr results = params->Get("results");
+
+	if (!results)
+		return Empty;
+
+	ObjectLock olock(results);
+
+	for (const Dictionary::Ptr& result : results) {
+		try {
+			CheckResultAPIHandler(origin, result);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "ClusterEvents")
+				<< "Error while processing check result from '" << origin->FromClient->GetIdentity()
+				<< "': " << DiagnosticInformation(ex);
+		}
+	}
+
+	return Empty;
+}
+
 void ClusterEvents::NextCheckChangedHandler(const Checkable::Ptr& checkable, const MessageOrigin::Ptr& origin)
 {
 	ApiListener::Ptr listener = ApiListener::GetInstance();
@@ -189,20 +593,19 @@ void ClusterEvents::NextCheckChangedHandler(const Checkable::Ptr& checkable, con
 	if (!listener)
 		return;
 
-	Host::Ptr host;
-	Service::Ptr service;
-	tie(host, service) = GetHostService(checkable);
+	/* Local changes are coalesced and dropped if a check result follows. */
+	if (!origin) {
+		StartBatchTimer();
 
-	Dictionary::Ptr params = new Dictionary();
-	params->Set("host", host->GetName());
-	if (service)
-		params->Set("service", service->GetShortName());
-	params->Set("next_check", checkable->GetNextCheck());
+		boost::mutex::scoped_lock lock(l_PendingNextChecksMutex);
+		l_PendingNextChecks[checkable.get()] = checkable;
+		return;
+	}
 
 	Dictionary::Ptr message = new Dictionary();
 	message->Set("jsonrpc", "2.0");
 	message->Set("method", "event::SetNextCheck");
-	message->Set("params", params);
+	message->Set("params", MakeNextCheckParams(checkable));
 
 	listener->RelayMessage(origin, checkable, message, true);
 }
@@ -249,6 +652,22 @@ Value ClusterEvents::NextCheckChangedAPIHandler(const MessageOrigin::Ptr& origin
 	return Empty;
 }
 
+Value ClusterEvents::NextChecksChangedAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Array::Ptr nextChecks = params->Get("next_checks");
+
+	if (!nextChecks)
+		return Empty;
+
+	ObjectLock olock(nextChecks);
+
+	for (const Dictionary::Ptr& nextCheck : nextChecks) {
+		NextCheckChangedAPIHandler(origin, nextCheck);
+	}
+
+	return Empty;
+}
+
 void ClusterEvents::NextNotificationChangedHandler(const Notification::Ptr& notification, const MessageOrigin::Ptr& origin)
 {
 	ApiListener::Ptr listener = ApiListener::GetInstance();
@@ -562,6 +981,27 @@ Value ClusterEvents::ExecuteCommandAPIHandler(const MessageOrigin::Ptr& origin,
 	return Empty;
 }
 
+Value ClusterEvents::ExecuteCommandsAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Array::Ptr commands = params->Get("commands");
+
+	if (!commands)
+		return Empty;
+
+	std::vector<Dictionary::Ptr> checks;
+
+	{
+		ObjectLock olock(commands);
+
+		for (const Dictionary::Ptr& command : commands)
+			checks.push_back(command);
+	}
+
+	EnqueueChecks(origin, checks);
+
+	return Empty;
+}
+
 void ClusterEvents::SendNotificationsHandler(const Checkable::Ptr& checkable, NotificationType type,
 	const CheckResult::Ptr& cr, const String& author, const String& text, const MessageOrigin::Ptr& origin)
 {
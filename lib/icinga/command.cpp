@@ -27,6 +27,27 @@ using namespace icinga;
 
 REGISTER_TYPE(Command);
 
+/**
+ * Returns the compiled arguments for this command. They're compiled again
+ * when the arguments are replaced, e.g. by modifying them at runtime.
+ *
+ * @returns The compiled arguments, or nullptr if the command has no arguments.
+ */
+CompiledCommandArguments::Ptr Command::GetCompiledArguments()
+{
+	Dictionary::Ptr arguments = GetArguments();
+
+	if (!arguments)
+		return nullptr;
+
+	boost::mutex::scoped_lock lock(m_CompiledArgumentsMutex);
+
+	if (!m_CompiledArguments || m_CompiledArguments->Source != arguments)
+		m_CompiledArguments = MacroProcessor::CompileArguments(arguments);
+
+	return m_CompiledArguments;
+}
+
 void Command::Validate(int types, const ValidationUtils& utils)
 {
 	ObjectImpl<Command>::Validate(types, utils);
@@ -68,6 +89,9 @@ void Command::Validate(int types, const ValidationUtils& utils)
 		}
 	}
 
+	if (GetMaxOutputSize() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_output_size" }, "Attribute 'max_output_size' must not be negative."));
+
 	Dictionary::Ptr env = GetEnv();
 
 	if (env) {
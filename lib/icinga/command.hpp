@@ -27,6 +27,8 @@
 namespace icinga
 {
 
+class CompiledCommandArguments;
+
 /**
  * A command.
  *
@@ -39,7 +41,13 @@ public:
 
 	//virtual Dictionary::Ptr Execute(const Object::Ptr& context) = 0;
 
+	intrusive_ptr<CompiledCommandArguments> GetCompiledArguments();
+
 	void Validate(int types, const ValidationUtils& utils) override;
+
+private:
+	boost::mutex m_CompiledArgumentsMutex;
+	intrusive_ptr<CompiledCommandArguments> m_CompiledArguments;
 };
 
 }
@@ -25,6 +25,7 @@
 #include "base/configtype.hpp"
 #include "base/timer.hpp"
 #include <boost/thread/once.hpp>
+#include <queue>
 
 using namespace icinga;
 
@@ -33,6 +34,13 @@ static boost::mutex l_CommentMutex;
 static std::map<int, String> l_LegacyCommentsCache;
 static Timer::Ptr l_CommentsExpireTimer;
 
+/* Comments with an expire time, ordered by it. Entries are revalidated
+ * when they are popped. */
+typedef std::pair<double, String> CommentQueueItem;
+
+static boost::mutex l_CommentQueueMutex;
+static std::priority_queue<CommentQueueItem, std::vector<CommentQueueItem>, std::greater<CommentQueueItem> > l_CommentsExpireQueue;
+
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentAdded;
 boost::signals2::signal<void (const Comment::Ptr&)> Comment::OnCommentRemoved;
 
@@ -99,8 +107,13 @@ void Comment::Start(bool runtimeCreated)
 	boost::call_once(once, [this]() {
 		l_CommentsExpireTimer = new Timer();
 		l_CommentsExpireTimer->SetInterval(60);
+		l_CommentsExpireTimer->SetSlack(1);
 		l_CommentsExpireTimer->OnTimerExpired.connect(std::bind(&Comment::CommentsExpireTimerHandler));
 		l_CommentsExpireTimer->Start();
+
+		Comment::OnExpireTimeChanged.connect([](const Comment::Ptr& comment, const Value&) {
+			comment->QueueComment();
+		});
 	});
 
 	{
@@ -113,6 +126,8 @@ void Comment::Start(bool runtimeCreated)
 
 	GetCheckable()->RegisterComment(this);
 
+	QueueComment();
+
 	if (runtimeCreated)
 		OnCommentAdded(this);
 }
@@ -139,6 +154,20 @@ bool Comment::IsExpired() const
 	return (expire_time != 0 && expire_time < Utility::GetTime());
 }
 
+/**
+ * Adds the comment to the expiration queue if it has an expire time.
+ */
+void Comment::QueueComment()
+{
+	double expire_time = GetExpireTime();
+
+	if (expire_time == 0)
+		return;
+
+	boost::mutex::scoped_lock lock(l_CommentQueueMutex);
+	l_CommentsExpireQueue.emplace(expire_time, GetName());
+}
+
 int Comment::GetNextCommentID()
 {
 	boost::mutex::scoped_lock lock(l_CommentMutex);
@@ -238,20 +267,37 @@ String Comment::GetCommentIDFromLegacyID(int id)
 
 void Comment::CommentsExpireTimerHandler()
 {
+	double now = Utility::GetTime();
+
 	std::vector<Comment::Ptr> comments;
 
-	for (const Comment::Ptr& comment : ConfigType::GetObjectsByType<Comment>()) {
-		comments.push_back(comment);
+	{
+		boost::mutex::scoped_lock lock(l_CommentQueueMutex);
+
+		while (!l_CommentsExpireQueue.empty() && l_CommentsExpireQueue.top().first <= now) {
+			Comment::Ptr comment = Comment::GetByName(l_CommentsExpireQueue.top().second);
+			l_CommentsExpireQueue.pop();
+
+			if (comment)
+				comments.push_back(comment);
+		}
 	}
 
 	for (const Comment::Ptr& comment : comments) {
 		/* Only remove comments which are activated after daemon start. */
-		if (comment->IsActive() && comment->IsExpired()) {
-			/* Do not remove persistent comments from an acknowledgement */
-			if (comment->GetEntryType() == CommentAcknowledgement && comment->GetPersistent())
-				continue;
+		if (!comment->IsActive())
+			continue;
 
-			RemoveComment(comment->GetName());
+		if (!comment->IsExpired()) {
+			/* The expire time was changed or hasn't quite passed yet. */
+			comment->QueueComment();
+			continue;
 		}
+
+		/* Do not remove persistent comments from an acknowledgement */
+		if (comment->GetEntryType() == CommentAcknowledgement && comment->GetPersistent())
+			continue;
+
+		RemoveComment(comment->GetName());
 	}
 }
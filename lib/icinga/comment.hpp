@@ -64,6 +64,8 @@ protected:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
+	void QueueComment();
+
 	static void CommentsExpireTimerHandler();
 };
 
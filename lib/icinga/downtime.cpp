@@ -26,6 +26,7 @@
 #include "base/utility.hpp"
 #include "base/timer.hpp"
 #include <boost/thread/once.hpp>
+#include <queue>
 
 using namespace icinga;
 
@@ -35,6 +36,16 @@ static std::map<int, String> l_LegacyDowntimesCache;
 static Timer::Ptr l_DowntimesExpireTimer;
 static Timer::Ptr l_DowntimesStartTimer;
 
+/* Pending downtime starts and expirations, ordered by their due time. Entries
+ * are revalidated when they are popped and requeued if their time changed. */
+typedef std::pair<double, String> DowntimeQueueItem;
+typedef std::priority_queue<DowntimeQueueItem, std::vector<DowntimeQueueItem>, std::greater<DowntimeQueueItem> > DowntimeQueue;
+
+static boost::mutex l_DowntimeQueueMutex;
+static DowntimeQueue l_DowntimesStartQueue;
+static DowntimeQueue l_DowntimesExpireQueue;
+static bool l_CheckConfigOwners = true;
+
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeAdded;
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeRemoved;
 boost::signals2::signal<void (const Downtime::Ptr&)> Downtime::OnDowntimeStarted;
@@ -108,8 +119,27 @@ void Downtime::Start(bool runtimeCreated)
 
 		l_DowntimesExpireTimer = new Timer();
 		l_DowntimesExpireTimer->SetInterval(60);
+		l_DowntimesExpireTimer->SetSlack(1);
 		l_DowntimesExpireTimer->OnTimerExpired.connect(std::bind(&Downtime::DowntimesExpireTimerHandler));
 		l_DowntimesExpireTimer->Start();
+
+		/* Downtimes which belong to a removed scheduled downtime are expired by the next timer run. */
+		ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+			if (!object->IsActive() && dynamic_pointer_cast<ScheduledDowntime>(object)) {
+				boost::mutex::scoped_lock lock(l_DowntimeQueueMutex);
+				l_CheckConfigOwners = true;
+			}
+		});
+
+		auto timesChangedHandler = [](const Downtime::Ptr& downtime, const Value&) {
+			downtime->GetCheckable()->InvalidateDowntimeDepth();
+			downtime->QueueDowntime();
+		};
+
+		Downtime::OnStartTimeChanged.connect(timesChangedHandler);
+		Downtime::OnEndTimeChanged.connect(timesChangedHandler);
+		Downtime::OnDurationChanged.connect(timesChangedHandler);
+		Downtime::OnFixedChanged.connect(timesChangedHandler);
 	});
 
 	{
@@ -124,6 +154,8 @@ void Downtime::Start(bool runtimeCreated)
 
 	checkable->RegisterDowntime(this);
 
+	QueueDowntime();
+
 	if (runtimeCreated)
 		OnDowntimeAdded(this);
 
@@ -199,6 +231,55 @@ bool Downtime::IsExpired() const
 	}
 }
 
+/**
+ * Returns the time at which IsExpired() will become true unless the
+ * downtime is triggered in the meantime.
+ */
+double Downtime::GetExpireTime() const
+{
+	if (!GetFixed()) {
+		double triggerTime = GetTriggerTime();
+
+		if (triggerTime > 0)
+			return triggerTime + GetDuration();
+	}
+
+	return GetEndTime();
+}
+
+/**
+ * Adds the downtime's start and expiration to the timer queues.
+ */
+void Downtime::QueueDowntime()
+{
+	boost::mutex::scoped_lock lock(l_DowntimeQueueMutex);
+
+	if (GetFixed())
+		l_DowntimesStartQueue.emplace(GetStartTime(), GetName());
+
+	l_DowntimesExpireQueue.emplace(GetExpireTime(), GetName());
+}
+
+/**
+ * Removes and returns the downtimes from a queue which are due.
+ */
+static std::vector<Downtime::Ptr> PopDueDowntimes(DowntimeQueue& queue, double now)
+{
+	std::vector<Downtime::Ptr> downtimes;
+
+	boost::mutex::scoped_lock lock(l_DowntimeQueueMutex);
+
+	while (!queue.empty() && queue.top().first <= now) {
+		Downtime::Ptr downtime = Downtime::GetByName(queue.top().second);
+		queue.pop();
+
+		if (downtime && downtime->IsActive())
+			downtimes.push_back(downtime);
+	}
+
+	return downtimes;
+}
+
 bool Downtime::HasValidConfigOwner() const
 {
 	String configOwner = GetConfigOwner();
@@ -342,9 +423,16 @@ void Downtime::TriggerDowntime()
 	Log(LogNotice, "Downtime")
 		<< "Triggering downtime '" << GetName() << "'.";
 
-	if (GetTriggerTime() == 0)
+	if (GetTriggerTime() == 0) {
 		SetTriggerTime(Utility::GetTime());
 
+		GetCheckable()->InvalidateDowntimeDepth();
+
+		/* Flexible downtimes expire once their duration has passed. */
+		if (!GetFixed())
+			QueueDowntime();
+	}
+
 	Array::Ptr triggers = GetTriggers();
 
 	{
@@ -376,11 +464,14 @@ String Downtime::GetDowntimeIDFromLegacyID(int id)
 
 void Downtime::DowntimesStartTimerHandler()
 {
+	double now = Utility::GetTime();
+
 	/* Start fixed downtimes. Flexible downtimes will be triggered on-demand. */
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
-		if (downtime->IsActive() &&
-			downtime->CanBeTriggered() &&
-			downtime->GetFixed()) {
+	for (const Downtime::Ptr& downtime : PopDueDowntimes(l_DowntimesStartQueue, now)) {
+		if (!downtime->GetFixed())
+			continue;
+
+		if (downtime->CanBeTriggered()) {
 			/* Send notifications. */
 			OnDowntimeStarted(downtime);
 
@@ -392,16 +483,35 @@ void Downtime::DowntimesStartTimerHandler()
 
 void Downtime::DowntimesExpireTimerHandler()
 {
-	std::vector<Downtime::Ptr> downtimes;
+	double now = Utility::GetTime();
+
+	std::vector<Downtime::Ptr> downtimes = PopDueDowntimes(l_DowntimesExpireQueue, now);
+
+	bool checkConfigOwners;
+
+	{
+		boost::mutex::scoped_lock lock(l_DowntimeQueueMutex);
+		checkConfigOwners = l_CheckConfigOwners;
+		l_CheckConfigOwners = false;
+	}
 
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
-		downtimes.push_back(downtime);
+	if (checkConfigOwners) {
+		for (const Downtime::Ptr& downtime : ConfigType::GetObjectViewByType<Downtime>()) {
+			if (downtime->IsActive() && !downtime->HasValidConfigOwner())
+				downtimes.push_back(downtime);
+		}
 	}
 
 	for (const Downtime::Ptr& downtime : downtimes) {
 		/* Only remove downtimes which are activated after daemon start. */
-		if (downtime->IsActive() && (downtime->IsExpired() || !downtime->HasValidConfigOwner()))
+		if (downtime->IsExpired() || !downtime->HasValidConfigOwner()) {
 			RemoveDowntime(downtime->GetName(), false, true);
+			continue;
+		}
+
+		/* The downtime was triggered or its end time was changed. */
+		boost::mutex::scoped_lock lock(l_DowntimeQueueMutex);
+		l_DowntimesExpireQueue.emplace(downtime->GetExpireTime(), downtime->GetName());
 	}
 }
 
@@ -49,6 +49,7 @@ public:
 	bool IsInEffect() const;
 	bool IsTriggered() const;
 	bool IsExpired() const;
+	double GetExpireTime() const;
 	bool HasValidConfigOwner() const;
 
 	static int GetNextDowntimeID();
@@ -77,6 +78,7 @@ private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
 	bool CanBeTriggered();
+	void QueueDowntime();
 
 	static void DowntimesStartTimerHandler();
 	static void DowntimesExpireTimerHandler();
@@ -37,6 +37,8 @@
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include <fstream>
+#include <iterator>
+#include <cstring>
 #include <boost/thread/once.hpp>
 
 using namespace icinga;
@@ -48,7 +50,20 @@ void ExternalCommandProcessor::Execute(const String& line)
 	if (line.IsEmpty())
 		return;
 
-	if (line[0] != '[')
+	double ts;
+	String command;
+	std::vector<String> arguments;
+
+	Parse(line, &ts, &command, &arguments);
+	Execute(ts, command, arguments);
+}
+
+/**
+ * Splits a command line into its timestamp, command name and arguments.
+ */
+void ExternalCommandProcessor::Parse(const String& line, double *time, String *command, std::vector<String> *arguments)
+{
+	if (line.IsEmpty() || line[0] != '[')
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
 
 	size_t pos = line.FindFirstOf("]");
@@ -56,54 +71,74 @@ void ExternalCommandProcessor::Execute(const String& line)
 	if (pos == String::NPos)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
 
-	String timestamp = line.SubStr(1, pos - 1);
-	String args = line.SubStr(pos + 2, String::NPos);
-
-	double ts = Convert::ToDouble(timestamp);
+	double ts = Convert::ToDouble(line.SubStr(1, pos - 1));
 
 	if (ts == 0)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid timestamp in command: " + line));
 
-	std::vector<String> argv = args.Split(";");
-
-	if (argv.empty())
+	if (pos + 2 > line.GetLength())
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing arguments in command: " + line));
 
-	std::vector<String> argvExtra(argv.begin() + 1, argv.end());
-	Execute(ts, argv[0], argvExtra);
+	/* Tokenize the command in place instead of copying the argument string and splitting it. */
+	const char *data = line.CStr();
+	const char *end = data + line.GetLength();
+	const char *begin = data + pos + 2;
+
+	const char *sep = static_cast<const char *>(memchr(begin, ';', end - begin));
+
+	if (!sep)
+		sep = end;
+
+	*time = ts;
+	*command = String(begin, sep);
+
+	arguments->clear();
+
+	while (sep < end) {
+		begin = sep + 1;
+		sep = static_cast<const char *>(memchr(begin, ';', end - begin));
+
+		if (!sep)
+			sep = end;
+
+		arguments->emplace_back(begin, sep);
+	}
 }
 
 void ExternalCommandProcessor::Execute(double time, const String& command, const std::vector<String>& arguments)
 {
-	ExternalCommandInfo eci;
-
 	static boost::once_flag once = BOOST_ONCE_INIT;
 
 	boost::call_once(once, []() {
 		RegisterCommands();
 	});
 
-	{
-		boost::mutex::scoped_lock lock(GetMutex());
-
-		auto it = GetCommands().find(command);
+	/* Commands are only registered by the call_once() above, so the table can be read without the mutex. */
+	auto it = GetCommands().find(command.GetData());
 
-		if (it == GetCommands().end())
-			BOOST_THROW_EXCEPTION(std::invalid_argument("The external command '" + command + "' does not exist."));
+	if (it == GetCommands().end())
+		BOOST_THROW_EXCEPTION(std::invalid_argument("The external command '" + command + "' does not exist."));
 
-		eci = it->second;
-	}
+	const ExternalCommandInfo& eci = it->second;
 
 	if (arguments.size() < eci.MinArgs)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Expected " + Convert::ToString(eci.MinArgs) + " arguments"));
 
-	size_t argnum = std::min(arguments.size(), eci.MaxArgs);
+	/* Only commands with more arguments than expected need a copy, the surplus is joined into the last argument. */
+	if (arguments.size() <= eci.MaxArgs) {
+		OnNewExternalCommand(time, command, arguments);
+
+		eci.Callback(time, arguments);
+		return;
+	}
+
+	size_t argnum = eci.MaxArgs;
 
 	std::vector<String> realArguments;
-	realArguments.resize(argnum);
 
 	if (argnum > 0) {
-		std::copy(arguments.begin(), arguments.begin() + argnum - 1, realArguments.begin());
+		realArguments.reserve(argnum);
+		std::copy(arguments.begin(), arguments.begin() + argnum - 1, std::back_inserter(realArguments));
 
 		String last_argument;
 		for (std::vector<String>::size_type i = argnum - 1; i < arguments.size(); i++) {
@@ -113,7 +148,7 @@ void ExternalCommandProcessor::Execute(double time, const String& command, const
 			last_argument += arguments[i];
 		}
 
-		realArguments[argnum - 1] = last_argument;
+		realArguments.emplace_back(std::move(last_argument));
 	}
 
 	OnNewExternalCommand(time, command, realArguments);
@@ -128,7 +163,7 @@ void ExternalCommandProcessor::RegisterCommand(const String& command, const Exte
 	eci.Callback = callback;
 	eci.MinArgs = minArgs;
 	eci.MaxArgs = (maxArgs == UINT_MAX) ? minArgs : maxArgs;
-	GetCommands()[command] = eci;
+	GetCommands()[command.GetData()] = eci;
 }
 
 void ExternalCommandProcessor::RegisterCommands()
@@ -258,35 +293,18 @@ void ExternalCommandProcessor::ExecuteFromFile(const String& line, std::deque< s
 	if (line.IsEmpty())
 		return;
 
-	if (line[0] != '[')
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
-
-	size_t pos = line.FindFirstOf("]");
-
-	if (pos == String::NPos)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing timestamp in command: " + line));
-
-	String timestamp = line.SubStr(1, pos - 1);
-	String args = line.SubStr(pos + 2, String::NPos);
-
-	double ts = Convert::ToDouble(timestamp);
-
-	if (ts == 0)
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid timestamp in command: " + line));
-
-	std::vector<String> argv = args.Split(";");
-
-	if (argv.empty())
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Missing arguments in command: " + line));
+	double ts;
+	String command;
+	std::vector<String> arguments;
 
-	std::vector<String> argvExtra(argv.begin() + 1, argv.end());
+	Parse(line, &ts, &command, &arguments);
 
-	if (argv[0] == "PROCESS_FILE") {
+	if (command == "PROCESS_FILE") {
 		Log(LogDebug, "ExternalCommandProcessor")
-			<< "Enqueing external command file " << argvExtra[0];
-		file_queue.push_back(argvExtra);
+			<< "Enqueing external command file " << arguments[0];
+		file_queue.push_back(arguments);
 	} else {
-		Execute(ts, argv[0], argvExtra);
+		Execute(ts, command, arguments);
 	}
 }
 
@@ -526,7 +544,7 @@ void ExternalCommandProcessor::ScheduleForcedHostSvcChecks(double, const std::ve
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot reschedule forced host service checks for non-existent host '" + arguments[0] + "'"));
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		Log(LogNotice, "ExternalCommandProcessor")
 			<< "Rescheduling next check for service '" << service->GetName() << "'";
 
@@ -550,7 +568,7 @@ void ExternalCommandProcessor::ScheduleHostSvcChecks(double, const std::vector<S
 	if (planned_check < Utility::GetTime())
 		planned_check = Utility::GetTime();
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		if (planned_check > service->GetNextCheck()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Ignoring reschedule request for service '"
@@ -575,7 +593,7 @@ void ExternalCommandProcessor::EnableHostSvcChecks(double, const std::vector<Str
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable host service checks for non-existent host '" + arguments[0] + "'"));
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		Log(LogNotice, "ExternalCommandProcessor")
 			<< "Enabling active checks for service '" << service->GetName() << "'";
 
@@ -590,7 +608,7 @@ void ExternalCommandProcessor::DisableHostSvcChecks(double, const std::vector<St
 	if (!host)
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable host service checks for non-existent host '" + arguments[0] + "'"));
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		Log(LogNotice, "ExternalCommandProcessor")
 			<< "Disabling active checks for service '" << service->GetName() << "'";
 
@@ -733,7 +751,7 @@ void ExternalCommandProcessor::EnableHostgroupSvcChecks(double, const std::vecto
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable hostgroup service checks for non-existent hostgroup '" + arguments[0] + "'"));
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Enabling active checks for service '" << service->GetName() << "'";
 
@@ -750,7 +768,7 @@ void ExternalCommandProcessor::DisableHostgroupSvcChecks(double, const std::vect
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable hostgroup service checks for non-existent hostgroup '" + arguments[0] + "'"));
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Disabling active checks for service '" << service->GetName() << "'";
 
@@ -879,7 +897,7 @@ void ExternalCommandProcessor::EnableHostgroupPassiveSvcChecks(double, const std
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable hostgroup passive service checks for non-existent hostgroup '" + arguments[0] + "'"));
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Enabling passive checks for service '" << service->GetName() << "'";
 
@@ -896,7 +914,7 @@ void ExternalCommandProcessor::DisableHostgroupPassiveSvcChecks(double, const st
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable hostgroup passive service checks for non-existent hostgroup '" + arguments[0] + "'"));
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Disabling passive checks for service '" << service->GetName() << "'";
 
@@ -1105,7 +1123,7 @@ void ExternalCommandProcessor::DelDowntimeByHostName(double, const std::vector<S
 		Downtime::RemoveDowntime(downtime->GetName(), true);
 	}
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		if (!serviceName.IsEmpty() && serviceName != service->GetName())
 			continue;
 
@@ -1144,7 +1162,7 @@ void ExternalCommandProcessor::ScheduleHostSvcDowntime(double, const std::vector
 		Convert::ToDouble(arguments[1]), Convert::ToDouble(arguments[2]),
 		Convert::ToBool(is_fixed), triggeredBy, Convert::ToDouble(arguments[5]));
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		Log(LogNotice, "ExternalCommandProcessor")
 			<< "Creating downtime for service " << service->GetName();
 		(void) Downtime::AddDowntime(service, arguments[6], arguments[7],
@@ -1196,7 +1214,7 @@ void ExternalCommandProcessor::ScheduleHostgroupSvcDowntime(double, const std::v
 	std::set<Service::Ptr> services;
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			services.insert(service);
 		}
 	}
@@ -1469,7 +1487,7 @@ void ExternalCommandProcessor::EnableHostSvcNotifications(double, const std::vec
 	Log(LogNotice, "ExternalCommandProcessor")
 		<< "Enabling notifications for all services on host '" << arguments[0] << "'";
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		Log(LogNotice, "ExternalCommandProcessor")
 			<< "Enabling notifications for service '" << service->GetName() << "'";
 
@@ -1487,7 +1505,7 @@ void ExternalCommandProcessor::DisableHostSvcNotifications(double, const std::ve
 	Log(LogNotice, "ExternalCommandProcessor")
 		<< "Disabling notifications for all services on host '" << arguments[0] << "'";
 
-	for (const Service::Ptr& service : host->GetServices()) {
+	for (const Service::Ptr& service : host->GetServiceView()) {
 		Log(LogNotice, "ExternalCommandProcessor")
 			<< "Disabling notifications for service '" << service->GetName() << "'";
 
@@ -2124,7 +2142,7 @@ void ExternalCommandProcessor::EnableHostgroupSvcNotifications(double, const std
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot enable service notifications for non-existent hostgroup '" + arguments[0] + "'"));
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Enabling notifications for service '" << service->GetName() << "'";
 
@@ -2156,7 +2174,7 @@ void ExternalCommandProcessor::DisableHostgroupSvcNotifications(double, const st
 		BOOST_THROW_EXCEPTION(std::invalid_argument("Cannot disable service notifications for non-existent hostgroup '" + arguments[0] + "'"));
 
 	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
 			Log(LogNotice, "ExternalCommandProcessor")
 				<< "Disabling notifications for service '" << service->GetName() << "'";
 
@@ -2235,9 +2253,9 @@ boost::mutex& ExternalCommandProcessor::GetMutex()
 	return mtx;
 }
 
-std::map<String, ExternalCommandInfo>& ExternalCommandProcessor::GetCommands()
+ExternalCommandProcessor::CommandTable& ExternalCommandProcessor::GetCommands()
 {
-	static std::map<String, ExternalCommandInfo> commands;
+	static CommandTable commands;
 	return commands;
 }
 
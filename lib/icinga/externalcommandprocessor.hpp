@@ -24,6 +24,7 @@
 #include "icinga/command.hpp"
 #include "base/string.hpp"
 #include <boost/signals2.hpp>
+#include <unordered_map>
 #include <vector>
 
 namespace icinga
@@ -42,6 +43,7 @@ class ExternalCommandProcessor {
 public:
 	static void Execute(const String& line);
 	static void Execute(double time, const String& command, const std::vector<String>& arguments);
+	static void Parse(const String& line, double *time, String *command, std::vector<String> *arguments);
 
 	static boost::signals2::signal<void(double, const String&, const std::vector<String>&)> OnNewExternalCommand;
 
@@ -176,8 +178,10 @@ private:
 	static void RegisterCommand(const String& command, const ExternalCommandCallback& callback, size_t minArgs = 0, size_t maxArgs = UINT_MAX);
 	static void RegisterCommands();
 
+	typedef std::unordered_map<std::string, ExternalCommandInfo> CommandTable;
+
 	static boost::mutex& GetMutex();
-	static std::map<String, ExternalCommandInfo>& GetCommands();
+	static CommandTable& GetCommands();
 
 };
 
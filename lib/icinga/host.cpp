@@ -28,11 +28,73 @@
 #include "base/utility.hpp"
 #include "base/debug.hpp"
 #include "base/json.hpp"
+#include "base/configtype.hpp"
+#include "base/initialize.hpp"
 
 using namespace icinga;
 
 REGISTER_TYPE(Host);
 
+static void ServiceStateCountsHandler(const Checkable::Ptr& checkable)
+{
+	Service::Ptr service = dynamic_pointer_cast<Service>(checkable);
+
+	if (!service)
+		return;
+
+	Host::Ptr host = service->GetHost();
+
+	if (host)
+		host->UpdateServiceStateCounts(service);
+}
+
+INITIALIZE_ONCE([]() {
+	Checkable::OnStateRawChanged.connect(std::bind(&ServiceStateCountsHandler, _1));
+	Checkable::OnStateTypeChanged.connect(std::bind(&ServiceStateCountsHandler, _1));
+	Checkable::OnLastCheckResultChanged.connect(std::bind(&ServiceStateCountsHandler, _1));
+
+	/* The state is restored without signalling the changes. */
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+		if (checkable && checkable->IsActive())
+			ServiceStateCountsHandler(checkable);
+	});
+});
+
+/* Indexes for API filters like 'host.name == "x"' or '"linux-servers" in host.groups'. */
+INITIALIZE_ONCE([]() {
+	auto *ctype = dynamic_cast<ConfigType *>(Host::TypeInstance.get());
+
+	ctype->RegisterIndex(ConfigType::IndexEqual, "name", [ctype](const Value& value, std::vector<ConfigObject::Ptr>& objects) -> bool {
+		if (!value.IsString())
+			return false;
+
+		ConfigObject::Ptr host = ctype->GetObject(value);
+
+		if (host)
+			objects.push_back(host);
+
+		return true;
+	});
+
+	ctype->RegisterIndex(ConfigType::IndexContains, "groups", [](const Value& value, std::vector<ConfigObject::Ptr>& objects) -> bool {
+		if (!value.IsString())
+			return false;
+
+		HostGroup::Ptr group = HostGroup::GetByName(value);
+
+		if (!group)
+			return false;
+
+		for (const Host::Ptr& host : group->GetMembers()) {
+			objects.push_back(host);
+		}
+
+		return true;
+	});
+});
+
 void Host::OnAllConfigLoaded()
 {
 	ObjectImpl<Host>::OnAllConfigLoaded();
@@ -100,36 +162,91 @@ void Host::Stop(bool runtimeRemoved)
 }
 
 std::vector<Service::Ptr> Host::GetServices() const
+{
+	std::vector<Service::Ptr> services;
+
+	for (const Service::Ptr& service : GetServiceView())
+		services.push_back(service);
+
+	return services;
+}
+
+/**
+ * Returns the services without copying the list. The list is only rebuilt
+ * after services were added or removed.
+ */
+ConfigObjectView<Service> Host::GetServiceView() const
 {
 	boost::mutex::scoped_lock lock(m_ServicesMutex);
 
-	std::vector<Service::Ptr> services;
-	services.reserve(m_Services.size());
-	typedef std::pair<String, Service::Ptr> ServicePair;
-	for (const ServicePair& kv : m_Services) {
-		services.push_back(kv.second);
+	if (!m_ServicesSnapshot) {
+		std::vector<ConfigObject::Ptr> services;
+		services.reserve(m_Services.size());
+
+		for (const auto& kv : m_Services)
+			services.push_back(kv.second);
+
+		m_ServicesSnapshot = std::make_shared<const std::vector<ConfigObject::Ptr> >(std::move(services));
 	}
 
-	return services;
+	return ConfigObjectView<Service>(m_ServicesSnapshot);
 }
 
 void Host::AddService(const Service::Ptr& service)
 {
 	boost::mutex::scoped_lock lock(m_ServicesMutex);
 
-	m_Services[service->GetShortName()] = service;
+	Service::Ptr& entry = m_Services[service->GetShortName()];
+
+	if (entry == service)
+		return;
+
+	if (entry)
+		m_ServiceStates.Remove(entry);
+
+	entry = service;
+	m_ServiceStates.Add(service);
+	m_ServicesSnapshot.reset();
 }
 
 void Host::RemoveService(const Service::Ptr& service)
 {
 	boost::mutex::scoped_lock lock(m_ServicesMutex);
 
-	m_Services.erase(service->GetShortName());
+	auto it = m_Services.find(service->GetShortName());
+
+	/* The name might already belong to a new service. */
+	if (it == m_Services.end() || it->second != service)
+		return;
+
+	m_ServiceStates.Remove(service);
+	m_Services.erase(it);
+	m_ServicesSnapshot.reset();
 }
 
 int Host::GetTotalServices() const
 {
-	return GetServices().size();
+	boost::mutex::scoped_lock lock(m_ServicesMutex);
+
+	return m_Services.size();
+}
+
+/**
+ * Updates the state counts after one of the attributes they're based on
+ * has changed for the service.
+ */
+void Host::UpdateServiceStateCounts(const Service::Ptr& service)
+{
+	boost::mutex::scoped_lock lock(m_ServicesMutex);
+
+	m_ServiceStates.Update(service);
+}
+
+CheckableStateCounts Host::GetServiceStateCounts() const
+{
+	boost::mutex::scoped_lock lock(m_ServicesMutex);
+
+	return m_ServiceStates.GetCounts();
 }
 
 Service::Ptr Host::GetServiceByShortName(const Value& name)
@@ -301,7 +418,7 @@ bool Host::ResolveMacro(const String& macro, const CheckResult::Ptr&, Value *res
 			else if (macro == "num_services_critical")
 				filter = ServiceCritical;
 
-			for (const Service::Ptr& service : GetServices()) {
+			for (const Service::Ptr& service : GetServiceView()) {
 				if (filter != -1 && service->GetState() != filter)
 					continue;
 
@@ -24,6 +24,7 @@
 #include "icinga/host-ti.hpp"
 #include "icinga/macroresolver.hpp"
 #include "icinga/checkresult.hpp"
+#include "base/configtype.hpp"
 
 namespace icinga
 {
@@ -44,10 +45,13 @@ public:
 	intrusive_ptr<Service> GetServiceByShortName(const Value& name);
 
 	std::vector<intrusive_ptr<Service> > GetServices() const;
+	ConfigObjectView<Service> GetServiceView() const;
 	void AddService(const intrusive_ptr<Service>& service);
 	void RemoveService(const intrusive_ptr<Service>& service);
 
 	int GetTotalServices() const;
+	CheckableStateCounts GetServiceStateCounts() const;
+	void UpdateServiceStateCounts(const intrusive_ptr<Service>& service);
 
 	static HostState CalculateState(ServiceState state);
 
@@ -77,6 +81,11 @@ private:
 	mutable boost::mutex m_ServicesMutex;
 	std::map<String, intrusive_ptr<Service> > m_Services;
 
+	/* Shared list of the services, created on demand and dropped when services are added or removed */
+	mutable std::shared_ptr<const std::vector<ConfigObject::Ptr> > m_ServicesSnapshot;
+
+	CheckableStateHistogram m_ServiceStates;
+
 	static void RefreshServicesCache();
 };
 
@@ -31,8 +31,42 @@ using namespace icinga;
 
 REGISTER_TYPE(HostGroup);
 
+static void MemberStateCountsHandler(const Checkable::Ptr& checkable)
+{
+	Host::Ptr host = dynamic_pointer_cast<Host>(checkable);
+
+	if (!host)
+		return;
+
+	Array::Ptr groups = host->GetGroups();
+
+	if (!groups)
+		return;
+
+	ObjectLock olock(groups);
+
+	for (const String& name : groups) {
+		HostGroup::Ptr hg = HostGroup::GetByName(name);
+
+		if (hg)
+			hg->UpdateMemberStateCounts(host);
+	}
+}
+
 INITIALIZE_ONCE([]() {
 	ObjectRule::RegisterType("HostGroup");
+
+	Checkable::OnStateRawChanged.connect(std::bind(&MemberStateCountsHandler, _1));
+	Checkable::OnStateTypeChanged.connect(std::bind(&MemberStateCountsHandler, _1));
+	Checkable::OnLastCheckResultChanged.connect(std::bind(&MemberStateCountsHandler, _1));
+
+	/* The state is restored without signalling the changes. */
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+		if (checkable && checkable->IsActive())
+			MemberStateCountsHandler(checkable);
+	});
 });
 
 bool HostGroup::EvaluateObjectRule(const Host::Ptr& host, const ConfigItem::Ptr& group)
@@ -85,12 +119,44 @@ void HostGroup::AddMember(const Host::Ptr& host)
 
 	boost::mutex::scoped_lock lock(m_HostGroupMutex);
 	m_Members.insert(host);
+	m_MemberStates.Add(host);
 }
 
 void HostGroup::RemoveMember(const Host::Ptr& host)
 {
 	boost::mutex::scoped_lock lock(m_HostGroupMutex);
 	m_Members.erase(host);
+	m_MemberStates.Remove(host);
+}
+
+/**
+ * Returns the number of members per raw state. The counts are updated when
+ * members change their state, so this doesn't need to look at the members.
+ */
+CheckableStateCounts HostGroup::GetMemberStateCounts() const
+{
+	boost::mutex::scoped_lock lock(m_HostGroupMutex);
+	return m_MemberStates.GetCounts();
+}
+
+/**
+ * Returns the number of services of all members per state. This only
+ * needs to look at the members' state counts, not at their services.
+ */
+CheckableStateCounts HostGroup::GetServiceStateCounts() const
+{
+	CheckableStateCounts counts;
+
+	for (const Host::Ptr& host : GetMembers())
+		counts += host->GetServiceStateCounts();
+
+	return counts;
+}
+
+void HostGroup::UpdateMemberStateCounts(const Host::Ptr& host)
+{
+	boost::mutex::scoped_lock lock(m_HostGroupMutex);
+	m_MemberStates.Update(host);
 }
 
 bool HostGroup::ResolveGroupMembership(const Host::Ptr& host, bool add, int rstack) {
@@ -46,11 +46,16 @@ public:
 
 	bool ResolveGroupMembership(const Host::Ptr& host, bool add = true, int rstack = 0);
 
+	CheckableStateCounts GetMemberStateCounts() const;
+	CheckableStateCounts GetServiceStateCounts() const;
+	void UpdateMemberStateCounts(const Host::Ptr& host);
+
 	static void EvaluateObjectRules(const Host::Ptr& host);
 
 private:
 	mutable boost::mutex m_HostGroupMutex;
 	std::set<Host::Ptr> m_Members;
+	CheckableStateHistogram m_MemberStates;
 
 	static bool EvaluateObjectRule(const Host::Ptr& host, const intrusive_ptr<ConfigItem>& item);
 };
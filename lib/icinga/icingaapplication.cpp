@@ -33,6 +33,8 @@
 #include "base/scriptglobal.hpp"
 #include "base/initialize.hpp"
 #include "base/statsfunction.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/process.hpp"
 #include "base/loader.hpp"
 #include <fstream>
 
@@ -40,6 +42,13 @@ using namespace icinga;
 
 static Timer::Ptr l_RetentionTimer;
 
+/* The state file is rewritten entirely once per hour or when the state
+ * journal has grown larger than the state file. */
+static const double l_StateCompactionInterval = 3600;
+static double l_LastFullStateDump = 0;
+static size_t l_StateFileSize = 0;
+static size_t l_StateJournalSize = 0;
+
 REGISTER_TYPE(IcingaApplication);
 INITIALIZE_ONCE(&IcingaApplication::StaticInitialize);
 
@@ -70,7 +79,14 @@ void IcingaApplication::StatsFunc(const Dictionary::Ptr& status, const Array::Pt
 {
 	DictionaryData nodes;
 
-	for (const IcingaApplication::Ptr& icingaapplication : ConfigType::GetObjectsByType<IcingaApplication>()) {
+	std::vector<double> spawnLatency = Process::GetSpawnLatencyPercentiles({ 50, 95, 99 });
+	size_t postProcessingItems = Checkable::GetPostProcessingQueueLength();
+	size_t eventHandlerItems = Checkable::GetEventHandlerQueueLength();
+	uint64_t eventHandlersExecuted = Checkable::GetEventHandlersExecuted();
+	uint64_t eventHandlersCoalesced = Checkable::GetEventHandlersCoalesced();
+	uint64_t eventHandlersDropped = Checkable::GetEventHandlersDropped();
+
+	for (const IcingaApplication::Ptr& icingaapplication : ConfigType::GetObjectViewByType<IcingaApplication>()) {
 		nodes.emplace_back(icingaapplication->GetName(), new Dictionary({
 			{ "node_name", icingaapplication->GetNodeName() },
 			{ "enable_notifications", icingaapplication->GetEnableNotifications() },
@@ -82,10 +98,27 @@ void IcingaApplication::StatsFunc(const Dictionary::Ptr& status, const Array::Pt
 			{ "pid", Utility::GetPid() },
 			{ "program_start", Application::GetStartTime() },
 			{ "version", Application::GetAppVersion() },
-			{ "environment", ScriptGlobal::Get("Environment", &Empty) }
+			{ "environment", ScriptGlobal::Get("Environment", &Empty) },
+			{ "spawn_latency_p50", spawnLatency[0] },
+			{ "spawn_latency_p95", spawnLatency[1] },
+			{ "spawn_latency_p99", spawnLatency[2] },
+			{ "checkresult_post_processing_queue_items", postProcessingItems },
+			{ "event_handler_queue_items", eventHandlerItems },
+			{ "event_handlers_executed", eventHandlersExecuted },
+			{ "event_handlers_coalesced", eventHandlersCoalesced },
+			{ "event_handlers_dropped", eventHandlersDropped }
 		}));
 	}
 
+	perfdata->Add(new PerfdataValue("spawn_latency_p50", spawnLatency[0]));
+	perfdata->Add(new PerfdataValue("spawn_latency_p95", spawnLatency[1]));
+	perfdata->Add(new PerfdataValue("spawn_latency_p99", spawnLatency[2]));
+	perfdata->Add(new PerfdataValue("checkresult_post_processing_queue_items", postProcessingItems));
+	perfdata->Add(new PerfdataValue("event_handler_queue_items", eventHandlerItems));
+	perfdata->Add(new PerfdataValue("event_handlers_executed", eventHandlersExecuted));
+	perfdata->Add(new PerfdataValue("event_handlers_coalesced", eventHandlersCoalesced));
+	perfdata->Add(new PerfdataValue("event_handlers_dropped", eventHandlersDropped));
+
 	status->Set("icingaapplication", new Dictionary(std::move(nodes)));
 }
 
@@ -100,7 +133,7 @@ int IcingaApplication::Main()
 
 	/* periodically dump the program state */
 	l_RetentionTimer = new Timer();
-	l_RetentionTimer->SetInterval(300);
+	l_RetentionTimer->SetInterval(60);
 	l_RetentionTimer->OnTimerExpired.connect(std::bind(&IcingaApplication::DumpProgramState, this));
 	l_RetentionTimer->Start();
 
@@ -118,6 +151,21 @@ void IcingaApplication::OnShutdown()
 		l_RetentionTimer->Stop();
 	}
 
+	/* Let the state file include the check results which are still being processed. */
+	Checkable::WaitForPostProcessing();
+
+	DumpProgramState();
+}
+
+void IcingaApplication::OnHandover()
+{
+	{
+		ObjectLock olock(this);
+		l_RetentionTimer->Stop();
+	}
+
+	Checkable::WaitForPostProcessing();
+
 	DumpProgramState();
 }
 
@@ -154,9 +202,23 @@ static void PersistModAttrHelper(std::fstream& fp, ConfigObject::Ptr& previousOb
 	previousObject = object;
 }
 
+/**
+ * Writes the state of all objects which changed since the last call to the
+ * state journal, or the state of all objects to the state file if the
+ * journal needs to be compacted.
+ */
 void IcingaApplication::DumpProgramState()
 {
-	ConfigObject::DumpObjects(GetStatePath());
+	double now = Utility::GetTime();
+
+	if (l_LastFullStateDump == 0 || now - l_LastFullStateDump > l_StateCompactionInterval || l_StateJournalSize > l_StateFileSize) {
+		l_StateFileSize = ConfigObject::DumpObjects(GetStatePath());
+		l_StateJournalSize = 0;
+		l_LastFullStateDump = now;
+	} else {
+		l_StateJournalSize += ConfigObject::DumpModifiedObjects(GetStatePath());
+	}
+
 	DumpModifiedAttributes();
 }
 
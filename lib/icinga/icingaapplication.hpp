@@ -59,6 +59,7 @@ private:
 	void DumpModifiedAttributes();
 
 	void OnShutdown() override;
+	void OnHandover() override;
 };
 
 }
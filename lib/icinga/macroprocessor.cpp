@@ -28,10 +28,72 @@
 #include "base/scriptframe.hpp"
 #include "base/convert.hpp"
 #include "base/exception.hpp"
-#include <boost/algorithm/string/join.hpp>
+#include <algorithm>
+#include <unordered_map>
 
 using namespace icinga;
 
+/**
+ * A macro name which was split into the resolver name (if any) and the
+ * attribute path.
+ */
+struct MacroPath
+{
+	String ObjName;
+	std::vector<String> Tokens;
+	String Attribute;
+};
+
+struct MacroNameHash
+{
+	size_t operator()(const String& name) const
+	{
+		return std::hash<std::string>()(name.GetData());
+	}
+};
+
+static thread_local std::unordered_map<String, MacroPath, MacroNameHash> l_MacroPaths;
+static thread_local MacroResolutionScope *l_ResolutionScope = nullptr;
+
+MacroResolutionScope::MacroResolutionScope()
+	: m_Previous(l_ResolutionScope)
+{
+	l_ResolutionScope = this;
+}
+
+MacroResolutionScope::~MacroResolutionScope()
+{
+	l_ResolutionScope = m_Previous;
+}
+
+/**
+ * Returns the split macro name. The same few macro names are used over and
+ * over again so they're only split once per thread.
+ */
+static const MacroPath& GetMacroPath(const String& macro)
+{
+	auto it = l_MacroPaths.find(macro);
+
+	if (it != l_MacroPaths.end())
+		return it->second;
+
+	/* Names built by functions could otherwise grow the cache without bounds. */
+	if (l_MacroPaths.size() >= 4096)
+		l_MacroPaths.clear();
+
+	MacroPath path;
+	path.Tokens = macro.Split(".");
+
+	if (path.Tokens.size() > 1) {
+		path.ObjName = path.Tokens[0];
+		path.Tokens.erase(path.Tokens.begin());
+		path.Attribute = macro.SubStr(path.ObjName.GetLength() + 1);
+	} else
+		path.Attribute = macro;
+
+	return l_MacroPaths.emplace(macro, std::move(path)).first->second;
+}
+
 Value MacroProcessor::ResolveMacros(const Value& str, const ResolverList& resolvers,
 	const CheckResult::Ptr& cr, String *missingMacro,
 	const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
@@ -95,13 +157,9 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 
 	*recursive_macro = false;
 
-	std::vector<String> tokens = macro.Split(".");
-
-	String objName;
-	if (tokens.size() > 1) {
-		objName = tokens[0];
-		tokens.erase(tokens.begin());
-	}
+	const MacroPath& path = GetMacroPath(macro);
+	const String& objName = path.ObjName;
+	const std::vector<String>& tokens = path.Tokens;
 
 	for (const ResolverSpec& resolver : resolvers) {
 		if (!objName.IsEmpty() && objName != resolver.first)
@@ -113,8 +171,7 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 			if (dobj) {
 				Dictionary::Ptr vars = dobj->GetVars();
 
-				if (vars && vars->Contains(macro)) {
-					*result = vars->Get(macro);
+				if (vars && vars->Get(macro, result)) {
 					*recursive_macro = true;
 					return true;
 				}
@@ -123,19 +180,30 @@ bool MacroProcessor::ResolveMacro(const String& macro, const ResolverList& resol
 
 		auto *mresolver = dynamic_cast<MacroResolver *>(resolver.second.get());
 
-		if (mresolver && mresolver->ResolveMacro(boost::algorithm::join(tokens, "."), cr, result))
+		if (mresolver && mresolver->ResolveMacro(path.Attribute, cr, result))
 			return true;
 
 		Value ref = resolver.second;
 		bool valid = true;
+		auto first = tokens.begin();
+
+		/* Custom variables don't need a reflection lookup. */
+		if (tokens.size() > 1 && tokens[0] == "vars") {
+			CustomVarObject::Ptr dobj = dynamic_pointer_cast<CustomVarObject>(resolver.second);
+
+			if (dobj) {
+				ref = dobj->GetVars();
+				first++;
+			}
+		}
+
+		for (auto it = first; it != tokens.end(); it++) {
+			const String& token = *it;
 
-		for (const String& token : tokens) {
 			if (ref.IsObjectType<Dictionary>()) {
 				Dictionary::Ptr dict = ref;
-				if (dict->Contains(token)) {
-					ref = dict->Get(token);
-					continue;
-				} else {
+
+				if (!dict->Get(token, &ref)) {
 					valid = false;
 					break;
 				}
@@ -184,11 +252,8 @@ Value MacroProcessor::EvaluateFunction(const Function::Ptr& func, const Resolver
 	const CheckResult::Ptr& cr, const MacroProcessor::EscapeCallback& escapeFn,
 	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel)
 {
-	Dictionary::Ptr resolvers_this = new Dictionary();
-
-	for (const ResolverSpec& resolver : resolvers) {
-		resolvers_this->Set(resolver.first, resolver.second);
-	}
+	DictionaryData resolvers_this;
+	resolvers_this.reserve(resolvers.size() + 2);
 
 	auto internalResolveMacrosShim = [resolvers, cr, resolvedMacros, useResolvedMacros, recursionLevel](const std::vector<Value>& args) {
 		if (args.size() < 1)
@@ -200,7 +265,7 @@ Value MacroProcessor::EvaluateFunction(const Function::Ptr& func, const Resolver
 			resolvedMacros, useResolvedMacros, recursionLevel);
 	};
 
-	resolvers_this->Set("macro", new Function("macro (temporary)", internalResolveMacrosShim, { "str" }));
+	resolvers_this.emplace_back("macro", new Function("macro (temporary)", internalResolveMacrosShim, { "str" }));
 
 	auto internalResolveArgumentsShim = [resolvers, cr, resolvedMacros, useResolvedMacros, recursionLevel](const std::vector<Value>& args) {
 		if (args.size() < 2)
@@ -210,9 +275,120 @@ Value MacroProcessor::EvaluateFunction(const Function::Ptr& func, const Resolver
 			resolvedMacros, useResolvedMacros, recursionLevel + 1);
 	};
 
-	resolvers_this->Set("resolve_arguments", new Function("resolve_arguments (temporary)", internalResolveArgumentsShim, { "command", "args" }));
+	resolvers_this.emplace_back("resolve_arguments", new Function("resolve_arguments (temporary)", internalResolveArgumentsShim, { "command", "args" }));
+
+	/* The first value wins for duplicate keys: The shims take precedence, followed by the last resolver. */
+	for (auto it = resolvers.rbegin(); it != resolvers.rend(); it++) {
+		resolvers_this.emplace_back(it->first, it->second);
+	}
+
+	Dictionary::Ptr thisDict = new Dictionary(std::move(resolvers_this));
+
+	return func->InvokeThis(thisDict);
+}
+
+/**
+ * Resolves a single macro, i.e. the name between two $ signs.
+ */
+Value MacroProcessor::ResolveSingleMacro(const String& name, const ResolverList& resolvers,
+	const CheckResult::Ptr& cr, String *missingMacro,
+	const MacroProcessor::EscapeCallback& escapeFn, const Dictionary::Ptr& resolvedMacros,
+	bool useResolvedMacros, int recursionLevel)
+{
+	Value resolved_macro;
+	bool recursive_macro;
+	bool found;
+
+	MacroResolutionScope *scope = useResolvedMacros ? nullptr : l_ResolutionScope;
+
+	if (scope) {
+		auto it = scope->m_Macros.find(name);
+
+		if (it != scope->m_Macros.end()) {
+			resolved_macro = it->second;
+
+			if (resolvedMacros)
+				resolvedMacros->Set(name, resolved_macro);
+
+			if (escapeFn)
+				resolved_macro = escapeFn(resolved_macro);
+
+			return resolved_macro;
+		}
+	}
+
+	if (useResolvedMacros) {
+		recursive_macro = false;
+		found = resolvedMacros->Contains(name);
+
+		if (found)
+			resolved_macro = resolvedMacros->Get(name);
+	} else
+		found = ResolveMacro(name, resolvers, cr, &resolved_macro, &recursive_macro);
+
+	/* $$ is an escape sequence for $. */
+	if (name.IsEmpty()) {
+		resolved_macro = "$";
+		found = true;
+	}
+
+	if (resolved_macro.IsObjectType<Function>()) {
+		resolved_macro = EvaluateFunction(resolved_macro, resolvers, cr, escapeFn,
+			resolvedMacros, useResolvedMacros, recursionLevel + 1);
+	}
+
+	if (!found) {
+		if (!missingMacro)
+			Log(LogWarning, "MacroProcessor")
+				<< "Macro '" << name << "' is not defined.";
+		else
+			*missingMacro = name;
+	}
+
+	/* Values which depend on a missing macro aren't memoised so that every
+	 * caller gets to see the missing macro. */
+	String nestedMissingMacro;
+
+	/* recursively resolve macros in the macro if it was a user macro */
+	if (recursive_macro) {
+		if (resolved_macro.IsObjectType<Array>()) {
+			Array::Ptr arr = resolved_macro;
+			ArrayData resolved_arr;
+
+			ObjectLock olock(arr);
+			for (const Value& value : arr) {
+				if (value.IsScalar()) {
+					resolved_arr.push_back(InternalResolveMacros(value,
+						resolvers, cr, &nestedMissingMacro, EscapeCallback(), nullptr,
+						false, recursionLevel + 1));
+				} else
+					resolved_arr.push_back(value);
+			}
+
+			resolved_macro = new Array(std::move(resolved_arr));
+		} else if (resolved_macro.IsString()) {
+			resolved_macro = InternalResolveMacros(resolved_macro,
+				resolvers, cr, &nestedMissingMacro, EscapeCallback(), nullptr,
+				false, recursionLevel + 1);
+		}
+	}
+
+	if (!nestedMissingMacro.IsEmpty()) {
+		if (!missingMacro)
+			Log(LogWarning, "MacroProcessor")
+				<< "Macro '" << nestedMissingMacro << "' is not defined.";
+		else
+			*missingMacro = nestedMissingMacro;
+	} else if (scope && found)
+		scope->m_Macros.emplace(name, resolved_macro);
+
+	if (!useResolvedMacros && found && resolvedMacros)
+		resolvedMacros->Set(name, resolved_macro);
+
+	if (escapeFn)
+		resolved_macro = escapeFn(resolved_macro);
 
-	return func->InvokeThis(resolvers_this);
+	return resolved_macro;
 }
 
 Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverList& resolvers,
@@ -228,8 +404,6 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 	size_t offset, pos_first, pos_second;
 	offset = 0;
 
-	Dictionary::Ptr resolvers_this;
-
 	String result = str;
 	while ((pos_first = result.FindFirstOf("$", offset)) != String::NPos) {
 		pos_second = result.FindFirstOf("$", pos_first + 1);
@@ -239,92 +413,90 @@ Value MacroProcessor::InternalResolveMacros(const String& str, const ResolverLis
 
 		String name = result.SubStr(pos_first + 1, pos_second - pos_first - 1);
 
-		Value resolved_macro;
-		bool recursive_macro;
-		bool found;
+		Value resolved_macro = ResolveSingleMacro(name, resolvers, cr, missingMacro, escapeFn,
+			resolvedMacros, useResolvedMacros, recursionLevel);
 
-		if (useResolvedMacros) {
-			recursive_macro = false;
-			found = resolvedMacros->Contains(name);
+		/* we're done if this is the only macro and there are no other non-macro parts in the string */
+		if (pos_first == 0 && pos_second == str.GetLength() - 1)
+			return resolved_macro;
+		else if (resolved_macro.IsObjectType<Array>())
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
 
-			if (found)
-				resolved_macro = resolvedMacros->Get(name);
-		} else
-			found = ResolveMacro(name, resolvers, cr, &resolved_macro, &recursive_macro);
+		String resolved_macro_str = resolved_macro;
 
-		/* $$ is an escape sequence for $. */
-		if (name.IsEmpty()) {
-			resolved_macro = "$";
-			found = true;
-		}
+		result.Replace(pos_first, pos_second - pos_first + 1, resolved_macro_str);
+		offset = pos_first + resolved_macro_str.GetLength();
+	}
 
-		if (resolved_macro.IsObjectType<Function>()) {
-			resolved_macro = EvaluateFunction(resolved_macro, resolvers, cr, escapeFn,
-				resolvedMacros, useResolvedMacros, recursionLevel + 1);
-		}
+	return result;
+}
 
-		if (!found) {
-			if (!missingMacro)
-				Log(LogWarning, "MacroProcessor")
-					<< "Macro '" << name << "' is not defined.";
-			else
-				*missingMacro = name;
-		}
+/**
+ * Splits a macro string into its literal text and the macro names, so that
+ * strings which are resolved over and over again (e.g. output templates)
+ * don't have to be parsed each time.
+ *
+ * @param str The macro string.
+ * @returns The compiled macro string.
+ */
+CompiledMacroString::Ptr MacroProcessor::CompileMacroString(const String& str)
+{
+	CompiledMacroString::Ptr result = new CompiledMacroString();
+	result->Source = str;
 
-		/* recursively resolve macros in the macro if it was a user macro */
-		if (recursive_macro) {
-			if (resolved_macro.IsObjectType<Array>()) {
-				Array::Ptr arr = resolved_macro;
-				ArrayData resolved_arr;
+	size_t offset = 0, pos_first, pos_second;
 
-				ObjectLock olock(arr);
-				for (const Value& value : arr) {
-					if (value.IsScalar()) {
-						resolved_arr.push_back(InternalResolveMacros(value,
-							resolvers, cr, missingMacro, EscapeCallback(), nullptr,
-							false, recursionLevel + 1));
-					} else
-						resolved_arr.push_back(value);
-				}
+	while ((pos_first = str.FindFirstOf("$", offset)) != String::NPos) {
+		pos_second = str.FindFirstOf("$", pos_first + 1);
 
-				resolved_macro = new Array(std::move(resolved_arr));
-			} else if (resolved_macro.IsString()) {
-				resolved_macro = InternalResolveMacros(resolved_macro,
-					resolvers, cr, missingMacro, EscapeCallback(), nullptr,
-					false, recursionLevel + 1);
-			}
-		}
+		if (pos_second == String::NPos)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Closing $ not found in macro format string."));
 
-		if (!useResolvedMacros && found && resolvedMacros)
-			resolvedMacros->Set(name, resolved_macro);
+		if (pos_first > offset)
+			result->Parts.emplace_back(str.SubStr(offset, pos_first - offset), false);
 
-		if (escapeFn)
-			resolved_macro = escapeFn(resolved_macro);
+		result->Parts.emplace_back(str.SubStr(pos_first + 1, pos_second - pos_first - 1), true);
 
-		/* we're done if this is the only macro and there are no other non-macro parts in the string */
-		if (pos_first == 0 && pos_second == str.GetLength() - 1)
-			return resolved_macro;
-		else if (resolved_macro.IsObjectType<Array>())
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
+		offset = pos_second + 1;
+	}
 
-		if (resolved_macro.IsObjectType<Array>()) {
-			/* don't allow mixing strings and arrays in macro strings */
-			if (pos_first != 0 || pos_second != str.GetLength() - 1)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
+	if (offset < str.GetLength())
+		result->Parts.emplace_back(str.SubStr(offset), false);
 
-			return resolved_macro;
+	return result;
+}
+
+/**
+ * Resolves a macro string which was compiled with CompileMacroString(). The
+ * result is the same as ResolveMacros() would return for the source string.
+ */
+Value MacroProcessor::ResolveCompiledMacroString(const CompiledMacroString::Ptr& str,
+	const ResolverList& resolvers, const CheckResult::Ptr& cr, String *missingMacro,
+	const EscapeCallback& escapeFn)
+{
+	/* Strings which consist of a single macro return its value as-is. */
+	if (str->Parts.size() == 1 && str->Parts[0].second)
+		return ResolveSingleMacro(str->Parts[0].first, resolvers, cr, missingMacro, escapeFn, nullptr, false, 1);
+
+	String result;
+
+	for (const auto& part : str->Parts) {
+		if (!part.second) {
+			result += part.first;
+			continue;
 		}
 
-		String resolved_macro_str = resolved_macro;
+		Value resolved_macro = ResolveSingleMacro(part.first, resolvers, cr, missingMacro, escapeFn, nullptr, false, 1);
 
-		result.Replace(pos_first, pos_second - pos_first + 1, resolved_macro_str);
-		offset = pos_first + resolved_macro_str.GetLength();
+		if (resolved_macro.IsObjectType<Array>())
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Mixing both strings and non-strings in macros is not allowed."));
+
+		result += static_cast<String>(resolved_macro);
 	}
 
 	return result;
 }
 
-
 bool MacroProcessor::ValidateMacroString(const String& macro)
 {
 	if (macro.IsEmpty())
@@ -420,24 +592,116 @@ Value MacroProcessor::EscapeMacroShellArg(const Value& value)
 	return result;
 }
 
-struct CommandArgument
+/**
+ * Evaluates the resolved value of a set_if attribute.
+ *
+ * @returns false if the value is invalid, true otherwise.
+ */
+static bool EvaluateSetIf(const Value& setIf, const String& key, bool *result)
 {
-	int Order{0};
-	bool SkipKey{false};
-	bool RepeatKey{true};
-	bool SkipValue{false};
-	String Key;
-	Value AValue;
-
-	bool operator<(const CommandArgument& rhs) const
-	{
-		return Order < rhs.Order;
+	if (setIf == "true")
+		*result = true;
+	else if (setIf == "false")
+		*result = false;
+	else {
+		try {
+			*result = Convert::ToLong(setIf);
+		} catch (const std::exception& ex) {
+			/* tried to convert a string */
+			Log(LogWarning, "PluginUtility")
+				<< "Error evaluating set_if value '" << setIf
+				<< "' used in argument '" << key << "': " << ex.what();
+			return false;
+		}
 	}
-};
+
+	return true;
+}
+
+/**
+ * Returns whether resolving macros in a value doesn't change it (other than
+ * converting it to a string).
+ */
+static bool IsConstantMacroValue(const Value& value)
+{
+	return value.IsEmpty() || (value.IsScalar() && String(value).FindFirstOf("$") == String::NPos);
+}
+
+/**
+ * Prepares the arguments of a command so that they can be resolved with
+ * ResolveCompiledArguments(). The result only depends on the arguments
+ * dictionary and can be reused until the dictionary is changed.
+ *
+ * @param arguments The command's arguments.
+ * @returns The compiled arguments.
+ */
+CompiledCommandArguments::Ptr MacroProcessor::CompileArguments(const Dictionary::Ptr& arguments)
+{
+	CompiledCommandArguments::Ptr compiled = new CompiledCommandArguments();
+	compiled->Source = arguments;
+
+	ObjectLock olock(arguments);
+	for (const Dictionary::Pair& kv : arguments) {
+		const Value& arginfo = kv.second;
+
+		CompiledCommandArgument arg;
+		arg.Key = kv.first;
+
+		if (arginfo.IsObjectType<Dictionary>()) {
+			Dictionary::Ptr argdict = arginfo;
+			if (argdict->Contains("key"))
+				arg.Key = argdict->Get("key");
+			arg.ArgValue = argdict->Get("value");
+			if (argdict->Contains("required"))
+				arg.Required = argdict->Get("required");
+			arg.SkipKey = argdict->Get("skip_key");
+			if (argdict->Contains("repeat_key"))
+				arg.RepeatKey = argdict->Get("repeat_key");
+			arg.Order = argdict->Get("order");
+			arg.SetIf = argdict->Get("set_if");
+
+			/* set_if values without macros are evaluated right away. */
+			if (!arg.SetIf.IsEmpty() && IsConstantMacroValue(arg.SetIf)) {
+				bool value;
+
+				if (!EvaluateSetIf(String(arg.SetIf), arg.Key, &value) || !value)
+					continue;
+
+				arg.SetIf = Empty;
+			}
+		} else
+			arg.ArgValue = arginfo;
+
+		if (arg.ArgValue.IsEmpty())
+			arg.SkipValue = true;
+
+		if (IsConstantMacroValue(arg.ArgValue)) {
+			arg.Constant = true;
+
+			if (!arg.ArgValue.IsEmpty())
+				arg.ArgValue = String(arg.ArgValue);
+		}
+
+		compiled->Arguments.emplace_back(std::move(arg));
+	}
+
+	std::stable_sort(compiled->Arguments.begin(), compiled->Arguments.end(),
+		[](const CompiledCommandArgument& a, const CompiledCommandArgument& b) { return a.Order < b.Order; });
+
+	return compiled;
+}
 
 Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::Ptr& arguments,
 	const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
 	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel)
+{
+	return ResolveCompiledArguments(command, arguments ? CompileArguments(arguments) : nullptr,
+		resolvers, cr, resolvedMacros, useResolvedMacros, recursionLevel);
+}
+
+Value MacroProcessor::ResolveCompiledArguments(const Value& command, const CompiledCommandArguments::Ptr& arguments,
+	const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
+	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel)
 {
 	if (useResolvedMacros)
 		REQUIRE_NOT_NULL(resolvedMacros);
@@ -451,98 +715,51 @@ Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::P
 	}
 
 	if (arguments) {
-		std::vector<CommandArgument> args;
-
-		ObjectLock olock(arguments);
-		for (const Dictionary::Pair& kv : arguments) {
-			const Value& arginfo = kv.second;
-
-			CommandArgument arg;
-			arg.Key = kv.first;
-
-			bool required = false;
-			Value argval;
-
-			if (arginfo.IsObjectType<Dictionary>()) {
-				Dictionary::Ptr argdict = arginfo;
-				if (argdict->Contains("key"))
-					arg.Key = argdict->Get("key");
-				argval = argdict->Get("value");
-				if (argdict->Contains("required"))
-					required = argdict->Get("required");
-				arg.SkipKey = argdict->Get("skip_key");
-				if (argdict->Contains("repeat_key"))
-					arg.RepeatKey = argdict->Get("repeat_key");
-				arg.Order = argdict->Get("order");
-
-				Value set_if = argdict->Get("set_if");
-
-				if (!set_if.IsEmpty()) {
-					String missingMacro;
-					Value set_if_resolved = MacroProcessor::ResolveMacros(set_if, resolvers,
-						cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
-						useResolvedMacros, recursionLevel + 1);
-
-					if (!missingMacro.IsEmpty())
-						continue;
-
-					int value;
-
-					if (set_if_resolved == "true")
-						value = 1;
-					else if (set_if_resolved == "false")
-						value = 0;
-					else {
-						try {
-							value = Convert::ToLong(set_if_resolved);
-						} catch (const std::exception& ex) {
-							/* tried to convert a string */
-							Log(LogWarning, "PluginUtility")
-								<< "Error evaluating set_if value '" << set_if_resolved
-								<< "' used in argument '" << arg.Key << "': " << ex.what();
-							continue;
-						}
-					}
+		Array::Ptr command_arr = resolvedCommand;
 
-					if (!value)
-						continue;
-				}
-			}
-			else
-				argval = arginfo;
+		for (const CompiledCommandArgument& arg : arguments->Arguments) {
+			if (!arg.SetIf.IsEmpty()) {
+				String missingMacro;
+				Value set_if_resolved = MacroProcessor::ResolveMacros(arg.SetIf, resolvers,
+					cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
+					useResolvedMacros, recursionLevel + 1);
 
-			if (argval.IsEmpty())
-				arg.SkipValue = true;
+				if (!missingMacro.IsEmpty())
+					continue;
 
-			String missingMacro;
-			arg.AValue = MacroProcessor::ResolveMacros(argval, resolvers,
-				cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
-				useResolvedMacros, recursionLevel + 1);
+				bool value;
 
-			if (!missingMacro.IsEmpty()) {
-				if (required) {
-					BOOST_THROW_EXCEPTION(ScriptError("Non-optional macro '" + missingMacro + "' used in argument '" +
-						arg.Key + "' is missing."));
-				}
-
-				continue;
+				if (!EvaluateSetIf(set_if_resolved, arg.Key, &value) || !value)
+					continue;
 			}
 
-			args.emplace_back(std::move(arg));
-		}
+			Value avalue;
 
-		std::sort(args.begin(), args.end());
+			if (arg.Constant)
+				avalue = arg.ArgValue;
+			else {
+				String missingMacro;
+				avalue = MacroProcessor::ResolveMacros(arg.ArgValue, resolvers,
+					cr, &missingMacro, MacroProcessor::EscapeCallback(), resolvedMacros,
+					useResolvedMacros, recursionLevel + 1);
 
-		Array::Ptr command_arr = resolvedCommand;
-		for (const CommandArgument& arg : args) {
+				if (!missingMacro.IsEmpty()) {
+					if (arg.Required) {
+						BOOST_THROW_EXCEPTION(ScriptError("Non-optional macro '" + missingMacro + "' used in argument '" +
+							arg.Key + "' is missing."));
+					}
+
+					continue;
+				}
+			}
 
-			if (arg.AValue.IsObjectType<Dictionary>()) {
+			if (avalue.IsObjectType<Dictionary>()) {
 				Log(LogWarning, "PluginUtility")
 					<< "Tried to use dictionary in argument '" << arg.Key << "'.";
 				continue;
-			} else if (arg.AValue.IsObjectType<Array>()) {
+			} else if (avalue.IsObjectType<Array>()) {
 				bool first = true;
-				Array::Ptr arr = static_cast<Array::Ptr>(arg.AValue);
+				Array::Ptr arr = static_cast<Array::Ptr>(avalue);
 
 				ObjectLock olock(arr);
 				for (const Value& value : arr) {
@@ -557,7 +774,7 @@ Value MacroProcessor::ResolveArguments(const Value& command, const Dictionary::P
 					AddArgumentHelper(command_arr, arg.Key, value, add_key, !arg.SkipValue);
 				}
 			} else
-				AddArgumentHelper(command_arr, arg.Key, arg.AValue, !arg.SkipKey, !arg.SkipValue);
+				AddArgumentHelper(command_arr, arg.Key, avalue, !arg.SkipKey, !arg.SkipValue);
 		}
 	}
 
@@ -23,11 +23,85 @@
 #include "icinga/i2-icinga.hpp"
 #include "icinga/checkable.hpp"
 #include "base/value.hpp"
+#include <map>
 #include <vector>
 
 namespace icinga
 {
 
+/**
+ * A command argument which was prepared by MacroProcessor::CompileArguments().
+ *
+ * @ingroup icinga
+ */
+struct CompiledCommandArgument
+{
+	int Order{0};
+	bool SkipKey{false};
+	bool RepeatKey{true};
+	bool SkipValue{false};
+	bool Required{false};
+	bool Constant{false};
+	String Key;
+	Value SetIf;
+	Value ArgValue;
+};
+
+/**
+ * Command arguments sorted by their order. Values without macros are
+ * converted to strings in advance so that they don't have to be resolved
+ * for every execution.
+ *
+ * @ingroup icinga
+ */
+class CompiledCommandArguments final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CompiledCommandArguments);
+
+	Dictionary::Ptr Source;
+	std::vector<CompiledCommandArgument> Arguments;
+};
+
+/**
+ * A macro string which was split into literal text (false) and macro names
+ * (true) by MacroProcessor::CompileMacroString().
+ *
+ * @ingroup icinga
+ */
+class CompiledMacroString final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CompiledMacroString);
+
+	String Source;
+	std::vector<std::pair<String, bool> > Parts;
+};
+
+/**
+ * Memoises the macros which are resolved by the current thread while the
+ * scope exists, e.g. for the command line, arguments and environment of a
+ * single command execution. The resolvers must not change within a scope.
+ * Scopes may be nested; the innermost scope is used.
+ *
+ * @ingroup icinga
+ */
+class MacroResolutionScope
+{
+public:
+	MacroResolutionScope();
+	~MacroResolutionScope();
+
+	MacroResolutionScope(const MacroResolutionScope&) = delete;
+	MacroResolutionScope& operator=(const MacroResolutionScope&) = delete;
+
+private:
+	MacroResolutionScope *m_Previous;
+	std::map<String, Value> m_Macros;
+
+	friend class MacroProcessor;
+};
+
 /**
  * Resolves macros.
  *
@@ -49,6 +123,16 @@ public:
 	static Value ResolveArguments(const Value& command, const Dictionary::Ptr& arguments,
 		const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel = 0);
+	static Value ResolveCompiledArguments(const Value& command, const CompiledCommandArguments::Ptr& arguments,
+		const MacroProcessor::ResolverList& resolvers, const CheckResult::Ptr& cr,
+		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel = 0);
+
+	static CompiledCommandArguments::Ptr CompileArguments(const Dictionary::Ptr& arguments);
+
+	static CompiledMacroString::Ptr CompileMacroString(const String& str);
+	static Value ResolveCompiledMacroString(const CompiledMacroString::Ptr& str,
+		const ResolverList& resolvers, const CheckResult::Ptr& cr = nullptr,
+		String *missingMacro = nullptr, const EscapeCallback& escapeFn = EscapeCallback());
 
 	static bool ValidateMacroString(const String& macro);
 	static void ValidateCustomVars(const ConfigObject::Ptr& object, const Dictionary::Ptr& value);
@@ -58,6 +142,9 @@ private:
 
 	static bool ResolveMacro(const String& macro, const ResolverList& resolvers,
 		const CheckResult::Ptr& cr, Value *result, bool *recursive_macro);
+	static Value ResolveSingleMacro(const String& name, const ResolverList& resolvers,
+		const CheckResult::Ptr& cr, String *missingMacro, const EscapeCallback& escapeFn,
+		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros, int recursionLevel);
 	static Value InternalResolveMacros(const String& str,
 		const ResolverList& resolvers, const CheckResult::Ptr& cr,
 		String *missingMacro, const EscapeCallback& escapeFn,
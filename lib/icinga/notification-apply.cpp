@@ -152,13 +152,17 @@ void Notification::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	for (ApplyRule& rule : ApplyRule::GetRules("Notification"))
+	Dictionary::Ptr vars = new Dictionary({ { "host", host } });
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("Notification", vars))
 	{
-		if (rule.GetTargetType() != "Host")
+		if (rule->GetTargetType() != "Host")
 			continue;
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+		ApplyRuleEvaluation evaluation(*rule);
+
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -166,11 +170,18 @@ void Notification::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	for (ApplyRule& rule : ApplyRule::GetRules("Notification")) {
-		if (rule.GetTargetType() != "Service")
+	Dictionary::Ptr vars = new Dictionary({
+		{ "host", service->GetHost() },
+		{ "service", service }
+	});
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("Notification", vars)) {
+		if (rule->GetTargetType() != "Service")
 			continue;
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+		ApplyRuleEvaluation evaluation(*rule);
+
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
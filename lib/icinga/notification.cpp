@@ -29,6 +29,9 @@
 #include "base/exception.hpp"
 #include "base/initialize.hpp"
 #include "base/scriptglobal.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <mutex>
 
 using namespace icinga;
 
@@ -40,6 +43,28 @@ std::map<String, int> Notification::m_TypeFilterMap;
 
 boost::signals2::signal<void (const Notification::Ptr&, const MessageOrigin::Ptr&)> Notification::OnNextNotificationChanged;
 
+/* Incremented whenever the resolved recipients of any notification may have changed. */
+static std::atomic<uint64_t> l_RecipientsGeneration(1);
+
+static std::atomic<int> l_MaxConcurrentNotifications(16);
+static std::once_flag l_NotificationQueueOnce;
+static WorkQueue *l_NotificationQueue;
+
+/**
+ * Returns the queue which runs the notification commands. Its number of
+ * threads limits how many users are notified concurrently.
+ */
+static WorkQueue& GetNotificationQueue()
+{
+	std::call_once(l_NotificationQueueOnce, []() {
+		/* Intentionally leaked, notifications may still be sent during shutdown. */
+		l_NotificationQueue = new WorkQueue(0, l_MaxConcurrentNotifications);
+		l_NotificationQueue->SetName("Notification");
+	});
+
+	return *l_NotificationQueue;
+}
+
 String NotificationNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
 	Notification::Ptr notification = dynamic_pointer_cast<Notification>(context);
@@ -112,6 +137,14 @@ void Notification::StaticInitialize()
 	m_TypeFilterMap["Recovery"] = NotificationRecovery;
 	m_TypeFilterMap["FlappingStart"] = NotificationFlappingStart;
 	m_TypeFilterMap["FlappingEnd"] = NotificationFlappingEnd;
+
+	Notification::OnUsersRawChanged.connect(std::bind(&Notification::InvalidateRecipients));
+	Notification::OnUserGroupsRawChanged.connect(std::bind(&Notification::InvalidateRecipients));
+
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		if (dynamic_pointer_cast<User>(object) || dynamic_pointer_cast<UserGroup>(object))
+			InvalidateRecipients();
+	});
 }
 
 void Notification::OnConfigLoaded()
@@ -216,6 +249,47 @@ std::set<UserGroup::Ptr> Notification::GetUserGroups() const
 	return result;
 }
 
+/**
+ * Returns the users and the members of the user groups. The result is cached
+ * until the users, user groups or group memberships change.
+ */
+std::shared_ptr<const std::set<User::Ptr> > Notification::GetRecipients() const
+{
+	uint64_t generation = l_RecipientsGeneration;
+
+	boost::mutex::scoped_lock lock(m_RecipientsMutex);
+
+	if (m_Recipients && m_RecipientsGeneration == generation)
+		return m_Recipients;
+
+	std::shared_ptr<std::set<User::Ptr> > recipients = std::make_shared<std::set<User::Ptr> >(GetUsers());
+
+	for (const UserGroup::Ptr& ug : GetUserGroups()) {
+		std::set<User::Ptr> members = ug->GetMembers();
+		recipients->insert(members.begin(), members.end());
+	}
+
+	/* If the generation changed in the meantime the next call resolves the recipients again. */
+	m_Recipients = recipients;
+	m_RecipientsGeneration = generation;
+
+	return m_Recipients;
+}
+
+void Notification::InvalidateRecipients()
+{
+	l_RecipientsGeneration++;
+}
+
+/**
+ * Sets how many notification commands may be executed concurrently. This only
+ * has an effect until the first notification is sent.
+ */
+void Notification::SetMaxConcurrentNotifications(int maxNotifications)
+{
+	l_MaxConcurrentNotifications = maxNotifications;
+}
+
 TimePeriod::Ptr Notification::GetPeriod() const
 {
 	return TimePeriod::GetByName(GetPeriodRaw());
@@ -372,20 +446,34 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			SetLastProblemNotification(now);
 	}
 
-	std::set<User::Ptr> allUsers;
+	std::shared_ptr<const std::set<User::Ptr> > allUsers = GetRecipients();
 
-	std::set<User::Ptr> users = GetUsers();
-	std::copy(users.begin(), users.end(), std::inserter(allUsers, allUsers.begin()));
+	/* The state is the same for all users. */
+	unsigned long fstate;
+	String stateStr;
 
-	for (const UserGroup::Ptr& ug : GetUserGroups()) {
-		std::set<User::Ptr> members = ug->GetMembers();
-		std::copy(members.begin(), members.end(), std::inserter(allUsers, allUsers.begin()));
+	{
+		Host::Ptr host;
+		Service::Ptr service;
+		tie(host, service) = GetHostService(checkable);
+
+		if (service) {
+			fstate = ServiceStateToFilter(service->GetState());
+			stateStr = NotificationServiceStateToString(service->GetState());
+		} else {
+			fstate = HostStateToFilter(host->GetState());
+			stateStr = NotificationHostStateToString(host->GetState());
+		}
 	}
 
+	NotificationCommand::Ptr command = GetCommand();
+	bool batchUsers = command && command->GetBatchUsers();
+	std::vector<User::Ptr> batchedUsers;
+
 	std::set<User::Ptr> allNotifiedUsers;
 	Array::Ptr notifiedProblemUsers = GetNotifiedProblemUsers();
 
-	for (const User::Ptr& user : allUsers) {
+	for (const User::Ptr& user : *allUsers) {
 		String userName = user->GetName();
 
 		if (!user->GetEnableNotifications()) {
@@ -394,7 +482,7 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			continue;
 		}
 
-		if (!CheckNotificationUserFilters(type, user, force, reminder)) {
+		if (!CheckNotificationUserFilters(type, user, force, reminder, fstate, stateStr)) {
 			Log(LogNotice, "Notification")
 				<< "Notification filters for user '" << userName << "' not matched. Not sending notification.";
 			continue;
@@ -413,7 +501,10 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			<< "Sending " << (reminder ? "reminder " : "") << "'" << NotificationTypeToStringInternal(type) << "' notification '"
 			<< GetName() << "' for user '" << userName << "'";
 
-		Utility::QueueAsyncCallback(std::bind(&Notification::ExecuteNotificationHelper, this, type, user, cr, force, author, text));
+		if (batchUsers)
+			batchedUsers.push_back(user);
+		else
+			GetNotificationQueue().Enqueue(std::bind(&Notification::ExecuteNotificationHelper, Notification::Ptr(this), type, user, cr, force, author, text));
 
 		/* collect all notified users */
 		allNotifiedUsers.insert(user);
@@ -423,6 +514,9 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 			notifiedProblemUsers->Add(userName);
 	}
 
+	if (!batchedUsers.empty())
+		GetNotificationQueue().Enqueue(std::bind(&Notification::ExecuteBatchNotificationHelper, Notification::Ptr(this), type, std::move(batchedUsers), cr, author, text));
+
 	/* if this was a recovery notification, reset all notified users */
 	if (type == NotificationRecovery)
 		notifiedProblemUsers->Clear();
@@ -431,7 +525,8 @@ void Notification::BeginExecuteNotification(NotificationType type, const CheckRe
 	Service::OnNotificationSentToAllUsers(this, checkable, allNotifiedUsers, type, cr, author, text, nullptr);
 }
 
-bool Notification::CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder)
+bool Notification::CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder,
+	unsigned long fstate, const String& stateStr)
 {
 	if (!force) {
 		TimePeriod::Ptr tp = user->GetPeriod();
@@ -463,22 +558,6 @@ bool Notification::CheckNotificationUserFilters(NotificationType type, const Use
 
 		/* check state filters it this is not a recovery notification */
 		if (type != NotificationRecovery) {
-			Checkable::Ptr checkable = GetCheckable();
-			Host::Ptr host;
-			Service::Ptr service;
-			tie(host, service) = GetHostService(checkable);
-
-			unsigned long fstate;
-			String stateStr;
-
-			if (service) {
-				fstate = ServiceStateToFilter(service->GetState());
-				stateStr = NotificationServiceStateToString(service->GetState());
-			} else {
-				fstate = HostStateToFilter(host->GetState());
-				stateStr = NotificationHostStateToString(host->GetState());
-			}
-
 			Log(LogDebug, "Notification")
 				<< "User notification, State '" << stateStr << "', StateFilter: "
 				<< NotificationFilterToString(user->GetStateFilter(), GetStateFilterMap())
@@ -529,6 +608,43 @@ void Notification::ExecuteNotificationHelper(NotificationType type, const User::
 	}
 }
 
+void Notification::ExecuteBatchNotificationHelper(NotificationType type, const std::vector<User::Ptr>& users, const CheckResult::Ptr& cr, const String& author, const String& text)
+{
+	try {
+		NotificationCommand::Ptr command = GetCommand();
+
+		if (!command) {
+			Log(LogDebug, "Notification")
+				<< "No command found for notification '" << GetName() << "'. Skipping execution.";
+			return;
+		}
+
+		ArrayData usersData;
+		usersData.reserve(users.size());
+
+		for (const User::Ptr& user : users) {
+			usersData.push_back(user);
+		}
+
+		command->ExecuteBatch(this, new Array(std::move(usersData)), cr, type, author, text);
+
+		/* required by compatlogger */
+		for (const User::Ptr& user : users) {
+			Service::OnNotificationSentToUser(this, GetCheckable(), user, type, cr, author, text, command->GetName(), nullptr);
+		}
+
+		Log(LogInformation, "Notification")
+			<< "Completed sending '" << NotificationTypeToStringInternal(type)
+			<< "' notification '" << GetName()
+			<< "' for checkable '" << GetCheckable()->GetName()
+			<< "' and " << users.size() << " users.";
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "Notification")
+			<< "Exception occurred during notification for checkable '"
+			<< GetCheckable()->GetName() << "': " << DiagnosticInformation(ex);
+	}
+}
+
 int icinga::ServiceStateToFilter(ServiceState state)
 {
 	switch (state) {
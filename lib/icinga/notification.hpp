@@ -30,6 +30,7 @@
 #include "remote/endpoint.hpp"
 #include "remote/messageorigin.hpp"
 #include "base/array.hpp"
+#include <memory>
 
 namespace icinga
 {
@@ -90,6 +91,10 @@ public:
 	TimePeriod::Ptr GetPeriod() const;
 	std::set<User::Ptr> GetUsers() const;
 	std::set<UserGroup::Ptr> GetUserGroups() const;
+	std::shared_ptr<const std::set<User::Ptr> > GetRecipients() const;
+
+	static void InvalidateRecipients();
+	static void SetMaxConcurrentNotifications(int maxNotifications);
 
 	void UpdateNotificationNumber();
 	void ResetNotificationNumber();
@@ -124,9 +129,15 @@ protected:
 private:
 	ObjectImpl<Checkable>::Ptr m_Checkable;
 
-	bool CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder);
+	mutable boost::mutex m_RecipientsMutex;
+	mutable std::shared_ptr<const std::set<User::Ptr> > m_Recipients;
+	mutable uint64_t m_RecipientsGeneration{0};
+
+	bool CheckNotificationUserFilters(NotificationType type, const User::Ptr& user, bool force, bool reminder,
+		unsigned long fstate, const String& stateStr);
 
 	void ExecuteNotificationHelper(NotificationType type, const User::Ptr& user, const CheckResult::Ptr& cr, bool force, const String& author = "", const String& text = "");
+	void ExecuteBatchNotificationHelper(NotificationType type, const std::vector<User::Ptr>& users, const CheckResult::Ptr& cr, const String& author, const String& text);
 
 	static bool EvaluateApplyRuleInstance(const intrusive_ptr<Checkable>& checkable, const String& name, ScriptFrame& frame, const ApplyRule& rule);
 	static bool EvaluateApplyRule(const intrusive_ptr<Checkable>& checkable, const ApplyRule& rule);
@@ -40,3 +40,23 @@ Dictionary::Ptr NotificationCommand::Execute(const Notification::Ptr& notificati
 		useResolvedMacros,
 	});
 }
+
+/**
+ * Executes the command once for multiple users. The execute function
+ * receives an array of users instead of a single user.
+ */
+Dictionary::Ptr NotificationCommand::ExecuteBatch(const Notification::Ptr& notification,
+	const Array::Ptr& users, const CheckResult::Ptr& cr, const NotificationType& type,
+	const String& author, const String& comment)
+{
+	return GetExecute()->Invoke({
+		notification,
+		users,
+		cr,
+		type,
+		author,
+		comment,
+		nullptr,
+		false,
+	});
+}
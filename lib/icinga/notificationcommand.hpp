@@ -44,6 +44,10 @@ public:
 		const String& author, const String& comment,
 		const Dictionary::Ptr& resolvedMacros = nullptr,
 		bool useResolvedMacros = false);
+
+	virtual Dictionary::Ptr ExecuteBatch(const intrusive_ptr<Notification>& notification,
+		const Array::Ptr& users, const CheckResult::Ptr& cr, const NotificationType& type,
+		const String& author, const String& comment);
 };
 
 }
@@ -19,6 +19,7 @@
 
 #include "icinga/pluginutility.hpp"
 #include "icinga/macroprocessor.hpp"
+#include "icinga/pluginworkerpool.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 #include "base/perfdatavalue.hpp"
@@ -35,13 +36,16 @@ void PluginUtility::ExecuteCommand(const Command::Ptr& commandObj, const Checkab
 	const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros,
 	const std::function<void(const Value& commandLine, const ProcessResult&)>& callback)
 {
+	/* The command line, its arguments and the environment often share macros. */
+	MacroResolutionScope macroScope;
+
 	Value raw_command = commandObj->GetCommandLine();
-	Dictionary::Ptr raw_arguments = commandObj->GetArguments();
+	CompiledCommandArguments::Ptr raw_arguments = commandObj->GetCompiledArguments();
 
 	Value command;
 
 	try {
-		command = MacroProcessor::ResolveArguments(raw_command, raw_arguments,
+		command = MacroProcessor::ResolveCompiledArguments(raw_command, raw_arguments,
 			macroResolvers, cr, resolvedMacros, useResolvedMacros);
 	} catch (const std::exception& ex) {
 		String message = DiagnosticInformation(ex);
@@ -84,14 +88,28 @@ void PluginUtility::ExecuteCommand(const Command::Ptr& commandObj, const Checkab
 	if (resolvedMacros && !useResolvedMacros)
 		return;
 
-	Process::Ptr process = new Process(Process::PrepareCommand(command), envMacros);
+	double timeout;
 
 	if (checkable->GetCheckTimeout().IsEmpty())
-		process->SetTimeout(commandObj->GetTimeout());
+		timeout = commandObj->GetTimeout();
 	else
-		process->SetTimeout(checkable->GetCheckTimeout());
+		timeout = checkable->GetCheckTimeout();
+
+#ifndef _WIN32
+	CheckCommand::Ptr checkCommand = dynamic_pointer_cast<CheckCommand>(commandObj);
+
+	/* Check commands with a worker command are executed by a pool of persistent workers. */
+	if (checkCommand && !checkCommand->GetWorkerCommand().IsEmpty()) {
+		PluginWorkerPool::GetPool(checkCommand)->Execute(Process::PrepareCommand(command), envMacros,
+			timeout, std::bind(callback, command, _1));
+		return;
+	}
+#endif /* _WIN32 */
 
+	Process::Ptr process = new Process(Process::PrepareCommand(command), envMacros);
+	process->SetTimeout(timeout);
 	process->SetAdjustPriority(true);
+	process->SetMaxOutputSize(commandObj->GetMaxOutputSize());
 
 	process->Run(std::bind(callback, command, _1));
 }
@@ -153,20 +171,31 @@ Array::Ptr PluginUtility::SplitPerfdata(const String& perfdata)
 		if (eqp == String::NPos)
 			break;
 
-		String label = perfdata.SubStr(begin, eqp - begin);
+		size_t spq = perfdata.FindFirstOf(' ', eqp);
 
-		if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'')
-			label = label.SubStr(1, label.GetLength() - 2);
+		if (spq == String::NPos)
+			spq = perfdata.GetLength();
+
+		String label = perfdata.SubStr(begin, eqp - begin);
 
 		size_t multi_index = label.RFind("::");
 
-		if (multi_index != String::NPos)
-			multi_prefix = "";
+		/* Most labels are neither quoted nor part of a multi-value series
+		 * and can be copied verbatim. */
+		if (multi_prefix.IsEmpty() && multi_index == String::NPos &&
+			label.FindFirstOf("' ") == String::NPos) {
+			result.emplace_back(perfdata.SubStr(begin, spq - begin));
+			begin = spq + 1;
+			continue;
+		}
 
-		size_t spq = perfdata.FindFirstOf(' ', eqp);
+		if (label.GetLength() > 2 && label[0] == '\'' && label[label.GetLength() - 1] == '\'') {
+			label = label.SubStr(1, label.GetLength() - 2);
+			multi_index = label.RFind("::");
+		}
 
-		if (spq == String::NPos)
-			spq = perfdata.GetLength();
+		if (multi_index != String::NPos)
+			multi_prefix = "";
 
 		String value = perfdata.SubStr(eqp + 1, spq - eqp - 1);
 
@@ -0,0 +1,310 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/pluginworkerpool.hpp"
+#include "base/json.hpp"
+#include "base/logger.hpp"
+#include "base/netstring.hpp"
+#include "base/objectlock.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/statsfunction.hpp"
+#include "base/exception.hpp"
+#include "base/utility.hpp"
+
+using namespace icinga;
+
+#ifndef _WIN32
+REGISTER_STATSFUNCTION(PluginWorkerPool, &PluginWorkerPool::StatsFunc);
+
+static boost::mutex l_PluginWorkerPoolsMutex;
+static std::map<String, PluginWorkerPool::Ptr> l_PluginWorkerPools;
+
+PluginWorkerPool::PluginWorkerPool(const String& name, const Process::Arguments& workerCommand, int size)
+	: m_Name(name), m_Size(size), m_WorkQueue(25000, size), m_WorkerCommand(workerCommand)
+{
+	m_WorkQueue.SetName("PluginWorkerPool, " + name);
+
+	for (int i = 0; i < size; i++) {
+		m_Workers.emplace_back(new Worker());
+		m_IdleWorkers.push_back(m_Workers.back().get());
+	}
+}
+
+/**
+ * Returns the worker pool for a check command. The pool is created when
+ * it's used for the first time. Changes to the worker_pool_size attribute
+ * require a restart.
+ *
+ * @param command The check command.
+ * @returns The pool.
+ */
+PluginWorkerPool::Ptr PluginWorkerPool::GetPool(const CheckCommand::Ptr& command)
+{
+	Process::Arguments workerCommand = Process::PrepareCommand(command->GetWorkerCommand());
+
+	boost::mutex::scoped_lock lock(l_PluginWorkerPoolsMutex);
+
+	PluginWorkerPool::Ptr& pool = l_PluginWorkerPools[command->GetName()];
+
+	if (!pool)
+		pool = new PluginWorkerPool(command->GetName(), workerCommand, std::max(command->GetWorkerPoolSize(), 1));
+	else
+		pool->SetWorkerCommand(workerCommand);
+
+	return pool;
+}
+
+void PluginWorkerPool::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
+{
+	DictionaryData nodes;
+
+	boost::mutex::scoped_lock lock(l_PluginWorkerPoolsMutex);
+
+	for (const auto& kv : l_PluginWorkerPools) {
+		const PluginWorkerPool::Ptr& pool = kv.second;
+
+		int busyWorkers = pool->m_BusyWorkers;
+		size_t queuedRequests = pool->m_WorkQueue.GetLength();
+		unsigned long requests = pool->m_Requests;
+		unsigned long timeouts = pool->m_Timeouts;
+		unsigned long workerStarts = pool->m_WorkerStarts;
+
+		nodes.emplace_back(kv.first, new Dictionary({
+			{ "workers", pool->m_Size },
+			{ "busy_workers", busyWorkers },
+			{ "queued_requests", queuedRequests },
+			{ "requests", requests },
+			{ "timeouts", timeouts },
+			{ "worker_starts", workerStarts }
+		}));
+
+		perfdata->Add(new PerfdataValue("pluginworkerpool_" + kv.first + "_busy_workers", busyWorkers));
+		perfdata->Add(new PerfdataValue("pluginworkerpool_" + kv.first + "_queued_requests", queuedRequests));
+	}
+
+	status->Set("pluginworkerpool", new Dictionary(std::move(nodes)));
+}
+
+/**
+ * Queues a plugin execution. The callback is invoked with the result once
+ * a worker has processed the request.
+ */
+void PluginWorkerPool::Execute(const Process::Arguments& arguments, const Dictionary::Ptr& env, double timeout,
+	const std::function<void (const ProcessResult&)>& callback)
+{
+	m_WorkQueue.Enqueue(std::bind(&PluginWorkerPool::ExecuteRequest, PluginWorkerPool::Ptr(this),
+		arguments, env, timeout, callback));
+}
+
+/**
+ * Restarts the workers if the worker command was changed at runtime.
+ */
+void PluginWorkerPool::SetWorkerCommand(const Process::Arguments& workerCommand)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (workerCommand == m_WorkerCommand)
+		return;
+
+	m_WorkerCommand = workerCommand;
+	m_Generation++;
+}
+
+void PluginWorkerPool::ExecuteRequest(const Process::Arguments& arguments, const Dictionary::Ptr& env, double timeout,
+	const std::function<void (const ProcessResult&)>& callback)
+{
+	ProcessResult pr;
+	pr.PID = -1;
+	pr.ExecutionStart = Utility::GetTime();
+
+	Worker *worker;
+	bool restart;
+
+	/* The work queue has one thread per worker, so there's always an idle worker. */
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		ASSERT(!m_IdleWorkers.empty());
+
+		worker = m_IdleWorkers.back();
+		m_IdleWorkers.pop_back();
+
+		restart = worker->Generation != m_Generation;
+	}
+
+	m_BusyWorkers++;
+	m_Requests++;
+
+	try {
+		if (restart)
+			StopWorker(worker);
+
+		if (worker->PID == -1)
+			StartWorker(worker);
+
+		pr.PID = worker->PID;
+
+		Dictionary::Ptr request = new Dictionary({
+			{ "arguments", Array::FromVector(arguments) },
+			{ "env", env },
+			{ "timeout", timeout }
+		});
+
+		NetString::WriteStringToStream(worker->Stream, JsonEncode(request));
+
+		String message;
+
+		if (ReadResponse(worker, timeout, &message)) {
+			Dictionary::Ptr response = JsonDecode(message);
+
+			pr.ExitStatus = response->Get("exit_status");
+			pr.Output = response->Get("output");
+		} else {
+			Log(LogWarning, "PluginWorkerPool")
+				<< "Killing worker " << worker->PID << " for check command '" << m_Name << "' ("
+				<< Process::PrettyPrintArguments(arguments) << ") after timeout of " << timeout << " seconds";
+
+			m_Timeouts++;
+
+			StopWorker(worker);
+
+			pr.ExitStatus = 128;
+			pr.Output = "<Timeout exceeded.>";
+		}
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "PluginWorkerPool")
+			<< "Worker for check command '" << m_Name << "' failed: " << DiagnosticInformation(ex, false);
+
+		StopWorker(worker);
+
+		pr.ExitStatus = 128;
+		pr.Output = "<Plugin worker failed: " + DiagnosticInformation(ex, false) + ">";
+	}
+
+	pr.ExecutionEnd = Utility::GetTime();
+
+	m_BusyWorkers--;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		m_IdleWorkers.push_back(worker);
+	}
+
+	if (callback)
+		Utility::QueueAsyncCallback(std::bind(callback, pr));
+}
+
+/**
+ * Reads a worker's response.
+ *
+ * @returns false if the timeout expired, true otherwise.
+ */
+bool PluginWorkerPool::ReadResponse(Worker *worker, double timeout, String *message)
+{
+	double deadline = Utility::GetTime() + timeout;
+
+	for (;;) {
+		/* Reading from the stream blocks, wait until there's data. */
+		if (worker->Context->MustRead) {
+			if (timeout > 0) {
+				double remaining = deadline - Utility::GetTime();
+
+				if (remaining <= 0)
+					return false;
+
+				timeval tv;
+				tv.tv_sec = static_cast<time_t>(remaining);
+				tv.tv_usec = static_cast<suseconds_t>((remaining - tv.tv_sec) * 1000 * 1000);
+
+				if (!worker->WorkerSocket->Poll(true, false, &tv))
+					continue;
+			} else
+				worker->WorkerSocket->Poll(true, false);
+		}
+
+		StreamReadStatus srs = NetString::ReadStringFromStream(worker->Stream, message, *worker->Context);
+
+		if (srs == StatusNewItem)
+			return true;
+
+		if (srs == StatusEof)
+			BOOST_THROW_EXCEPTION(std::runtime_error("Worker process closed the connection."));
+	}
+}
+
+void PluginWorkerPool::StartWorker(Worker *worker)
+{
+	Process::Arguments workerCommand;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+		workerCommand = m_WorkerCommand;
+		worker->Generation = m_Generation;
+	}
+
+	SOCKET fds[2];
+	Socket::SocketPair(fds);
+
+	/* stderr isn't part of the protocol and goes wherever ours goes. */
+	int childFDs[3] = { fds[1], fds[1], STDERR_FILENO };
+
+	pid_t pid = Process::Spawn(workerCommand, nullptr, true, childFDs);
+	int error = errno;
+
+	closesocket(fds[1]);
+
+	if (pid == -1) {
+		closesocket(fds[0]);
+
+		BOOST_THROW_EXCEPTION(posix_error()
+			<< boost::errinfo_api_function("spawn")
+			<< boost::errinfo_errno(error));
+	}
+
+	Log(LogNotice, "PluginWorkerPool")
+		<< "Started worker " << pid << " for check command '" << m_Name << "': "
+		<< Process::PrettyPrintArguments(workerCommand);
+
+	worker->PID = pid;
+	worker->WorkerSocket = new Socket(fds[0]);
+	worker->Stream = new NetworkStream(worker->WorkerSocket);
+	worker->Context.reset(new StreamReadContext());
+
+	m_WorkerStarts++;
+}
+
+void PluginWorkerPool::StopWorker(Worker *worker)
+{
+	if (worker->PID == -1)
+		return;
+
+	worker->Stream->Close();
+
+	/* Plugins started by the worker are in its process group. */
+	(void) Process::Kill(-worker->PID, SIGKILL);
+
+	int status;
+	(void) Process::WaitPID(worker->PID, &status);
+
+	worker->PID = -1;
+	worker->Stream.reset();
+	worker->WorkerSocket.reset();
+	worker->Context.reset();
+}
+#endif /* _WIN32 */
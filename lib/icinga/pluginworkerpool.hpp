@@ -0,0 +1,100 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PLUGINWORKERPOOL_H
+#define PLUGINWORKERPOOL_H
+
+#include "icinga/i2-icinga.hpp"
+#include "icinga/checkcommand.hpp"
+#include "base/process.hpp"
+#include "base/networkstream.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
+#include <memory>
+
+namespace icinga
+{
+
+#ifndef _WIN32
+/**
+ * A pool of long-lived worker processes which execute check plugins for a
+ * check command, avoiding the interpreter start-up for every check.
+ *
+ * Requests and responses are exchanged as JSON-encoded netstrings over the
+ * worker's stdin/stdout:
+ *
+ *   Request:  { "arguments": [ ... ], "env": { ... }, "timeout": 60 }
+ *   Response: { "output": "...", "exit_status": 0 }
+ *
+ * Workers must handle one request at a time and exit when stdin is closed.
+ *
+ * @ingroup icinga
+ */
+class PluginWorkerPool final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(PluginWorkerPool);
+
+	static PluginWorkerPool::Ptr GetPool(const CheckCommand::Ptr& command);
+
+	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
+
+	void Execute(const Process::Arguments& arguments, const Dictionary::Ptr& env, double timeout,
+		const std::function<void (const ProcessResult&)>& callback);
+
+private:
+	struct Worker
+	{
+		pid_t PID{-1};
+		int Generation{0};
+		Socket::Ptr WorkerSocket;
+		NetworkStream::Ptr Stream;
+		std::unique_ptr<StreamReadContext> Context;
+	};
+
+	String m_Name;
+	int m_Size;
+	WorkQueue m_WorkQueue;
+
+	boost::mutex m_Mutex;
+	Process::Arguments m_WorkerCommand;
+	int m_Generation{0};
+	std::vector<std::unique_ptr<Worker> > m_Workers;
+	std::vector<Worker *> m_IdleWorkers;
+
+	std::atomic<int> m_BusyWorkers{0};
+	std::atomic<unsigned long> m_Requests{0};
+	std::atomic<unsigned long> m_Timeouts{0};
+	std::atomic<unsigned long> m_WorkerStarts{0};
+
+	PluginWorkerPool(const String& name, const Process::Arguments& workerCommand, int size);
+
+	void SetWorkerCommand(const Process::Arguments& workerCommand);
+
+	void ExecuteRequest(const Process::Arguments& arguments, const Dictionary::Ptr& env, double timeout,
+		const std::function<void (const ProcessResult&)>& callback);
+	bool ReadResponse(Worker *worker, double timeout, String *message);
+	void StartWorker(Worker *worker);
+	void StopWorker(Worker *worker);
+};
+#endif /* _WIN32 */
+
+}
+
+#endif /* PLUGINWORKERPOOL_H */
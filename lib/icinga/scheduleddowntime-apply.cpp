@@ -151,12 +151,16 @@ void ScheduledDowntime::EvaluateApplyRules(const Host::Ptr& host)
 {
 	CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-	for (ApplyRule& rule : ApplyRule::GetRules("ScheduledDowntime")) {
-		if (rule.GetTargetType() != "Host")
+	Dictionary::Ptr vars = new Dictionary({ { "host", host } });
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("ScheduledDowntime", vars)) {
+		if (rule->GetTargetType() != "Host")
 			continue;
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+		ApplyRuleEvaluation evaluation(*rule);
+
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
 
@@ -164,11 +168,18 @@ void ScheduledDowntime::EvaluateApplyRules(const Service::Ptr& service)
 {
 	CONTEXT("Evaluating 'apply' rules for service '" + service->GetName() + "'");
 
-	for (ApplyRule& rule : ApplyRule::GetRules("ScheduledDowntime")) {
-		if (rule.GetTargetType() != "Service")
+	Dictionary::Ptr vars = new Dictionary({
+		{ "host", service->GetHost() },
+		{ "service", service }
+	});
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("ScheduledDowntime", vars)) {
+		if (rule->GetTargetType() != "Service")
 			continue;
 
-		if (EvaluateApplyRule(service, rule))
-			rule.AddMatch();
+		ApplyRuleEvaluation evaluation(*rule);
+
+		if (EvaluateApplyRule(service, *rule))
+			rule->AddMatch();
 	}
 }
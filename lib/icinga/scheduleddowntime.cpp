@@ -30,6 +30,7 @@
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include <boost/thread/once.hpp>
+#include <queue>
 
 using namespace icinga;
 
@@ -37,6 +38,15 @@ REGISTER_TYPE(ScheduledDowntime);
 
 static Timer::Ptr l_Timer;
 
+/* Scheduled downtimes ordered by the time at which their next downtime has to
+ * be created. Entries may be outdated, creating the next downtime is a no-op
+ * if it already exists. */
+typedef std::pair<double, String> ScheduledDowntimeQueueItem;
+typedef std::priority_queue<ScheduledDowntimeQueueItem, std::vector<ScheduledDowntimeQueueItem>, std::greater<ScheduledDowntimeQueueItem> > ScheduledDowntimeQueue;
+
+static boost::mutex l_ScheduledDowntimeQueueMutex;
+static ScheduledDowntimeQueue l_ScheduledDowntimeQueue;
+
 String ScheduledDowntimeNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
 	ScheduledDowntime::Ptr downtime = dynamic_pointer_cast<ScheduledDowntime>(context);
@@ -91,19 +101,63 @@ void ScheduledDowntime::Start(bool runtimeCreated)
 	boost::call_once(once, [this]() {
 		l_Timer = new Timer();
 		l_Timer->SetInterval(60);
+		l_Timer->SetSlack(1);
 		l_Timer->OnTimerExpired.connect(std::bind(&ScheduledDowntime::TimerProc));
 		l_Timer->Start();
+
+		/* Replace downtimes which were removed before they started. */
+		Downtime::OnDowntimeRemoved.connect([](const Downtime::Ptr& downtime) {
+			String scheduledBy = downtime->GetScheduledBy();
+
+			if (scheduledBy.IsEmpty())
+				return;
+
+			ScheduledDowntime::Ptr sd = ScheduledDowntime::GetByName(scheduledBy);
+
+			if (sd && sd->IsActive())
+				Utility::QueueAsyncCallback(std::bind(&ScheduledDowntime::UpdateNextDowntime, sd));
+		});
+
+		ScheduledDowntime::OnRangesChanged.connect([](const ScheduledDowntime::Ptr& sd, const Value&) {
+			if (sd->IsActive())
+				Utility::QueueAsyncCallback(std::bind(&ScheduledDowntime::UpdateNextDowntime, sd));
+		});
 	});
 
-	Utility::QueueAsyncCallback(std::bind(&ScheduledDowntime::CreateNextDowntime, this));
+	Utility::QueueAsyncCallback(std::bind(&ScheduledDowntime::UpdateNextDowntime, this));
 }
 
 void ScheduledDowntime::TimerProc()
 {
-	for (const ScheduledDowntime::Ptr& sd : ConfigType::GetObjectsByType<ScheduledDowntime>()) {
-		if (sd->IsActive())
-			sd->CreateNextDowntime();
+	double now = Utility::GetTime();
+	std::vector<ScheduledDowntime::Ptr> downtimes;
+
+	{
+		boost::mutex::scoped_lock lock(l_ScheduledDowntimeQueueMutex);
+
+		while (!l_ScheduledDowntimeQueue.empty() && l_ScheduledDowntimeQueue.top().first <= now) {
+			ScheduledDowntime::Ptr sd = ScheduledDowntime::GetByName(l_ScheduledDowntimeQueue.top().second);
+			l_ScheduledDowntimeQueue.pop();
+
+			if (sd && sd->IsActive())
+				downtimes.push_back(sd);
+		}
 	}
+
+	for (const ScheduledDowntime::Ptr& sd : downtimes)
+		sd->UpdateNextDowntime();
+}
+
+/**
+ * Creates the next downtime if necessary and queues the scheduled downtime
+ * for the time at which the following downtime has to be created.
+ */
+void ScheduledDowntime::UpdateNextDowntime()
+{
+	double next = CreateNextDowntime();
+
+	boost::mutex::scoped_lock lock(l_ScheduledDowntimeQueueMutex);
+	l_ScheduledDowntimeQueue.emplace(next, GetName());
 }
 
 Checkable::Ptr ScheduledDowntime::GetCheckable() const
@@ -165,15 +219,22 @@ std::pair<double, double> ScheduledDowntime::FindNextSegment()
 		return std::make_pair(0, 0);
 }
 
-void ScheduledDowntime::CreateNextDowntime()
+/**
+ * Creates the next downtime unless a downtime which hasn't started yet exists.
+ *
+ * @returns The time at which the following downtime has to be created.
+ */
+double ScheduledDowntime::CreateNextDowntime()
 {
+	double now = Utility::GetTime();
+
 	for (const Downtime::Ptr& downtime : GetCheckable()->GetDowntimes()) {
 		if (downtime->GetScheduledBy() != GetName() ||
-			downtime->GetStartTime() < Utility::GetTime())
+			downtime->GetStartTime() < now)
 			continue;
 
 		/* We've found a downtime that is owned by us and that hasn't started yet - we're done. */
-		return;
+		return downtime->GetStartTime();
 	}
 
 	Log(LogDebug, "ScheduledDowntime")
@@ -181,19 +242,15 @@ void ScheduledDowntime::CreateNextDowntime()
 
 	std::pair<double, double> segment = FindNextSegment();
 
-	if (segment.first == 0 && segment.second == 0) {
-		tm reference = Utility::LocalTime(Utility::GetTime());
-		reference.tm_mday++;
-		reference.tm_hour = 0;
-		reference.tm_min = 0;
-		reference.tm_sec = 0;
-
-		return;
-	}
+	/* There's no segment in the near future, try again later. */
+	if (segment.first == 0 && segment.second == 0)
+		return now + 3600;
 
 	Downtime::AddDowntime(GetCheckable(), GetAuthor(), GetComment(),
 		segment.first, segment.second,
 		GetFixed(), String(), GetDuration(), GetName(), GetName());
+
+	return segment.first;
 }
 
 void ScheduledDowntime::ValidateRanges(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils)
@@ -58,7 +58,8 @@ private:
 	static void TimerProc();
 
 	std::pair<double, double> FindNextSegment();
-	void CreateNextDowntime();
+	double CreateNextDowntime();
+	void UpdateNextDowntime();
 
 	static bool EvaluateApplyRuleInstance(const Checkable::Ptr& checkable, const String& name, ScriptFrame& frame, const ApplyRule& rule);
 	static bool EvaluateApplyRule(const Checkable::Ptr& checkable, const ApplyRule& rule);
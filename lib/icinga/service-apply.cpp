@@ -138,10 +138,14 @@ bool Service::EvaluateApplyRule(const Host::Ptr& host, const ApplyRule& rule)
 
 void Service::EvaluateApplyRules(const Host::Ptr& host)
 {
-	for (ApplyRule& rule : ApplyRule::GetRules("Service")) {
+	Dictionary::Ptr vars = new Dictionary({ { "host", host } });
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("Service", vars)) {
 		CONTEXT("Evaluating 'apply' rules for host '" + host->GetName() + "'");
 
-		if (EvaluateApplyRule(host, rule))
-			rule.AddMatch();
+		ApplyRuleEvaluation evaluation(*rule);
+
+		if (EvaluateApplyRule(host, *rule))
+			rule->AddMatch();
 	}
 }
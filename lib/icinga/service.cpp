@@ -20,16 +20,78 @@
 #include "icinga/service.hpp"
 #include "icinga/service-ti.cpp"
 #include "icinga/servicegroup.hpp"
+#include "icinga/hostgroup.hpp"
 #include "icinga/scheduleddowntime.hpp"
 #include "icinga/pluginutility.hpp"
 #include "base/objectlock.hpp"
 #include "base/convert.hpp"
 #include "base/utility.hpp"
+#include "base/configtype.hpp"
+#include "base/initialize.hpp"
 
 using namespace icinga;
 
 REGISTER_TYPE(Service);
 
+static bool LookupServicesByHost(const Value& value, std::vector<ConfigObject::Ptr>& objects)
+{
+	if (!value.IsString())
+		return false;
+
+	Host::Ptr host = Host::GetByName(value);
+
+	if (host) {
+		for (const Service::Ptr& service : host->GetServiceView()) {
+			objects.push_back(service);
+		}
+	}
+
+	return true;
+}
+
+/* Indexes for API filters like 'host.name == "x"', e.g. when rescheduling all services of a host. */
+INITIALIZE_ONCE([]() {
+	auto *ctype = dynamic_cast<ConfigType *>(Service::TypeInstance.get());
+
+	ctype->RegisterIndex(ConfigType::IndexEqual, "host_name", &LookupServicesByHost);
+	ctype->RegisterIndex(ConfigType::IndexEqual, "host.name", &LookupServicesByHost);
+	ctype->RegisterIndex(ConfigType::IndexEqual, "host.__name", &LookupServicesByHost);
+
+	ctype->RegisterIndex(ConfigType::IndexContains, "groups", [](const Value& value, std::vector<ConfigObject::Ptr>& objects) -> bool {
+		if (!value.IsString())
+			return false;
+
+		ServiceGroup::Ptr group = ServiceGroup::GetByName(value);
+
+		if (!group)
+			return false;
+
+		for (const Service::Ptr& service : group->GetMembers()) {
+			objects.push_back(service);
+		}
+
+		return true;
+	});
+
+	ctype->RegisterIndex(ConfigType::IndexContains, "host.groups", [](const Value& value, std::vector<ConfigObject::Ptr>& objects) -> bool {
+		if (!value.IsString())
+			return false;
+
+		HostGroup::Ptr group = HostGroup::GetByName(value);
+
+		if (!group)
+			return false;
+
+		for (const Host::Ptr& host : group->GetMembers()) {
+			for (const Service::Ptr& service : host->GetServiceView()) {
+				objects.push_back(service);
+			}
+		}
+
+		return true;
+	});
+});
+
 String ServiceNameComposer::MakeName(const String& shortName, const Object::Ptr& context) const
 {
 	Service::Ptr service = dynamic_pointer_cast<Service>(context);
@@ -53,6 +115,14 @@ Dictionary::Ptr ServiceNameComposer::ParseName(const String& name) const
 	});
 }
 
+void Service::Stop(bool runtimeRemoved)
+{
+	ObjectImpl<Service>::Stop(runtimeRemoved);
+
+	if (runtimeRemoved && m_Host)
+		m_Host->RemoveService(this);
+}
+
 void Service::OnAllConfigLoaded()
 {
 	ObjectImpl<Service>::OnAllConfigLoaded();
@@ -61,6 +61,8 @@ public:
 	static void EvaluateApplyRules(const Host::Ptr& host);
 
 protected:
+	void Stop(bool runtimeRemoved) override;
+
 	void OnAllConfigLoaded() override;
 	void CreateChildObjects(const Type::Ptr& childType) override;
 
@@ -31,8 +31,42 @@ using namespace icinga;
 
 REGISTER_TYPE(ServiceGroup);
 
+static void MemberStateCountsHandler(const Checkable::Ptr& checkable)
+{
+	Service::Ptr service = dynamic_pointer_cast<Service>(checkable);
+
+	if (!service)
+		return;
+
+	Array::Ptr groups = service->GetGroups();
+
+	if (!groups)
+		return;
+
+	ObjectLock olock(groups);
+
+	for (const String& name : groups) {
+		ServiceGroup::Ptr sg = ServiceGroup::GetByName(name);
+
+		if (sg)
+			sg->UpdateMemberStateCounts(service);
+	}
+}
+
 INITIALIZE_ONCE([]() {
 	ObjectRule::RegisterType("ServiceGroup");
+
+	Checkable::OnStateRawChanged.connect(std::bind(&MemberStateCountsHandler, _1));
+	Checkable::OnStateTypeChanged.connect(std::bind(&MemberStateCountsHandler, _1));
+	Checkable::OnLastCheckResultChanged.connect(std::bind(&MemberStateCountsHandler, _1));
+
+	/* The state is restored without signalling the changes. */
+	ConfigObject::OnActiveChanged.connect([](const ConfigObject::Ptr& object, const Value&) {
+		Checkable::Ptr checkable = dynamic_pointer_cast<Checkable>(object);
+
+		if (checkable && checkable->IsActive())
+			MemberStateCountsHandler(checkable);
+	});
 });
 
 bool ServiceGroup::EvaluateObjectRule(const Service::Ptr& service, const ConfigItem::Ptr& group)
@@ -88,12 +122,30 @@ void ServiceGroup::AddMember(const Service::Ptr& service)
 
 	boost::mutex::scoped_lock lock(m_ServiceGroupMutex);
 	m_Members.insert(service);
+	m_MemberStates.Add(service);
 }
 
 void ServiceGroup::RemoveMember(const Service::Ptr& service)
 {
 	boost::mutex::scoped_lock lock(m_ServiceGroupMutex);
 	m_Members.erase(service);
+	m_MemberStates.Remove(service);
+}
+
+/**
+ * Returns the number of members per state. The counts are updated when
+ * members change their state, so this doesn't need to look at the members.
+ */
+CheckableStateCounts ServiceGroup::GetMemberStateCounts() const
+{
+	boost::mutex::scoped_lock lock(m_ServiceGroupMutex);
+	return m_MemberStates.GetCounts();
+}
+
+void ServiceGroup::UpdateMemberStateCounts(const Service::Ptr& service)
+{
+	boost::mutex::scoped_lock lock(m_ServiceGroupMutex);
+	m_MemberStates.Update(service);
 }
 
 bool ServiceGroup::ResolveGroupMembership(const Service::Ptr& service, bool add, int rstack) {
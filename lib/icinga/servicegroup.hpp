@@ -46,11 +46,15 @@ public:
 
 	bool ResolveGroupMembership(const Service::Ptr& service, bool add = true, int rstack = 0);
 
+	CheckableStateCounts GetMemberStateCounts() const;
+	void UpdateMemberStateCounts(const Service::Ptr& service);
+
 	static void EvaluateObjectRules(const Service::Ptr& service);
 
 private:
 	mutable boost::mutex m_ServiceGroupMutex;
 	std::set<Service::Ptr> m_Members;
+	CheckableStateHistogram m_MemberStates;
 
 	static bool EvaluateObjectRule(const Service::Ptr& service, const intrusive_ptr<ConfigItem>& group);
 };
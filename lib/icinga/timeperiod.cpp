@@ -27,6 +27,7 @@
 #include "base/timer.hpp"
 #include "base/utility.hpp"
 #include <boost/thread/once.hpp>
+#include <algorithm>
 
 using namespace icinga;
 
@@ -43,6 +44,7 @@ void TimePeriod::Start(bool runtimeCreated)
 	boost::call_once(once, [this]() {
 		l_UpdateTimer = new Timer();
 		l_UpdateTimer->SetInterval(300);
+		l_UpdateTimer->SetSlack(1);
 		l_UpdateTimer->OnTimerExpired.connect(std::bind(&TimePeriod::UpdateTimerHandler));
 		l_UpdateTimer->Start();
 	});
@@ -59,6 +61,8 @@ void TimePeriod::AddSegment(double begin, double end)
 {
 	ASSERT(OwnsLock());
 
+	InvalidateSegmentIndex();
+
 	Log(LogDebug, "TimePeriod")
 		<< "Adding segment '" << Utility::FormatDateTime("%c", begin) << "' <-> '"
 		<< Utility::FormatDateTime("%c", end) << "' to TimePeriod '" << GetName() << "'";
@@ -120,6 +124,8 @@ void TimePeriod::RemoveSegment(double begin, double end)
 {
 	ASSERT(OwnsLock());
 
+	InvalidateSegmentIndex();
+
 	Log(LogDebug, "TimePeriod")
 		<< "Removing segment '" << Utility::FormatDateTime("%c", begin) << "' <-> '"
 		<< Utility::FormatDateTime("%c", end) << "' from TimePeriod '" << GetName() << "'";
@@ -192,6 +198,8 @@ void TimePeriod::PurgeSegments(double end)
 {
 	ASSERT(OwnsLock());
 
+	InvalidateSegmentIndex();
+
 	Log(LogDebug, "TimePeriod")
 		<< "Purging segments older than '" << Utility::FormatDateTime("%c", end)
 		<< "' from TimePeriod '" << GetName() << "'";
@@ -288,6 +296,9 @@ void TimePeriod::UpdateRegion(double begin, double end, bool clearExisting)
 				Merge(timeperiod, preferInclude);
 		}
 	}
+
+	/* Rebuild the index now rather than on the next IsInside() call. */
+	RefreshSegmentIndex();
 }
 
 bool TimePeriod::GetIsInside() const
@@ -297,22 +308,89 @@ bool TimePeriod::GetIsInside() const
 
 bool TimePeriod::IsInside(double ts) const
 {
-	ObjectLock olock(this);
+	{
+		boost::mutex::scoped_lock lock(m_SegmentIndexMutex);
 
-	if (GetValidBegin().IsEmpty() || ts < GetValidBegin() || GetValidEnd().IsEmpty() || ts > GetValidEnd())
-		return true; /* Assume that all invalid regions are "inside". */
+		if (m_SegmentIndexValid && m_SegmentIndexSource == GetSegments())
+			return IsInsideSegmentIndex(ts);
+	}
+
+	RefreshSegmentIndex();
+
+	boost::mutex::scoped_lock lock(m_SegmentIndexMutex);
+	return IsInsideSegmentIndex(ts);
+}
+
+/**
+ * Rebuilds the sorted segment index if the segments have changed since it was
+ * last built.
+ */
+void TimePeriod::RefreshSegmentIndex() const
+{
+	ObjectLock olock(this);
 
 	Array::Ptr segments = GetSegments();
 
+	boost::mutex::scoped_lock lock(m_SegmentIndexMutex);
+
+	if (m_SegmentIndexValid && m_SegmentIndexSource == segments)
+		return;
+
+	Value validBegin = GetValidBegin();
+	Value validEnd = GetValidEnd();
+
+	m_SegmentIndexHasValidRange = !validBegin.IsEmpty() && !validEnd.IsEmpty();
+	m_SegmentIndexValidBegin = m_SegmentIndexHasValidRange ? static_cast<double>(validBegin) : 0;
+	m_SegmentIndexValidEnd = m_SegmentIndexHasValidRange ? static_cast<double>(validEnd) : 0;
+
+	std::vector<std::pair<double, double> > index;
+
 	if (segments) {
 		ObjectLock dlock(segments);
-		for (const Dictionary::Ptr& segment : segments) {
-			if (ts > segment->Get("begin") && ts < segment->Get("end"))
-				return true;
-		}
+
+		index.reserve(segments->GetLength());
+
+		for (const Dictionary::Ptr& segment : segments)
+			index.emplace_back(segment->Get("begin"), segment->Get("end"));
+	}
+
+	std::sort(index.begin(), index.end());
+
+	/* Merge overlapping segments. Segments which only touch are kept apart
+	 * because their shared boundary is not inside the time period. */
+	m_SegmentIndex.clear();
+
+	for (const std::pair<double, double>& segment : index) {
+		if (!m_SegmentIndex.empty() && segment.first < m_SegmentIndex.back().second)
+			m_SegmentIndex.back().second = std::max(m_SegmentIndex.back().second, segment.second);
+		else
+			m_SegmentIndex.push_back(segment);
 	}
 
-	return false;
+	m_SegmentIndexSource = segments;
+	m_SegmentIndexValid = true;
+}
+
+void TimePeriod::InvalidateSegmentIndex()
+{
+	boost::mutex::scoped_lock lock(m_SegmentIndexMutex);
+	m_SegmentIndexValid = false;
+}
+
+bool TimePeriod::IsInsideSegmentIndex(double ts) const
+{
+	if (!m_SegmentIndexHasValidRange || ts < m_SegmentIndexValidBegin || ts > m_SegmentIndexValidEnd)
+		return true; /* Assume that all invalid regions are "inside". */
+
+	auto it = std::upper_bound(m_SegmentIndex.begin(), m_SegmentIndex.end(), ts,
+		[](double ts, const std::pair<double, double>& segment) { return ts < segment.first; });
+
+	if (it == m_SegmentIndex.begin())
+		return false;
+
+	--it;
+
+	return ts > it->first && ts < it->second;
 }
 
 double TimePeriod::FindNextTransition(double begin)
@@ -341,7 +419,7 @@ void TimePeriod::UpdateTimerHandler()
 {
 	double now = Utility::GetTime();
 
-	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectsByType<TimePeriod>()) {
+	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectViewByType<TimePeriod>()) {
 		if (!tp->IsActive())
 			continue;
 
@@ -22,6 +22,8 @@
 
 #include "icinga/i2-icinga.hpp"
 #include "icinga/timeperiod-ti.hpp"
+#include <boost/thread/mutex.hpp>
+#include <vector>
 
 namespace icinga
 {
@@ -49,6 +51,18 @@ public:
 	void ValidateRanges(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 
 private:
+	mutable boost::mutex m_SegmentIndexMutex;
+	mutable bool m_SegmentIndexValid{false};
+	mutable Array::Ptr m_SegmentIndexSource;
+	mutable std::vector<std::pair<double, double> > m_SegmentIndex;
+	mutable bool m_SegmentIndexHasValidRange{false};
+	mutable double m_SegmentIndexValidBegin{0};
+	mutable double m_SegmentIndexValidEnd{0};
+
+	void RefreshSegmentIndex() const;
+	void InvalidateSegmentIndex();
+	bool IsInsideSegmentIndex(double ts) const;
+
 	void AddSegment(double s, double end);
 	void AddSegment(const Dictionary::Ptr& segment);
 	void RemoveSegment(double begin, double end);
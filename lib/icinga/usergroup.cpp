@@ -19,6 +19,7 @@
 
 #include "icinga/usergroup.hpp"
 #include "icinga/usergroup-ti.cpp"
+#include "icinga/notification.hpp"
 #include "config/objectrule.hpp"
 #include "config/configitem.hpp"
 #include "base/configtype.hpp"
@@ -83,14 +84,22 @@ void UserGroup::AddMember(const User::Ptr& user)
 {
 	user->AddGroup(GetName());
 
-	boost::mutex::scoped_lock lock(m_UserGroupMutex);
-	m_Members.insert(user);
+	{
+		boost::mutex::scoped_lock lock(m_UserGroupMutex);
+		m_Members.insert(user);
+	}
+
+	Notification::InvalidateRecipients();
 }
 
 void UserGroup::RemoveMember(const User::Ptr& user)
 {
-	boost::mutex::scoped_lock lock(m_UserGroupMutex);
-	m_Members.erase(user);
+	{
+		boost::mutex::scoped_lock lock(m_UserGroupMutex);
+		m_Members.erase(user);
+	}
+
+	Notification::InvalidateRecipients();
 }
 
 bool UserGroup::ResolveGroupMembership(const User::Ptr& user, bool add, int rstack) {
@@ -45,6 +45,7 @@ public:
 
 	virtual void Apply(const Table::Ptr& table, const Value& row, AggregatorState **state) = 0;
 	virtual double GetResultAndFreeState(AggregatorState *state) const = 0;
+	virtual void MergeAndFreeState(AggregatorState **state, AggregatorState *other) const = 0;
 	void SetFilter(const Filter::Ptr& filter);
 
 protected:
@@ -30,3 +30,14 @@ bool AndFilter::Apply(const Table::Ptr& table, const Value& row)
 
 	return true;
 }
+
+bool AndFilter::GetRequiredOperand(const String& column, const String& op, String *operand) const
+{
+	/* Every sub filter has to match, so any of their conditions is required. */
+	for (const Filter::Ptr& filter : m_Filters) {
+		if (filter->GetRequiredOperand(column, op, operand))
+			return true;
+	}
+
+	return false;
+}
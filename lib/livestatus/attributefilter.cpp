@@ -31,11 +31,18 @@ AttributeFilter::AttributeFilter(String column, String op, String operand)
 	: m_Column(std::move(column)), m_Operator(std::move(op)), m_Operand(std::move(operand))
 { }
 
-bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
+bool AttributeFilter::GetRequiredOperand(const String& column, const String& op, String *operand) const
 {
-	Column column = table->GetColumn(m_Column);
+	if (m_Column != column || m_Operator != op)
+		return false;
+
+	*operand = m_Operand;
+	return true;
+}
 
-	Value value = column.ExtractValue(row);
+bool AttributeFilter::Apply(const Table::Ptr& table, const Value& row)
+{
+	Value value = table->GetColumnValue(m_Column, row);
 
 	if (value.IsObjectType<Array>()) {
 		Array::Ptr array = value;
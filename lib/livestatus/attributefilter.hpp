@@ -38,6 +38,7 @@ public:
 	AttributeFilter(String column, String op, String operand);
 
 	bool Apply(const Table::Ptr& table, const Value& row) override;
+	bool GetRequiredOperand(const String& column, const String& op, String *operand) const override;
 
 protected:
 	String m_Column;
@@ -35,9 +35,7 @@ AvgAggregatorState *AvgAggregator::EnsureState(AggregatorState **state)
 
 void AvgAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_AvgAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_AvgAttr, row);
 
 	AvgAggregatorState *pstate = EnsureState(state);
 
@@ -53,3 +51,17 @@ double AvgAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void AvgAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	AvgAggregatorState *pstate = EnsureState(state);
+	AvgAggregatorState *pother = static_cast<AvgAggregatorState *>(other);
+
+	pstate->Avg += pother->Avg;
+	pstate->AvgCount += pother->AvgCount;
+
+	delete pother;
+}
@@ -47,6 +47,7 @@ public:
 
 	void Apply(const Table::Ptr& table, const Value& row, AggregatorState **state) override;
 	double GetResultAndFreeState(AggregatorState *state) const override;
+	void MergeAndFreeState(AggregatorState **state, AggregatorState *other) const override;
 
 private:
 	String m_AvgAttr;
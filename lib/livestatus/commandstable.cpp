@@ -59,17 +59,17 @@ String CommandsTable::GetPrefix() const
 
 void CommandsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const ConfigObject::Ptr& object : ConfigType::GetObjectsByType<CheckCommand>()) {
+	for (const ConfigObject::Ptr& object : ConfigType::GetObjectViewByType<CheckCommand>()) {
 		if (!addRowFn(object, LivestatusGroupByNone, Empty))
 			return;
 	}
 
-	for (const ConfigObject::Ptr& object : ConfigType::GetObjectsByType<EventCommand>()) {
+	for (const ConfigObject::Ptr& object : ConfigType::GetObjectViewByType<EventCommand>()) {
 		if (!addRowFn(object, LivestatusGroupByNone, Empty))
 			return;
 	}
 
-	for (const ConfigObject::Ptr& object : ConfigType::GetObjectsByType<NotificationCommand>()) {
+	for (const ConfigObject::Ptr& object : ConfigType::GetObjectViewByType<NotificationCommand>()) {
 		if (!addRowFn(object, LivestatusGroupByNone, Empty))
 			return;
 	}
@@ -64,7 +64,7 @@ String CommentsTable::GetPrefix() const
 
 void CommentsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const Comment::Ptr& comment : ConfigType::GetObjectsByType<Comment>()) {
+	for (const Comment::Ptr& comment : ConfigType::GetObjectViewByType<Comment>()) {
 		if (!addRowFn(comment, LivestatusGroupByNone, Empty))
 			return;
 	}
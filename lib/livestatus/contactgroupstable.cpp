@@ -48,7 +48,7 @@ String ContactGroupsTable::GetPrefix() const
 
 void ContactGroupsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const UserGroup::Ptr& ug : ConfigType::GetObjectsByType<UserGroup>()) {
+	for (const UserGroup::Ptr& ug : ConfigType::GetObjectViewByType<UserGroup>()) {
 		if (!addRowFn(ug, LivestatusGroupByNone, Empty))
 			return;
 	}
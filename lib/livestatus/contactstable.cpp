@@ -69,7 +69,7 @@ String ContactsTable::GetPrefix() const
 
 void ContactsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const User::Ptr& user : ConfigType::GetObjectsByType<User>()) {
+	for (const User::Ptr& user : ConfigType::GetObjectViewByType<User>()) {
 		if (!addRowFn(user, LivestatusGroupByNone, Empty))
 			return;
 	}
@@ -45,3 +45,16 @@ double CountAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void CountAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	CountAggregatorState *pstate = EnsureState(state);
+	CountAggregatorState *pother = static_cast<CountAggregatorState *>(other);
+
+	pstate->Count += pother->Count;
+
+	delete pother;
+}
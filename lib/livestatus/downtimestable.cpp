@@ -64,7 +64,7 @@ String DowntimesTable::GetPrefix() const
 
 void DowntimesTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const Downtime::Ptr& downtime : ConfigType::GetObjectsByType<Downtime>()) {
+	for (const Downtime::Ptr& downtime : ConfigType::GetObjectViewByType<Downtime>()) {
 		if (!addRowFn(downtime, LivestatusGroupByNone, Empty))
 			return;
 	}
@@ -59,7 +59,7 @@ String EndpointsTable::GetPrefix() const
 
 void EndpointsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectViewByType<Endpoint>()) {
 		if (!addRowFn(endpoint, LivestatusGroupByNone, Empty))
 			return;
 	}
@@ -36,6 +36,20 @@ public:
 
 	virtual bool Apply(const Table::Ptr& table, const Value& row) = 0;
 
+	/**
+	 * Checks whether rows only match if the column and operand match with the
+	 * operator. Tables use this to look up candidate rows in an index.
+	 *
+	 * @param column The column name.
+	 * @param op The operator.
+	 * @param operand The operand, set when the filter has such a condition.
+	 * @returns true if the filter has such a condition, false otherwise.
+	 */
+	virtual bool GetRequiredOperand(const String&, const String&, String *) const
+	{
+		return false;
+	}
+
 protected:
 	Filter() = default;
 };
@@ -72,7 +72,7 @@ String HostGroupsTable::GetPrefix() const
 
 void HostGroupsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const HostGroup::Ptr& hg : ConfigType::GetObjectsByType<HostGroup>()) {
+	for (const HostGroup::Ptr& hg : ConfigType::GetObjectViewByType<HostGroup>()) {
 		if (!addRowFn(hg, LivestatusGroupByNone, Empty))
 			return;
 	}
@@ -170,14 +170,12 @@ Value HostGroupsTable::WorstHostStateAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int worst_host = HostUp;
+	CheckableStateCounts counts = hg->GetMemberStateCounts();
 
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		if (host->GetState() > worst_host)
-			worst_host = host->GetState();
-	}
+	if (counts.States[ServiceCritical] > 0 || counts.States[ServiceUnknown] > 0)
+		return HostDown;
 
-	return worst_host;
+	return HostUp;
 }
 
 Value HostGroupsTable::NumHostsAccessor(const Value& row)
@@ -187,7 +185,7 @@ Value HostGroupsTable::NumHostsAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	return hg->GetMembers().size();
+	return hg->GetMemberStateCounts().Total;
 }
 
 Value HostGroupsTable::NumHostsPendingAccessor(const Value& row)
@@ -197,15 +195,7 @@ Value HostGroupsTable::NumHostsPendingAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_hosts = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		/* no checkresult */
-		if (!host->GetLastCheckResult())
-			num_hosts++;
-	}
-
-	return num_hosts;
+	return hg->GetMemberStateCounts().Pending;
 }
 
 Value HostGroupsTable::NumHostsUpAccessor(const Value& row)
@@ -215,14 +205,9 @@ Value HostGroupsTable::NumHostsUpAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_hosts = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		if (host->GetState() == HostUp)
-			num_hosts++;
-	}
+	CheckableStateCounts counts = hg->GetMemberStateCounts();
 
-	return num_hosts;
+	return counts.States[ServiceOK] + counts.States[ServiceWarning];
 }
 
 Value HostGroupsTable::NumHostsDownAccessor(const Value& row)
@@ -232,14 +217,9 @@ Value HostGroupsTable::NumHostsDownAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_hosts = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		if (host->GetState() == HostDown)
-			num_hosts++;
-	}
+	CheckableStateCounts counts = hg->GetMemberStateCounts();
 
-	return num_hosts;
+	return counts.States[ServiceCritical] + counts.States[ServiceUnknown];
 }
 
 Value HostGroupsTable::NumHostsUnreachAccessor(const Value& row)
@@ -266,16 +246,7 @@ Value HostGroupsTable::NumServicesAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	if (hg->GetMembers().size() == 0)
-		return 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		num_services += host->GetServices().size();
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().Total;
 }
 
 Value HostGroupsTable::WorstServiceStateAccessor(const Value& row)
@@ -285,16 +256,14 @@ Value HostGroupsTable::WorstServiceStateAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	Value worst_service = ServiceOK;
+	CheckableStateCounts counts = hg->GetServiceStateCounts();
 
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetState() > worst_service)
-				worst_service = service->GetState();
-		}
+	for (int state = ServiceUnknown; state > ServiceOK; state--) {
+		if (counts.States[state] > 0)
+			return state;
 	}
 
-	return worst_service;
+	return ServiceOK;
 }
 
 Value HostGroupsTable::NumServicesPendingAccessor(const Value& row)
@@ -304,16 +273,7 @@ Value HostGroupsTable::NumServicesPendingAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (!service->GetLastCheckResult())
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().Pending;
 }
 
 Value HostGroupsTable::NumServicesOkAccessor(const Value& row)
@@ -323,16 +283,7 @@ Value HostGroupsTable::NumServicesOkAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetState() == ServiceOK)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().States[ServiceOK];
 }
 
 Value HostGroupsTable::NumServicesWarnAccessor(const Value& row)
@@ -342,16 +293,7 @@ Value HostGroupsTable::NumServicesWarnAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetState() == ServiceWarning)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().States[ServiceWarning];
 }
 
 Value HostGroupsTable::NumServicesCritAccessor(const Value& row)
@@ -361,16 +303,7 @@ Value HostGroupsTable::NumServicesCritAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetState() == ServiceCritical)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().States[ServiceCritical];
 }
 
 Value HostGroupsTable::NumServicesUnknownAccessor(const Value& row)
@@ -380,16 +313,7 @@ Value HostGroupsTable::NumServicesUnknownAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetState() == ServiceUnknown)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().States[ServiceUnknown];
 }
 
 Value HostGroupsTable::WorstServiceHardStateAccessor(const Value& row)
@@ -399,18 +323,14 @@ Value HostGroupsTable::WorstServiceHardStateAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	Value worst_service = ServiceOK;
+	CheckableStateCounts counts = hg->GetServiceStateCounts();
 
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetStateType() == StateTypeHard) {
-				if (service->GetState() > worst_service)
-					worst_service = service->GetState();
-			}
-		}
+	for (int state = ServiceUnknown; state > ServiceOK; state--) {
+		if (counts.HardStates[state] > 0)
+			return state;
 	}
 
-	return worst_service;
+	return ServiceOK;
 }
 
 Value HostGroupsTable::NumServicesHardOkAccessor(const Value& row)
@@ -420,16 +340,7 @@ Value HostGroupsTable::NumServicesHardOkAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceOK)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().HardStates[ServiceOK];
 }
 
 Value HostGroupsTable::NumServicesHardWarnAccessor(const Value& row)
@@ -439,16 +350,7 @@ Value HostGroupsTable::NumServicesHardWarnAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceWarning)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().HardStates[ServiceWarning];
 }
 
 Value HostGroupsTable::NumServicesHardCritAccessor(const Value& row)
@@ -458,16 +360,7 @@ Value HostGroupsTable::NumServicesHardCritAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceCritical)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().HardStates[ServiceCritical];
 }
 
 Value HostGroupsTable::NumServicesHardUnknownAccessor(const Value& row)
@@ -477,14 +370,5 @@ Value HostGroupsTable::NumServicesHardUnknownAccessor(const Value& row)
 	if (!hg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Host::Ptr& host : hg->GetMembers()) {
-		for (const Service::Ptr& service : host->GetServices()) {
-			if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceUnknown)
-				num_services++;
-		}
-	}
-
-	return num_services;
+	return hg->GetServiceStateCounts().HardStates[ServiceUnknown];
 }
@@ -188,7 +188,7 @@ String HostsTable::GetPrefix() const
 void HostsTable::FetchRows(const AddRowFunction& addRowFn)
 {
 	if (GetGroupByType() == LivestatusGroupByHostGroup) {
-		for (const HostGroup::Ptr& hg : ConfigType::GetObjectsByType<HostGroup>()) {
+		for (const HostGroup::Ptr& hg : ConfigType::GetObjectViewByType<HostGroup>()) {
 			for (const Host::Ptr& host : hg->GetMembers()) {
 				/* the caller must know which groupby type and value are set for this row */
 				if (!addRowFn(host, LivestatusGroupByHostGroup, hg))
@@ -196,13 +196,39 @@ void HostsTable::FetchRows(const AddRowFunction& addRowFn)
 			}
 		}
 	} else {
-		for (const Host::Ptr& host : ConfigType::GetObjectsByType<Host>()) {
+		for (const Host::Ptr& host : ConfigType::GetObjectViewByType<Host>()) {
 			if (!addRowFn(host, LivestatusGroupByNone, Empty))
 				return;
 		}
 	}
 }
 
+void HostsTable::FetchCandidateRows(const AddRowFunction& addRowFn, const Filter::Ptr& filter)
+{
+	String operand;
+
+	if (GetGroupByType() != LivestatusGroupByNone || !filter) {
+		FetchRows(addRowFn);
+	} else if (filter->GetRequiredOperand("name", "=", &operand) || filter->GetRequiredOperand("host_name", "=", &operand)) {
+		Host::Ptr host = Host::GetByName(operand);
+
+		if (host)
+			addRowFn(host, LivestatusGroupByNone, Empty);
+	} else if (filter->GetRequiredOperand("groups", ">=", &operand)) {
+		HostGroup::Ptr hg = HostGroup::GetByName(operand);
+
+		if (!hg)
+			return;
+
+		for (const Host::Ptr& host : hg->GetMembers()) {
+			if (!addRowFn(host, LivestatusGroupByNone, Empty))
+				return;
+		}
+	} else {
+		FetchRows(addRowFn);
+	}
+}
+
 Object::Ptr HostsTable::HostGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
 	/* return the current group by value set from within FetchRows()
@@ -517,8 +543,7 @@ Value HostsTable::AcknowledgementTypeAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	ObjectLock olock(host);
-	return host->GetAcknowledgement();
+	return host->GetStateSnapshot()->GetAcknowledgement();
 }
 
 Value HostsTable::CheckTypeAccessor(const Value& row)
@@ -668,8 +693,7 @@ Value HostsTable::AcknowledgedAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	ObjectLock olock(host);
-	return host->IsAcknowledged();
+	return host->GetStateSnapshot()->IsAcknowledged();
 }
 
 Value HostsTable::StateAccessor(const Value& row)
@@ -1189,14 +1213,14 @@ Value HostsTable::WorstServiceStateAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	Value worst_service = ServiceOK;
+	CheckableStateCounts counts = host->GetServiceStateCounts();
 
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetState() > worst_service)
-			worst_service = service->GetState();
+	for (int state = ServiceUnknown; state > ServiceOK; state--) {
+		if (counts.States[state] > 0)
+			return state;
 	}
 
-	return worst_service;
+	return ServiceOK;
 }
 
 Value HostsTable::NumServicesOkAccessor(const Value& row)
@@ -1206,14 +1230,7 @@ Value HostsTable::NumServicesOkAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetState() == ServiceOK)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().States[ServiceOK];
 }
 
 Value HostsTable::NumServicesWarnAccessor(const Value& row)
@@ -1223,14 +1240,7 @@ Value HostsTable::NumServicesWarnAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetState() == ServiceWarning)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().States[ServiceWarning];
 }
 
 Value HostsTable::NumServicesCritAccessor(const Value& row)
@@ -1240,14 +1250,7 @@ Value HostsTable::NumServicesCritAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetState() == ServiceCritical)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().States[ServiceCritical];
 }
 
 Value HostsTable::NumServicesUnknownAccessor(const Value& row)
@@ -1257,14 +1260,7 @@ Value HostsTable::NumServicesUnknownAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetState() == ServiceUnknown)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().States[ServiceUnknown];
 }
 
 Value HostsTable::NumServicesPendingAccessor(const Value& row)
@@ -1274,14 +1270,7 @@ Value HostsTable::NumServicesPendingAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (!service->GetLastCheckResult())
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().Pending;
 }
 
 Value HostsTable::WorstServiceHardStateAccessor(const Value& row)
@@ -1291,16 +1280,14 @@ Value HostsTable::WorstServiceHardStateAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	Value worst_service = ServiceOK;
+	CheckableStateCounts counts = host->GetServiceStateCounts();
 
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetStateType() == StateTypeHard) {
-			if (service->GetState() > worst_service)
-				worst_service = service->GetState();
-		}
+	for (int state = ServiceUnknown; state > ServiceOK; state--) {
+		if (counts.HardStates[state] > 0)
+			return state;
 	}
 
-	return worst_service;
+	return ServiceOK;
 }
 
 Value HostsTable::NumServicesHardOkAccessor(const Value& row)
@@ -1310,14 +1297,7 @@ Value HostsTable::NumServicesHardOkAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceOK)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().HardStates[ServiceOK];
 }
 
 Value HostsTable::NumServicesHardWarnAccessor(const Value& row)
@@ -1327,14 +1307,7 @@ Value HostsTable::NumServicesHardWarnAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceWarning)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().HardStates[ServiceWarning];
 }
 
 Value HostsTable::NumServicesHardCritAccessor(const Value& row)
@@ -1344,14 +1317,7 @@ Value HostsTable::NumServicesHardCritAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceCritical)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().HardStates[ServiceCritical];
 }
 
 Value HostsTable::NumServicesHardUnknownAccessor(const Value& row)
@@ -1361,14 +1327,7 @@ Value HostsTable::NumServicesHardUnknownAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : host->GetServices()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceUnknown)
-			num_services++;
-	}
-
-	return num_services;
+	return host->GetServiceStateCounts().HardStates[ServiceUnknown];
 }
 
 Value HostsTable::HardStateAccessor(const Value& row)
@@ -1437,10 +1396,10 @@ Value HostsTable::ServicesAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	std::vector<Service::Ptr> rservices = host->GetServices();
+	ConfigObjectView<Service> rservices = host->GetServiceView();
 
 	ArrayData result;
-	result.reserve(rservices.size());
+	result.reserve(rservices.GetLength());
 
 	for (const Service::Ptr& service : rservices) {
 		result.push_back(service->GetShortName());
@@ -1456,10 +1415,10 @@ Value HostsTable::ServicesWithStateAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	std::vector<Service::Ptr> rservices = host->GetServices();
+	ConfigObjectView<Service> rservices = host->GetServiceView();
 
 	ArrayData result;
-	result.reserve(rservices.size());
+	result.reserve(rservices.GetLength());
 
 	for (const Service::Ptr& service : rservices) {
 		result.push_back(new Array({
@@ -1479,10 +1438,10 @@ Value HostsTable::ServicesWithInfoAccessor(const Value& row)
 	if (!host)
 		return Empty;
 
-	std::vector<Service::Ptr> rservices = host->GetServices();
+	ConfigObjectView<Service> rservices = host->GetServiceView();
 
 	ArrayData result;
-	result.reserve(rservices.size());
+	result.reserve(rservices.GetLength());
 
 	for (const Service::Ptr& service : rservices) {
 		String output;
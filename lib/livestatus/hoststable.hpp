@@ -45,6 +45,7 @@ public:
 
 protected:
 	void FetchRows(const AddRowFunction& addRowFn) override;
+	void FetchCandidateRows(const AddRowFunction& addRowFn, const intrusive_ptr<Filter>& filter) override;
 
 	static Object::Ptr HostGroupAccessor(const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
 
@@ -35,9 +35,7 @@ InvAvgAggregatorState *InvAvgAggregator::EnsureState(AggregatorState **state)
 
 void InvAvgAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_InvAvgAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_InvAvgAttr, row);
 
 	InvAvgAggregatorState *pstate = EnsureState(state);
 
@@ -53,3 +51,17 @@ double InvAvgAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void InvAvgAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	InvAvgAggregatorState *pstate = EnsureState(state);
+	InvAvgAggregatorState *pother = static_cast<InvAvgAggregatorState *>(other);
+
+	pstate->InvAvg += pother->InvAvg;
+	pstate->InvAvgCount += pother->InvAvgCount;
+
+	delete pother;
+}
@@ -35,9 +35,7 @@ InvSumAggregatorState *InvSumAggregator::EnsureState(AggregatorState **state)
 
 void InvSumAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_InvSumAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_InvSumAttr, row);
 
 	InvSumAggregatorState *pstate = EnsureState(state);
 
@@ -52,3 +50,16 @@ double InvSumAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void InvSumAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	InvSumAggregatorState *pstate = EnsureState(state);
+	InvSumAggregatorState *pother = static_cast<InvSumAggregatorState *>(other);
+
+	pstate->InvSum += pother->InvSum;
+
+	delete pother;
+}
@@ -0,0 +1,159 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "livestatus/livestatusclientconnection.hpp"
+#include "livestatus/livestatuslistener.hpp"
+#include "livestatus/livestatusquery.hpp"
+#include "base/networkstream.hpp"
+#include "base/utility.hpp"
+#include "base/logger.hpp"
+#include "base/exception.hpp"
+
+using namespace icinga;
+
+LivestatusClientConnection::LivestatusClientConnection(const LivestatusListener::Ptr& listener, const Socket::Ptr& socket)
+	: SocketEvents(socket, this), m_Listener(listener), m_Socket(socket), m_Stream(new NetworkStream(socket))
+{ }
+
+void LivestatusClientConnection::Start()
+{
+	ChangeEvents(POLLIN);
+}
+
+void LivestatusClientConnection::Disconnect()
+{
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Disconnected)
+			return;
+
+		m_Disconnected = true;
+	}
+
+	Log(LogNotice, "LivestatusListener", "Client disconnected");
+
+	SocketEvents::Unregister();
+
+	m_Stream->Close();
+
+	m_Listener->RemoveClient(this);
+}
+
+void LivestatusClientConnection::OnEvent(int)
+{
+	char buffer[4096];
+	size_t rc;
+
+	try {
+		rc = m_Socket->Read(buffer, sizeof(buffer));
+	} catch (const std::exception&) {
+		rc = 0;
+	}
+
+	if (rc == 0) {
+		Disconnect();
+		return;
+	}
+
+	std::vector<String> lines;
+
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		m_Buffer += String(buffer, buffer + rc);
+
+		if (m_Disconnected || !ParseQuery(lines))
+			return;
+
+		/* Stop watching the socket until the query has been processed. */
+		ChangeEvents(0);
+	}
+
+	Utility::QueueAsyncCallback(std::bind(&LivestatusClientConnection::ProcessQuery,
+		LivestatusClientConnection::Ptr(this), std::move(lines)), LowLatencyScheduler);
+}
+
+/**
+ * Extracts the next complete query from the receive buffer.
+ *
+ * Note: Caller must hold m_Mutex.
+ *
+ * @param lines The query's lines (empty for an empty query).
+ * @returns true if a query (terminated by an empty line) was found, false otherwise.
+ */
+bool LivestatusClientConnection::ParseQuery(std::vector<String>& lines)
+{
+	for (;;) {
+		String::SizeType index = m_Buffer.FindFirstOf('\n');
+
+		if (index == String::NPos)
+			return false;
+
+		String line = m_Buffer.SubStr(0, index);
+		m_Buffer = m_Buffer.SubStr(index + 1);
+
+		if (line.GetLength() > 0 && line[line.GetLength() - 1] == '\r')
+			line = line.SubStr(0, line.GetLength() - 1);
+
+		if (line.IsEmpty()) {
+			lines.swap(m_Lines);
+			return true;
+		}
+
+		m_Lines.emplace_back(std::move(line));
+	}
+}
+
+void LivestatusClientConnection::ProcessQuery(std::vector<String> lines)
+{
+	for (;;) {
+		if (lines.empty()) {
+			Disconnect();
+			return;
+		}
+
+		try {
+			LivestatusQuery::Ptr query = new LivestatusQuery(lines, m_Listener->GetCompatLogPath(), m_Listener->GetQueryCacheTtl());
+
+			if (!query->Execute(m_Stream)) {
+				Disconnect();
+				return;
+			}
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "LivestatusListener")
+				<< "Error while processing livestatus query: " << DiagnosticInformation(ex, false);
+			Disconnect();
+			return;
+		}
+
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		if (m_Disconnected)
+			return;
+
+		/* Handle queries which were pipelined by the client. */
+		lines.clear();
+
+		if (!ParseQuery(lines)) {
+			ChangeEvents(POLLIN);
+			return;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef LIVESTATUSCLIENTCONNECTION_H
+#define LIVESTATUSCLIENTCONNECTION_H
+
+#include "livestatus/i2-livestatus.hpp"
+#include "base/socket.hpp"
+#include "base/socketevents.hpp"
+#include "base/stream.hpp"
+#include <boost/thread/mutex.hpp>
+#include <vector>
+
+namespace icinga
+{
+
+class LivestatusListener;
+
+/**
+ * A livestatus client connection.
+ *
+ * The socket is watched by the socket event engine while the client is idle,
+ * so keep-alive connections don't occupy a thread pool thread. Once a query
+ * has been received completely it is executed as a separate task.
+ *
+ * @ingroup livestatus
+ */
+class LivestatusClientConnection final : public Object, public SocketEvents
+{
+public:
+	DECLARE_PTR_TYPEDEFS(LivestatusClientConnection);
+
+	LivestatusClientConnection(const intrusive_ptr<LivestatusListener>& listener, const Socket::Ptr& socket);
+
+	void Start();
+	void Disconnect();
+
+	void OnEvent(int revents) override;
+
+private:
+	intrusive_ptr<LivestatusListener> m_Listener;
+	Socket::Ptr m_Socket;
+	Stream::Ptr m_Stream;
+	boost::mutex m_Mutex;
+	String m_Buffer;
+	std::vector<String> m_Lines;
+	bool m_Disconnected{false};
+
+	bool ParseQuery(std::vector<String>& lines);
+	void ProcessQuery(std::vector<String> lines);
+};
+
+}
+
+#endif /* LIVESTATUSCLIENTCONNECTION_H */
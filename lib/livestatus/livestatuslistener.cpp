@@ -27,7 +27,6 @@
 #include "base/exception.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/unixsocket.hpp"
-#include "base/networkstream.hpp"
 #include "base/application.hpp"
 #include "base/function.hpp"
 #include "base/statsfunction.hpp"
@@ -47,7 +46,7 @@ void LivestatusListener::StatsFunc(const Dictionary::Ptr& status, const Array::P
 {
 	DictionaryData nodes;
 
-	for (const LivestatusListener::Ptr& livestatuslistener : ConfigType::GetObjectsByType<LivestatusListener>()) {
+	for (const LivestatusListener::Ptr& livestatuslistener : ConfigType::GetObjectViewByType<LivestatusListener>()) {
 		nodes.emplace_back(livestatuslistener->GetName(), new Dictionary({
 			{ "connections", l_Connections }
 		}));
@@ -132,6 +131,17 @@ void LivestatusListener::Stop(bool runtimeRemoved)
 
 	if (m_Thread.joinable())
 		m_Thread.join();
+
+	std::set<LivestatusClientConnection::Ptr> clients;
+
+	{
+		boost::mutex::scoped_lock lock(m_ClientsMutex);
+		clients = m_Clients;
+	}
+
+	for (const LivestatusClientConnection::Ptr& client : clients) {
+		client->Disconnect();
+	}
 }
 
 int LivestatusListener::GetClientsConnected()
@@ -159,7 +169,7 @@ void LivestatusListener::ServerThreadProc()
 			if (m_Listener->Poll(true, false, &tv)) {
 				Socket::Ptr client = m_Listener->Accept();
 				Log(LogNotice, "LivestatusListener", "Client connected");
-				Utility::QueueAsyncCallback(std::bind(&LivestatusListener::ClientHandler, this, client), LowLatencyScheduler);
+				NewClientHandler(client);
 			}
 
 			if (!IsActive())
@@ -172,7 +182,7 @@ void LivestatusListener::ServerThreadProc()
 	m_Listener->Close();
 }
 
-void LivestatusListener::ClientHandler(const Socket::Ptr& client)
+void LivestatusListener::NewClientHandler(const Socket::Ptr& client)
 {
 	{
 		boost::mutex::scoped_lock lock(l_ComponentMutex);
@@ -180,45 +190,29 @@ void LivestatusListener::ClientHandler(const Socket::Ptr& client)
 		l_Connections++;
 	}
 
-	Stream::Ptr stream = new NetworkStream(client);
-
-	StreamReadContext context;
-
-	for (;;) {
-		String line;
-
-		std::vector<String> lines;
-
-		for (;;) {
-			StreamReadStatus srs = stream->ReadLine(&line, context);
-
-			if (srs == StatusEof)
-				break;
+	LivestatusClientConnection::Ptr connection = new LivestatusClientConnection(this, client);
 
-			if (srs != StatusNewItem)
-				continue;
+	{
+		boost::mutex::scoped_lock lock(m_ClientsMutex);
+		m_Clients.insert(connection);
+	}
 
-			if (line.GetLength() > 0)
-				lines.push_back(line);
-			else
-				break;
-		}
+	connection->Start();
+}
 
-		if (lines.empty())
-			break;
+void LivestatusListener::RemoveClient(const LivestatusClientConnection::Ptr& client)
+{
+	{
+		boost::mutex::scoped_lock lock(m_ClientsMutex);
 
-		LivestatusQuery::Ptr query = new LivestatusQuery(lines, GetCompatLogPath());
-		if (!query->Execute(stream))
-			break;
+		if (m_Clients.erase(client) == 0)
+			return;
 	}
 
-	{
-		boost::mutex::scoped_lock lock(l_ComponentMutex);
-		l_ClientsConnected--;
-	}
+	boost::mutex::scoped_lock lock(l_ComponentMutex);
+	l_ClientsConnected--;
 }
 
-
 void LivestatusListener::ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils)
 {
 	ObjectImpl<LivestatusListener>::ValidateSocketType(lvalue, utils);
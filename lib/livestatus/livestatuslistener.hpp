@@ -23,7 +23,9 @@
 #include "livestatus/i2-livestatus.hpp"
 #include "livestatus/livestatuslistener-ti.hpp"
 #include "livestatus/livestatusquery.hpp"
+#include "livestatus/livestatusclientconnection.hpp"
 #include "base/socket.hpp"
+#include <set>
 #include <thread>
 
 using namespace icinga;
@@ -45,6 +47,8 @@ public:
 	static int GetClientsConnected();
 	static int GetConnections();
 
+	void RemoveClient(const LivestatusClientConnection::Ptr& client);
+
 	void ValidateSocketType(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
 
 protected:
@@ -53,10 +57,13 @@ protected:
 
 private:
 	void ServerThreadProc();
-	void ClientHandler(const Socket::Ptr& client);
+	void NewClientHandler(const Socket::Ptr& client);
 
 	Socket::Ptr m_Listener;
 	std::thread m_Thread;
+
+	boost::mutex m_ClientsMutex;
+	std::set<LivestatusClientConnection::Ptr> m_Clients;
 };
 
 }
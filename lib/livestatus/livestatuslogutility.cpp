@@ -32,9 +32,17 @@
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fstream>
+#include <cstdio>
+#include <limits>
 
 using namespace icinga;
 
+static boost::mutex l_LogFileIndexMutex;
+static std::map<String, LivestatusLogFileIndex> l_LogFileIndex;
+
+static boost::mutex l_StateHistoryMutex;
+static std::map<String, LivestatusStateHistory> l_StateHistory;
+
 void LivestatusLogUtility::CreateLogIndex(const String& path, std::map<time_t, String>& index)
 {
 	Utility::Glob(path + "/icinga.log", std::bind(&LivestatusLogUtility::CreateLogIndexFileHandler, _1, std::ref(index)), GlobFile);
@@ -71,34 +79,172 @@ void LivestatusLogUtility::CreateLogIndexFileHandler(const String& path, std::ma
 	index[ts_start] = path;
 }
 
+/**
+ * Adds the entries which the CompatLogger appended to the log file's index
+ * file since the last update. Reading stops at the first entry which doesn't
+ * continue where the line index left off, the remaining lines are read
+ * from the log file itself.
+ */
+static void ReadCompatLogIndex(const String& path, std::streamoff size, LivestatusLogFileIndex& index)
+{
+	std::ifstream fp;
+	fp.open((path + ".idx").CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		return;
+
+	fp.seekg(index.IndexSize);
+
+	std::string line;
+
+	while (std::getline(fp, line)) {
+		if (fp.eof())
+			break;
+
+		long long ts, offset, end;
+
+		if (sscanf(line.c_str(), "%lld %lld %lld", &ts, &offset, &end) != 3)
+			break;
+
+		/* Entries for lines we've already read from the log file are skipped. */
+		if (end > index.Size) {
+			if (offset != index.Size || end > size)
+				break;
+
+			if (!index.Lines.empty() && ts < index.Lines.back().first)
+				index.Sorted = false;
+
+			index.Lines.emplace_back(ts, offset);
+			index.Size = end;
+		}
+
+		index.IndexSize += line.size() + 1;
+	}
+}
+
+/**
+ * Updates the line index for a log file. Only the lines which were appended
+ * since the last update are read. Archived log files don't change, so they
+ * are only read once.
+ */
+void LivestatusLogUtility::UpdateLogFileIndex(const String& path, LivestatusLogFileIndex& index)
+{
+	std::ifstream fp;
+	fp.open(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
+
+	fp.seekg(0, std::ios::end);
+	std::streamoff size = fp.tellg();
+
+	/* The file was truncated or replaced. */
+	if (size < index.Size) {
+		index.Size = 0;
+		index.IndexSize = 0;
+		index.Sorted = true;
+		index.Lines.clear();
+	}
+
+	if (size == index.Size)
+		return;
+
+	ReadCompatLogIndex(path, size, index);
+
+	if (size == index.Size)
+		return;
+
+	fp.seekg(index.Size);
+
+	std::streamoff offset = index.Size;
+	time_t ts = index.Lines.empty() ? 0 : index.Lines.back().first;
+
+	std::string line;
+
+	while (std::getline(fp, line)) {
+		/* Incomplete lines are indexed once they've been written completely. */
+		if (fp.eof())
+			break;
+
+		if (!line.empty()) {
+			time_t last = ts;
+
+			if (line[0] == '[')
+				ts = atol(line.c_str() + 1);
+
+			/* Lines with older timestamps (e.g. after a clock change) can't be searched by time. */
+			if (ts < last)
+				index.Sorted = false;
+
+			index.Lines.emplace_back(ts, offset);
+		}
+
+		offset += line.size() + 1;
+	}
+
+	index.Size = offset;
+}
+
 void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, HistoryTable *table,
 	time_t from, time_t until, const AddRowFunction& addRowFn)
 {
 	ASSERT(table);
 
+	typedef std::pair<time_t, std::streamoff> LineIndex;
+
 	/* m_LogFileIndex map tells which log files are involved ordered by their start timestamp */
 	unsigned long line_count = 0;
-	for (const auto& kv : index) {
-		unsigned int ts = kv.first;
+	for (auto it = index.begin(); it != index.end(); it++) {
+		/* log files end where the next one starts */
+		auto next = std::next(it);
 
-		/* skip log files not in range (performance optimization) */
-		if (ts < from || ts > until)
+		if (it->first > until || (next != index.end() && next->first < from))
 			continue;
 
-		String log_file = index[ts];
-		int lineno = 0;
+		const String& log_file = it->second;
+
+		std::streamoff offset;
+		size_t count;
+		int lineno;
 
+		{
+			boost::mutex::scoped_lock lock(l_LogFileIndexMutex);
+
+			LivestatusLogFileIndex& fileIndex = l_LogFileIndex[log_file];
+			UpdateLogFileIndex(log_file, fileIndex);
+
+			auto begin = fileIndex.Lines.begin();
+			auto end = fileIndex.Lines.end();
+
+			if (fileIndex.Sorted) {
+				begin = std::lower_bound(begin, end, LineIndex(from, 0));
+				end = std::upper_bound(begin, end, LineIndex(until, std::numeric_limits<std::streamoff>::max()));
+			}
+
+			if (begin == end)
+				continue;
+
+			offset = begin->second;
+			count = end - begin;
+			lineno = begin - fileIndex.Lines.begin();
+		}
+
+		/* The lines in range are read with a single sequential pass. */
 		std::ifstream fp;
 		fp.exceptions(std::ifstream::badbit);
-		fp.open(log_file.CStr(), std::ifstream::in);
+		fp.open(log_file.CStr(), std::ifstream::in | std::ifstream::binary);
+		fp.seekg(offset);
 
-		while (fp.good()) {
+		while (count > 0 && fp.good()) {
 			std::string line;
 			std::getline(fp, line);
 
 			if (line.empty())
 				continue; /* Ignore empty lines */
 
+			count--;
+			lineno++;
+
 			Dictionary::Ptr log_entry_attrs = LivestatusLogUtility::GetAttributes(line);
 
 			/* no attributes available - invalid log line */
@@ -108,16 +254,180 @@ void LivestatusLogUtility::CreateLogCache(std::map<time_t, String> index, Histor
 				continue;
 			}
 
-			table->UpdateLogEntries(log_entry_attrs, line_count, lineno, addRowFn);
+			table->UpdateLogEntries(log_entry_attrs, line_count, lineno - 1, addRowFn);
 
 			line_count++;
-			lineno++;
 		}
 
 		fp.close();
 	}
 }
 
+static bool IsStateHistoryEvent(int logType)
+{
+	switch (logType) {
+		case LogEntryTypeHostAlert:
+		case LogEntryTypeHostInitialState:
+		case LogEntryTypeHostCurrentState:
+		case LogEntryTypeHostFlapping:
+		case LogEntryTypeHostDowntimeAlert:
+		case LogEntryTypeServiceAlert:
+		case LogEntryTypeServiceInitialState:
+		case LogEntryTypeServiceCurrentState:
+		case LogEntryTypeServiceFlapping:
+		case LogEntryTypeServiceDowntimeAlert:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * Updates the state history events for a log file. Like the line index,
+ * only the lines which were appended since the last update are read.
+ * Line numbers are counted the same way as for the line index.
+ */
+void LivestatusLogUtility::UpdateStateHistory(const String& path, LivestatusStateHistory& history)
+{
+	std::ifstream fp;
+	fp.open(path.CStr(), std::ifstream::in | std::ifstream::binary);
+
+	if (!fp)
+		BOOST_THROW_EXCEPTION(std::runtime_error("Could not open log file: " + path));
+
+	fp.seekg(0, std::ios::end);
+	std::streamoff size = fp.tellg();
+
+	/* The file was truncated or replaced. */
+	if (size < history.Size)
+		history = LivestatusStateHistory();
+
+	if (size == history.Size)
+		return;
+
+	fp.seekg(history.Size);
+
+	std::streamoff offset = history.Size;
+	std::string line;
+
+	while (std::getline(fp, line)) {
+		/* Incomplete lines are read once they've been written completely. */
+		if (fp.eof())
+			break;
+
+		offset += line.size() + 1;
+
+		if (line.empty())
+			continue;
+
+		int lineno = history.LineCount++;
+
+		if (line[0] == '[') {
+			time_t ts = atol(line.c_str() + 1);
+
+			if (ts < history.LastTime)
+				history.Sorted = false;
+
+			history.LastTime = ts;
+		}
+
+		Dictionary::Ptr attrs = GetAttributes(line);
+
+		if (!attrs || !IsStateHistoryEvent(attrs->Get("log_type")))
+			continue;
+
+		LivestatusStateEvent event;
+		event.HostName = attrs->Get("host_name");
+
+		if (event.HostName.IsEmpty())
+			continue;
+
+		event.Time = static_cast<unsigned long>(attrs->Get("time"));
+		event.LineNo = lineno;
+		event.LogType = attrs->Get("log_type");
+		event.State = attrs->Get("state");
+		event.ServiceDescription = attrs->Get("service_description");
+		event.StateType = attrs->Get("state_type");
+		event.Message = line;
+
+		history.Events.push_back(std::move(event));
+	}
+
+	history.Size = offset;
+}
+
+/**
+ * Replays the state history events of the log files for the time range. Unlike
+ * CreateLogCache() this doesn't read and parse all log lines for every query:
+ * the events are kept in memory and only the lines which were appended to a
+ * log file since the last query are read.
+ */
+void LivestatusLogUtility::CreateStateHistoryCache(const std::map<time_t, String>& index, HistoryTable *table,
+	time_t from, time_t until, const AddRowFunction& addRowFn)
+{
+	ASSERT(table);
+
+	std::vector<LivestatusStateEvent> events;
+
+	{
+		boost::mutex::scoped_lock lock(l_StateHistoryMutex);
+
+		/* Forget about log files which were removed. */
+		for (auto it = l_StateHistory.begin(); it != l_StateHistory.end(); ) {
+			bool found = false;
+
+			for (const auto& kv : index) {
+				if (kv.second == it->first) {
+					found = true;
+					break;
+				}
+			}
+
+			if (found)
+				it++;
+			else
+				it = l_StateHistory.erase(it);
+		}
+
+		for (auto it = index.begin(); it != index.end(); it++) {
+			/* log files end where the next one starts */
+			auto next = std::next(it);
+
+			if (it->first > until || (next != index.end() && next->first < from))
+				continue;
+
+			LivestatusStateHistory& history = l_StateHistory[it->second];
+			UpdateStateHistory(it->second, history);
+
+			for (const LivestatusStateEvent& event : history.Events) {
+				/* The whole file is used if its lines can't be searched by time. */
+				if (history.Sorted && (event.Time < from || event.Time > until))
+					continue;
+
+				events.push_back(event);
+			}
+		}
+	}
+
+	int line_count = 0;
+
+	for (const LivestatusStateEvent& event : events) {
+		Dictionary::Ptr attrs = new Dictionary({
+			{ "time", static_cast<unsigned long>(event.Time) },
+			{ "log_type", event.LogType },
+			{ "state", event.State },
+			{ "state_type", event.StateType },
+			{ "host_name", event.HostName },
+			{ "service_description", event.ServiceDescription },
+			{ "message", event.Message }
+		});
+
+		table->UpdateLogEntries(attrs, line_count, event.LineNo, addRowFn);
+
+		line_count++;
+	}
+}
+
 Dictionary::Ptr LivestatusLogUtility::GetAttributes(const String& text)
 {
 	Dictionary::Ptr bag = new Dictionary();
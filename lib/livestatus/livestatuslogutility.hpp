@@ -21,6 +21,7 @@
 #define LIVESTATUSLOGUTILITY_H
 
 #include "livestatus/historytable.hpp"
+#include <ios>
 
 using namespace icinga;
 
@@ -57,6 +58,51 @@ enum LogEntryClass {
 	LogEntryClassText = 7
 };
 
+/**
+ * The timestamps and offsets of the lines in a log file.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusLogFileIndex
+{
+	std::streamoff Size{0};
+	std::streamoff IndexSize{0};
+	bool Sorted{true};
+	std::vector<std::pair<time_t, std::streamoff> > Lines;
+};
+
+/**
+ * A log entry which affects the state history of a host or service, i.e.
+ * a state change, a flapping or a downtime alert.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusStateEvent
+{
+	time_t Time;
+	int LineNo;
+	int LogType;
+	int State;
+	String HostName;
+	String ServiceDescription;
+	String StateType;
+	String Message;
+};
+
+/**
+ * The state history events of a log file.
+ *
+ * @ingroup livestatus
+ */
+struct LivestatusStateHistory
+{
+	std::streamoff Size{0};
+	int LineCount{0};
+	time_t LastTime{0};
+	bool Sorted{true};
+	std::vector<LivestatusStateEvent> Events;
+};
+
 /**
  * @ingroup livestatus
  */
@@ -66,7 +112,10 @@ public:
 	static void CreateLogIndex(const String& path, std::map<time_t, String>& index);
 	static void CreateLogIndexFileHandler(const String& path, std::map<time_t, String>& index);
 	static void CreateLogCache(std::map<time_t, String> index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn);
+	static void CreateStateHistoryCache(const std::map<time_t, String>& index, HistoryTable *table, time_t from, time_t until, const AddRowFunction& addRowFn);
 	static Dictionary::Ptr GetAttributes(const String& text);
+	static void UpdateLogFileIndex(const String& path, LivestatusLogFileIndex& index);
+	static void UpdateStateHistory(const String& path, LivestatusStateHistory& history);
 
 private:
 	LivestatusLogUtility();
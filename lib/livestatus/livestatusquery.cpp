@@ -31,6 +31,11 @@
 #include "livestatus/orfilter.hpp"
 #include "livestatus/andfilter.hpp"
 #include "icinga/externalcommandprocessor.hpp"
+#include "icinga/checkable.hpp"
+#include "icinga/comment.hpp"
+#include "icinga/downtime.hpp"
+#include "icinga/service.hpp"
+#include "icinga/icingaapplication.hpp"
 #include "base/debug.hpp"
 #include "base/convert.hpp"
 #include "base/objectlock.hpp"
@@ -41,17 +46,146 @@
 #include "base/serializer.hpp"
 #include "base/timer.hpp"
 #include "base/initialize.hpp"
+#include "base/workqueue.hpp"
+#include "base/application.hpp"
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/join.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <atomic>
 
 using namespace icinga;
 
 static int l_ExternalCommands = 0;
 static boost::mutex l_QueryMutex;
 
-LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path)
-	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1), m_ErrorCode(0),
-	m_LogTimeFrom(0), m_LogTimeUntil(static_cast<long>(Utility::GetTime()))
+/* Minimum number of rows per thread before stats are aggregated in parallel. */
+static const size_t l_StatsRowsPerChunk = 2500;
+
+/* Results which don't need to be buffered are written in chunks of this size. */
+static const size_t l_ResultChunkSize = 64 * 1024;
+
+struct LivestatusCacheEntry
+{
+	unsigned long long Generation;
+	double Timestamp;
+	String Result;
+};
+
+/* Cached GET results. Entries are only valid for the current generation,
+ * which changes whenever a check result or object state changes. */
+static boost::mutex l_QueryCacheMutex;
+static std::map<String, LivestatusCacheEntry> l_QueryCache;
+static std::atomic<unsigned long long> l_QueryCacheGeneration{0};
+
+static void InvalidateQueryCache()
+{
+	l_QueryCacheGeneration++;
+}
+
+INITIALIZE_ONCE([]() {
+	Checkable::OnNewCheckResult.connect(std::bind(&InvalidateQueryCache));
+	Checkable::OnStateChange.connect(std::bind(&InvalidateQueryCache));
+	Checkable::OnAcknowledgementSet.connect(std::bind(&InvalidateQueryCache));
+	Checkable::OnAcknowledgementCleared.connect(std::bind(&InvalidateQueryCache));
+	Comment::OnCommentAdded.connect(std::bind(&InvalidateQueryCache));
+	Comment::OnCommentRemoved.connect(std::bind(&InvalidateQueryCache));
+	Downtime::OnDowntimeAdded.connect(std::bind(&InvalidateQueryCache));
+	Downtime::OnDowntimeRemoved.connect(std::bind(&InvalidateQueryCache));
+	Downtime::OnDowntimeStarted.connect(std::bind(&InvalidateQueryCache));
+	Downtime::OnDowntimeTriggered.connect(std::bind(&InvalidateQueryCache));
+	ConfigObject::OnStateChanged.connect(std::bind(&InvalidateQueryCache));
+});
+
+/* Wait queries block until the counter for their trigger changes. */
+static boost::mutex l_WaitMutex;
+static boost::condition_variable l_WaitCV;
+static unsigned long long l_WaitTriggerCounters[LivestatusWaitTriggerCount];
+
+static const char * const l_WaitTriggerNames[LivestatusWaitTriggerCount] = {
+	"all", "check", "state", "log", "downtime", "comment", "command", "program"
+};
+
+static void NotifyWaitTrigger(LivestatusWaitTrigger trigger)
+{
+	boost::mutex::scoped_lock lock(l_WaitMutex);
+
+	l_WaitTriggerCounters[trigger]++;
+	l_WaitTriggerCounters[LivestatusWaitAll]++;
+
+	l_WaitCV.notify_all();
+}
+
+INITIALIZE_ONCE([]() {
+	Checkable::OnNewCheckResult.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitCheck));
+	Checkable::OnStateChange.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitState));
+
+	/* These events are written to the log table. */
+	Checkable::OnStateChange.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+	Checkable::OnNotificationSentToAllUsers.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+	Checkable::OnAcknowledgementSet.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+	Checkable::OnAcknowledgementCleared.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+	Downtime::OnDowntimeStarted.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+	Downtime::OnDowntimeRemoved.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+	ExternalCommandProcessor::OnNewExternalCommand.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitLog));
+
+	Downtime::OnDowntimeAdded.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitDowntime));
+	Downtime::OnDowntimeRemoved.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitDowntime));
+	Downtime::OnDowntimeStarted.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitDowntime));
+	Downtime::OnDowntimeTriggered.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitDowntime));
+	Comment::OnCommentAdded.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitComment));
+	Comment::OnCommentRemoved.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitComment));
+	ExternalCommandProcessor::OnNewExternalCommand.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitCommand));
+
+	IcingaApplication::OnEnableNotificationsChanged.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitProgram));
+	IcingaApplication::OnEnableEventHandlersChanged.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitProgram));
+	IcingaApplication::OnEnableFlappingChanged.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitProgram));
+	IcingaApplication::OnEnableHostChecksChanged.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitProgram));
+	IcingaApplication::OnEnableServiceChecksChanged.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitProgram));
+	IcingaApplication::OnEnablePerfdataChanged.connect(std::bind(&NotifyWaitTrigger, LivestatusWaitProgram));
+});
+
+static bool GetCachedResult(const String& key, unsigned long long generation, double ttl, String *result)
+{
+	boost::mutex::scoped_lock lock(l_QueryCacheMutex);
+
+	auto it = l_QueryCache.find(key);
+
+	if (it == l_QueryCache.end() || it->second.Generation != generation || it->second.Timestamp + ttl < Utility::GetTime())
+		return false;
+
+	*result = it->second.Result;
+	return true;
+}
+
+static void StoreCachedResult(const String& key, unsigned long long generation, const String& result)
+{
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(l_QueryCacheMutex);
+
+	/* Entries from older generations are never used again. */
+	if (l_QueryCache.size() >= 1000) {
+		for (auto it = l_QueryCache.begin(); it != l_QueryCache.end(); ) {
+			if (it->second.Generation != generation)
+				it = l_QueryCache.erase(it);
+			else
+				++it;
+		}
+
+		if (l_QueryCache.size() >= 1000)
+			l_QueryCache.clear();
+	}
+
+	LivestatusCacheEntry& entry = l_QueryCache[key];
+	entry.Generation = generation;
+	entry.Timestamp = now;
+	entry.Result = result;
+}
+
+LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path, double cache_ttl)
+	: m_KeepAlive(false), m_OutputFormat("csv"), m_ColumnHeaders(true), m_Limit(-1),
+	m_WaitTrigger(LivestatusWaitAll), m_Wait(false), m_WaitTimeout(0), m_ErrorCode(0),
+	m_LogTimeFrom(0), m_LogTimeUntil(static_cast<long>(Utility::GetTime())), m_CacheTtl(cache_ttl)
 {
 	if (lines.size() == 0) {
 		m_Verb = "ERROR";
@@ -63,6 +197,11 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 	String msg;
 	for (const String& line : lines) {
 		msg += line + "\n";
+
+		String header = line.SubStr(0, line.FindFirstOf(":"));
+
+		if (header != "KeepAlive" && header != "ResponseHeader")
+			m_CacheKey += line + "\n";
 	}
 	Log(LogDebug, "LivestatusQuery", msg);
 
@@ -98,7 +237,7 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 		return;
 	}
 
-	std::deque<Filter::Ptr> filters, stats;
+	std::deque<Filter::Ptr> filters, stats, waitConditions;
 	std::deque<Aggregator::Ptr> aggregators;
 
 	for (unsigned int i = 1; i < lines.size(); i++) {
@@ -148,7 +287,35 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 			}
 
 			filters.push_back(filter);
-		} else if (header == "Stats") {
+		} else if (header == "WaitObject")
+			m_WaitObject = params;
+		else if (header == "WaitCondition") {
+			Filter::Ptr filter = ParseFilter(params, m_LogTimeFrom, m_LogTimeUntil);
+
+			if (!filter) {
+				m_Verb = "ERROR";
+				m_ErrorCode = LivestatusErrorQuery;
+				m_ErrorMessage = "Invalid wait condition specification: " + line;
+				return;
+			}
+
+			waitConditions.push_back(filter);
+			m_Wait = true;
+		} else if (header == "WaitTrigger") {
+			auto it = std::find(std::begin(l_WaitTriggerNames), std::end(l_WaitTriggerNames), params);
+
+			if (it == std::end(l_WaitTriggerNames)) {
+				m_Verb = "ERROR";
+				m_ErrorCode = LivestatusErrorQuery;
+				m_ErrorMessage = "Invalid wait trigger: " + line;
+				return;
+			}
+
+			m_WaitTrigger = static_cast<LivestatusWaitTrigger>(it - std::begin(l_WaitTriggerNames));
+			m_Wait = true;
+		} else if (header == "WaitTimeout")
+			m_WaitTimeout = Convert::ToLong(params);
+		else if (header == "Stats") {
 			m_ColumnHeaders = false; // Might be explicitly re-enabled later on
 
 			std::vector<String> tokens = params.Split(" ");
@@ -197,13 +364,15 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 			aggregators.push_back(aggregator);
 
 			stats.push_back(filter);
-		} else if (header == "Or" || header == "And" || header == "StatsOr" || header == "StatsAnd") {
-			std::deque<Filter::Ptr>& deq = (header == "Or" || header == "And") ? filters : stats;
+		} else if (header == "Or" || header == "And" || header == "StatsOr" || header == "StatsAnd" ||
+			header == "WaitConditionOr" || header == "WaitConditionAnd") {
+			std::deque<Filter::Ptr>& deq = (header == "Or" || header == "And") ? filters :
+				(header == "WaitConditionOr" || header == "WaitConditionAnd") ? waitConditions : stats;
 
 			unsigned int num = Convert::ToLong(params);
 			CombinerFilter::Ptr filter;
 
-			if (header == "Or" || header == "StatsOr") {
+			if (header == "Or" || header == "StatsOr" || header == "WaitConditionOr") {
 				filter = new OrFilter();
 				Log(LogDebug, "LivestatusQuery")
 					<< "Add OR filter for " << params << " column(s). " << deq.size() << " filters available.";
@@ -235,8 +404,9 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 				aggregator->SetFilter(filter);
 				aggregators.push_back(aggregator);
 			}
-		} else if (header == "Negate" || header == "StatsNegate") {
-			std::deque<Filter::Ptr>& deq = (header == "Negate") ? filters : stats;
+		} else if (header == "Negate" || header == "StatsNegate" || header == "WaitConditionNegate") {
+			std::deque<Filter::Ptr>& deq = (header == "Negate") ? filters :
+				(header == "WaitConditionNegate") ? waitConditions : stats;
 
 			if (deq.empty()) {
 				m_Verb = "ERROR";
@@ -273,6 +443,17 @@ LivestatusQuery::LivestatusQuery(const std::vector<String>& lines, const String&
 
 	m_Filter = top_filter;
 	m_Aggregators.swap(aggregators);
+
+	/* All top-level wait conditions must be met. */
+	if (!waitConditions.empty()) {
+		AndFilter::Ptr wait_condition = new AndFilter();
+
+		for (const Filter::Ptr& filter : waitConditions) {
+			wait_condition->AddSubFilter(filter);
+		}
+
+		m_WaitCondition = wait_condition;
+	}
 }
 
 int LivestatusQuery::GetExternalCommands()
@@ -357,53 +538,82 @@ Filter::Ptr LivestatusQuery::ParseFilter(const String& params, unsigned long& fr
 	return filter;
 }
 
-void LivestatusQuery::BeginResultSet(std::ostream& fp) const
+void LivestatusQuery::BeginResultSet(String& output) const
 {
 	if (m_OutputFormat == "json" || m_OutputFormat == "python")
-		fp << "[";
+		output += "[";
 }
 
-void LivestatusQuery::EndResultSet(std::ostream& fp) const
+void LivestatusQuery::EndResultSet(String& output) const
 {
 	if (m_OutputFormat == "json" || m_OutputFormat == "python")
-		fp << "]";
+		output += "]";
 }
 
-void LivestatusQuery::AppendResultRow(std::ostream& fp, const Array::Ptr& row, bool& first_row) const
+void LivestatusQuery::BeginResultRow(String& output, bool& first_row) const
 {
-	if (m_OutputFormat == "csv") {
-		bool first = true;
+	if (m_OutputFormat == "json") {
+		if (!first_row)
+			output += ", ";
 
-		ObjectLock rlock(row);
-		for (const Value& value : row) {
-			if (first)
-				first = false;
-			else
-				fp << m_Separators[1];
+		output += "[";
+	} else if (m_OutputFormat == "python") {
+		if (!first_row)
+			output += ", ";
 
-			if (value.IsObjectType<Array>())
-				PrintCsvArray(fp, value, 0);
-			else
-				fp << value;
-		}
+		output += "[ ";
+	}
+
+	first_row = false;
+}
 
-		fp << m_Separators[0];
+/**
+ * Formats a column value straight into the output, rows are never
+ * materialized as arrays.
+ */
+void LivestatusQuery::AppendResultValue(String& output, const Value& value, bool& first_value) const
+{
+	if (m_OutputFormat == "csv") {
+		if (!first_value)
+			output += m_Separators[1];
+
+		if (value.IsObjectType<Array>())
+			PrintCsvArray(output, value, 0);
+		else if (value.IsBoolean())
+			output += value.ToBool() ? '1' : '0';
+		else
+			output += value;
 	} else if (m_OutputFormat == "json") {
-		if (!first_row)
-			fp << ", ";
+		if (!first_value)
+			output += ",";
 
-		fp << JsonEncode(row);
+		PrintJsonValue(output, value);
 	} else if (m_OutputFormat == "python") {
-		if (!first_row)
-			fp << ", ";
+		if (!first_value)
+			output += ", ";
 
-		PrintPythonArray(fp, row);
+		if (value.IsObjectType<Array>())
+			PrintPythonArray(output, value);
+		else if (value.IsNumber())
+			output += value;
+		else
+			output += QuoteStringPython(value);
 	}
 
-	first_row = false;
+	first_value = false;
 }
 
-void LivestatusQuery::PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const
+void LivestatusQuery::EndResultRow(String& output) const
+{
+	if (m_OutputFormat == "csv")
+		output += m_Separators[0];
+	else if (m_OutputFormat == "json")
+		output += "]";
+	else if (m_OutputFormat == "python")
+		output += " ]";
+}
+
+void LivestatusQuery::PrintCsvArray(String& output, const Array::Ptr& array, int level) const
 {
 	bool first = true;
 
@@ -412,20 +622,20 @@ void LivestatusQuery::PrintCsvArray(std::ostream& fp, const Array::Ptr& array, i
 		if (first)
 			first = false;
 		else
-			fp << ((level == 0) ? m_Separators[2] : m_Separators[3]);
+			output += ((level == 0) ? m_Separators[2] : m_Separators[3]);
 
 		if (value.IsObjectType<Array>())
-			PrintCsvArray(fp, value, level + 1);
+			PrintCsvArray(output, value, level + 1);
 		else if (value.IsBoolean())
-			fp << Convert::ToLong(value);
+			output += value.ToBool() ? '1' : '0';
 		else
-			fp << value;
+			output += value;
 	}
 }
 
-void LivestatusQuery::PrintPythonArray(std::ostream& fp, const Array::Ptr& rs) const
+void LivestatusQuery::PrintPythonArray(String& output, const Array::Ptr& rs) const
 {
-	fp << "[ ";
+	output += "[ ";
 
 	bool first = true;
 
@@ -433,17 +643,79 @@ void LivestatusQuery::PrintPythonArray(std::ostream& fp, const Array::Ptr& rs) c
 		if (first)
 			first = false;
 		else
-			fp << ", ";
+			output += ", ";
 
 		if (value.IsObjectType<Array>())
-			PrintPythonArray(fp, value);
+			PrintPythonArray(output, value);
 		else if (value.IsNumber())
-			fp << value;
+			output += value;
 		else
-			fp << QuoteStringPython(value);
+			output += QuoteStringPython(value);
 	}
 
-	fp << " ]";
+	output += " ]";
+}
+
+/**
+ * Appends a value just like JsonEncode() would. Strings and numbers, i.e.
+ * most column values, are written directly.
+ */
+void LivestatusQuery::PrintJsonValue(String& output, const Value& value)
+{
+	if (value.IsString()) {
+		const std::string& str = value.Get<String>().GetData();
+		std::string& out = output.GetData();
+		size_t begin = 0;
+
+		out += '"';
+
+		/* Same escapes as yajl_gen_string() */
+		for (size_t i = 0; i < str.size(); i++) {
+			const char *escaped;
+			char hex[7];
+
+			switch (str[i]) {
+				case '\r': escaped = "\\r"; break;
+				case '\n': escaped = "\\n"; break;
+				case '\\': escaped = "\\\\"; break;
+				case '"': escaped = "\\\""; break;
+				case '\f': escaped = "\\f"; break;
+				case '\b': escaped = "\\b"; break;
+				case '\t': escaped = "\\t"; break;
+				default:
+					if (static_cast<unsigned char>(str[i]) >= 32)
+						continue;
+
+					sprintf(hex, "\\u%04X", static_cast<unsigned char>(str[i]));
+					escaped = hex;
+			}
+
+			out.append(str, begin, i - begin);
+			out += escaped;
+			begin = i + 1;
+		}
+
+		out.append(str, begin, std::string::npos);
+		out += '"';
+	} else if (value.IsNumber()) {
+		char buffer[Convert::FormatBufferSize + 3];
+		size_t length = Convert::FormatShortest(value.Get<double>(), buffer);
+
+		if (length == 0) {
+			output += JsonEncode(value);
+			return;
+		}
+
+		buffer[length] = '\0';
+
+		if (strspn(buffer, "0123456789-") == length) {
+			memcpy(buffer + length, ".0", 2);
+			length += 2;
+		}
+
+		output.GetData().append(buffer, length);
+	} else
+		output += JsonEncode(value);
 }
 
 String LivestatusQuery::QuoteStringPython(const String& str) {
@@ -452,11 +724,159 @@ String LivestatusQuery::QuoteStringPython(const String& str) {
 	return "r\"" + result + "\"";
 }
 
+void LivestatusQuery::AggregateRows(const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects,
+	size_t begin, size_t end, LivestatusStatsMap& allStats) const
+{
+	std::vector<const Column *> columns;
+	columns.reserve(m_Columns.size());
+
+	for (const String& columnName : m_Columns)
+		columns.emplace_back(&table->GetColumn(columnName));
+
+	for (size_t i = begin; i < end; i++) {
+		const LivestatusRowValue& object = objects[i];
+
+		std::vector<Value> statsKey;
+		statsKey.reserve(columns.size());
+
+		for (const Column *column : columns) {
+			if (object.GroupByType == LivestatusGroupByNone)
+				statsKey.emplace_back(table->GetColumnValue(*column, object.Row));
+			else
+				statsKey.emplace_back(column->ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
+		}
+
+		auto it = allStats.find(statsKey);
+
+		if (it == allStats.end()) {
+			std::vector<AggregatorState *> newStats(m_Aggregators.size(), nullptr);
+			it = allStats.insert(std::make_pair(std::move(statsKey), std::move(newStats))).first;
+		}
+
+		auto& stats = it->second;
+
+		int index = 0;
+
+		for (const Aggregator::Ptr& aggregator : m_Aggregators) {
+			aggregator->Apply(table, object.Row, &stats[index]);
+			index++;
+		}
+	}
+}
+
+/**
+ * Checks whether a row is the object specified by the WaitObject header,
+ * i.e. "host" or "host;service" ("host service" is accepted as well).
+ */
+bool LivestatusQuery::IsWaitObject(const Value& row) const
+{
+	if (!row.IsObject())
+		return false;
+
+	Object::Ptr object = row;
+	Service::Ptr service = dynamic_pointer_cast<Service>(object);
+
+	if (service) {
+		size_t sep_index = m_WaitObject.FindFirstOf(";");
+
+		if (sep_index == String::NPos)
+			sep_index = m_WaitObject.FindFirstOf(" ");
+
+		if (sep_index == String::NPos)
+			return false;
+
+		return service->GetHost()->GetName() == m_WaitObject.SubStr(0, sep_index) &&
+			service->GetShortName() == m_WaitObject.SubStr(sep_index + 1);
+	}
+
+	ConfigObject::Ptr configObject = dynamic_pointer_cast<ConfigObject>(object);
+
+	return configObject && configObject->GetName() == m_WaitObject;
+}
+
+bool LivestatusQuery::IsWaitConditionMet() const
+{
+	/* A new table is used for each check, so column values which were
+	 * cached for the previous check are not reused. */
+	Table::Ptr table = Table::GetByName(m_Table, m_CompatLogPath, m_LogTimeFrom, m_LogTimeUntil);
+
+	if (!table)
+		return true;
+
+	bool met = false;
+
+	if (m_WaitObject.IsEmpty()) {
+		table->FilterRows(m_WaitCondition, 1, [&met](const LivestatusRowValue&) { met = true; });
+	} else {
+		table->FilterRows(m_WaitCondition, -1, [this, &met](const LivestatusRowValue& rval) {
+			if (IsWaitObject(rval.Row))
+				met = true;
+		});
+	}
+
+	return met;
+}
+
+/**
+ * Blocks until the wait condition is met (if there is one) or an event
+ * for the wait trigger occurs (if there is no condition), or until the
+ * wait timeout expires.
+ */
+void LivestatusQuery::WaitForTrigger() const
+{
+	boost::posix_time::ptime deadline;
+
+	if (m_WaitTimeout > 0)
+		deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(m_WaitTimeout);
+
+	boost::mutex::scoped_lock lock(l_WaitMutex);
+
+	for (;;) {
+		/* Events which occur while the condition is evaluated must wake us up. */
+		unsigned long long counter = l_WaitTriggerCounters[m_WaitTrigger];
+
+		if (m_WaitCondition) {
+			lock.unlock();
+			bool met = IsWaitConditionMet();
+			lock.lock();
+
+			if (met)
+				return;
+		}
+
+		while (l_WaitTriggerCounters[m_WaitTrigger] == counter) {
+			if (deadline.is_not_a_date_time())
+				l_WaitCV.wait(lock);
+			else if (!l_WaitCV.timed_wait(lock, deadline))
+				return;
+		}
+
+		if (!m_WaitCondition)
+			return;
+	}
+}
+
 void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 {
 	Log(LogNotice, "LivestatusQuery")
 		<< "Table: " << m_Table;
 
+	if (m_Wait)
+		WaitForTrigger();
+
+	/* The log tables are read from files and don't belong to a generation. */
+	bool cacheable = m_CacheTtl > 0 && m_Table != "log" && m_Table != "statehist";
+	unsigned long long generation = l_QueryCacheGeneration;
+
+	if (cacheable) {
+		String cachedResult;
+
+		if (GetCachedResult(m_CacheKey, generation, m_CacheTtl, &cachedResult)) {
+			SendResponse(stream, LivestatusErrorOK, cachedResult);
+			return;
+		}
+	}
+
 	Table::Ptr table = Table::GetByName(m_Table, m_CompatLogPath, m_LogTimeFrom, m_LogTimeUntil);
 
 	if (!table) {
@@ -465,7 +885,6 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 		return;
 	}
 
-	std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit);
 	std::vector<String> columns;
 
 	if (m_Columns.size() > 0)
@@ -473,118 +892,167 @@ void LivestatusQuery::ExecuteGetHelper(const Stream::Ptr& stream)
 	else
 		columns = table->GetColumnNames();
 
-	std::ostringstream result;
+	/* The fixed16 header needs the result's length up front and cached
+	 * results are stored as a whole, all other results are written to the
+	 * stream while they are formatted. */
+	bool streaming = !cacheable && m_ResponseHeader != "fixed16";
+
+	String result;
+	result.GetData().reserve(l_ResultChunkSize);
+
+	auto flushResult = [this, streaming, &stream, &result]() {
+		if (streaming && result.GetLength() >= l_ResultChunkSize) {
+			SendResponse(stream, LivestatusErrorOK, result);
+			result.GetData().clear();
+		}
+	};
+
 	bool first_row = true;
 	BeginResultSet(result);
 
 	if (m_Aggregators.empty()) {
-		typedef std::pair<String, Column> ColumnPair;
+		typedef std::pair<String, const Column *> ColumnPair;
 
 		std::vector<ColumnPair> column_objs;
 		column_objs.reserve(columns.size());
 
 		for (const String& columnName : columns)
-			column_objs.emplace_back(columnName, table->GetColumn(columnName));
+			column_objs.emplace_back(columnName, &table->GetColumn(columnName));
 
-		ArrayData header;
+		/* Rows are formatted as soon as they match the filter, the column
+		 * values which the filter extracted are still cached then. */
+		table->FilterRows(m_Filter, m_Limit, [this, &table, &column_objs, &result, &first_row, &flushResult](const LivestatusRowValue& object) {
+			bool first_value = true;
 
-		for (const LivestatusRowValue& object : objects) {
-			ArrayData row;
+			if (m_ColumnHeaders) {
+				BeginResultRow(result, first_row);
 
-			row.reserve(column_objs.size());
+				for (const ColumnPair& cv : column_objs)
+					AppendResultValue(result, cv.first, first_value);
 
-			for (const ColumnPair& cv : column_objs) {
-				if (m_ColumnHeaders)
-					header.push_back(cv.first);
+				EndResultRow(result);
 
-				row.push_back(cv.second.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
+				m_ColumnHeaders = false;
+				first_value = true;
 			}
 
-			if (m_ColumnHeaders) {
-				AppendResultRow(result, new Array(std::move(header)), first_row);
-				m_ColumnHeaders = false;
+			BeginResultRow(result, first_row);
+
+			for (const ColumnPair& cv : column_objs) {
+				Value value;
+
+				if (object.GroupByType == LivestatusGroupByNone)
+					value = table->GetColumnValue(*cv.second, object.Row);
+				else
+					value = cv.second->ExtractValue(object.Row, object.GroupByType, object.GroupByObject);
+
+				AppendResultValue(result, value, first_value);
 			}
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
-		}
+			EndResultRow(result);
+
+			flushResult();
+		});
 	} else {
-		std::map<std::vector<Value>, std::vector<AggregatorState *> > allStats;
+		std::vector<LivestatusRowValue> objects = table->FilterRows(m_Filter, m_Limit);
+		LivestatusStatsMap allStats;
 
-		/* add aggregated stats */
-		for (const LivestatusRowValue& object : objects) {
-			std::vector<Value> statsKey;
+		/* Large stats queries (e.g. the tactical overview) are evaluated in chunks
+		 * on the thread pool, the partial aggregator states are merged afterwards. */
+		size_t chunks = std::min<size_t>(Application::GetConcurrency(), objects.size() / l_StatsRowsPerChunk);
 
-			for (const String& columnName : m_Columns) {
-				Column column = table->GetColumn(columnName);
-				statsKey.emplace_back(column.ExtractValue(object.Row, object.GroupByType, object.GroupByObject));
-			}
+		if (chunks < 2) {
+			AggregateRows(table, objects, 0, objects.size(), allStats);
+		} else {
+			std::vector<LivestatusStatsMap> partialStats(chunks);
+			std::vector<size_t> indices(chunks);
 
-			auto it = allStats.find(statsKey);
+			for (size_t i = 0; i < chunks; i++)
+				indices[i] = i;
 
-			if (it == allStats.end()) {
-				std::vector<AggregatorState *> newStats(m_Aggregators.size(), nullptr);
-				it = allStats.insert(std::make_pair(statsKey, newStats)).first;
-			}
+			WorkQueue upq(25000, static_cast<int>(chunks));
+			upq.SetName("LivestatusQuery");
+
+			upq.ParallelFor(indices, [this, &table, &objects, &partialStats, chunks](size_t i) {
+				size_t begin = objects.size() * i / chunks;
+				size_t end = objects.size() * (i + 1) / chunks;
+
+				AggregateRows(table, objects, begin, end, partialStats[i]);
+			});
 
-			auto& stats = it->second;
+			upq.Join();
 
-			int index = 0;
+			for (LivestatusStatsMap& partial : partialStats) {
+				for (auto& kv : partial) {
+					auto it = allStats.find(kv.first);
 
-			for (const Aggregator::Ptr& aggregator : m_Aggregators) {
-				aggregator->Apply(table, object.Row, &stats[index]);
-				index++;
+					if (it == allStats.end()) {
+						allStats.insert(std::move(kv));
+						continue;
+					}
+
+					for (size_t i = 0; i < m_Aggregators.size(); i++)
+						m_Aggregators[i]->MergeAndFreeState(&it->second[i], kv.second[i]);
+				}
 			}
 		}
 
 		/* add column headers both for raw and aggregated data */
 		if (m_ColumnHeaders) {
-			ArrayData header;
+			bool first_value = true;
+
+			BeginResultRow(result, first_row);
 
 			for (const String& columnName : m_Columns) {
-				header.push_back(columnName);
+				AppendResultValue(result, columnName, first_value);
 			}
 
 			for (size_t i = 1; i <= m_Aggregators.size(); i++) {
-				header.push_back("stats_" + Convert::ToString(i));
+				AppendResultValue(result, "stats_" + Convert::ToString(i), first_value);
 			}
 
-			AppendResultRow(result, new Array(std::move(header)), first_row);
+			EndResultRow(result);
 		}
 
 		for (const auto& kv : allStats) {
-			ArrayData row;
+			bool first_value = true;
 
-			row.reserve(m_Columns.size() + m_Aggregators.size());
+			BeginResultRow(result, first_row);
 
 			for (const Value& keyPart : kv.first) {
-				row.push_back(keyPart);
+				AppendResultValue(result, keyPart, first_value);
 			}
 
 			auto& stats = kv.second;
 
 			for (size_t i = 0; i < m_Aggregators.size(); i++)
-				row.push_back(m_Aggregators[i]->GetResultAndFreeState(stats[i]));
+				AppendResultValue(result, m_Aggregators[i]->GetResultAndFreeState(stats[i]), first_value);
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
+			EndResultRow(result);
+
+			flushResult();
 		}
 
 		/* add a bogus zero value if aggregated is empty*/
 		if (allStats.empty()) {
-			ArrayData row;
+			bool first_value = true;
 
-			row.reserve(m_Aggregators.size());
+			BeginResultRow(result, first_row);
 
 			for (size_t i = 1; i <= m_Aggregators.size(); i++) {
-				row.push_back(0);
+				AppendResultValue(result, 0, first_value);
 			}
 
-			AppendResultRow(result, new Array(std::move(row)), first_row);
+			EndResultRow(result);
 		}
 	}
 
 	EndResultSet(result);
 
-	SendResponse(stream, LivestatusErrorOK, result.str());
+	if (cacheable)
+		StoreCachedResult(m_CacheKey, generation, result);
+
+	SendResponse(stream, LivestatusErrorOK, result);
 }
 
 void LivestatusQuery::ExecuteCommandHelper(const Stream::Ptr& stream)
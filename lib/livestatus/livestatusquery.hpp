@@ -27,6 +27,7 @@
 #include "base/stream.hpp"
 #include "base/scriptframe.hpp"
 #include <deque>
+#include <map>
 
 using namespace icinga;
 
@@ -40,6 +41,21 @@ enum LivestatusError
 	LivestatusErrorQuery = 452
 };
 
+enum LivestatusWaitTrigger
+{
+	LivestatusWaitAll,
+	LivestatusWaitCheck,
+	LivestatusWaitState,
+	LivestatusWaitLog,
+	LivestatusWaitDowntime,
+	LivestatusWaitComment,
+	LivestatusWaitCommand,
+	LivestatusWaitProgram,
+	LivestatusWaitTriggerCount
+};
+
+typedef std::map<std::vector<Value>, std::vector<AggregatorState *> > LivestatusStatsMap;
+
 /**
  * @ingroup livestatus
  */
@@ -48,7 +64,7 @@ class LivestatusQuery final : public Object
 public:
 	DECLARE_PTR_TYPEDEFS(LivestatusQuery);
 
-	LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path);
+	LivestatusQuery(const std::vector<String>& lines, const String& compat_log_path, double cache_ttl = 0);
 
 	bool Execute(const Stream::Ptr& stream);
 
@@ -73,6 +89,13 @@ private:
 
 	String m_ResponseHeader;
 
+	/* Parameters for GET queries which wait for a change. */
+	String m_WaitObject;
+	Filter::Ptr m_WaitCondition;
+	LivestatusWaitTrigger m_WaitTrigger;
+	bool m_Wait;
+	long m_WaitTimeout;
+
 	/* Parameters for COMMAND/SCRIPT queries. */
 	String m_Command;
 	String m_Session;
@@ -85,14 +108,27 @@ private:
 	unsigned long m_LogTimeUntil;
 	String m_CompatLogPath;
 
-	void BeginResultSet(std::ostream& fp) const;
-	void EndResultSet(std::ostream& fp) const;
-	void AppendResultRow(std::ostream& fp, const Array::Ptr& row, bool& first_row) const;
-	void PrintCsvArray(std::ostream& fp, const Array::Ptr& array, int level) const;
-	void PrintPythonArray(std::ostream& fp, const Array::Ptr& array) const;
+	/* The query without headers which don't change the result. */
+	String m_CacheKey;
+	double m_CacheTtl;
+
+	void BeginResultSet(String& output) const;
+	void EndResultSet(String& output) const;
+	void BeginResultRow(String& output, bool& first_row) const;
+	void AppendResultValue(String& output, const Value& value, bool& first_value) const;
+	void EndResultRow(String& output) const;
+	void PrintCsvArray(String& output, const Array::Ptr& array, int level) const;
+	void PrintPythonArray(String& output, const Array::Ptr& array) const;
+	static void PrintJsonValue(String& output, const Value& value);
 	static String QuoteStringPython(const String& str);
 
+	void WaitForTrigger() const;
+	bool IsWaitConditionMet() const;
+	bool IsWaitObject(const Value& row) const;
+
 	void ExecuteGetHelper(const Stream::Ptr& stream);
+	void AggregateRows(const Table::Ptr& table, const std::vector<LivestatusRowValue>& objects,
+		size_t begin, size_t end, LivestatusStatsMap& allStats) const;
 	void ExecuteCommandHelper(const Stream::Ptr& stream);
 	void ExecuteErrorHelper(const Stream::Ptr& stream);
 
@@ -35,9 +35,7 @@ MaxAggregatorState *MaxAggregator::EnsureState(AggregatorState **state)
 
 void MaxAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_MaxAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_MaxAttr, row);
 
 	MaxAggregatorState *pstate = EnsureState(state);
 
@@ -53,3 +51,17 @@ double MaxAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void MaxAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	MaxAggregatorState *pstate = EnsureState(state);
+	MaxAggregatorState *pother = static_cast<MaxAggregatorState *>(other);
+
+	if (pother->Max > pstate->Max)
+		pstate->Max = pother->Max;
+
+	delete pother;
+}
@@ -46,6 +46,7 @@ public:
 
 	void Apply(const Table::Ptr& table, const Value& row, AggregatorState **state) override;
 	double GetResultAndFreeState(AggregatorState *state) const override;
+	void MergeAndFreeState(AggregatorState **state, AggregatorState *other) const override;
 
 private:
 	String m_MaxAttr;
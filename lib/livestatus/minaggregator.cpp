@@ -35,9 +35,7 @@ MinAggregatorState *MinAggregator::EnsureState(AggregatorState **state)
 
 void MinAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_MinAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_MinAttr, row);
 
 	MinAggregatorState *pstate = EnsureState(state);
 
@@ -60,3 +58,17 @@ double MinAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void MinAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	MinAggregatorState *pstate = EnsureState(state);
+	MinAggregatorState *pother = static_cast<MinAggregatorState *>(other);
+
+	if (pother->Min < pstate->Min)
+		pstate->Min = pother->Min;
+
+	delete pother;
+}
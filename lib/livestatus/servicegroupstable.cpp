@@ -63,7 +63,7 @@ String ServiceGroupsTable::GetPrefix() const
 
 void ServiceGroupsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectsByType<ServiceGroup>()) {
+	for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectViewByType<ServiceGroup>()) {
 		if (!addRowFn(sg, LivestatusGroupByNone, Empty))
 			return;
 	}
@@ -166,14 +166,14 @@ Value ServiceGroupsTable::WorstServiceStateAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	Value worst_service = ServiceOK;
+	CheckableStateCounts counts = sg->GetMemberStateCounts();
 
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetState() > worst_service)
-			worst_service = service->GetState();
+	for (int state = ServiceUnknown; state > ServiceOK; state--) {
+		if (counts.States[state] > 0)
+			return state;
 	}
 
-	return worst_service;
+	return ServiceOK;
 }
 
 Value ServiceGroupsTable::NumServicesAccessor(const Value& row)
@@ -183,7 +183,7 @@ Value ServiceGroupsTable::NumServicesAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	return sg->GetMembers().size();
+	return sg->GetMemberStateCounts().Total;
 }
 
 Value ServiceGroupsTable::NumServicesOkAccessor(const Value& row)
@@ -193,14 +193,7 @@ Value ServiceGroupsTable::NumServicesOkAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetState() == ServiceOK)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().States[ServiceOK];
 }
 
 Value ServiceGroupsTable::NumServicesWarnAccessor(const Value& row)
@@ -210,14 +203,7 @@ Value ServiceGroupsTable::NumServicesWarnAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetState() == ServiceWarning)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().States[ServiceWarning];
 }
 
 Value ServiceGroupsTable::NumServicesCritAccessor(const Value& row)
@@ -227,14 +213,7 @@ Value ServiceGroupsTable::NumServicesCritAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetState() == ServiceCritical)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().States[ServiceCritical];
 }
 
 Value ServiceGroupsTable::NumServicesUnknownAccessor(const Value& row)
@@ -244,14 +223,7 @@ Value ServiceGroupsTable::NumServicesUnknownAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetState() == ServiceUnknown)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().States[ServiceUnknown];
 }
 
 Value ServiceGroupsTable::NumServicesPendingAccessor(const Value& row)
@@ -261,14 +233,7 @@ Value ServiceGroupsTable::NumServicesPendingAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (!service->GetLastCheckResult())
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().Pending;
 }
 
 Value ServiceGroupsTable::NumServicesHardOkAccessor(const Value& row)
@@ -278,14 +243,7 @@ Value ServiceGroupsTable::NumServicesHardOkAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceOK)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().HardStates[ServiceOK];
 }
 
 Value ServiceGroupsTable::NumServicesHardWarnAccessor(const Value& row)
@@ -295,14 +253,7 @@ Value ServiceGroupsTable::NumServicesHardWarnAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceWarning)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().HardStates[ServiceWarning];
 }
 
 Value ServiceGroupsTable::NumServicesHardCritAccessor(const Value& row)
@@ -312,14 +263,7 @@ Value ServiceGroupsTable::NumServicesHardCritAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceCritical)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().HardStates[ServiceCritical];
 }
 
 Value ServiceGroupsTable::NumServicesHardUnknownAccessor(const Value& row)
@@ -329,12 +273,5 @@ Value ServiceGroupsTable::NumServicesHardUnknownAccessor(const Value& row)
 	if (!sg)
 		return Empty;
 
-	int num_services = 0;
-
-	for (const Service::Ptr& service : sg->GetMembers()) {
-		if (service->GetStateType() == StateTypeHard && service->GetState() == ServiceUnknown)
-			num_services++;
-	}
-
-	return num_services;
+	return sg->GetMemberStateCounts().HardStates[ServiceUnknown];
 }
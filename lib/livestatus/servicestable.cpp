@@ -168,7 +168,7 @@ String ServicesTable::GetPrefix() const
 void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 {
 	if (GetGroupByType() == LivestatusGroupByServiceGroup) {
-		for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectsByType<ServiceGroup>()) {
+		for (const ServiceGroup::Ptr& sg : ConfigType::GetObjectViewByType<ServiceGroup>()) {
 			for (const Service::Ptr& service : sg->GetMembers()) {
 				/* the caller must know which groupby type and value are set for this row */
 				if (!addRowFn(service, LivestatusGroupByServiceGroup, sg))
@@ -176,11 +176,11 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 			}
 		}
 	} else if (GetGroupByType() == LivestatusGroupByHostGroup) {
-		for (const HostGroup::Ptr& hg : ConfigType::GetObjectsByType<HostGroup>()) {
+		for (const HostGroup::Ptr& hg : ConfigType::GetObjectViewByType<HostGroup>()) {
 			ObjectLock ylock(hg);
 			for (const Host::Ptr& host : hg->GetMembers()) {
 				ObjectLock ylock(host);
-				for (const Service::Ptr& service : host->GetServices()) {
+				for (const Service::Ptr& service : host->GetServiceView()) {
 					/* the caller must know which groupby type and value are set for this row */
 					if (!addRowFn(service, LivestatusGroupByHostGroup, hg))
 						return;
@@ -188,13 +188,65 @@ void ServicesTable::FetchRows(const AddRowFunction& addRowFn)
 			}
 		}
 	} else {
-		for (const Service::Ptr& service : ConfigType::GetObjectsByType<Service>()) {
+		for (const Service::Ptr& service : ConfigType::GetObjectViewByType<Service>()) {
 			if (!addRowFn(service, LivestatusGroupByNone, Empty))
 				return;
 		}
 	}
 }
 
+void ServicesTable::FetchCandidateRows(const AddRowFunction& addRowFn, const Filter::Ptr& filter)
+{
+	String operand;
+
+	if (GetGroupByType() != LivestatusGroupByNone || !filter) {
+		FetchRows(addRowFn);
+	} else if (filter->GetRequiredOperand("host_name", "=", &operand)) {
+		Host::Ptr host = Host::GetByName(operand);
+
+		if (!host)
+			return;
+
+		if (filter->GetRequiredOperand("description", "=", &operand)) {
+			Service::Ptr service = host->GetServiceByShortName(operand);
+
+			if (service)
+				addRowFn(service, LivestatusGroupByNone, Empty);
+
+			return;
+		}
+
+		for (const Service::Ptr& service : host->GetServiceView()) {
+			if (!addRowFn(service, LivestatusGroupByNone, Empty))
+				return;
+		}
+	} else if (filter->GetRequiredOperand("groups", ">=", &operand)) {
+		ServiceGroup::Ptr sg = ServiceGroup::GetByName(operand);
+
+		if (!sg)
+			return;
+
+		for (const Service::Ptr& service : sg->GetMembers()) {
+			if (!addRowFn(service, LivestatusGroupByNone, Empty))
+				return;
+		}
+	} else if (filter->GetRequiredOperand("host_groups", ">=", &operand)) {
+		HostGroup::Ptr hg = HostGroup::GetByName(operand);
+
+		if (!hg)
+			return;
+
+		for (const Host::Ptr& host : hg->GetMembers()) {
+			for (const Service::Ptr& service : host->GetServiceView()) {
+				if (!addRowFn(service, LivestatusGroupByNone, Empty))
+					return;
+			}
+		}
+	} else {
+		FetchRows(addRowFn);
+	}
+}
+
 Object::Ptr ServicesTable::HostAccessor(const Value& row, const Column::ObjectAccessor& parentObjectAccessor)
 {
 	Value service;
@@ -565,8 +617,7 @@ Value ServicesTable::AcknowledgedAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	ObjectLock olock(service);
-	return service->IsAcknowledged();
+	return service->GetStateSnapshot()->IsAcknowledged();
 }
 
 Value ServicesTable::AcknowledgementTypeAccessor(const Value& row)
@@ -576,8 +627,7 @@ Value ServicesTable::AcknowledgementTypeAccessor(const Value& row)
 	if (!service)
 		return Empty;
 
-	ObjectLock olock(service);
-	return service->GetAcknowledgement();
+	return service->GetStateSnapshot()->GetAcknowledgement();
 }
 
 Value ServicesTable::NoMoreNotificationsAccessor(const Value& row)
@@ -260,8 +260,8 @@ void StateHistTable::FetchRows(const AddRowFunction& addRowFn)
 	/* create log file index */
 	LivestatusLogUtility::CreateLogIndex(m_CompatLogPath, m_LogFileIndex);
 
-	/* generate log cache */
-	LivestatusLogUtility::CreateLogCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
+	/* replay the state history events */
+	LivestatusLogUtility::CreateStateHistoryCache(m_LogFileIndex, this, m_TimeFrom, m_TimeUntil, addRowFn);
 
 	Checkable::Ptr checkable;
 
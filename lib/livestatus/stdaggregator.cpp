@@ -36,9 +36,7 @@ StdAggregatorState *StdAggregator::EnsureState(AggregatorState **state)
 
 void StdAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_StdAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_StdAttr, row);
 
 	StdAggregatorState *pstate = EnsureState(state);
 
@@ -55,3 +53,18 @@ double StdAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void StdAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	StdAggregatorState *pstate = EnsureState(state);
+	StdAggregatorState *pother = static_cast<StdAggregatorState *>(other);
+
+	pstate->StdSum += pother->StdSum;
+	pstate->StdQSum += pother->StdQSum;
+	pstate->StdCount += pother->StdCount;
+
+	delete pother;
+}
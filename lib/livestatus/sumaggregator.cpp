@@ -35,9 +35,7 @@ SumAggregatorState *SumAggregator::EnsureState(AggregatorState **state)
 
 void SumAggregator::Apply(const Table::Ptr& table, const Value& row, AggregatorState **state)
 {
-	Column column = table->GetColumn(m_SumAttr);
-
-	Value value = column.ExtractValue(row);
+	Value value = table->GetColumnValue(m_SumAttr, row);
 
 	SumAggregatorState *pstate = EnsureState(state);
 
@@ -52,3 +50,16 @@ double SumAggregator::GetResultAndFreeState(AggregatorState *state) const
 
 	return result;
 }
+
+void SumAggregator::MergeAndFreeState(AggregatorState **state, AggregatorState *other) const
+{
+	if (!other)
+		return;
+
+	SumAggregatorState *pstate = EnsureState(state);
+	SumAggregatorState *pother = static_cast<SumAggregatorState *>(other);
+
+	pstate->Sum += pother->Sum;
+
+	delete pother;
+}
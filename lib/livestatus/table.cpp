@@ -38,11 +38,29 @@
 #include "base/dictionary.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <atomic>
 
 using namespace icinga;
 
+/* Identifies the table (i.e. the query) which the cached column values belong to. */
+static std::atomic<uint_fast64_t> l_TableGeneration{0};
+
+/**
+ * The column values of the row which was most recently looked at by this
+ * thread. Filters, aggregators and the query's output all extract the same
+ * few columns of a row, this way each of them is only extracted once.
+ */
+struct RowColumnCache
+{
+	uint_fast64_t Generation{0};
+	Object::Ptr Row;
+	std::vector<std::pair<const Column *, Value> > Values;
+};
+
+static thread_local RowColumnCache l_RowColumnCache;
+
 Table::Table(LivestatusGroupByType type)
-	: m_GroupByType(type), m_GroupByObject(Empty)
+	: m_GroupByType(type), m_GroupByObject(Empty), m_Generation(++l_TableGeneration)
 { }
 
 Table::Ptr Table::GetByName(const String& name, const String& compat_log_path, const unsigned long& from, const unsigned long& until)
@@ -97,7 +115,7 @@ void Table::AddColumn(const String& name, const Column& column)
 		ret.first->second = column;
 }
 
-Column Table::GetColumn(const String& name) const
+const Column& Table::GetColumn(const String& name) const
 {
 	String dname = name;
 	String prefix = GetPrefix() + "_";
@@ -124,18 +142,74 @@ std::vector<String> Table::GetColumnNames() const
 	return names;
 }
 
+/**
+ * Extracts a column's value, see RowColumnCache.
+ */
+Value Table::GetColumnValue(const String& name, const Value& row) const
+{
+	return GetColumnValue(GetColumn(name), row);
+}
+
+Value Table::GetColumnValue(const Column& column, const Value& row) const
+{
+	if (!row.IsObject())
+		return column.ExtractValue(row);
+
+	RowColumnCache& cache = l_RowColumnCache;
+	const Object::Ptr& object = row.Get<Object::Ptr>();
+
+	if (cache.Generation != m_Generation || cache.Row != object) {
+		cache.Generation = m_Generation;
+		cache.Row = object;
+		cache.Values.clear();
+	}
+
+	for (const auto& kv : cache.Values) {
+		if (kv.first == &column)
+			return kv.second;
+	}
+
+	Value value = column.ExtractValue(row);
+	cache.Values.emplace_back(&column, value);
+	return value;
+}
+
 std::vector<LivestatusRowValue> Table::FilterRows(const Filter::Ptr& filter, int limit)
 {
 	std::vector<LivestatusRowValue> rs;
 
-	FetchRows(std::bind(&Table::FilteredAddRow, this, std::ref(rs), filter, limit, _1, _2, _3));
+	FilterRows(filter, limit, [&rs](const LivestatusRowValue& rval) { rs.push_back(rval); });
 
 	return rs;
 }
 
-bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
+/**
+ * Calls the function for each row which matches the filter while the row's
+ * column values are still cached, see GetColumnValue().
+ */
+void Table::FilterRows(const Filter::Ptr& filter, int limit, const FilteredRowFunction& rowFn)
+{
+	int count = 0;
+
+	FetchCandidateRows(std::bind(&Table::FilteredAddRow, this, std::cref(rowFn), std::ref(count), filter, limit, _1, _2, _3), filter);
+
+	/* Don't keep the last row alive. */
+	l_RowColumnCache.Row.reset();
+	l_RowColumnCache.Values.clear();
+}
+
+/**
+ * Fetches the rows which the filter is applied to. Tables may override this
+ * to skip rows which can't match the filter.
+ */
+void Table::FetchCandidateRows(const AddRowFunction& addRowFn, const Filter::Ptr&)
+{
+	FetchRows(addRowFn);
+}
+
+bool Table::FilteredAddRow(const FilteredRowFunction& rowFn, int& count, const Filter::Ptr& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject)
 {
-	if (limit != -1 && static_cast<int>(rs.size()) == limit)
+	if (limit != -1 && count == limit)
 		return false;
 
 	if (!filter || filter->Apply(this, row)) {
@@ -144,7 +218,8 @@ bool Table::FilteredAddRow(std::vector<LivestatusRowValue>& rs, const Filter::Pt
 		rval.GroupByType = groupByType;
 		rval.GroupByObject = groupByObject;
 
-		rs.emplace_back(std::move(rval));
+		count++;
+		rowFn(rval);
 	}
 
 	return true;
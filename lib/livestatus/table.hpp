@@ -36,6 +36,7 @@ struct LivestatusRowValue {
 };
 
 typedef std::function<bool (const Value&, LivestatusGroupByType, const Object::Ptr&)> AddRowFunction;
+typedef std::function<void (const LivestatusRowValue&)> FilteredRowFunction;
 
 class Filter;
 
@@ -53,9 +54,12 @@ public:
 	virtual String GetPrefix() const = 0;
 
 	std::vector<LivestatusRowValue> FilterRows(const intrusive_ptr<Filter>& filter, int limit = -1);
+	void FilterRows(const intrusive_ptr<Filter>& filter, int limit, const FilteredRowFunction& rowFn);
 
 	void AddColumn(const String& name, const Column& column);
-	Column GetColumn(const String& name) const;
+	const Column& GetColumn(const String& name) const;
+	Value GetColumnValue(const String& name, const Value& row) const;
+	Value GetColumnValue(const Column& column, const Value& row) const;
 	std::vector<String> GetColumnNames() const;
 
 	LivestatusGroupByType GetGroupByType() const;
@@ -64,6 +68,7 @@ protected:
 	Table(LivestatusGroupByType type = LivestatusGroupByNone);
 
 	virtual void FetchRows(const AddRowFunction& addRowFn) = 0;
+	virtual void FetchCandidateRows(const AddRowFunction& addRowFn, const intrusive_ptr<Filter>& filter);
 
 	static Value ZeroAccessor(const Value&);
 	static Value OneAccessor(const Value&);
@@ -76,8 +81,9 @@ protected:
 
 private:
 	std::map<String, Column> m_Columns;
+	uint_fast64_t m_Generation;
 
-	bool FilteredAddRow(std::vector<LivestatusRowValue>& rs, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
+	bool FilteredAddRow(const FilteredRowFunction& rowFn, int& count, const intrusive_ptr<Filter>& filter, int limit, const Value& row, LivestatusGroupByType groupByType, const Object::Ptr& groupByObject);
 };
 
 }
@@ -53,7 +53,7 @@ String TimePeriodsTable::GetPrefix() const
 
 void TimePeriodsTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectsByType<TimePeriod>()) {
+	for (const TimePeriod::Ptr& tp : ConfigType::GetObjectViewByType<TimePeriod>()) {
 		if (!addRowFn(tp, LivestatusGroupByNone, Empty))
 			return;
 	}
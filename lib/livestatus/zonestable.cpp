@@ -49,7 +49,7 @@ String ZonesTable::GetPrefix() const
 
 void ZonesTable::FetchRows(const AddRowFunction& addRowFn)
 {
-	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+	for (const Zone::Ptr& zone : ConfigType::GetObjectViewByType<Zone>()) {
 		if (!addRowFn(zone, LivestatusGroupByNone, Empty))
 			return;
 	}
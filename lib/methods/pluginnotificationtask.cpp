@@ -29,18 +29,30 @@
 #include "base/utility.hpp"
 #include "base/process.hpp"
 #include "base/convert.hpp"
+#include "base/json.hpp"
+#include "base/objectlock.hpp"
 
 using namespace icinga;
 
 REGISTER_SCRIPTFUNCTION_NS(Internal, PluginNotification, &PluginNotificationTask::ScriptFunc, "notification:user:cr:itype:author:comment:resolvedMacros:useResolvedMacros");
 
 void PluginNotificationTask::ScriptFunc(const Notification::Ptr& notification,
-	const User::Ptr& user, const CheckResult::Ptr& cr, int itype,
+	const Value& user, const CheckResult::Ptr& cr, int itype,
 	const String& author, const String& comment, const Dictionary::Ptr& resolvedMacros,
 	bool useResolvedMacros)
 {
 	REQUIRE_NOT_NULL(notification);
-	REQUIRE_NOT_NULL(user);
+
+	/* Commands with batch_users receive all users at once. */
+	Array::Ptr users;
+	User::Ptr singleUser;
+
+	if (user.IsObjectType<Array>()) {
+		users = user;
+	} else {
+		singleUser = user;
+		REQUIRE_NOT_NULL(singleUser);
+	}
 
 	NotificationCommand::Ptr commandObj = notification->GetCommand();
 
@@ -58,8 +70,29 @@ void PluginNotificationTask::ScriptFunc(const Notification::Ptr& notification,
 	Service::Ptr service;
 	tie(host, service) = GetHostService(checkable);
 
+	if (users) {
+		ArrayData recipients;
+
+		{
+			ObjectLock olock(users);
+
+			for (const User::Ptr& recipient : users) {
+				recipients.emplace_back(new Dictionary({
+					{ "name", recipient->GetName() },
+					{ "display_name", recipient->GetDisplayName() },
+					{ "email", recipient->GetEmail() },
+					{ "pager", recipient->GetPager() },
+					{ "vars", recipient->GetVars() }
+				}));
+			}
+		}
+
+		notificationExtra->Set("users", JsonEncode(new Array(std::move(recipients))));
+	}
+
 	MacroProcessor::ResolverList resolvers;
-	resolvers.emplace_back("user", user);
+	if (singleUser)
+		resolvers.emplace_back("user", singleUser);
 	resolvers.emplace_back("notification", notificationExtra);
 	resolvers.emplace_back("notification", notification);
 	if (service)
@@ -37,7 +37,7 @@ class PluginNotificationTask
 {
 public:
 	static void ScriptFunc(const Notification::Ptr& notification,
-		const User::Ptr& user, const CheckResult::Ptr& cr, int itype,
+		const Value& user, const CheckResult::Ptr& cr, int itype,
 		const String& author, const String& comment,
 		const Dictionary::Ptr& resolvedMacros, bool useResolvedMacros);
 
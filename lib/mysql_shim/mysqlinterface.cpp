@@ -119,6 +119,11 @@ struct MysqlInterfaceImpl final : public MysqlInterface
 		return mysql_store_result(mysql);
 	}
 
+	MYSQL_RES *use_result(MYSQL *mysql) const override
+	{
+		return mysql_use_result(mysql);
+	}
+
 	unsigned int thread_safe() const override
 	{
 		return mysql_thread_safe();
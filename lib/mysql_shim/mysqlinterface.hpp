@@ -54,6 +54,7 @@ struct MysqlInterface
 	virtual unsigned long real_escape_string(MYSQL *mysql, char *to, const char *from, unsigned long length) const = 0;
 	virtual my_bool ssl_set(MYSQL *mysql, const char *key, const char *cert, const char *ca, const char *capath, const char *cipher) const = 0;
 	virtual MYSQL_RES *store_result(MYSQL *mysql) const = 0;
+	virtual MYSQL_RES *use_result(MYSQL *mysql) const = 0;
 	virtual unsigned int thread_safe() const = 0;
 
 protected:
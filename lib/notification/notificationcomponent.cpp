@@ -27,6 +27,8 @@
 #include "base/utility.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/convert.hpp"
 
 using namespace icinga;
 
@@ -34,17 +36,30 @@ REGISTER_TYPE(NotificationComponent);
 
 REGISTER_STATSFUNCTION(NotificationComponent, &NotificationComponent::StatsFunc);
 
-void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void NotificationComponent::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
-	for (const NotificationComponent::Ptr& notification_component : ConfigType::GetObjectsByType<NotificationComponent>()) {
-		nodes.emplace_back(notification_component->GetName(), 1); //add more stats
+	for (const NotificationComponent::Ptr& notification_component : ConfigType::GetObjectViewByType<NotificationComponent>()) {
+		unsigned long scheduled = notification_component->GetScheduledNotifications();
+
+		nodes.emplace_back(notification_component->GetName(), new Dictionary({
+			{ "scheduled_notifications", scheduled }
+		}));
+
+		perfdata->Add(new PerfdataValue("notificationcomponent_" + notification_component->GetName() + "_scheduled_notifications", Convert::ToDouble(scheduled)));
 	}
 
 	status->Set("notificationcomponent", new Dictionary(std::move(nodes)));
 }
 
+void NotificationComponent::OnConfigLoaded()
+{
+	ObjectImpl<NotificationComponent>::OnConfigLoaded();
+
+	Notification::SetMaxConcurrentNotifications(GetConcurrentNotifications());
+}
+
 /**
  * Starts the component.
  */
@@ -58,6 +73,15 @@ void NotificationComponent::Start(bool runtimeCreated)
 	Checkable::OnNotificationsRequested.connect(std::bind(&NotificationComponent::SendNotificationsHandler, this, _1,
 		_2, _3, _4, _5));
 
+	ConfigObject::OnActiveChanged.connect(std::bind(&NotificationComponent::ObjectHandler, this, _1));
+	ConfigObject::OnPausedChanged.connect(std::bind(&NotificationComponent::ObjectHandler, this, _1));
+
+	Notification::OnNextNotificationChanged.connect(std::bind(&NotificationComponent::NextNotificationChangedHandler, this, _1));
+	Notification::OnNoMoreNotificationsChanged.connect(std::bind(&NotificationComponent::NextNotificationChangedHandler, this, _1));
+
+	for (const Notification::Ptr& notification : ConfigType::GetObjectViewByType<Notification>())
+		ObjectHandler(notification);
+
 	m_NotificationTimer = new Timer();
 	m_NotificationTimer->SetInterval(5);
 	m_NotificationTimer->OnTimerExpired.connect(std::bind(&NotificationComponent::NotificationTimerHandler, this));
@@ -73,7 +97,8 @@ void NotificationComponent::Stop(bool runtimeRemoved)
 }
 
 /**
- * Periodically sends notifications.
+ * Periodically sends reminder notifications. Only notifications whose
+ * next notification timestamp has been reached are examined.
  *
  * @param - Event arguments for the timer.
  */
@@ -81,7 +106,18 @@ void NotificationComponent::NotificationTimerHandler()
 {
 	double now = Utility::GetTime();
 
-	for (const Notification::Ptr& notification : ConfigType::GetObjectsByType<Notification>()) {
+	std::vector<Notification::Ptr> notifications;
+
+	{
+		boost::mutex::scoped_lock lock(m_NotificationMutex);
+
+		NotificationScheduleInfo *nsi;
+
+		while ((nsi = static_cast<NotificationScheduleInfo *>(m_ScheduledNotifications.PopExpired(now))))
+			notifications.push_back(nsi->Object);
+	}
+
+	for (const Notification::Ptr& notification : notifications) {
 		if (!notification->IsActive())
 			continue;
 
@@ -90,14 +126,22 @@ void NotificationComponent::NotificationTimerHandler()
 
 		Checkable::Ptr checkable = notification->GetCheckable();
 
-		if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications())
+		if (!IcingaApplication::GetInstance()->GetEnableNotifications() || !checkable->GetEnableNotifications()) {
+			/* Look at the notification again once notifications might have been enabled. */
+			ScheduleNotification(notification, now + m_NotificationTimer->GetInterval());
 			continue;
+		}
 
+		/* Rescheduled once the notification is reset. */
 		if (notification->GetInterval() <= 0 && notification->GetNoMoreNotifications())
 			continue;
 
-		if (notification->GetNextNotification() > now)
+		double nextNotification = notification->GetNextNotification();
+
+		if (nextNotification > now) {
+			ScheduleNotification(notification, nextNotification);
 			continue;
+		}
 
 		bool reachable = checkable->IsReachable(DependencyNotification);
 
@@ -136,6 +180,57 @@ void NotificationComponent::NotificationTimerHandler()
 	}
 }
 
+void NotificationComponent::ObjectHandler(const ConfigObject::Ptr& object)
+{
+	Notification::Ptr notification = dynamic_pointer_cast<Notification>(object);
+
+	if (!notification)
+		return;
+
+	boost::mutex::scoped_lock lock(m_NotificationMutex);
+
+	auto it = m_Notifications.find(notification.get());
+
+	if (notification->IsActive() && !(notification->IsPaused() && GetEnableHA())) {
+		if (it != m_Notifications.end())
+			return;
+
+		NotificationScheduleInfo& nsi = m_Notifications[notification.get()];
+		nsi.Object = notification;
+		m_ScheduledNotifications.Insert(&nsi, notification->GetNextNotification());
+	} else if (it != m_Notifications.end()) {
+		m_ScheduledNotifications.Remove(&it->second);
+		m_Notifications.erase(it);
+	}
+}
+
+void NotificationComponent::NextNotificationChangedHandler(const Notification::Ptr& notification)
+{
+	ScheduleNotification(notification, notification->GetNextNotification());
+}
+
+/**
+ * (Re-)schedules a notification which is handled by this component.
+ */
+void NotificationComponent::ScheduleNotification(const Notification::Ptr& notification, double when)
+{
+	boost::mutex::scoped_lock lock(m_NotificationMutex);
+
+	auto it = m_Notifications.find(notification.get());
+
+	if (it == m_Notifications.end())
+		return;
+
+	m_ScheduledNotifications.Reschedule(&it->second, when);
+}
+
+unsigned long NotificationComponent::GetScheduledNotifications()
+{
+	boost::mutex::scoped_lock lock(m_NotificationMutex);
+
+	return m_ScheduledNotifications.GetLength();
+}
+
 /**
  * Processes icinga::SendNotifications messages.
  */
@@ -144,3 +239,11 @@ void NotificationComponent::SendNotificationsHandler(const Checkable::Ptr& check
 {
 	checkable->SendNotifications(type, cr, author, text);
 }
+
+void NotificationComponent::ValidateConcurrentNotifications(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<NotificationComponent>::ValidateConcurrentNotifications(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "concurrent_notifications" }, "Number of concurrent notifications must be greater than 0."));
+}
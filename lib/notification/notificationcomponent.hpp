@@ -24,10 +24,24 @@
 #include "icinga/service.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include "base/timerwheel.hpp"
+#include <boost/thread/mutex.hpp>
+#include <unordered_map>
 
 namespace icinga
 {
 
+/**
+ * Scheduling state for a notification. The entry is linked into the timer
+ * wheel while the notification waits for its next reminder.
+ *
+ * @ingroup notification
+ */
+struct NotificationScheduleInfo : public TimerWheelEntry
+{
+	Notification::Ptr Object;
+};
+
 /**
  * @ingroup notification
  */
@@ -39,13 +53,26 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
+	unsigned long GetScheduledNotifications();
+
+	void ValidateConcurrentNotifications(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 private:
 	Timer::Ptr m_NotificationTimer;
 
+	boost::mutex m_NotificationMutex;
+	std::unordered_map<Notification *, NotificationScheduleInfo> m_Notifications;
+	TimerWheel m_ScheduledNotifications{0.1};
+
 	void NotificationTimerHandler();
+	void ObjectHandler(const ConfigObject::Ptr& object);
+	void NextNotificationChangedHandler(const Notification::Ptr& notification);
+	void ScheduleNotification(const Notification::Ptr& notification, double when);
+
 	void SendNotificationsHandler(const Checkable::Ptr& checkable, NotificationType type,
 		const CheckResult::Ptr& cr, const String& author, const String& text);
 };
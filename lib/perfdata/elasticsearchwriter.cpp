@@ -28,12 +28,14 @@
 #include "base/tcpsocket.hpp"
 #include "base/stream.hpp"
 #include "base/base64.hpp"
+#include "base/gzip.hpp"
 #include "base/json.hpp"
 #include "base/utility.hpp"
 #include "base/networkstream.hpp"
 #include "base/perfdatavalue.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/latencyhistogram.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/scoped_array.hpp>
 #include <utility>
@@ -44,28 +46,69 @@ REGISTER_TYPE(ElasticsearchWriter);
 
 REGISTER_STATSFUNCTION(ElasticsearchWriter, &ElasticsearchWriter::StatsFunc);
 
+/* How long data points wait in the buffer until they are flushed (measured for the oldest one). */
+static LatencyHistogram l_BufferLatency("elasticsearchwriter_buffer_latency");
+
 void ElasticsearchWriter::OnConfigLoaded()
 {
 	ObjectImpl<ElasticsearchWriter>::OnConfigLoaded();
 
 	m_WorkQueue.SetName("ElasticsearchWriter, " + GetName());
+
+	for (int i = 0; i < GetBulkSenders(); i++) {
+		std::unique_ptr<BulkSender> sender(new BulkSender(GetBulkQueueSize(), std::bind(&ElasticsearchWriter::Connect, this)));
+		sender->Queue.SetName("ElasticsearchWriter, " + GetName() + ", Flush #" + Convert::ToString(i));
+		m_Senders.push_back(std::move(sender));
+	}
 }
 
 void ElasticsearchWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
-	for (const ElasticsearchWriter::Ptr& elasticsearchwriter : ConfigType::GetObjectsByType<ElasticsearchWriter>()) {
+	for (const ElasticsearchWriter::Ptr& elasticsearchwriter : ConfigType::GetObjectViewByType<ElasticsearchWriter>()) {
 		size_t workQueueItems = elasticsearchwriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = elasticsearchwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		CheckResultQueue::Ptr checkResultQueue = elasticsearchwriter->m_CheckResultQueue;
+		size_t checkResultQueueItems = checkResultQueue ? checkResultQueue->GetLength() : 0;
+		unsigned long checkResultQueueDropped = checkResultQueue ? checkResultQueue->GetDroppedResults() : 0;
+		size_t flushQueueItems = 0;
+
+		for (const auto& sender : elasticsearchwriter->m_Senders)
+			flushQueueItems += sender->Queue.GetLength();
+
+		unsigned long connects = elasticsearchwriter->m_Connects;
+		unsigned long tlsHandshakes = elasticsearchwriter->m_TlsHandshakes;
+		unsigned long documentsRetried = elasticsearchwriter->m_DocumentsRetried;
+		unsigned long documentsFailed = elasticsearchwriter->m_DocumentsFailed;
+		PerfdataSpool::Ptr spool = elasticsearchwriter->m_Spool;
+		size_t spoolSize = spool ? spool->GetSize() : 0;
+		unsigned long spoolDroppedBatches = spool ? spool->GetDroppedBatches() : 0;
 
 		nodes.emplace_back(elasticsearchwriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
-			{ "work_queue_item_rate", workQueueItemRate }
+			{ "work_queue_item_rate", workQueueItemRate },
+			{ "check_result_queue_items", checkResultQueueItems },
+			{ "check_result_queue_dropped", checkResultQueueDropped },
+			{ "flush_queue_items", flushQueueItems },
+			{ "connects", connects },
+			{ "tls_handshakes", tlsHandshakes },
+			{ "documents_retried", documentsRetried },
+			{ "documents_failed", documentsFailed },
+			{ "spool_size", spoolSize },
+			{ "spool_dropped_batches", spoolDroppedBatches }
 		}));
 
 		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_check_result_queue_items", checkResultQueueItems));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_check_result_queue_dropped", checkResultQueueDropped));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_flush_queue_items", flushQueueItems));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_connects", connects));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_tls_handshakes", tlsHandshakes));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_documents_retried", documentsRetried));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_documents_failed", documentsFailed));
+		perfdata->Add(new PerfdataValue("elasticsearchwriter_" + elasticsearchwriter->GetName() + "_spool_size", spoolSize));
 	}
 
 	status->Set("elasticsearchwriter", new Dictionary(std::move(nodes)));
@@ -82,6 +125,12 @@ void ElasticsearchWriter::Start(bool runtimeCreated)
 
 	m_WorkQueue.SetExceptionCallback(std::bind(&ElasticsearchWriter::ExceptionHandler, this, _1));
 
+	for (const auto& sender : m_Senders)
+		sender->Queue.SetExceptionCallback(std::bind(&ElasticsearchWriter::ExceptionHandler, this, _1));
+
+	if (GetEnableSpool())
+		m_Spool = new PerfdataSpool(PerfdataSpool::GetSpoolPath("ElasticsearchWriter", GetName()), GetSpoolMaxSize());
+
 	/* Setup timer for periodically flushing m_DataBuffer */
 	m_FlushTimer = new Timer();
 	m_FlushTimer->SetInterval(GetFlushInterval());
@@ -90,7 +139,8 @@ void ElasticsearchWriter::Start(bool runtimeCreated)
 	m_FlushTimer->Reschedule(0);
 
 	/* Register for new metrics. */
-	Checkable::OnNewCheckResult.connect(std::bind(&ElasticsearchWriter::CheckResultHandler, this, _1, _2));
+	m_CheckResultQueue = new CheckResultQueue(GetName(), m_WorkQueue, std::bind(&ElasticsearchWriter::CheckResultBatchHandler, this, _1));
+	m_CheckResultQueue->Start();
 	Checkable::OnStateChange.connect(std::bind(&ElasticsearchWriter::StateChangeHandler, this, _1, _2, _3));
 	Checkable::OnNotificationSentToAllUsers.connect(std::bind(&ElasticsearchWriter::NotificationSentToAllUsersHandler, this, _1, _2, _3, _4, _5, _6, _7));
 }
@@ -100,8 +150,16 @@ void ElasticsearchWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "ElasticsearchWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_CheckResultQueue)
+		m_CheckResultQueue->Stop();
+
 	m_WorkQueue.Join();
 
+	for (const auto& sender : m_Senders) {
+		sender->Queue.Join();
+		sender->Client.Close();
+	}
+
 	ObjectImpl<ElasticsearchWriter>::Stop(runtimeRemoved);
 }
 
@@ -129,25 +187,12 @@ void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Ch
 	if (!GetEnableSendPerfdata())
 		return;
 
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = cr->GetParsedPerformanceData();
 
 	if (perfdata) {
 		ObjectLock olock(perfdata);
 		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, "ElasticsearchWriter")
-						<< "Ignoring invalid perfdata value: '" << val << "' for object '"
-						<< checkable->GetName() << "'.";
-					continue;
-				}
-			}
+			PerfdataValue::Ptr pdv = val;
 
 			String escapedKey = pdv->GetLabel();
 			boost::replace_all(escapedKey, " ", "_");
@@ -174,58 +219,50 @@ void ElasticsearchWriter::AddCheckResult(const Dictionary::Ptr& fields, const Ch
 	}
 }
 
-void ElasticsearchWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void ElasticsearchWriter::CheckResultBatchHandler(const std::vector<CheckResultEvent>& events)
 {
-	m_WorkQueue.Enqueue(std::bind(&ElasticsearchWriter::InternalCheckResultHandler, this, checkable, cr));
+	for (const CheckResultEvent& event : events)
+		InternalCheckResultHandler(event.Subject, event.Result, event.Metrics);
 }
 
-void ElasticsearchWriter::InternalCheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void ElasticsearchWriter::InternalCheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics)
 {
 	AssertOnWorkQueue();
 
 	CONTEXT("Elasticwriter processing check result for '" + checkable->GetName() + "'");
 
-	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata())
+	if (!metrics->IsPerfdataEnabled())
 		return;
 
-	Host::Ptr host;
-	Service::Ptr service;
-	tie(host, service) = GetHostService(checkable);
+	const Host::Ptr& host = metrics->GetHost();
+	const Service::Ptr& service = metrics->GetService();
 
 	Dictionary::Ptr fields = new Dictionary();
 
 	if (service) {
 		fields->Set("service", service->GetShortName());
-		fields->Set("state", service->GetState());
 		fields->Set("last_state", service->GetLastState());
 		fields->Set("last_hard_state", service->GetLastHardState());
 	} else {
-		fields->Set("state", host->GetState());
 		fields->Set("last_state", host->GetLastState());
 		fields->Set("last_hard_state", host->GetLastHardState());
 	}
 
+	fields->Set("state", metrics->GetState());
 	fields->Set("host", host->GetName());
-	fields->Set("state_type", checkable->GetStateType());
+	fields->Set("state_type", metrics->GetStateType());
 
-	fields->Set("current_check_attempt", checkable->GetCheckAttempt());
-	fields->Set("max_check_attempts", checkable->GetMaxCheckAttempts());
+	fields->Set("current_check_attempt", metrics->GetCheckAttempt());
+	fields->Set("max_check_attempts", metrics->GetMaxCheckAttempts());
 
-	fields->Set("reachable", checkable->IsReachable());
+	fields->Set("reachable", metrics->IsReachable());
 
-	CheckCommand::Ptr commandObj = checkable->GetCheckCommand();
-
-	if (commandObj)
-		fields->Set("check_command", commandObj->GetName());
-
-	double ts = Utility::GetTime();
+	if (!metrics->GetCheckCommand().IsEmpty())
+		fields->Set("check_command", metrics->GetCheckCommand());
 
-	if (cr) {
-		AddCheckResult(fields, checkable, cr);
-		ts = cr->GetExecutionEnd();
-	}
+	AddCheckResult(fields, checkable, cr);
 
-	Enqueue("checkresult", fields, ts);
+	Enqueue("checkresult", fields, metrics->GetTimestamp());
 }
 
 void ElasticsearchWriter::StateChangeHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType type)
@@ -343,9 +380,6 @@ void ElasticsearchWriter::NotificationSentToAllUsersHandlerInternal(const Notifi
 
 void ElasticsearchWriter::Enqueue(const String& type, const Dictionary::Ptr& fields, double ts)
 {
-	/* Atomically buffer the data point. */
-	boost::mutex::scoped_lock lock(m_DataBufferMutex);
-
 	/* Format the timestamps to dynamically select the date datatype inside the index. */
 	fields->Set("@timestamp", FormatTimestamp(ts));
 	fields->Set("timestamp", FormatTimestamp(ts));
@@ -362,49 +396,197 @@ void ElasticsearchWriter::Enqueue(const String& type, const Dictionary::Ptr& fie
 	Log(LogDebug, "ElasticsearchWriter")
 		<< "Add to fields to message list: '" << fieldsBody << "'.";
 
-	m_DataBuffer.emplace_back(indexBody + fieldsBody);
+	String body;
 
-	/* Flush if we've buffered too much to prevent excessive memory use. */
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
-		Log(LogDebug, "ElasticsearchWriter")
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
-		Flush();
+	{
+		/* Atomically buffer the data point. */
+		boost::mutex::scoped_lock lock(m_DataBufferMutex);
+
+		if (m_DataBuffer.empty())
+			m_DataBufferSince = Utility::GetTime();
+
+		m_DataBuffer.emplace_back(indexBody + fieldsBody);
+
+		/* Flush if we've buffered too much to prevent excessive memory use. */
+		if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
+			Log(LogDebug, "ElasticsearchWriter")
+				<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+			body = Flush();
+		}
 	}
+
+	/* The sender queues are bounded, don't block other threads while waiting for them. */
+	if (!body.IsEmpty())
+		SendRequest(body);
 }
 
 void ElasticsearchWriter::FlushTimeout()
 {
-	/* Prevent new data points from being added to the array, there is a
-	 * race condition where they could disappear.
-	 */
-	boost::mutex::scoped_lock lock(m_DataBufferMutex);
+	String body;
+
+	{
+		/* Prevent new data points from being added to the array, there is a
+		 * race condition where they could disappear.
+		 */
+		boost::mutex::scoped_lock lock(m_DataBufferMutex);
+
+		/* Flush if there are any data available. */
+		if (m_DataBuffer.size() > 0) {
+			Log(LogDebug, "ElasticsearchWriter")
+				<< "Timer expired writing " << m_DataBuffer.size() << " data points";
+			body = Flush();
+		}
+	}
 
-	/* Flush if there are any data available. */
-	if (m_DataBuffer.size() > 0) {
-		Log(LogDebug, "ElasticsearchWriter")
-			<< "Timer expired writing " << m_DataBuffer.size() << " data points";
-		Flush();
+	if (!body.IsEmpty()) {
+		SendRequest(body);
+	} else if (m_Spool && !m_Spool->IsEmpty()) {
+		/* Send spooled data even if there are no new data points. */
+		BulkSender *sender = m_Senders.front().get();
+		sender->Queue.Enqueue(std::bind(&ElasticsearchWriter::DrainSpool, this, sender));
 	}
 }
 
-void ElasticsearchWriter::Flush()
+/**
+ * Builds a bulk request body from the buffered data points and clears the buffer.
+ *
+ * Note: Caller must hold m_DataBufferMutex.
+ */
+String ElasticsearchWriter::Flush()
 {
-	/* Ensure you hold a lock against m_DataBuffer so that things
-	 * don't go missing after creating the body and clearing the buffer.
-	 */
 	String body = boost::algorithm::join(m_DataBuffer, "\n");
 	m_DataBuffer.clear();
 
+	l_BufferLatency.Record(Utility::GetTime() - m_DataBufferSince);
+
 	/* Elasticsearch 6.x requires a new line. This is compatible to 5.x.
 	 * Tested with 6.0.0 and 5.6.4.
 	 */
 	body += "\n";
 
-	SendRequest(body);
+	return body;
 }
 
 void ElasticsearchWriter::SendRequest(const String& body)
 {
+	/* Pick the sender with the fewest pending requests, equally loaded
+	 * senders are used in a round-robin fashion.
+	 */
+	size_t offset = m_NextSender++;
+	BulkSender *sender = nullptr;
+	size_t senderItems = 0;
+
+	for (size_t i = 0; i < m_Senders.size(); i++) {
+		BulkSender *candidate = m_Senders[(offset + i) % m_Senders.size()].get();
+		size_t items = candidate->Queue.GetLength();
+
+		if (!sender || items < senderItems) {
+			sender = candidate;
+			senderItems = items;
+		}
+	}
+
+	/* Compressing and sending the data happens on separate queues so that
+	 * check results can be processed in the meantime.
+	 */
+	sender->Queue.Enqueue(std::bind(&ElasticsearchWriter::SendRequestWQ, this, sender, body));
+}
+
+void ElasticsearchWriter::SendRequestWQ(BulkSender *sender, const String& body)
+{
+	std::vector<String> retryDocuments;
+
+	if (!m_Spool) {
+		TransmitRequest(sender, body, &retryDocuments);
+		RequeueDocuments(retryDocuments);
+		return;
+	}
+
+	bool sent = false;
+
+	try {
+		sent = TransmitRequest(sender, body, &retryDocuments);
+	} catch (const std::exception&) {
+		/* Already logged. */
+	}
+
+	if (!sent) {
+		Log(LogWarning, "ElasticsearchWriter")
+			<< "Spooling " << body.GetLength() << " bytes of data until Elasticsearch is available again.";
+
+		boost::mutex::scoped_lock lock(m_SpoolMutex);
+		m_Spool->Append(body);
+		return;
+	}
+
+	RequeueDocuments(retryDocuments);
+
+	DrainSpool(sender);
+}
+
+/**
+ * Adds documents which Elasticsearch rejected temporarily to the buffer
+ * again. They're sent with the next flush.
+ */
+void ElasticsearchWriter::RequeueDocuments(std::vector<String>& documents)
+{
+	if (documents.empty())
+		return;
+
+	m_DocumentsRetried += documents.size();
+
+	boost::mutex::scoped_lock lock(m_DataBufferMutex);
+
+	if (m_DataBuffer.empty())
+		m_DataBufferSince = Utility::GetTime();
+
+	for (String& document : documents)
+		m_DataBuffer.emplace_back(std::move(document));
+}
+
+/**
+ * Sends spooled data after the backend became available again. At most
+ * spool_drain_rate batches are sent at a time.
+ */
+void ElasticsearchWriter::DrainSpool(BulkSender *sender)
+{
+	/* Only one sender drains the spool at a time, otherwise batches could be sent twice. */
+	boost::mutex::scoped_lock lock(m_SpoolMutex, boost::try_to_lock);
+
+	if (!lock.owns_lock())
+		return;
+
+	String batch;
+
+	for (int i = 0; i < GetSpoolDrainRate() && m_Spool->Peek(&batch); i++) {
+		std::vector<String> retryDocuments;
+
+		try {
+			if (!TransmitRequest(sender, batch, &retryDocuments))
+				return;
+		} catch (const std::exception&) {
+			return;
+		}
+
+		m_Spool->Pop();
+
+		RequeueDocuments(retryDocuments);
+	}
+}
+
+/**
+ * Sends data to Elasticsearch.
+ *
+ * @param retryDocuments Receives the documents which should be sent again.
+ * @returns false if the data should be sent again later on, true otherwise.
+ */
+bool ElasticsearchWriter::TransmitRequest(BulkSender *sender, const String& body, std::vector<String> *retryDocuments)
+{
+	String payload = body;
+
+	if (GetEnableCompression())
+		payload = Gzip::Compress(body);
+
 	Url::Ptr url = new Url();
 
 	url->SetScheme(GetEnableTls() ? "https" : "http");
@@ -428,91 +610,80 @@ void ElasticsearchWriter::SendRequest(const String& body)
 
 	url->SetPath(path);
 
-	Stream::Ptr stream;
-
-	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Flush failed, cannot connect to Elasticsearch.";
-		return;
-	}
-
-	if (!stream)
-		return;
-
-	HttpRequest req(stream);
-
-	/* Specify required headers by Elasticsearch. */
-	req.AddHeader("Accept", "application/json");
-	req.AddHeader("Content-Type", "application/json");
-
 	/* Send authentication if configured. */
 	String username = GetUsername();
 	String password = GetPassword();
 
-	if (!username.IsEmpty() && !password.IsEmpty())
-		req.AddHeader("Authorization", "Basic " + Base64::Encode(username + ":" + password));
+	bool accepted = false;
+	String error;
 
-	req.RequestMethod = "POST";
-	req.RequestUrl = url;
+	KeepAliveRequestResult result = sender->Client.SendRequest([this, &url, &username, &password](HttpRequest& req) {
+		/* Specify required headers by Elasticsearch. */
+		req.AddHeader("Accept", "application/json");
+		req.AddHeader("Content-Type", "application/json");
 
-	/* Don't log the request body to debug log, this is already done above. */
-	Log(LogDebug, "ElasticsearchWriter")
-		<< "Sending " << req.RequestMethod << " request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
-		<< " to '" << url->Format() << "'.";
+		if (GetEnableCompression())
+			req.AddHeader("Content-Encoding", "gzip");
 
-	try {
-		req.WriteBody(body.CStr(), body.GetLength());
-		req.Finish();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Cannot write to HTTP API on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw ex;
-	}
+		if (!username.IsEmpty() && !password.IsEmpty())
+			req.AddHeader("Authorization", "Basic " + Base64::Encode(username + ":" + password));
 
-	HttpResponse resp(stream, req);
-	StreamReadContext context;
+		req.RequestMethod = "POST";
+		req.RequestUrl = url;
 
-	try {
-		resp.Parse(context, true);
-		while (resp.Parse(context, true) && !resp.Complete)
-			; /* Do nothing */
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex, false);
-		throw ex;
-	}
+		/* Don't log the request body to debug log, this is already done above. */
+		Log(LogDebug, "ElasticsearchWriter")
+			<< "Sending " << req.RequestMethod << " request" << ((!username.IsEmpty() && !password.IsEmpty()) ? " with basic auth" : "" )
+			<< " to '" << url->Format() << "'.";
+	}, payload, [this, &accepted, &username, &password, &body, retryDocuments](HttpResponse& resp) {
+		/* Server errors are usually temporary, the data is sent again later on. */
+		accepted = resp.StatusCode < 500;
+
+		if (resp.StatusCode > 299) {
+			if (resp.StatusCode == 401) {
+				/* More verbose error logging with Elasticsearch is hidden behind a proxy. */
+				if (!username.IsEmpty() && !password.IsEmpty()) {
+					Log(LogCritical, "ElasticsearchWriter")
+						<< "401 Unauthorized. Please ensure that the user '" << username
+						<< "' is able to authenticate against the HTTP API/Proxy.";
+				} else {
+					Log(LogCritical, "ElasticsearchWriter")
+						<< "401 Unauthorized. The HTTP API requires authentication but no username/password has been configured.";
+				}
 
-	if (!resp.Complete) {
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Failed to read a complete HTTP response from the Elasticsearch server.";
-		return;
-	}
+				return;
+			}
+
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "Unexpected response code " << resp.StatusCode;
 
-	if (resp.StatusCode > 299) {
-		if (resp.StatusCode == 401) {
-			/* More verbose error logging with Elasticsearch is hidden behind a proxy. */
-			if (!username.IsEmpty() && !password.IsEmpty()) {
-				Log(LogCritical, "ElasticsearchWriter")
-					<< "401 Unauthorized. Please ensure that the user '" << username
-					<< "' is able to authenticate against the HTTP API/Proxy.";
-			} else {
-				Log(LogCritical, "ElasticsearchWriter")
-					<< "401 Unauthorized. The HTTP API requires authentication but no username/password has been configured.";
+			String contentType = resp.Headers->Get("content-type");
+
+			if (contentType != "application/json") {
+				Log(LogWarning, "ElasticsearchWriter")
+					<< "Unexpected Content-Type: " << contentType;
+				return;
 			}
 
-			return;
-		}
+			size_t responseSize = resp.GetBodySize();
+			boost::scoped_array<char> buffer(new char[responseSize + 1]);
+			resp.ReadBody(buffer.get(), responseSize);
+			buffer.get()[responseSize] = '\0';
+
+			Dictionary::Ptr jsonResponse;
+			try {
+				jsonResponse = JsonDecode(buffer.get());
+			} catch (...) {
+				Log(LogWarning, "ElasticsearchWriter")
+					<< "Unable to parse JSON response:\n" << buffer.get();
+				return;
+			}
 
-		Log(LogWarning, "ElasticsearchWriter")
-			<< "Unexpected response code " << resp.StatusCode;
+			String error = jsonResponse->Get("error");
 
-		String contentType = resp.Headers->Get("content-type");
+			Log(LogCritical, "ElasticsearchWriter")
+				<< "Elasticsearch error message:\n" << error;
 
-		if (contentType != "application/json") {
-			Log(LogWarning, "ElasticsearchWriter")
-				<< "Unexpected Content-Type: " << contentType;
 			return;
 		}
 
@@ -521,21 +692,118 @@ void ElasticsearchWriter::SendRequest(const String& body)
 		resp.ReadBody(buffer.get(), responseSize);
 		buffer.get()[responseSize] = '\0';
 
-		Dictionary::Ptr jsonResponse;
-		try {
-			jsonResponse = JsonDecode(buffer.get());
-		} catch (...) {
+		ProcessBulkResponse(buffer.get(), body, retryDocuments);
+	}, &error);
+
+	switch (result) {
+		case KeepAliveConnectFailed:
 			Log(LogWarning, "ElasticsearchWriter")
-				<< "Unable to parse JSON response:\n" << buffer.get();
-			return;
-		}
+				<< "Flush failed, cannot connect to Elasticsearch.";
+			return false;
+		case KeepAliveWriteFailed:
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "Cannot write to HTTP API on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot write to Elasticsearch."));
+		case KeepAliveReadFailed:
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << error;
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot read the Elasticsearch response."));
+		case KeepAliveResponseIncomplete:
+			Log(LogWarning, "ElasticsearchWriter")
+				<< "Failed to read a complete HTTP response from the Elasticsearch server.";
+			return false;
+		default:
+			return accepted;
+	}
+}
+
+/**
+ * Checks the results for the individual documents of a bulk request. The
+ * items in the response are in the same order as the documents in the request.
+ * Documents which were rejected because of a temporary condition (e.g. a full
+ * bulk queue on the Elasticsearch node) are sent again, others are dropped.
+ */
+void ElasticsearchWriter::ProcessBulkResponse(const String& response, const String& body, std::vector<String> *retryDocuments)
+{
+	/* Don't decode the response if all documents were indexed. */
+	if (response.Find("\"errors\":true") == String::NPos)
+		return;
 
-		String error = jsonResponse->Get("error");
+	Dictionary::Ptr jsonResponse;
+	Array::Ptr items;
 
-		Log(LogCritical, "ElasticsearchWriter")
-			<< "Elasticsearch error message:\n" << error;
+	try {
+		jsonResponse = JsonDecode(response);
+		items = jsonResponse->Get("items");
+	} catch (...) {
+		Log(LogWarning, "ElasticsearchWriter")
+			<< "Unable to parse bulk response:\n" << response;
+		return;
+	}
 
+	if (!items)
 		return;
+
+	/* Each document consists of the action line and the source line. */
+	std::vector<String> documents;
+	String::SizeType start = 0;
+
+	for (;;) {
+		String::SizeType actionEnd = body.Find("\n", start);
+
+		if (actionEnd == String::NPos)
+			break;
+
+		String::SizeType sourceEnd = body.Find("\n", actionEnd + 1);
+
+		if (sourceEnd == String::NPos)
+			break;
+
+		documents.emplace_back(body.SubStr(start, sourceEnd - start));
+		start = sourceEnd + 1;
+	}
+
+	size_t failed = 0;
+	String error;
+
+	ObjectLock olock(items);
+
+	size_t index = 0;
+
+	for (const Value& item : items) {
+		if (index >= documents.size())
+			break;
+
+		Dictionary::Ptr result;
+
+		if (item.IsObjectType<Dictionary>())
+			result = static_cast<Dictionary::Ptr>(item)->Get("index");
+
+		if (result) {
+			double status = result->Get("status");
+
+			if (status == 429 || status >= 500) {
+				retryDocuments->emplace_back(std::move(documents[index]));
+			} else if (status > 299) {
+				failed++;
+				error = JsonEncode(result->Get("error"));
+			}
+		}
+
+		index++;
+	}
+
+	if (failed > 0) {
+		m_DocumentsFailed += failed;
+
+		Log(LogWarning, "ElasticsearchWriter")
+			<< "Elasticsearch rejected " << failed << " of " << documents.size() << " documents, last error: " << error;
+	}
+
+	if (!retryDocuments->empty()) {
+		Log(LogNotice, "ElasticsearchWriter")
+			<< "Elasticsearch temporarily rejected " << retryDocuments->size() << " of " << documents.size()
+			<< " documents, sending them again.";
 	}
 }
 
@@ -554,6 +822,8 @@ Stream::Ptr ElasticsearchWriter::Connect()
 		throw ex;
 	}
 
+	m_Connects++;
+
 	if (GetEnableTls()) {
 		std::shared_ptr<SSL_CTX> sslContext;
 
@@ -575,6 +845,8 @@ Stream::Ptr ElasticsearchWriter::Connect()
 			throw ex;
 		}
 
+		m_TlsHandshakes++;
+
 		return tlsStream;
 	} else {
 		return new NetworkStream(socket);
@@ -611,3 +883,27 @@ String ElasticsearchWriter::FormatTimestamp(double ts)
 
 	return Utility::FormatDateTime("%Y-%m-%dT%H:%M:%S", ts) + "." + Convert::ToString(milliSeconds) + Utility::FormatDateTime("%z", ts);
 }
+
+void ElasticsearchWriter::ValidateEnableCompression(const Lazy<bool>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ElasticsearchWriter>::ValidateEnableCompression(lvalue, utils);
+
+	if (lvalue() && !Gzip::IsSupported())
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "enable_compression" }, "Compression is not supported by this build (zlib is missing)."));
+}
+
+void ElasticsearchWriter::ValidateBulkSenders(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ElasticsearchWriter>::ValidateBulkSenders(lvalue, utils);
+
+	if (lvalue() < 1 || lvalue() > 32)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "bulk_senders" }, "Number of bulk senders must be between 1 and 32."));
+}
+
+void ElasticsearchWriter::ValidateBulkQueueSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ElasticsearchWriter>::ValidateBulkQueueSize(lvalue, utils);
+
+	if (lvalue() < 1)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "bulk_queue_size" }, "Bulk queue size must be greater than 0."));
+}
@@ -21,10 +21,15 @@
 #define ELASTICSEARCHWRITER_H
 
 #include "perfdata/elasticsearchwriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
+#include "perfdata/keepalivehttpclient.hpp"
 #include "icinga/service.hpp"
+#include "icinga/checkresultqueue.hpp"
 #include "base/configobject.hpp"
 #include "base/workqueue.hpp"
 #include "base/timer.hpp"
+#include <atomic>
+#include <memory>
 
 namespace icinga
 {
@@ -39,24 +44,52 @@ public:
 
 	static String FormatTimestamp(double ts);
 
+	void ValidateEnableCompression(const Lazy<bool>& lvalue, const ValidationUtils& utils) override;
+	void ValidateBulkSenders(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateBulkQueueSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
 private:
+	/**
+	 * Sends bulk requests over its own connection. Each sender has a
+	 * bounded queue which limits the number of pending requests.
+	 */
+	struct BulkSender
+	{
+		WorkQueue Queue;
+		KeepAliveHttpClient Client;
+
+		BulkSender(size_t maxItems, KeepAliveHttpClient::ConnectCallback connect)
+			: Queue(maxItems, 1), Client(std::move(connect))
+		{ }
+	};
+
 	String m_EventPrefix;
 	WorkQueue m_WorkQueue{10000000, 1};
+	CheckResultQueue::Ptr m_CheckResultQueue;
+	std::vector<std::unique_ptr<BulkSender> > m_Senders;
+	std::atomic<size_t> m_NextSender{0};
+	std::atomic<unsigned long> m_Connects{0};
+	std::atomic<unsigned long> m_TlsHandshakes{0};
+	std::atomic<unsigned long> m_DocumentsRetried{0};
+	std::atomic<unsigned long> m_DocumentsFailed{0};
+	PerfdataSpool::Ptr m_Spool;
+	boost::mutex m_SpoolMutex;
 	Timer::Ptr m_FlushTimer;
 	std::vector<String> m_DataBuffer;
+	double m_DataBufferSince{0};
 	boost::mutex m_DataBufferMutex;
 
 	void AddCheckResult(const Dictionary::Ptr& fields, const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 
 	void StateChangeHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType type);
 	void StateChangeHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, StateType type);
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void InternalCheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultBatchHandler(const std::vector<CheckResultEvent>& events);
+	void InternalCheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics);
 	void NotificationSentToAllUsersHandler(const Notification::Ptr& notification,
 		const Checkable::Ptr& checkable, const std::set<User::Ptr>& users, NotificationType type,
 		const CheckResult::Ptr& cr, const String& author, const String& text);
@@ -70,8 +103,13 @@ private:
 	void AssertOnWorkQueue();
 	void ExceptionHandler(boost::exception_ptr exp);
 	void FlushTimeout();
-	void Flush();
+	String Flush();
 	void SendRequest(const String& body);
+	void SendRequestWQ(BulkSender *sender, const String& body);
+	bool TransmitRequest(BulkSender *sender, const String& body, std::vector<String> *retryDocuments);
+	void ProcessBulkResponse(const String& response, const String& body, std::vector<String> *retryDocuments);
+	void RequeueDocuments(std::vector<String>& documents);
+	void DrainSpool(BulkSender *sender);
 };
 
 }
@@ -25,6 +25,8 @@
 #include "icinga/macroprocessor.hpp"
 #include "icinga/compatutility.hpp"
 #include "base/tcpsocket.hpp"
+#include "base/udpsocket.hpp"
+#include "base/gzip.hpp"
 #include "base/configtype.hpp"
 #include "base/objectlock.hpp"
 #include "base/logger.hpp"
@@ -38,6 +40,7 @@
 #include "base/json.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string/replace.hpp>
+#include <algorithm>
 #include <utility>
 
 using namespace icinga;
@@ -46,6 +49,13 @@ REGISTER_TYPE(GelfWriter);
 
 REGISTER_STATSFUNCTION(GelfWriter, &GelfWriter::StatsFunc);
 
+/* Messages are coalesced into writes of up to this size in TCP mode. */
+static const size_t l_GelfSendBufferSize = 64 * 1024;
+
+/* Chunked GELF: magic bytes, 8 byte message ID, sequence number and sequence count. */
+static const size_t l_GelfChunkHeaderSize = 12;
+static const size_t l_GelfMaxChunks = 128;
+
 void GelfWriter::OnConfigLoaded()
 {
 	ObjectImpl<GelfWriter>::OnConfigLoaded();
@@ -57,19 +67,26 @@ void GelfWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perf
 {
 	DictionaryData nodes;
 
-	for (const GelfWriter::Ptr& gelfwriter : ConfigType::GetObjectsByType<GelfWriter>()) {
+	for (const GelfWriter::Ptr& gelfwriter : ConfigType::GetObjectViewByType<GelfWriter>()) {
 		size_t workQueueItems = gelfwriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = gelfwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		CheckResultQueue::Ptr checkResultQueue = gelfwriter->m_CheckResultQueue;
+		size_t checkResultQueueItems = checkResultQueue ? checkResultQueue->GetLength() : 0;
+		unsigned long checkResultQueueDropped = checkResultQueue ? checkResultQueue->GetDroppedResults() : 0;
 
 		nodes.emplace_back(gelfwriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
+			{ "check_result_queue_items", checkResultQueueItems },
+			{ "check_result_queue_dropped", checkResultQueueDropped },
 			{ "connected", gelfwriter->GetConnected() },
 			{ "source", gelfwriter->GetSource() }
 		}));
 
 		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_check_result_queue_items", checkResultQueueItems));
+		perfdata->Add(new PerfdataValue("gelfwriter_" + gelfwriter->GetName() + "_check_result_queue_dropped", checkResultQueueDropped));
 	}
 
 	status->Set("gelfwriter", new Dictionary(std::move(nodes)));
@@ -85,15 +102,20 @@ void GelfWriter::Start(bool runtimeCreated)
 	/* Register exception handler for WQ tasks. */
 	m_WorkQueue.SetExceptionCallback(std::bind(&GelfWriter::ExceptionHandler, this, _1));
 
+	/* Chunked message IDs only need to be unique per sender for a few seconds. */
+	m_NextMessageId = static_cast<uint64_t>(Utility::GetTime() * 1000 * 1000);
+
 	/* Timer for reconnecting */
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
+	m_ReconnectTimer->SetSlack(1);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&GelfWriter::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
 	/* Register event handlers. */
-	Checkable::OnNewCheckResult.connect(std::bind(&GelfWriter::CheckResultHandler, this, _1, _2));
+	m_CheckResultQueue = new CheckResultQueue(GetName(), m_WorkQueue, std::bind(&GelfWriter::CheckResultBatchHandler, this, _1));
+	m_CheckResultQueue->Start();
 	Checkable::OnNotificationSentToUser.connect(std::bind(&GelfWriter::NotificationToUserHandler, this, _1, _2, _3, _4, _5, _6, _7, _8));
 	Checkable::OnStateChange.connect(std::bind(&GelfWriter::StateChangeHandler, this, _1, _2, _3));
 }
@@ -103,6 +125,10 @@ void GelfWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "GelfWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_CheckResultQueue)
+		m_CheckResultQueue->Stop();
+
+	m_WorkQueue.Enqueue(std::bind(&GelfWriter::FlushSendBuffer, this), PriorityLow);
 	m_WorkQueue.Join();
 
 	ObjectImpl<GelfWriter>::Stop(runtimeRemoved);
@@ -120,11 +146,7 @@ void GelfWriter::ExceptionHandler(boost::exception_ptr exp)
 	Log(LogDebug, "GelfWriter")
 		<< "Exception during Graylog Gelf operation: " << DiagnosticInformation(std::move(exp));
 
-	if (GetConnected()) {
-		m_Stream->Close();
-
-		SetConnected(false);
-	}
+	CloseConnection();
 }
 
 void GelfWriter::Reconnect()
@@ -140,21 +162,26 @@ void GelfWriter::Reconnect()
 	if (GetConnected())
 		return;
 
-	TcpSocket::Ptr socket = new TcpSocket();
-
 	Log(LogNotice, "GelfWriter")
-		<< "Reconnecting to Graylog Gelf on host '" << GetHost() << "' port '" << GetPort() << "'.";
+		<< "Reconnecting to Graylog Gelf on host '" << GetHost() << "' port '" << GetPort()
+		<< "' (" << GetTransport() << ").";
 
 	try {
-		socket->Connect(GetHost(), GetPort());
+		if (GetTransport() == "udp") {
+			UdpSocket::Ptr socket = new UdpSocket();
+			socket->Connect(GetHost(), GetPort());
+			m_UdpSocket = socket;
+		} else {
+			TcpSocket::Ptr socket = new TcpSocket();
+			socket->Connect(GetHost(), GetPort());
+			m_Stream = new NetworkStream(socket);
+		}
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GelfWriter")
 			<< "Can't connect to Graylog Gelf on host '" << GetHost() << "' port '" << GetPort() << "'.";
 		throw ex;
 	}
 
-	m_Stream = new NetworkStream(socket);
-
 	SetConnected(true);
 
 	Log(LogInformation, "GelfWriter")
@@ -170,20 +197,38 @@ void GelfWriter::Disconnect()
 {
 	AssertOnWorkQueue();
 
+	FlushSendBuffer();
+	CloseConnection();
+}
+
+void GelfWriter::CloseConnection()
+{
+	/* Pending messages are dropped, just like messages sent while disconnected. */
+	m_SendBuffer.clear();
+
 	if (!GetConnected())
 		return;
 
-	m_Stream->Close();
+	if (m_UdpSocket) {
+		m_UdpSocket->Close();
+		m_UdpSocket.reset();
+	}
+
+	if (m_Stream) {
+		m_Stream->Close();
+		m_Stream.reset();
+	}
 
 	SetConnected(false);
 }
 
-void GelfWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GelfWriter::CheckResultBatchHandler(const std::vector<CheckResultEvent>& events)
 {
-	m_WorkQueue.Enqueue(std::bind(&GelfWriter::CheckResultHandlerInternal, this, checkable, cr));
+	for (const CheckResultEvent& event : events)
+		CheckResultHandlerInternal(event.Subject, event.Result, event.Metrics);
 }
 
-void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics)
 {
 	AssertOnWorkQueue();
 
@@ -192,15 +237,18 @@ void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, con
 	Log(LogDebug, "GelfWriter")
 		<< "Processing check result for '" << checkable->GetName() << "'";
 
-	Host::Ptr host;
-	Service::Ptr service;
-	tie(host, service) = GetHostService(checkable);
+	const Host::Ptr& host = metrics->GetHost();
+	const Service::Ptr& service = metrics->GetService();
 
 	Dictionary::Ptr fields = new Dictionary();
 
+	String state = service
+		? Service::StateToString(static_cast<ServiceState>(metrics->GetState()))
+		: Host::StateToString(static_cast<HostState>(metrics->GetState()));
+
 	if (service) {
 		fields->Set("_service_name", service->GetShortName());
-		fields->Set("_service_state", Service::StateToString(service->GetState()));
+		fields->Set("_service_state", state);
 		fields->Set("_last_state", service->GetLastState());
 		fields->Set("_last_hard_state", service->GetLastHardState());
 	} else {
@@ -210,49 +258,31 @@ void GelfWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, con
 
 	fields->Set("_hostname", host->GetName());
 	fields->Set("_type", "CHECK RESULT");
-	fields->Set("_state", service ? Service::StateToString(service->GetState()) : Host::StateToString(host->GetState()));
+	fields->Set("_state", state);
 
-	fields->Set("_current_check_attempt", checkable->GetCheckAttempt());
-	fields->Set("_max_check_attempts", checkable->GetMaxCheckAttempts());
+	fields->Set("_current_check_attempt", metrics->GetCheckAttempt());
+	fields->Set("_max_check_attempts", metrics->GetMaxCheckAttempts());
 
-	fields->Set("_reachable", checkable->IsReachable());
+	fields->Set("_reachable", metrics->IsReachable());
 
-	CheckCommand::Ptr commandObj = checkable->GetCheckCommand();
+	if (!metrics->GetCheckCommand().IsEmpty())
+		fields->Set("_check_command", metrics->GetCheckCommand());
 
-	if (commandObj)
-		fields->Set("_check_command", commandObj->GetName());
-
-	double ts = Utility::GetTime();
+	fields->Set("_latency", metrics->GetLatency());
+	fields->Set("_execution_time", metrics->GetExecutionTime());
+	fields->Set("short_message", CompatUtility::GetCheckResultOutput(cr));
+	fields->Set("full_message", cr->GetOutput());
+	fields->Set("_check_source", cr->GetCheckSource());
 
-	if (cr) {
-		fields->Set("_latency", cr->CalculateLatency());
-		fields->Set("_execution_time", cr->CalculateExecutionTime());
-		fields->Set("short_message", CompatUtility::GetCheckResultOutput(cr));
-		fields->Set("full_message", cr->GetOutput());
-		fields->Set("_check_source", cr->GetCheckSource());
-		ts = cr->GetExecutionEnd();
-	}
+	double ts = metrics->GetTimestamp();
 
-	if (cr && GetEnableSendPerfdata()) {
-		Array::Ptr perfdata = cr->GetPerformanceData();
+	if (GetEnableSendPerfdata()) {
+		Array::Ptr perfdata = metrics->GetPerfdata();
 
 		if (perfdata) {
 			ObjectLock olock(perfdata);
 			for (const Value& val : perfdata) {
-				PerfdataValue::Ptr pdv;
-
-				if (val.IsObjectType<PerfdataValue>())
-					pdv = val;
-				else {
-					try {
-						pdv = PerfdataValue::Parse(val);
-					} catch (const std::exception&) {
-						Log(LogWarning, "GelfWriter")
-							<< "Ignoring invalid perfdata value: '" << val << "' for object '"
-							<< checkable->GetName() << "'.";
-						continue;
-					}
-				}
+				PerfdataValue::Ptr pdv = val;
 
 				String escaped_key = pdv->GetLabel();
 				boost::replace_all(escaped_key, " ", "_");
@@ -410,22 +440,48 @@ String GelfWriter::ComposeGelfMessage(const Dictionary::Ptr& fields, const Strin
 
 void GelfWriter::SendLogMessage(const String& gelfMessage)
 {
-	std::ostringstream msgbuf;
-	msgbuf << gelfMessage;
-	msgbuf << '\0';
+	AssertOnWorkQueue();
 
-	String log = msgbuf.str();
+	if (!GetConnected())
+		return;
 
-	ObjectLock olock(this);
+	Log(LogDebug, "GelfWriter")
+		<< "Sending '" << gelfMessage << "'.";
 
-	if (!GetConnected())
+	if (m_UdpSocket) {
+		SendDatagram(gelfMessage);
 		return;
+	}
 
-	try {
-		Log(LogDebug, "GelfWriter")
-			<< "Sending '" << log << "'.";
+	/* Messages are null-delimited on TCP streams. Instead of writing each of
+	 * them separately they're buffered and flushed by a low priority task,
+	 * which runs once the queued events have been processed.
+	 */
+	m_SendBuffer.append(gelfMessage.CStr(), gelfMessage.GetLength());
+	m_SendBuffer.push_back('\0');
+
+	if (m_SendBuffer.size() >= l_GelfSendBufferSize) {
+		FlushSendBuffer();
+	} else if (!m_FlushPending) {
+		m_FlushPending = true;
+		m_WorkQueue.Enqueue(std::bind(&GelfWriter::FlushSendBuffer, this), PriorityLow);
+	}
+}
+
+void GelfWriter::FlushSendBuffer()
+{
+	AssertOnWorkQueue();
+
+	m_FlushPending = false;
 
-		m_Stream->Write(log.CStr(), log.GetLength());
+	if (m_SendBuffer.empty() || !GetConnected())
+		return;
+
+	std::string buffer;
+	buffer.swap(m_SendBuffer);
+
+	try {
+		m_Stream->Write(buffer.c_str(), buffer.size());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GelfWriter")
 			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
@@ -433,3 +489,75 @@ void GelfWriter::SendLogMessage(const String& gelfMessage)
 		throw ex;
 	}
 }
+
+void GelfWriter::SendDatagram(const String& gelfMessage)
+{
+	String payload = GetEnableCompression() ? Gzip::Compress(gelfMessage) : gelfMessage;
+	size_t chunkSize = GetChunkSize();
+
+	try {
+		if (payload.GetLength() <= chunkSize) {
+			m_UdpSocket->Write(payload.CStr(), payload.GetLength());
+			return;
+		}
+
+		size_t dataSize = chunkSize - l_GelfChunkHeaderSize;
+		size_t count = (payload.GetLength() + dataSize - 1) / dataSize;
+
+		if (count > l_GelfMaxChunks) {
+			Log(LogWarning, "GelfWriter")
+				<< "Dropping GELF message of " << payload.GetLength() << " bytes: It would need "
+				<< count << " chunks, but at most " << l_GelfMaxChunks << " are allowed.";
+			return;
+		}
+
+		uint64_t messageId = m_NextMessageId++;
+
+		std::string chunk;
+		chunk.reserve(chunkSize);
+
+		for (size_t i = 0; i < count; i++) {
+			chunk.assign("\x1e\x0f", 2);
+
+			for (int shift = 56; shift >= 0; shift -= 8)
+				chunk.push_back(static_cast<char>((messageId >> shift) & 0xff));
+
+			chunk.push_back(static_cast<char>(i));
+			chunk.push_back(static_cast<char>(count));
+
+			size_t offset = i * dataSize;
+			chunk.append(payload.CStr() + offset, std::min(dataSize, payload.GetLength() - offset));
+
+			m_UdpSocket->Write(chunk.c_str(), chunk.size());
+		}
+	} catch (const std::exception& ex) {
+		Log(LogCritical, "GelfWriter")
+			<< "Cannot write to UDP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+
+		throw ex;
+	}
+}
+
+void GelfWriter::ValidateTransport(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<GelfWriter>::ValidateTransport(lvalue, utils);
+
+	if (lvalue() != "tcp" && lvalue() != "udp")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "transport" }, "Transport must be 'tcp' or 'udp'."));
+}
+
+void GelfWriter::ValidateEnableCompression(const Lazy<bool>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<GelfWriter>::ValidateEnableCompression(lvalue, utils);
+
+	if (lvalue() && !Gzip::IsSupported())
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "enable_compression" }, "Compression is not supported by this build (zlib is missing)."));
+}
+
+void GelfWriter::ValidateChunkSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<GelfWriter>::ValidateChunkSize(lvalue, utils);
+
+	if (lvalue() < 128 || lvalue() > 65507)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "chunk_size" }, "Chunk size must be between 128 and 65507 bytes."));
+}
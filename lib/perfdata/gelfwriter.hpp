@@ -22,8 +22,10 @@
 
 #include "perfdata/gelfwriter-ti.hpp"
 #include "icinga/service.hpp"
+#include "icinga/checkresultqueue.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
+#include "base/udpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include <fstream>
@@ -44,6 +46,10 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void ValidateTransport(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateEnableCompression(const Lazy<bool>& lvalue, const ValidationUtils& utils) override;
+	void ValidateChunkSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+
 protected:
 	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
@@ -51,12 +57,17 @@ protected:
 
 private:
 	Stream::Ptr m_Stream;
+	UdpSocket::Ptr m_UdpSocket;
+	std::string m_SendBuffer;
+	bool m_FlushPending{false};
+	uint64_t m_NextMessageId{0};
 	WorkQueue m_WorkQueue{10000000, 1};
+	CheckResultQueue::Ptr m_CheckResultQueue;
 
 	Timer::Ptr m_ReconnectTimer;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	void CheckResultBatchHandler(const std::vector<CheckResultEvent>& events);
+	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics);
 	void NotificationToUserHandler(const Notification::Ptr& notification, const Checkable::Ptr& checkable,
 		const User::Ptr& user, NotificationType notificationType, const CheckResult::Ptr& cr,
 		const String& author, const String& commentText, const String& commandName);
@@ -68,11 +79,14 @@ private:
 
 	String ComposeGelfMessage(const Dictionary::Ptr& fields, const String& source, double ts);
 	void SendLogMessage(const String& gelfMessage);
+	void SendDatagram(const String& gelfMessage);
+	void FlushSendBuffer();
 
 	void ReconnectTimerHandler();
 
 	void Disconnect();
 	void Reconnect();
+	void CloseConnection();
 
 	void AssertOnWorkQueue();
 
@@ -34,9 +34,11 @@
 #include "base/networkstream.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/latencyhistogram.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <utility>
+#include <algorithm>
 
 using namespace icinga;
 
@@ -44,6 +46,9 @@ REGISTER_TYPE(GraphiteWriter);
 
 REGISTER_STATSFUNCTION(GraphiteWriter, &GraphiteWriter::StatsFunc);
 
+/* How long data points wait in the buffer until they are flushed (measured for the oldest one). */
+static LatencyHistogram l_BufferLatency("graphitewriter_buffer_latency");
+
 void GraphiteWriter::OnConfigLoaded()
 {
 	ObjectImpl<GraphiteWriter>::OnConfigLoaded();
@@ -55,18 +60,37 @@ void GraphiteWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&
 {
 	DictionaryData nodes;
 
-	for (const GraphiteWriter::Ptr& graphitewriter : ConfigType::GetObjectsByType<GraphiteWriter>()) {
+	for (const GraphiteWriter::Ptr& graphitewriter : ConfigType::GetObjectViewByType<GraphiteWriter>()) {
 		size_t workQueueItems = graphitewriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = graphitewriter->m_WorkQueue.GetTaskCount(60) / 60.0;
+		CheckResultQueue::Ptr checkResultQueue = graphitewriter->m_CheckResultQueue;
+		size_t checkResultQueueItems = checkResultQueue ? checkResultQueue->GetLength() : 0;
+		unsigned long checkResultQueueDropped = checkResultQueue ? checkResultQueue->GetDroppedResults() : 0;
+		size_t sendBufferBytes = graphitewriter->m_SendBufferSize;
+		double flushDuration = graphitewriter->m_LastFlushDuration;
+		PerfdataSpool::Ptr spool = graphitewriter->m_Spool;
+		size_t spoolSize = spool ? spool->GetSize() : 0;
+		unsigned long spoolDroppedBatches = spool ? spool->GetDroppedBatches() : 0;
 
 		nodes.emplace_back(graphitewriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
-			{ "connected", graphitewriter->GetConnected() }
+			{ "check_result_queue_items", checkResultQueueItems },
+			{ "check_result_queue_dropped", checkResultQueueDropped },
+			{ "send_buffer_bytes", sendBufferBytes },
+			{ "flush_duration", flushDuration },
+			{ "connected", graphitewriter->GetConnected() },
+			{ "spool_size", spoolSize },
+			{ "spool_dropped_batches", spoolDroppedBatches }
 		}));
 
 		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_check_result_queue_items", checkResultQueueItems));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_check_result_queue_dropped", checkResultQueueDropped));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_send_buffer_bytes", sendBufferBytes));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_flush_duration", flushDuration));
+		perfdata->Add(new PerfdataValue("graphitewriter_" + graphitewriter->GetName() + "_spool_size", spoolSize));
 	}
 
 	status->Set("graphitewriter", new Dictionary(std::move(nodes)));
@@ -82,15 +106,26 @@ void GraphiteWriter::Start(bool runtimeCreated)
 	/* Register exception handler for WQ tasks. */
 	m_WorkQueue.SetExceptionCallback(std::bind(&GraphiteWriter::ExceptionHandler, this, _1));
 
+	if (GetEnableSpool())
+		m_Spool = new PerfdataSpool(PerfdataSpool::GetSpoolPath("GraphiteWriter", GetName()), GetSpoolMaxSize());
+
 	/* Timer for reconnecting */
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->SetInterval(10);
+	m_ReconnectTimer->SetSlack(1);
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&GraphiteWriter::ReconnectTimerHandler, this));
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
+	/* Timer for periodically flushing m_SendBuffer */
+	m_FlushTimer = new Timer();
+	m_FlushTimer->SetInterval(GetFlushInterval());
+	m_FlushTimer->OnTimerExpired.connect(std::bind(&GraphiteWriter::FlushTimeout, this));
+	m_FlushTimer->Start();
+
 	/* Register event handlers. */
-	Checkable::OnNewCheckResult.connect(std::bind(&GraphiteWriter::CheckResultHandler, this, _1, _2));
+	m_CheckResultQueue = new CheckResultQueue(GetName(), m_WorkQueue, std::bind(&GraphiteWriter::CheckResultBatchHandler, this, _1));
+	m_CheckResultQueue->Start();
 }
 
 void GraphiteWriter::Stop(bool runtimeRemoved)
@@ -98,6 +133,10 @@ void GraphiteWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "GraphiteWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_CheckResultQueue)
+		m_CheckResultQueue->Stop();
+
+	m_WorkQueue.Enqueue(std::bind(&GraphiteWriter::Flush, this), PriorityHigh);
 	m_WorkQueue.Join();
 
 	ObjectImpl<GraphiteWriter>::Stop(runtimeRemoved);
@@ -168,28 +207,30 @@ void GraphiteWriter::Disconnect()
 	if (!GetConnected())
 		return;
 
+	Flush();
+
 	m_Stream->Close();
 
 	SetConnected(false);
 }
 
-void GraphiteWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GraphiteWriter::CheckResultBatchHandler(const std::vector<CheckResultEvent>& events)
 {
-	m_WorkQueue.Enqueue(std::bind(&GraphiteWriter::CheckResultHandlerInternal, this, checkable, cr));
+	for (const CheckResultEvent& event : events)
+		CheckResultHandlerInternal(event.Subject, event.Result, event.Metrics);
 }
 
-void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics)
 {
 	AssertOnWorkQueue();
 
 	CONTEXT("Processing check result for '" + checkable->GetName() + "'");
 
-	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata())
+	if (!metrics->IsPerfdataEnabled())
 		return;
 
-	Host::Ptr host;
-	Service::Ptr service;
-	tie(host, service) = GetHostService(checkable);
+	const Host::Ptr& host = metrics->GetHost();
+	const Service::Ptr& service = metrics->GetService();
 
 	MacroProcessor::ResolverList resolvers;
 	if (service)
@@ -208,50 +249,37 @@ void GraphiteWriter::CheckResultHandlerInternal(const Checkable::Ptr& checkable,
 	String prefixPerfdata = prefix + ".perfdata";
 	String prefixMetadata = prefix + ".metadata";
 
-	double ts = cr->GetExecutionEnd();
+	double ts = metrics->GetTimestamp();
 
 	if (GetEnableSendMetadata()) {
-		if (service) {
-			SendMetric(prefixMetadata, "state", service->GetState(), ts);
-		} else {
-			SendMetric(prefixMetadata, "state", host->GetState(), ts);
-		}
-
-		SendMetric(prefixMetadata, "current_attempt", checkable->GetCheckAttempt(), ts);
-		SendMetric(prefixMetadata, "max_check_attempts", checkable->GetMaxCheckAttempts(), ts);
-		SendMetric(prefixMetadata, "state_type", checkable->GetStateType(), ts);
-		SendMetric(prefixMetadata, "reachable", checkable->IsReachable(), ts);
-		SendMetric(prefixMetadata, "downtime_depth", checkable->GetDowntimeDepth(), ts);
-		SendMetric(prefixMetadata, "acknowledgement", checkable->GetAcknowledgement(), ts);
-		SendMetric(prefixMetadata, "latency", cr->CalculateLatency(), ts);
-		SendMetric(prefixMetadata, "execution_time", cr->CalculateExecutionTime(), ts);
+		SendMetric(prefixMetadata, "state", metrics->GetState(), ts);
+		SendMetric(prefixMetadata, "current_attempt", metrics->GetCheckAttempt(), ts);
+		SendMetric(prefixMetadata, "max_check_attempts", metrics->GetMaxCheckAttempts(), ts);
+		SendMetric(prefixMetadata, "state_type", metrics->GetStateType(), ts);
+		SendMetric(prefixMetadata, "reachable", metrics->IsReachable(), ts);
+		SendMetric(prefixMetadata, "downtime_depth", metrics->GetDowntimeDepth(), ts);
+		SendMetric(prefixMetadata, "acknowledgement", metrics->GetAcknowledgement(), ts);
+		SendMetric(prefixMetadata, "latency", metrics->GetLatency(), ts);
+		SendMetric(prefixMetadata, "execution_time", metrics->GetExecutionTime(), ts);
 	}
 
-	SendPerfdata(prefixPerfdata, cr, ts);
+	SendPerfdata(prefixPerfdata, metrics, ts);
+
+	/* Without a threshold all metrics for a check result are sent with a single write. */
+	if (m_SendBuffer.size() >= static_cast<size_t>(std::max(GetFlushThreshold(), 0)))
+		Flush();
 }
 
-void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResult::Ptr& cr, double ts)
+void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResultMetrics::Ptr& metrics, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = metrics->GetPerfdata();
 
 	if (!perfdata)
 		return;
 
 	ObjectLock olock(perfdata);
 	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "GraphiteWriter")
-					<< "Ignoring invalid perfdata value: " << val;
-				continue;
-			}
-		}
+		PerfdataValue::Ptr pdv = val;
 
 		String escapedKey = EscapeMetricLabel(pdv->GetLabel());
 
@@ -272,29 +300,110 @@ void GraphiteWriter::SendPerfdata(const String& prefix, const CheckResult::Ptr&
 
 void GraphiteWriter::SendMetric(const String& prefix, const String& name, double value, double ts)
 {
-	std::ostringstream msgbuf;
-	msgbuf << prefix << "." << name << " " << Convert::ToString(value) << " " << static_cast<long>(ts);
+	char buffer[Convert::FormatBufferSize];
+
+	std::string metric;
+	metric.reserve(prefix.GetLength() + name.GetLength() + 2 * Convert::FormatBufferSize);
+	metric += prefix.GetData();
+	metric += '.';
+	metric += name.GetData();
+	metric += ' ';
+	metric += Convert::ToString(value).GetData();
+	metric += ' ';
+	metric.append(buffer, Convert::FormatInteger(static_cast<long>(ts), buffer));
 
 	Log(LogDebug, "GraphiteWriter")
-		<< "Add to metric list:'" << msgbuf.str() << "'.";
+		<< "Add to metric list:'" << metric << "'.";
+
+	if (m_SendBuffer.empty())
+		m_SendBufferSince = Utility::GetTime();
+
+	m_SendBuffer += metric;
+	m_SendBuffer += '\n';
+	m_SendBufferSize = m_SendBuffer.size();
+}
 
-	// do not send \n to debug log
-	msgbuf << "\n";
-	String metric = msgbuf.str();
+void GraphiteWriter::FlushTimeout()
+{
+	m_WorkQueue.Enqueue(std::bind(&GraphiteWriter::FlushTimeoutWQ, this), PriorityHigh);
+}
+
+void GraphiteWriter::FlushTimeoutWQ()
+{
+	AssertOnWorkQueue();
+
+	if (m_SendBuffer.empty()) {
+		/* Send spooled data even if there are no new metrics. */
+		if (m_Spool && GetConnected())
+			DrainSpool();
+
+		return;
+	}
+
+	Log(LogDebug, "GraphiteWriter")
+		<< "Timer expired writing " << m_SendBuffer.size() << " bytes";
+
+	Flush();
+}
+
+void GraphiteWriter::Flush()
+{
+	AssertOnWorkQueue();
+
+	if (m_SendBuffer.empty())
+		return;
+
+	std::string buffer;
+	std::swap(buffer, m_SendBuffer);
+	m_SendBufferSize = 0;
+
+	l_BufferLatency.Record(Utility::GetTime() - m_SendBufferSince);
 
 	ObjectLock olock(this);
 
-	if (!GetConnected())
+	/* Metrics are dropped while we're not connected unless spooling is enabled. */
+	if (!GetConnected()) {
+		if (m_Spool)
+			m_Spool->Append(buffer);
+
 		return;
+	}
+
+	double startTime = Utility::GetTime();
 
 	try {
-		m_Stream->Write(metric.CStr(), metric.GetLength());
+		m_Stream->Write(buffer.c_str(), buffer.size());
 	} catch (const std::exception& ex) {
 		Log(LogCritical, "GraphiteWriter")
 			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
 
+		if (m_Spool)
+			m_Spool->Append(buffer);
+
 		throw ex;
 	}
+
+	m_LastFlushDuration = Utility::GetTime() - startTime;
+
+	if (m_Spool)
+		DrainSpool();
+}
+
+/**
+ * Writes spooled metrics after Graphite became available again. At most
+ * spool_drain_rate batches are written at a time.
+ */
+void GraphiteWriter::DrainSpool()
+{
+	AssertOnWorkQueue();
+
+	String batch;
+
+	for (int i = 0; i < GetSpoolDrainRate() && m_Spool->Peek(&batch); i++) {
+		/* Exceptions are handled by ExceptionHandler() which closes the connection. */
+		m_Stream->Write(batch.CStr(), batch.GetLength());
+		m_Spool->Pop();
+	}
 }
 
 String GraphiteWriter::EscapeMetric(const String& str)
@@ -21,12 +21,15 @@
 #define GRAPHITEWRITER_H
 
 #include "perfdata/graphitewriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
 #include "icinga/service.hpp"
+#include "icinga/checkresultqueue.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
 #include <fstream>
+#include <atomic>
 
 namespace icinga
 {
@@ -55,13 +58,26 @@ protected:
 private:
 	Stream::Ptr m_Stream;
 	WorkQueue m_WorkQueue{10000000, 1};
+	CheckResultQueue::Ptr m_CheckResultQueue;
 
 	Timer::Ptr m_ReconnectTimer;
+	Timer::Ptr m_FlushTimer;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	std::string m_SendBuffer;
+	double m_SendBufferSince{0};
+	std::atomic<size_t> m_SendBufferSize{0};
+	std::atomic<double> m_LastFlushDuration{0};
+
+	PerfdataSpool::Ptr m_Spool;
+
+	void CheckResultBatchHandler(const std::vector<CheckResultEvent>& events);
+	void CheckResultHandlerInternal(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics);
 	void SendMetric(const String& prefix, const String& name, double value, double ts);
-	void SendPerfdata(const String& prefix, const CheckResult::Ptr& cr, double ts);
+	void SendPerfdata(const String& prefix, const CheckResultMetrics::Ptr& metrics, double ts);
+	void FlushTimeout();
+	void FlushTimeoutWQ();
+	void Flush();
+	void DrainSpool();
 	static String EscapeMetric(const String& str);
 	static String EscapeMetricLabel(const String& str);
 	static Value EscapeMacroMetric(const Value& value);
@@ -38,7 +38,9 @@
 #include "base/networkstream.hpp"
 #include "base/exception.hpp"
 #include "base/statsfunction.hpp"
+#include "base/latencyhistogram.hpp"
 #include "base/tlsutility.hpp"
+#include "base/gzip.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/math/special_functions/fpclassify.hpp>
@@ -70,31 +72,54 @@ REGISTER_TYPE(InfluxdbWriter);
 
 REGISTER_STATSFUNCTION(InfluxdbWriter, &InfluxdbWriter::StatsFunc);
 
+/* How long data points wait in the buffer until they are flushed (measured for the oldest one). */
+static LatencyHistogram l_BufferLatency("influxdbwriter_buffer_latency");
+
 void InfluxdbWriter::OnConfigLoaded()
 {
 	ObjectImpl<InfluxdbWriter>::OnConfigLoaded();
 
 	m_WorkQueue.SetName("InfluxdbWriter, " + GetName());
+	m_FlushQueue.SetName("InfluxdbWriter, " + GetName() + ", Flush");
 }
 
 void InfluxdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
-	for (const InfluxdbWriter::Ptr& influxdbwriter : ConfigType::GetObjectsByType<InfluxdbWriter>()) {
+	for (const InfluxdbWriter::Ptr& influxdbwriter : ConfigType::GetObjectViewByType<InfluxdbWriter>()) {
 		size_t workQueueItems = influxdbwriter->m_WorkQueue.GetLength();
 		double workQueueItemRate = influxdbwriter->m_WorkQueue.GetTaskCount(60) / 60.0;
-		size_t dataBufferItems = influxdbwriter->m_DataBuffer.size();
+		CheckResultQueue::Ptr checkResultQueue = influxdbwriter->m_CheckResultQueue;
+		size_t checkResultQueueItems = checkResultQueue ? checkResultQueue->GetLength() : 0;
+		unsigned long checkResultQueueDropped = checkResultQueue ? checkResultQueue->GetDroppedResults() : 0;
+		size_t dataBufferItems = influxdbwriter->m_DataBufferItems;
+		unsigned long connects = influxdbwriter->m_Connects;
+		unsigned long tlsHandshakes = influxdbwriter->m_TlsHandshakes;
+		PerfdataSpool::Ptr spool = influxdbwriter->m_Spool;
+		size_t spoolSize = spool ? spool->GetSize() : 0;
+		unsigned long spoolDroppedBatches = spool ? spool->GetDroppedBatches() : 0;
 
 		nodes.emplace_back(influxdbwriter->GetName(), new Dictionary({
 			{ "work_queue_items", workQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
-			{ "data_buffer_items", dataBufferItems }
+			{ "check_result_queue_items", checkResultQueueItems },
+			{ "check_result_queue_dropped", checkResultQueueDropped },
+			{ "data_buffer_items", dataBufferItems },
+			{ "connects", connects },
+			{ "tls_handshakes", tlsHandshakes },
+			{ "spool_size", spoolSize },
+			{ "spool_dropped_batches", spoolDroppedBatches }
 		}));
 
 		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_work_queue_items", workQueueItems));
 		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_work_queue_item_rate", workQueueItemRate));
+		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_check_result_queue_items", checkResultQueueItems));
+		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_check_result_queue_dropped", checkResultQueueDropped));
 		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_data_queue_items", dataBufferItems));
+		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_connects", connects));
+		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_tls_handshakes", tlsHandshakes));
+		perfdata->Add(new PerfdataValue("influxdbwriter_" + influxdbwriter->GetName() + "_spool_size", spoolSize));
 	}
 
 	status->Set("influxdbwriter", new Dictionary(std::move(nodes)));
@@ -109,6 +134,10 @@ void InfluxdbWriter::Start(bool runtimeCreated)
 
 	/* Register exception handler for WQ tasks. */
 	m_WorkQueue.SetExceptionCallback(std::bind(&InfluxdbWriter::ExceptionHandler, this, _1));
+	m_FlushQueue.SetExceptionCallback(std::bind(&InfluxdbWriter::ExceptionHandler, this, _1));
+
+	if (GetEnableSpool())
+		m_Spool = new PerfdataSpool(PerfdataSpool::GetSpoolPath("InfluxdbWriter", GetName()), GetSpoolMaxSize());
 
 	/* Setup timer for periodically flushing m_DataBuffer */
 	m_FlushTimer = new Timer();
@@ -118,7 +147,12 @@ void InfluxdbWriter::Start(bool runtimeCreated)
 	m_FlushTimer->Reschedule(0);
 
 	/* Register for new metrics. */
-	Checkable::OnNewCheckResult.connect(std::bind(&InfluxdbWriter::CheckResultHandler, this, _1, _2));
+	m_CheckResultQueue = new CheckResultQueue(GetName(), m_WorkQueue, std::bind(&InfluxdbWriter::CheckResultBatchHandler, this, _1), PriorityLow);
+	m_CheckResultQueue->Start();
+
+	/* Rendered templates may reference custom variables and other objects. */
+	CustomVarObject::OnVarsChanged.connect(std::bind(&InfluxdbWriter::TemplateCacheInvalidationHandler, this));
+	ConfigObject::OnActiveChanged.connect(std::bind(&InfluxdbWriter::TemplateCacheInvalidationHandler, this));
 }
 
 void InfluxdbWriter::Stop(bool runtimeRemoved)
@@ -126,7 +160,13 @@ void InfluxdbWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "InfluxdbWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_CheckResultQueue)
+		m_CheckResultQueue->Stop();
+
 	m_WorkQueue.Join();
+	m_FlushQueue.Join();
+
+	m_Client.Close();
 
 	ObjectImpl<InfluxdbWriter>::Stop(runtimeRemoved);
 }
@@ -161,6 +201,8 @@ Stream::Ptr InfluxdbWriter::Connect()
 		throw ex;
 	}
 
+	m_Connects++;
+
 	if (GetSslEnable()) {
 		std::shared_ptr<SSL_CTX> sslContext;
 		try {
@@ -180,29 +222,102 @@ Stream::Ptr InfluxdbWriter::Connect()
 			throw ex;
 		}
 
+		m_TlsHandshakes++;
+
 		return tlsStream;
 	} else {
 		return new NetworkStream(socket);
 	}
 }
 
-void InfluxdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void InfluxdbWriter::CheckResultBatchHandler(const std::vector<CheckResultEvent>& events)
 {
-	m_WorkQueue.Enqueue(std::bind(&InfluxdbWriter::CheckResultHandlerWQ, this, checkable, cr), PriorityLow);
+	for (const CheckResultEvent& event : events)
+		CheckResultHandlerWQ(event.Subject, event.Result, event.Metrics);
 }
 
-void InfluxdbWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void InfluxdbWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics)
 {
 	AssertOnWorkQueue();
 
 	CONTEXT("Processing check result for '" + checkable->GetName() + "'");
 
-	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata())
+	if (!metrics->IsPerfdataEnabled())
 		return;
 
-	Host::Ptr host;
-	Service::Ptr service;
-	tie(host, service) = GetHostService(checkable);
+	String prefix = GetMetricPrefix(checkable, cr, metrics);
+
+	double ts = metrics->GetTimestamp();
+
+	Array::Ptr perfdata = metrics->GetPerfdata();
+	if (perfdata) {
+		ObjectLock olock(perfdata);
+		for (const Value& val : perfdata) {
+			PerfdataValue::Ptr pdv = val;
+
+			/* Fields are written in the order of their keys, the same order a Dictionary would use. */
+			BeginMetric(prefix, pdv->GetLabel());
+
+			bool first = true;
+
+			if (GetEnableSendThresholds() && pdv->GetCrit())
+				AppendField(first, "crit", pdv->GetCrit());
+			if (GetEnableSendThresholds() && pdv->GetMax())
+				AppendField(first, "max", pdv->GetMax());
+			if (GetEnableSendThresholds() && pdv->GetMin())
+				AppendField(first, "min", pdv->GetMin());
+			if (!pdv->GetUnit().IsEmpty())
+				AppendField(first, "unit", pdv->GetUnit());
+
+			AppendField(first, "value", pdv->GetValue());
+
+			if (GetEnableSendThresholds() && pdv->GetWarn())
+				AppendField(first, "warn", pdv->GetWarn());
+
+			EndMetric(ts);
+		}
+	}
+
+	if (GetEnableSendMetadata()) {
+		BeginMetric(prefix, Empty);
+
+		bool first = true;
+
+		AppendField(first, "acknowledgement", new InfluxdbInteger(metrics->GetAcknowledgement()));
+		AppendField(first, "current_attempt", new InfluxdbInteger(metrics->GetCheckAttempt()));
+		AppendField(first, "downtime_depth", new InfluxdbInteger(metrics->GetDowntimeDepth()));
+		AppendField(first, "execution_time", metrics->GetExecutionTime());
+		AppendField(first, "latency", metrics->GetLatency());
+		AppendField(first, "max_check_attempts", new InfluxdbInteger(metrics->GetMaxCheckAttempts()));
+		AppendField(first, "reachable", metrics->IsReachable());
+		AppendField(first, "state", new InfluxdbInteger(metrics->GetState()));
+		AppendField(first, "state_type", new InfluxdbInteger(metrics->GetStateType()));
+
+		EndMetric(ts);
+	}
+}
+
+/**
+ * Returns the measurement and tag set for a checkable's metrics, i.e. the
+ * escaped line protocol prefix up to (but not including) the metric tag.
+ *
+ * The rendered templates are cached per checkable unless the template cache
+ * is disabled. The cache is cleared whenever custom variables are modified
+ * or objects are (de)activated.
+ */
+String InfluxdbWriter::GetMetricPrefix(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics)
+{
+	bool useCache = GetEnableTemplateCache();
+
+	if (useCache) {
+		auto it = m_TemplateCache.find(checkable);
+
+		if (it != m_TemplateCache.end())
+			return it->second;
+	}
+
+	const Host::Ptr& host = metrics->GetHost();
+	const Service::Ptr& service = metrics->GetService();
 
 	MacroProcessor::ResolverList resolvers;
 	if (service)
@@ -210,14 +325,10 @@ void InfluxdbWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const
 	resolvers.emplace_back("host", host);
 	resolvers.emplace_back("icinga", IcingaApplication::GetInstance());
 
-	String prefix;
-
-	double ts = cr->GetExecutionEnd();
+	Dictionary::Ptr tmpl = service ? GetServiceTemplate() : GetHostTemplate();
 
-	// Clone the template and perform an in-place macro expansion of measurement and tag values
-	Dictionary::Ptr tmpl_clean = service ? GetServiceTemplate() : GetHostTemplate();
-	Dictionary::Ptr tmpl = static_pointer_cast<Dictionary>(tmpl_clean->Clone());
-	tmpl->Set("measurement", MacroProcessor::ResolveMacros(tmpl->Get("measurement"), resolvers, cr));
+	String prefix;
+	AppendEscapedKeyOrTagValue(prefix, MacroProcessor::ResolveMacros(tmpl->Get("measurement"), resolvers, cr));
 
 	Dictionary::Ptr tags = tmpl->Get("tags");
 	if (tags) {
@@ -226,85 +337,48 @@ void InfluxdbWriter::CheckResultHandlerWQ(const Checkable::Ptr& checkable, const
 			String missing_macro;
 			Value value = MacroProcessor::ResolveMacros(pair.second, resolvers, cr, &missing_macro);
 
+			/* Keep the unresolved value if a macro is missing. */
 			if (!missing_macro.IsEmpty())
+				value = pair.second;
+
+			// Empty macro expansion, no tag
+			if (value.IsEmpty())
 				continue;
 
-			tags->Set(pair.first, value);
+			prefix += ",";
+			AppendEscapedKeyOrTagValue(prefix, pair.first);
+			prefix += "=";
+			AppendEscapedKeyOrTagValue(prefix, value);
 		}
 	}
 
-	Array::Ptr perfdata = cr->GetPerformanceData();
-	if (perfdata) {
-		ObjectLock olock(perfdata);
-		for (const Value& val : perfdata) {
-			PerfdataValue::Ptr pdv;
-
-			if (val.IsObjectType<PerfdataValue>())
-				pdv = val;
-			else {
-				try {
-					pdv = PerfdataValue::Parse(val);
-				} catch (const std::exception&) {
-					Log(LogWarning, "InfluxdbWriter")
-						<< "Ignoring invalid perfdata value: " << val;
-					continue;
-				}
-			}
-
-			Dictionary::Ptr fields = new Dictionary();
-			fields->Set("value", pdv->GetValue());
-
-			if (GetEnableSendThresholds()) {
-				if (pdv->GetCrit())
-					fields->Set("crit", pdv->GetCrit());
-				if (pdv->GetWarn())
-					fields->Set("warn", pdv->GetWarn());
-				if (pdv->GetMin())
-					fields->Set("min", pdv->GetMin());
-				if (pdv->GetMax())
-					fields->Set("max", pdv->GetMax());
-			}
-			if (!pdv->GetUnit().IsEmpty()) {
-				fields->Set("unit", pdv->GetUnit());
-			}
-
-			SendMetric(tmpl, pdv->GetLabel(), fields, ts);
-		}
-	}
+	if (useCache)
+		m_TemplateCache[checkable] = prefix;
 
-	if (GetEnableSendMetadata()) {
-		Host::Ptr host;
-		Service::Ptr service;
-		tie(host, service) = GetHostService(checkable);
-
-		Dictionary::Ptr fields = new Dictionary();
-
-		if (service)
-			fields->Set("state", new InfluxdbInteger(service->GetState()));
-		else
-			fields->Set("state", new InfluxdbInteger(host->GetState()));
-
-		fields->Set("current_attempt", new InfluxdbInteger(checkable->GetCheckAttempt()));
-		fields->Set("max_check_attempts", new InfluxdbInteger(checkable->GetMaxCheckAttempts()));
-		fields->Set("state_type", new InfluxdbInteger(checkable->GetStateType()));
-		fields->Set("reachable", checkable->IsReachable());
-		fields->Set("downtime_depth", new InfluxdbInteger(checkable->GetDowntimeDepth()));
-		fields->Set("acknowledgement", new InfluxdbInteger(checkable->GetAcknowledgement()));
-		fields->Set("latency", cr->CalculateLatency());
-		fields->Set("execution_time", cr->CalculateExecutionTime());
-
-		SendMetric(tmpl, Empty, fields, ts);
-	}
+	return prefix;
+}
+
+void InfluxdbWriter::TemplateCacheInvalidationHandler()
+{
+	m_WorkQueue.Enqueue(std::bind(&InfluxdbWriter::TemplateCacheInvalidationHandlerWQ, this), PriorityHigh);
 }
 
-String InfluxdbWriter::EscapeKeyOrTagValue(const String& str)
+void InfluxdbWriter::TemplateCacheInvalidationHandlerWQ()
 {
-	// Iterate over the key name and escape commas and spaces with a backslash
-	String result = str;
-	boost::algorithm::replace_all(result, "\"", "\\\"");
-	boost::algorithm::replace_all(result, "=", "\\=");
-	boost::algorithm::replace_all(result, ",", "\\,");
-	boost::algorithm::replace_all(result, " ", "\\ ");
+	AssertOnWorkQueue();
+
+	m_TemplateCache.clear();
+}
+
+void InfluxdbWriter::AppendEscapedKeyOrTagValue(String& buffer, const String& str)
+{
+	// Escape quotes, equal signs, commas and spaces with a backslash
+	for (char ch : str) {
+		if (ch == '"' || ch == '=' || ch == ',' || ch == ' ')
+			buffer += '\\';
+
+		buffer += ch;
+	}
 
 	// InfluxDB 'feature': although backslashes are allowed in keys they also act
 	// as escape sequences when followed by ',' or ' '.  When your tag is like
@@ -312,80 +386,77 @@ String InfluxdbWriter::EscapeKeyOrTagValue(const String& str)
 	// and through experimentation they also escape '='.  To be safe we replace
 	// trailing backslashes with and underscore.
 	// See https://github.com/influxdata/influxdb/issues/8587 for more info
-	size_t length = result.GetLength();
-	if (result[length - 1] == '\\')
-		result[length - 1] = '_';
-
-	return result;
+	size_t length = buffer.GetLength();
+	if (!str.IsEmpty() && buffer[length - 1] == '\\')
+		buffer[length - 1] = '_';
 }
 
-String InfluxdbWriter::EscapeValue(const Value& value)
+void InfluxdbWriter::AppendEscapedValue(String& buffer, const Value& value)
 {
 	if (value.IsObjectType<InfluxdbInteger>()) {
-		std::ostringstream os;
-		os << static_cast<InfluxdbInteger::Ptr>(value)->GetValue() << "i";
-		return os.str();
+		char number[Convert::FormatBufferSize];
+		size_t length = Convert::FormatInteger(static_cast<InfluxdbInteger::Ptr>(value)->GetValue(), number);
+		buffer.GetData().append(number, length);
+		buffer += 'i';
+		return;
 	}
 
-	if (value.IsBoolean())
-		return value ? "true" : "false";
+	if (value.IsBoolean()) {
+		buffer += value ? "true" : "false";
+		return;
+	}
 
-	if (value.IsString())
-		return "\"" + EscapeKeyOrTagValue(value) + "\"";
+	if (value.IsString()) {
+		buffer += '"';
+		AppendEscapedKeyOrTagValue(buffer, value);
+		buffer += '"';
+		return;
+	}
 
-	return value;
+	buffer += value;
 }
 
-void InfluxdbWriter::SendMetric(const Dictionary::Ptr& tmpl, const String& label, const Dictionary::Ptr& fields, double ts)
+void InfluxdbWriter::BeginMetric(const String& prefix, const String& label)
 {
-	std::ostringstream msgbuf;
-	msgbuf << EscapeKeyOrTagValue(tmpl->Get("measurement"));
-
-	Dictionary::Ptr tags = tmpl->Get("tags");
-	if (tags) {
-		ObjectLock olock(tags);
-		for (const Dictionary::Pair& pair : tags) {
-			// Empty macro expansion, no tag
-			if (!pair.second.IsEmpty()) {
-				msgbuf << "," << EscapeKeyOrTagValue(pair.first) << "=" << EscapeKeyOrTagValue(pair.second);
-			}
-		}
-	}
+	m_DataBuffer += prefix;
 
 	// Label may be empty in the case of metadata
-	if (!label.IsEmpty())
-		msgbuf << ",metric=" << EscapeKeyOrTagValue(label);
-
-	msgbuf << " ";
-
-	{
-		bool first = true;
+	if (!label.IsEmpty()) {
+		m_DataBuffer += ",metric=";
+		AppendEscapedKeyOrTagValue(m_DataBuffer, label);
+	}
 
-		ObjectLock fieldLock(fields);
-		for (const Dictionary::Pair& pair : fields) {
-			if (first)
-				first = false;
-			else
-				msgbuf << ",";
+	m_DataBuffer += ' ';
+}
 
-			msgbuf << EscapeKeyOrTagValue(pair.first) << "=" << EscapeValue(pair.second);
-		}
-	}
+void InfluxdbWriter::AppendField(bool& first, const char *key, const Value& value)
+{
+	if (first)
+		first = false;
+	else
+		m_DataBuffer += ',';
+
+	m_DataBuffer += key;
+	m_DataBuffer += '=';
+	AppendEscapedValue(m_DataBuffer, value);
+}
 
-	msgbuf << " " <<  static_cast<unsigned long>(ts);
+void InfluxdbWriter::EndMetric(double ts)
+{
+	m_DataBuffer += ' ';
+	char number[Convert::FormatBufferSize];
+	m_DataBuffer.GetData().append(number, Convert::FormatInteger(static_cast<unsigned long>(ts), number));
+	m_DataBuffer += '\n';
 
-#ifdef I2_DEBUG
-	Log(LogDebug, "InfluxdbWriter")
-		<< "Add to metric list: '" << msgbuf.str() << "'.";
-#endif /* I2_DEBUG */
+	if (m_DataBufferItems == 0)
+		m_DataBufferSince = Utility::GetTime();
 
-	// Buffer the data point
-	m_DataBuffer.emplace_back(msgbuf.str());
+	m_DataBufferItems++;
 
 	// Flush if we've buffered too much to prevent excessive memory use
-	if (static_cast<int>(m_DataBuffer.size()) >= GetFlushThreshold()) {
+	if (static_cast<int>(m_DataBufferItems) >= GetFlushThreshold()) {
 		Log(LogDebug, "InfluxdbWriter")
-			<< "Data buffer overflow writing " << m_DataBuffer.size() << " data points";
+			<< "Data buffer overflow writing " << m_DataBufferItems << " data points";
 
 		try {
 			Flush();
@@ -404,33 +475,92 @@ void InfluxdbWriter::FlushTimeoutWQ()
 {
 	AssertOnWorkQueue();
 
-	// Flush if there are any data available
-	if (m_DataBuffer.empty())
+	// Send spooled data even if there are no new data points
+	if (m_DataBufferItems == 0) {
+		if (m_Spool && !m_Spool->IsEmpty())
+			m_FlushQueue.Enqueue(std::bind(&InfluxdbWriter::DrainSpool, this));
+
 		return;
+	}
 
 	Log(LogDebug, "InfluxdbWriter")
-		<< "Timer expired writing " << m_DataBuffer.size() << " data points";
+		<< "Timer expired writing " << m_DataBufferItems << " data points";
 
 	Flush();
 }
 
 void InfluxdbWriter::Flush()
 {
-	String body = boost::algorithm::join(m_DataBuffer, "\n");
-	m_DataBuffer.clear();
+	/* Drop the trailing newline; clearing the buffer keeps its capacity for the next batch. */
+	String body = m_DataBuffer.SubStr(0, m_DataBuffer.GetLength() - 1);
+	m_DataBuffer.Clear();
+	m_DataBufferItems = 0;
 
-	Stream::Ptr stream;
+	l_BufferLatency.Record(Utility::GetTime() - m_DataBufferSince);
 
-	try {
-		stream = Connect();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "InfluxDbWriter")
-			<< "Flush failed, cannot connect to InfluxDB.";
+	/* Compressing and sending the data happens on a separate queue so that
+	 * check results can be processed in the meantime.
+	 */
+	m_FlushQueue.Enqueue(std::bind(&InfluxdbWriter::SendRequest, this, body));
+}
+
+void InfluxdbWriter::SendRequest(const String& body)
+{
+	if (!m_Spool) {
+		TransmitRequest(body);
 		return;
 	}
 
-	if (!stream)
+	bool sent = false;
+
+	try {
+		sent = TransmitRequest(body);
+	} catch (const std::exception&) {
+		/* Already logged. */
+	}
+
+	if (!sent) {
+		Log(LogWarning, "InfluxdbWriter")
+			<< "Spooling " << body.GetLength() << " bytes of data until InfluxDB is available again.";
+
+		m_Spool->Append(body);
 		return;
+	}
+
+	DrainSpool();
+}
+
+/**
+ * Sends spooled data after the backend became available again. At most
+ * spool_drain_rate batches are sent at a time.
+ */
+void InfluxdbWriter::DrainSpool()
+{
+	String batch;
+
+	for (int i = 0; i < GetSpoolDrainRate() && m_Spool->Peek(&batch); i++) {
+		try {
+			if (!TransmitRequest(batch))
+				return;
+		} catch (const std::exception&) {
+			return;
+		}
+
+		m_Spool->Pop();
+	}
+}
+
+/**
+ * Sends data to InfluxDB.
+ *
+ * @returns false if the data should be sent again later on, true otherwise.
+ */
+bool InfluxdbWriter::TransmitRequest(const String& body)
+{
+	String payload = body;
+
+	if (GetEnableCompression())
+		payload = Gzip::Compress(body);
 
 	Url::Ptr url = new Url();
 	url->SetScheme(GetSslEnable() ? "https" : "http");
@@ -448,38 +578,22 @@ void InfluxdbWriter::Flush()
 	if (!GetPassword().IsEmpty())
 		url->AddQueryElement("p", GetPassword());
 
-	HttpRequest req(stream);
-	req.RequestMethod = "POST";
-	req.RequestUrl = url;
+	bool accepted = false;
+	String error;
 
-	try {
-		req.WriteBody(body.CStr(), body.GetLength());
-		req.Finish();
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "InfluxdbWriter")
-			<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
-		throw ex;
-	}
+	KeepAliveRequestResult result = m_Client.SendRequest([this, &url](HttpRequest& req) {
+		req.RequestMethod = "POST";
+		req.RequestUrl = url;
 
-	HttpResponse resp(stream, req);
-	StreamReadContext context;
+		if (GetEnableCompression())
+			req.AddHeader("Content-Encoding", "gzip");
+	}, payload, [&accepted](HttpResponse& resp) {
+		/* Server errors are usually temporary, the data is sent again later on. */
+		accepted = resp.StatusCode < 500;
 
-	try {
-		while (resp.Parse(context, true) && !resp.Complete)
-			; /* Do nothing */
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "InfluxdbWriter")
-			<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << DiagnosticInformation(ex);
-		throw ex;
-	}
-
-	if (!resp.Complete) {
-		Log(LogWarning, "InfluxdbWriter")
-			<< "Failed to read a complete HTTP response from the InfluxDB server.";
-		return;
-	}
+		if (resp.StatusCode == 204)
+			return;
 
-	if (resp.StatusCode != 204) {
 		Log(LogWarning, "InfluxdbWriter")
 			<< "Unexpected response code: " << resp.StatusCode;
 
@@ -508,8 +622,27 @@ void InfluxdbWriter::Flush()
 
 		Log(LogCritical, "InfluxdbWriter")
 			<< "InfluxDB error message:\n" << error;
-
-		return;
+	}, &error);
+
+	switch (result) {
+		case KeepAliveConnectFailed:
+			Log(LogWarning, "InfluxDbWriter")
+				<< "Flush failed, cannot connect to InfluxDB.";
+			return false;
+		case KeepAliveWriteFailed:
+			Log(LogWarning, "InfluxdbWriter")
+				<< "Cannot write to TCP socket on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot write to InfluxDB."));
+		case KeepAliveReadFailed:
+			Log(LogWarning, "InfluxdbWriter")
+				<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << error;
+			BOOST_THROW_EXCEPTION(std::runtime_error("Cannot read the InfluxDB response."));
+		case KeepAliveResponseIncomplete:
+			Log(LogWarning, "InfluxdbWriter")
+				<< "Failed to read a complete HTTP response from the InfluxDB server.";
+			return false;
+		default:
+			return accepted;
 	}
 }
 
@@ -549,3 +682,10 @@ void InfluxdbWriter::ValidateServiceTemplate(const Lazy<Dictionary::Ptr>& lvalue
 	}
 }
 
+void InfluxdbWriter::ValidateEnableCompression(const Lazy<bool>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<InfluxdbWriter>::ValidateEnableCompression(lvalue, utils);
+
+	if (lvalue() && !Gzip::IsSupported())
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "enable_compression" }, "Compression is not supported by this build (zlib is missing)."));
+}
@@ -21,12 +21,18 @@
 #define INFLUXDBWRITER_H
 
 #include "perfdata/influxdbwriter-ti.hpp"
+#include "perfdata/perfdataspool.hpp"
+#include "perfdata/keepalivehttpclient.hpp"
 #include "icinga/service.hpp"
+#include "icinga/checkresultqueue.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <atomic>
 #include <fstream>
+#include <map>
+#include <memory>
 
 namespace icinga
 {
@@ -46,6 +52,7 @@ public:
 
 	void ValidateHostTemplate(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
 	void ValidateServiceTemplate(const Lazy<Dictionary::Ptr>& lvalue, const ValidationUtils& utils) override;
+	void ValidateEnableCompression(const Lazy<bool>& lvalue, const ValidationUtils& utils) override;
 
 protected:
 	void OnConfigLoaded() override;
@@ -54,18 +61,35 @@ protected:
 
 private:
 	WorkQueue m_WorkQueue{10000000, 1};
+	CheckResultQueue::Ptr m_CheckResultQueue;
+	WorkQueue m_FlushQueue{100, 1};
+	KeepAliveHttpClient m_Client{std::bind(&InfluxdbWriter::Connect, this)};
+	std::atomic<unsigned long> m_Connects{0};
+	std::atomic<unsigned long> m_TlsHandshakes{0};
+	PerfdataSpool::Ptr m_Spool;
 	Timer::Ptr m_FlushTimer;
-	std::vector<String> m_DataBuffer;
+	String m_DataBuffer;
+	size_t m_DataBufferItems{0};
+	double m_DataBufferSince{0};
+	std::map<Checkable::Ptr, String> m_TemplateCache;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
-	void SendMetric(const Dictionary::Ptr& tmpl, const String& label, const Dictionary::Ptr& fields, double ts);
+	void CheckResultBatchHandler(const std::vector<CheckResultEvent>& events);
+	void CheckResultHandlerWQ(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics);
+	String GetMetricPrefix(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr, const CheckResultMetrics::Ptr& metrics);
+	void TemplateCacheInvalidationHandler();
+	void TemplateCacheInvalidationHandlerWQ();
+	void BeginMetric(const String& prefix, const String& label);
+	void AppendField(bool& first, const char *key, const Value& value);
+	void EndMetric(double ts);
 	void FlushTimeout();
 	void FlushTimeoutWQ();
 	void Flush();
+	void SendRequest(const String& body);
+	bool TransmitRequest(const String& body);
+	void DrainSpool();
 
-	static String EscapeKeyOrTagValue(const String& str);
-	static String EscapeValue(const Value& value);
+	static void AppendEscapedKeyOrTagValue(String& buffer, const String& str);
+	static void AppendEscapedValue(String& buffer, const Value& value);
 
 	Stream::Ptr Connect();
 
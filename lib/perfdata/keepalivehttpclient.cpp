@@ -0,0 +1,127 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/keepalivehttpclient.hpp"
+#include "base/exception.hpp"
+
+using namespace icinga;
+
+/**
+ * Constructor for the KeepAliveHttpClient class.
+ *
+ * @param connect Opens a new connection. It may throw or return an empty
+ *                pointer if the server isn't reachable.
+ */
+KeepAliveHttpClient::KeepAliveHttpClient(ConnectCallback connect)
+	: m_Connect(std::move(connect))
+{ }
+
+/**
+ * Sends a request, connecting first unless there's a connection left from
+ * the previous request.
+ *
+ * @param prepareRequest Sets the request method, URL and headers.
+ * @param body The request body.
+ * @param handleResponse Called with the complete response.
+ * @param error Receives the error message for a failed connect or read.
+ * @returns The outcome, handleResponse is only called for KeepAliveRequestCompleted.
+ */
+KeepAliveRequestResult KeepAliveHttpClient::SendRequest(const RequestCallback& prepareRequest, const String& body,
+	const ResponseCallback& handleResponse, String *error)
+{
+	for (int attempt = 0;; attempt++) {
+		bool reused = static_cast<bool>(m_Stream);
+
+		if (!m_Stream) {
+			try {
+				m_Stream = m_Connect();
+			} catch (const std::exception& ex) {
+				if (error)
+					*error = DiagnosticInformation(ex, false);
+
+				return KeepAliveConnectFailed;
+			}
+
+			if (!m_Stream)
+				return KeepAliveConnectFailed;
+
+			m_Context.reset(new StreamReadContext());
+		}
+
+		bool retry = reused && attempt == 0;
+
+		HttpRequest req(m_Stream);
+		prepareRequest(req);
+
+		try {
+			req.WriteBody(body.CStr(), body.GetLength());
+			req.Finish();
+		} catch (const std::exception&) {
+			Close();
+
+			if (retry)
+				continue;
+
+			return KeepAliveWriteFailed;
+		}
+
+		HttpResponse resp(m_Stream, req);
+
+		try {
+			while (resp.Parse(*m_Context, true) && !resp.Complete)
+				; /* Do nothing */
+		} catch (const std::exception& ex) {
+			Close();
+
+			if (retry && !resp.Headers)
+				continue;
+
+			if (error)
+				*error = DiagnosticInformation(ex, false);
+
+			return KeepAliveReadFailed;
+		}
+
+		if (!resp.Complete) {
+			Close();
+
+			if (retry && !resp.Headers)
+				continue;
+
+			return KeepAliveResponseIncomplete;
+		}
+
+		if (resp.ProtocolVersion == HttpVersion10 || resp.Headers->Get("connection") == "close")
+			Close();
+
+		handleResponse(resp);
+
+		return KeepAliveRequestCompleted;
+	}
+}
+
+void KeepAliveHttpClient::Close()
+{
+	if (m_Stream) {
+		m_Stream->Close();
+		m_Stream.reset();
+	}
+
+	m_Context.reset();
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef KEEPALIVEHTTPCLIENT_H
+#define KEEPALIVEHTTPCLIENT_H
+
+#include "remote/httprequest.hpp"
+#include "remote/httpresponse.hpp"
+#include "base/stream.hpp"
+#include <functional>
+#include <memory>
+
+namespace icinga
+{
+
+/**
+ * The outcome of KeepAliveHttpClient::SendRequest().
+ *
+ * @ingroup perfdata
+ */
+enum KeepAliveRequestResult
+{
+	KeepAliveRequestCompleted, /**< a complete response was received */
+	KeepAliveConnectFailed,
+	KeepAliveWriteFailed,
+	KeepAliveReadFailed,
+	KeepAliveResponseIncomplete
+};
+
+/**
+ * A HTTP connection which perfdata writers keep alive between flushes. The
+ * server may have closed it in the meantime, in that case the request is
+ * retried once on a new connection as long as no response was received.
+ *
+ * Note: The client isn't thread-safe, callers must serialize access (e.g. by
+ * using it from a single work queue only).
+ *
+ * @ingroup perfdata
+ */
+class KeepAliveHttpClient
+{
+public:
+	typedef std::function<Stream::Ptr ()> ConnectCallback;
+	typedef std::function<void (HttpRequest&)> RequestCallback;
+	typedef std::function<void (HttpResponse&)> ResponseCallback;
+
+	KeepAliveHttpClient(ConnectCallback connect);
+
+	KeepAliveRequestResult SendRequest(const RequestCallback& prepareRequest, const String& body,
+		const ResponseCallback& handleResponse, String *error = nullptr);
+	void Close();
+
+private:
+	ConnectCallback m_Connect;
+	Stream::Ptr m_Stream;
+	std::unique_ptr<StreamReadContext> m_Context;
+};
+
+}
+
+#endif /* KEEPALIVEHTTPCLIENT_H */
@@ -19,6 +19,9 @@
 
 #include "perfdata/opentsdbwriter.hpp"
 #include "perfdata/opentsdbwriter-ti.cpp"
+#include "remote/url.hpp"
+#include "remote/httprequest.hpp"
+#include "remote/httpresponse.hpp"
 #include "icinga/service.hpp"
 #include "icinga/macroprocessor.hpp"
 #include "icinga/icingaapplication.hpp"
@@ -34,9 +37,11 @@
 #include "base/stream.hpp"
 #include "base/networkstream.hpp"
 #include "base/exception.hpp"
+#include "base/json.hpp"
 #include "base/statsfunction.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/scoped_array.hpp>
 
 using namespace icinga;
 
@@ -44,12 +49,46 @@ REGISTER_TYPE(OpenTsdbWriter);
 
 REGISTER_STATSFUNCTION(OpenTsdbWriter, &OpenTsdbWriter::StatsFunc);
 
-void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
+void OpenTsdbWriter::OnConfigLoaded()
+{
+	ObjectImpl<OpenTsdbWriter>::OnConfigLoaded();
+
+	m_WorkQueue.SetName("OpenTsdbWriter, " + GetName());
+	m_FlushQueue.SetName("OpenTsdbWriter, " + GetName() + ", Flush");
+}
+
+void OpenTsdbWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata)
 {
 	DictionaryData nodes;
 
-	for (const OpenTsdbWriter::Ptr& opentsdbwriter : ConfigType::GetObjectsByType<OpenTsdbWriter>()) {
-		nodes.emplace_back(opentsdbwriter->GetName(), 1); //add more stats
+	for (const OpenTsdbWriter::Ptr& opentsdbwriter : ConfigType::GetObjectViewByType<OpenTsdbWriter>()) {
+		if (!opentsdbwriter->m_UseHttp) {
+			nodes.emplace_back(opentsdbwriter->GetName(), 1); //add more stats
+			continue;
+		}
+
+		size_t dataBufferItems;
+
+		{
+			boost::mutex::scoped_lock lock(opentsdbwriter->m_DataBufferMutex);
+			dataBufferItems = opentsdbwriter->m_DataBufferItems;
+		}
+
+		size_t flushQueueItems = opentsdbwriter->m_FlushQueue.GetLength();
+		unsigned long dataPointsSent = opentsdbwriter->m_DataPointsSent;
+		unsigned long dataPointsFailed = opentsdbwriter->m_DataPointsFailed;
+
+		nodes.emplace_back(opentsdbwriter->GetName(), new Dictionary({
+			{ "data_buffer_items", dataBufferItems },
+			{ "flush_queue_items", flushQueueItems },
+			{ "data_points_sent", dataPointsSent },
+			{ "data_points_failed", dataPointsFailed }
+		}));
+
+		perfdata->Add(new PerfdataValue("opentsdbwriter_" + opentsdbwriter->GetName() + "_data_buffer_items", dataBufferItems));
+		perfdata->Add(new PerfdataValue("opentsdbwriter_" + opentsdbwriter->GetName() + "_flush_queue_items", flushQueueItems));
+		perfdata->Add(new PerfdataValue("opentsdbwriter_" + opentsdbwriter->GetName() + "_data_points_sent", dataPointsSent));
+		perfdata->Add(new PerfdataValue("opentsdbwriter_" + opentsdbwriter->GetName() + "_data_points_failed", dataPointsFailed));
 	}
 
 	status->Set("opentsdbwriter", new Dictionary(std::move(nodes)));
@@ -62,13 +101,25 @@ void OpenTsdbWriter::Start(bool runtimeCreated)
 	Log(LogInformation, "OpentsdbWriter")
 		<< "'" << GetName() << "' started.";
 
-	m_ReconnectTimer = new Timer();
-	m_ReconnectTimer->SetInterval(10);
-	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&OpenTsdbWriter::ReconnectTimerHandler, this));
-	m_ReconnectTimer->Start();
-	m_ReconnectTimer->Reschedule(0);
+	m_UseHttp = (GetTransport() == "http");
 
-	Service::OnNewCheckResult.connect(std::bind(&OpenTsdbWriter::CheckResultHandler, this, _1, _2));
+	if (m_UseHttp) {
+		/* Setup timer for periodically flushing m_DataBuffer */
+		m_FlushTimer = new Timer();
+		m_FlushTimer->SetInterval(GetFlushInterval());
+		m_FlushTimer->OnTimerExpired.connect(std::bind(&OpenTsdbWriter::FlushTimeout, this));
+		m_FlushTimer->Start();
+	} else {
+		m_ReconnectTimer = new Timer();
+		m_ReconnectTimer->SetInterval(10);
+		m_ReconnectTimer->SetSlack(1);
+		m_ReconnectTimer->OnTimerExpired.connect(std::bind(&OpenTsdbWriter::ReconnectTimerHandler, this));
+		m_ReconnectTimer->Start();
+		m_ReconnectTimer->Reschedule(0);
+	}
+
+	m_CheckResultQueue = new CheckResultQueue(GetName(), m_WorkQueue, std::bind(&OpenTsdbWriter::CheckResultBatchHandler, this, _1));
+	m_CheckResultQueue->Start();
 }
 
 void OpenTsdbWriter::Stop(bool runtimeRemoved)
@@ -76,6 +127,20 @@ void OpenTsdbWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "OpentsdbWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	if (m_CheckResultQueue)
+		m_CheckResultQueue->Stop();
+
+	m_WorkQueue.Join();
+
+	if (m_UseHttp) {
+		m_FlushTimer->Stop(true);
+
+		Flush();
+		m_FlushQueue.Join();
+
+		m_HttpClient.Close();
+	}
+
 	ObjectImpl<OpenTsdbWriter>::Stop(runtimeRemoved);
 }
 
@@ -100,20 +165,21 @@ void OpenTsdbWriter::ReconnectTimerHandler()
 	m_Stream = new NetworkStream(socket);
 }
 
-void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr)
+void OpenTsdbWriter::CheckResultBatchHandler(const std::vector<CheckResultEvent>& events)
+{
+	for (const CheckResultEvent& event : events)
+		CheckResultHandler(event.Subject, event.Metrics);
+}
+
+void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const CheckResultMetrics::Ptr& metrics)
 {
 	CONTEXT("Processing check result for '" + checkable->GetName() + "'");
 
-	if (!IcingaApplication::GetInstance()->GetEnablePerfdata() || !checkable->GetEnablePerfdata())
+	if (!metrics->IsPerfdataEnabled())
 		return;
 
-	Service::Ptr service = dynamic_pointer_cast<Service>(checkable);
-	Host::Ptr host;
-
-	if (service)
-		host = service->GetHost();
-	else
-		host = static_pointer_cast<Host>(checkable);
+	const Host::Ptr& host = metrics->GetHost();
+	const Service::Ptr& service = metrics->GetService();
 
 	String metric;
 	std::map<String, String> tags;
@@ -121,25 +187,23 @@ void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 	String escaped_hostName = EscapeTag(host->GetName());
 	tags["host"] = escaped_hostName;
 
-	double ts = cr->GetExecutionEnd();
+	double ts = metrics->GetTimestamp();
 
 	if (service) {
 		String serviceName = service->GetShortName();
 		String escaped_serviceName = EscapeMetric(serviceName);
 		metric = "icinga.service." + escaped_serviceName;
-
-		SendMetric(metric + ".state", tags, service->GetState(), ts);
 	} else {
 		metric = "icinga.host";
-		SendMetric(metric + ".state", tags, host->GetState(), ts);
 	}
 
-	SendMetric(metric + ".state_type", tags, checkable->GetStateType(), ts);
-	SendMetric(metric + ".reachable", tags, checkable->IsReachable(), ts);
-	SendMetric(metric + ".downtime_depth", tags, checkable->GetDowntimeDepth(), ts);
-	SendMetric(metric + ".acknowledgement", tags, checkable->GetAcknowledgement(), ts);
+	SendMetric(metric + ".state", tags, metrics->GetState(), ts);
+	SendMetric(metric + ".state_type", tags, metrics->GetStateType(), ts);
+	SendMetric(metric + ".reachable", tags, metrics->IsReachable(), ts);
+	SendMetric(metric + ".downtime_depth", tags, metrics->GetDowntimeDepth(), ts);
+	SendMetric(metric + ".acknowledgement", tags, metrics->GetAcknowledgement(), ts);
 
-	SendPerfdata(metric, tags, cr, ts);
+	SendPerfdata(metric, tags, metrics, ts);
 
 	metric = "icinga.check";
 
@@ -152,34 +216,22 @@ void OpenTsdbWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 		tags["type"] = "host";
 	}
 
-	SendMetric(metric + ".current_attempt", tags, checkable->GetCheckAttempt(), ts);
-	SendMetric(metric + ".max_check_attempts", tags, checkable->GetMaxCheckAttempts(), ts);
-	SendMetric(metric + ".latency", tags, cr->CalculateLatency(), ts);
-	SendMetric(metric + ".execution_time", tags, cr->CalculateExecutionTime(), ts);
+	SendMetric(metric + ".current_attempt", tags, metrics->GetCheckAttempt(), ts);
+	SendMetric(metric + ".max_check_attempts", tags, metrics->GetMaxCheckAttempts(), ts);
+	SendMetric(metric + ".latency", tags, metrics->GetLatency(), ts);
+	SendMetric(metric + ".execution_time", tags, metrics->GetExecutionTime(), ts);
 }
 
-void OpenTsdbWriter::SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts)
+void OpenTsdbWriter::SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResultMetrics::Ptr& metrics, double ts)
 {
-	Array::Ptr perfdata = cr->GetPerformanceData();
+	Array::Ptr perfdata = metrics->GetPerfdata();
 
 	if (!perfdata)
 		return;
 
 	ObjectLock olock(perfdata);
 	for (const Value& val : perfdata) {
-		PerfdataValue::Ptr pdv;
-
-		if (val.IsObjectType<PerfdataValue>())
-			pdv = val;
-		else {
-			try {
-				pdv = PerfdataValue::Parse(val);
-			} catch (const std::exception&) {
-				Log(LogWarning, "OpenTsdbWriter")
-					<< "Ignoring invalid perfdata value: " << val;
-				continue;
-			}
-		}
+		PerfdataValue::Ptr pdv = val;
 
 		String escaped_key = EscapeMetric(pdv->GetLabel());
 		boost::algorithm::replace_all(escaped_key, "::", ".");
@@ -199,6 +251,11 @@ void OpenTsdbWriter::SendPerfdata(const String& metric, const std::map<String, S
 
 void OpenTsdbWriter::SendMetric(const String& metric, const std::map<String, String>& tags, double value, double ts)
 {
+	if (m_UseHttp) {
+		AddDataPoint(metric, tags, value, ts);
+		return;
+	}
+
 	String tags_string = "";
 	for (const Dictionary::Pair& tag : tags) {
 		tags_string += " " + tag.first + "=" + Convert::ToString(tag.second);
@@ -234,6 +291,179 @@ void OpenTsdbWriter::SendMetric(const String& metric, const std::map<String, Str
 	}
 }
 
+/**
+ * Buffers a data point for the HTTP API. The buffer holds a JSON array
+ * without its closing bracket, which is added when the buffer is flushed.
+ */
+void OpenTsdbWriter::AddDataPoint(const String& metric, const std::map<String, String>& tags, double value, double ts)
+{
+	DictionaryData tagData;
+
+	for (const auto& tag : tags)
+		tagData.emplace_back(tag.first, tag.second);
+
+	String dataPoint = JsonEncode(new Dictionary({
+		{ "metric", metric },
+		{ "timestamp", static_cast<long>(ts) },
+		{ "value", value },
+		{ "tags", new Dictionary(std::move(tagData)) }
+	}));
+
+	Log(LogDebug, "OpenTsdbWriter")
+		<< "Add to metric list: '" << dataPoint << "'.";
+
+	bool flush;
+
+	{
+		boost::mutex::scoped_lock lock(m_DataBufferMutex);
+
+		m_DataBuffer += m_DataBuffer.empty() ? '[' : ',';
+		m_DataBuffer.append(dataPoint.CStr(), dataPoint.GetLength());
+		m_DataBufferItems++;
+
+		flush = static_cast<int>(m_DataBufferItems) >= GetFlushThreshold();
+	}
+
+	// Flush if we've buffered too much to prevent excessive memory use
+	if (flush)
+		Flush();
+}
+
+void OpenTsdbWriter::FlushTimeout()
+{
+	Flush();
+}
+
+void OpenTsdbWriter::Flush()
+{
+	std::string body;
+	size_t items;
+
+	{
+		boost::mutex::scoped_lock lock(m_DataBufferMutex);
+
+		if (m_DataBufferItems == 0)
+			return;
+
+		body.swap(m_DataBuffer);
+		items = m_DataBufferItems;
+		m_DataBufferItems = 0;
+	}
+
+	body += ']';
+
+	Log(LogDebug, "OpenTsdbWriter")
+		<< "Flushing " << items << " data points.";
+
+	/* Sending the data happens on a separate queue so that check results can be processed in the meantime. */
+	m_FlushQueue.Enqueue(std::bind(&OpenTsdbWriter::SendRequest, this, String(std::move(body)), items));
+}
+
+/**
+ * Sends a batch of data points to the /api/put endpoint. The summary in
+ * the response tells us how many of them OpenTSDB accepted.
+ */
+void OpenTsdbWriter::SendRequest(const String& body, size_t items)
+{
+	Url::Ptr url = new Url();
+	url->SetScheme("http");
+	url->SetHost(GetHost());
+	url->SetPort(GetPort());
+
+	std::vector<String> path;
+	path.emplace_back("api");
+	path.emplace_back("put");
+	url->SetPath(path);
+
+	url->AddQueryElement("summary", "true");
+
+	String error;
+
+	KeepAliveRequestResult result = m_HttpClient.SendRequest([&url](HttpRequest& req) {
+		req.RequestMethod = "POST";
+		req.RequestUrl = url;
+		req.AddHeader("Content-Type", "application/json");
+	}, body, [this, items](HttpResponse& resp) {
+		size_t responseSize = resp.GetBodySize();
+		boost::scoped_array<char> buffer(new char[responseSize + 1]);
+		resp.ReadBody(buffer.get(), responseSize);
+		buffer.get()[responseSize] = '\0';
+
+		Dictionary::Ptr summary;
+
+		try {
+			Value result = JsonDecode(buffer.get());
+
+			if (result.IsObjectType<Dictionary>())
+				summary = result;
+		} catch (...) {
+			/* Not a summary, e.g. an error page. */
+		}
+
+		if (!summary || !summary->Contains("success")) {
+			if (resp.StatusCode >= 200 && resp.StatusCode <= 299) {
+				m_DataPointsSent += items;
+			} else {
+				Log(LogWarning, "OpenTsdbWriter")
+					<< "Unexpected response code: " << resp.StatusCode;
+				m_DataPointsFailed += items;
+			}
+
+			return;
+		}
+
+		double success = summary->Get("success");
+		double failed = summary->Get("failed");
+
+		m_DataPointsSent += static_cast<unsigned long>(success);
+		m_DataPointsFailed += static_cast<unsigned long>(failed);
+
+		if (failed > 0) {
+			Log(LogWarning, "OpenTsdbWriter")
+				<< "OpenTSDB rejected " << failed << " of " << items << " data points (response code " << resp.StatusCode << ").";
+		}
+	}, &error);
+
+	switch (result) {
+		case KeepAliveConnectFailed:
+			Log(LogCritical, "OpenTsdbWriter")
+				<< "Can't connect to OpenTSDB TSD on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			break;
+		case KeepAliveWriteFailed:
+			Log(LogCritical, "OpenTsdbWriter")
+				<< "Cannot write to OpenTSDB TSD on host '" << GetHost() << "' port '" << GetPort() << "'.";
+			break;
+		case KeepAliveReadFailed:
+			Log(LogCritical, "OpenTsdbWriter")
+				<< "Failed to parse HTTP response from host '" << GetHost() << "' port '" << GetPort() << "': " << error;
+			break;
+		case KeepAliveResponseIncomplete:
+			Log(LogCritical, "OpenTsdbWriter")
+				<< "Failed to read a complete HTTP response from the OpenTSDB TSD.";
+			break;
+		default:
+			return;
+	}
+
+	m_DataPointsFailed += items;
+}
+
+Stream::Ptr OpenTsdbWriter::ConnectHttp()
+{
+	TcpSocket::Ptr socket = new TcpSocket();
+	socket->Connect(GetHost(), GetPort());
+
+	return new NetworkStream(socket);
+}
+
+void OpenTsdbWriter::ValidateTransport(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<OpenTsdbWriter>::ValidateTransport(lvalue, utils);
+
+	if (lvalue() != "telnet" && lvalue() != "http")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "transport" }, "Transport must be 'telnet' or 'http'."));
+}
+
 /* for metric and tag name rules, see
  * http://opentsdb.net/docs/build/html/user_guide/writing.html#metrics-and-tags
  */
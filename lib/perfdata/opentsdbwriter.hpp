@@ -21,11 +21,16 @@
 #define OPENTSDBWRITER_H
 
 #include "perfdata/opentsdbwriter-ti.hpp"
+#include "perfdata/keepalivehttpclient.hpp"
 #include "icinga/service.hpp"
+#include "icinga/checkresultqueue.hpp"
 #include "base/configobject.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/timer.hpp"
+#include "base/workqueue.hpp"
+#include <atomic>
 #include <fstream>
+#include <memory>
 
 namespace icinga
 {
@@ -43,22 +48,45 @@ public:
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
 
+	void ValidateTransport(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+
 protected:
+	void OnConfigLoaded() override;
 	void Start(bool runtimeCreated) override;
 	void Stop(bool runtimeRemoved) override;
 
 private:
 	Stream::Ptr m_Stream;
+	WorkQueue m_WorkQueue{10000000, 1};
+	CheckResultQueue::Ptr m_CheckResultQueue;
 
 	Timer::Ptr m_ReconnectTimer;
 
-	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
+	/* HTTP API */
+	bool m_UseHttp{false};
+	boost::mutex m_DataBufferMutex;
+	std::string m_DataBuffer;
+	size_t m_DataBufferItems{0};
+	WorkQueue m_FlushQueue{100, 1};
+	Timer::Ptr m_FlushTimer;
+	KeepAliveHttpClient m_HttpClient{std::bind(&OpenTsdbWriter::ConnectHttp, this)};
+	std::atomic<unsigned long> m_DataPointsSent{0};
+	std::atomic<unsigned long> m_DataPointsFailed{0};
+
+	void CheckResultBatchHandler(const std::vector<CheckResultEvent>& events);
+	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResultMetrics::Ptr& metrics);
 	void SendMetric(const String& metric, const std::map<String, String>& tags, double value, double ts);
-	void SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResult::Ptr& cr, double ts);
+	void SendPerfdata(const String& metric, const std::map<String, String>& tags, const CheckResultMetrics::Ptr& metrics, double ts);
 	static String EscapeTag(const String& str);
 	static String EscapeMetric(const String& str);
 
 	void ReconnectTimerHandler();
+
+	void AddDataPoint(const String& metric, const std::map<String, String>& tags, double value, double ts);
+	void FlushTimeout();
+	void Flush();
+	void SendRequest(const String& body, size_t items);
+	Stream::Ptr ConnectHttp();
 };
 
 }
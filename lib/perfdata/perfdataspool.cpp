@@ -0,0 +1,197 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "perfdata/perfdataspool.hpp"
+#include "base/application.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/logger.hpp"
+#include "base/netstring.hpp"
+#include "base/utility.hpp"
+#include <cstdio>
+#include <fstream>
+
+using namespace icinga;
+
+/**
+ * Constructor for the PerfdataSpool class. Batches which are still in the
+ * spool file (e.g. from before a restart) are kept.
+ *
+ * @param path The path of the spool file.
+ * @param maxSize The maximum size of the spool file in bytes.
+ */
+PerfdataSpool::PerfdataSpool(String path, size_t maxSize)
+	: m_Path(std::move(path)), m_MaxSize(maxSize)
+{
+	Utility::MkDirP(Utility::DirName(m_Path), 0750);
+
+	std::ifstream fp(m_Path.CStr(), std::ifstream::binary | std::ifstream::ate);
+
+	if (!fp.good())
+		return;
+
+	m_WriteOffset = static_cast<size_t>(fp.tellg());
+
+	try {
+		if (Utility::PathExists(m_Path + ".pos"))
+			m_ReadOffset = static_cast<size_t>(Convert::ToLong(Utility::LoadJsonFile(m_Path + ".pos")));
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "PerfdataSpool")
+			<< "Could not read spool position from '" << m_Path << ".pos': " << DiagnosticInformation(ex, false);
+	}
+
+	if (m_ReadOffset >= m_WriteOffset)
+		Reset();
+	else
+		Log(LogInformation, "PerfdataSpool")
+			<< "Spool file '" << m_Path << "' contains " << m_WriteOffset - m_ReadOffset << " bytes of unsent data.";
+}
+
+/**
+ * Appends a batch to the spool file.
+ *
+ * @param batch The batch.
+ * @returns true if the batch was spooled, false if the spool is full.
+ */
+bool PerfdataSpool::Append(const String& batch)
+{
+	size_t size = Convert::ToString(batch.GetLength()).GetLength() + batch.GetLength() + 2;
+
+	if (m_WriteOffset + size > m_MaxSize) {
+		m_DroppedBatches++;
+
+		Log(LogWarning, "PerfdataSpool")
+			<< "Spool file '" << m_Path << "' is full, dropping " << batch.GetLength() << " bytes of data.";
+		return false;
+	}
+
+	std::ofstream fp(m_Path.CStr(), std::ofstream::binary | std::ofstream::app);
+
+	if (fp.good())
+		NetString::WriteStringToStream(fp, batch);
+
+	fp.close();
+
+	if (fp.fail()) {
+		m_DroppedBatches++;
+
+		Log(LogWarning, "PerfdataSpool")
+			<< "Could not write to spool file '" << m_Path << "'.";
+		return false;
+	}
+
+	m_WriteOffset += size;
+
+	return true;
+}
+
+/**
+ * Reads the oldest batch from the spool file without removing it.
+ *
+ * @param batch The batch.
+ * @returns true if a batch was read, false if the spool is empty.
+ */
+bool PerfdataSpool::Peek(String *batch)
+{
+	if (IsEmpty())
+		return false;
+
+	std::ifstream fp(m_Path.CStr(), std::ifstream::binary);
+	fp.seekg(m_ReadOffset);
+
+	size_t length = 0, digits = 0;
+	char ch = 0;
+
+	while (fp.get(ch) && ch != ':') {
+		if (ch < '0' || ch > '9' || ++digits > 9)
+			break;
+
+		length = length * 10 + (ch - '0');
+	}
+
+	std::string data(length, '\0');
+
+	if (ch != ':' || digits == 0 || !fp.read(&data[0], length) || !fp.get(ch) || ch != ',') {
+		Log(LogWarning, "PerfdataSpool")
+			<< "Spool file '" << m_Path << "' is corrupt, discarding its contents.";
+
+		Reset();
+		return false;
+	}
+
+	*batch = std::move(data);
+	m_PeekSize = digits + length + 2;
+
+	return true;
+}
+
+/**
+ * Removes the batch which was returned by the last Peek() call.
+ */
+void PerfdataSpool::Pop()
+{
+	m_ReadOffset += m_PeekSize;
+	m_PeekSize = 0;
+
+	if (m_ReadOffset >= m_WriteOffset)
+		Reset();
+	else
+		SaveReadOffset();
+}
+
+bool PerfdataSpool::IsEmpty() const
+{
+	return m_ReadOffset >= m_WriteOffset;
+}
+
+/**
+ * Returns the number of unsent bytes in the spool.
+ */
+size_t PerfdataSpool::GetSize() const
+{
+	return m_WriteOffset - m_ReadOffset;
+}
+
+unsigned long PerfdataSpool::GetDroppedBatches() const
+{
+	return m_DroppedBatches;
+}
+
+String PerfdataSpool::GetSpoolPath(const String& type, const String& name)
+{
+	return Application::GetLocalStateDir() + "/lib/icinga2/spool/perfdata/" + type.ToLower() + "-" + name + ".spool";
+}
+
+void PerfdataSpool::SaveReadOffset()
+{
+	Utility::SaveJsonFile(m_Path + ".pos", 0600, static_cast<double>(m_ReadOffset));
+}
+
+/**
+ * Removes the spool file once all batches have been sent.
+ */
+void PerfdataSpool::Reset()
+{
+	(void) remove(m_Path.CStr());
+	(void) remove((m_Path + ".pos").CStr());
+
+	m_ReadOffset = 0;
+	m_WriteOffset = 0;
+	m_PeekSize = 0;
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef PERFDATASPOOL_H
+#define PERFDATASPOOL_H
+
+#include "base/object.hpp"
+#include "base/string.hpp"
+#include <atomic>
+
+namespace icinga
+{
+
+/**
+ * A bounded on-disk spool for perfdata writers. Batches which can't be sent
+ * while the backend is unavailable are appended to a spool file (as netstrings)
+ * and sent later on. The read position is stored in a separate file so that
+ * batches aren't sent twice after a restart.
+ *
+ * Note: The spool isn't thread-safe, callers must serialize access (e.g. by
+ * using it from a single work queue only).
+ *
+ * @ingroup perfdata
+ */
+class PerfdataSpool final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(PerfdataSpool);
+
+	PerfdataSpool(String path, size_t maxSize);
+
+	bool Append(const String& batch);
+	bool Peek(String *batch);
+	void Pop();
+
+	bool IsEmpty() const;
+	size_t GetSize() const;
+	unsigned long GetDroppedBatches() const;
+
+	static String GetSpoolPath(const String& type, const String& name);
+
+private:
+	String m_Path;
+	size_t m_MaxSize;
+	std::atomic<size_t> m_WriteOffset{0};
+	std::atomic<size_t> m_ReadOffset{0};
+	std::atomic<unsigned long> m_DroppedBatches{0};
+	size_t m_PeekSize{0};
+
+	void SaveReadOffset();
+	void Reset();
+};
+
+}
+
+#endif /* PERFDATASPOOL_H */
@@ -38,11 +38,14 @@ REGISTER_TYPE(PerfdataWriter);
 
 REGISTER_STATSFUNCTION(PerfdataWriter, &PerfdataWriter::StatsFunc);
 
+/* Buffered lines are written by the flush timer unless a buffer grows beyond this size. */
+static const size_t l_PerfdataBufferSize = 4 * 1024 * 1024;
+
 void PerfdataWriter::StatsFunc(const Dictionary::Ptr& status, const Array::Ptr&)
 {
 	DictionaryData nodes;
 
-	for (const PerfdataWriter::Ptr& perfdatawriter : ConfigType::GetObjectsByType<PerfdataWriter>()) {
+	for (const PerfdataWriter::Ptr& perfdatawriter : ConfigType::GetObjectViewByType<PerfdataWriter>()) {
 		nodes.emplace_back(perfdatawriter->GetName(), 1); //add more stats
 	}
 
@@ -63,6 +66,11 @@ void PerfdataWriter::Start(bool runtimeCreated)
 	m_RotationTimer->SetInterval(GetRotationInterval());
 	m_RotationTimer->Start();
 
+	m_FlushTimer = new Timer();
+	m_FlushTimer->OnTimerExpired.connect(std::bind(&PerfdataWriter::FlushTimerHandler, this));
+	m_FlushTimer->SetInterval(1);
+	m_FlushTimer->Start();
+
 	RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
 	RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
 }
@@ -72,6 +80,13 @@ void PerfdataWriter::Stop(bool runtimeRemoved)
 	Log(LogInformation, "PerfdataWriter")
 		<< "'" << GetName() << "' stopped.";
 
+	m_FlushTimer->Stop(true);
+
+	{
+		ObjectLock olock(this);
+		FlushBuffers();
+	}
+
 	ObjectImpl<PerfdataWriter>::Stop(runtimeRemoved);
 }
 
@@ -104,27 +119,76 @@ void PerfdataWriter::CheckResultHandler(const Checkable::Ptr& checkable, const C
 	resolvers.emplace_back("host", host);
 	resolvers.emplace_back("icinga", IcingaApplication::GetInstance());
 
-	if (service) {
-		String line = MacroProcessor::ResolveMacros(GetServiceFormatTemplate(), resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
+	/* Lines are formatted by the thread which processes the check result, only appending them is serialized. */
+	String line = MacroProcessor::ResolveCompiledMacroString(GetCompiledTemplate(!!service), resolvers, cr,
+		nullptr, &PerfdataWriter::EscapeMacroMetric);
 
-		{
-			ObjectLock olock(this);
-			if (!m_ServiceOutputFile.good())
-				return;
+	bool full;
 
-			m_ServiceOutputFile << line << "\n";
-		}
-	} else {
-		String line = MacroProcessor::ResolveMacros(GetHostFormatTemplate(), resolvers, cr, nullptr, &PerfdataWriter::EscapeMacroMetric);
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
 
-		{
-			ObjectLock olock(this);
-			if (!m_HostOutputFile.good())
-				return;
+		std::string& buffer = service ? m_ServiceBuffer : m_HostBuffer;
+		buffer.append(line.CStr(), line.GetLength());
+		buffer += '\n';
 
-			m_HostOutputFile << line << "\n";
-		}
+		full = buffer.size() >= l_PerfdataBufferSize;
+	}
+
+	if (full) {
+		ObjectLock olock(this);
+		FlushBuffers();
+	}
+}
+
+/**
+ * Returns the compiled host or service format template. It is compiled
+ * again when the template was changed at runtime.
+ */
+CompiledMacroString::Ptr PerfdataWriter::GetCompiledTemplate(bool service)
+{
+	String source = service ? GetServiceFormatTemplate() : GetHostFormatTemplate();
+
+	boost::mutex::scoped_lock lock(m_TemplateMutex);
+
+	CompiledMacroString::Ptr& tmpl = service ? m_ServiceTemplate : m_HostTemplate;
+
+	if (!tmpl || tmpl->Source != source)
+		tmpl = MacroProcessor::CompileMacroString(source);
+
+	return tmpl;
+}
+
+/**
+ * Writes the buffered lines to the perfdata files, with one write per file.
+ */
+void PerfdataWriter::FlushBuffers()
+{
+	ASSERT(OwnsLock());
+
+	std::string serviceBuffer, hostBuffer;
+
+	{
+		boost::mutex::scoped_lock lock(m_BufferMutex);
+		serviceBuffer.swap(m_ServiceBuffer);
+		hostBuffer.swap(m_HostBuffer);
+	}
+
+	if (!serviceBuffer.empty() && m_ServiceOutputFile.good()) {
+		m_ServiceOutputFile.write(serviceBuffer.c_str(), serviceBuffer.size());
+		m_ServiceOutputFile.flush();
 	}
+
+	if (!hostBuffer.empty() && m_HostOutputFile.good()) {
+		m_HostOutputFile.write(hostBuffer.c_str(), hostBuffer.size());
+		m_HostOutputFile.flush();
+	}
+}
+
+void PerfdataWriter::FlushTimerHandler()
+{
+	ObjectLock olock(this);
+	FlushBuffers();
 }
 
 void PerfdataWriter::RotateFile(std::ofstream& output, const String& temp_path, const String& perfdata_path)
@@ -154,6 +218,12 @@ void PerfdataWriter::RotateFile(std::ofstream& output, const String& temp_path,
 
 void PerfdataWriter::RotationTimerHandler()
 {
+	{
+		/* Lines which were buffered before the rotation belong into the old files. */
+		ObjectLock olock(this);
+		FlushBuffers();
+	}
+
 	RotateFile(m_ServiceOutputFile, GetServiceTempPath(), GetServicePerfdataPath());
 	RotateFile(m_HostOutputFile, GetHostTempPath(), GetHostPerfdataPath());
 }
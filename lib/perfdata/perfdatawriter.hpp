@@ -22,8 +22,10 @@
 
 #include "perfdata/perfdatawriter-ti.hpp"
 #include "icinga/service.hpp"
+#include "icinga/macroprocessor.hpp"
 #include "base/configobject.hpp"
 #include "base/timer.hpp"
+#include <boost/thread/mutex.hpp>
 #include <fstream>
 
 namespace icinga
@@ -53,6 +55,18 @@ private:
 	void CheckResultHandler(const Checkable::Ptr& checkable, const CheckResult::Ptr& cr);
 	static Value EscapeMacroMetric(const Value& value);
 
+	boost::mutex m_TemplateMutex;
+	CompiledMacroString::Ptr m_HostTemplate;
+	CompiledMacroString::Ptr m_ServiceTemplate;
+	CompiledMacroString::Ptr GetCompiledTemplate(bool service);
+
+	boost::mutex m_BufferMutex;
+	std::string m_HostBuffer;
+	std::string m_ServiceBuffer;
+	Timer::Ptr m_FlushTimer;
+	void FlushTimerHandler();
+	void FlushBuffers();
+
 	Timer::Ptr m_RotationTimer;
 	void RotationTimerHandler();
 
@@ -117,6 +117,31 @@ struct PgsqlInterfaceImpl final : public PgsqlInterface
 	{
 		return PQstatus(conn);
 	}
+
+	int putCopyData(PGconn *conn, const char *buffer, int nbytes) const override
+	{
+		return PQputCopyData(conn, buffer, nbytes);
+	}
+
+	int putCopyEnd(PGconn *conn, const char *errormsg) const override
+	{
+		return PQputCopyEnd(conn, errormsg);
+	}
+
+	PGresult *getResult(PGconn *conn) const override
+	{
+		return PQgetResult(conn);
+	}
+
+	PGresult *prepare(PGconn *conn, const char *stmtName, const char *query, int nParams, const Oid *paramTypes) const override
+	{
+		return PQprepare(conn, stmtName, query, nParams, paramTypes);
+	}
+
+	PGresult *execPrepared(PGconn *conn, const char *stmtName, int nParams, const char * const *paramValues, const int *paramLengths, const int *paramFormats, int resultFormat) const override
+	{
+		return PQexecPrepared(conn, stmtName, nParams, paramValues, paramLengths, paramFormats, resultFormat);
+	}
 };
 
 PgsqlInterface *create_pgsql_shim()
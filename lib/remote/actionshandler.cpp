@@ -21,14 +21,66 @@
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
 #include "remote/apiaction.hpp"
+#include "base/application.hpp"
 #include "base/exception.hpp"
 #include "base/logger.hpp"
+#include "base/workqueue.hpp"
+#include <map>
 #include <set>
 
 using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/actions", ActionsHandler);
 
+/* Smaller batches aren't worth spreading across threads. */
+static const size_t l_BatchEntriesPerChunk = 64;
+
+static Value InvokeAction(const ApiAction::Ptr& action, const ConfigObject::Ptr& obj, const Dictionary::Ptr& params, bool verbose)
+{
+	try {
+		return action->Invoke(obj, params);
+	} catch (const std::exception& ex) {
+		Dictionary::Ptr fail = new Dictionary({
+			{ "code", 500 },
+			{ "status", "Action execution failed: '" + DiagnosticInformation(ex, false) + "'." }
+		});
+
+		/* Exception for actions. Normally we would handle this inside SendJsonError(). */
+		if (verbose)
+			fail->Set("diagnostic_information", DiagnosticInformation(ex));
+
+		return fail;
+	}
+}
+
+/**
+ * Looks up the target object of a batch entry by its name.
+ */
+static ConfigObject::Ptr GetBatchTarget(const std::vector<String>& types, const Dictionary::Ptr& entry)
+{
+	for (const String& type : types) {
+		String attr = type.ToLower();
+
+		if (!entry->Contains(attr))
+			continue;
+
+		String name = HttpUtility::GetLastParameter(entry, attr);
+
+		/* Services may also be specified by their host and short name. */
+		if (attr == "service" && name.Find("!") == String::NPos && entry->Contains("host"))
+			name = HttpUtility::GetLastParameter(entry, "host") + "!" + name;
+
+		ConfigObject::Ptr object = ConfigObject::GetObject(type, name);
+
+		if (!object)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Object '" + name + "' of type '" + type + "' does not exist."));
+
+		return object;
+	}
+
+	BOOST_THROW_EXCEPTION(std::invalid_argument("No target object specified."));
+}
+
 bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
 {
 	if (request.RequestUrl->GetPath().size() != 3)
@@ -46,6 +98,11 @@ bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& reques
 		return true;
 	}
 
+	if (params && params->Contains("batch")) {
+		HandleBatch(user, action, actionName, response, params);
+		return true;
+	}
+
 	QueryDescription qd;
 
 	const std::vector<String>& types = action->GetTypes();
@@ -81,22 +138,151 @@ bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& reques
 		verbose = HttpUtility::GetLastParameter(params, "verbose");
 
 	for (const ConfigObject::Ptr& obj : objs) {
+		results.emplace_back(InvokeAction(action, obj, params, verbose));
+	}
+
+	SendResults(response, params, std::move(results));
+
+	return true;
+}
+
+/**
+ * Runs an action for a batch of objects, e.g. many passive check results with one request.
+ * Entries for different objects are processed in parallel, entries for the same
+ * object in the order in which they were specified.
+ */
+void ActionsHandler::HandleBatch(const ApiUser::Ptr& user, const ApiAction::Ptr& action, const String& actionName,
+	HttpResponse& response, const Dictionary::Ptr& params)
+{
+	const std::vector<String>& types = action->GetTypes();
+
+	if (types.empty()) {
+		HttpUtility::SendJsonError(response, params, 400, "Action '" + actionName + "' does not support batches.");
+		return;
+	}
+
+	Value vbatch = params->Get("batch");
+
+	if (!vbatch.IsObjectType<Array>()) {
+		HttpUtility::SendJsonError(response, params, 400, "Parameter 'batch' must be an array.");
+		return;
+	}
+
+	Array::Ptr batch = vbatch;
+
+	Expression *permissionFilterPtr;
+
+	try {
+		FilterUtility::CheckPermission(user, "actions/" + actionName, &permissionFilterPtr);
+	} catch (const std::exception& ex) {
+		HttpUtility::SendJsonError(response, params, 404,
+			"No objects found.",
+			DiagnosticInformation(ex));
+		return;
+	}
+
+	std::unique_ptr<Expression> permissionFilter(permissionFilterPtr);
+
+	bool verbose = HttpUtility::GetLastParameter(params, "verbose");
+
+	/* Parameters which aren't specified for an entry are taken from the request. */
+	Dictionary::Ptr defaults = params->ShallowClone();
+	defaults->Remove("batch");
+
+	ArrayData entries;
+
+	{
+		ObjectLock olock(batch);
+		entries = ArrayData(batch->Begin(), batch->End());
+	}
+
+	ArrayData results(entries.size());
+	std::vector<Dictionary::Ptr> entryParams(entries.size());
+	std::vector<ConfigObject::Ptr> targets(entries.size());
+
+	/* Entries grouped by their target object */
+	std::vector<std::vector<size_t> > groups;
+	std::map<ConfigObject *, size_t> groupIndex;
+
+	ScriptFrame permissionFrame(true);
+
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (!entries[i].IsObjectType<Dictionary>()) {
+			results[i] = new Dictionary({
+				{ "code", 400 },
+				{ "status", "Batch entries must be dictionaries." }
+			});
+			continue;
+		}
+
+		Dictionary::Ptr entry = entries[i];
+		Dictionary::Ptr entryParam = defaults->ShallowClone();
+		entry->CopyTo(entryParam);
+
+		ConfigObject::Ptr target;
+
 		try {
-			results.emplace_back(action->Invoke(obj, params));
+			target = GetBatchTarget(types, entryParam);
+
+			if (!FilterUtility::EvaluateFilter(permissionFrame, permissionFilter.get(), target))
+				BOOST_THROW_EXCEPTION(ScriptError("Access denied to object '" + target->GetName() + "'"));
 		} catch (const std::exception& ex) {
-			Dictionary::Ptr fail = new Dictionary({
-				{ "code", 500 },
-				{ "status", "Action execution failed: '" + DiagnosticInformation(ex, false) + "'." }
+			results[i] = new Dictionary({
+				{ "code", 404 },
+				{ "status", "No objects found: " + DiagnosticInformation(ex, false) }
 			});
+			continue;
+		}
 
-			/* Exception for actions. Normally we would handle this inside SendJsonError(). */
-			if (verbose)
-				fail->Set("diagnostic_information", DiagnosticInformation(ex));
+		auto it = groupIndex.find(target.get());
 
-			results.emplace_back(std::move(fail));
+		if (it == groupIndex.end()) {
+			it = groupIndex.insert(std::make_pair(target.get(), groups.size())).first;
+			groups.emplace_back();
 		}
+
+		groups[it->second].push_back(i);
+
+		entryParams[i] = std::move(entryParam);
+		targets[i] = std::move(target);
+	}
+
+	Log(LogNotice, "ApiActionHandler")
+		<< "Running action " << actionName << " for a batch of " << entries.size() << " objects";
+
+	auto processGroups = [&action, &groups, &targets, &entryParams, &results, verbose](size_t begin, size_t end) {
+		for (size_t g = begin; g < end; g++) {
+			for (size_t i : groups[g])
+				results[i] = InvokeAction(action, targets[i], entryParams[i], verbose);
+		}
+	};
+
+	size_t chunks = std::min<size_t>(Application::GetConcurrency(), entries.size() / l_BatchEntriesPerChunk);
+	chunks = std::min(chunks, groups.size());
+
+	if (chunks < 2) {
+		processGroups(0, groups.size());
+	} else {
+		std::vector<size_t> indices(chunks);
+
+		for (size_t i = 0; i < chunks; i++)
+			indices[i] = i;
+
+		WorkQueue upq(25000, static_cast<int>(chunks));
+		upq.SetName("ActionsHandler");
+
+		upq.ParallelFor(indices, [&groups, &processGroups, chunks](size_t i) {
+			processGroups(groups.size() * i / chunks, groups.size() * (i + 1) / chunks);
+		});
+
+		upq.Join();
 	}
 
+	SendResults(response, params, std::move(results));
+}
+
+void ActionsHandler::SendResults(HttpResponse& response, const Dictionary::Ptr& params, ArrayData&& results)
+{
 	int statusCode = 500;
 	String statusMessage = "No action executed successfully";
 
@@ -115,6 +301,4 @@ bool ActionsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& reques
 	});
 
 	HttpUtility::SendJsonBody(response, params, result);
-
-	return true;
 }
@@ -21,6 +21,7 @@
 #define ACTIONSHANDLER_H
 
 #include "remote/httphandler.hpp"
+#include "remote/apiaction.hpp"
 
 namespace icinga
 {
@@ -32,6 +33,11 @@ public:
 
 	bool HandleRequest(const ApiUser::Ptr& user, HttpRequest& request,
 		HttpResponse& response, const Dictionary::Ptr& params) override;
+
+private:
+	static void HandleBatch(const ApiUser::Ptr& user, const ApiAction::Ptr& action, const String& actionName,
+		HttpResponse& response, const Dictionary::Ptr& params);
+	static void SendResults(HttpResponse& response, const Dictionary::Ptr& params, ArrayData&& results);
 };
 
 }
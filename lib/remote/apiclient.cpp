@@ -95,7 +95,7 @@ void ApiClient::ExecuteScriptHttpCompletionCallback(HttpRequest& request,
 				DebugInfo di;
 				Dictionary::Ptr debugInfo = resultInfo->Get("debug_info");
 				if (debugInfo) {
-					di.Path = debugInfo->Get("path");
+					di.Path = static_cast<String>(debugInfo->Get("path"));
 					di.FirstLine = debugInfo->Get("first_line");
 					di.FirstColumn = debugInfo->Get("first_column");
 					di.LastLine = debugInfo->Get("last_line");
@@ -31,6 +31,7 @@ using namespace icinga;
 
 REGISTER_APIFUNCTION(UpdateObject, config, &ApiListener::ConfigUpdateObjectAPIHandler);
 REGISTER_APIFUNCTION(DeleteObject, config, &ApiListener::ConfigDeleteObjectAPIHandler);
+REGISTER_APIFUNCTION(RuntimeObjectsSynced, config, &ApiListener::RuntimeObjectsSyncedAPIHandler);
 
 INITIALIZE_ONCE([]() {
 	ConfigObject::OnActiveChanged.connect(&ApiListener::ConfigUpdateObjectHandler);
@@ -44,6 +45,8 @@ void ApiListener::ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, con
 	if (!listener)
 		return;
 
+	listener->UpdateRuntimeObjectChange(object);
+
 	if (object->IsActive()) {
 		/* Sync object config */
 		listener->UpdateConfigObject(object, cookie);
@@ -340,7 +343,7 @@ void ApiListener::UpdateConfigObject(const ConfigObject::Ptr& object, const Mess
 #endif /* I2_DEBUG */
 
 	if (client)
-		JsonRpc::SendMessage(client->GetStream(), message);
+		client->SendMessage(message);
 	else {
 		Zone::Ptr target = static_pointer_cast<Zone>(object->GetZone());
 
@@ -390,7 +393,7 @@ void ApiListener::DeleteConfigObject(const ConfigObject::Ptr& object, const Mess
 #endif /* I2_DEBUG */
 
 	if (client)
-		JsonRpc::SendMessage(client->GetStream(), message);
+		client->SendMessage(message);
 	else {
 		Zone::Ptr target = static_pointer_cast<Zone>(object->GetZone());
 
@@ -402,6 +405,24 @@ void ApiListener::DeleteConfigObject(const ConfigObject::Ptr& object, const Mess
 }
 
 /* Initial sync on connect for new endpoints */
+/**
+ * Remembers when an object which is synced as a runtime object changed.
+ */
+void ApiListener::UpdateRuntimeObjectChange(const ConfigObject::Ptr& object)
+{
+	boost::mutex::scoped_lock lock(m_RuntimeObjectChangesMutex);
+
+	if (!object->IsActive())
+		m_RuntimeObjectChanges.erase(object);
+	else if (object->GetPackage() == "_api" || object->GetVersion() != 0)
+		m_RuntimeObjectChanges[object] = Utility::GetTime();
+}
+
+/**
+ * Sends the runtime objects to an endpoint. Endpoints which announce the
+ * position of the last sync they received in their hello message only get
+ * the objects which have changed since then.
+ */
 void ApiListener::SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient)
 {
 	Endpoint::Ptr endpoint = aclient->GetEndpoint();
@@ -409,8 +430,27 @@ void ApiListener::SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient
 
 	Zone::Ptr azone = endpoint->GetZone();
 
+	aclient->WaitForHello(5);
+
+	double syncStart = Utility::GetTime();
+	double position = aclient->GetRuntimeObjectsPosition();
+
+	/* We don't know what has changed before we were started. */
+	if (position < m_RuntimeObjectChangesSince)
+		position = 0;
+
+	std::map<ConfigObject::Ptr, double> changes;
+
+	if (position > 0) {
+		boost::mutex::scoped_lock lock(m_RuntimeObjectChangesMutex);
+		changes = m_RuntimeObjectChanges;
+	}
+
 	Log(LogInformation, "ApiListener")
-		<< "Syncing runtime objects to endpoint '" << endpoint->GetName() << "'.";
+		<< "Syncing runtime objects to endpoint '" << endpoint->GetName() << "'"
+		<< (position > 0 ? " (changed since " + Utility::FormatDateTime("%Y-%m-%d %H:%M:%S %z", position) + ")." : ".");
+
+	size_t count = 0;
 
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
@@ -418,16 +458,52 @@ void ApiListener::SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
 			/* don't sync objects for non-matching parent-child zones */
 			if (!azone->CanAccessObject(object))
 				continue;
 
+			/* the endpoint already has the current version */
+			if (position > 0) {
+				auto it = changes.find(object);
+
+				if (it == changes.end() || it->second <= position)
+					continue;
+			}
+
 			/* send the config object to the connected client */
 			UpdateConfigObject(object, nullptr, aclient);
+			count++;
 		}
 	}
 
+	/* Endpoints which don't announce a position can't handle this message. */
+	if (aclient->GetRuntimeObjectsPosition() >= 0) {
+		aclient->SendMessage(new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "config::RuntimeObjectsSynced" },
+			{ "params", new Dictionary({
+				{ "position", syncStart }
+			}) }
+		}));
+	}
+
 	Log(LogInformation, "ApiListener")
-		<< "Finished syncing runtime objects to endpoint '" << endpoint->GetName() << "'.";
+		<< "Finished syncing " << count << " runtime objects to endpoint '" << endpoint->GetName() << "'.";
+}
+
+Value ApiListener::RuntimeObjectsSyncedAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener || !origin->FromClient->GetEndpoint())
+		return Empty;
+
+	/* Objects are ignored without accept_config, make sure we get all of them once it's enabled. */
+	if (!listener->GetAcceptConfig())
+		return Empty;
+
+	origin->FromClient->SetPendingRuntimeObjectsPosition(params->Get("position"));
+
+	return Empty;
 }
@@ -24,12 +24,64 @@
 #include "base/logger.hpp"
 #include "base/convert.hpp"
 #include "base/exception.hpp"
+#include "base/tlsutility.hpp"
 #include <fstream>
 #include <iomanip>
+#include <algorithm>
+#include <sys/stat.h>
 
 using namespace icinga;
 
 REGISTER_APIFUNCTION(Update, config, &ApiListener::ConfigUpdateHandler);
+REGISTER_APIFUNCTION(Manifest, config, &ApiListener::ConfigManifestHandler);
+REGISTER_APIFUNCTION(RequestFiles, config, &ApiListener::ConfigRequestFilesHandler);
+REGISTER_APIFUNCTION(UpdateFiles, config, &ApiListener::ConfigUpdateFilesHandler);
+
+/* Maximum number of content bytes per config::UpdateFiles message. */
+static const size_t l_ConfigChunkSize = 1024 * 1024;
+
+struct FileHashCacheEntry
+{
+	time_t MTime;
+	off_t Size;
+	String Hash;
+};
+
+static boost::mutex l_FileHashCacheMutex;
+static std::map<String, FileHashCacheEntry> l_FileHashCache;
+
+/**
+ * Returns the SHA256 hash of a file's content. Hashes are cached
+ * until the file's modification time or size changes.
+ */
+static String GetFileHash(const String& path)
+{
+	struct stat statbuf;
+
+	if (stat(path.CStr(), &statbuf) < 0)
+		return String();
+
+	{
+		boost::mutex::scoped_lock lock(l_FileHashCacheMutex);
+
+		auto it = l_FileHashCache.find(path);
+
+		if (it != l_FileHashCache.end() && it->second.MTime == statbuf.st_mtime && it->second.Size == statbuf.st_size)
+			return it->second.Hash;
+	}
+
+	std::ifstream fp(path.CStr(), std::ifstream::binary);
+	if (!fp)
+		return String();
+
+	String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+	String hash = SHA256(content);
+
+	boost::mutex::scoped_lock lock(l_FileHashCacheMutex);
+	l_FileHashCache[path] = { statbuf.st_mtime, statbuf.st_size, hash };
+
+	return hash;
+}
 
 void ApiListener::ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file)
 {
@@ -216,7 +268,7 @@ void ApiListener::SyncZoneDir(const Zone::Ptr& zone) const
 
 void ApiListener::SyncZoneDirs() const
 {
-	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+	for (const Zone::Ptr& zone : ConfigType::GetObjectViewByType<Zone>()) {
 		try {
 			SyncZoneDir(zone);
 		} catch (const std::exception&) {
@@ -237,12 +289,11 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 	if (!azone->IsChildOf(lzone))
 		return;
 
-	Dictionary::Ptr configUpdateV1 = new Dictionary();
-	Dictionary::Ptr configUpdateV2 = new Dictionary();
-
 	String zonesDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
 
-	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+	std::vector<Zone::Ptr> zones;
+
+	for (const Zone::Ptr& zone : ConfigType::GetObjectViewByType<Zone>()) {
 		String zoneDir = zonesDir + "/" + zone->GetName();
 
 		if (!zone->IsChildOf(azone) && !zone->IsGlobal())
@@ -251,6 +302,19 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 		if (!Utility::PathExists(zoneDir))
 			continue;
 
+		zones.push_back(zone);
+	}
+
+	/* Older versions don't answer our hello message and only understand config::Update. */
+	if (aclient->WaitForHello(5) && aclient->GetConfigManifest()) {
+		SendConfigManifest(aclient, zones);
+		return;
+	}
+
+	Dictionary::Ptr configUpdateV1 = new Dictionary();
+	Dictionary::Ptr configUpdateV2 = new Dictionary();
+
+	for (const Zone::Ptr& zone : zones) {
 		Log(LogInformation, "ApiListener")
 			<< "Syncing configuration files for " << (zone->IsGlobal() ? "global " : "")
 			<< "zone '" << zone->GetName() << "' to endpoint '" << endpoint->GetName() << "'.";
@@ -272,6 +336,48 @@ void ApiListener::SendConfigUpdate(const JsonRpcConnection::Ptr& aclient)
 	aclient->SendMessage(message);
 }
 
+/**
+ * Sends the hashes of all files in the zones' config directories. The
+ * endpoint then requests the files it doesn't have yet using config::RequestFiles.
+ */
+void ApiListener::SendConfigManifest(const JsonRpcConnection::Ptr& aclient, const std::vector<Zone::Ptr>& zones)
+{
+	Endpoint::Ptr endpoint = aclient->GetEndpoint();
+
+	String zonesDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
+
+	Dictionary::Ptr manifest = new Dictionary();
+
+	for (const Zone::Ptr& zone : zones) {
+		String zoneDir = zonesDir + "/" + zone->GetName();
+
+		Dictionary::Ptr hashes = new Dictionary();
+
+		Utility::GlobRecursive(zoneDir, "*", [&zoneDir, &hashes](const String& file) {
+			String hash = GetFileHash(file);
+
+			if (!hash.IsEmpty())
+				hashes->Set(file.SubStr(zoneDir.GetLength()), hash);
+		}, GlobFile);
+
+		Log(LogInformation, "ApiListener")
+			<< "Sending hashes for " << hashes->GetLength() << " configuration files of " << (zone->IsGlobal() ? "global " : "")
+			<< "zone '" << zone->GetName() << "' to endpoint '" << endpoint->GetName() << "'.";
+
+		manifest->Set(zone->GetName(), hashes);
+	}
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::Manifest" },
+		{ "params", new Dictionary({
+			{ "zones", manifest }
+		}) }
+	});
+
+	aclient->SendMessage(message);
+}
+
 Value ApiListener::ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
 {
 	if (!origin->FromClient->GetEndpoint() || (origin->FromZone && !Zone::GetLocalZone()->IsChildOf(origin->FromZone)))
@@ -339,3 +445,362 @@ Value ApiListener::ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const D
 
 	return Empty;
 }
+
+Value ApiListener::ConfigManifestHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	if (!origin->FromClient->GetEndpoint() || (origin->FromZone && !Zone::GetLocalZone()->IsChildOf(origin->FromZone)))
+		return Empty;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener) {
+		Log(LogCritical, "ApiListener", "No instance available.");
+		return Empty;
+	}
+
+	if (!listener->GetAcceptConfig()) {
+		Log(LogWarning, "ApiListener")
+			<< "Ignoring config update. '" << listener->GetName() << "' does not accept config.";
+		return Empty;
+	}
+
+	String endpointName = origin->FromClient->GetEndpoint()->GetName();
+
+	Dictionary::Ptr zones = params->Get("zones");
+
+	if (!zones)
+		return Empty;
+
+	Dictionary::Ptr manifest = new Dictionary();
+	Dictionary::Ptr requests = new Dictionary();
+	size_t numRequested = 0;
+
+	{
+		ObjectLock olock(zones);
+		for (const Dictionary::Pair& kv : zones) {
+			Zone::Ptr zone = Zone::GetByName(kv.first);
+
+			if (!zone) {
+				Log(LogWarning, "ApiListener")
+					<< "Ignoring config update for unknown zone '" << kv.first << "'.";
+				continue;
+			}
+
+			if (ConfigCompiler::HasZoneConfigAuthority(kv.first)) {
+				Log(LogWarning, "ApiListener")
+					<< "Ignoring config update for zone '" << kv.first << "' because we have an authoritative version of the zone's config.";
+				continue;
+			}
+
+			Dictionary::Ptr hashes = kv.second;
+
+			if (!hashes)
+				continue;
+
+			String oldDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones/" + zone->GetName();
+
+			Array::Ptr paths = new Array();
+
+			{
+				ObjectLock hlock(hashes);
+				for (const Dictionary::Pair& hkv : hashes) {
+					if (hkv.first.Find("..") != String::NPos) {
+						Log(LogWarning, "ApiListener")
+							<< "Ignoring config update for zone '" << kv.first << "' because it contains the invalid path '" << hkv.first << "'.";
+						paths = nullptr;
+						break;
+					}
+
+					if (GetFileHash(oldDir + hkv.first) != hkv.second)
+						paths->Add(hkv.first);
+				}
+			}
+
+			if (!paths)
+				continue;
+
+			manifest->Set(kv.first, hashes);
+
+			if (paths->GetLength() > 0) {
+				requests->Set(kv.first, paths);
+				numRequested += paths->GetLength();
+			}
+		}
+	}
+
+	Log(LogInformation, "ApiListener")
+		<< "Received config manifest from endpoint '" << endpointName << "' of zone '" << GetFromZoneName(origin->FromZone)
+		<< "'. Requesting " << numRequested << " changed configuration files.";
+
+	if (numRequested == 0) {
+		bool configChange = false;
+
+		/* Files may have been removed even though none were added or changed. */
+		ObjectLock olock(manifest);
+		for (const Dictionary::Pair& kv : manifest) {
+			if (ApplyConfigFiles(kv.first, kv.second, new Dictionary()))
+				configChange = true;
+		}
+
+		if (configChange) {
+			Log(LogInformation, "ApiListener", "Restarting after configuration change.");
+			Application::RequestRestart();
+		}
+
+		return Empty;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(listener->m_PendingConfigUpdatesMutex);
+		listener->m_PendingConfigUpdates[endpointName] = { manifest, new Dictionary() };
+	}
+
+	Dictionary::Ptr message = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "config::RequestFiles" },
+		{ "params", new Dictionary({
+			{ "zones", requests }
+		}) }
+	});
+
+	origin->FromClient->SendMessage(message);
+
+	return Empty;
+}
+
+Value ApiListener::ConfigRequestFilesHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	Endpoint::Ptr endpoint = origin->FromClient->GetEndpoint();
+
+	if (!endpoint)
+		return Empty;
+
+	Zone::Ptr azone = endpoint->GetZone();
+	Zone::Ptr lzone = Zone::GetLocalZone();
+
+	if (!azone->IsChildOf(lzone))
+		return Empty;
+
+	Dictionary::Ptr zones = params->Get("zones");
+
+	if (!zones)
+		return Empty;
+
+	String zonesDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones";
+
+	Array::Ptr entries = new Array();
+	size_t messageBytes = 0;
+	size_t totalBytes = 0;
+
+	auto sendEntries = [&origin, &entries, &messageBytes](bool complete) {
+		Dictionary::Ptr message = new Dictionary({
+			{ "jsonrpc", "2.0" },
+			{ "method", "config::UpdateFiles" },
+			{ "params", new Dictionary({
+				{ "files", entries },
+				{ "complete", complete }
+			}) }
+		});
+
+		origin->FromClient->SendMessage(message);
+
+		entries = new Array();
+		messageBytes = 0;
+	};
+
+	{
+		ObjectLock olock(zones);
+		for (const Dictionary::Pair& kv : zones) {
+			Zone::Ptr zone = Zone::GetByName(kv.first);
+
+			if (!zone || (!zone->IsChildOf(azone) && !zone->IsGlobal())) {
+				Log(LogWarning, "ApiListener")
+					<< "Ignoring config file request from endpoint '" << endpoint->GetName() << "' for zone '" << kv.first << "'.";
+				continue;
+			}
+
+			Array::Ptr paths = kv.second;
+
+			if (!paths)
+				continue;
+
+			ObjectLock plock(paths);
+			for (const String& path : paths) {
+				if (path.Find("..") != String::NPos) {
+					Log(LogWarning, "ApiListener")
+						<< "Ignoring invalid config file request for path '" << path << "' from endpoint '" << endpoint->GetName() << "'.";
+					continue;
+				}
+
+				std::ifstream fp((zonesDir + "/" + zone->GetName() + path).CStr(), std::ifstream::binary);
+				if (!fp)
+					continue;
+
+				String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+
+				size_t offset = 0;
+
+				/* Large files are split across several messages. */
+				do {
+					size_t length = std::min(content.GetLength() - offset, l_ConfigChunkSize - messageBytes);
+
+					entries->Add(new Array({ zone->GetName(), path, static_cast<double>(offset), content.SubStr(offset, length) }));
+					messageBytes += length;
+					offset += length;
+
+					if (messageBytes >= l_ConfigChunkSize)
+						sendEntries(false);
+				} while (offset < content.GetLength());
+
+				totalBytes += content.GetLength();
+			}
+		}
+	}
+
+	sendEntries(true);
+
+	Log(LogInformation, "ApiListener")
+		<< "Sent " << totalBytes << " Bytes of changed configuration files to endpoint '" << endpoint->GetName() << "'.";
+
+	return Empty;
+}
+
+Value ApiListener::ConfigUpdateFilesHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
+{
+	if (!origin->FromClient->GetEndpoint() || (origin->FromZone && !Zone::GetLocalZone()->IsChildOf(origin->FromZone)))
+		return Empty;
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+
+	if (!listener)
+		return Empty;
+
+	String endpointName = origin->FromClient->GetEndpoint()->GetName();
+
+	PendingConfigUpdate update;
+
+	{
+		boost::mutex::scoped_lock lock(listener->m_PendingConfigUpdatesMutex);
+
+		auto it = listener->m_PendingConfigUpdates.find(endpointName);
+
+		if (it == listener->m_PendingConfigUpdates.end()) {
+			Log(LogWarning, "ApiListener")
+				<< "Ignoring unexpected config files from endpoint '" << endpointName << "'.";
+			return Empty;
+		}
+
+		update = it->second;
+
+		if (params->Get("complete").ToBool())
+			listener->m_PendingConfigUpdates.erase(it);
+	}
+
+	Array::Ptr entries = params->Get("files");
+
+	if (entries) {
+		ObjectLock olock(entries);
+		for (const Array::Ptr& entry : entries) {
+			String zoneName = entry->Get(0);
+			String path = entry->Get(1);
+			size_t offset = entry->Get(2);
+			String content = entry->Get(3);
+
+			Dictionary::Ptr files = update.Files->Get(zoneName);
+
+			if (!files) {
+				files = new Dictionary();
+				update.Files->Set(zoneName, files);
+			}
+
+			String current = files->Get(path);
+
+			if (offset != current.GetLength()) {
+				Log(LogWarning, "ApiListener")
+					<< "Discarding config update from endpoint '" << endpointName << "': Received chunk for file '"
+					<< path << "' at unexpected offset " << offset << ".";
+
+				boost::mutex::scoped_lock lock(listener->m_PendingConfigUpdatesMutex);
+				listener->m_PendingConfigUpdates.erase(endpointName);
+				return Empty;
+			}
+
+			files->Set(path, current + content);
+		}
+	}
+
+	if (!params->Get("complete").ToBool())
+		return Empty;
+
+	Log(LogInformation, "ApiListener")
+		<< "Applying config update from endpoint '" << endpointName
+		<< "' of zone '" << GetFromZoneName(origin->FromZone) << "'.";
+
+	bool configChange = false;
+
+	ObjectLock olock(update.Manifest);
+	for (const Dictionary::Pair& kv : update.Manifest) {
+		Dictionary::Ptr files = update.Files->Get(kv.first);
+
+		if (!files)
+			files = new Dictionary();
+
+		if (ApplyConfigFiles(kv.first, kv.second, files))
+			configChange = true;
+	}
+
+	if (configChange) {
+		Log(LogInformation, "ApiListener", "Restarting after configuration change.");
+		Application::RequestRestart();
+	}
+
+	return Empty;
+}
+
+/**
+ * Builds the zone's new config from the received files and the unchanged
+ * local files listed in the manifest and writes it to the zone's directory.
+ *
+ * @returns true if the config has changed.
+ */
+bool ApiListener::ApplyConfigFiles(const String& zoneName, const Dictionary::Ptr& manifest, const Dictionary::Ptr& files)
+{
+	String oldDir = Application::GetLocalStateDir() + "/lib/icinga2/api/zones/" + zoneName;
+
+	Utility::MkDirP(oldDir, 0700);
+
+	ConfigDirInformation oldConfigInfo = LoadConfigDir(oldDir);
+	Dictionary::Ptr oldConfig = MergeConfigUpdate(oldConfigInfo);
+
+	ConfigDirInformation newConfigInfo;
+	newConfigInfo.UpdateV1 = new Dictionary();
+	newConfigInfo.UpdateV2 = new Dictionary();
+
+	ObjectLock olock(manifest);
+	for (const Dictionary::Pair& kv : manifest) {
+		String content;
+
+		if (files->Contains(kv.first)) {
+			content = files->Get(kv.first);
+
+			if (SHA256(content) != kv.second) {
+				Log(LogWarning, "ApiListener")
+					<< "Discarding config update for zone '" << zoneName << "': Checksum mismatch for file '" << kv.first << "'.";
+				return false;
+			}
+		} else if (oldConfig->Contains(kv.first)) {
+			content = oldConfig->Get(kv.first);
+		} else {
+			Log(LogWarning, "ApiListener")
+				<< "Discarding config update for zone '" << zoneName << "': File '" << kv.first << "' is missing.";
+			return false;
+		}
+
+		if (Utility::Match("*.conf", kv.first))
+			newConfigInfo.UpdateV1->Set(kv.first, content);
+		else
+			newConfigInfo.UpdateV2->Set(kv.first, content);
+	}
+
+	return UpdateConfigDir(oldConfigInfo, newConfigInfo, oldDir, false);
+}
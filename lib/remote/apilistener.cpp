@@ -23,6 +23,8 @@
 #include "remote/endpoint.hpp"
 #include "remote/jsonrpc.hpp"
 #include "remote/apifunction.hpp"
+#include "remote/eventqueue.hpp"
+#include "remote/httphandler.hpp"
 #include "base/convert.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
@@ -35,7 +37,9 @@
 #include "base/context.hpp"
 #include "base/statsfunction.hpp"
 #include "base/exception.hpp"
+#include "base/mappedfile.hpp"
 #include <fstream>
+#include <cstring>
 
 using namespace icinga;
 
@@ -48,7 +52,36 @@ REGISTER_STATSFUNCTION(ApiListener, &ApiListener::StatsFunc);
 
 REGISTER_APIFUNCTION(Hello, icinga, &ApiListener::HelloAPIHandler);
 
+INITIALIZE_ONCE([]() {
+	auto invalidateRelayRoutes = []() {
+		ApiListener::Ptr listener = ApiListener::GetInstance();
+
+		if (listener)
+			listener->InvalidateRelayRoutes();
+	};
+
+	Endpoint::OnConnected.connect(std::bind(invalidateRelayRoutes));
+	Endpoint::OnDisconnected.connect(std::bind(invalidateRelayRoutes));
+	Zone::OnEndpointsRawChanged.connect(std::bind(invalidateRelayRoutes));
+
+	ConfigObject::OnActiveChanged.connect([invalidateRelayRoutes](const ConfigObject::Ptr& object, const Value&) {
+		if (dynamic_pointer_cast<Zone>(object) || dynamic_pointer_cast<Endpoint>(object))
+			invalidateRelayRoutes();
+	});
+});
+
+/**
+ * An entry in a replay log's index file. All messages in the log file before
+ * the offset are not newer than the timestamp.
+ */
+struct ReplayLogIndexEntry
+{
+	double Timestamp;
+	uint_least64_t Offset;
+};
+
 ApiListener::ApiListener()
+	: m_RuntimeObjectChangesSince(Utility::GetTime())
 {
 	m_RelayQueue.SetName("ApiListener, RelayQueue");
 	m_SyncQueue.SetName("ApiListener, SyncQueue");
@@ -187,7 +220,14 @@ void ApiListener::UpdateSSLContext()
 
 	m_SSLContext = context;
 
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+	UpdateSessionTicketKeys();
+
+	{
+		boost::mutex::scoped_lock lock(m_TlsSessionsMutex);
+		m_TlsSessions.clear();
+	}
+
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectViewByType<Endpoint>()) {
 		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
 			client->Disconnect();
 		}
@@ -224,6 +264,13 @@ void ApiListener::Start(bool runtimeCreated)
 		OpenLogFile();
 	}
 
+	m_LogWriterStop = false;
+	m_LogWriterThread = boost::thread(std::bind(&ApiListener::LogWriterThreadProc, this));
+
+	HttpHandler::SetConcurrencyLimit(HttpHandlerQuery, GetHttpQueryConcurrency());
+	HttpHandler::SetConcurrencyLimit(HttpHandlerAction, GetHttpActionConcurrency());
+	HttpHandler::SetConcurrencyLimit(HttpHandlerConfig, GetHttpConfigConcurrency());
+
 	/* create the primary JSON-RPC listener */
 	if (!AddListener(GetBindHost(), GetBindPort())) {
 		Log(LogCritical, "ApiListener")
@@ -240,6 +287,7 @@ void ApiListener::Start(bool runtimeCreated)
 	m_ReconnectTimer = new Timer();
 	m_ReconnectTimer->OnTimerExpired.connect(std::bind(&ApiListener::ApiReconnectTimerHandler, this));
 	m_ReconnectTimer->SetInterval(60);
+	m_ReconnectTimer->SetSlack(1);
 	m_ReconnectTimer->Start();
 	m_ReconnectTimer->Reschedule(0);
 
@@ -254,6 +302,11 @@ void ApiListener::Start(bool runtimeCreated)
 	m_CleanupCertificateRequestsTimer->Start();
 	m_CleanupCertificateRequestsTimer->Reschedule(0);
 
+	m_SessionTicketKeysTimer = new Timer();
+	m_SessionTicketKeysTimer->OnTimerExpired.connect(std::bind(&ApiListener::UpdateSessionTicketKeys, this));
+	m_SessionTicketKeysTimer->SetInterval(3600);
+	m_SessionTicketKeysTimer->Start();
+
 	OnMasterChanged(true);
 }
 
@@ -264,7 +317,17 @@ void ApiListener::Stop(bool runtimeDeleted)
 	Log(LogInformation, "ApiListener")
 		<< "'" << GetName() << "' stopped.";
 
+	{
+		boost::mutex::scoped_lock lock(m_LogQueueMutex);
+		m_LogWriterStop = true;
+		m_LogQueueCV.notify_all();
+	}
+
+	if (m_LogWriterThread.joinable())
+		m_LogWriterThread.join();
+
 	boost::mutex::scoped_lock lock(m_LogLock);
+	ProcessLogQueue();
 	CloseLogFile();
 }
 
@@ -421,6 +484,50 @@ void ApiListener::NewClientHandler(const Socket::Ptr& client, const String& host
 	}
 }
 
+/**
+ * Waits until a new TLS handshake may be started. The handshakes are done by
+ * the socket I/O threads which also handle all established connections, so
+ * only a few of them may run at the same time. Otherwise reconnect storms
+ * would starve the existing connections.
+ *
+ * @returns false if too many handshakes are waiting already.
+ */
+bool ApiListener::BeginHandshake()
+{
+	static const int maxActive = std::max(2, Application::GetConcurrency());
+	static const int maxPending = 1024;
+
+	boost::mutex::scoped_lock lock(m_HandshakeMutex);
+
+	if (m_PendingHandshakes >= maxPending) {
+		m_RejectedHandshakes++;
+		return false;
+	}
+
+	m_PendingHandshakes++;
+
+	while (m_ActiveHandshakes >= maxActive)
+		m_HandshakeCV.wait(lock);
+
+	m_PendingHandshakes--;
+	m_ActiveHandshakes++;
+
+	return true;
+}
+
+void ApiListener::EndHandshake(double waitTime, double latency)
+{
+	boost::mutex::scoped_lock lock(m_HandshakeMutex);
+
+	m_ActiveHandshakes--;
+
+	/* Exponential moving averages */
+	m_HandshakeWaitTime = m_HandshakeWaitTime * 0.9 + waitTime * 0.1;
+	m_HandshakeLatency = m_HandshakeLatency * 0.9 + latency * 0.1;
+
+	m_HandshakeCV.notify_one();
+}
+
 /**
  * Processes a new client connection.
  *
@@ -452,15 +559,40 @@ void ApiListener::NewClientHandlerInternal(const Socket::Ptr& client, const Stri
 		}
 	}
 
+	/* Try to resume the previous session with this endpoint to avoid a full handshake. */
+	if (role == RoleClient && !hostname.IsEmpty()) {
+		boost::mutex::scoped_lock lock(m_TlsSessionsMutex);
+
+		auto it = m_TlsSessions.find(hostname);
+
+		if (it != m_TlsSessions.end())
+			tlsStream->SetSession(it->second);
+	}
+
+	double queued = Utility::GetTime();
+
+	if (!BeginHandshake()) {
+		Log(LogWarning, "ApiListener")
+			<< "Too many pending TLS handshakes, dropping connection (" << conninfo << ")";
+		tlsStream->Close();
+		return;
+	}
+
+	double started = Utility::GetTime();
+
 	try {
 		tlsStream->Handshake();
 	} catch (const std::exception&) {
+		EndHandshake(started - queued, Utility::GetTime() - started);
+
 		Log(LogCritical, "ApiListener")
 			<< "Client TLS handshake failed (" << conninfo << ")";
 		tlsStream->Close();
 		return;
 	}
 
+	EndHandshake(started - queued, Utility::GetTime() - started);
+
 	std::shared_ptr<X509> cert = tlsStream->GetPeerCertificate();
 	String identity;
 	Endpoint::Ptr endpoint;
@@ -494,6 +626,15 @@ void ApiListener::NewClientHandlerInternal(const Socket::Ptr& client, const Stri
 		if (verify_ok)
 			endpoint = Endpoint::GetByName(identity);
 
+		if (role == RoleClient && !hostname.IsEmpty()) {
+			boost::mutex::scoped_lock lock(m_TlsSessionsMutex);
+
+			if (verify_ok)
+				m_TlsSessions[hostname] = tlsStream->GetSession();
+			else
+				m_TlsSessions.erase(hostname);
+		}
+
 		{
 			Log log(LogInformation, "ApiListener");
 
@@ -515,7 +656,14 @@ void ApiListener::NewClientHandlerInternal(const Socket::Ptr& client, const Stri
 		Dictionary::Ptr message = new Dictionary({
 			{ "jsonrpc", "2.0" },
 			{ "method", "icinga::Hello" },
-			{ "params", new Dictionary() }
+			{ "params", new Dictionary({
+				{ "binary_messages", true },
+				{ "config_manifest", true },
+				{ "check_result_batches", true },
+				{ "execute_command_batches", true },
+				{ "agent_scheduling", GetAcceptCommands() },
+				{ "runtime_objects_position", endpoint ? endpoint->GetRuntimeObjectsPosition() : 0 }
+			}) }
 		});
 
 		JsonRpc::SendMessage(tlsStream, message);
@@ -651,14 +799,10 @@ void ApiListener::ApiTimerHandler()
 {
 	double now = Utility::GetTime();
 
-	std::vector<int> files;
-	Utility::Glob(GetApiDir() + "log/*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
-	std::sort(files.begin(), files.end());
-
-	for (int ts : files) {
+	for (int ts : GetLogFiles()) {
 		bool need = false;
 
-		for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+		for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectViewByType<Endpoint>()) {
 			if (endpoint == GetLocalEndpoint())
 				continue;
 
@@ -671,15 +815,20 @@ void ApiListener::ApiTimerHandler()
 			}
 		}
 
-		if (!need) {
-			String path = GetApiDir() + "log/" + Convert::ToString(ts);
-			Log(LogNotice, "ApiListener")
-				<< "Removing old log file: " << path;
-			(void)unlink(path.CStr());
-		}
+		/* Newer files are needed as well, the files are sorted by timestamp. */
+		if (need)
+			break;
+
+		String path = GetApiDir() + "log/" + Convert::ToString(ts);
+		Log(LogNotice, "ApiListener")
+			<< "Removing old log file: " << path;
+		(void)unlink(path.CStr());
+		(void)unlink((path + ".idx").CStr());
+
+		RemoveLogFile(ts);
 	}
 
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectViewByType<Endpoint>()) {
 		if (!endpoint->GetConnected())
 			continue;
 
@@ -720,7 +869,7 @@ void ApiListener::ApiReconnectTimerHandler()
 {
 	Zone::Ptr my_zone = Zone::GetLocalZone();
 
-	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+	for (const Zone::Ptr& zone : ConfigType::GetObjectViewByType<Zone>()) {
 		/* don't connect to global zones */
 		if (zone->GetGlobal())
 			continue;
@@ -777,7 +926,7 @@ void ApiListener::ApiReconnectTimerHandler()
 			<< "Current zone master: " << master->GetName();
 
 	std::vector<String> names;
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>())
+	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectViewByType<Endpoint>())
 		if (endpoint->GetConnected())
 			names.emplace_back(endpoint->GetName() + " (" + Convert::ToString(endpoint->GetClients().size()) + ")");
 
@@ -801,6 +950,22 @@ static void CleanupCertificateRequest(const String& path, double expiryTime)
 		(void) unlink(path.CStr());
 }
 
+/**
+ * Loads the session ticket keys and replaces them once a day. The keys are
+ * persisted so that clients can resume their sessions after a restart.
+ */
+void ApiListener::UpdateSessionTicketKeys()
+{
+	std::shared_ptr<SSL_CTX> context = m_SSLContext;
+
+	try {
+		SetSessionTicketKeysToSSLContext(context, GetCertsDir() + "/session-tickets.key", 24 * 60 * 60);
+	} catch (const std::exception& ex) {
+		Log(LogWarning, "ApiListener")
+			<< "Cannot update TLS session ticket keys: " << DiagnosticInformation(ex, false);
+	}
+}
+
 void ApiListener::CleanupCertificateRequestsTimerHandler()
 {
 	String requestsDir = GetCertificateRequestsDir();
@@ -821,16 +986,17 @@ void ApiListener::RelayMessage(const MessageOrigin::Ptr& origin,
 	m_RelayQueue.Enqueue(std::bind(&ApiListener::SyncRelayMessage, this, origin, secobj, message, log), PriorityNormal, true);
 }
 
-void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj)
+void ApiListener::PersistMessage(const EncodedMessage::Ptr& message, const ConfigObject::Ptr& secobj)
 {
-	double ts = message->Get("ts");
+	double ts = message->GetMessage()->Get("ts");
 
 	ASSERT(ts != 0);
 
 	Dictionary::Ptr pmessage = new Dictionary();
 	pmessage->Set("timestamp", ts);
 
-	pmessage->Set("message", JsonEncode(message));
+	/* The replay log always uses JSON, replayed messages are sent as they are. */
+	pmessage->Set("message", message->GetJson());
 
 	if (secobj) {
 		Dictionary::Ptr secname = new Dictionary();
@@ -839,27 +1005,137 @@ void ApiListener::PersistMessage(const Dictionary::Ptr& message, const ConfigObj
 		pmessage->Set("secobj", secname);
 	}
 
-	boost::mutex::scoped_lock lock(m_LogLock);
-	if (m_LogFile) {
-		NetString::WriteStringToStream(m_LogFile, JsonEncode(pmessage));
+	String encoded = JsonEncode(pmessage);
+
+	/* The message is written by the log writer thread. */
+	boost::mutex::scoped_lock lock(m_LogQueueMutex);
+	m_LogQueue.emplace_back(std::move(encoded), ts);
+	m_LogQueueCV.notify_one();
+}
+
+void ApiListener::LogWriterThreadProc()
+{
+	Utility::SetThreadName("API Log Writer");
+
+	for (;;) {
+		{
+			boost::mutex::scoped_lock lock(m_LogQueueMutex);
+
+			while (m_LogQueue.empty() && !m_LogWriterStop)
+				m_LogQueueCV.wait(lock);
+
+			if (m_LogWriterStop)
+				break;
+		}
+
+		boost::mutex::scoped_lock lock(m_LogLock);
+		ProcessLogQueue();
+	}
+}
+
+/**
+ * Writes all queued messages to the replay log as one batch.
+ *
+ * Note: Caller must hold m_LogLock.
+ */
+void ApiListener::ProcessLogQueue()
+{
+	std::vector<std::pair<String, double> > messages;
+
+	{
+		boost::mutex::scoped_lock lock(m_LogQueueMutex);
+		std::swap(messages, m_LogQueue);
+	}
+
+	if (messages.empty() || !m_LogFile)
+		return;
+
+	for (const auto& message : messages) {
+		/* Add a sparse index entry which allows replaying to skip all messages up to this offset. */
+		if (m_LogIndexFile && m_LogMessageCount % 100 == 0) {
+			ReplayLogIndexEntry entry = { m_LogMaxTimestamp, m_LogFileOffset };
+			m_LogIndexFile->Write(&entry, sizeof(entry));
+		}
+
+		m_LogFileOffset += NetString::WriteStringToStream(m_LogFile, message.first);
 		m_LogMessageCount++;
-		SetLogMessageTimestamp(ts);
+		m_LogMaxTimestamp = std::max(m_LogMaxTimestamp, message.second);
 
 		if (m_LogMessageCount > 50000) {
 			CloseLogFile();
 			RotateLogFile();
 			OpenLogFile();
+
+			if (!m_LogFile)
+				break;
 		}
 	}
+
+	SetLogMessageTimestamp(messages.back().second);
+
+	m_LogWriteStats.InsertValue(Utility::GetTime(), messages.size());
+
+	if (!m_LogFile)
+		return;
+
+	m_LogFile->Flush();
+
+	String policy = GetLogSyncPolicy();
+	double now = Utility::GetTime();
+
+	if (policy == "batch" || (policy == "interval" && m_LogLastSync < now - 1)) {
+		SyncLogFile();
+		m_LogLastSync = now;
+	}
+}
+
+/**
+ * Makes sure that the replay log's content has been written to disk.
+ *
+ * Note: Caller must hold m_LogLock.
+ */
+void ApiListener::SyncLogFile()
+{
+	String path = GetApiDir() + "log/current";
+
+#ifndef _WIN32
+	int fd = open(path.CStr(), O_RDONLY);
+
+	if (fd < 0)
+		return;
+
+	(void) fsync(fd);
+	close(fd);
+#else /* _WIN32 */
+	HANDLE handle = CreateFile(path.CStr(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return;
+
+	(void) FlushFileBuffers(handle);
+	CloseHandle(handle);
+#endif /* _WIN32 */
+}
+
+size_t ApiListener::GetLogQueueLength()
+{
+	boost::mutex::scoped_lock lock(m_LogQueueMutex);
+	return m_LogQueue.size();
 }
 
 void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message)
+{
+	SyncSendMessage(endpoint, new EncodedMessage(message));
+}
+
+void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const EncodedMessage::Ptr& message)
 {
 	ObjectLock olock(endpoint);
 
 	if (!endpoint->GetSyncing()) {
 		Log(LogNotice, "ApiListener")
-			<< "Sending message '" << message->Get("method") << "' to '" << endpoint->GetName() << "'";
+			<< "Sending message '" << message->GetMessage()->Get("method") << "' to '" << endpoint->GetName() << "'";
 
 		double maxTs = 0;
 
@@ -877,51 +1153,108 @@ void ApiListener::SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionar
 	}
 }
 
-bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentMaster)
+/**
+ * Returns the endpoints a message for an object in the zone is relayed to:
+ * the zone itself and all its parents, as far as they are the local zone,
+ * its parent or one of its direct child zones. Global zones are relayed to
+ * the local zone and all of its child zones.
+ */
+std::shared_ptr<const RelayRoute> ApiListener::GetRelayRoute(const Zone::Ptr& targetZone)
 {
 	ASSERT(targetZone);
 
-	Zone::Ptr myZone = Zone::GetLocalZone();
+	uint_fast64_t generation;
 
-	/* only relay the message to a) the same zone, b) the parent zone and c) direct child zones. Exception is a global zone. */
-	if (!targetZone->GetGlobal() &&
-		targetZone != myZone &&
-		targetZone != myZone->GetParent() &&
-		targetZone->GetParent() != myZone) {
-		return true;
+	{
+		boost::mutex::scoped_lock lock(m_RelayRoutesMutex);
+
+		auto it = m_RelayRoutes.find(targetZone);
+
+		if (it != m_RelayRoutes.end())
+			return it->second;
+
+		generation = m_RelayRoutesGeneration;
 	}
 
+	auto route = std::make_shared<RelayRoute>();
+	route->Master = GetMaster();
+
+	Zone::Ptr myZone = Zone::GetLocalZone();
 	Endpoint::Ptr myEndpoint = GetLocalEndpoint();
 
-	std::vector<Endpoint::Ptr> skippedEndpoints;
+	std::vector<Zone::Ptr> zones = targetZone->GetAllParents();
+	zones.insert(zones.begin(), targetZone);
 
-	bool relayed = false, log_needed = false, log_done = false;
+	for (const Zone::Ptr& zone : zones) {
+		/* only relay the message to a) the same zone, b) the parent zone and c) direct child zones. Exception is a global zone. */
+		if (!zone->GetGlobal() &&
+			zone != myZone &&
+			zone != myZone->GetParent() &&
+			zone->GetParent() != myZone) {
+			continue;
+		}
 
-	std::set<Endpoint::Ptr> targetEndpoints;
+		std::set<Endpoint::Ptr> targetEndpoints;
 
-	if (targetZone->GetGlobal()) {
-		targetEndpoints = myZone->GetEndpoints();
+		if (zone->GetGlobal()) {
+			targetEndpoints = myZone->GetEndpoints();
 
-		for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
-			/* Fetch immediate child zone members */
-			if (zone->GetParent() == myZone) {
-				std::set<Endpoint::Ptr> endpoints = zone->GetEndpoints();
-				targetEndpoints.insert(endpoints.begin(), endpoints.end());
+			for (const Zone::Ptr& childZone : ConfigType::GetObjectViewByType<Zone>()) {
+				/* Fetch immediate child zone members */
+				if (childZone->GetParent() == myZone) {
+					std::set<Endpoint::Ptr> endpoints = childZone->GetEndpoints();
+					targetEndpoints.insert(endpoints.begin(), endpoints.end());
+				}
 			}
+		} else {
+			targetEndpoints = zone->GetEndpoints();
 		}
-	} else {
-		targetEndpoints = targetZone->GetEndpoints();
+
+		RelayHop hop;
+		hop.TargetZone = zone;
+
+		for (const Endpoint::Ptr& endpoint : targetEndpoints) {
+			/* don't relay messages to ourselves */
+			if (endpoint != myEndpoint)
+				hop.Targets.emplace_back(endpoint, endpoint->GetConnected());
+		}
+
+		if (!hop.Targets.empty())
+			route->Hops.emplace_back(std::move(hop));
 	}
 
-	for (const Endpoint::Ptr& endpoint : targetEndpoints) {
-		/* don't relay messages to ourselves */
-		if (endpoint == GetLocalEndpoint())
-			continue;
+	boost::mutex::scoped_lock lock(m_RelayRoutesMutex);
+
+	/* Don't keep a route which may already be outdated. */
+	if (generation == m_RelayRoutesGeneration)
+		m_RelayRoutes[targetZone] = route;
+
+	return route;
+}
+
+void ApiListener::InvalidateRelayRoutes()
+{
+	boost::mutex::scoped_lock lock(m_RelayRoutesMutex);
+
+	m_RelayRoutes.clear();
+	m_RelayRoutesGeneration++;
+}
 
-		log_needed = true;
+bool ApiListener::RelayMessageOne(const RelayHop& hop, const MessageOrigin::Ptr& origin, const EncodedMessage::Ptr& message, const Endpoint::Ptr& currentMaster)
+{
+	Zone::Ptr myZone = Zone::GetLocalZone();
+	Endpoint::Ptr myEndpoint = GetLocalEndpoint();
+	const Zone::Ptr& targetZone = hop.TargetZone;
+
+	std::vector<Endpoint::Ptr> skippedEndpoints;
+
+	bool relayed = false, log_done = false;
+
+	for (const auto& target : hop.Targets) {
+		const Endpoint::Ptr& endpoint = target.first;
 
 		/* don't relay messages to disconnected endpoints */
-		if (!endpoint->GetConnected()) {
+		if (!target.second) {
 			if (targetZone == myZone)
 				log_done = false;
 
@@ -960,13 +1293,13 @@ bool ApiListener::RelayMessageOne(const Zone::Ptr& targetZone, const MessageOrig
 	}
 
 	if (!skippedEndpoints.empty()) {
-		double ts = message->Get("ts");
+		double ts = message->GetMessage()->Get("ts");
 
 		for (const Endpoint::Ptr& endpoint : skippedEndpoints)
 			endpoint->SetLocalLogPosition(ts);
 	}
 
-	return !log_needed || log_done;
+	return log_done;
 }
 
 void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
@@ -993,17 +1326,20 @@ void ApiListener::SyncRelayMessage(const MessageOrigin::Ptr& origin,
 	if (!target_zone)
 		target_zone = Zone::GetLocalZone();
 
-	Endpoint::Ptr master = GetMaster();
+	std::shared_ptr<const RelayRoute> route = GetRelayRoute(target_zone);
 
-	bool need_log = !RelayMessageOne(target_zone, origin, message, master);
+	/* The message is complete now, encode it only once for all endpoints and the replay log. */
+	EncodedMessage::Ptr emessage = new EncodedMessage(message);
 
-	for (const Zone::Ptr& zone : target_zone->GetAllParents()) {
-		if (!RelayMessageOne(zone, origin, message, master))
+	bool need_log = false;
+
+	for (const RelayHop& hop : route->Hops) {
+		if (!RelayMessageOne(hop, origin, emessage, route->Master))
 			need_log = true;
 	}
 
 	if (log && need_log)
-		PersistMessage(message, secobj);
+		PersistMessage(emessage, secobj);
 }
 
 /* must hold m_LogLock */
@@ -1021,9 +1357,27 @@ void ApiListener::OpenLogFile()
 		return;
 	}
 
+	fp->seekp(0, std::ios_base::end);
+
 	m_LogFile = new StdioStream(fp, true);
+	m_LogFileOffset = fp->tellp();
 	m_LogMessageCount = 0;
-	SetLogMessageTimestamp(Utility::GetTime());
+
+	/* Messages which are already in the file are older than this. */
+	m_LogMaxTimestamp = Utility::GetTime();
+	SetLogMessageTimestamp(m_LogMaxTimestamp);
+
+	auto *ifp = new std::fstream((path + ".idx").CStr(), std::fstream::out | std::fstream::app | std::fstream::binary);
+
+	if (!ifp->good()) {
+		delete ifp;
+
+		Log(LogWarning, "ApiListener")
+			<< "Could not open spool index file: " << path << ".idx";
+		return;
+	}
+
+	m_LogIndexFile = new StdioStream(ifp, true);
 }
 
 /* must hold m_LogLock */
@@ -1034,6 +1388,11 @@ void ApiListener::CloseLogFile()
 
 	m_LogFile->Close();
 	m_LogFile.reset();
+
+	if (m_LogIndexFile) {
+		m_LogIndexFile->Close();
+		m_LogIndexFile.reset();
+	}
 }
 
 /* must hold m_LogLock */
@@ -1046,14 +1405,47 @@ void ApiListener::RotateLogFile()
 
 	String oldpath = GetApiDir() + "log/current";
 	String newpath = GetApiDir() + "log/" + Convert::ToString(static_cast<int>(ts)+1);
-	(void) rename(oldpath.CStr(), newpath.CStr());
+
+	if (rename(oldpath.CStr(), newpath.CStr()) == 0) {
+		boost::mutex::scoped_lock lock(m_LogFilesMutex);
+
+		if (m_LogFilesLoaded)
+			m_LogFiles.insert(static_cast<int>(ts)+1);
+	}
+
+	(void) rename((oldpath + ".idx").CStr(), (newpath + ".idx").CStr());
+}
+
+/**
+ * Returns the timestamps of the rotated log files in ascending order. Only
+ * the first call has to look at the log directory.
+ */
+std::vector<int> ApiListener::GetLogFiles()
+{
+	boost::mutex::scoped_lock lock(m_LogFilesMutex);
+
+	if (!m_LogFilesLoaded) {
+		std::vector<int> files;
+		Utility::Glob(GetApiDir() + "log/*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
+
+		m_LogFiles.insert(files.begin(), files.end());
+		m_LogFilesLoaded = true;
+	}
+
+	return std::vector<int>(m_LogFiles.begin(), m_LogFiles.end());
+}
+
+void ApiListener::RemoveLogFile(int ts)
+{
+	boost::mutex::scoped_lock lock(m_LogFilesMutex);
+	m_LogFiles.erase(ts);
 }
 
 void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
 {
 	String name = Utility::BaseName(file);
 
-	if (name == "current")
+	if (name == "current" || name.Contains(".idx"))
 		return;
 
 	int ts;
@@ -1067,6 +1459,53 @@ void ApiListener::LogGlobHandler(std::vector<int>& files, const String& file)
 	files.push_back(ts);
 }
 
+/**
+ * Looks up the offset in a replay log file from which on messages might be
+ * newer than the specified timestamp.
+ *
+ * @param indexPath The path of the log file's index.
+ * @param peer_ts The timestamp.
+ * @returns The offset or 0 if there's no usable index.
+ */
+uint_least64_t ApiListener::GetLogReplayOffset(const String& indexPath, double peer_ts)
+{
+	if (!Utility::PathExists(indexPath))
+		return 0;
+
+	MappedFile::Ptr index;
+
+	try {
+		index = new MappedFile(indexPath);
+	} catch (const std::exception&) {
+		return 0;
+	}
+
+	size_t count = index->GetSize() / sizeof(ReplayLogIndexEntry);
+
+	auto getEntry = [&index](size_t i) {
+		ReplayLogIndexEntry entry;
+		memcpy(&entry, index->GetData() + i * sizeof(entry), sizeof(entry));
+		return entry;
+	};
+
+	/* The timestamps in the index are increasing, find the last entry which isn't newer than peer_ts. */
+	size_t lower = 0, upper = count;
+
+	while (lower < upper) {
+		size_t middle = lower + (upper - lower) / 2;
+
+		if (getEntry(middle).Timestamp <= peer_ts)
+			lower = middle + 1;
+		else
+			upper = middle;
+	}
+
+	if (lower == 0)
+		return 0;
+
+	return getEntry(lower - 1).Offset;
+}
+
 void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 {
 	Endpoint::Ptr endpoint = client->GetEndpoint();
@@ -1079,6 +1518,12 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 
 	CONTEXT("Replaying log for Endpoint '" + endpoint->GetName() + "'");
 
+	/* Don't read the log faster than the endpoint takes it, queued messages count towards max_send_queue_size. */
+	size_t maxQueueSize = 16 * 1024 * 1024;
+
+	if (GetMaxSendQueueSize() > 0)
+		maxQueueSize = std::min<size_t>(maxQueueSize, GetMaxSendQueueSize() / 2);
+
 	int count = -1;
 	double peer_ts = endpoint->GetLocalLogPosition();
 	double logpos_ts = peer_ts;
@@ -1098,6 +1543,9 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 	for (;;) {
 		boost::mutex::scoped_lock lock(m_LogLock);
 
+		/* Make sure that messages which are still queued are replayed as well. */
+		ProcessLogQueue();
+
 		CloseLogFile();
 		RotateLogFile();
 
@@ -1110,11 +1558,7 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 
 		count = 0;
 
-		std::vector<int> files;
-		Utility::Glob(GetApiDir() + "log/*", std::bind(&ApiListener::LogGlobHandler, std::ref(files), _1), GlobFile);
-		std::sort(files.begin(), files.end());
-
-		for (int ts : files) {
+		for (int ts : GetLogFiles()) {
 			String path = GetApiDir() + "log/" + Convert::ToString(ts);
 
 			if (ts < peer_ts)
@@ -1123,22 +1567,38 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 			Log(LogNotice, "ApiListener")
 				<< "Replaying log: " << path;
 
-			auto *fp = new std::fstream(path.CStr(), std::fstream::in | std::fstream::binary);
-			StdioStream::Ptr logStream = new StdioStream(fp, true);
+			MappedFile::Ptr logFile;
+
+			try {
+				logFile = new MappedFile(path);
+			} catch (const std::exception& ex) {
+				Log(LogWarning, "ApiListener")
+					<< "Could not open cluster log '" << path << "': " << DiagnosticInformation(ex, false);
+				continue;
+			}
+
+			/* Skip the messages the endpoint has already seen. */
+			uint_least64_t offset = GetLogReplayOffset(path + ".idx", peer_ts);
+
+			if (offset > logFile->GetSize())
+				offset = 0;
 
 			String message;
-			StreamReadContext src;
 			while (true) {
 				Dictionary::Ptr pmessage;
 
 				try {
-					StreamReadStatus srs = NetString::ReadStringFromStream(logStream, &message, src);
+					size_t length = NetString::ReadStringFromBuffer(logFile->GetData() + offset, logFile->GetSize() - offset, &message);
+
+					if (length == 0) {
+						if (offset != logFile->GetSize())
+							Log(LogWarning, "ApiListener")
+								<< "Unexpected end-of-file for cluster log: " << path;
 
-					if (srs == StatusEof)
 						break;
+					}
 
-					if (srs != StatusNewItem)
-						continue;
+					offset += length;
 
 					pmessage = JsonDecode(message);
 				} catch (const std::exception&) {
@@ -1164,9 +1624,14 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 						continue;
 				}
 
+				/* The log lock is held for the last round, it's short enough not to wait. */
+				if (!last_sync)
+					client->WaitForSendQueue(maxQueueSize);
+
 				try  {
-					size_t bytesSent = NetString::WriteStringToStream(client->GetStream(), pmessage->Get("message"));
-					endpoint->AddMessageSent(bytesSent);
+					/* Replayed messages must stay in order with later events: the peer's
+					 * log position is the newest timestamp it has seen, see ReplayLog(). */
+					client->SendRawMessage(pmessage->Get("message"), MessagePriorityLive);
 					count++;
 				} catch (const std::exception& ex) {
 					Log(LogWarning, "ApiListener")
@@ -1191,12 +1656,10 @@ void ApiListener::ReplayLog(const JsonRpcConnection::Ptr& client)
 						}) }
 					});
 
-					size_t bytesSent = JsonRpc::SendMessage(client->GetStream(), lmessage);
-					endpoint->AddMessageSent(bytesSent);
+					/* The log position must not overtake the messages it refers to. */
+					client->SendMessage(lmessage, MessagePriorityLive);
 				}
 			}
-
-			logStream->Close();
 		}
 
 		if (count > 0) {
@@ -1251,8 +1714,9 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	Zone::Ptr my_zone = Zone::GetLocalZone();
 
 	Dictionary::Ptr connectedZones = new Dictionary();
+	Dictionary::Ptr sendQueues = new Dictionary();
 
-	for (const Zone::Ptr& zone : ConfigType::GetObjectsByType<Zone>()) {
+	for (const Zone::Ptr& zone : ConfigType::GetObjectViewByType<Zone>()) {
 		/* only check endpoints in a) the same zone b) our parent zone c) immediate child zones */
 		if (my_zone != zone && my_zone != zone->GetParent() && zone != my_zone->GetParent()) {
 			Log(LogDebug, "ApiListener")
@@ -1285,6 +1749,20 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 			} else {
 				allConnectedEndpoints->Add(endpoint->GetName());
 				zoneConnected = true;
+
+				/* per-lane send queue depth, summed over all connections of the endpoint */
+				Dictionary::Ptr endpointQueues = new Dictionary();
+
+				for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
+					Dictionary::Ptr clientQueues = client->GetSendQueueStatus();
+
+					ObjectLock olock(clientQueues);
+					for (const Dictionary::Pair& kv : clientQueues) {
+						endpointQueues->Set(kv.first, endpointQueues->Get(kv.first) + kv.second);
+					}
+				}
+
+				sendQueues->Set(endpoint->GetName(), endpointQueues);
 			}
 		}
 
@@ -1317,6 +1795,43 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	double workQueueItemRate = JsonRpcConnection::GetWorkQueueRate();
 	double syncQueueItemRate = m_SyncQueue.GetTaskCount(60) / 60.0;
 	double relayQueueItemRate = m_RelayQueue.GetTaskCount(60) / 60.0;
+	size_t logQueueItems = GetLogQueueLength();
+	double logWriteRate = m_LogWriteStats.CalculateRate(Utility::GetTime(), 60);
+
+	/* TLS session resumption and handshake stats */
+	Dictionary::Ptr tlsStats = TlsStream::GetHandshakeStats();
+
+	{
+		boost::mutex::scoped_lock lock(m_HandshakeMutex);
+
+		tlsStats->Set("handshakes_active", m_ActiveHandshakes);
+		tlsStats->Set("handshakes_pending", m_PendingHandshakes);
+		tlsStats->Set("handshakes_rejected", m_RejectedHandshakes);
+		tlsStats->Set("handshake_latency", m_HandshakeLatency);
+		tlsStats->Set("handshake_wait_time", m_HandshakeWaitTime);
+	}
+
+	/* event stream stats */
+	Dictionary::Ptr eventQueues = new Dictionary();
+	double eventQueueItems = 0, eventQueueDropped = 0, eventQueueMaxAge = 0;
+
+	for (const auto& kv : EventQueueRegistry::GetInstance()->GetItems()) {
+		Dictionary::Ptr queueStats = kv.second->GetStatus();
+		eventQueueDropped += queueStats->Get("dropped");
+
+		Array::Ptr clients = queueStats->Get("clients");
+
+		ObjectLock olock(clients);
+		for (const Dictionary::Ptr& client : clients) {
+			eventQueueItems += client->Get("queue_items");
+			eventQueueMaxAge = std::max<double>(eventQueueMaxAge, client->Get("oldest_event_age"));
+		}
+
+		eventQueues->Set(kv.first, queueStats);
+	}
+
+	/* HTTP request class stats */
+	Dictionary::Ptr httpHandlers = HttpHandler::GetStatus();
 
 	Dictionary::Ptr status = new Dictionary({
 		{ "identity", GetIdentity() },
@@ -1336,12 +1851,19 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 			{ "relay_queue_items", relayQueueItems },
 			{ "work_queue_item_rate", workQueueItemRate },
 			{ "sync_queue_item_rate", syncQueueItemRate },
-			{ "relay_queue_item_rate", relayQueueItemRate }
+			{ "relay_queue_item_rate", relayQueueItemRate },
+			{ "log_queue_items", logQueueItems },
+			{ "log_write_rate", logWriteRate },
+			{ "send_queues", sendQueues }
 		}) },
 
 		{ "http", new Dictionary({
-			{ "clients", httpClients }
-		}) }
+			{ "clients", httpClients },
+			{ "event_queues", eventQueues },
+			{ "handlers", httpHandlers }
+		}) },
+
+		{ "tls", tlsStats }
 	});
 
 	/* performance data */
@@ -1359,6 +1881,31 @@ std::pair<Dictionary::Ptr, Dictionary::Ptr> ApiListener::GetStatus()
 	perfdata->Set("num_json_rpc_work_queue_item_rate", workQueueItemRate);
 	perfdata->Set("num_json_rpc_sync_queue_item_rate", syncQueueItemRate);
 	perfdata->Set("num_json_rpc_relay_queue_item_rate", relayQueueItemRate);
+	perfdata->Set("num_json_rpc_log_queue_items", logQueueItems);
+	perfdata->Set("num_json_rpc_log_write_rate", logWriteRate);
+
+	perfdata->Set("num_http_event_queue_items", eventQueueItems);
+	perfdata->Set("num_http_event_queue_dropped", eventQueueDropped);
+	perfdata->Set("http_event_queue_max_age", eventQueueMaxAge);
+
+	{
+		ObjectLock olock(httpHandlers);
+		for (const Dictionary::Pair& kv : httpHandlers) {
+			Dictionary::Ptr classStats = kv.second;
+			perfdata->Set("num_http_" + kv.first + "_requests_active", classStats->Get("active"));
+			perfdata->Set("num_http_" + kv.first + "_requests_queued", classStats->Get("queued"));
+			perfdata->Set("num_http_" + kv.first + "_requests_rejected", classStats->Get("rejected"));
+			perfdata->Set("http_" + kv.first + "_request_latency", classStats->Get("avg_latency"));
+		}
+	}
+
+	perfdata->Set("num_tls_server_handshakes", tlsStats->Get("server_handshakes"));
+	perfdata->Set("num_tls_server_resumed", tlsStats->Get("server_resumed"));
+	perfdata->Set("num_tls_client_handshakes", tlsStats->Get("client_handshakes"));
+	perfdata->Set("num_tls_client_resumed", tlsStats->Get("client_resumed"));
+	perfdata->Set("num_tls_handshakes_pending", tlsStats->Get("handshakes_pending"));
+	perfdata->Set("tls_handshake_latency", tlsStats->Get("handshake_latency"));
+	perfdata->Set("tls_handshake_wait_time", tlsStats->Get("handshake_wait_time"));
 
 	return std::make_pair(status, perfdata);
 }
@@ -1416,6 +1963,49 @@ std::set<HttpServerConnection::Ptr> ApiListener::GetHttpClients() const
 
 Value ApiListener::HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
 {
+	JsonRpcConnection::Ptr client = origin->FromClient;
+
+	if (!client)
+		return Empty;
+
+	if (params->Get("config_manifest").ToBool())
+		client->SetConfigManifest(true);
+
+	if (params->Get("check_result_batches").ToBool())
+		client->SetCheckResultBatches(true);
+
+	if (params->Get("execute_command_batches").ToBool())
+		client->SetExecuteCommandBatches(true);
+
+	if (params->Get("agent_scheduling").ToBool())
+		client->SetAgentScheduling(true);
+
+	if (params->Contains("runtime_objects_position"))
+		client->SetRuntimeObjectsPosition(params->Get("runtime_objects_position"));
+
+	/* Older versions send an empty hello message and only understand JSON. */
+	if (params->Get("binary_messages").ToBool() && !client->GetBinaryMessages()) {
+		/* The client sends the first hello message, let it know that we support the binary encoding as well. */
+		if (client->GetRole() == RoleServer) {
+			client->SendMessage(new Dictionary({
+				{ "jsonrpc", "2.0" },
+				{ "method", "icinga::Hello" },
+				{ "params", new Dictionary({
+					{ "binary_messages", true },
+					{ "config_manifest", true },
+					{ "check_result_batches", true },
+					{ "execute_command_batches", true },
+					{ "agent_scheduling", ApiListener::GetInstance()->GetAcceptCommands() },
+					{ "runtime_objects_position", client->GetEndpoint() ? client->GetEndpoint()->GetRuntimeObjectsPosition() : 0 }
+				}) }
+			}));
+		}
+
+		client->SetBinaryMessages(true);
+	}
+
+	client->SetHelloReceived();
+
 	return Empty;
 }
 
@@ -1443,6 +2033,72 @@ void ApiListener::ValidateTlsProtocolmin(const Lazy<String>& lvalue, const Valid
 	}
 }
 
+void ApiListener::ValidateLogSyncPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateLogSyncPolicy(lvalue, utils);
+
+	if (lvalue() != "none" && lvalue() != "batch" && lvalue() != "interval")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "log_sync_policy" }, "Invalid sync policy. Must be one of 'none', 'batch' or 'interval'."));
+}
+
+void ApiListener::ValidateEventsQueueCapacity(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateEventsQueueCapacity(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "events_queue_capacity" }, "Event queue capacity must not be negative."));
+}
+
+void ApiListener::ValidateEventsOverflowPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateEventsOverflowPolicy(lvalue, utils);
+
+	EventQueueOverflowPolicy policy;
+
+	if (!EventQueue::ParseOverflowPolicy(lvalue(), &policy))
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "events_overflow_policy" }, "Invalid overflow policy. Must be one of 'drop-oldest', 'drop-newest' or 'disconnect'."));
+}
+
+void ApiListener::ValidateHttpQueryConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateHttpQueryConcurrency(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "http_query_concurrency" }, "Concurrency limit must not be negative."));
+}
+
+void ApiListener::ValidateHttpActionConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateHttpActionConcurrency(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "http_action_concurrency" }, "Concurrency limit must not be negative."));
+}
+
+void ApiListener::ValidateHttpConfigConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateHttpConfigConcurrency(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "http_config_concurrency" }, "Concurrency limit must not be negative."));
+}
+
+void ApiListener::ValidateHaDistribution(const Lazy<String>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateHaDistribution(lvalue, utils);
+
+	if (lvalue() != "hash" && lvalue() != "rendezvous" && lvalue() != "load")
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "ha_distribution" }, "Invalid HA distribution. Must be one of 'hash', 'rendezvous' or 'load'."));
+}
+
+void ApiListener::ValidateMaxSendQueueSize(const Lazy<int>& lvalue, const ValidationUtils& utils)
+{
+	ObjectImpl<ApiListener>::ValidateMaxSendQueueSize(lvalue, utils);
+
+	if (lvalue() < 0)
+		BOOST_THROW_EXCEPTION(ValidationError(this, { "max_send_queue_size" }, "Send queue size must not be negative."));
+}
+
 bool ApiListener::IsHACluster()
 {
 	Zone::Ptr zone = Zone::GetLocalZone();
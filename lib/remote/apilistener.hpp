@@ -30,6 +30,10 @@
 #include "base/workqueue.hpp"
 #include "base/tcpsocket.hpp"
 #include "base/tlsstream.hpp"
+#include "base/stdiostream.hpp"
+#include "base/ringbuffer.hpp"
+#include <boost/thread/condition_variable.hpp>
+#include <map>
 #include <set>
 
 namespace icinga
@@ -46,6 +50,41 @@ struct ConfigDirInformation
 	Dictionary::Ptr UpdateV2;
 };
 
+/**
+ * A config update which is received in several config::UpdateFiles messages.
+ *
+ * @ingroup remote
+ */
+struct PendingConfigUpdate
+{
+	Dictionary::Ptr Manifest;
+	Dictionary::Ptr Files;
+};
+
+/**
+ * The endpoints of one zone a message is relayed to, without the local
+ * endpoint. Each endpoint is paired with whether it was connected when the
+ * route was built.
+ *
+ * @ingroup remote
+ */
+struct RelayHop
+{
+	Zone::Ptr TargetZone;
+	std::vector<std::pair<Endpoint::Ptr, bool> > Targets;
+};
+
+/**
+ * Where messages for objects in a zone are relayed to, see ApiListener::GetRelayRoute().
+ *
+ * @ingroup remote
+ */
+struct RelayRoute
+{
+	Endpoint::Ptr Master;
+	std::vector<RelayHop> Hops;
+};
+
 /**
 * @ingroup remote
 */
@@ -69,11 +108,13 @@ public:
 	static ApiListener::Ptr GetInstance();
 
 	Endpoint::Ptr GetMaster() const;
+	void InvalidateRelayRoutes();
 	bool IsMaster() const;
 
 	Endpoint::Ptr GetLocalEndpoint() const;
 
 	void SyncSendMessage(const Endpoint::Ptr& endpoint, const Dictionary::Ptr& message);
+	void SyncSendMessage(const Endpoint::Ptr& endpoint, const EncodedMessage::Ptr& message);
 	void RelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
 
 	static void StatsFunc(const Dictionary::Ptr& status, const Array::Ptr& perfdata);
@@ -91,10 +132,14 @@ public:
 
 	/* filesync */
 	static Value ConfigUpdateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigManifestHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigRequestFilesHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value ConfigUpdateFilesHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	/* configsync */
 	static void ConfigUpdateObjectHandler(const ConfigObject::Ptr& object, const Value& cookie);
 	static Value ConfigUpdateObjectAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
+	static Value RuntimeObjectsSyncedAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 	static Value ConfigDeleteObjectAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 
 	static Value HelloAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
@@ -115,6 +160,14 @@ protected:
 	void Stop(bool runtimeDeleted) override;
 
 	void ValidateTlsProtocolmin(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateLogSyncPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateEventsQueueCapacity(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateEventsOverflowPolicy(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateHttpQueryConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateHttpActionConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateHttpConfigConcurrency(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
+	void ValidateHaDistribution(const Lazy<String>& lvalue, const ValidationUtils& utils) override;
+	void ValidateMaxSendQueueSize(const Lazy<int>& lvalue, const ValidationUtils& utils) override;
 
 private:
 	std::shared_ptr<SSL_CTX> m_SSLContext;
@@ -129,36 +182,86 @@ private:
 	Timer::Ptr m_ReconnectTimer;
 	Timer::Ptr m_AuthorityTimer;
 	Timer::Ptr m_CleanupCertificateRequestsTimer;
+	Timer::Ptr m_SessionTicketKeysTimer;
 	Endpoint::Ptr m_LocalEndpoint;
 
+	/* Limits the number of concurrent TLS handshakes, see BeginHandshake(). */
+	boost::mutex m_HandshakeMutex;
+	boost::condition_variable m_HandshakeCV;
+	int m_ActiveHandshakes{0};
+	int m_PendingHandshakes{0};
+	uint_fast64_t m_RejectedHandshakes{0};
+	double m_HandshakeLatency{0};
+	double m_HandshakeWaitTime{0};
+
+	/* TLS sessions for outgoing connections, by endpoint name. */
+	boost::mutex m_TlsSessionsMutex;
+	std::map<String, std::shared_ptr<SSL_SESSION> > m_TlsSessions;
+
 	static ApiListener::Ptr m_Instance;
 
 	void ApiTimerHandler();
 	void ApiReconnectTimerHandler();
 	void CleanupCertificateRequestsTimerHandler();
+	void UpdateSessionTicketKeys();
 
 	bool AddListener(const String& node, const String& service);
 	void AddConnection(const Endpoint::Ptr& endpoint);
 
 	void NewClientHandler(const Socket::Ptr& client, const String& hostname, ConnectionRole role);
 	void NewClientHandlerInternal(const Socket::Ptr& client, const String& hostname, ConnectionRole role);
+	bool BeginHandshake();
+	void EndHandshake(double waitTime, double latency);
 	void ListenerThreadProc(const Socket::Ptr& server);
 
 	WorkQueue m_RelayQueue;
 	WorkQueue m_SyncQueue{0, 4};
 
 	boost::mutex m_LogLock;
-	Stream::Ptr m_LogFile;
+	StdioStream::Ptr m_LogFile;
+	StdioStream::Ptr m_LogIndexFile;
 	size_t m_LogMessageCount{0};
-
-	bool RelayMessageOne(const Zone::Ptr& zone, const MessageOrigin::Ptr& origin, const Dictionary::Ptr& message, const Endpoint::Ptr& currentMaster);
+	uint_least64_t m_LogFileOffset{0};
+	double m_LogMaxTimestamp{0};
+	double m_LogLastSync{0};
+
+	/* Messages which still have to be written to the replay log. */
+	boost::mutex m_LogQueueMutex;
+	boost::condition_variable m_LogQueueCV;
+	std::vector<std::pair<String, double> > m_LogQueue;
+	bool m_LogWriterStop{false};
+	boost::thread m_LogWriterThread;
+	RingBuffer m_LogWriteStats{15 * 60};
+
+	/* Relay routes by target zone, cleared whenever endpoints or zones change. */
+	boost::mutex m_RelayRoutesMutex;
+	std::map<Zone::Ptr, std::shared_ptr<const RelayRoute> > m_RelayRoutes;
+	uint_fast64_t m_RelayRoutesGeneration{0};
+
+	std::shared_ptr<const RelayRoute> GetRelayRoute(const Zone::Ptr& targetZone);
+
+	bool RelayMessageOne(const RelayHop& hop, const MessageOrigin::Ptr& origin, const EncodedMessage::Ptr& message, const Endpoint::Ptr& currentMaster);
 	void SyncRelayMessage(const MessageOrigin::Ptr& origin, const ConfigObject::Ptr& secobj, const Dictionary::Ptr& message, bool log);
-	void PersistMessage(const Dictionary::Ptr& message, const ConfigObject::Ptr& secobj);
+	void PersistMessage(const EncodedMessage::Ptr& message, const ConfigObject::Ptr& secobj);
+
+	void LogWriterThreadProc();
+	void ProcessLogQueue();
+	void SyncLogFile();
+	size_t GetLogQueueLength();
 
 	void OpenLogFile();
 	void RotateLogFile();
 	void CloseLogFile();
 	static void LogGlobHandler(std::vector<int>& files, const String& file);
+
+	/* The rotated replay log files by timestamp, loaded from the log directory on first use. */
+	boost::mutex m_LogFilesMutex;
+	std::set<int> m_LogFiles;
+	bool m_LogFilesLoaded{false};
+
+	std::vector<int> GetLogFiles();
+	void RemoveLogFile(int ts);
+	static uint_least64_t GetLogReplayOffset(const String& indexPath, double peer_ts);
 	void ReplayLog(const JsonRpcConnection::Ptr& client);
 
 	static void CopyCertificateFile(const String& oldCertPath, const String& newCertPath);
@@ -173,6 +276,12 @@ private:
 
 	static void ConfigGlobHandler(ConfigDirInformation& config, const String& path, const String& file);
 	void SendConfigUpdate(const JsonRpcConnection::Ptr& aclient);
+	void SendConfigManifest(const JsonRpcConnection::Ptr& aclient, const std::vector<Zone::Ptr>& zones);
+	static bool ApplyConfigFiles(const String& zoneName, const Dictionary::Ptr& manifest, const Dictionary::Ptr& files);
+
+	/* Config updates which are currently received from our parent endpoints. */
+	boost::mutex m_PendingConfigUpdatesMutex;
+	std::map<String, PendingConfigUpdate> m_PendingConfigUpdates;
 
 	/* configsync */
 	void UpdateConfigObject(const ConfigObject::Ptr& object, const MessageOrigin::Ptr& origin,
@@ -181,6 +290,13 @@ private:
 		const JsonRpcConnection::Ptr& client = nullptr);
 	void SendRuntimeConfigObjects(const JsonRpcConnection::Ptr& aclient);
 
+	/* When runtime objects were last changed, changes before m_RuntimeObjectChangesSince are unknown. */
+	boost::mutex m_RuntimeObjectChangesMutex;
+	std::map<ConfigObject::Ptr, double> m_RuntimeObjectChanges;
+	double m_RuntimeObjectChangesSince;
+
+	void UpdateRuntimeObjectChange(const ConfigObject::Ptr& object);
+
 	void SyncClient(const JsonRpcConnection::Ptr& aclient, const Endpoint::Ptr& endpoint, bool needSync);
 };
 
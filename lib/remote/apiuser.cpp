@@ -29,7 +29,7 @@ REGISTER_TYPE(ApiUser);
 
 ApiUser::Ptr ApiUser::GetByClientCN(const String& cn)
 {
-	for (const ApiUser::Ptr& user : ConfigType::GetObjectsByType<ApiUser>()) {
+	for (const ApiUser::Ptr& user : ConfigType::GetObjectViewByType<ApiUser>()) {
 		if (user->GetClientCN() == cn)
 			return user;
 	}
@@ -20,10 +20,133 @@
 #include "remote/zone.hpp"
 #include "remote/apilistener.hpp"
 #include "base/configtype.hpp"
+#include "base/logger.hpp"
 #include "base/utility.hpp"
+#include <cmath>
+#include <set>
 
 using namespace icinga;
 
+/**
+ * Converts the estimated load to microseconds of CPU time per second and
+ * rounds it up to one of four steps between two powers of two. Objects
+ * without an estimate count as one unit so that their number is balanced
+ * as well.
+ */
+static uint64_t QuantizeLoad(double load)
+{
+	double micros = std::min(load * 1000000, 1e12);
+	uint64_t units = 1;
+
+	while (units < micros)
+		units <<= 1;
+
+	if (units < 8)
+		return units;
+
+	uint64_t step = units / 8;
+
+	return static_cast<uint64_t>(std::ceil(micros / step)) * step;
+}
+
+/**
+ * Scrambles the bits of a hash value (the finalizer of SplitMix64).
+ */
+static uint64_t MixHash(uint64_t value)
+{
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
+
+/**
+ * Picks the endpoint with the highest score for the object (rendezvous
+ * hashing). Unlike taking the hash modulo the number of endpoints, only the
+ * objects of an endpoint which leaves the zone move, and an endpoint which
+ * joins only takes over its share of the objects from the others.
+ */
+static size_t GetRendezvousEndpoint(const String& name, const std::vector<uint64_t>& endpointHashes)
+{
+	uint64_t objectHash = Utility::SDBM(name);
+	size_t best = 0;
+	uint64_t bestScore = 0;
+
+	for (size_t i = 0; i < endpointHashes.size(); i++) {
+		uint64_t score = MixHash(objectHash ^ endpointHashes[i]);
+
+		if (i == 0 || score > bestScore) {
+			best = i;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Starts with the rendezvous hashing distribution and moves objects from the
+ * busiest to the least busy endpoint until their estimated loads differ by
+ * less than a tenth of the average load. Quantizing the loads and this tolerance keep
+ * small changes of the check execution times from moving objects around.
+ *
+ * All endpoints in the zone run this with the same replicated check results,
+ * so they agree on the distribution without exchanging it.
+ */
+static std::vector<size_t> BalanceAuthority(const std::vector<ConfigObject::Ptr>& objects, const std::vector<uint64_t>& endpointHashes)
+{
+	size_t endpointCount = endpointHashes.size();
+
+	std::vector<size_t> assignment;
+	assignment.reserve(objects.size());
+
+	std::vector<uint64_t> costs;
+	costs.reserve(objects.size());
+
+	std::vector<uint64_t> loads(endpointCount, 0);
+	std::vector<std::set<std::pair<uint64_t, size_t> > > assigned(endpointCount);
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < objects.size(); i++) {
+		size_t endpoint = GetRendezvousEndpoint(objects[i]->GetName(), endpointHashes);
+		uint64_t cost = QuantizeLoad(objects[i]->GetLoadEstimate());
+
+		assignment.push_back(endpoint);
+		costs.push_back(cost);
+		loads[endpoint] += cost;
+		assigned[endpoint].insert(std::make_pair(cost, i));
+		total += cost;
+	}
+
+	uint64_t tolerance = std::max<uint64_t>(total / endpointCount / 10, 1);
+
+	for (size_t moves = 0; moves < objects.size(); moves++) {
+		size_t busiest = std::max_element(loads.begin(), loads.end()) - loads.begin();
+		size_t idlest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+		uint64_t diff = loads[busiest] - loads[idlest];
+
+		if (diff <= tolerance)
+			break;
+
+		/* Moving an object which costs at most half the difference always reduces it. */
+		auto it = assigned[busiest].upper_bound(std::make_pair(diff / 2, objects.size()));
+
+		if (it == assigned[busiest].begin())
+			break;
+
+		--it;
+
+		size_t index = it->second;
+
+		assigned[busiest].erase(it);
+		assigned[idlest].insert(std::make_pair(costs[index], index));
+		loads[busiest] -= costs[index];
+		loads[idlest] += costs[index];
+		assignment[index] = idlest;
+	}
+
+	return assignment;
+}
+
 void ApiListener::UpdateObjectAuthority()
 {
 	Zone::Ptr my_zone = Zone::GetLocalZone();
@@ -57,24 +180,63 @@ void ApiListener::UpdateObjectAuthority()
 		);
 	}
 
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+	String distribution = listener ? listener->GetHaDistribution() : "hash";
+	bool balance = my_zone && endpoints.size() > 1 && distribution == "load";
+
+	std::vector<uint64_t> endpointHashes;
+
+	for (const Endpoint::Ptr& endpoint : endpoints)
+		endpointHashes.push_back(MixHash(Utility::SDBM(endpoint->GetName())));
+
+	std::vector<ConfigObject::Ptr> objects;
+
 	for (const Type::Ptr& type : Type::GetAllTypes()) {
 		auto *dtype = dynamic_cast<ConfigType *>(type.get());
 
 		if (!dtype)
 			continue;
 
-		for (const ConfigObject::Ptr& object : dtype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : dtype->GetObjectView()) {
 			if (!object->IsActive() || object->GetHAMode() != HARunOnce)
 				continue;
 
+			if (balance) {
+				objects.push_back(object);
+				continue;
+			}
+
 			bool authority;
 
 			if (!my_zone)
 				authority = true;
+			else if (distribution == "rendezvous")
+				authority = endpoints[GetRendezvousEndpoint(object->GetName(), endpointHashes)] == my_endpoint;
 			else
 				authority = endpoints[Utility::SDBM(object->GetName()) % endpoints.size()] == my_endpoint;
 
 			object->SetAuthority(authority);
 		}
 	}
+
+	if (!balance)
+		return;
+
+	/* The endpoints must process the objects in the same order. */
+	std::sort(objects.begin(), objects.end(),
+		[](const ConfigObject::Ptr& a, const ConfigObject::Ptr& b) {
+			Type::Ptr typeA = a->GetReflectionType();
+			Type::Ptr typeB = b->GetReflectionType();
+
+			if (typeA != typeB)
+				return typeA->GetName() < typeB->GetName();
+
+			return a->GetName() < b->GetName();
+		}
+	);
+
+	std::vector<size_t> assignment = BalanceAuthority(objects, endpointHashes);
+
+	for (size_t i = 0; i < objects.size(); i++)
+		objects[i]->SetAuthority(endpoints[assignment[i]] == my_endpoint);
 }
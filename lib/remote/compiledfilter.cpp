@@ -0,0 +1,506 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/compiledfilter.hpp"
+#include "remote/filterutility.hpp"
+#include "config/configcompiler.hpp"
+#include "config/vmops.hpp"
+#include "base/configobject.hpp"
+#include "base/json.hpp"
+#include "base/scripterror.hpp"
+#include <boost/algorithm/string/join.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <map>
+
+using namespace icinga;
+
+enum CompiledFilterOp
+{
+	FilterOpLiteral,
+	FilterOpVariable,
+	FilterOpField,
+	FilterOpEqual,
+	FilterOpNotEqual,
+	FilterOpLessThan,
+	FilterOpGreaterThan,
+	FilterOpLessThanOrEqual,
+	FilterOpGreaterThanOrEqual,
+	FilterOpIn,
+	FilterOpNotIn,
+	FilterOpLogicalAnd,
+	FilterOpLogicalOr,
+	FilterOpLogicalNegate
+};
+
+namespace icinga
+{
+
+struct CompiledFilterNode
+{
+	CompiledFilterOp Op;
+	const Expression *Source;
+	Value Literal;
+	String Name;
+	int Slot{-1};
+	std::unique_ptr<CompiledFilterNode> Operand1;
+	std::unique_ptr<CompiledFilterNode> Operand2;
+};
+
+}
+
+struct CompiledFilterContext
+{
+	ScriptFrame& Frame;
+	CompiledFilterState& State;
+	const Object::Ptr& Target;
+	const String& VariableName;
+};
+
+/* Compiled filters are cached by their text, API event streams and
+ * dashboards tend to send the same few filters over and over again.
+ */
+static const std::map<String, CompiledFilter::Ptr>::size_type l_CompiledFilterCacheSize = 1024;
+
+static boost::mutex& GetCompiledFilterMutex()
+{
+	static boost::mutex mutex;
+	return mutex;
+}
+
+static std::map<String, CompiledFilter::Ptr>& GetCompiledFilterCache()
+{
+	static std::map<String, CompiledFilter::Ptr> cache;
+	return cache;
+}
+
+static std::unique_ptr<CompiledFilterNode> CompileNode(const Expression *expr, bool boolean, int& slots);
+
+static std::unique_ptr<CompiledFilterNode> MakeNode(CompiledFilterOp op, const Expression *source)
+{
+	std::unique_ptr<CompiledFilterNode> node{new CompiledFilterNode()};
+	node->Op = op;
+	node->Source = source;
+	return node;
+}
+
+static std::unique_ptr<CompiledFilterNode> CompileBinary(CompiledFilterOp op, const BinaryExpression *expr, bool boolean, int& slots)
+{
+	std::unique_ptr<CompiledFilterNode> operand1 = CompileNode(expr->GetOperand1(), boolean, slots);
+
+	if (!operand1)
+		return nullptr;
+
+	std::unique_ptr<CompiledFilterNode> operand2 = CompileNode(expr->GetOperand2(), boolean, slots);
+
+	if (!operand2)
+		return nullptr;
+
+	std::unique_ptr<CompiledFilterNode> node = MakeNode(op, expr);
+	node->Operand1 = std::move(operand1);
+	node->Operand2 = std::move(operand2);
+	return node;
+}
+
+/**
+ * Lowers an expression. Returns nullptr for anything which can't be compiled.
+ *
+ * @param boolean Whether only the truth value of the result is used. The
+ *                logical operators return one of their operands and are
+ *                therefore only compiled in a boolean context.
+ */
+static std::unique_ptr<CompiledFilterNode> CompileNode(const Expression *expr, bool boolean, int& slots)
+{
+	if (auto *dexpr = dynamic_cast<const DictExpression *>(expr)) {
+		if (!dexpr->IsInline() || dexpr->GetExpressions().size() != 1)
+			return nullptr;
+
+		return CompileNode(dexpr->GetExpressions()[0].get(), boolean, slots);
+	}
+
+	if (auto *lexpr = dynamic_cast<const LiteralExpression *>(expr)) {
+		std::unique_ptr<CompiledFilterNode> node = MakeNode(FilterOpLiteral, expr);
+		node->Literal = lexpr->GetValue();
+		return node;
+	}
+
+	if (auto *vexpr = dynamic_cast<const VariableExpression *>(expr)) {
+		std::unique_ptr<CompiledFilterNode> node = MakeNode(FilterOpVariable, expr);
+		node->Name = vexpr->GetVariable();
+		node->Slot = slots++;
+		return node;
+	}
+
+	if (auto *iexpr = dynamic_cast<const IndexerExpression *>(expr)) {
+		auto *index = dynamic_cast<const LiteralExpression *>(iexpr->GetOperand2());
+
+		if (!index || !index->GetValue().IsString())
+			return nullptr;
+
+		std::unique_ptr<CompiledFilterNode> operand = CompileNode(iexpr->GetOperand1(), false, slots);
+
+		if (!operand)
+			return nullptr;
+
+		std::unique_ptr<CompiledFilterNode> node = MakeNode(FilterOpField, expr);
+		node->Name = index->GetValue();
+		node->Slot = slots++;
+		node->Operand1 = std::move(operand);
+		return node;
+	}
+
+	if (auto *bexpr = dynamic_cast<const EqualExpression *>(expr))
+		return CompileBinary(FilterOpEqual, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const NotEqualExpression *>(expr))
+		return CompileBinary(FilterOpNotEqual, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const LessThanExpression *>(expr))
+		return CompileBinary(FilterOpLessThan, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const GreaterThanExpression *>(expr))
+		return CompileBinary(FilterOpGreaterThan, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const LessThanOrEqualExpression *>(expr))
+		return CompileBinary(FilterOpLessThanOrEqual, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const GreaterThanOrEqualExpression *>(expr))
+		return CompileBinary(FilterOpGreaterThanOrEqual, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const InExpression *>(expr))
+		return CompileBinary(FilterOpIn, bexpr, false, slots);
+	if (auto *bexpr = dynamic_cast<const NotInExpression *>(expr))
+		return CompileBinary(FilterOpNotIn, bexpr, false, slots);
+
+	if (auto *nexpr = dynamic_cast<const LogicalNegateExpression *>(expr)) {
+		std::unique_ptr<CompiledFilterNode> operand = CompileNode(nexpr->GetOperand(), true, slots);
+
+		if (!operand)
+			return nullptr;
+
+		std::unique_ptr<CompiledFilterNode> node = MakeNode(FilterOpLogicalNegate, expr);
+		node->Operand1 = std::move(operand);
+		return node;
+	}
+
+	if (!boolean)
+		return nullptr;
+
+	if (auto *bexpr = dynamic_cast<const LogicalAndExpression *>(expr))
+		return CompileBinary(FilterOpLogicalAnd, bexpr, true, slots);
+	if (auto *bexpr = dynamic_cast<const LogicalOrExpression *>(expr))
+		return CompileBinary(FilterOpLogicalOr, bexpr, true, slots);
+
+	return nullptr;
+}
+
+static bool EvaluateBool(const CompiledFilterNode *node, CompiledFilterContext& context);
+
+/**
+ * Looks up a variable the same way FilterUtility::EvaluateFilter() populates
+ * the script frame: navigation fields of the target type, then 'obj' and the
+ * type's variable name, then the filter variables and globals.
+ */
+static Value EvaluateVariable(const CompiledFilterNode *node, CompiledFilterContext& context)
+{
+	CompiledFilterState::Slot& slot = context.State.Slots[node->Slot];
+	Type *type = context.Target->GetReflectionType().get();
+
+	/* FieldId is the navigation field, -2 for the target itself or -1 for other variables. */
+	if (slot.CachedType != type) {
+		slot.CachedType = type;
+		slot.FieldId = -1;
+
+		if (node->Name == "obj" || node->Name == (context.VariableName.IsEmpty() ? type->GetName().ToLower() : context.VariableName))
+			slot.FieldId = -2;
+
+		for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+			Field field = type->GetFieldInfo(fid);
+
+			if ((field.Attributes & FANavigation) == 0)
+				continue;
+
+			if ((field.NavigationName ? field.NavigationName : field.Name) == node->Name)
+				slot.FieldId = fid;
+		}
+	}
+
+	if (slot.FieldId >= 0)
+		return context.Target->NavigateField(slot.FieldId);
+	else if (slot.FieldId == -2)
+		return context.Target;
+
+	if (!slot.Resolved) {
+		slot.Global = node->Source->Evaluate(context.Frame).GetValue();
+		slot.Resolved = true;
+	}
+
+	return slot.Global;
+}
+
+static Value EvaluateValue(const CompiledFilterNode *node, CompiledFilterContext& context)
+{
+	switch (node->Op) {
+		case FilterOpLiteral:
+			return node->Literal;
+
+		case FilterOpVariable:
+			return EvaluateVariable(node, context);
+
+		case FilterOpField:
+			{
+				Value operand = EvaluateValue(node->Operand1.get(), context);
+
+				/* Dictionaries and arrays have their own field semantics. */
+				if (operand.IsObjectType<ConfigObject>()) {
+					ConfigObject::Ptr object = operand;
+					Type *type = object->GetReflectionType().get();
+					CompiledFilterState::Slot& slot = context.State.Slots[node->Slot];
+
+					if (slot.CachedType != type) {
+						slot.CachedType = type;
+						slot.FieldId = type->GetFieldId(node->Name);
+
+						if (slot.FieldId != -1 && (type->GetFieldInfo(slot.FieldId).Attributes & FANoUserView))
+							slot.FieldId = -1;
+					}
+
+					if (slot.FieldId != -1)
+						return object->GetField(slot.FieldId);
+				}
+
+				return VMOps::GetField(operand, node->Name, context.Frame.Sandboxed, node->Source->GetDebugInfo());
+			}
+
+		case FilterOpEqual:
+			return EvaluateValue(node->Operand1.get(), context) == EvaluateValue(node->Operand2.get(), context);
+
+		case FilterOpNotEqual:
+			return EvaluateValue(node->Operand1.get(), context) != EvaluateValue(node->Operand2.get(), context);
+
+		case FilterOpLessThan:
+			return EvaluateValue(node->Operand1.get(), context) < EvaluateValue(node->Operand2.get(), context);
+
+		case FilterOpGreaterThan:
+			return EvaluateValue(node->Operand1.get(), context) > EvaluateValue(node->Operand2.get(), context);
+
+		case FilterOpLessThanOrEqual:
+			return EvaluateValue(node->Operand1.get(), context) <= EvaluateValue(node->Operand2.get(), context);
+
+		case FilterOpGreaterThanOrEqual:
+			return EvaluateValue(node->Operand1.get(), context) >= EvaluateValue(node->Operand2.get(), context);
+
+		case FilterOpIn:
+		case FilterOpNotIn:
+			{
+				Value operand2 = EvaluateValue(node->Operand2.get(), context);
+
+				if (operand2.IsEmpty())
+					return node->Op == FilterOpNotIn;
+				else if (!operand2.IsObjectType<Array>())
+					BOOST_THROW_EXCEPTION(ScriptError("Invalid right side argument for 'in' operator: " + JsonEncode(operand2), node->Source->GetDebugInfo()));
+
+				Value operand1 = EvaluateValue(node->Operand1.get(), context);
+
+				Array::Ptr arr = operand2;
+				return arr->Contains(operand1) != (node->Op == FilterOpNotIn);
+			}
+
+		case FilterOpLogicalAnd:
+		case FilterOpLogicalOr:
+		case FilterOpLogicalNegate:
+			return EvaluateBool(node, context);
+
+		default:
+			VERIFY(!"Invalid filter operation.");
+	}
+}
+
+static bool EvaluateBool(const CompiledFilterNode *node, CompiledFilterContext& context)
+{
+	switch (node->Op) {
+		case FilterOpLogicalAnd:
+			return EvaluateBool(node->Operand1.get(), context) && EvaluateBool(node->Operand2.get(), context);
+
+		case FilterOpLogicalOr:
+			return EvaluateBool(node->Operand1.get(), context) || EvaluateBool(node->Operand2.get(), context);
+
+		case FilterOpLogicalNegate:
+			return !EvaluateBool(node->Operand1.get(), context);
+
+		default:
+			return EvaluateValue(node, context).ToBool();
+	}
+}
+
+/**
+ * Builds the attribute path (e.g. "host.name") for an attribute access on
+ * the target object or one of its navigation variables.
+ */
+static bool GetAttributePath(const CompiledFilterNode *node, const Type::Ptr& type, const String& variableName, String *path)
+{
+	std::vector<String> tokens;
+
+	for (; node->Op == FilterOpField; node = node->Operand1.get())
+		tokens.push_back(node->Name);
+
+	if (node->Op != FilterOpVariable || tokens.empty())
+		return false;
+
+	bool navigation = false;
+
+	for (int fid = 0; fid < type->GetFieldCount(); fid++) {
+		Field field = type->GetFieldInfo(fid);
+
+		if ((field.Attributes & FANavigation) && (field.NavigationName ? field.NavigationName : field.Name) == node->Name)
+			navigation = true;
+	}
+
+	if (navigation)
+		tokens.push_back(node->Name);
+	else if (node->Name != "obj" && node->Name != (variableName.IsEmpty() ? type->GetName().ToLower() : variableName))
+		return false;
+
+	std::reverse(tokens.begin(), tokens.end());
+
+	*path = boost::algorithm::join(tokens, ".");
+	return true;
+}
+
+static void GetIndexHintsForNode(const CompiledFilterNode *node, const Type::Ptr& type, const String& variableName,
+	std::vector<CompiledFilterIndexHint>& hints)
+{
+	String path;
+
+	switch (node->Op) {
+		case FilterOpLogicalAnd:
+			GetIndexHintsForNode(node->Operand1.get(), type, variableName, hints);
+			GetIndexHintsForNode(node->Operand2.get(), type, variableName, hints);
+			break;
+
+		case FilterOpEqual:
+			if (node->Operand2->Op == FilterOpLiteral && GetAttributePath(node->Operand1.get(), type, variableName, &path))
+				hints.push_back({ ConfigType::IndexEqual, path, node->Operand2->Literal });
+			else if (node->Operand1->Op == FilterOpLiteral && GetAttributePath(node->Operand2.get(), type, variableName, &path))
+				hints.push_back({ ConfigType::IndexEqual, path, node->Operand1->Literal });
+
+			break;
+
+		case FilterOpIn:
+			if (node->Operand1->Op == FilterOpLiteral && GetAttributePath(node->Operand2.get(), type, variableName, &path))
+				hints.push_back({ ConfigType::IndexContains, path, node->Operand1->Literal });
+
+			break;
+
+		default:
+			break;
+	}
+}
+
+CompiledFilter::CompiledFilter(std::unique_ptr<Expression> expression)
+	: m_Expression(std::move(expression))
+{
+	m_Root = CompileNode(m_Expression.get(), true, m_SlotCount);
+}
+
+CompiledFilter::~CompiledFilter()
+{ }
+
+/**
+ * Parses and compiles a filter expression or returns a cached instance
+ * for the same text.
+ *
+ * @param text The filter expression.
+ * @returns The compiled filter.
+ */
+CompiledFilter::Ptr CompiledFilter::Compile(const String& text)
+{
+	{
+		boost::mutex::scoped_lock lock(GetCompiledFilterMutex());
+
+		auto it = GetCompiledFilterCache().find(text);
+
+		if (it != GetCompiledFilterCache().end())
+			return it->second;
+	}
+
+	CompiledFilter::Ptr filter = new CompiledFilter(ConfigCompiler::CompileText("<API query>", text));
+
+	boost::mutex::scoped_lock lock(GetCompiledFilterMutex());
+
+	auto& cache = GetCompiledFilterCache();
+
+	if (cache.size() >= l_CompiledFilterCacheSize)
+		cache.clear();
+
+	cache[text] = filter;
+
+	return filter;
+}
+
+/**
+ * Returns whether the whole expression could be lowered.
+ */
+bool CompiledFilter::IsCompiled() const
+{
+	return !!m_Root;
+}
+
+Expression *CompiledFilter::GetExpression() const
+{
+	return m_Expression.get();
+}
+
+CompiledFilterState CompiledFilter::CreateState() const
+{
+	CompiledFilterState state;
+	state.Slots.resize(m_SlotCount);
+	return state;
+}
+
+/**
+ * Evaluates the filter for a target object.
+ *
+ * @param frame The script frame which holds the filter variables.
+ * @param state The lookup state, see CreateState().
+ * @param target The target object.
+ * @param variableName The name of the target variable (defaults to the lower-case type name).
+ * @returns Whether the target matches the filter.
+ */
+bool CompiledFilter::Evaluate(ScriptFrame& frame, CompiledFilterState& state,
+	const Object::Ptr& target, const String& variableName) const
+{
+	if (!m_Root)
+		return FilterUtility::EvaluateFilter(frame, m_Expression.get(), target, variableName);
+
+	CompiledFilterContext context{frame, state, target, variableName};
+
+	return EvaluateBool(m_Root.get(), context);
+}
+
+/**
+ * Returns the conditions every matching object has to satisfy and which
+ * may be answered by an index on the target type.
+ *
+ * @param type The target type.
+ * @param variableName The name of the target variable (defaults to the lower-case type name).
+ */
+std::vector<CompiledFilterIndexHint> CompiledFilter::GetIndexHints(const Type::Ptr& type, const String& variableName) const
+{
+	std::vector<CompiledFilterIndexHint> hints;
+
+	if (m_Root)
+		GetIndexHintsForNode(m_Root.get(), type, variableName, hints);
+
+	return hints;
+}
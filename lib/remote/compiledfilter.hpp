@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef COMPILEDFILTER_H
+#define COMPILEDFILTER_H
+
+#include "remote/i2-remote.hpp"
+#include "config/expression.hpp"
+#include "base/object.hpp"
+#include "base/type.hpp"
+#include "base/configtype.hpp"
+#include <vector>
+
+namespace icinga
+{
+
+struct CompiledFilterNode;
+
+/**
+ * Per-query lookup state for a compiled filter, e.g. the field IDs which
+ * were resolved for the target type. Must not be shared between threads.
+ *
+ * @ingroup remote
+ */
+struct CompiledFilterState
+{
+	struct Slot
+	{
+		Type *CachedType{nullptr};
+		int FieldId{-1};
+		bool Resolved{false};
+		Value Global;
+	};
+
+	std::vector<Slot> Slots;
+};
+
+/**
+ * A top-level conjunct of a filter which may be answered by an index, see
+ * ConfigType::RegisterIndex().
+ *
+ * @ingroup remote
+ */
+struct CompiledFilterIndexHint
+{
+	ConfigType::IndexOperator Operator;
+	String Attribute;
+	Value Literal;
+};
+
+/**
+ * An API filter expression. Common expression shapes (comparisons of
+ * object attributes with literals, combined with &&, || and !) are
+ * lowered to a small tree which accesses fields by their ID instead of
+ * evaluating the config AST with a fully populated script frame.
+ * Everything else is evaluated by the interpreter.
+ *
+ * @ingroup remote
+ */
+class CompiledFilter final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(CompiledFilter);
+
+	~CompiledFilter() override;
+
+	static CompiledFilter::Ptr Compile(const String& text);
+
+	bool IsCompiled() const;
+	Expression *GetExpression() const;
+
+	CompiledFilterState CreateState() const;
+
+	bool Evaluate(ScriptFrame& frame, CompiledFilterState& state,
+		const Object::Ptr& target, const String& variableName = String()) const;
+
+	std::vector<CompiledFilterIndexHint> GetIndexHints(const Type::Ptr& type, const String& variableName = String()) const;
+
+private:
+	std::unique_ptr<Expression> m_Expression;
+	std::unique_ptr<CompiledFilterNode> m_Root;
+	int m_SlotCount{0};
+
+	CompiledFilter(std::unique_ptr<Expression> expression);
+};
+
+}
+
+#endif /* COMPILEDFILTER_H */
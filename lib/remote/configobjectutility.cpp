@@ -22,11 +22,13 @@
 #include "remote/apilistener.hpp"
 #include "config/configcompiler.hpp"
 #include "config/configitem.hpp"
+#include "base/application.hpp"
 #include "base/configwriter.hpp"
 #include "base/exception.hpp"
 #include "base/dependencygraph.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <fstream>
+#include <set>
 
 using namespace icinga;
 
@@ -99,6 +101,29 @@ String ConfigObjectUtility::CreateObjectConfig(const Type::Ptr& type, const Stri
 
 bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& fullName,
 	const String& config, const Array::Ptr& errors, const Array::Ptr& diagnosticInformation)
+{
+	return CreateObjects({ { type, fullName, config } }, errors, diagnosticInformation);
+}
+
+static void RemoveObjectConfigFiles(const std::vector<String>& paths)
+{
+	for (const String& path : paths) {
+		if (unlink(path.CStr()) < 0 && errno != ENOENT) {
+			BOOST_THROW_EXCEPTION(posix_error()
+				<< boost::errinfo_api_function("unlink")
+				<< boost::errinfo_errno(errno)
+				<< boost::errinfo_file_name(path));
+		}
+	}
+}
+
+/**
+ * Creates several objects in the _api package. The objects are committed
+ * and activated together, so they may refer to each other. Either all
+ * objects are created or none of them.
+ */
+bool ConfigObjectUtility::CreateObjects(const std::vector<ConfigObjectDefinition>& objects,
+	const Array::Ptr& errors, const Array::Ptr& diagnosticInformation)
 {
 	{
 		boost::mutex::scoped_lock lock(ConfigPackageUtility::GetStaticMutex());
@@ -110,47 +135,54 @@ bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& full
 		}
 	}
 
-	ConfigItem::Ptr item = ConfigItem::GetByTypeAndName(type, fullName);
+	std::vector<String> paths;
+	std::set<String> uniquePaths;
 
-	if (item) {
-		errors->Add("Object '" + fullName + "' already exists.");
-		return false;
-	}
+	for (const ConfigObjectDefinition& object : objects) {
+		ConfigItem::Ptr item = ConfigItem::GetByTypeAndName(object.ObjectType, object.Name);
+
+		if (item) {
+			errors->Add("Object '" + object.Name + "' already exists.");
+			return false;
+		}
 
-	String path = GetObjectConfigPath(type, fullName);
-	Utility::MkDirP(Utility::DirName(path), 0700);
+		String path = GetObjectConfigPath(object.ObjectType, object.Name);
 
-	if (Utility::PathExists(path)) {
-		errors->Add("Cannot create object '" + fullName + "'. Configuration file '" + path + "' already exists.");
-		return false;
+		if (Utility::PathExists(path) || !uniquePaths.insert(path).second) {
+			errors->Add("Cannot create object '" + object.Name + "'. Configuration file '" + path + "' already exists.");
+			return false;
+		}
+
+		paths.push_back(path);
 	}
 
-	std::ofstream fp(path.CStr(), std::ofstream::out | std::ostream::trunc);
-	fp << config;
-	fp.close();
+	for (std::vector<ConfigObjectDefinition>::size_type i = 0; i < objects.size(); i++) {
+		Utility::MkDirP(Utility::DirName(paths[i]), 0700);
 
-	std::unique_ptr<Expression> expr = ConfigCompiler::CompileFile(path, String(), "_api");
+		std::ofstream fp(paths[i].CStr(), std::ofstream::out | std::ostream::trunc);
+		fp << objects[i].Config;
+		fp.close();
+	}
 
 	try {
 		ActivationScope ascope;
 
-		ScriptFrame frame(true);
-		expr->Evaluate(frame);
-		expr.reset();
+		for (std::vector<ConfigObjectDefinition>::size_type i = 0; i < objects.size(); i++) {
+			/* The config was just written to this file, there's no need to read it again. */
+			std::unique_ptr<Expression> expr = ConfigCompiler::CompileText(paths[i], objects[i].Config, String(), "_api");
 
-		WorkQueue upq;
-		upq.SetName("ConfigObjectUtility::CreateObject");
+			ScriptFrame frame(true);
+			expr->Evaluate(frame);
+		}
+
+		WorkQueue upq(25000, objects.size() > 1 ? Application::GetConcurrency() : 1);
+		upq.SetName("ConfigObjectUtility::CreateObjects");
 
 		std::vector<ConfigItem::Ptr> newItems;
 
 		if (!ConfigItem::CommitItems(ascope.GetContext(), upq, newItems) || !ConfigItem::ActivateItems(upq, newItems, true)) {
 			if (errors) {
-				if (unlink(path.CStr()) < 0 && errno != ENOENT) {
-					BOOST_THROW_EXCEPTION(posix_error()
-						<< boost::errinfo_api_function("unlink")
-						<< boost::errinfo_errno(errno)
-						<< boost::errinfo_file_name(path));
-				}
+				RemoveObjectConfigFiles(paths);
 
 				for (const boost::exception_ptr& ex : upq.GetExceptions()) {
 					errors->Add(DiagnosticInformation(ex, false));
@@ -165,12 +197,7 @@ bool ConfigObjectUtility::CreateObject(const Type::Ptr& type, const String& full
 
 		ApiListener::UpdateObjectAuthority();
 	} catch (const std::exception& ex) {
-		if (unlink(path.CStr()) < 0 && errno != ENOENT) {
-			BOOST_THROW_EXCEPTION(posix_error()
-				<< boost::errinfo_api_function("unlink")
-				<< boost::errinfo_errno(errno)
-				<< boost::errinfo_file_name(path));
-		}
+		RemoveObjectConfigFiles(paths);
 
 		if (errors)
 			errors->Add(DiagnosticInformation(ex, false));
@@ -29,6 +29,18 @@
 namespace icinga
 {
 
+/**
+ * The generated configuration for an object which is created at runtime.
+ *
+ * @ingroup remote
+ */
+struct ConfigObjectDefinition
+{
+	Type::Ptr ObjectType;
+	String Name;
+	String Config;
+};
+
 /**
  * Helper functions.
  *
@@ -46,6 +58,8 @@ public:
 
 	static bool CreateObject(const Type::Ptr& type, const String& fullName,
 		const String& config, const Array::Ptr& errors, const Array::Ptr& diagnosticInformation);
+	static bool CreateObjects(const std::vector<ConfigObjectDefinition>& objects,
+		const Array::Ptr& errors, const Array::Ptr& diagnosticInformation);
 
 	static bool DeleteObject(const ConfigObject::Ptr& object, bool cascade, const Array::Ptr& errors,
 		const Array::Ptr& diagnosticInformation);
@@ -18,13 +18,20 @@
  ******************************************************************************/
 
 #include "remote/configpackageutility.hpp"
+#include "config/applyrule.hpp"
+#include "config/configcompiler.hpp"
+#include "config/configitem.hpp"
 #include "base/application.hpp"
+#include "base/configtype.hpp"
+#include "base/dependencygraph.hpp"
 #include "base/exception.hpp"
+#include "base/logger.hpp"
 #include "base/utility.hpp"
 #include <boost/algorithm/string.hpp>
 #include <boost/regex.hpp>
 #include <algorithm>
 #include <fstream>
+#include <set>
 
 using namespace icinga;
 
@@ -210,10 +217,165 @@ void ConfigPackageUtility::TryActivateStageCallback(const ProcessResult& pr, con
 	}
 }
 
+/**
+ * Collects the config files which are included for a stage together with
+ * the zone they belong to.
+ */
+void ConfigPackageUtility::CollectStageConfigFiles(const String& packageName, const String& stageName, std::vector<std::pair<String, String> >& files)
+{
+	String stagePath = GetPackageDir() + "/" + packageName + "/" + stageName;
+
+	Utility::GlobRecursive(stagePath + "/conf.d", "*.conf", [&files](const String& path) {
+		files.emplace_back(path, String());
+	}, GlobFile);
+
+	std::vector<String> zoneDirs;
+	Utility::Glob(stagePath + "/zones.d/*", std::bind(&ConfigPackageUtility::CollectDirNames, _1, std::ref(zoneDirs)), GlobDirectory);
+
+	for (const String& zoneName : zoneDirs) {
+		Utility::GlobRecursive(stagePath + "/zones.d/" + zoneName, "*.conf", [&files, &zoneName](const String& path) {
+			files.emplace_back(path, zoneName);
+		}, GlobFile);
+	}
+}
+
+/**
+ * Validates a stage which only contains object definitions in this process.
+ * The objects are validated against the running configuration in place of
+ * the objects from the package's active stage.
+ *
+ * @returns false if the stage has to be validated in a new process.
+ */
+bool ConfigPackageUtility::TryValidateStageInProcess(const String& packageName, const String& stageName, ProcessResult& pr)
+{
+	/* The running configuration must contain the active stage, and it must not have
+	 * defined anything but objects which the new stage can replace. */
+	String activeStage = GetActiveStage(packageName);
+
+	if (!activeStage.IsEmpty()) {
+		std::vector<std::pair<String, String> > activeFiles;
+		CollectStageConfigFiles(packageName, activeStage, activeFiles);
+
+		for (const auto& file : activeFiles) {
+			ConfigFileInfo info;
+
+			if (!ConfigCompiler::GetConfigFileInfo(file.first, &info) || !info.ObjectsOnly)
+				return false;
+		}
+	}
+
+	std::vector<std::pair<String, String> > files;
+	CollectStageConfigFiles(packageName, stageName, files);
+
+	pr.ExecutionStart = Utility::GetTime();
+
+	std::ostringstream msgbuf;
+	std::vector<ConfigObject::Ptr> objects;
+
+	try {
+		std::vector<std::unique_ptr<Expression> > expressions;
+
+		for (const auto& file : files) {
+			std::ifstream fp(file.first.CStr(), std::ifstream::in | std::ifstream::binary);
+
+			if (!fp)
+				return false;
+
+			String content((std::istreambuf_iterator<char>(fp)), std::istreambuf_iterator<char>());
+
+			std::unique_ptr<Expression> expression = ConfigCompiler::CompileText(file.first, content, file.second, packageName);
+
+			if (!ConfigCompiler::IsObjectsOnly(expression.get()))
+				return false;
+
+			expressions.push_back(std::move(expression));
+		}
+
+		objects = ConfigItem::ValidateItems(packageName, expressions);
+	} catch (const std::exception& ex) {
+		msgbuf << "critical/config: " << DiagnosticInformation(ex, false) << "\n"
+			<< "critical/cli: Config validation failed. Re-run with 'icinga2 daemon -C' after fixing the config.\n";
+
+		pr.ExecutionEnd = Utility::GetTime();
+		pr.ExitStatus = 1;
+		pr.Output = msgbuf.str();
+		return true;
+	}
+
+	std::set<std::pair<Type::Ptr, String> > names;
+
+	for (const ConfigObject::Ptr& object : objects) {
+		Type::Ptr type = object->GetReflectionType();
+
+		/* Apply rules are evaluated when the objects are loaded. */
+		for (const Type::Ptr& applyType : Type::GetAllTypes()) {
+			std::vector<String> targetTypes = ApplyRule::GetTargetTypes(applyType->GetName());
+
+			if (std::find(targetTypes.begin(), targetTypes.end(), type->GetName()) == targetTypes.end())
+				continue;
+
+			for (const ApplyRule& rule : ApplyRule::GetRules(applyType->GetName())) {
+				if (rule.GetTargetType() == type->GetName())
+					return false;
+			}
+		}
+
+		names.insert(std::make_pair(type, object->GetName()));
+	}
+
+	/* Objects which are removed from the package must not be used by other objects. */
+	for (const Type::Ptr& type : Type::GetAllTypes()) {
+		auto *ctype = dynamic_cast<ConfigType *>(type.get());
+
+		if (!ctype)
+			continue;
+
+		for (const ConfigObject::Ptr& object : ctype->GetObjects()) {
+			if (object->GetPackage() != packageName || names.find(std::make_pair(type, object->GetName())) != names.end())
+				continue;
+
+			for (const Object::Ptr& pobj : DependencyGraph::GetParents(object)) {
+				ConfigObject::Ptr parent = dynamic_pointer_cast<ConfigObject>(pobj);
+
+				if (parent && parent->GetPackage() != packageName)
+					return false;
+			}
+		}
+	}
+
+	pr.ExecutionEnd = Utility::GetTime();
+
+	msgbuf << "information/ConfigPackageUtility: Validated " << objects.size() << " objects from "
+		<< files.size() << " config files in " << Utility::FormatDuration(pr.ExecutionEnd - pr.ExecutionStart) << ".\n"
+		<< "information/cli: Finished validating the configuration file(s).\n";
+
+	pr.ExitStatus = 0;
+	pr.Output = msgbuf.str();
+	return true;
+}
+
 void ConfigPackageUtility::AsyncTryActivateStage(const String& packageName, const String& stageName, bool reload)
 {
 	VERIFY(Application::GetArgC() >= 1);
 
+	/* Stages which only contain object definitions don't require loading the whole configuration. */
+	Utility::QueueAsyncCallback([packageName, stageName, reload]() {
+		ProcessResult pr;
+
+		if (TryValidateStageInProcess(packageName, stageName, pr)) {
+			Log(LogInformation, "ConfigPackageUtility")
+				<< "Validated stage '" << stageName << "' for package '" << packageName << "' without starting a new process.";
+
+			TryActivateStageCallback(pr, packageName, stageName, reload);
+			return;
+		}
+
+		AsyncValidateStageInChildProcess(packageName, stageName, reload);
+	});
+}
+
+void ConfigPackageUtility::AsyncValidateStageInChildProcess(const String& packageName, const String& stageName, bool reload)
+{
 	// prepare arguments
 	Array::Ptr args = new Array({
 		Application::GetExePath(Application::GetArgV()[0]),
@@ -68,6 +68,9 @@ private:
 	static void WriteStageConfig(const String& packageName, const String& stageName);
 
 	static void TryActivateStageCallback(const ProcessResult& pr, const String& packageName, const String& stageName, bool reload);
+	static void AsyncValidateStageInChildProcess(const String& packageName, const String& stageName, bool reload);
+	static bool TryValidateStageInProcess(const String& packageName, const String& stageName, ProcessResult& pr);
+	static void CollectStageConfigFiles(const String& packageName, const String& stageName, std::vector<std::pair<String, String> >& files);
 };
 
 }
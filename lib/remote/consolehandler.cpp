@@ -154,7 +154,7 @@ bool ConsoleHandler::ExecuteScriptHelper(HttpRequest& request, HttpResponse& res
 			{ "status", String(msgbuf.str()) },
 			{ "incomplete_expression", ex.IsIncompleteExpression() },
 			{ "debug_info", new Dictionary({
-				{ "path", di.Path },
+				{ "path", di.Path.GetString() },
 				{ "first_line", di.FirstLine },
 				{ "first_column", di.FirstColumn },
 				{ "last_line", di.LastLine },
@@ -31,36 +31,17 @@ using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/objects", CreateObjectHandler);
 
-bool CreateObjectHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+/**
+ * Puts created objects into the local zone if not explicitly defined.
+ * This allows additional zone members to sync the
+ * configuration at some later point.
+ */
+static Dictionary::Ptr PrepareAttrs(Dictionary::Ptr attrs)
 {
-	if (request.RequestUrl->GetPath().size() != 4)
-		return false;
-
-	if (request.RequestMethod != "PUT")
-		return false;
-
-	Type::Ptr type = FilterUtility::TypeFromPluralName(request.RequestUrl->GetPath()[2]);
-
-	if (!type) {
-		HttpUtility::SendJsonError(response, params, 400, "Invalid type specified.");
-		return true;
-	}
-
-	FilterUtility::CheckPermission(user, "objects/create/" + type->GetName());
-
-	String name = request.RequestUrl->GetPath()[3];
-	Array::Ptr templates = params->Get("templates");
-	Dictionary::Ptr attrs = params->Get("attrs");
-
-	/* Put created objects into the local zone if not explicitly defined.
-	 * This allows additional zone members to sync the
-	 * configuration at some later point.
-	 */
 	Zone::Ptr localZone = Zone::GetLocalZone();
-	String localZoneName;
 
 	if (localZone) {
-		localZoneName = localZone->GetName();
+		String localZoneName = localZone->GetName();
 
 		if (!attrs) {
 			attrs = new Dictionary({
@@ -72,13 +53,40 @@ bool CreateObjectHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& r
 	}
 
 	/* Sanity checks for unique groups array. */
-	if (attrs->Contains("groups")) {
+	if (attrs && attrs->Contains("groups")) {
 		Array::Ptr groups = attrs->Get("groups");
 
 		if (groups)
 			attrs->Set("groups", groups->Unique());
 	}
 
+	return attrs;
+}
+
+bool CreateObjectHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	if (request.RequestMethod != "PUT")
+		return false;
+
+	if (request.RequestUrl->GetPath().size() == 2)
+		return HandleBulkRequest(user, request, response, params);
+
+	if (request.RequestUrl->GetPath().size() != 4)
+		return false;
+
+	Type::Ptr type = FilterUtility::TypeFromPluralName(request.RequestUrl->GetPath()[2]);
+
+	if (!type) {
+		HttpUtility::SendJsonError(response, params, 400, "Invalid type specified.");
+		return true;
+	}
+
+	FilterUtility::CheckPermission(user, "objects/create/" + type->GetName());
+
+	String name = request.RequestUrl->GetPath()[3];
+	Array::Ptr templates = params->Get("templates");
+	Dictionary::Ptr attrs = PrepareAttrs(params->Get("attrs"));
+
 	Dictionary::Ptr result1 = new Dictionary();
 	String status;
 	Array::Ptr errors = new Array();
@@ -151,3 +159,117 @@ bool CreateObjectHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& r
 
 	return true;
 }
+
+/**
+ * Creates several objects which are specified in the 'objects' array of the
+ * request body. The objects are committed together, so e.g. services can be
+ * created in the same request as their hosts.
+ */
+bool CreateObjectHandler::HandleBulkRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	Array::Ptr objects = params->Get("objects");
+
+	if (!objects || objects->GetLength() == 0) {
+		HttpUtility::SendJsonError(response, params, 400, "No objects specified.");
+		return true;
+	}
+
+	bool ignoreOnError = false;
+
+	if (params->Contains("ignore_on_error"))
+		ignoreOnError = HttpUtility::GetLastParameter(params, "ignore_on_error");
+
+	bool verbose = HttpUtility::GetLastParameter(params, "verbose");
+
+	std::vector<ConfigObjectDefinition> definitions;
+	Array::Ptr errors = new Array();
+	Array::Ptr diagnosticInformation = new Array();
+
+	{
+		ObjectLock olock(objects);
+		for (const Value& vobject : objects) {
+			if (!vobject.IsObjectType<Dictionary>()) {
+				HttpUtility::SendJsonError(response, params, 400, "Objects must be dictionaries.");
+				return true;
+			}
+
+			Dictionary::Ptr object = vobject;
+			String name = object->Get("name");
+
+			if (name.IsEmpty()) {
+				HttpUtility::SendJsonError(response, params, 400, "Object names must not be empty.");
+				return true;
+			}
+
+			Type::Ptr type = Type::GetByName(object->Get("type"));
+
+			if (!type || !ConfigObject::TypeInstance->IsAssignableFrom(type)) {
+				HttpUtility::SendJsonError(response, params, 400, "Invalid type specified for object '" + name + "'.");
+				return true;
+			}
+
+			FilterUtility::CheckPermission(user, "objects/create/" + type->GetName());
+
+			try {
+				definitions.push_back({ type, name, ConfigObjectUtility::CreateObjectConfig(type, name, ignoreOnError,
+					object->Get("templates"), PrepareAttrs(object->Get("attrs"))) });
+			} catch (const std::exception& ex) {
+				errors->Add(DiagnosticInformation(ex, false));
+				diagnosticInformation->Add(DiagnosticInformation(ex));
+				break;
+			}
+		}
+	}
+
+	bool success = errors->GetLength() == 0 && ConfigObjectUtility::CreateObjects(definitions, errors, diagnosticInformation);
+
+	ArrayData results;
+
+	for (const ConfigObjectDefinition& definition : definitions) {
+		Dictionary::Ptr result1 = new Dictionary({
+			{ "type", definition.ObjectType->GetName() },
+			{ "name", definition.Name }
+		});
+
+		if (success) {
+			auto *ctype = dynamic_cast<ConfigType *>(definition.ObjectType.get());
+
+			result1->Set("code", 200);
+
+			if (ctype->GetObject(definition.Name))
+				result1->Set("status", "Object was created");
+			else
+				result1->Set("status", "Object was not created but 'ignore_on_error' was set to true");
+		} else {
+			result1->Set("code", 500);
+			result1->Set("status", "Object could not be created.");
+			result1->Set("errors", errors);
+
+			if (verbose)
+				result1->Set("diagnostic_information", diagnosticInformation);
+		}
+
+		results.push_back(result1);
+	}
+
+	if (results.empty()) {
+		results.push_back(new Dictionary({
+			{ "code", 500 },
+			{ "status", "Object could not be created." },
+			{ "errors", errors }
+		}));
+	}
+
+	Dictionary::Ptr result = new Dictionary({
+		{ "results", new Array(std::move(results)) }
+	});
+
+	if (success)
+		response.SetStatus(200, "OK");
+	else
+		response.SetStatus(500, "Objects could not be created");
+
+	HttpUtility::SendJsonBody(response, params, result);
+
+	return true;
+}
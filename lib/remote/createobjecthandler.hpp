@@ -32,6 +32,10 @@ public:
 
 	bool HandleRequest(const ApiUser::Ptr& user, HttpRequest& request,
 		HttpResponse& response, const Dictionary::Ptr& params) override;
+
+private:
+	static bool HandleBulkRequest(const ApiUser::Ptr& user, HttpRequest& request,
+		HttpResponse& response, const Dictionary::Ptr& params);
 };
 
 }
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/debughandler.hpp"
+#include "remote/httputility.hpp"
+#include "remote/filterutility.hpp"
+#include "base/convert.hpp"
+#include "base/exception.hpp"
+#include "base/profiler.hpp"
+
+using namespace icinga;
+
+REGISTER_URLHANDLER("/v1/debug", DebugHandler);
+
+bool DebugHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
+{
+	const std::vector<String>& urlPath = request.RequestUrl->GetPath();
+
+	if (urlPath.size() != 3 || urlPath[2] != "profile")
+		return false;
+
+	if (request.RequestMethod != "GET")
+		return false;
+
+	FilterUtility::CheckPermission(user, "debug/profile");
+
+	if (!Profiler::IsSupported()) {
+		HttpUtility::SendJsonError(response, params, 501, "The profiler is not supported on this platform.");
+		return true;
+	}
+
+	double seconds = 30;
+	String secondsParam = HttpUtility::GetLastParameter(params, "seconds");
+
+	if (!secondsParam.IsEmpty()) {
+		try {
+			seconds = Convert::ToDouble(secondsParam);
+		} catch (const std::exception&) {
+			seconds = -1;
+		}
+
+		if (seconds <= 0 || seconds > 300) {
+			HttpUtility::SendJsonError(response, params, 400, "'seconds' must be a number between 0 and 300.");
+			return true;
+		}
+	}
+
+	String stacks;
+
+	try {
+		stacks = Profiler::Profile(seconds);
+	} catch (const std::exception& ex) {
+		HttpUtility::SendJsonError(response, params, 409, "Could not start profiling session.",
+			DiagnosticInformation(ex));
+		return true;
+	}
+
+	response.SetStatus(200, "OK");
+	response.AddHeader("Content-Type", "text/plain");
+	response.WriteBody(stacks.CStr(), stacks.GetLength());
+
+	return true;
+}
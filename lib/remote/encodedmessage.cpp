@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/encodedmessage.hpp"
+#include "base/json.hpp"
+#include "base/object-packer.hpp"
+
+using namespace icinga;
+
+EncodedMessage::EncodedMessage(Dictionary::Ptr message)
+	: m_Message(std::move(message))
+{ }
+
+Dictionary::Ptr EncodedMessage::GetMessage() const
+{
+	return m_Message;
+}
+
+String EncodedMessage::GetJson()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_HasJson) {
+		m_Json = JsonEncode(m_Message);
+		m_HasJson = true;
+	}
+
+	return m_Json;
+}
+
+String EncodedMessage::GetBinary()
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	if (!m_HasBinary) {
+		m_Binary = PackObject(m_Message);
+		m_HasBinary = true;
+	}
+
+	return m_Binary;
+}
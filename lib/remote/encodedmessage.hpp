@@ -0,0 +1,62 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#ifndef ENCODEDMESSAGE_H
+#define ENCODEDMESSAGE_H
+
+#include "remote/i2-remote.hpp"
+#include "base/dictionary.hpp"
+#include <boost/thread/mutex.hpp>
+
+namespace icinga
+{
+
+/**
+ * A cluster message which is encoded at most once per encoding, no matter
+ * how many connections and log files it is written to.
+ *
+ * The message must not be modified once it has been wrapped.
+ *
+ * @ingroup remote
+ */
+class EncodedMessage final : public Object
+{
+public:
+	DECLARE_PTR_TYPEDEFS(EncodedMessage);
+
+	EncodedMessage(Dictionary::Ptr message);
+
+	Dictionary::Ptr GetMessage() const;
+
+	String GetJson();
+	String GetBinary();
+
+private:
+	Dictionary::Ptr m_Message;
+
+	boost::mutex m_Mutex;
+	bool m_HasJson{false};
+	String m_Json;
+	bool m_HasBinary{false};
+	String m_Binary;
+};
+
+}
+
+#endif /* ENCODEDMESSAGE_H */
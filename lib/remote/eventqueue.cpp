@@ -21,9 +21,15 @@
 #include "remote/filterutility.hpp"
 #include "base/singleton.hpp"
 #include "base/logger.hpp"
+#include "base/json.hpp"
+#include "base/utility.hpp"
+#include <boost/algorithm/string/replace.hpp>
 
 using namespace icinga;
 
+static boost::mutex l_FiltersMutex;
+static std::map<String, CompiledFilter::Ptr> l_Filters;
+
 EventQueue::EventQueue(String name)
 	: m_Name(std::move(name))
 { }
@@ -37,33 +43,150 @@ bool EventQueue::CanProcessEvent(const String& type) const
 
 void EventQueue::ProcessEvent(const Dictionary::Ptr& event)
 {
-	ScriptFrame frame(true);
-	frame.Sandboxed = true;
+	ProcessEvent({ this }, event);
+}
+
+/**
+ * Adds an event to all queues whose filter matches it. Queues which were
+ * created with the same filter text share a filter, it is evaluated only
+ * once per event. The event is JSON-encoded only once and all clients
+ * write the same buffer.
+ *
+ * @param queues The queues, see GetQueuesForType().
+ * @param event The event.
+ */
+void EventQueue::ProcessEvent(const std::vector<EventQueue::Ptr>& queues, const Dictionary::Ptr& event)
+{
+	std::map<CompiledFilter::Ptr, bool> matches;
+	std::shared_ptr<const String> body;
+
+	for (const EventQueue::Ptr& queue : queues) {
+		CompiledFilter::Ptr filter = queue->GetFilter();
+
+		if (filter) {
+			auto it = matches.find(filter);
+
+			if (it == matches.end()) {
+				bool match;
+
+				try {
+					ScriptFrame frame(true);
+					frame.Sandboxed = true;
+
+					CompiledFilterState state = filter->CreateState();
+					match = filter->Evaluate(frame, state, event, "event");
+				} catch (const std::exception& ex) {
+					Log(LogWarning, "EventQueue")
+						<< "Error occurred while evaluating event filter for queue '" << queue->m_Name << "': " << DiagnosticInformation(ex);
+					match = false;
+				}
+
+				it = matches.insert(std::make_pair(filter, match)).first;
+			}
+
+			if (!it->second)
+				continue;
+		}
+
+		if (!body) {
+			String json = JsonEncode(event);
+			boost::algorithm::replace_all(json, "\n", "");
+			json += "\n";
+
+			body = std::make_shared<const String>(std::move(json));
+		}
 
-	try {
-		if (!FilterUtility::EvaluateFilter(frame, m_Filter.get(), event, "event"))
-			return;
-	} catch (const std::exception& ex) {
-		Log(LogWarning, "EventQueue")
-			<< "Error occurred while evaluating event filter for queue '" << m_Name << "': " << DiagnosticInformation(ex);
-		return;
+		queue->PushEvent(body);
 	}
+}
+
+void EventQueue::PushEvent(const std::shared_ptr<const String>& body)
+{
+	double now = Utility::GetTime();
 
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	typedef std::pair<void *const, std::deque<Dictionary::Ptr> > kv_pair;
-	for (kv_pair& kv : m_Events) {
-		kv.second.push_back(event);
+	size_t limit = m_Capacity > 0 ? m_Capacity : m_TrimThreshold;
+
+	if (m_Events.size() >= limit) {
+		TrimEvents();
+
+		if (m_Capacity > 0 && m_Events.size() >= m_Capacity) {
+			/* Some clients are lagging behind by the whole capacity. */
+			uint_fast64_t end = m_EventsStart + m_Events.size();
+			bool dropEvent = false;
+
+			for (auto& kv : m_Clients) {
+				EventQueueClient& client = kv.second;
+				uint_fast64_t backlog = end - client.Cursor;
+
+				if (client.Overflowed || backlog < m_Capacity)
+					continue;
+
+				if (client.Dropped == 0) {
+					Log(LogWarning, "EventQueue")
+						<< "Event queue '" << m_Name << "' is full (" << m_Capacity << " events), the client is not reading fast enough.";
+				}
+
+				if (m_OverflowPolicy == EventQueueDisconnect) {
+					client.Dropped += backlog + 1;
+					m_Dropped += backlog + 1;
+					client.Overflowed = true;
+				} else if (m_OverflowPolicy == EventQueueDropNewest) {
+					client.Dropped++;
+					m_Dropped++;
+					dropEvent = true;
+				} else {
+					uint_fast64_t skip = backlog - m_Capacity + 1;
+					client.Dropped += skip;
+					m_Dropped += skip;
+					client.Cursor += skip;
+				}
+			}
+
+			/* The queue is shared, dropping new events affects all of its clients. */
+			if (dropEvent)
+				return;
+
+			TrimEvents();
+		}
+
+		if (m_Capacity == 0)
+			m_TrimThreshold = m_Events.size() + 1024;
+	}
+
+	m_Events.emplace_back(now, body);
+
+	if (m_WaitingClients > 0)
+		m_CV.notify_all();
+}
+
+/**
+ * Removes the events which all clients have read already.
+ */
+void EventQueue::TrimEvents()
+{
+	uint_fast64_t minCursor = m_EventsStart + m_Events.size();
+
+	for (const auto& kv : m_Clients) {
+		if (!kv.second.Overflowed && kv.second.Cursor < minCursor)
+			minCursor = kv.second.Cursor;
 	}
 
-	m_CV.notify_all();
+	while (m_EventsStart < minCursor) {
+		m_Events.pop_front();
+		m_EventsStart++;
+	}
 }
 
 void EventQueue::AddClient(void *client)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	auto result = m_Events.insert(std::make_pair(client, std::deque<Dictionary::Ptr>()));
+	EventQueueClient info;
+	info.Cursor = m_EventsStart + m_Events.size();
+
+	auto result = m_Clients.insert(std::make_pair(client, info));
 	ASSERT(result.second);
 }
 
@@ -71,14 +194,14 @@ void EventQueue::RemoveClient(void *client)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
-	m_Events.erase(client);
+	m_Clients.erase(client);
 }
 
 void EventQueue::UnregisterIfUnused(const String& name, const EventQueue::Ptr& queue)
 {
 	boost::mutex::scoped_lock lock(queue->m_Mutex);
 
-	if (queue->m_Events.empty())
+	if (queue->m_Clients.empty())
 		Unregister(name);
 }
 
@@ -88,27 +211,160 @@ void EventQueue::SetTypes(const std::set<String>& types)
 	m_Types = types;
 }
 
-void EventQueue::SetFilter(std::unique_ptr<Expression> filter)
+void EventQueue::SetFilter(const CompiledFilter::Ptr& filter)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
-	m_Filter.swap(filter);
+	m_Filter = filter;
 }
 
-Dictionary::Ptr EventQueue::WaitForEvent(void *client, double timeout)
+CompiledFilter::Ptr EventQueue::GetFilter() const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	return m_Filter;
+}
+
+/**
+ * Sets the maximum number of pending events per client.
+ *
+ * @param capacity The capacity, 0 means unbounded.
+ */
+void EventQueue::SetCapacity(size_t capacity)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_Capacity = capacity;
+}
+
+void EventQueue::SetOverflowPolicy(EventQueueOverflowPolicy policy)
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+	m_OverflowPolicy = policy;
+}
+
+bool EventQueue::ParseOverflowPolicy(const String& name, EventQueueOverflowPolicy *policy)
+{
+	if (name == "drop-oldest")
+		*policy = EventQueueDropOldest;
+	else if (name == "drop-newest")
+		*policy = EventQueueDropNewest;
+	else if (name == "disconnect")
+		*policy = EventQueueDisconnect;
+	else
+		return false;
+
+	return true;
+}
+
+static String OverflowPolicyToString(EventQueueOverflowPolicy policy)
+{
+	switch (policy) {
+		case EventQueueDropNewest:
+			return "drop-newest";
+		case EventQueueDisconnect:
+			return "disconnect";
+		default:
+			return "drop-oldest";
+	}
+}
+
+/**
+ * Checks whether a client was dropped because its queue overflowed
+ * with the "disconnect" policy.
+ */
+bool EventQueue::HasOverflowed(void *client) const
+{
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	auto it = m_Clients.find(client);
+
+	return it != m_Clients.end() && it->second.Overflowed;
+}
+
+Dictionary::Ptr EventQueue::GetStatus() const
+{
+	double now = Utility::GetTime();
+
+	boost::mutex::scoped_lock lock(m_Mutex);
+
+	ArrayData clients;
+	clients.reserve(m_Clients.size());
+
+	uint_fast64_t end = m_EventsStart + m_Events.size();
+
+	for (const auto& kv : m_Clients) {
+		const EventQueueClient& client = kv.second;
+		size_t items = client.Overflowed ? 0 : end - client.Cursor;
+
+		clients.emplace_back(new Dictionary({
+			{ "queue_items", items },
+			{ "dropped", client.Dropped },
+			{ "oldest_event_age", items == 0 ? 0 : now - m_Events[client.Cursor - m_EventsStart].first }
+		}));
+	}
+
+	return new Dictionary({
+		{ "types", Array::FromSet(m_Types) },
+		{ "capacity", m_Capacity },
+		{ "overflow_policy", OverflowPolicyToString(m_OverflowPolicy) },
+		{ "dropped", m_Dropped },
+		{ "clients", new Array(std::move(clients)) }
+	});
+}
+
+/**
+ * Compiles an event filter. Queues with the same filter text get the same
+ * filter object so that ProcessEvent() only has to evaluate it once.
+ *
+ * @param text The filter expression.
+ * @returns The compiled filter.
+ */
+CompiledFilter::Ptr EventQueue::CompileFilter(const String& text)
+{
+	boost::mutex::scoped_lock lock(l_FiltersMutex);
+
+	/* Forget the filters which no queue uses anymore. */
+	for (auto it = l_Filters.begin(); it != l_Filters.end(); ) {
+		if (it->second->GetReferenceCount() == 1)
+			it = l_Filters.erase(it);
+		else
+			it++;
+	}
+
+	auto it = l_Filters.find(text);
+
+	if (it != l_Filters.end())
+		return it->second;
+
+	CompiledFilter::Ptr filter = CompiledFilter::Compile(text);
+	l_Filters[text] = filter;
+
+	return filter;
+}
+
+std::shared_ptr<const String> EventQueue::WaitForEvent(void *client, double timeout)
 {
 	boost::mutex::scoped_lock lock(m_Mutex);
 
 	for (;;) {
-		auto it = m_Events.find(client);
-		ASSERT(it != m_Events.end());
+		auto it = m_Clients.find(client);
+		ASSERT(it != m_Clients.end());
+
+		if (it->second.Overflowed)
+			return nullptr;
 
-		if (!it->second.empty()) {
-			Dictionary::Ptr result = *it->second.begin();
-			it->second.pop_front();
+		uint_fast64_t& cursor = it->second.Cursor;
+
+		if (cursor < m_EventsStart + m_Events.size()) {
+			std::shared_ptr<const String> result = m_Events[cursor - m_EventsStart].second;
+			cursor++;
 			return result;
 		}
 
-		if (!m_CV.timed_wait(lock, boost::posix_time::milliseconds(long(timeout * 1000))))
+		/* Producers only wake us up when someone is actually waiting. */
+		m_WaitingClients++;
+		bool signaled = m_CV.timed_wait(lock, boost::posix_time::milliseconds(long(timeout * 1000)));
+		m_WaitingClients--;
+
+		if (!signaled)
 			return nullptr;
 	}
 }
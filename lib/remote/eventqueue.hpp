@@ -22,16 +22,41 @@
 
 #include "remote/httphandler.hpp"
 #include "base/object.hpp"
-#include "config/expression.hpp"
+#include "remote/compiledfilter.hpp"
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <set>
 #include <map>
 #include <deque>
+#include <memory>
 
 namespace icinga
 {
 
+/**
+ * What to do when a client's event queue is full.
+ *
+ * @ingroup remote
+ */
+enum EventQueueOverflowPolicy
+{
+	EventQueueDropOldest,
+	EventQueueDropNewest,
+	EventQueueDisconnect
+};
+
+/**
+ * The read position of a single HTTP client in an event queue.
+ *
+ * @ingroup remote
+ */
+struct EventQueueClient
+{
+	uint_fast64_t Cursor{0};
+	uint_fast64_t Dropped{0};
+	bool Overflowed{false};
+};
+
 class EventQueue final : public Object
 {
 public:
@@ -45,13 +70,24 @@ public:
 	void RemoveClient(void *client);
 
 	void SetTypes(const std::set<String>& types);
-	void SetFilter(std::unique_ptr<Expression> filter);
+	void SetFilter(const CompiledFilter::Ptr& filter);
+	CompiledFilter::Ptr GetFilter() const;
+	void SetCapacity(size_t capacity);
+	void SetOverflowPolicy(EventQueueOverflowPolicy policy);
 
-	Dictionary::Ptr WaitForEvent(void *client, double timeout = 5);
+	std::shared_ptr<const String> WaitForEvent(void *client, double timeout = 5);
+	bool HasOverflowed(void *client) const;
+
+	Dictionary::Ptr GetStatus() const;
+
+	static void ProcessEvent(const std::vector<EventQueue::Ptr>& queues, const Dictionary::Ptr& event);
+	static CompiledFilter::Ptr CompileFilter(const String& text);
 
 	static std::vector<EventQueue::Ptr> GetQueuesForType(const String& type);
 	static void UnregisterIfUnused(const String& name, const EventQueue::Ptr& queue);
 
+	static bool ParseOverflowPolicy(const String& name, EventQueueOverflowPolicy *policy);
+
 	static EventQueue::Ptr GetByName(const String& name);
 	static void Register(const String& name, const EventQueue::Ptr& function);
 	static void Unregister(const String& name);
@@ -63,9 +99,22 @@ private:
 	boost::condition_variable m_CV;
 
 	std::set<String> m_Types;
-	std::unique_ptr<Expression> m_Filter;
-
-	std::map<void *, std::deque<Dictionary::Ptr> > m_Events;
+	CompiledFilter::Ptr m_Filter;
+	size_t m_Capacity{0};
+	EventQueueOverflowPolicy m_OverflowPolicy{EventQueueDropOldest};
+	uint_fast64_t m_Dropped{0};
+
+	/* The JSON encoded events (shared between all queues) and when they were queued.
+	 * All clients read from the same buffer, each one with its own cursor. */
+	std::deque<std::pair<double, std::shared_ptr<const String> > > m_Events;
+	uint_fast64_t m_EventsStart{0};
+	size_t m_TrimThreshold{0};
+
+	std::map<void *, EventQueueClient> m_Clients;
+	int m_WaitingClients{0};
+
+	void PushEvent(const std::shared_ptr<const String>& body);
+	void TrimEvents();
 };
 
 /**
@@ -20,11 +20,12 @@
 #include "remote/eventshandler.hpp"
 #include "remote/httputility.hpp"
 #include "remote/filterutility.hpp"
+#include "remote/apilistener.hpp"
 #include "config/configcompiler.hpp"
 #include "config/expression.hpp"
 #include "base/objectlock.hpp"
-#include "base/json.hpp"
-#include <boost/algorithm/string/replace.hpp>
+#include "base/convert.hpp"
+#include "base/logger.hpp"
 
 using namespace icinga;
 
@@ -66,10 +67,41 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 
 	String filter = HttpUtility::GetLastParameter(params, "filter");
 
-	std::unique_ptr<Expression> ufilter;
+	CompiledFilter::Ptr ufilter;
 
 	if (!filter.IsEmpty())
-		ufilter = ConfigCompiler::CompileText("<API query>", filter);
+		ufilter = EventQueue::CompileFilter(filter);
+
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+	size_t capacity = listener ? listener->GetEventsQueueCapacity() : 0;
+	String policyName = listener ? listener->GetEventsOverflowPolicy() : "drop-oldest";
+
+	/* Clients may ask for a smaller queue, but not for a larger one. */
+	String capacityParam = HttpUtility::GetLastParameter(params, "capacity");
+
+	if (!capacityParam.IsEmpty()) {
+		int requested = Convert::ToLong(capacityParam);
+
+		if (requested <= 0) {
+			HttpUtility::SendJsonError(response, params, 400, "'capacity' query parameter must be a positive number.");
+			return true;
+		}
+
+		if (capacity == 0 || static_cast<size_t>(requested) < capacity)
+			capacity = requested;
+	}
+
+	String overflowParam = HttpUtility::GetLastParameter(params, "overflow");
+
+	if (!overflowParam.IsEmpty())
+		policyName = overflowParam;
+
+	EventQueueOverflowPolicy policy;
+
+	if (!EventQueue::ParseOverflowPolicy(policyName, &policy)) {
+		HttpUtility::SendJsonError(response, params, 400, "'overflow' query parameter must be one of 'drop-oldest', 'drop-newest' or 'disconnect'.");
+		return true;
+	}
 
 	/* create a new queue or update an existing one */
 	EventQueue::Ptr queue = EventQueue::GetByName(queueName);
@@ -80,7 +112,9 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 	}
 
 	queue->SetTypes(types->ToSet<String>());
-	queue->SetFilter(std::move(ufilter));
+	queue->SetFilter(ufilter);
+	queue->SetCapacity(capacity);
+	queue->SetOverflowPolicy(policy);
 
 	queue->AddClient(&request);
 
@@ -88,7 +122,7 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 	response.AddHeader("Content-Type", "application/json");
 
 	for (;;) {
-		Dictionary::Ptr result = queue->WaitForEvent(&request);
+		std::shared_ptr<const String> body = queue->WaitForEvent(&request);
 
 		if (!response.IsPeerConnected()) {
 			queue->RemoveClient(&request);
@@ -96,16 +130,20 @@ bool EventsHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request
 			return true;
 		}
 
-		if (!result)
-			continue;
+		if (queue->HasOverflowed(&request)) {
+			Log(LogWarning, "EventsHandler")
+				<< "Closing event stream for queue '" << queueName << "': The client did not keep up with the events.";
 
-		String body = JsonEncode(result);
+			queue->RemoveClient(&request);
+			EventQueue::UnregisterIfUnused(queueName, queue);
+			return true;
+		}
 
-		boost::algorithm::replace_all(body, "\n", "");
+		if (!body)
+			continue;
 
 		try {
-			response.WriteBody(body.CStr(), body.GetLength());
-			response.WriteBody("\n", 1);
+			response.WriteBody(body->CStr(), body->GetLength());
 		} catch (const std::exception&) {
 			queue->RemoveClient(&request);
 			EventQueue::UnregisterIfUnused(queueName, queue);
@@ -50,12 +50,60 @@ void ConfigObjectTargetProvider::FindTargets(const String& type, const std::func
 	auto *ctype = dynamic_cast<ConfigType *>(ptype.get());
 
 	if (ctype) {
-		for (const ConfigObject::Ptr& object : ctype->GetObjects()) {
+		for (const ConfigObject::Ptr& object : ctype->GetObjectView()) {
 			addTarget(object);
 		}
 	}
 }
 
+/**
+ * Finds a superset of the objects which match a filter using the type's
+ * indexes. Returns false if none of the filter's conditions is indexed.
+ */
+bool TargetProvider::FindIndexedTargets(const String&, const CompiledFilter::Ptr&, const String&,
+	const std::function<void (const Value&)>&) const
+{
+	return false;
+}
+
+bool ConfigObjectTargetProvider::FindIndexedTargets(const String& type, const CompiledFilter::Ptr& filter,
+	const String& variableName, const std::function<void (const Value&)>& addTarget) const
+{
+	Type::Ptr ptype = Type::GetByName(type);
+	auto *ctype = dynamic_cast<ConfigType *>(ptype.get());
+
+	if (!ctype)
+		return false;
+
+	bool found = false;
+	std::vector<ConfigObject::Ptr> candidates;
+
+	/* Use the most selective index. */
+	for (const CompiledFilterIndexHint& hint : filter->GetIndexHints(ptype, variableName)) {
+		std::vector<ConfigObject::Ptr> objects;
+
+		if (!ctype->LookupIndex(hint.Operator, hint.Attribute, hint.Literal, objects))
+			continue;
+
+		if (!found || objects.size() < candidates.size())
+			candidates.swap(objects);
+
+		found = true;
+
+		if (candidates.empty())
+			break;
+	}
+
+	if (!found)
+		return false;
+
+	for (const ConfigObject::Ptr& object : candidates) {
+		addTarget(object);
+	}
+
+	return true;
+}
+
 Value ConfigObjectTargetProvider::GetTargetByName(const String& type, const String& name) const
 {
 	ConfigObject::Ptr obj = ConfigObject::GetObject(type, name);
@@ -124,10 +172,16 @@ bool FilterUtility::EvaluateFilter(ScriptFrame& frame, Expression *filter,
 }
 
 static void FilteredAddTarget(ScriptFrame& permissionFrame, Expression *permissionFilter,
-	ScriptFrame& frame, Expression *ufilter, std::vector<Value>& result, const String& variableName, const Object::Ptr& target)
+	ScriptFrame& frame, const CompiledFilter::Ptr& ufilter, CompiledFilterState& ufilterState,
+	std::vector<Value>& result, const String& variableName, const Object::Ptr& target)
 {
-	if (FilterUtility::EvaluateFilter(permissionFrame, permissionFilter, target, variableName) && FilterUtility::EvaluateFilter(frame, ufilter, target, variableName))
-		result.emplace_back(target);
+	if (!FilterUtility::EvaluateFilter(permissionFrame, permissionFilter, target, variableName))
+		return;
+
+	if (ufilter && !ufilter->Evaluate(frame, ufilterState, target, variableName))
+		return;
+
+	result.emplace_back(target);
 }
 
 void FilterUtility::CheckPermission(const ApiUser::Ptr& user, const String& permission, Expression **permissionFilter)
@@ -251,11 +305,13 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 		frame.Sandboxed = true;
 		Dictionary::Ptr uvars = new Dictionary();
 
-		std::unique_ptr<Expression> ufilter;
+		CompiledFilter::Ptr ufilter;
+		CompiledFilterState ufilterState;
 
 		if (query->Contains("filter")) {
 			String filter = HttpUtility::GetLastParameter(query, "filter");
-			ufilter = ConfigCompiler::CompileText("<API query>", filter);
+			ufilter = CompiledFilter::Compile(filter);
+			ufilterState = ufilter->CreateState();
 		}
 
 		Dictionary::Ptr filter_vars = query->Get("filter_vars");
@@ -268,9 +324,12 @@ std::vector<Value> FilterUtility::GetFilterTargets(const QueryDescription& qd, c
 
 		frame.Self = uvars;
 
-		provider->FindTargets(type, std::bind(&FilteredAddTarget,
+		std::function<void (const Value&)> addTarget = std::bind(&FilteredAddTarget,
 			std::ref(permissionFrame), permissionFilter,
-			std::ref(frame), &*ufilter, std::ref(result), variableName, _1));
+			std::ref(frame), ufilter, std::ref(ufilterState), std::ref(result), variableName, _1);
+
+		if (!ufilter || !provider->FindIndexedTargets(type, ufilter, variableName, addTarget))
+			provider->FindTargets(type, addTarget);
 	}
 
 	return result;
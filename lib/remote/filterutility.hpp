@@ -22,6 +22,7 @@
 
 #include "remote/i2-remote.hpp"
 #include "remote/apiuser.hpp"
+#include "remote/compiledfilter.hpp"
 #include "config/expression.hpp"
 #include "base/dictionary.hpp"
 #include "base/configobject.hpp"
@@ -36,6 +37,8 @@ public:
 	DECLARE_PTR_TYPEDEFS(TargetProvider);
 
 	virtual void FindTargets(const String& type, const std::function<void (const Value&)>& addTarget) const = 0;
+	virtual bool FindIndexedTargets(const String& type, const CompiledFilter::Ptr& filter, const String& variableName,
+		const std::function<void (const Value&)>& addTarget) const;
 	virtual Value GetTargetByName(const String& type, const String& name) const = 0;
 	virtual bool IsValidType(const String& type) const = 0;
 	virtual String GetPluralName(const String& type) const = 0;
@@ -47,6 +50,8 @@ public:
 	DECLARE_PTR_TYPEDEFS(ConfigObjectTargetProvider);
 
 	void FindTargets(const String& type, const std::function<void (const Value&)>& addTarget) const override;
+	bool FindIndexedTargets(const String& type, const CompiledFilter::Ptr& filter, const String& variableName,
+		const std::function<void (const Value&)>& addTarget) const override;
 	Value GetTargetByName(const String& type, const String& name) const override;
 	bool IsValidType(const String& type) const override;
 	String GetPluralName(const String& type) const override;
@@ -21,12 +21,128 @@
 #include "remote/httputility.hpp"
 #include "base/singleton.hpp"
 #include "base/exception.hpp"
+#include "base/utility.hpp"
+#include "base/convert.hpp"
+#include "base/latencyhistogram.hpp"
 #include <boost/algorithm/string/join.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 using namespace icinga;
 
+/* How long a request may wait for a free slot before it is rejected. */
+#define HTTP_HANDLER_QUEUE_TIMEOUT 30
+
 Dictionary::Ptr HttpHandler::m_UrlTree;
 
+static const char * const l_HandlerClassNames[] = { "read", "query", "action", "config" };
+
+/* Upper bounds (in seconds) of the latency histogram buckets, the last bucket has no upper bound. */
+static const double l_LatencyBuckets[] = { 0.01, 0.05, 0.1, 0.5, 1, 5, 10 };
+#define HTTP_HANDLER_LATENCY_BUCKETS (sizeof(l_LatencyBuckets) / sizeof(l_LatencyBuckets[0]) + 1)
+
+struct HttpHandlerClassState
+{
+	boost::mutex Mutex;
+	boost::condition_variable CV;
+
+	int Limit{0}; /**< 0 means unlimited */
+	int Active{0};
+	int Queued{0};
+	uint_fast64_t Rejected{0};
+
+	uint_fast64_t Requests{0};
+	double TotalLatency{0};
+	double TotalWaitTime{0};
+	uint_fast64_t Histogram[HTTP_HANDLER_LATENCY_BUCKETS]{};
+};
+
+static HttpHandlerClassState l_HandlerClasses[HttpHandlerClassCount];
+
+static LatencyHistogram l_ReadLatency("http_read_request_latency");
+static LatencyHistogram l_QueryLatency("http_query_request_latency");
+static LatencyHistogram l_ActionLatency("http_action_request_latency");
+static LatencyHistogram l_ConfigLatency("http_config_request_latency");
+
+static LatencyHistogram * const l_HandlerLatencies[HttpHandlerClassCount] = {
+	&l_ReadLatency, &l_QueryLatency, &l_ActionLatency, &l_ConfigLatency
+};
+
+/**
+ * Holds a slot of a request class while a request is being processed.
+ */
+class HttpHandlerSlot
+{
+public:
+	HttpHandlerSlot(HttpHandlerClass cls)
+		: m_State(l_HandlerClasses[cls]), m_Latency(*l_HandlerLatencies[cls]), m_Start(Utility::GetTime())
+	{
+		boost::mutex::scoped_lock lock(m_State.Mutex);
+
+		if (m_State.Limit > 0 && m_State.Active >= m_State.Limit) {
+			m_State.Queued++;
+
+			boost::system_time timeout = boost::get_system_time() + boost::posix_time::seconds(HTTP_HANDLER_QUEUE_TIMEOUT);
+
+			while (m_State.Limit > 0 && m_State.Active >= m_State.Limit) {
+				if (!m_State.CV.timed_wait(lock, timeout))
+					break;
+			}
+
+			m_State.Queued--;
+
+			if (m_State.Limit > 0 && m_State.Active >= m_State.Limit) {
+				m_State.Rejected++;
+				return;
+			}
+		}
+
+		m_State.Active++;
+		m_Acquired = true;
+		m_Started = Utility::GetTime();
+	}
+
+	~HttpHandlerSlot()
+	{
+		if (!m_Acquired)
+			return;
+
+		double now = Utility::GetTime();
+		double latency = now - m_Start;
+
+		size_t bucket = 0;
+
+		while (bucket < HTTP_HANDLER_LATENCY_BUCKETS - 1 && latency > l_LatencyBuckets[bucket])
+			bucket++;
+
+		m_Latency.Record(latency);
+
+		boost::mutex::scoped_lock lock(m_State.Mutex);
+
+		m_State.Active--;
+		m_State.Requests++;
+		m_State.TotalLatency += latency;
+		m_State.TotalWaitTime += m_Started - m_Start;
+		m_State.Histogram[bucket]++;
+
+		m_State.CV.notify_one();
+	}
+
+	HttpHandlerSlot(const HttpHandlerSlot&) = delete;
+	HttpHandlerSlot& operator=(const HttpHandlerSlot&) = delete;
+
+	bool IsAcquired() const
+	{
+		return m_Acquired;
+	}
+
+private:
+	HttpHandlerClassState& m_State;
+	LatencyHistogram& m_Latency;
+	double m_Start;
+	double m_Started{0};
+	bool m_Acquired{false};
+};
+
 void HttpHandler::Register(const Url::Ptr& url, const HttpHandler::Ptr& handler)
 {
 	if (!m_UrlTree)
@@ -104,6 +220,13 @@ void HttpHandler::ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request,
 		return;
 	}
 
+	HttpHandlerSlot slot(GetRequestClass(request));
+
+	if (!slot.IsAcquired()) {
+		HttpUtility::SendJsonError(response, params, 503, "Too many concurrent requests of this kind. Please try again later.");
+		return;
+	}
+
 	bool processed = false;
 	for (const HttpHandler::Ptr& handler : handlers) {
 		if (handler->HandleRequest(user, request, response, params)) {
@@ -120,3 +243,66 @@ void HttpHandler::ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request,
 	}
 }
 
+/**
+ * Determines which concurrency limit applies to a request.
+ */
+HttpHandlerClass HttpHandler::GetRequestClass(const HttpRequest& request)
+{
+	const std::vector<String>& path = request.RequestUrl->GetPath();
+
+	if (path.size() < 2)
+		return HttpHandlerRead;
+
+	const String& endpoint = path[1];
+
+	if (endpoint == "objects")
+		return request.RequestMethod == "GET" ? HttpHandlerQuery : HttpHandlerConfig;
+	else if (endpoint == "console" || endpoint == "templates" || endpoint == "variables")
+		return HttpHandlerQuery;
+	else if (endpoint == "actions")
+		return HttpHandlerAction;
+	else if (endpoint == "config")
+		return HttpHandlerConfig;
+	else
+		return HttpHandlerRead;
+}
+
+void HttpHandler::SetConcurrencyLimit(HttpHandlerClass cls, int limit)
+{
+	HttpHandlerClassState& state = l_HandlerClasses[cls];
+
+	boost::mutex::scoped_lock lock(state.Mutex);
+	state.Limit = limit;
+	state.CV.notify_all();
+}
+
+Dictionary::Ptr HttpHandler::GetStatus()
+{
+	Dictionary::Ptr result = new Dictionary();
+
+	for (int i = 0; i < HttpHandlerClassCount; i++) {
+		HttpHandlerClassState& state = l_HandlerClasses[i];
+
+		boost::mutex::scoped_lock lock(state.Mutex);
+
+		Dictionary::Ptr histogram = new Dictionary();
+
+		for (size_t bucket = 0; bucket < HTTP_HANDLER_LATENCY_BUCKETS; bucket++) {
+			String key = bucket < HTTP_HANDLER_LATENCY_BUCKETS - 1 ? Convert::ToString(l_LatencyBuckets[bucket]) : "inf";
+			histogram->Set(key, state.Histogram[bucket]);
+		}
+
+		result->Set(l_HandlerClassNames[i], new Dictionary({
+			{ "limit", state.Limit },
+			{ "active", state.Active },
+			{ "queued", state.Queued },
+			{ "rejected", state.Rejected },
+			{ "requests", state.Requests },
+			{ "avg_latency", state.Requests ? state.TotalLatency / state.Requests : 0 },
+			{ "avg_wait_time", state.Requests ? state.TotalWaitTime / state.Requests : 0 },
+			{ "latency_histogram", histogram }
+		}));
+	}
+
+	return result;
+}
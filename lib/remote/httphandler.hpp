@@ -29,6 +29,22 @@
 namespace icinga
 {
 
+/**
+ * Classes of HTTP requests. Each class has its own concurrency limit, so
+ * slow queries can't hold up actions and other cheap requests.
+ *
+ * @ingroup remote
+ */
+enum HttpHandlerClass
+{
+	HttpHandlerRead,
+	HttpHandlerQuery,
+	HttpHandlerAction,
+	HttpHandlerConfig,
+
+	HttpHandlerClassCount
+};
+
 /**
  * HTTP handler.
  *
@@ -44,6 +60,10 @@ public:
 	static void Register(const Url::Ptr& url, const HttpHandler::Ptr& handler);
 	static void ProcessRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response);
 
+	static HttpHandlerClass GetRequestClass(const HttpRequest& request);
+	static void SetConcurrencyLimit(HttpHandlerClass cls, int limit);
+	static Dictionary::Ptr GetStatus();
+
 private:
 	static Dictionary::Ptr m_UrlTree;
 };
@@ -21,6 +21,7 @@
 #include "base/logger.hpp"
 #include "base/application.hpp"
 #include "base/convert.hpp"
+#include <cstring>
 
 using namespace icinga;
 
@@ -34,6 +35,23 @@ HttpRequest::HttpRequest(Stream::Ptr stream)
 	m_State(HttpRequestStart)
 { }
 
+static bool IsSpace(char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\v' || ch == '\f';
+}
+
+static bool RangeEquals(const char *begin, const char *end, const char *str)
+{
+	size_t length = strlen(str);
+	return static_cast<size_t>(end - begin) == length && memcmp(begin, str, length) == 0;
+}
+
+/**
+ * Parses all complete header lines which are available in the read buffer.
+ * The lines are parsed in place, the buffer is only compacted once per call.
+ *
+ * @returns true if at least one line was parsed, false if more data is needed.
+ */
 bool HttpRequest::ParseHeaders(StreamReadContext& src, bool may_wait)
 {
 	if (!m_Stream)
@@ -42,71 +60,125 @@ bool HttpRequest::ParseHeaders(StreamReadContext& src, bool may_wait)
 	if (m_State != HttpRequestStart && m_State != HttpRequestHeaders)
 		BOOST_THROW_EXCEPTION(std::runtime_error("Invalid HTTP state"));
 
-	String line;
-	StreamReadStatus srs = m_Stream->ReadLine(&line, src, may_wait);
+	if (src.Eof)
+		return false;
 
-	if (srs != StatusNewItem) {
-		if (src.Size > 8 * 1024)
-			BOOST_THROW_EXCEPTION(std::invalid_argument("Line length for HTTP header exceeded"));
+	if (src.MustRead) {
+		if (!src.FillFromStream(m_Stream, may_wait)) {
+			src.Eof = true;
+			return false;
+		}
 
-		return false;
+		src.MustRead = false;
 	}
 
-	if (line.GetLength() > 8 * 1024) {
+	size_t offset = 0;
+
+	while (m_State != HttpRequestBody) {
+		const char *begin = src.Buffer + offset;
+		const char *end = src.Buffer + src.Size;
+		auto *eol = static_cast<const char *>(memchr(begin, '\n', end - begin));
+
+		if (!eol) {
+			if (end - begin > 8 * 1024)
+				BOOST_THROW_EXCEPTION(std::invalid_argument("Line length for HTTP header exceeded"));
+
+			src.MustRead = true;
+			break;
+		}
+
+		if (eol - begin > 8 * 1024) {
 #ifdef I2_DEBUG /* I2_DEBUG */
-		Log(LogDebug, "HttpRequest")
-			<< "Header size: " << line.GetLength() << " content: '" << line << "'.";
+			Log(LogDebug, "HttpRequest")
+				<< "Header size: " << (eol - begin) << " content: '" << String(begin, eol) << "'.";
 #endif /* I2_DEBUG */
 
-		BOOST_THROW_EXCEPTION(std::invalid_argument("Line length for HTTP header exceeded"));
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Line length for HTTP header exceeded"));
+		}
+
+		offset = eol - src.Buffer + 1;
+
+		while (eol > begin && IsSpace(eol[-1]))
+			eol--;
+
+		ParseHeaderLine(begin, eol);
 	}
 
+	if (offset == 0)
+		return false;
+
+	src.DropData(offset);
+
+	if (!src.Size)
+		src.MustRead = true;
+
+	return true;
+}
+
+void HttpRequest::ParseHeaderLine(const char *begin, const char *end)
+{
 	if (m_State == HttpRequestStart) {
 		/* ignore trailing new-lines */
-		if (line == "")
-			return true;
+		if (begin == end)
+			return;
+
+		auto *methodEnd = static_cast<const char *>(memchr(begin, ' ', end - begin));
+		const char *urlEnd = nullptr;
+
+		if (methodEnd)
+			urlEnd = static_cast<const char *>(memchr(methodEnd + 1, ' ', end - methodEnd - 1));
 
-		std::vector<String> tokens = line.Split(" ");
-		Log(LogDebug, "HttpRequest")
-			<< "line: " << line << ", tokens: " << tokens.size();
-		if (tokens.size() != 3)
+		if (!urlEnd || memchr(urlEnd + 1, ' ', end - urlEnd - 1))
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid HTTP request"));
 
-		RequestMethod = tokens[0];
-		RequestUrl = new class Url(tokens[1]);
+		RequestMethod = String(begin, methodEnd);
+		RequestUrl = new class Url(String(methodEnd + 1, urlEnd));
 
-		if (tokens[2] == "HTTP/1.0")
+		if (RangeEquals(urlEnd + 1, end, "HTTP/1.0"))
 			ProtocolVersion = HttpVersion10;
-		else if (tokens[2] == "HTTP/1.1") {
+		else if (RangeEquals(urlEnd + 1, end, "HTTP/1.1"))
 			ProtocolVersion = HttpVersion11;
-		} else
+		else
 			BOOST_THROW_EXCEPTION(std::invalid_argument("Unsupported HTTP version"));
 
 		m_State = HttpRequestHeaders;
-		return true;
 	} else { // m_State = HttpRequestHeaders
-		if (line == "") {
+		if (begin == end) {
 			m_State = HttpRequestBody;
 			CompleteHeaders = true;
-			return true;
+			return;
+		}
+
+		if (Headers->GetLength() > 128)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Maximum number of HTTP request headers exceeded"));
 
-		} else {
-			if (Headers->GetLength() > 128)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Maximum number of HTTP request headers exceeded"));
+		auto *colon = static_cast<const char *>(memchr(begin, ':', end - begin));
 
-			String::SizeType pos = line.FindFirstOf(":");
-			if (pos == String::NPos)
-				BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid HTTP request"));
+		if (!colon)
+			BOOST_THROW_EXCEPTION(std::invalid_argument("Invalid HTTP request"));
 
-			String key = line.SubStr(0, pos).ToLower().Trim();
-			String value = line.SubStr(pos + 1).Trim();
-			Headers->Set(key, value);
+		const char *keyBegin = begin, *keyEnd = colon, *valueBegin = colon + 1;
 
-			if (key == "x-http-method-override")
-				RequestMethod = value;
+		while (keyBegin < keyEnd && IsSpace(*keyBegin))
+			keyBegin++;
 
-			return true;
-		}
+		while (keyEnd > keyBegin && IsSpace(keyEnd[-1]))
+			keyEnd--;
+
+		while (valueBegin < end && IsSpace(*valueBegin))
+			valueBegin++;
+
+		String key(keyBegin, keyEnd);
+
+		for (char& ch : key)
+			ch = tolower(ch);
+
+		String value(valueBegin, end);
+
+		if (key == "x-http-method-override")
+			RequestMethod = value;
+
+		Headers->Set(key, std::move(value));
 	}
 }
 
@@ -78,6 +78,7 @@ private:
 	HttpRequestState m_State;
 	FIFO::Ptr m_Body;
 
+	void ParseHeaderLine(const char *begin, const char *end);
 	void FinishHeaders();
 };
 
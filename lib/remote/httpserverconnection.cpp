@@ -131,6 +131,12 @@ bool HttpServerConnection::ProcessMessage()
 	}
 
 	if (!m_CurrentRequest.CompleteHeaderCheck) {
+		/* Pipelined requests: ManageHeaders() may write a response right away, so wait
+		 * until the responses for the earlier requests have been sent.
+		 * ProcessMessageAsync() resumes parsing once the work queue is idle. */
+		if (m_PendingRequests > 0)
+			return false;
+
 		m_CurrentRequest.CompleteHeaderCheck = true;
 		if (!ManageHeaders(response)) {
 			m_CurrentRequest.~HttpRequest();
@@ -182,7 +188,8 @@ bool HttpServerConnection::ProcessMessage()
 	m_CurrentRequest.~HttpRequest();
 	new (&m_CurrentRequest) HttpRequest(m_Stream);
 
-	return false;
+	/* Keep going if the client has already sent the next request. */
+	return m_Context.Size > 0;
 }
 
 bool HttpServerConnection::ManageHeaders(HttpResponse& response)
@@ -333,8 +340,18 @@ void HttpServerConnection::ProcessMessageAsync(HttpRequest& request, HttpRespons
 	}
 
 	response.Finish();
-	m_PendingRequests--;
+
+	bool resume = false;
+
+	if (--m_PendingRequests == 0) {
+		boost::recursive_mutex::scoped_lock lock(m_DataHandlerMutex);
+		resume = m_CurrentRequest.CompleteHeaders && !m_CurrentRequest.CompleteHeaderCheck;
+	}
+
 	m_Stream->SetCorked(false);
+
+	if (resume)
+		DataAvailableHandler();
 }
 
 void HttpServerConnection::DataAvailableHandler()
@@ -26,6 +26,7 @@
 #include "base/tlsstream.hpp"
 #include "base/workqueue.hpp"
 #include <boost/thread/recursive_mutex.hpp>
+#include <atomic>
 
 namespace icinga
 {
@@ -58,7 +59,7 @@ private:
 	HttpRequest m_CurrentRequest;
 	boost::recursive_mutex m_DataHandlerMutex;
 	WorkQueue m_RequestQueue;
-	int m_PendingRequests;
+	std::atomic<int> m_PendingRequests;
 
 	StreamReadContext m_Context;
 
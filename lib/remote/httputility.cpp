@@ -23,6 +23,45 @@
 
 using namespace icinga;
 
+namespace
+{
+
+/**
+ * Write-only stream which sends everything as part of an HTTP response body.
+ * With HTTP/1.1 each write becomes a chunk of the chunked transfer encoding.
+ */
+class HttpResponseBodyStream final : public Stream
+{
+public:
+	explicit HttpResponseBodyStream(HttpResponse& response)
+		: m_Response(response)
+	{ }
+
+	size_t Read(void *, size_t, bool) override
+	{
+		BOOST_THROW_EXCEPTION(std::runtime_error("Cannot read from an HTTP response body stream."));
+	}
+
+	void Write(const void *buffer, size_t count) override
+	{
+		/* An empty chunk would terminate the chunked body. */
+		if (count == 0)
+			return;
+
+		m_Response.WriteBody(static_cast<const char *>(buffer), count);
+	}
+
+	bool IsEof() const override
+	{
+		return false;
+	}
+
+private:
+	HttpResponse& m_Response;
+};
+
+}
+
 Dictionary::Ptr HttpUtility::FetchRequestParameters(HttpRequest& request)
 {
 	Dictionary::Ptr result;
@@ -62,9 +101,8 @@ void HttpUtility::SendJsonBody(HttpResponse& response, const Dictionary::Ptr& pa
 	if (params)
 		prettyPrint = GetLastParameter(params, "pretty");
 
-	String body = JsonEncode(val, prettyPrint);
-
-	response.WriteBody(body.CStr(), body.GetLength());
+	/* Large responses (e.g. all objects of a type) are sent while they're being encoded. */
+	JsonEncode(val, new HttpResponseBodyStream(response), prettyPrint);
 }
 
 Value HttpUtility::GetLastParameter(const Dictionary::Ptr& params, const String& key)
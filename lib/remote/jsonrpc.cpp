@@ -20,6 +20,7 @@
 #include "remote/jsonrpc.hpp"
 #include "base/netstring.hpp"
 #include "base/json.hpp"
+#include "base/object-packer.hpp"
 #include "base/console.hpp"
 #include "base/scriptglobal.hpp"
 #include "base/convert.hpp"
@@ -27,6 +28,9 @@
 
 using namespace icinga;
 
+/* The type tag PackObject() uses for dictionaries. */
+static const char l_BinaryMessageTag = 6;
+
 #ifdef I2_DEBUG
 static bool GetDebugJsonRpcCached()
 {
@@ -57,11 +61,29 @@ static bool GetDebugJsonRpcCached()
  * Sends a message to the connected peer and returns the bytes sent.
  *
  * @param message The message.
+ * @param binary Whether to use the binary encoding instead of JSON. Only
+ *               peers which announced support for it can decode it.
  *
  * @return The amount of bytes sent.
  */
-size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message)
+size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message, bool binary)
+{
+	return NetString::WriteStringToStream(stream, EncodeMessage(message, binary));
+}
+
+/**
+ * Encodes a message without sending it, e.g. to queue it for later.
+ *
+ * @param message The message.
+ * @param binary Whether to use the binary encoding instead of JSON.
+ *
+ * @return The encoded message.
+ */
+String JsonRpc::EncodeMessage(const Dictionary::Ptr& message, bool binary)
 {
+	if (binary)
+		return PackObject(message);
+
 	String json = JsonEncode(message);
 
 #ifdef I2_DEBUG
@@ -69,7 +91,19 @@ size_t JsonRpc::SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& me
 		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << ">> " << json << ConsoleColorTag(Console_Normal) << "\n";
 #endif /* I2_DEBUG */
 
-	return NetString::WriteStringToStream(stream, json);
+	return json;
+}
+
+/**
+ * Sends a message which has already been encoded, e.g. by EncodedMessage.
+ *
+ * @param message The encoded message.
+ *
+ * @return The amount of bytes sent.
+ */
+size_t JsonRpc::SendRawMessage(const Stream::Ptr& stream, const String& message)
+{
+	return NetString::WriteStringToStream(stream, message);
 }
 
 StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, String *message, StreamReadContext& src, bool may_wait, ssize_t maxMessageLength)
@@ -90,9 +124,39 @@ StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, String *message
 	return StatusNewItem;
 }
 
+/**
+ * Reads a message without copying it, see NetString::ReadStringViewFromStream().
+ * The message stays valid until the next read from the same context.
+ */
+StreamReadStatus JsonRpc::ReadMessage(const Stream::Ptr& stream, const char **data, size_t *length, StreamReadContext& src, bool may_wait, ssize_t maxMessageLength)
+{
+	StreamReadStatus srs = NetString::ReadStringViewFromStream(stream, data, length, src, may_wait, maxMessageLength);
+
+	if (srs != StatusNewItem)
+		return srs;
+
+#ifdef I2_DEBUG
+	if (GetDebugJsonRpcCached())
+		std::cerr << ConsoleColorTag(Console_ForegroundBlue) << "<< " << std::string(*data, *length) << ConsoleColorTag(Console_Normal) << "\n";
+#endif /* I2_DEBUG */
+
+	return StatusNewItem;
+}
+
 Dictionary::Ptr JsonRpc::DecodeMessage(const String& message)
 {
-	Value value = JsonDecode(message);
+	return DecodeMessage(message.CStr(), message.GetLength());
+}
+
+Dictionary::Ptr JsonRpc::DecodeMessage(const char *data, size_t length)
+{
+	Value value;
+
+	/* Binary messages start with the packed object's type tag, JSON messages with '{'. */
+	if (length > 0 && data[0] == l_BinaryMessageTag)
+		value = UnpackObject(data, length);
+	else
+		value = JsonDecode(data, length);
 
 	if (!value.IsObjectType<Dictionary>()) {
 		BOOST_THROW_EXCEPTION(std::invalid_argument("JSON-RPC"
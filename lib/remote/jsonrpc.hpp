@@ -35,9 +35,13 @@ namespace icinga
 class JsonRpc
 {
 public:
-	static size_t SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message);
+	static size_t SendMessage(const Stream::Ptr& stream, const Dictionary::Ptr& message, bool binary = false);
+	static String EncodeMessage(const Dictionary::Ptr& message, bool binary = false);
+	static size_t SendRawMessage(const Stream::Ptr& stream, const String& message);
 	static StreamReadStatus ReadMessage(const Stream::Ptr& stream, String *message, StreamReadContext& src, bool may_wait = false, ssize_t maxMessageLength = -1);
+	static StreamReadStatus ReadMessage(const Stream::Ptr& stream, const char **data, size_t *length, StreamReadContext& src, bool may_wait = false, ssize_t maxMessageLength = -1);
 	static Dictionary::Ptr DecodeMessage(const String& message);
+	static Dictionary::Ptr DecodeMessage(const char *data, size_t length);
 
 private:
 	JsonRpc();
@@ -21,7 +21,6 @@
 #include "remote/messageorigin.hpp"
 #include "remote/apifunction.hpp"
 #include "base/initialize.hpp"
-#include "base/configtype.hpp"
 #include "base/logger.hpp"
 #include "base/utility.hpp"
 
@@ -29,30 +28,30 @@ using namespace icinga;
 
 REGISTER_APIFUNCTION(Heartbeat, event, &JsonRpcConnection::HeartbeatAPIHandler);
 
-void JsonRpcConnection::HeartbeatTimerHandler()
+/**
+ * Sends a heartbeat to the endpoint, or closes the connection if the
+ * endpoint's heartbeats stopped. Called by TimeoutTimerHandler().
+ */
+void JsonRpcConnection::CheckHeartbeat()
 {
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
-		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
-			if (client->m_NextHeartbeat != 0 && client->m_NextHeartbeat < Utility::GetTime()) {
-				Log(LogWarning, "JsonRpcConnection")
-					<< "Client for endpoint '" << endpoint->GetName() << "' has requested "
-					<< "heartbeat message but hasn't responded in time. Closing connection.";
+	if (m_NextHeartbeat != 0 && m_NextHeartbeat < Utility::GetTime()) {
+		Log(LogWarning, "JsonRpcConnection")
+			<< "Client for endpoint '" << m_Endpoint->GetName() << "' has requested "
+			<< "heartbeat message but hasn't responded in time. Closing connection.";
 
-				client->Disconnect();
-				continue;
-			}
+		Disconnect();
+		return;
+	}
 
-			Dictionary::Ptr request = new Dictionary({
-				{ "jsonrpc", "2.0" },
-				{ "method", "event::Heartbeat" },
-				{ "params", new Dictionary({
-					{ "timeout", 120 }
-				}) }
-			});
+	Dictionary::Ptr request = new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::Heartbeat" },
+		{ "params", new Dictionary({
+			{ "timeout", 120 }
+		}) }
+	});
 
-			client->SendMessage(request);
-		}
-	}
+	SendMessage(request);
 }
 
 Value JsonRpcConnection::HeartbeatAPIHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
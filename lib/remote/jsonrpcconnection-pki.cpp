@@ -30,6 +30,7 @@
 #include <boost/thread/once.hpp>
 #include <boost/regex.hpp>
 #include <fstream>
+#include <sys/stat.h>
 
 using namespace icinga;
 
@@ -38,6 +39,94 @@ REGISTER_APIFUNCTION(RequestCertificate, pki, &RequestCertificateHandler);
 static Value UpdateCertificateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params);
 REGISTER_APIFUNCTION(UpdateCertificate, pki, &UpdateCertificateHandler);
 
+/* Upper bound for the number of cached requests and tickets. */
+static const size_t l_PkiCacheSize = 16384;
+
+struct CertificateRequestCacheEntry
+{
+	time_t MTime;
+	off_t Size;
+	Dictionary::Ptr Request;
+};
+
+static boost::mutex l_CertificateRequestCacheMutex;
+static std::map<String, CertificateRequestCacheEntry> l_CertificateRequestCache;
+
+struct TicketCacheEntry
+{
+	String Salt;
+	String Ticket;
+};
+
+static boost::mutex l_TicketCacheMutex;
+static std::map<String, TicketCacheEntry> l_TicketCache;
+
+/**
+ * Loads a certificate request file. Agents repeat their requests on every
+ * reconnect until they've been signed, so the requests are cached until
+ * the file's modification time or size changes, e.g. by 'icinga2 ca sign'.
+ * The returned dictionary must not be modified.
+ *
+ * @returns The request, or nullptr if there is no such file.
+ */
+static Dictionary::Ptr LoadCertificateRequest(const String& path)
+{
+	struct stat statbuf;
+
+	if (stat(path.CStr(), &statbuf) < 0) {
+		boost::mutex::scoped_lock lock(l_CertificateRequestCacheMutex);
+		l_CertificateRequestCache.erase(path);
+		return nullptr;
+	}
+
+	{
+		boost::mutex::scoped_lock lock(l_CertificateRequestCacheMutex);
+
+		auto it = l_CertificateRequestCache.find(path);
+
+		if (it != l_CertificateRequestCache.end() && it->second.MTime == statbuf.st_mtime && it->second.Size == statbuf.st_size)
+			return it->second.Request;
+	}
+
+	Dictionary::Ptr request = Utility::LoadJsonFile(path);
+
+	boost::mutex::scoped_lock lock(l_CertificateRequestCacheMutex);
+
+	if (l_CertificateRequestCache.size() >= l_PkiCacheSize)
+		l_CertificateRequestCache.clear();
+
+	l_CertificateRequestCache[path] = { statbuf.st_mtime, statbuf.st_size, request };
+
+	return request;
+}
+
+/**
+ * Returns the expected ticket for a CN. Deriving it takes 50000 PBKDF2
+ * rounds, the result is cached for agents which repeat their request.
+ */
+static String GetExpectedTicket(const String& cn, const String& salt)
+{
+	{
+		boost::mutex::scoped_lock lock(l_TicketCacheMutex);
+
+		auto it = l_TicketCache.find(cn);
+
+		if (it != l_TicketCache.end() && it->second.Salt == salt)
+			return it->second.Ticket;
+	}
+
+	String ticket = PBKDF2_SHA1(cn, salt, 50000);
+
+	boost::mutex::scoped_lock lock(l_TicketCacheMutex);
+
+	if (l_TicketCache.size() >= l_PkiCacheSize)
+		l_TicketCache.clear();
+
+	l_TicketCache[cn] = { salt, ticket };
+
+	return ticket;
+}
+
 Value RequestCertificateHandler(const MessageOrigin::Ptr& origin, const Dictionary::Ptr& params)
 {
 	String certText = params->Get("cert_request");
@@ -111,10 +200,10 @@ Value RequestCertificateHandler(const MessageOrigin::Ptr& origin, const Dictiona
 	JsonRpcConnection::Ptr client = origin->FromClient;
 
 	/* If we already have a signed certificate request, send it to the client. */
-	if (Utility::PathExists(requestPath)) {
-		Dictionary::Ptr request = Utility::LoadJsonFile(requestPath);
+	Dictionary::Ptr existingRequest = LoadCertificateRequest(requestPath);
 
-		String certResponse = request->Get("cert_response");
+	if (existingRequest) {
+		String certResponse = existingRequest->Get("cert_response");
 
 		if (!certResponse.IsEmpty()) {
 			Log(LogInformation, "JsonRpcConnection")
@@ -158,7 +247,7 @@ Value RequestCertificateHandler(const MessageOrigin::Ptr& origin, const Dictiona
 		if (salt.IsEmpty() || ticket.IsEmpty())
 			goto delayed_request;
 
-		String realTicket = PBKDF2_SHA1(cn, salt, 50000);
+		String realTicket = GetExpectedTicket(cn, salt);
 
 		if (ticket != realTicket) {
 			Log(LogWarning, "JsonRpcConnection")
@@ -250,9 +339,9 @@ void JsonRpcConnection::SendCertificateRequest(const JsonRpcConnection::Ptr& acl
 
 		params->Set("ticket", ticket);
 	} else {
-		Dictionary::Ptr request = Utility::LoadJsonFile(path);
+		Dictionary::Ptr request = LoadCertificateRequest(path);
 
-		if (request->Contains("cert_response"))
+		if (!request || request->Contains("cert_response"))
 			return;
 
 		params->Set("cert_request", request->Get("cert_request"));
@@ -315,11 +404,13 @@ Value UpdateCertificateHandler(const MessageOrigin::Ptr& origin, const Dictionar
 		String requestPath = requestDir + "/" + certFingerprint + ".json";
 
 		/* Save the received signed certificate request to disk. */
-		if (Utility::PathExists(requestPath)) {
+		Dictionary::Ptr request = LoadCertificateRequest(requestPath);
+
+		if (request) {
 			Log(LogInformation, "JsonRpcConnection")
 				<< "Saved certificate update for CN '" << cn << "'";
 
-			Dictionary::Ptr request = Utility::LoadJsonFile(requestPath);
+			request = request->ShallowClone();
 			request->Set("cert_response", cert);
 			Utility::SaveJsonFile(requestPath, 0644, request);
 		}
@@ -21,13 +21,15 @@
 #include "remote/apilistener.hpp"
 #include "remote/apifunction.hpp"
 #include "remote/jsonrpc.hpp"
-#include "base/configtype.hpp"
 #include "base/objectlock.hpp"
 #include "base/utility.hpp"
 #include "base/logger.hpp"
 #include "base/exception.hpp"
 #include "base/convert.hpp"
+#include "base/latencyhistogram.hpp"
 #include <boost/thread/once.hpp>
+#include <algorithm>
+#include <queue>
 
 using namespace icinga;
 
@@ -38,8 +40,26 @@ static boost::once_flag l_JsonRpcConnectionOnceFlag = BOOST_ONCE_INIT;
 static Timer::Ptr l_JsonRpcConnectionTimeoutTimer;
 static WorkQueue *l_JsonRpcConnectionWorkQueues;
 static size_t l_JsonRpcConnectionWorkQueueCount;
+static WorkQueue *l_JsonRpcConnectionPkiWorkQueue;
 static int l_JsonRpcConnectionNextID;
-static Timer::Ptr l_HeartbeatTimer;
+
+/* Connections by the time of their next heartbeat and liveness check. The
+ * timer only looks at the connections which are due instead of all of them. */
+typedef std::pair<double, JsonRpcConnection::Ptr> ConnectionDeadline;
+static boost::mutex l_ConnectionDeadlinesMutex;
+static std::priority_queue<ConnectionDeadline, std::vector<ConnectionDeadline>, std::greater<ConnectionDeadline> > l_ConnectionDeadlines;
+
+/* How often each connection sends a heartbeat and is checked for timeouts. */
+static const double l_TimeoutCheckInterval = 10;
+
+/* Time from reading a message until it has been handled. */
+static LatencyHistogram l_MessageLatency("jsonrpc_message_latency");
+
+/* Queued messages are only passed to the stream while it has less than this many bytes left to send. */
+static const size_t l_SendQueueLowWatermark = 256 * 1024;
+
+/* Live messages which may be sent before a waiting bulk message gets its turn. */
+static const int l_LiveMessagesPerBulkMessage = 8;
 
 JsonRpcConnection::JsonRpcConnection(const String& identity, bool authenticated,
 	TlsStream::Ptr stream, ConnectionRole role)
@@ -56,7 +76,7 @@ void JsonRpcConnection::StaticInitialize()
 {
 	l_JsonRpcConnectionTimeoutTimer = new Timer();
 	l_JsonRpcConnectionTimeoutTimer->OnTimerExpired.connect(std::bind(&JsonRpcConnection::TimeoutTimerHandler));
-	l_JsonRpcConnectionTimeoutTimer->SetInterval(15);
+	l_JsonRpcConnectionTimeoutTimer->SetInterval(1);
 	l_JsonRpcConnectionTimeoutTimer->Start();
 
 	l_JsonRpcConnectionWorkQueueCount = Application::GetConcurrency();
@@ -64,18 +84,19 @@ void JsonRpcConnection::StaticInitialize()
 
 	for (size_t i = 0; i < l_JsonRpcConnectionWorkQueueCount; i++) {
 		l_JsonRpcConnectionWorkQueues[i].SetName("JsonRpcConnection, #" + Convert::ToString(i));
+		l_JsonRpcConnectionWorkQueues[i].SetNode(i);
 	}
 
-	l_HeartbeatTimer = new Timer();
-	l_HeartbeatTimer->OnTimerExpired.connect(std::bind(&JsonRpcConnection::HeartbeatTimerHandler));
-	l_HeartbeatTimer->SetInterval(10);
-	l_HeartbeatTimer->Start();
+	l_JsonRpcConnectionPkiWorkQueue = new WorkQueue(0, std::max(1, Application::GetConcurrency() / 2));
+	l_JsonRpcConnectionPkiWorkQueue->SetName("JsonRpcConnection, PKI");
 }
 
 void JsonRpcConnection::Start()
 {
 	/* the stream holds an owning reference to this object through the callback we're registering here */
 	m_Stream->RegisterDataHandler(std::bind(&JsonRpcConnection::DataAvailableHandler, JsonRpcConnection::Ptr(this)));
+	m_Stream->SetSendQueueLowCallback(std::bind(&JsonRpcConnection::SendQueuedMessages, JsonRpcConnection::Ptr(this)), l_SendQueueLowWatermark);
+	ScheduleTimeoutCheck(Utility::GetTime() + l_TimeoutCheckInterval);
 	if (m_Stream->IsDataAvailable())
 		DataAvailableHandler();
 }
@@ -110,81 +131,381 @@ ConnectionRole JsonRpcConnection::GetRole() const
 	return m_Role;
 }
 
-void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
+/**
+ * Whether messages to this peer use the binary encoding. Incoming messages
+ * are accepted in either encoding.
+ */
+bool JsonRpcConnection::GetBinaryMessages() const
 {
-	try {
-		ObjectLock olock(m_Stream);
+	return m_BinaryMessages;
+}
 
-		if (m_Stream->IsEof())
-			return;
+void JsonRpcConnection::SetBinaryMessages(bool binary)
+{
+	m_BinaryMessages = binary;
+}
 
-		size_t bytesSent = JsonRpc::SendMessage(m_Stream, message);
+/**
+ * Whether the peer supports config sync using file hashes (config::Manifest).
+ */
+bool JsonRpcConnection::GetConfigManifest() const
+{
+	return m_ConfigManifest;
+}
 
-		if (m_Endpoint)
-			m_Endpoint->AddMessageSent(bytesSent);
+void JsonRpcConnection::SetConfigManifest(bool manifest)
+{
+	m_ConfigManifest = manifest;
+}
 
-	} catch (const std::exception& ex) {
-		std::ostringstream info;
-		info << "Error while sending JSON-RPC message for identity '" << m_Identity << "'";
-		Log(LogWarning, "JsonRpcConnection")
-			<< info.str() << "\n" << DiagnosticInformation(ex);
+/**
+ * Whether the peer understands event::CheckResults messages.
+ */
+bool JsonRpcConnection::GetCheckResultBatches() const
+{
+	return m_CheckResultBatches;
+}
 
-		Disconnect();
-	}
+void JsonRpcConnection::SetCheckResultBatches(bool batches)
+{
+	m_CheckResultBatches = batches;
 }
 
-void JsonRpcConnection::Disconnect()
+/**
+ * Whether the peer understands event::ExecuteCommands messages.
+ */
+bool JsonRpcConnection::GetExecuteCommandBatches() const
 {
-	Log(LogWarning, "JsonRpcConnection")
-		<< "API client disconnected for identity '" << m_Identity << "'";
+	return m_ExecuteCommandBatches;
+}
 
-	m_Stream->Close();
+void JsonRpcConnection::SetExecuteCommandBatches(bool batches)
+{
+	m_ExecuteCommandBatches = batches;
+}
 
-	if (m_Endpoint)
-		m_Endpoint->RemoveClient(this);
-	else {
-		ApiListener::Ptr listener = ApiListener::GetInstance();
-		listener->RemoveAnonymousClient(this);
+/**
+ * Whether the peer accepts commands and runs the checks from event::SetAgentSchedule
+ * messages on its own.
+ */
+bool JsonRpcConnection::GetAgentScheduling() const
+{
+	return m_AgentScheduling;
+}
+
+void JsonRpcConnection::SetAgentScheduling(bool scheduling)
+{
+	m_AgentScheduling = scheduling;
+}
+
+/**
+ * The point in time up to which the peer has received all our runtime
+ * objects, as announced in its hello message. -1 if it doesn't support
+ * incremental runtime object sync.
+ */
+double JsonRpcConnection::GetRuntimeObjectsPosition() const
+{
+	return m_RuntimeObjectsPosition;
+}
+
+void JsonRpcConnection::SetRuntimeObjectsPosition(double position)
+{
+	m_RuntimeObjectsPosition = position;
+}
+
+/**
+ * Remembers the position of a finished runtime object sync. It is stored
+ * once all messages which were read before have been handled, i.e. once the
+ * objects have been updated.
+ */
+void JsonRpcConnection::SetPendingRuntimeObjectsPosition(double position)
+{
+	m_PendingRuntimeObjectsPosition = position;
+}
+
+void JsonRpcConnection::CommitRuntimeObjectsPosition()
+{
+	if (m_PendingMessages != 0 || !m_Endpoint || m_Stream->IsEof())
+		return;
+
+	double position = m_PendingRuntimeObjectsPosition.exchange(0);
+
+	if (position > 0)
+		m_Endpoint->SetRuntimeObjectsPosition(position);
+}
+
+void JsonRpcConnection::SetHelloReceived()
+{
+	boost::mutex::scoped_lock lock(m_HelloMutex);
+	m_HelloReceived = true;
+	m_HelloCV.notify_all();
+}
+
+/**
+ * Waits until the peer's hello message was processed. Older versions don't
+ * answer our hello message, so the capabilities may remain unknown.
+ *
+ * @returns true if the hello message was received in time.
+ */
+bool JsonRpcConnection::WaitForHello(double timeout)
+{
+	boost::mutex::scoped_lock lock(m_HelloMutex);
+
+	boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(static_cast<long>(timeout * 1000));
+
+	while (!m_HelloReceived) {
+		if (!m_HelloCV.timed_wait(lock, deadline))
+			break;
 	}
+
+	return m_HelloReceived;
+}
+
+void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message)
+{
+	SendMessage(message, GetMessagePriority(message));
+}
+
+void JsonRpcConnection::SendMessage(const Dictionary::Ptr& message, MessagePriority priority)
+{
+	EnqueueMessage(JsonRpc::EncodeMessage(message, m_BinaryMessages), priority);
+}
+
+/**
+ * Sends a message which may be shared with other connections. The message
+ * is only encoded once for all connections using the same encoding.
+ */
+void JsonRpcConnection::SendMessage(const EncodedMessage::Ptr& message)
+{
+	EnqueueMessage(m_BinaryMessages ? message->GetBinary() : message->GetJson(), GetMessagePriority(message->GetMessage()));
+}
+
+/**
+ * Sends a message which has already been encoded, e.g. by the replay log.
+ */
+void JsonRpcConnection::SendRawMessage(const String& encoded, MessagePriority priority)
+{
+	EnqueueMessage(encoded, priority);
+}
+
+MessagePriority JsonRpcConnection::GetMessagePriority(const Dictionary::Ptr& message)
+{
+	String method = message->Get("method");
+
+	if (method == "event::Heartbeat" || method == "icinga::Hello" || method == "log::SetLogPosition")
+		return MessagePriorityControl;
+
+	/* Object updates are small and must stay in order with other events. */
+	if (method.SubStr(0, 8) == "config::" && method != "config::UpdateObject" &&
+		method != "config::DeleteObject" && method != "config::RuntimeObjectsSynced")
+		return MessagePriorityBulk;
+
+	return MessagePriorityLive;
 }
 
-void JsonRpcConnection::MessageHandlerWrapper(const String& jsonString)
+/**
+ * Queues an encoded message. The caller only writes to the stream itself
+ * if nothing else is being sent right now, otherwise the message is picked
+ * up once the socket has drained, see TlsStream::SetSendQueueLowCallback().
+ */
+void JsonRpcConnection::EnqueueMessage(String encoded, MessagePriority priority)
 {
 	if (m_Stream->IsEof())
 		return;
 
-	try {
-		MessageHandler(jsonString);
-	} catch (const std::exception& ex) {
+	ApiListener::Ptr listener = ApiListener::GetInstance();
+	size_t maxQueueSize = listener ? listener->GetMaxSendQueueSize() : 0;
+	bool overflow = false;
+
+	{
+		boost::mutex::scoped_lock lock(m_SendQueueMutex);
+
+		m_SendQueueBytes[priority] += encoded.GetLength();
+		m_SendQueues[priority].emplace_back(std::move(encoded));
+
+		/* Config sync messages are limited by the size of the config, only limit events which keep coming. */
+		if (maxQueueSize > 0 && m_SendQueueBytes[MessagePriorityControl] + m_SendQueueBytes[MessagePriorityLive] > maxQueueSize)
+			overflow = true;
+	}
+
+	if (overflow) {
 		Log(LogWarning, "JsonRpcConnection")
-			<< "Error while reading JSON-RPC message for identity '" << m_Identity
-			<< "': " << DiagnosticInformation(ex);
+			<< "Send queue for identity '" << m_Identity << "' exceeds " << maxQueueSize
+			<< " bytes, disconnecting. Missed messages will be replayed from the replay log once it reconnects.";
 
 		Disconnect();
-
 		return;
 	}
+
+	if (m_Stream->GetSendQueueLength() > 0)
+		return;
+
+	SendQueuedMessages();
 }
 
-void JsonRpcConnection::MessageHandler(const String& jsonString)
+/**
+ * Passes queued messages to the stream until its send queue is full. Control
+ * messages go first, bulk messages get every few turns while there are live
+ * messages so that neither of them can starve the other.
+ *
+ * Only one thread writes at a time. Other threads just leave a note for it to
+ * have another look at the queues instead of waiting for the stream.
+ */
+void JsonRpcConnection::SendQueuedMessages()
 {
-	Dictionary::Ptr message = JsonRpc::DecodeMessage(jsonString);
+	m_SendRequested = true;
 
-	m_Seen = Utility::GetTime();
+	while (m_SendRequested) {
+		boost::mutex::scoped_lock writeLock(m_SendWriteMutex, boost::try_to_lock);
 
-	if (m_HeartbeatTimeout != 0)
-		m_NextHeartbeat = Utility::GetTime() + m_HeartbeatTimeout;
+		if (!writeLock.owns_lock())
+			return;
 
-	if (m_Endpoint && message->Contains("ts")) {
-		double ts = message->Get("ts");
+		m_SendRequested = false;
 
-		/* ignore old messages */
-		if (ts < m_Endpoint->GetRemoteLogPosition())
+		try {
+			while (m_Stream->GetSendQueueLength() < l_SendQueueLowWatermark) {
+				String encoded;
+
+				{
+					boost::mutex::scoped_lock lock(m_SendQueueMutex);
+
+					if (m_Stream->IsEof()) {
+						ClearSendQueues();
+						return;
+					}
+
+					MessagePriority priority;
+
+					if (!m_SendQueues[MessagePriorityControl].empty())
+						priority = MessagePriorityControl;
+					else if (!m_SendQueues[MessagePriorityLive].empty() &&
+						(m_SendQueues[MessagePriorityBulk].empty() || m_LiveMessagesSinceBulk < l_LiveMessagesPerBulkMessage))
+						priority = MessagePriorityLive;
+					else if (!m_SendQueues[MessagePriorityBulk].empty())
+						priority = MessagePriorityBulk;
+					else
+						break;
+
+					if (priority == MessagePriorityLive)
+						m_LiveMessagesSinceBulk++;
+					else if (priority == MessagePriorityBulk)
+						m_LiveMessagesSinceBulk = 0;
+
+					encoded = std::move(m_SendQueues[priority].front());
+					m_SendQueues[priority].pop_front();
+					m_SendQueueBytes[priority] -= encoded.GetLength();
+				}
+
+				size_t bytesSent;
+
+				{
+					ObjectLock olock(m_Stream);
+					bytesSent = JsonRpc::SendRawMessage(m_Stream, encoded);
+				}
+
+				if (m_Endpoint)
+					m_Endpoint->AddMessageSent(bytesSent);
+			}
+
+			/* The queues were drained as far as the stream takes it, see WaitForSendQueue(). */
+			m_SendQueueCV.notify_all();
+		} catch (const std::exception& ex) {
+			writeLock.unlock();
+
+			std::ostringstream info;
+			info << "Error while sending JSON-RPC message for identity '" << m_Identity << "'";
+			Log(LogWarning, "JsonRpcConnection")
+				<< info.str() << "\n" << DiagnosticInformation(ex);
+
+			Disconnect();
 			return;
+		}
+	}
+}
 
-		m_Endpoint->SetRemoteLogPosition(ts);
+/**
+ * Drops all queued messages. Callers must hold m_SendQueueMutex.
+ */
+void JsonRpcConnection::ClearSendQueues()
+{
+	for (int i = 0; i <= MessagePriorityBulk; i++) {
+		m_SendQueues[i].clear();
+		m_SendQueueBytes[i] = 0;
 	}
 
+	m_SendQueueCV.notify_all();
+}
+
+/**
+ * Blocks until there are at most maxSize bytes in the control and live lanes
+ * or the connection was closed, see ApiListener::GetMaxSendQueueSize().
+ */
+void JsonRpcConnection::WaitForSendQueue(size_t maxSize)
+{
+	boost::mutex::scoped_lock lock(m_SendQueueMutex);
+
+	while (m_SendQueueBytes[MessagePriorityControl] + m_SendQueueBytes[MessagePriorityLive] > maxSize && !m_Stream->IsEof())
+		m_SendQueueCV.wait(lock);
+}
+
+Dictionary::Ptr JsonRpcConnection::GetSendQueueStatus() const
+{
+	boost::mutex::scoped_lock lock(m_SendQueueMutex);
+
+	return new Dictionary({
+		{ "control_items", m_SendQueues[MessagePriorityControl].size() },
+		{ "control_bytes", m_SendQueueBytes[MessagePriorityControl] },
+		{ "live_items", m_SendQueues[MessagePriorityLive].size() },
+		{ "live_bytes", m_SendQueueBytes[MessagePriorityLive] },
+		{ "bulk_items", m_SendQueues[MessagePriorityBulk].size() },
+		{ "bulk_bytes", m_SendQueueBytes[MessagePriorityBulk] }
+	});
+}
+
+void JsonRpcConnection::Disconnect()
+{
+	Log(LogWarning, "JsonRpcConnection")
+		<< "API client disconnected for identity '" << m_Identity << "'";
+
+	m_Stream->Close();
+
+	{
+		boost::mutex::scoped_lock lock(m_SendQueueMutex);
+		ClearSendQueues();
+	}
+
+	if (m_Endpoint)
+		m_Endpoint->RemoveClient(this);
+	else {
+		ApiListener::Ptr listener = ApiListener::GetInstance();
+		listener->RemoveAnonymousClient(this);
+	}
+}
+
+void JsonRpcConnection::MessageHandlerWrapper(const Dictionary::Ptr& message, double received)
+{
+	if (!m_Stream->IsEof()) {
+		try {
+			MessageHandler(message);
+
+			l_MessageLatency.Record(Utility::GetTime() - received);
+		} catch (const std::exception& ex) {
+			Log(LogWarning, "JsonRpcConnection")
+				<< "Error while reading JSON-RPC message for identity '" << m_Identity
+				<< "': " << DiagnosticInformation(ex);
+
+			Disconnect();
+		}
+	}
+
+	m_PendingMessages--;
+	UncorkIfIdle();
+	CommitRuntimeObjectsPosition();
+}
+
+void JsonRpcConnection::MessageHandler(const Dictionary::Ptr& message)
+{
 	MessageOrigin::Ptr origin = new MessageOrigin();
 	origin->FromClient = this;
 
@@ -193,8 +514,6 @@ void JsonRpcConnection::MessageHandler(const String& jsonString)
 			origin->FromZone = m_Endpoint->GetZone();
 		else
 			origin->FromZone = Zone::GetByName(message->Get("originZone"));
-
-		m_Endpoint->AddMessageReceived(jsonString.GetLength());
 	}
 
 	Value vmethod;
@@ -253,18 +572,104 @@ bool JsonRpcConnection::ProcessMessage()
 	if (m_Endpoint)
 		maxMessageLength = -1; /* no limit */
 
-	String message;
+	const char *data;
+	size_t length;
 
-	StreamReadStatus srs = JsonRpc::ReadMessage(m_Stream, &message, m_Context, false, maxMessageLength);
+	/* The message is decoded straight from the read buffer. */
+	StreamReadStatus srs = JsonRpc::ReadMessage(m_Stream, &data, &length, m_Context, false, maxMessageLength);
 
 	if (srs != StatusNewItem)
 		return false;
 
-	l_JsonRpcConnectionWorkQueues[m_ID % l_JsonRpcConnectionWorkQueueCount].Enqueue(std::bind(&JsonRpcConnection::MessageHandlerWrapper, JsonRpcConnection::Ptr(this), message));
+	double received = Utility::GetTime();
+
+	Dictionary::Ptr message = JsonRpc::DecodeMessage(data, length);
+
+	m_Seen = received;
+
+	if (m_HeartbeatTimeout != 0)
+		m_NextHeartbeat = received + m_HeartbeatTimeout;
+
+	/* The log position must be checked in the order the messages were received
+	 * because the messages are handled by different work queues. */
+	if (m_Endpoint && message->Contains("ts")) {
+		double ts = message->Get("ts");
+
+		/* ignore old messages */
+		if (ts < m_Endpoint->GetRemoteLogPosition())
+			return true;
+
+		m_Endpoint->SetRemoteLogPosition(ts);
+	}
+
+	if (m_Endpoint)
+		m_Endpoint->AddMessageReceived(length);
+
+	m_PendingMessages++;
+
+	GetMessageWorkQueue(message).Enqueue(std::bind(&JsonRpcConnection::MessageHandlerWrapper, JsonRpcConnection::Ptr(this), message, received));
 
 	return true;
 }
 
+/**
+ * Returns the work queue for a message. Messages which refer to a host or
+ * one of its services, comments, downtimes etc. are distributed by the host
+ * name so that they are handled in order. Certificate requests have their
+ * own queue. All other messages use the connection's queue.
+ */
+WorkQueue& JsonRpcConnection::GetMessageWorkQueue(const Dictionary::Ptr& message) const
+{
+	/* Checking tickets and signing certificates is expensive, bursts of new
+	 * agents must not delay the other cluster messages. */
+	String method = message->Get("method");
+
+	if (method.SubStr(0, 5) == "pki::")
+		return *l_JsonRpcConnectionPkiWorkQueue;
+
+	Value vparams = message->Get("params");
+	String key;
+
+	if (vparams.IsObjectType<Dictionary>()) {
+		Dictionary::Ptr params = vparams;
+
+		/* e.g. event::CheckResult */
+		key = params->Get("host");
+
+		/* config::UpdateObject and config::DeleteObject use the object name, e.g. "host!service" */
+		if (key.IsEmpty()) {
+			String name = params->Get("name");
+			key = name.SubStr(0, name.Find("!"));
+		}
+	}
+
+	if (key.IsEmpty()) {
+		size_t index = m_ID;
+
+		/* Use a queue on the same NUMA node as the socket I/O thread. Queue i belongs to node i % nodes. */
+		int node = Application::GetThreadNode();
+		size_t nodes = Application::GetCpuNodeCount();
+
+		if (node >= 0 && nodes > 1 && static_cast<size_t>(node) < l_JsonRpcConnectionWorkQueueCount) {
+			size_t nodeQueues = (l_JsonRpcConnectionWorkQueueCount - node + nodes - 1) / nodes;
+			index = node + nodes * (m_ID % nodeQueues);
+		}
+
+		return l_JsonRpcConnectionWorkQueues[index % l_JsonRpcConnectionWorkQueueCount];
+	}
+
+	return l_JsonRpcConnectionWorkQueues[Utility::SDBM(key) % l_JsonRpcConnectionWorkQueueCount];
+}
+
+/**
+ * Uncorks the stream once all messages which were read so far have been handled.
+ */
+void JsonRpcConnection::UncorkIfIdle()
+{
+	if (m_PendingMessages == 0 && m_UncorkPending.exchange(false))
+		m_Stream->SetCorked(false);
+}
+
 void JsonRpcConnection::DataAvailableHandler()
 {
 	bool close = false;
@@ -290,7 +695,8 @@ void JsonRpcConnection::DataAvailableHandler()
 			return;
 		}
 
-		l_JsonRpcConnectionWorkQueues[m_ID % l_JsonRpcConnectionWorkQueueCount].Enqueue(std::bind(&Stream::SetCorked, m_Stream, false));
+		m_UncorkPending = true;
+		UncorkIfIdle();
 	} else
 		close = true;
 
@@ -321,19 +727,39 @@ void JsonRpcConnection::CheckLiveness()
 	}
 }
 
+void JsonRpcConnection::ScheduleTimeoutCheck(double deadline)
+{
+	boost::mutex::scoped_lock lock(l_ConnectionDeadlinesMutex);
+	l_ConnectionDeadlines.emplace(deadline, this);
+}
+
 void JsonRpcConnection::TimeoutTimerHandler()
 {
-	ApiListener::Ptr listener = ApiListener::GetInstance();
+	double now = Utility::GetTime();
+	std::vector<JsonRpcConnection::Ptr> clients;
 
-	for (const JsonRpcConnection::Ptr& client : listener->GetAnonymousClients()) {
-		client->CheckLiveness();
-	}
+	{
+		boost::mutex::scoped_lock lock(l_ConnectionDeadlinesMutex);
 
-	for (const Endpoint::Ptr& endpoint : ConfigType::GetObjectsByType<Endpoint>()) {
-		for (const JsonRpcConnection::Ptr& client : endpoint->GetClients()) {
-			client->CheckLiveness();
+		while (!l_ConnectionDeadlines.empty() && l_ConnectionDeadlines.top().first <= now) {
+			clients.push_back(l_ConnectionDeadlines.top().second);
+			l_ConnectionDeadlines.pop();
 		}
 	}
+
+	for (const JsonRpcConnection::Ptr& client : clients) {
+		/* Closed connections are simply dropped from the queue. */
+		if (client->m_Stream->IsEof())
+			continue;
+
+		client->CheckLiveness();
+
+		if (client->m_Endpoint)
+			client->CheckHeartbeat();
+
+		if (!client->m_Stream->IsEof())
+			client->ScheduleTimeoutCheck(now + l_TimeoutCheckInterval);
+	}
 }
 
 size_t JsonRpcConnection::GetWorkQueueCount()
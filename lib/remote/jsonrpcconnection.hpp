@@ -22,9 +22,12 @@
 
 #include "remote/i2-remote.hpp"
 #include "remote/endpoint.hpp"
+#include "remote/encodedmessage.hpp"
 #include "base/tlsstream.hpp"
 #include "base/timer.hpp"
 #include "base/workqueue.hpp"
+#include <atomic>
+#include <deque>
 
 namespace icinga
 {
@@ -41,6 +44,16 @@ enum ClientType
 	ClientHttp
 };
 
+/**
+ * The send queues of a connection, in the order in which they're drained.
+ */
+enum MessagePriority
+{
+	MessagePriorityControl, /**< heartbeats, hello and log position messages */
+	MessagePriorityLive, /**< events, e.g. check results, and log replay */
+	MessagePriorityBulk /**< config sync */
+};
+
 class MessageOrigin;
 
 /**
@@ -67,8 +80,35 @@ public:
 	void Disconnect();
 
 	void SendMessage(const Dictionary::Ptr& request);
+	void SendMessage(const Dictionary::Ptr& request, MessagePriority priority);
+	void SendMessage(const EncodedMessage::Ptr& request);
+	void SendRawMessage(const String& encoded, MessagePriority priority);
+
+	Dictionary::Ptr GetSendQueueStatus() const;
+	void WaitForSendQueue(size_t maxSize);
+
+	bool GetBinaryMessages() const;
+	void SetBinaryMessages(bool binary);
+
+	bool GetConfigManifest() const;
+	void SetConfigManifest(bool manifest);
+
+	bool GetCheckResultBatches() const;
+	void SetCheckResultBatches(bool batches);
+
+	bool GetExecuteCommandBatches() const;
+	void SetExecuteCommandBatches(bool batches);
+
+	bool GetAgentScheduling() const;
+	void SetAgentScheduling(bool scheduling);
+
+	double GetRuntimeObjectsPosition() const;
+	void SetRuntimeObjectsPosition(double position);
+	void SetPendingRuntimeObjectsPosition(double position);
+
+	void SetHelloReceived();
+	bool WaitForHello(double timeout);
 
-	static void HeartbeatTimerHandler();
 	static Value HeartbeatAPIHandler(const intrusive_ptr<MessageOrigin>& origin, const Dictionary::Ptr& params);
 
 	static size_t GetWorkQueueCount();
@@ -88,18 +128,49 @@ private:
 	double m_Seen;
 	double m_NextHeartbeat;
 	double m_HeartbeatTimeout;
+	std::atomic<bool> m_BinaryMessages{false};
+	std::atomic<bool> m_ConfigManifest{false};
+	std::atomic<bool> m_CheckResultBatches{false};
+	std::atomic<bool> m_ExecuteCommandBatches{false};
+	std::atomic<bool> m_AgentScheduling{false};
+	std::atomic<double> m_RuntimeObjectsPosition{-1};
+	std::atomic<double> m_PendingRuntimeObjectsPosition{0};
 	boost::mutex m_DataHandlerMutex;
+	std::atomic<int> m_PendingMessages{0};
+	std::atomic<bool> m_UncorkPending{false};
+
+	boost::mutex m_HelloMutex;
+	boost::condition_variable m_HelloCV;
+	bool m_HelloReceived{false};
 
 	StreamReadContext m_Context;
 
+	mutable boost::mutex m_SendQueueMutex;
+	boost::condition_variable m_SendQueueCV;
+	boost::mutex m_SendWriteMutex;
+	std::atomic<bool> m_SendRequested{false};
+	std::deque<String> m_SendQueues[MessagePriorityBulk + 1];
+	size_t m_SendQueueBytes[MessagePriorityBulk + 1]{};
+	int m_LiveMessagesSinceBulk{0};
+
+	static MessagePriority GetMessagePriority(const Dictionary::Ptr& message);
+	void EnqueueMessage(String encoded, MessagePriority priority);
+	void SendQueuedMessages();
+	void ClearSendQueues();
+
 	bool ProcessMessage();
-	void MessageHandlerWrapper(const String& jsonString);
-	void MessageHandler(const String& jsonString);
+	void MessageHandlerWrapper(const Dictionary::Ptr& message, double received);
+	void MessageHandler(const Dictionary::Ptr& message);
+	WorkQueue& GetMessageWorkQueue(const Dictionary::Ptr& message) const;
+	void UncorkIfIdle();
+	void CommitRuntimeObjectsPosition();
 	void DataAvailableHandler();
 
 	static void StaticInitialize();
 	static void TimeoutTimerHandler();
+	void ScheduleTimeoutCheck(double deadline);
 	void CheckLiveness();
+	void CheckHeartbeat();
 
 	void CertificateRequestResponseHandler(const Dictionary::Ptr& message);
 };
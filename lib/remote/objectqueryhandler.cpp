@@ -23,6 +23,7 @@
 #include "base/serializer.hpp"
 #include "base/dependencygraph.hpp"
 #include "base/configtype.hpp"
+#include "base/json.hpp"
 #include <boost/algorithm/string/case_conv.hpp>
 #include <set>
 
@@ -30,6 +31,19 @@ using namespace icinga;
 
 REGISTER_URLHANDLER("/v1/objects", ObjectQueryHandler);
 
+static bool IsUserVisibleField(const Field& field)
+{
+	/* hide attributes which shouldn't be user-visible */
+	if (field.Attributes & FANoUserView)
+		return false;
+
+	/* hide internal navigation fields */
+	if (field.Attributes & FANavigation && !(field.Attributes & (FAConfig | FAState)))
+		return false;
+
+	return true;
+}
+
 Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& object,
 	const String& attrPrefix, const Array::Ptr& attrs, bool isJoin, bool allAttrs)
 {
@@ -50,10 +64,15 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 	if (!isJoin && (!attrs || attrs->GetLength() == 0))
 		allAttrs = true;
 
+	DictionaryData resultAttrs;
+
 	if (allAttrs) {
-		for (int fid = 0; fid < type->GetFieldCount(); fid++) {
-			fids.push_back(fid);
-		}
+		resultAttrs.reserve(type->GetFieldCount());
+
+		object->VisitFields(0, [&resultAttrs](const Field& field, const Value& val) {
+			if (IsUserVisibleField(field))
+				resultAttrs.emplace_back(field.Name, Serialize(val, FAConfig | FAState));
+		});
 	} else if (attrs) {
 		ObjectLock olock(attrs);
 		for (const String& attr : attrs) {
@@ -81,27 +100,94 @@ Dictionary::Ptr ObjectQueryHandler::SerializeObjectAttrs(const Object::Ptr& obje
 		}
 	}
 
-	DictionaryData resultAttrs;
 	resultAttrs.reserve(fids.size());
 
 	for (int fid : fids) {
 		Field field = type->GetFieldInfo(fid);
 
-		Value val = object->GetField(fid);
-
-		/* hide attributes which shouldn't be user-visible */
-		if (field.Attributes & FANoUserView)
+		if (!IsUserVisibleField(field))
 			continue;
 
-		/* hide internal navigation fields */
-		if (field.Attributes & FANavigation && !(field.Attributes & (FAConfig | FAState)))
+		resultAttrs.emplace_back(field.Name, Serialize(object->GetField(fid), FAConfig | FAState));
+	}
+
+	return new Dictionary(std::move(resultAttrs));
+}
+
+/**
+ * Builds the result entry for a single object.
+ *
+ * @throws ScriptError if the requested attributes, joins or meta fields are invalid.
+ */
+Dictionary::Ptr ObjectQueryHandler::SerializeObject(const ConfigObject::Ptr& obj, const Array::Ptr& uattrs,
+	const Array::Ptr& ujoins, const Array::Ptr& umetas, const std::set<String>& joinAttrs, bool allJoins)
+{
+	Type::Ptr type = obj->GetReflectionType();
+
+	DictionaryData result1{
+		{ "name", obj->GetName() },
+		{ "type", type->GetName() }
+	};
+
+	DictionaryData metaAttrs;
+
+	if (umetas) {
+		ObjectLock olock(umetas);
+		for (const String& meta : umetas) {
+			if (meta == "used_by") {
+				Array::Ptr used_by = new Array();
+				metaAttrs.emplace_back("used_by", used_by);
+
+				for (const Object::Ptr& pobj : DependencyGraph::GetParents((obj)))
+				{
+					ConfigObject::Ptr configObj = dynamic_pointer_cast<ConfigObject>(pobj);
+
+					if (!configObj)
+						continue;
+
+					used_by->Add(new Dictionary({
+						{ "type", configObj->GetReflectionType()->GetName() },
+						{ "name", configObj->GetName() }
+					}));
+				}
+			} else if (meta == "location") {
+				metaAttrs.emplace_back("location", obj->GetSourceLocation());
+			} else
+				BOOST_THROW_EXCEPTION(ScriptError("Invalid field specified for meta: " + meta));
+		}
+	}
+
+	result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
+
+	result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
+
+	DictionaryData joins;
+
+	for (const String& joinAttr : joinAttrs) {
+		Object::Ptr joinedObj;
+		int fid = type->GetFieldId(joinAttr);
+
+		if (fid < 0)
+			BOOST_THROW_EXCEPTION(ScriptError("Invalid field specified for join: " + joinAttr));
+
+		Field field = type->GetFieldInfo(fid);
+
+		if (!(field.Attributes & FANavigation))
+			BOOST_THROW_EXCEPTION(ScriptError("Not a joinable field: " + joinAttr));
+
+		joinedObj = obj->NavigateField(fid);
+
+		if (!joinedObj)
 			continue;
 
-		Value sval = Serialize(val, FAConfig | FAState);
-		resultAttrs.emplace_back(field.Name, sval);
+		String prefix = field.NavigationName;
+
+		joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
 	}
 
-	return new Dictionary(std::move(resultAttrs));
+	result1.emplace_back("joins", new Dictionary(std::move(joins)));
+
+	return new Dictionary(std::move(result1));
 }
 
 bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& request, HttpResponse& response, const Dictionary::Ptr& params)
@@ -170,9 +256,6 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		return true;
 	}
 
-	ArrayData results;
-	results.reserve(objs.size());
-
 	std::set<String> joinAttrs;
 	std::set<String> userJoinAttrs;
 
@@ -195,95 +278,79 @@ bool ObjectQueryHandler::HandleRequest(const ApiUser::Ptr& user, HttpRequest& re
 		joinAttrs.insert(field.Name);
 	}
 
-	for (const ConfigObject::Ptr& obj : objs) {
-		DictionaryData result1{
-			{ "name", obj->GetName() },
-			{ "type", obj->GetReflectionType()->GetName() }
-		};
-
-		DictionaryData metaAttrs;
-
-		if (umetas) {
-			ObjectLock olock(umetas);
-			for (const String& meta : umetas) {
-				if (meta == "used_by") {
-					Array::Ptr used_by = new Array();
-					metaAttrs.emplace_back("used_by", used_by);
-
-					for (const Object::Ptr& pobj : DependencyGraph::GetParents((obj)))
-					{
-						ConfigObject::Ptr configObj = dynamic_pointer_cast<ConfigObject>(pobj);
-
-						if (!configObj)
-							continue;
-
-						used_by->Add(new Dictionary({
-							{ "type", configObj->GetReflectionType()->GetName() },
-							{ "name", configObj->GetName() }
-						}));
-					}
-				} else if (meta == "location") {
-					metaAttrs.emplace_back("location", obj->GetSourceLocation());
-				} else {
-					HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for meta: " + meta);
-					return true;
-				}
+	if (!HttpUtility::GetLastParameter(params, "stream")) {
+		ArrayData results;
+		results.reserve(objs.size());
+
+		for (const ConfigObject::Ptr& obj : objs) {
+			try {
+				results.push_back(SerializeObject(obj, uattrs, ujoins, umetas, joinAttrs, allJoins));
+			} catch (const ScriptError& ex) {
+				HttpUtility::SendJsonError(response, params, 400, ex.what());
+				return true;
 			}
 		}
 
-		result1.emplace_back("meta", new Dictionary(std::move(metaAttrs)));
+		Dictionary::Ptr result = new Dictionary({
+			{ "results", new Array(std::move(results)) }
+		});
+
+		response.SetStatus(200, "OK");
+		HttpUtility::SendJsonBody(response, params, result);
+
+		return true;
+	}
+
+	/* Serialize the first object before sending the status line so that
+	 * invalid attrs/joins/meta still result in a proper error response.
+	 */
+	Dictionary::Ptr first;
 
+	if (!objs.empty()) {
 		try {
-			result1.emplace_back("attrs", SerializeObjectAttrs(obj, String(), uattrs, false, false));
+			first = SerializeObject(objs[0], uattrs, ujoins, umetas, joinAttrs, allJoins);
 		} catch (const ScriptError& ex) {
 			HttpUtility::SendJsonError(response, params, 400, ex.what());
 			return true;
 		}
+	}
 
-		DictionaryData joins;
-
-		for (const String& joinAttr : joinAttrs) {
-			Object::Ptr joinedObj;
-			int fid = type->GetFieldId(joinAttr);
-
-			if (fid < 0) {
-				HttpUtility::SendJsonError(response, params, 400, "Invalid field specified for join: " + joinAttr);
-				return true;
-			}
-
-			Field field = type->GetFieldInfo(fid);
-
-			if (!(field.Attributes & FANavigation)) {
-				HttpUtility::SendJsonError(response, params, 400, "Not a joinable field: " + joinAttr);
-				return true;
-			}
-
-			joinedObj = obj->NavigateField(fid);
+	response.SetStatus(200, "OK");
+	response.AddHeader("Content-Type", "application/x-ndjson");
 
-			if (!joinedObj)
-				continue;
+	String buffer;
 
-			String prefix = field.NavigationName;
+	for (std::vector<Value>::size_type i = 0; i < objs.size(); i++) {
+		Dictionary::Ptr result;
 
+		if (i == 0) {
+			result = first;
+			first.reset();
+		} else {
 			try {
-				joins.emplace_back(prefix, SerializeObjectAttrs(joinedObj, prefix, ujoins, true, allJoins));
+				result = SerializeObject(objs[i], uattrs, ujoins, umetas, joinAttrs, allJoins);
 			} catch (const ScriptError& ex) {
-				HttpUtility::SendJsonError(response, params, 400, ex.what());
-				return true;
+				/* The status line has already been sent. */
+				result = new Dictionary({
+					{ "error", 400 },
+					{ "status", ex.what() }
+				});
+
+				buffer += JsonEncode(result) + "\n";
+				break;
 			}
 		}
 
-		result1.emplace_back("joins", new Dictionary(std::move(joins)));
+		buffer += JsonEncode(result) + "\n";
 
-		results.push_back(new Dictionary(std::move(result1)));
+		if (buffer.GetLength() >= 64 * 1024) {
+			response.WriteBody(buffer.CStr(), buffer.GetLength());
+			buffer.Clear();
+		}
 	}
 
-	Dictionary::Ptr result = new Dictionary({
-		{ "results", new Array(std::move(results)) }
-	});
-
-	response.SetStatus(200, "OK");
-	HttpUtility::SendJsonBody(response, params, result);
+	if (!buffer.IsEmpty())
+		response.WriteBody(buffer.CStr(), buffer.GetLength());
 
 	return true;
 }
@@ -21,6 +21,8 @@
 #define OBJECTQUERYHANDLER_H
 
 #include "remote/httphandler.hpp"
+#include "base/configobject.hpp"
+#include <set>
 
 namespace icinga
 {
@@ -36,6 +38,8 @@ public:
 private:
 	static Dictionary::Ptr SerializeObjectAttrs(const Object::Ptr& object, const String& attrPrefix,
 		const Array::Ptr& attrs, bool isJoin, bool allAttrs);
+	static Dictionary::Ptr SerializeObject(const ConfigObject::Ptr& obj, const Array::Ptr& uattrs,
+		const Array::Ptr& ujoins, const Array::Ptr& umetas, const std::set<String>& joinAttrs, bool allJoins);
 };
 
 }
@@ -44,7 +44,7 @@ public:
 			{ "name", item->GetName() },
 			{ "type", item->GetType()->GetName() },
 			{ "location", new Dictionary({
-				{ "path", di.Path },
+				{ "path", di.Path.GetString() },
 				{ "first_line", di.FirstLine },
 				{ "first_column", di.FirstColumn },
 				{ "last_line", di.LastLine },
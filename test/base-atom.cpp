@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/atom.hpp"
+#include <BoostTestTargetConfig.h>
+#include <unordered_set>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_atom)
+
+BOOST_AUTO_TEST_CASE(intern)
+{
+	Atom a = "performance_data";
+	Atom b = String("performance") + "_data";
+	Atom c = "check_result";
+
+	BOOST_CHECK(a == b);
+	BOOST_CHECK(a != c);
+	BOOST_CHECK(&a.GetString() == &b.GetString());
+	BOOST_CHECK(a.GetString() == "performance_data");
+	BOOST_CHECK(Atom().GetString().IsEmpty());
+	BOOST_CHECK(Atom() == Atom(""));
+}
+
+BOOST_AUTO_TEST_CASE(hash)
+{
+	std::unordered_set<Atom> atoms;
+
+	atoms.insert("host");
+	atoms.insert("service");
+	atoms.insert(String("host"));
+
+	BOOST_CHECK(atoms.size() == 2);
+	BOOST_CHECK(atoms.find("service") != atoms.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/binarylog.hpp"
+#include <BoostTestTargetConfig.h>
+#include <sstream>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_binarylog)
+
+static LogEntry MakeEntry(LogSeverity severity, const String& facility, const String& message)
+{
+	LogEntry entry;
+	entry.Timestamp = 1500000000.25;
+	entry.Severity = severity;
+	entry.Facility = facility;
+	entry.Message = message;
+	return entry;
+}
+
+BOOST_AUTO_TEST_CASE(roundtrip)
+{
+	std::stringstream stream;
+	BinaryLogWriter writer;
+
+	writer.WriteHeader(stream);
+	writer.WriteEntry(stream, MakeEntry(LogDebug, "CheckerComponent", "Executing check"));
+	writer.WriteEntry(stream, MakeEntry(LogWarning, "ApiListener", String("binary\0data", 11)));
+	writer.WriteEntry(stream, MakeEntry(LogInformation, "CheckerComponent", ""));
+
+	/* A reopened log file starts with a new header and facility table. */
+	writer.WriteHeader(stream);
+	writer.WriteEntry(stream, MakeEntry(LogCritical, "ApiListener", "Reopened"));
+
+	BinaryLogReader reader;
+	LogEntry entry;
+
+	BOOST_CHECK(reader.ReadEntry(stream, &entry));
+	BOOST_CHECK(entry.Severity == LogDebug);
+	BOOST_CHECK(entry.Facility == "CheckerComponent");
+	BOOST_CHECK(entry.Message == "Executing check");
+	BOOST_CHECK(entry.Timestamp == 1500000000.25);
+
+	BOOST_CHECK(reader.ReadEntry(stream, &entry));
+	BOOST_CHECK(entry.Severity == LogWarning);
+	BOOST_CHECK(entry.Facility == "ApiListener");
+	BOOST_CHECK(entry.Message.GetLength() == 11);
+
+	BOOST_CHECK(reader.ReadEntry(stream, &entry));
+	BOOST_CHECK(entry.Facility == "CheckerComponent");
+	BOOST_CHECK(entry.Message.IsEmpty());
+
+	BOOST_CHECK(reader.ReadEntry(stream, &entry));
+	BOOST_CHECK(entry.Severity == LogCritical);
+	BOOST_CHECK(entry.Facility == "ApiListener");
+	BOOST_CHECK(entry.Message == "Reopened");
+
+	BOOST_CHECK(!reader.ReadEntry(stream, &entry));
+}
+
+BOOST_AUTO_TEST_CASE(truncated)
+{
+	std::stringstream stream;
+	BinaryLogWriter writer;
+
+	writer.WriteHeader(stream);
+	writer.WriteEntry(stream, MakeEntry(LogDebug, "CheckerComponent", "Executing check"));
+
+	std::string data = stream.str();
+	std::istringstream truncated(data.substr(0, data.size() - 3));
+
+	BinaryLogReader reader;
+	LogEntry entry;
+
+	BOOST_CHECK_THROW(reader.ReadEntry(truncated, &entry), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -21,6 +21,7 @@
 #include "base/object.hpp"
 #include <BoostTestTargetConfig.h>
 #include <iostream>
+#include <limits>
 
 using namespace icinga;
 
@@ -58,6 +59,27 @@ BOOST_AUTO_TEST_CASE(tostring)
 	BOOST_CHECK(Convert::ToString(Value("hello hello")) == "hello hello");
 }
 
+BOOST_AUTO_TEST_CASE(format)
+{
+	char buffer[Convert::FormatBufferSize];
+
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatInteger(0, buffer)) == "0");
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatInteger(-1234567890123LL, buffer)) == "-1234567890123");
+
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatFixed(0.055, buffer)) == "0.055000");
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatFixed(-0.0000001, buffer)) == "-0.000000");
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatFixed(9.9999999, buffer)) == "10.000000");
+	BOOST_CHECK(Convert::ToString(-123.4567891) == "-123.456789");
+
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatShortest(0.1, buffer)) == "0.1");
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatShortest(-7, buffer)) == "-7");
+	BOOST_CHECK(String(buffer, buffer + Convert::FormatShortest(1523462533.689, buffer)) == "1523462533.689");
+	BOOST_CHECK(Convert::FormatShortest(std::numeric_limits<double>::infinity(), buffer) == 0);
+
+	size_t length = Convert::FormatShortest(1.0 / 3, buffer);
+	BOOST_CHECK(Convert::ToDouble(String(buffer, buffer + length)) == 1.0 / 3);
+}
+
 BOOST_AUTO_TEST_CASE(tobool)
 {
 	BOOST_CHECK(Convert::ToBool("a") == true);
@@ -0,0 +1,58 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/dependencygraph.hpp"
+#include "base/dictionary.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_dependencygraph)
+
+BOOST_AUTO_TEST_CASE(parents)
+{
+	Dictionary::Ptr child = new Dictionary();
+	Dictionary::Ptr parent1 = new Dictionary();
+	Dictionary::Ptr parent2 = new Dictionary();
+
+	BOOST_CHECK(DependencyGraph::GetParents(child).empty());
+
+	DependencyGraph::AddDependency(parent1.get(), child.get());
+	DependencyGraph::AddDependency(parent1.get(), child.get());
+	DependencyGraph::AddDependency(parent2.get(), child.get());
+
+	BOOST_CHECK(DependencyGraph::GetParents(child).size() == 2);
+	BOOST_CHECK(DependencyGraph::GetParents(parent1).empty());
+
+	/* Dependencies are reference-counted. */
+	DependencyGraph::RemoveDependency(parent1.get(), child.get());
+	BOOST_CHECK(DependencyGraph::GetParents(child).size() == 2);
+
+	DependencyGraph::RemoveDependency(parent1.get(), child.get());
+
+	std::vector<Object::Ptr> parents = DependencyGraph::GetParents(child);
+	BOOST_CHECK(parents.size() == 1);
+	BOOST_CHECK(parents[0] == parent2);
+
+	DependencyGraph::RemoveDependency(parent2.get(), child.get());
+	DependencyGraph::RemoveDependency(parent2.get(), child.get());
+	BOOST_CHECK(DependencyGraph::GetParents(child).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -140,6 +140,30 @@ BOOST_AUTO_TEST_CASE(remove)
 	BOOST_CHECK(dictionary->GetLength() == 1);
 }
 
+BOOST_AUTO_TEST_CASE(order)
+{
+	Dictionary::Ptr dictionary = new Dictionary();
+
+	dictionary->Set("c", 3);
+	dictionary->Set("a", 1);
+	dictionary->Set("d", 4);
+	dictionary->Set("b", 2);
+	dictionary->Set("a", 5);
+
+	BOOST_CHECK(dictionary->GetLength() == 4);
+	BOOST_CHECK(dictionary->Get("a") == 5);
+
+	std::vector<String> keys = dictionary->GetKeys();
+	BOOST_CHECK(keys == std::vector<String>({ "a", "b", "c", "d" }));
+
+	/* The first value wins for duplicate keys, just like it did for std::map::insert(). */
+	Dictionary::Ptr data = new Dictionary(DictionaryData({ { "y", 1 }, { "x", 2 }, { "y", 3 } }));
+
+	BOOST_CHECK(data->GetLength() == 2);
+	BOOST_CHECK(data->Get("y") == 1);
+	BOOST_CHECK(data->GetKeys() == std::vector<String>({ "x", "y" }));
+}
+
 BOOST_AUTO_TEST_CASE(clone)
 {
 	Dictionary::Ptr dictionary = new Dictionary();
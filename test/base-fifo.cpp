@@ -57,4 +57,64 @@ BOOST_AUTO_TEST_CASE(io)
 	fifo->Close();
 }
 
+BOOST_AUTO_TEST_CASE(direct_buffers)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	fifo->Write("he", 2);
+
+	char *buffer = fifo->GetWriteBuffer(16);
+	memcpy(buffer, "llo", 3);
+	fifo->CommitWrite(3);
+
+	BOOST_CHECK(fifo->GetAvailableBytes() == 5);
+	BOOST_CHECK(memcmp(fifo->GetReadBuffer(), "hello", 5) == 0);
+
+	fifo->Read(nullptr, 2, true);
+	BOOST_CHECK(memcmp(fifo->GetReadBuffer(), "llo", 3) == 0);
+
+	fifo->Close();
+}
+
+BOOST_AUTO_TEST_CASE(chunks)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	std::vector<char> data(300000);
+
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = static_cast<char>(i % 251);
+
+	for (size_t offset = 0; offset < data.size(); offset += 1000)
+		fifo->Write(&data[offset], 1000);
+
+	BOOST_CHECK(fifo->GetAvailableBytes() == data.size());
+
+	size_t length;
+	const char *buffer = fifo->GetReadBuffer(&length);
+	BOOST_CHECK(length > 0 && length < data.size());
+	BOOST_CHECK(memcmp(buffer, &data[0], length) == 0);
+
+	/* Peek and Read have to gather the data across the chunks. */
+	std::vector<char> peeked(70000);
+	BOOST_CHECK(fifo->Peek(&peeked[0], peeked.size(), true) == peeked.size());
+	BOOST_CHECK(memcmp(&peeked[0], &data[0], peeked.size()) == 0);
+
+	std::vector<char> result;
+	char chunk[7777];
+	size_t rc;
+
+	while ((rc = fifo->Read(chunk, sizeof(chunk), true)) > 0)
+		result.insert(result.end(), chunk, chunk + rc);
+
+	BOOST_CHECK(result == data);
+	BOOST_CHECK(fifo->GetAvailableBytes() == 0);
+
+	fifo->Write("hello", 5);
+	BOOST_CHECK(fifo->GetAvailableBytes() == 5);
+	BOOST_CHECK(memcmp(fifo->GetReadBuffer(), "hello", 5) == 0);
+
+	fifo->Close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/flatset.hpp"
+#include "base/dictionary.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_flatset)
+
+BOOST_AUTO_TEST_CASE(insert)
+{
+	FlatSet<int> set;
+
+	BOOST_CHECK(set.IsEmpty());
+
+	BOOST_CHECK(set.Insert(3));
+	BOOST_CHECK(set.Insert(1));
+	BOOST_CHECK(set.Insert(2));
+	BOOST_CHECK(!set.Insert(1));
+
+	BOOST_CHECK(set.GetLength() == 3);
+	BOOST_CHECK(set.ToVector() == std::vector<int>({ 1, 2, 3 }));
+	BOOST_CHECK(set.Contains(2));
+	BOOST_CHECK(!set.Contains(4));
+}
+
+BOOST_AUTO_TEST_CASE(erase)
+{
+	FlatSet<Dictionary::Ptr> set;
+
+	Dictionary::Ptr a = new Dictionary();
+	Dictionary::Ptr b = new Dictionary();
+
+	set.Insert(a);
+	set.Insert(b);
+
+	BOOST_CHECK(set.Erase(a));
+	BOOST_CHECK(!set.Erase(a));
+	BOOST_CHECK(!set.Contains(a));
+	BOOST_CHECK(set.Contains(b));
+
+	BOOST_CHECK(set.ToSet() == std::set<Dictionary::Ptr>({ b }));
+
+	BOOST_CHECK(set.Erase(b));
+	BOOST_CHECK(set.IsEmpty());
+	BOOST_CHECK(set.ToVector().capacity() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -18,8 +18,11 @@
  ******************************************************************************/
 
 #include "base/dictionary.hpp"
+#include "base/array.hpp"
 #include "base/objectlock.hpp"
 #include "base/json.hpp"
+#include "base/fifo.hpp"
+#include "base/convert.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -33,4 +36,73 @@ BOOST_AUTO_TEST_CASE(invalid1)
 	BOOST_CHECK_THROW(JsonDecode("{\"test\": \"test\""), std::exception);
 }
 
+BOOST_AUTO_TEST_CASE(decode)
+{
+	Dictionary::Ptr dict = JsonDecode("{\"b\": [1, 2.5, true, null], \"a\": {\"x\": \"y\"}, \"b\": -3e2}");
+
+	BOOST_CHECK(dict->GetLength() == 2);
+	BOOST_CHECK(dict->GetKeys() == std::vector<String>({ "a", "b" }));
+
+	/* The last value wins for duplicate keys. */
+	BOOST_CHECK(dict->Get("b") == -300);
+
+	Dictionary::Ptr inner = dict->Get("a");
+	BOOST_CHECK(inner->Get("x") == "y");
+
+	Array::Ptr arr = JsonDecode("[1, 2.5, true, null, [], {}]");
+	BOOST_CHECK(arr->GetLength() == 6);
+	BOOST_CHECK(arr->Get(1) == 2.5);
+	BOOST_CHECK(arr->Get(2) == true);
+	BOOST_CHECK(arr->Get(3).IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(decode_indexed)
+{
+	std::vector<String> documents = {
+		"{\"b\": [1, 2.5, true, null], \"a\": {\"x\": \"y\"}, \"b\": -3e2}",
+		"[1, -0.5e-3, 1E+2, 0, \"\", [], {}, [[]], {\"a\": {}}]",
+		"\"escaped \\\" \\\\ \\/ \\b\\f\\n\\r\\t \\u00e4 \\ud83d\\ude00\"",
+		" 42 ",
+		"{\"key with [brackets], {braces}: and commas\": \"value, too\"}"
+	};
+
+	/* Escapes at every position around the block boundaries. */
+	for (int i = 50; i < 140; i++)
+		documents.push_back("[\"" + String(i, 'x') + "\\\\\\\"\", \"\\\\\", {\"k\": 1}]");
+
+	for (const String& document : documents) {
+		Value value;
+		BOOST_CHECK(JsonDecodeIndexed(document, &value));
+		BOOST_CHECK(JsonEncode(value) == JsonEncode(JsonDecode(document)));
+	}
+
+	Value unescaped;
+	BOOST_CHECK(JsonDecodeIndexed("\"\\u00e4\\n\"", &unescaped));
+	BOOST_CHECK(unescaped == "\xc3\xa4\n");
+
+	/* Documents which are left to yajl. */
+	for (const String& document : std::vector<String>({ "", "[1,]", "[1] /* comment */", "\"\\ud800\"", "{\"a\" 1}", "[01]", "\"a\tb\"", "[1] [2]", "{\"a\": 1" })) {
+		Value value;
+		BOOST_CHECK(!JsonDecodeIndexed(document, &value));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(encode_stream)
+{
+	Array::Ptr arr = new Array();
+
+	for (int i = 0; i < 20000; i++)
+		arr->Add(new Dictionary({ { "id", i }, { "name", "object" + Convert::ToString(i) } }));
+
+	FIFO::Ptr fifo = new FIFO();
+	JsonEncode(arr, fifo);
+
+	String json = JsonEncode(arr);
+	BOOST_CHECK(fifo->GetAvailableBytes() == json.GetLength());
+
+	std::vector<char> buf(fifo->GetAvailableBytes());
+	fifo->Read(&buf[0], buf.size());
+	BOOST_CHECK(String(buf.begin(), buf.end()) == json);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/latencyhistogram.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_latencyhistogram)
+
+BOOST_AUTO_TEST_CASE(empty)
+{
+	LatencyHistogram histogram("test_empty");
+
+	BOOST_CHECK(histogram.GetCount() == 0);
+	BOOST_CHECK(histogram.GetPercentile(99) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(percentiles)
+{
+	LatencyHistogram histogram("test_percentiles");
+
+	/* 1ms ... 1000ms */
+	for (int i = 1; i <= 1000; i++)
+		histogram.Record(i / 1000.0);
+
+	BOOST_CHECK(histogram.GetCount() == 1000);
+
+	double p50 = histogram.GetPercentile(50);
+	BOOST_CHECK(p50 >= 0.5 && p50 <= 0.5 * 1.13);
+
+	double p99 = histogram.GetPercentile(99);
+	BOOST_CHECK(p99 >= 0.99 && p99 <= 0.99 * 1.13);
+
+	double p999 = histogram.GetPercentile(99.9);
+	BOOST_CHECK(p999 >= 0.999 && p999 <= 0.999 * 1.13);
+
+	BOOST_CHECK(histogram.GetPercentile(100) >= 1);
+}
+
+BOOST_AUTO_TEST_CASE(range)
+{
+	LatencyHistogram histogram("test_range");
+
+	histogram.Record(-1);
+	histogram.Record(0.000003);
+	histogram.Record(1e9);
+
+	BOOST_CHECK(histogram.GetCount() == 3);
+	BOOST_CHECK(histogram.GetPercentile(10) == 0);
+	BOOST_CHECK(histogram.GetPercentile(50) == 0.000003);
+	BOOST_CHECK(histogram.GetPercentile(100) > 3600);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -18,7 +18,10 @@
  ******************************************************************************/
 
 #include "base/netstring.hpp"
+#include "base/netstringindex.hpp"
 #include "base/fifo.hpp"
+#include "base/utility.hpp"
+#include <fstream>
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -39,4 +42,138 @@ BOOST_AUTO_TEST_CASE(netstring)
 	fifo->Close();
 }
 
+BOOST_AUTO_TEST_CASE(partial)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	String large(1024 * 1024, 'x');
+	String encoded = "1048576:" + large + ",5:hello,";
+
+	String s;
+	StreamReadContext src;
+
+	/* The rest of the string is read directly once the header is known. */
+	fifo->Write(encoded.CStr(), 1000);
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNeedData);
+
+	fifo->Write(encoded.CStr() + 1000, 500000);
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNeedData);
+
+	fifo->Write(encoded.CStr() + 501000, encoded.GetLength() - 501000);
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem);
+	BOOST_CHECK(s == large);
+
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem);
+	BOOST_CHECK(s == "hello");
+
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNeedData);
+
+	fifo->Write("3:foo;", 6);
+	BOOST_CHECK_THROW(NetString::ReadStringFromStream(fifo, &s, src), std::invalid_argument);
+
+	fifo->Close();
+}
+
+BOOST_AUTO_TEST_CASE(view)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	String large(100000, 'x');
+	String encoded = "5:hello,3:foo,100000:" + large + ",";
+
+	const char *data;
+	size_t length;
+	StreamReadContext src;
+
+	fifo->Write(encoded.CStr(), 20000);
+
+	/* Messages which are in the buffer are returned without copying them. */
+	BOOST_CHECK(NetString::ReadStringViewFromStream(fifo, &data, &length, src) == StatusNewItem);
+	BOOST_CHECK(String(data, data + length) == "hello");
+	BOOST_CHECK(data >= src.Buffer && data < src.Buffer + src.Size);
+
+	BOOST_CHECK(NetString::ReadStringViewFromStream(fifo, &data, &length, src) == StatusNewItem);
+	BOOST_CHECK(String(data, data + length) == "foo");
+
+	BOOST_CHECK(NetString::ReadStringViewFromStream(fifo, &data, &length, src) == StatusNeedData);
+
+	fifo->Write(encoded.CStr() + 20000, encoded.GetLength() - 20000);
+
+	/* Messages which straddle reads are assembled in the pending string. */
+	BOOST_CHECK(NetString::ReadStringViewFromStream(fifo, &data, &length, src) == StatusNewItem);
+	BOOST_CHECK(String(data, data + length) == large);
+
+	BOOST_CHECK(NetString::ReadStringViewFromStream(fifo, &data, &length, src) == StatusNeedData);
+	BOOST_CHECK(src.Pending.IsEmpty());
+
+	/* Views and copies can be mixed on the same context. */
+	NetString::WriteStringToStream(fifo, "bar");
+	NetString::WriteStringToStream(fifo, "baz");
+
+	BOOST_CHECK(NetString::ReadStringViewFromStream(fifo, &data, &length, src) == StatusNewItem);
+	BOOST_CHECK(String(data, data + length) == "bar");
+
+	String s;
+	BOOST_CHECK(NetString::ReadStringFromStream(fifo, &s, src) == StatusNewItem);
+	BOOST_CHECK(s == "baz");
+
+	fifo->Close();
+}
+
+BOOST_AUTO_TEST_CASE(buffer)
+{
+	String buffer = "5:hello,3:foo,4:ba";
+
+	String s;
+	size_t offset = NetString::ReadStringFromBuffer(buffer.CStr(), buffer.GetLength(), &s);
+	BOOST_CHECK(offset == 8);
+	BOOST_CHECK(s == "hello");
+
+	offset += NetString::ReadStringFromBuffer(buffer.CStr() + offset, buffer.GetLength() - offset, &s);
+	BOOST_CHECK(offset == 14);
+	BOOST_CHECK(s == "foo");
+
+	BOOST_CHECK(NetString::ReadStringFromBuffer(buffer.CStr() + offset, buffer.GetLength() - offset, &s) == 0);
+
+	String invalid = "5:hello;";
+	BOOST_CHECK_THROW(NetString::ReadStringFromBuffer(invalid.CStr(), invalid.GetLength(), &s), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(index)
+{
+	std::fstream fp;
+	String filename = Utility::CreateTempFile("base-netstring-index.XXXXXX", 0600, fp);
+
+	std::vector<NetStringIndexEntry> entries;
+
+	entries.push_back({ "Host", "foo", "foo", static_cast<uint_least64_t>(fp.tellp()) });
+	NetString::WriteStringToStream(fp, "hello");
+	entries.push_back({ "Service", "bar", "foo!bar", static_cast<uint_least64_t>(fp.tellp()) });
+	NetString::WriteStringToStream(fp, "world");
+	fp.close();
+
+	NetStringIndex::WriteToFile(filename, entries);
+
+	std::vector<NetStringIndexEntry> index;
+	BOOST_CHECK(NetStringIndex::ReadFromFile(filename, index));
+	BOOST_CHECK(index.size() == 2);
+	BOOST_CHECK(index[1].Type == "Service");
+	BOOST_CHECK(index[1].FullName == "foo!bar");
+
+	fp.open(filename.CStr(), std::ios_base::in);
+	BOOST_CHECK(NetStringIndex::ReadRecord(fp, index[1].Offset) == "world");
+	BOOST_CHECK(NetStringIndex::ReadRecord(fp, index[0].Offset) == "hello");
+	fp.close();
+
+	/* The index must not be used once the file has changed. */
+	fp.open(filename.CStr(), std::ios_base::out | std::ios_base::app);
+	NetString::WriteStringToStream(fp, "!");
+	fp.close();
+
+	BOOST_CHECK(!NetStringIndex::ReadFromFile(filename, index));
+
+	(void) unlink(NetStringIndex::GetIndexPath(filename).CStr());
+	(void) unlink(filename.CStr());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -278,4 +278,36 @@ BOOST_AUTO_TEST_CASE(pack_object)
 	));
 }
 
+BOOST_AUTO_TEST_CASE(unpack_roundtrip)
+{
+	Dictionary::Ptr dict = new Dictionary({
+		{"null", Empty},
+		{"false", false},
+		{"true", true},
+		{"42.125", 42.125},
+		{"foobar", "foobar"},
+		{"[]", (Array::Ptr)new Array({Empty, "x", (Dictionary::Ptr)new Dictionary({{"y", -1}})})}
+	});
+
+	String packed = PackObject(dict);
+	Value unpacked = UnpackObject(packed);
+
+	BOOST_REQUIRE(unpacked.IsObjectType<Dictionary>());
+	BOOST_CHECK(PackObject(unpacked) == packed);
+
+	Dictionary::Ptr result = unpacked;
+	BOOST_CHECK(result->Get("null").IsEmpty());
+	BOOST_CHECK(result->Get("42.125") == 42.125);
+	BOOST_CHECK(result->Get("foobar") == "foobar");
+}
+
+BOOST_AUTO_TEST_CASE(unpack_invalid)
+{
+	String packed = PackObject((Array::Ptr)new Array({"foobar"}));
+
+	BOOST_CHECK_THROW(UnpackObject(packed.SubStr(0, packed.GetLength() - 1)), std::invalid_argument);
+	BOOST_CHECK_THROW(UnpackObject(packed + String(1, '\0')), std::invalid_argument);
+	BOOST_CHECK_THROW(UnpackObject(String(1, '\x07')), std::invalid_argument);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -20,6 +20,8 @@
 #include "base/object.hpp"
 #include "base/value.hpp"
 #include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
 
 using namespace icinga;
 
@@ -53,4 +55,40 @@ BOOST_AUTO_TEST_CASE(getself)
 	BOOST_CHECK(vobject.IsObjectType<TestObject>());
 }
 
+BOOST_AUTO_TEST_CASE(confined)
+{
+	TestObject::Ptr tobject;
+
+	{
+		ThreadConfinedScope confined;
+
+		tobject = new TestObject();
+
+		{
+			ThreadConfinedScope nested;
+
+			TestObject::Ptr tobject2 = tobject;
+			BOOST_CHECK(tobject->GetReferenceCount() == 2);
+		}
+
+		BOOST_CHECK(tobject->GetReferenceCount() == 1);
+	}
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([tobject]() {
+			for (int k = 0; k < 10000; k++) {
+				TestObject::Ptr copy = tobject;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	BOOST_CHECK(tobject->GetReferenceCount() == 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/objectlock.hpp"
+#include "base/dictionary.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+#include <vector>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_objectlock)
+
+BOOST_AUTO_TEST_CASE(recursive)
+{
+	Dictionary::Ptr dict = new Dictionary();
+
+	ObjectLock olock(dict);
+	BOOST_CHECK(dict->GetLength() == 0);
+
+	{
+		ObjectLock ilock(dict);
+		dict->Set("test", 7);
+	}
+
+	BOOST_CHECK(dict->Get("test") == 7);
+}
+
+BOOST_AUTO_TEST_CASE(contention)
+{
+	Dictionary::Ptr dict = new Dictionary();
+	long counter = 0;
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 8; i++) {
+		threads.emplace_back([dict, &counter]() {
+			for (int k = 0; k < 10000; k++) {
+				ObjectLock olock(dict);
+				counter++;
+			}
+		});
+	}
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	BOOST_CHECK(counter == 80000);
+
+	/* Nobody holds the lock anymore. */
+	std::thread([dict]() { ObjectLock olock(dict); }).join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
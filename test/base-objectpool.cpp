@@ -0,0 +1,61 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/objectpool.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_objectpool)
+
+BOOST_AUTO_TEST_CASE(reuse)
+{
+	void *block = ObjectPool::Allocate(40);
+	ObjectPool::Free(block, 40);
+
+	/* Blocks are handed out again for any size in the same size class. */
+	void *block2 = ObjectPool::Allocate(48);
+	BOOST_CHECK(block2 == block);
+	ObjectPool::Free(block2, 48);
+
+	void *large = ObjectPool::Allocate(ObjectPool::MaxBlockSize + 1);
+	ObjectPool::Free(large, ObjectPool::MaxBlockSize + 1);
+}
+
+BOOST_AUTO_TEST_CASE(threads)
+{
+	std::vector<Dictionary::Ptr> dicts;
+
+	for (int i = 0; i < 1000; i++) {
+		dicts.emplace_back(new Dictionary({ { "array", new Array({ i }) } }));
+	}
+
+	/* Objects may be freed by a different thread than the one which allocated them. */
+	std::thread([&dicts]() { dicts.clear(); }).join();
+
+	for (int i = 0; i < 1000; i++) {
+		Dictionary::Ptr dict = new Dictionary({ { "array", new Array({ i }) } });
+		BOOST_CHECK(dict->GetLength() == 1);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
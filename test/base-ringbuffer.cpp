@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/ringbuffer.hpp"
+#include <BoostTestTargetConfig.h>
+#include <thread>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_ringbuffer)
+
+BOOST_AUTO_TEST_CASE(span)
+{
+	RingBuffer rb(10);
+
+	rb.InsertValue(100, 1);
+	rb.InsertValue(101, 2);
+	rb.InsertValue(101, 3);
+	rb.InsertValue(100, 4);
+
+	BOOST_CHECK(rb.UpdateAndGetValues(101, 1) == 5);
+	BOOST_CHECK(rb.UpdateAndGetValues(101, 2) == 10);
+
+	/* Slots which fall out of the window are reset. */
+	BOOST_CHECK(rb.UpdateAndGetValues(110, 10) == 5);
+	BOOST_CHECK(rb.UpdateAndGetValues(120, 10) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent)
+{
+	RingBuffer rb(60);
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&rb]() {
+			for (int tv = 1000; tv < 1010; tv++) {
+				for (int n = 0; n < 1000; n++)
+					rb.InsertValue(tv, 1);
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	BOOST_CHECK(rb.UpdateAndGetValues(1009, 60) == 4 * 10 * 1000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -82,4 +82,23 @@ BOOST_AUTO_TEST_CASE(object)
 	BOOST_CHECK(result->GetValue() == pdv->GetValue());
 }
 
+BOOST_AUTO_TEST_CASE(circular)
+{
+	Dictionary::Ptr dict = new Dictionary();
+	Array::Ptr array = new Array({ 1, "test" });
+
+	dict->Set("a", array);
+	dict->Set("b", array);
+
+	/* Referring to the same object twice isn't a cycle. */
+	Dictionary::Ptr result = Serialize(dict);
+	BOOST_CHECK(result->GetLength() == 2);
+
+	array->Add(dict);
+
+	BOOST_CHECK_THROW(Serialize(dict), CircularReferenceError);
+
+	array->Remove(2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
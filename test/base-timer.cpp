@@ -21,6 +21,8 @@
 #include "base/utility.hpp"
 #include "base/application.hpp"
 #include <BoostTestTargetConfig.h>
+#include <atomic>
+#include <cmath>
 
 using namespace icinga;
 
@@ -75,4 +77,47 @@ BOOST_AUTO_TEST_CASE(scope)
 	BOOST_CHECK(counter >= 4 && counter <= 6);
 }
 
+BOOST_AUTO_TEST_CASE(slack)
+{
+	Timer::Ptr timer = new Timer();
+	timer->SetInterval(1.5);
+	timer->SetSlack(1);
+	BOOST_CHECK(timer->GetSlack() == 1);
+
+	timer->Start();
+	double next = timer->GetNext();
+	timer->Stop();
+
+	BOOST_CHECK(next == std::ceil(next));
+}
+
+static void AtomicCallback(std::atomic<int> *counter)
+{
+	(*counter)++;
+}
+
+BOOST_AUTO_TEST_CASE(batch)
+{
+	std::atomic<int> counter{0};
+	std::vector<Timer::Ptr> timers;
+
+	for (int i = 0; i < 100; i++) {
+		Timer::Ptr timer = new Timer();
+		timer->OnTimerExpired.connect(std::bind(&AtomicCallback, &counter));
+		timer->SetInterval(1);
+		timer->SetSlack(1);
+		timers.push_back(timer);
+	}
+
+	for (const Timer::Ptr& timer : timers)
+		timer->Start();
+
+	Utility::Sleep(3.5);
+
+	for (const Timer::Ptr& timer : timers)
+		timer->Stop(true);
+
+	BOOST_CHECK(counter >= 200 && counter <= 400);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,139 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/timerwheel.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_timerwheel)
+
+BOOST_AUTO_TEST_CASE(expire)
+{
+	TimerWheel wheel(0.01);
+	TimerWheelEntry e1, e2, e3;
+
+	wheel.Insert(&e1, 1000.5);
+	wheel.Insert(&e2, 1000.25);
+	wheel.Insert(&e3, 1002);
+
+	BOOST_CHECK(wheel.GetLength() == 3);
+	BOOST_CHECK(wheel.GetNextExpiry() <= 1000.25);
+
+	BOOST_CHECK(wheel.PopExpired(1000.2) == nullptr);
+	BOOST_CHECK(wheel.PopExpired(1000.3) == &e2);
+	BOOST_CHECK(wheel.PopExpired(1000.3) == nullptr);
+	BOOST_CHECK(!e2.IsScheduled());
+
+	BOOST_CHECK(wheel.PopExpired(1001) == &e1);
+	BOOST_CHECK(wheel.PopExpired(1001) == nullptr);
+	BOOST_CHECK(wheel.PopExpired(1002) == &e3);
+	BOOST_CHECK(wheel.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(remove)
+{
+	TimerWheel wheel(0.01);
+	TimerWheelEntry e1, e2;
+
+	wheel.Insert(&e1, 10);
+	wheel.Insert(&e2, 20);
+
+	wheel.Remove(&e1);
+	BOOST_CHECK(!e1.IsScheduled());
+	BOOST_CHECK(wheel.GetLength() == 1);
+
+	/* removing an entry twice is a no-op */
+	wheel.Remove(&e1);
+	BOOST_CHECK(wheel.GetLength() == 1);
+
+	BOOST_CHECK(wheel.PopExpired(30) == &e2);
+	BOOST_CHECK(wheel.PopExpired(30) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(reschedule)
+{
+	TimerWheel wheel(0.01);
+	TimerWheelEntry e1;
+
+	wheel.Insert(&e1, 100);
+	wheel.Reschedule(&e1, 50000);
+
+	BOOST_CHECK(wheel.PopExpired(100) == nullptr);
+	BOOST_CHECK(wheel.GetNextExpiry() <= 50000);
+	BOOST_CHECK(wheel.PopExpired(49999.99) == nullptr);
+	BOOST_CHECK(wheel.PopExpired(50000) == &e1);
+	BOOST_CHECK(e1.GetWhen() == 50000);
+}
+
+BOOST_AUTO_TEST_CASE(past)
+{
+	TimerWheel wheel(0.01);
+	TimerWheelEntry e1, e2;
+
+	wheel.Insert(&e1, 100);
+	BOOST_CHECK(wheel.PopExpired(200) == &e1);
+
+	/* entries which are already due are returned immediately */
+	wheel.Insert(&e2, 150);
+	BOOST_CHECK(wheel.GetNextExpiry() <= 200);
+	BOOST_CHECK(wheel.PopExpired(200) == &e2);
+}
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	TimerWheel wheel(1);
+	std::vector<TimerWheelEntry> entries(500);
+
+	for (std::vector<TimerWheelEntry>::size_type i = 0; i < entries.size(); i++)
+		wheel.Insert(&entries[i], 1000 + (i * 7919) % 100000);
+
+	double last = 0;
+	int count = 0;
+
+	for (double now = 1000; now <= 101000; now += 50) {
+		TimerWheelEntry *entry;
+
+		while ((entry = wheel.PopExpired(now))) {
+			BOOST_CHECK(entry->GetWhen() <= now);
+			BOOST_CHECK(entry->GetWhen() > now - 50);
+			BOOST_CHECK(entry->GetWhen() + 50 > last);
+			last = entry->GetWhen();
+			count++;
+		}
+	}
+
+	BOOST_CHECK(count == 500);
+	BOOST_CHECK(wheel.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(overflow)
+{
+	TimerWheel wheel(0.01);
+	TimerWheelEntry e1, e2;
+
+	wheel.Insert(&e1, 1);
+	wheel.Insert(&e2, 1e9);
+
+	BOOST_CHECK(wheel.PopExpired(1) == &e1);
+	BOOST_CHECK(wheel.PopExpired(1e9 - 1) == nullptr);
+	BOOST_CHECK(wheel.PopExpired(1e9) == &e2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -61,4 +61,26 @@ BOOST_AUTO_TEST_CASE(instantiate)
 	BOOST_CHECK(p);
 }
 
+BOOST_AUTO_TEST_CASE(visitfields)
+{
+	PerfdataValue::Ptr pv = new PerfdataValue("test", 5, false, "s", 3, 7);
+	Type::Ptr type = pv->GetReflectionType();
+
+	std::vector<String> names;
+
+	pv->VisitFields(0, [&names, &pv, &type](const Field& field, const Value& value) {
+		int fid = type->GetFieldId(field.Name);
+		BOOST_CHECK(fid == static_cast<int>(names.size()));
+		BOOST_CHECK(value == pv->GetField(fid));
+		names.emplace_back(field.Name);
+	});
+
+	BOOST_CHECK(names.size() == static_cast<size_t>(type->GetFieldCount()));
+
+	/* Fields without any matching attribute are skipped. */
+	pv->VisitFields(FAState, [](const Field& field, const Value&) {
+		BOOST_CHECK(field.Attributes & FAState);
+	});
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "base/workqueue.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(base_workqueue)
+
+BOOST_AUTO_TEST_CASE(order)
+{
+	WorkQueue wq;
+	wq.SetName("Test");
+
+	boost::mutex mutex;
+	std::vector<int> results;
+
+	for (int i = 0; i < 10000; i++) {
+		wq.Enqueue([&mutex, &results, i]() {
+			boost::mutex::scoped_lock lock(mutex);
+			results.push_back(i);
+		});
+	}
+
+	wq.Join();
+
+	BOOST_CHECK(wq.GetLength() == 0);
+	BOOST_REQUIRE(results.size() == 10000);
+
+	for (int i = 0; i < 10000; i++)
+		BOOST_CHECK(results[i] == i);
+}
+
+BOOST_AUTO_TEST_CASE(priority)
+{
+	WorkQueue wq;
+	wq.SetName("Test");
+
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	bool started = false, blocked = true;
+	std::vector<int> results;
+
+	/* Keep the worker thread busy until all tasks have been enqueued. */
+	wq.Enqueue([&mutex, &cv, &started, &blocked]() {
+		boost::mutex::scoped_lock lock(mutex);
+
+		started = true;
+		cv.notify_all();
+
+		while (blocked)
+			cv.wait(lock);
+	});
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+
+		while (!started)
+			cv.wait(lock);
+	}
+
+	auto push = [&mutex, &results](int value) {
+		return [&mutex, &results, value]() {
+			boost::mutex::scoped_lock lock(mutex);
+			results.push_back(value);
+		};
+	};
+
+	wq.Enqueue(push(1));
+	wq.Enqueue(push(2), PriorityLow);
+	wq.Enqueue(push(3), PriorityHigh);
+	wq.Enqueue(push(4));
+
+	BOOST_CHECK(wq.GetLength() == 4);
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		blocked = false;
+		cv.notify_all();
+	}
+
+	wq.Join();
+
+	BOOST_REQUIRE(results.size() == 4);
+	BOOST_CHECK(results[0] == 3);
+	BOOST_CHECK(results[1] == 1);
+	BOOST_CHECK(results[2] == 4);
+	BOOST_CHECK(results[3] == 2);
+}
+
+BOOST_AUTO_TEST_CASE(producers)
+{
+	WorkQueue wq(100);
+	wq.SetName("Test");
+
+	std::atomic<int> count(0);
+	boost::thread_group producers;
+
+	for (int i = 0; i < 4; i++) {
+		producers.create_thread([&wq, &count]() {
+			for (int j = 0; j < 5000; j++)
+				wq.Enqueue([&count]() { count++; });
+		});
+	}
+
+	producers.join_all();
+	wq.Join();
+
+	BOOST_CHECK(count == 20000);
+	BOOST_CHECK(wq.GetLength() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,198 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "benchmark-messages.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include "base/json.hpp"
+#include "base/netstring.hpp"
+#include "base/fifo.hpp"
+#include "base/serializer.hpp"
+#include "base/value.hpp"
+#include <benchmark/benchmark.h>
+#include <sstream>
+
+using namespace icinga;
+
+static void BenchmarkJsonEncode(benchmark::State& state)
+{
+	Dictionary::Ptr message = MakeCheckResultMessage();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(JsonEncode(message));
+}
+BENCHMARK(BenchmarkJsonEncode);
+
+static void BenchmarkJsonDecode(benchmark::State& state)
+{
+	String json = JsonEncode(MakeCheckResultMessage());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(JsonDecode(json));
+
+	state.SetBytesProcessed(state.iterations() * json.GetLength());
+}
+BENCHMARK(BenchmarkJsonDecode);
+
+static void BenchmarkJsonDecodeIndexed(benchmark::State& state)
+{
+	String json = JsonEncode(MakeCheckResultMessage());
+	Value result;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(JsonDecodeIndexed(json, &result));
+
+	state.SetBytesProcessed(state.iterations() * json.GetLength());
+}
+BENCHMARK(BenchmarkJsonDecodeIndexed);
+
+static void BenchmarkDictionaryGet(benchmark::State& state)
+{
+	Dictionary::Ptr dict = new Dictionary();
+
+	for (int i = 0; i < state.range(0); i++)
+		dict->Set("key" + Convert::ToString(i), i);
+
+	String key = "key" + Convert::ToString(state.range(0) / 2);
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(dict->Get(key));
+}
+BENCHMARK(BenchmarkDictionaryGet)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BenchmarkDictionarySet(benchmark::State& state)
+{
+	std::vector<String> keys;
+
+	for (int i = 0; i < state.range(0); i++)
+		keys.push_back("key" + Convert::ToString(i));
+
+	for (auto _ : state) {
+		Dictionary::Ptr dict = new Dictionary();
+
+		for (const String& key : keys)
+			dict->Set(key, 1);
+
+		benchmark::DoNotOptimize(dict);
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BenchmarkDictionarySet)->Arg(8)->Arg(64)->Arg(1024);
+
+static void BenchmarkValueToString(benchmark::State& state)
+{
+	Value value = 1523462537.7305359840;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(static_cast<String>(value));
+}
+BENCHMARK(BenchmarkValueToString);
+
+static void BenchmarkValueToDouble(benchmark::State& state)
+{
+	Value value = "1523462537.7305359840";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(static_cast<double>(value));
+}
+BENCHMARK(BenchmarkValueToDouble);
+
+static void BenchmarkValueOperators(benchmark::State& state)
+{
+	Value a = 7, b = 3.5, s = "hello";
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(a + b);
+		benchmark::DoNotOptimize(a * b < a - b);
+		benchmark::DoNotOptimize(s + a);
+		benchmark::DoNotOptimize(s == "hello");
+	}
+}
+BENCHMARK(BenchmarkValueOperators);
+
+static void BenchmarkStringConcat(benchmark::State& state)
+{
+	String host = "web-frontend-042.example.localdomain";
+	String service = "ping4";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(host + "!" + service);
+}
+BENCHMARK(BenchmarkStringConcat);
+
+static void BenchmarkNetStringWrite(benchmark::State& state)
+{
+	String json = JsonEncode(MakeCheckResultMessage());
+	FIFO::Ptr fifo = new FIFO();
+
+	for (auto _ : state) {
+		NetString::WriteStringToStream(fifo, json);
+
+		state.PauseTiming();
+		fifo->Read(nullptr, fifo->GetAvailableBytes(), true);
+		state.ResumeTiming();
+	}
+
+	state.SetBytesProcessed(state.iterations() * json.GetLength());
+}
+BENCHMARK(BenchmarkNetStringWrite);
+
+static void BenchmarkNetStringRead(benchmark::State& state)
+{
+	String json = JsonEncode(MakeCheckResultMessage());
+	std::ostringstream msgbuf;
+
+	for (int i = 0; i < 100; i++)
+		NetString::WriteStringToStream(msgbuf, json);
+
+	String buffer = msgbuf.str();
+
+	for (auto _ : state) {
+		String message;
+		size_t offset = 0, rc;
+
+		while ((rc = NetString::ReadStringFromBuffer(buffer.CStr() + offset, buffer.GetLength() - offset, &message)) > 0)
+			offset += rc;
+
+		benchmark::DoNotOptimize(message);
+	}
+
+	state.SetItemsProcessed(state.iterations() * 100);
+}
+BENCHMARK(BenchmarkNetStringRead);
+
+static void BenchmarkSerialize(benchmark::State& state)
+{
+	Dictionary::Ptr message = MakeCheckResultMessage();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Serialize(message));
+}
+BENCHMARK(BenchmarkSerialize);
+
+static void BenchmarkDeserialize(benchmark::State& state)
+{
+	Value serialized = Serialize(MakeCheckResultMessage());
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(Deserialize(serialized, true));
+}
+BENCHMARK(BenchmarkDeserialize);
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/macroprocessor.hpp"
+#include "icinga/pluginutility.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/objectlock.hpp"
+#include <benchmark/benchmark.h>
+
+using namespace icinga;
+
+static const char *l_Perfdata = "'/ used'=5321MB;7884;8869;0;9855 '/boot used'=152MB;189;213;0;237 "
+	"rta=0.055000ms;100.000000;200.000000;0.000000 pl=0%;5;15;0 load1=0.230;5.000;10.000;0; "
+	"load5=0.180;4.000;6.000;0; load15=0.120;3.000;4.000;0; time=0.001s;;;0.000000 size=178B;;;0";
+
+static void BenchmarkSplitPerfdata(benchmark::State& state)
+{
+	for (auto _ : state)
+		benchmark::DoNotOptimize(PluginUtility::SplitPerfdata(l_Perfdata));
+}
+BENCHMARK(BenchmarkSplitPerfdata);
+
+static void BenchmarkPerfdataValueParse(benchmark::State& state)
+{
+	Array::Ptr values = PluginUtility::SplitPerfdata(l_Perfdata);
+	std::vector<String> tokens;
+
+	{
+		ObjectLock olock(values);
+
+		for (const Value& value : values)
+			tokens.push_back(value);
+	}
+
+	for (auto _ : state) {
+		for (const String& token : tokens)
+			benchmark::DoNotOptimize(PerfdataValue::Parse(token));
+	}
+
+	state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BenchmarkPerfdataValueParse);
+
+static void BenchmarkResolveMacros(benchmark::State& state)
+{
+	Dictionary::Ptr host = new Dictionary({
+		{ "name", "web-frontend-042.example.localdomain" },
+		{ "address", "192.168.33.10" },
+		{ "vars", new Dictionary({ { "ping_wrta", 100 }, { "ping_crta", 200 } }) }
+	});
+
+	Dictionary::Ptr service = new Dictionary({
+		{ "name", "ping4" },
+		{ "vars", new Dictionary({ { "ping_wpl", 5 }, { "ping_cpl", 15 } }) }
+	});
+
+	MacroProcessor::ResolverList resolvers;
+	resolvers.emplace_back("service", service);
+	resolvers.emplace_back("host", host);
+
+	String command = "$host.address$ -w $host.vars.ping_wrta$,$service.vars.ping_wpl$% "
+		"-c $host.vars.ping_crta$,$service.vars.ping_cpl$% -p 5 -t 10";
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(MacroProcessor::ResolveMacros(command, resolvers));
+}
+BENCHMARK(BenchmarkResolveMacros);
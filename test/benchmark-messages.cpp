@@ -0,0 +1,72 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "benchmark-messages.hpp"
+#include "base/array.hpp"
+#include "base/utility.hpp"
+
+using namespace icinga;
+
+/* An event::CheckResult message as it is relayed between cluster nodes. */
+Dictionary::Ptr MakeCheckResultMessage()
+{
+	Dictionary::Ptr cr = new Dictionary({
+		{ "active", true },
+		{ "check_source", "master1.example.localdomain" },
+		{ "command", new Array({ "/usr/lib/nagios/plugins/check_ping", "-H", "192.168.33.10", "-c", "200,15%", "-w", "100,5%" }) },
+		{ "execution_end", 1523462537.7305359840 },
+		{ "execution_start", 1523462533.6894919872 },
+		{ "exit_status", 0 },
+		{ "output", "PING OK - Packet loss = 0%, RTA = 0.05 ms" },
+		{ "performance_data", new Array({ "rta=0.055000ms;100.000000;200.000000;0.000000", "pl=0%;5;15;0" }) },
+		{ "schedule_end", 1523462537.7306189537 },
+		{ "schedule_start", 1523462533.6890000000 },
+		{ "state", 0 },
+		{ "ttl", 0 },
+		{ "type", "CheckResult" },
+		{ "vars_after", new Dictionary({ { "attempt", 1 }, { "reachable", true }, { "state", 0 }, { "state_type", 1 } }) },
+		{ "vars_before", new Dictionary({ { "attempt", 1 }, { "reachable", true }, { "state", 0 }, { "state_type", 1 } }) }
+	});
+
+	return new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::CheckResult" },
+		{ "params", new Dictionary({
+			{ "cr", cr },
+			{ "host", "web-frontend-042.example.localdomain" },
+			{ "service", "ping4" }
+		}) },
+		{ "ts", 1523462537.7312090397 }
+	});
+}
+
+/* An event::SetNextCheck message which is sent whenever a check is rescheduled. */
+Dictionary::Ptr MakeSetNextCheckMessage()
+{
+	return new Dictionary({
+		{ "jsonrpc", "2.0" },
+		{ "method", "event::SetNextCheck" },
+		{ "params", new Dictionary({
+			{ "host", "web-frontend-042.example.localdomain" },
+			{ "next_check", 1523462597.6890000000 },
+			{ "service", "ping4" }
+		}) },
+		{ "ts", 1523462537.7312090397 }
+	});
+}
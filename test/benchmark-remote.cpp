@@ -0,0 +1,201 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "benchmark-messages.hpp"
+#include "remote/apifunction.hpp"
+#include "remote/jsonrpc.hpp"
+#include "remote/jsonrpcconnection.hpp"
+#include "remote/messageorigin.hpp"
+#include "base/socket.hpp"
+#include "base/tlsstream.hpp"
+#include "base/tlsutility.hpp"
+#include "base/utility.hpp"
+#include <benchmark/benchmark.h>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
+#include <fstream>
+#include <thread>
+#include <sys/socket.h>
+
+using namespace icinga;
+
+/**
+ * Two TLS streams over a socketpair with a receiver thread which reads,
+ * decodes and dispatches messages just like JsonRpcConnection does.
+ *
+ * The receiving connection isn't authenticated, so the cluster event
+ * handlers return right after looking up the endpoint.
+ */
+class ClusterLink
+{
+public:
+	explicit ClusterLink(bool binary)
+		: m_Binary(binary)
+	{
+		std::fstream fp;
+		m_KeyPath = Utility::CreateTempFile("icinga2-benchmark-key.XXXXXX", 0600, fp);
+		fp.close();
+		m_CertPath = Utility::CreateTempFile("icinga2-benchmark-crt.XXXXXX", 0600, fp);
+		fp.close();
+
+		MakeX509CSR("benchmark", m_KeyPath, String(), m_CertPath);
+		std::shared_ptr<SSL_CTX> context = MakeSSLContext(m_CertPath, m_KeyPath, m_CertPath);
+
+		int fds[2];
+
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+			BOOST_THROW_EXCEPTION(std::runtime_error("socketpair() failed"));
+
+		m_Sender = new TlsStream(new Socket(fds[0]), "benchmark", RoleClient, context);
+		m_Receiver = new TlsStream(new Socket(fds[1]), "benchmark", RoleServer, context);
+
+		std::thread handshake([this]() { m_Receiver->Handshake(); });
+		m_Sender->Handshake();
+		handshake.join();
+
+		m_Connection = new JsonRpcConnection("benchmark", false, m_Receiver, RoleServer);
+		m_Thread = std::thread(&ClusterLink::ReceiverThreadProc, this);
+	}
+
+	~ClusterLink()
+	{
+		m_Sender->Close();
+		m_Thread.join();
+		m_Receiver->Close();
+
+		(void) unlink(m_KeyPath.CStr());
+		(void) unlink(m_CertPath.CStr());
+	}
+
+	size_t Send(const Dictionary::Ptr& message)
+	{
+		message->Set("ts", Utility::GetTime());
+
+		m_Sent++;
+		return JsonRpc::SendMessage(m_Sender, message, m_Binary);
+	}
+
+	/* Waits until all messages which were sent so far have been dispatched. */
+	void Flush()
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		while (m_Received < m_Sent)
+			m_CV.wait(lock);
+	}
+
+	std::vector<double> TakeLatencies()
+	{
+		boost::mutex::scoped_lock lock(m_Mutex);
+
+		std::vector<double> latencies;
+		std::swap(latencies, m_Latencies);
+		return latencies;
+	}
+
+private:
+	bool m_Binary;
+	String m_KeyPath;
+	String m_CertPath;
+	TlsStream::Ptr m_Sender;
+	TlsStream::Ptr m_Receiver;
+	JsonRpcConnection::Ptr m_Connection;
+	std::thread m_Thread;
+
+	boost::mutex m_Mutex;
+	boost::condition_variable m_CV;
+	uint64_t m_Sent{0};
+	uint64_t m_Received{0};
+	std::vector<double> m_Latencies;
+
+	void ReceiverThreadProc()
+	{
+		StreamReadContext src;
+		MessageOrigin::Ptr origin = new MessageOrigin();
+		origin->FromClient = m_Connection;
+
+		for (;;) {
+			String jsonString;
+			StreamReadStatus srs;
+
+			try {
+				srs = JsonRpc::ReadMessage(m_Receiver, &jsonString, src, true);
+			} catch (const std::exception&) {
+				break;
+			}
+
+			if (srs == StatusEof)
+				break;
+
+			if (srs != StatusNewItem)
+				continue;
+
+			Dictionary::Ptr message = JsonRpc::DecodeMessage(jsonString);
+			ApiFunction::Ptr afunc = ApiFunction::GetByName(message->Get("method"));
+
+			if (afunc)
+				afunc->Invoke(origin, message->Get("params"));
+
+			double ts = message->Get("ts");
+			double latency = Utility::GetTime() - ts;
+
+			boost::mutex::scoped_lock lock(m_Mutex);
+			m_Latencies.push_back(latency);
+			m_Received++;
+			m_CV.notify_all();
+		}
+	}
+};
+
+static double GetPercentile(std::vector<double>& values, double percentile)
+{
+	if (values.empty())
+		return 0;
+
+	size_t index = std::min(values.size() - 1, static_cast<size_t>(values.size() * percentile / 100));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+/* Sends batches of check results and next check updates, range(0) selects the binary encoding. */
+static void BenchmarkClusterMessages(benchmark::State& state)
+{
+	const int batchSize = 100;
+	ClusterLink link(state.range(0) != 0);
+	size_t bytes = 0;
+
+	for (auto _ : state) {
+		for (int i = 0; i < batchSize; i += 2) {
+			bytes += link.Send(MakeCheckResultMessage());
+			bytes += link.Send(MakeSetNextCheckMessage());
+		}
+
+		link.Flush();
+	}
+
+	std::vector<double> latencies = link.TakeLatencies();
+
+	state.SetItemsProcessed(state.iterations() * batchSize);
+	state.SetBytesProcessed(bytes);
+	state.counters["p50_us"] = GetPercentile(latencies, 50) * 1000000;
+	state.counters["p99_us"] = GetPercentile(latencies, 99) * 1000000;
+	state.counters["p999_us"] = GetPercentile(latencies, 99.9) * 1000000;
+}
+BENCHMARK(BenchmarkClusterMessages)->ArgName("binary")->Arg(0)->Arg(1)->UseRealTime();
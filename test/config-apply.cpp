@@ -0,0 +1,87 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "config/applyrule.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+static std::unique_ptr<Expression> MakeVarsPath(const String& variable, const String& attr)
+{
+	std::unique_ptr<Expression> vars{new IndexerExpression(std::unique_ptr<Expression>(new VariableExpression(variable)), MakeLiteral("vars"))};
+	return std::unique_ptr<Expression>(new IndexerExpression(std::move(vars), MakeLiteral(attr)));
+}
+
+static void AddTestRule(const String& name, Expression *filter)
+{
+	ApplyRule::AddRule("ApplyIndexTest", "Host", name, std::shared_ptr<Expression>(MakeLiteral()),
+		std::shared_ptr<Expression>(filter), "_etc", "", "", nullptr, false, DebugInfo(), new Dictionary());
+}
+
+static std::vector<String> GetCandidateNames(const Dictionary::Ptr& vars)
+{
+	std::vector<String> names;
+
+	for (ApplyRule *rule : ApplyRule::GetCandidateRules("ApplyIndexTest", vars))
+		names.push_back(rule->GetName());
+
+	return names;
+}
+
+BOOST_AUTO_TEST_SUITE(config_apply)
+
+BOOST_AUTO_TEST_CASE(candidates)
+{
+	/* assign where host.vars.os == "Linux" */
+	AddTestRule("linux", new EqualExpression(MakeVarsPath("host", "os"), MakeLiteral("Linux")));
+
+	/* assign where "Windows" == host.vars.os && host.vars.x */
+	AddTestRule("windows", new LogicalAndExpression(
+		std::unique_ptr<Expression>(new EqualExpression(MakeLiteral("Windows"), MakeVarsPath("host", "os"))),
+		MakeVarsPath("host", "x")));
+
+	/* assign where "web" in host.vars.roles */
+	AddTestRule("web", new InExpression(MakeLiteral("web"), MakeVarsPath("host", "roles")));
+
+	/* assign where host.vars.x || host.vars.os == "Linux" */
+	AddTestRule("any", new LogicalOrExpression(MakeVarsPath("host", "x"),
+		std::unique_ptr<Expression>(new EqualExpression(MakeVarsPath("host", "os"), MakeLiteral("Linux")))));
+
+	Dictionary::Ptr hostVars = new Dictionary();
+	Dictionary::Ptr host = new Dictionary({ { "vars", hostVars } });
+	Dictionary::Ptr vars = new Dictionary({ { "host", host } });
+
+	BOOST_CHECK(GetCandidateNames(vars) == std::vector<String>({ "any" }));
+
+	hostVars->Set("os", "Linux");
+	BOOST_CHECK(GetCandidateNames(vars) == std::vector<String>({ "linux", "any" }));
+
+	hostVars->Set("os", "Windows");
+	hostVars->Set("roles", new Array({ "db", "web" }));
+	BOOST_CHECK(GetCandidateNames(vars) == std::vector<String>({ "windows", "web", "any" }));
+
+	/* Values which can't be looked up in the index must not exclude any rules. */
+	hostVars->Set("os", 7);
+	hostVars->Set("roles", "web");
+	BOOST_CHECK(GetCandidateNames(vars) == std::vector<String>({ "linux", "windows", "web", "any" }));
+
+	BOOST_CHECK(GetCandidateNames(new Dictionary()) == std::vector<String>({ "linux", "windows", "web", "any" }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
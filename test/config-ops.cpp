@@ -174,6 +174,11 @@ BOOST_AUTO_TEST_CASE(advanced)
 
 	expr = ConfigCompiler::CompileText("<test>", R"(regex("^Hello", "Hello World"))");
 	BOOST_CHECK(expr->Evaluate(frame).GetValue());
+	BOOST_CHECK(expr->Evaluate(frame).GetValue());
+
+	/* Invalid constant patterns are only reported when the call is evaluated. */
+	expr = ConfigCompiler::CompileText("<test>", R"(regex("^(Hello", "Hello World"))");
+	BOOST_CHECK_THROW(expr->Evaluate(frame).GetValue(), std::exception);
 
 	expr = ConfigCompiler::CompileText("<test>", "__boost_test()");
 	BOOST_CHECK_THROW(expr->Evaluate(frame).GetValue(), ScriptError);
@@ -260,4 +265,32 @@ BOOST_AUTO_TEST_CASE(advanced)
 	BOOST_CHECK(func->Invoke() == 3);
 }
 
+BOOST_AUTO_TEST_CASE(locals)
+{
+	ScriptFrame frame(true);
+	std::unique_ptr<Expression> expr;
+	Function::Ptr func;
+
+	/* Locals from an earlier call must not be visible in the next one. */
+	expr = ConfigCompiler::CompileText("<test>", "function(a) { if (a) { var b = a }; return locals.contains(\"b\") }");
+	func = expr->Evaluate(frame).GetValue();
+	BOOST_CHECK(func->Invoke({ 3 }));
+	BOOST_CHECK(!func->Invoke({ false }));
+
+	/* Locals which are still referenced after the call must not be reused. */
+	expr = ConfigCompiler::CompileText("<test>", "function(a) { return locals }");
+	func = expr->Evaluate(frame).GetValue();
+	Dictionary::Ptr first = func->Invoke({ 1 });
+	Dictionary::Ptr second = func->Invoke({ 2 });
+	BOOST_CHECK(first != second);
+	BOOST_CHECK(first->Get("a") == 1);
+	BOOST_CHECK(second->Get("a") == 2);
+
+	expr = ConfigCompiler::CompileText("<test>", "var x = 5; function(a) use(x) { return a + x }");
+	func = expr->Evaluate(frame).GetValue();
+
+	for (int i = 0; i < 100; i++)
+		BOOST_CHECK(func->Invoke({ i }) == i + 5);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -18,6 +18,9 @@
  ******************************************************************************/
 
 #include "icinga/host.hpp"
+#include "base/json.hpp"
+#include "base/perfdatavalue.hpp"
+#include "base/serializer.hpp"
 #include <BoostTestTargetConfig.h>
 #include <iostream>
 
@@ -50,6 +53,9 @@ static void NotificationHandler(const Checkable::Ptr& checkable, NotificationTyp
 
 static void CheckNotification(const Checkable::Ptr& checkable, bool expected, NotificationType type = NotificationRecovery)
 {
+	/* Notifications are requested asynchronously after the check result was processed. */
+	Checkable::WaitForPostProcessing();
+
 	BOOST_CHECK((expected && checkable->GetExtension("requested_notifications").ToBool()) || (!expected && !checkable->GetExtension("requested_notifications").ToBool()));
 
 	if (expected && checkable->GetExtension("requested_notifications").ToBool())
@@ -757,4 +763,101 @@ BOOST_AUTO_TEST_CASE(service_flapping_ok_over_bad_into_ok)
 
 #endif /* I2_DEBUG */
 }
+
+BOOST_AUTO_TEST_CASE(state_snapshot)
+{
+	Host::Ptr host = new Host();
+	host->SetActive(true);
+	host->SetMaxCheckAttempts(2);
+	host->Activate();
+	host->SetAuthority(true);
+	host->SetStateRaw(ServiceOK);
+	host->SetStateType(StateTypeHard);
+
+	CheckableStateSnapshot::Ptr before = host->GetStateSnapshot();
+	BOOST_CHECK(before->StateRaw == ServiceOK);
+	BOOST_CHECK(before->CurrentStateType == StateTypeHard);
+	BOOST_CHECK(!before->LastCheckResult);
+
+	CheckResult::Ptr cr = MakeCheckResult(ServiceCritical);
+	host->ProcessCheckResult(cr);
+
+	CheckableStateSnapshot::Ptr after = host->GetStateSnapshot();
+	BOOST_CHECK(after->StateRaw == ServiceCritical);
+	BOOST_CHECK(after->CurrentStateType == StateTypeSoft);
+	BOOST_CHECK(after->CheckAttempt == host->GetCheckAttempt());
+	BOOST_CHECK(after->LastCheckResult == cr);
+
+	/* Snapshots are immutable. */
+	BOOST_CHECK(before->StateRaw == ServiceOK);
+
+	host->AcknowledgeProblem("test", "test", AcknowledgementNormal, false);
+	BOOST_CHECK(host->GetStateSnapshot()->IsAcknowledged());
+
+	Checkable::WaitForPostProcessing();
+}
+
+BOOST_AUTO_TEST_CASE(shared_attributes)
+{
+	CheckResult::Ptr cr1 = MakeCheckResult(ServiceOK);
+	CheckResult::Ptr cr2 = MakeCheckResult(ServiceOK);
+
+	BOOST_CHECK(cr1->GetOutput().IsEmpty());
+
+	cr1->SetOutput("OK - everything is fine");
+	cr2->SetOutput("OK - everything is fine");
+	BOOST_CHECK(cr1->GetOutput() == "OK - everything is fine");
+	BOOST_CHECK(cr2->GetOutput() == cr1->GetOutput());
+
+	cr2->SetOutput("OK - something else");
+	BOOST_CHECK(cr1->GetOutput() == "OK - everything is fine");
+	BOOST_CHECK(cr2->GetOutput() == "OK - something else");
+
+	cr1->SetField(CheckResult::TypeInstance->GetFieldId("check_source"), "satellite1");
+	BOOST_CHECK(cr1->GetCheckSource() == "satellite1");
+
+	cr1->SetCommand(new Array({ "/bin/check_ping", "-H", "127.0.0.1" }));
+	cr2->SetCommand(new Array({ "/bin/check_ping", "-H", "127.0.0.1" }));
+	BOOST_CHECK(Array::Ptr(cr1->GetCommand()) == Array::Ptr(cr2->GetCommand()));
+
+	cr2->SetCommand(new Array({ "/bin/check_ping", "-H", "127.0.0.2" }));
+	BOOST_CHECK(Array::Ptr(cr1->GetCommand()) != Array::Ptr(cr2->GetCommand()));
+	BOOST_CHECK(Array::Ptr(cr2->GetCommand())->Get(2) == "127.0.0.2");
+
+	cr1->SetCommand("/bin/true");
+	BOOST_CHECK(cr1->GetCommand() == "/bin/true");
+}
+
+BOOST_AUTO_TEST_CASE(from_message)
+{
+	CheckResult::Ptr cr = MakeCheckResult(ServiceWarning);
+	cr->SetOutput("WARNING - load average: 5.00");
+	cr->SetExitStatus(1);
+	cr->SetCommand(new Array({ "/bin/check_load", "-w", "4" }));
+	cr->SetPerformanceData(new Array({ new PerfdataValue("load1", 5, false, "", 4), "invalid" }));
+
+	Dictionary::Ptr data = JsonDecode(JsonEncode(Serialize(cr)));
+	CheckResult::Ptr result = CheckResult::FromMessage(data);
+
+	BOOST_CHECK(result->GetState() == ServiceWarning);
+	BOOST_CHECK(result->GetOutput() == "WARNING - load average: 5.00");
+	BOOST_CHECK(result->GetExitStatus() == 1);
+	BOOST_CHECK(result->GetExecutionEnd() == cr->GetExecutionEnd());
+	BOOST_CHECK(Array::Ptr(result->GetCommand())->Get(0) == "/bin/check_load");
+
+	Array::Ptr perfdata = result->GetPerformanceData();
+	BOOST_CHECK(perfdata->GetLength() == 2);
+
+	PerfdataValue::Ptr pdv = perfdata->Get(0);
+	BOOST_CHECK(pdv->GetLabel() == "load1");
+	BOOST_CHECK(pdv->GetValue() == 5);
+	BOOST_CHECK(pdv->GetWarn() == 4);
+	BOOST_CHECK(perfdata->Get(1) == "invalid");
+
+	/* Invalid values are ignored just like with Deserialize(). */
+	data->Set("vars_after", "not a dictionary");
+	result = CheckResult::FromMessage(data);
+	BOOST_CHECK(!result->GetVarsAfter());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "icinga/checkresultqueue.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(icinga_checkresultqueue)
+
+BOOST_AUTO_TEST_CASE(batches)
+{
+	WorkQueue wq;
+	wq.SetName("Test");
+
+	/* Keep the work queue busy until all check results have been queued. */
+	boost::mutex mutex;
+	boost::condition_variable cv;
+	bool release = false;
+
+	wq.Enqueue([&mutex, &cv, &release]() {
+		boost::mutex::scoped_lock lock(mutex);
+
+		while (!release)
+			cv.wait(lock);
+	});
+
+	std::vector<std::vector<CheckResult::Ptr> > batches;
+
+	CheckResultQueue::Ptr queue = new CheckResultQueue("Test", wq, [&batches](const std::vector<CheckResultEvent>& events) {
+		std::vector<CheckResult::Ptr> batch;
+
+		for (const CheckResultEvent& event : events)
+			batch.push_back(event.Result);
+
+		batches.push_back(batch);
+	}, PriorityNormal, 3, 2);
+
+	queue->Start();
+
+	std::vector<CheckResult::Ptr> results;
+
+	for (int i = 0; i < 5; i++) {
+		CheckResult::Ptr cr = new CheckResult();
+		results.push_back(cr);
+		Checkable::OnNewCheckResult(nullptr, cr, nullptr);
+	}
+
+	queue->Stop();
+
+	/* Not delivered after Stop(). */
+	Checkable::OnNewCheckResult(nullptr, new CheckResult(), nullptr);
+
+	BOOST_CHECK(queue->GetLength() == 3);
+	BOOST_CHECK(queue->GetDroppedResults() == 2);
+
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		release = true;
+		cv.notify_all();
+	}
+
+	wq.Join();
+
+	BOOST_CHECK(queue->GetLength() == 0);
+	BOOST_CHECK(queue->GetDeliveredBatches() == 2);
+	BOOST_REQUIRE(batches.size() == 2);
+	BOOST_CHECK(batches[0] == std::vector<CheckResult::Ptr>({ results[0], results[1] }));
+	BOOST_CHECK(batches[1] == std::vector<CheckResult::Ptr>({ results[2] }));
+}
+
+BOOST_AUTO_TEST_CASE(shared_metrics)
+{
+	WorkQueue wq;
+	wq.SetName("Test");
+
+	std::vector<CheckResultMetrics::Ptr> metrics;
+
+	auto handler = [&metrics](const std::vector<CheckResultEvent>& events) {
+		for (const CheckResultEvent& event : events)
+			metrics.push_back(event.Metrics);
+	};
+
+	CheckResultQueue::Ptr queue1 = new CheckResultQueue("Test1", wq, handler);
+	CheckResultQueue::Ptr queue2 = new CheckResultQueue("Test2", wq, handler);
+
+	queue1->Start();
+	queue2->Start();
+
+	Checkable::OnNewCheckResult(nullptr, new CheckResult(), nullptr);
+
+	queue1->Stop();
+	queue2->Stop();
+
+	wq.Join();
+
+	/* Both subscribers get the same metrics object. */
+	BOOST_REQUIRE(metrics.size() == 2);
+	BOOST_CHECK(metrics[0]);
+	BOOST_CHECK(metrics[0] == metrics[1]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
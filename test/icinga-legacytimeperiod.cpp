@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "icinga/legacytimeperiod.hpp"
+#include "icinga/timeperiod.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -103,4 +104,50 @@ BOOST_AUTO_TEST_CASE(simple)
 	BOOST_CHECK_EQUAL(mktime(&end), (time_t) 1456790400); // 2016-03-01
 }
 
+static Dictionary::Ptr MakeSegment(double begin, double end)
+{
+	return new Dictionary({
+		{ "begin", begin },
+		{ "end", end }
+	});
+}
+
+BOOST_AUTO_TEST_CASE(is_inside)
+{
+	TimePeriod::Ptr tp = new TimePeriod();
+
+	/* Without a valid region every timestamp is considered inside. */
+	BOOST_CHECK(tp->IsInside(50));
+
+	Array::Ptr segments = new Array();
+	segments->Add(MakeSegment(40, 50));
+	segments->Add(MakeSegment(10, 20));
+	segments->Add(MakeSegment(15, 30));
+	segments->Add(MakeSegment(50, 60));
+
+	tp->SetValidBegin(0);
+	tp->SetValidEnd(100);
+	tp->SetSegments(segments);
+
+	BOOST_CHECK(!tp->IsInside(5));
+	BOOST_CHECK(!tp->IsInside(10));
+	BOOST_CHECK(tp->IsInside(12));
+	BOOST_CHECK(tp->IsInside(25));
+	BOOST_CHECK(!tp->IsInside(30));
+	BOOST_CHECK(!tp->IsInside(35));
+	BOOST_CHECK(tp->IsInside(45));
+	BOOST_CHECK(!tp->IsInside(50));
+	BOOST_CHECK(tp->IsInside(55));
+	BOOST_CHECK(!tp->IsInside(70));
+	BOOST_CHECK(tp->IsInside(150));
+
+	/* Replacing the segments must not use the stale index. */
+	segments = new Array();
+	segments->Add(MakeSegment(60, 80));
+	tp->SetSegments(segments);
+
+	BOOST_CHECK(!tp->IsInside(12));
+	BOOST_CHECK(tp->IsInside(70));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
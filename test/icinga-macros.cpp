@@ -18,6 +18,7 @@
  ******************************************************************************/
 
 #include "icinga/macroprocessor.hpp"
+#include "base/json.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -64,4 +65,71 @@ BOOST_AUTO_TEST_CASE(simple)
 
 }
 
+BOOST_AUTO_TEST_CASE(arguments)
+{
+	Dictionary::Ptr macros = new Dictionary();
+	macros->Set("warning", 10);
+
+	MacroProcessor::ResolverList resolvers;
+	resolvers.emplace_back("macros", macros);
+
+	Dictionary::Ptr arguments = new Dictionary({
+		{ "-w", "$warning$" },
+		{ "-c", "$critical$" },
+		{ "-v", new Dictionary({ { "set_if", "false" } }) },
+		{ "-H", new Dictionary({ { "value", "localhost" }, { "order", -1 } }) },
+		{ "-t", 30 }
+	});
+
+	CompiledCommandArguments::Ptr compiled = MacroProcessor::CompileArguments(arguments);
+
+	/* set_if without macros is evaluated when compiling the arguments. */
+	BOOST_CHECK(compiled->Arguments.size() == 4);
+	BOOST_CHECK(compiled->Arguments[0].Key == "-H");
+
+	Array::Ptr result = MacroProcessor::ResolveCompiledArguments(new Array({ "check_foo" }), compiled,
+		resolvers, nullptr, nullptr, false);
+	BOOST_CHECK(JsonEncode(result) == "[\"check_foo\",\"-H\",\"localhost\",\"-t\",\"30\",\"-w\",\"10\"]");
+
+	/* Compiled arguments are reused with different macro values. */
+	macros->Set("warning", 20);
+	macros->Set("critical", 30);
+
+	result = MacroProcessor::ResolveCompiledArguments(new Array({ "check_foo" }), compiled,
+		resolvers, nullptr, nullptr, false);
+	BOOST_CHECK(JsonEncode(result) == "[\"check_foo\",\"-H\",\"localhost\",\"-c\",\"30\",\"-t\",\"30\",\"-w\",\"20\"]");
+
+	Array::Ptr uncompiled = MacroProcessor::ResolveArguments(new Array({ "check_foo" }), arguments,
+		resolvers, nullptr, nullptr, false);
+	BOOST_CHECK(JsonEncode(uncompiled) == JsonEncode(result));
+}
+
+BOOST_AUTO_TEST_CASE(resolution_scope)
+{
+	Dictionary::Ptr macros = new Dictionary({ { "address", "127.0.0.1" } });
+
+	MacroProcessor::ResolverList resolvers;
+	resolvers.emplace_back("macros", macros);
+
+	{
+		MacroResolutionScope scope;
+
+		BOOST_CHECK(MacroProcessor::ResolveMacros("$macros.address$", resolvers) == "127.0.0.1");
+
+		/* Values are memoised for the rest of the scope. */
+		macros->Set("address", "::1");
+		BOOST_CHECK(MacroProcessor::ResolveMacros("$macros.address$", resolvers) == "127.0.0.1");
+
+		/* Missing macros are not. */
+		String missingMacro;
+		MacroProcessor::ResolveMacros("$port$", resolvers, nullptr, &missingMacro);
+		BOOST_CHECK(missingMacro == "port");
+
+		macros->Set("port", 22);
+		BOOST_CHECK(MacroProcessor::ResolveMacros("$port$", resolvers) == "22");
+	}
+
+	BOOST_CHECK(MacroProcessor::ResolveMacros("$macros.address$", resolvers) == "::1");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
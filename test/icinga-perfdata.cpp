@@ -19,6 +19,7 @@
 
 #include "base/perfdatavalue.hpp"
 #include "icinga/pluginutility.hpp"
+#include "icinga/checkresult.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -127,6 +128,19 @@ BOOST_AUTO_TEST_CASE(ignore_invalid_warn_crit_min_max)
 	BOOST_CHECK(pv->Format() == "test=123456");
 }
 
+BOOST_AUTO_TEST_CASE(numbers)
+{
+	PerfdataValue::Ptr pv = PerfdataValue::Parse("test=0.1;-12.5e-3;1e23;+7;0.30000000000000004");
+	BOOST_CHECK(pv->GetValue() == 0.1);
+	BOOST_CHECK(pv->GetWarn() == -0.0125);
+	BOOST_CHECK(pv->GetCrit() == 1e23);
+	BOOST_CHECK(pv->GetMin() == 7);
+	BOOST_CHECK(pv->GetMax() == 0.30000000000000004);
+
+	pv = PerfdataValue::Parse("test=12345678901234567890");
+	BOOST_CHECK(pv->GetValue() == 12345678901234567890.0);
+}
+
 BOOST_AUTO_TEST_CASE(invalid)
 {
 	BOOST_CHECK_THROW(PerfdataValue::Parse("123456"), boost::exception);
@@ -140,4 +154,24 @@ BOOST_AUTO_TEST_CASE(multi)
 	BOOST_CHECK(pd->Get(1) == "test::b=4");
 }
 
+BOOST_AUTO_TEST_CASE(parsed)
+{
+	CheckResult::Ptr cr = new CheckResult();
+	cr->SetPerformanceData(PluginUtility::SplitPerfdata("load1=0.5;1;2 invalid=x load5=0.25s"));
+
+	Array::Ptr pd = cr->GetParsedPerformanceData();
+	BOOST_CHECK(pd->GetLength() == 2);
+
+	PerfdataValue::Ptr pv = pd->Get(1);
+	BOOST_CHECK(pv->GetLabel() == "load5");
+	BOOST_CHECK(pv->GetValue() == 0.25);
+	BOOST_CHECK(pv->GetUnit() == "seconds");
+
+	/* The values are only parsed once. */
+	BOOST_CHECK(cr->GetParsedPerformanceData() == pd);
+
+	cr->SetPerformanceData(PluginUtility::SplitPerfdata("users=3"));
+	BOOST_CHECK(cr->GetParsedPerformanceData()->GetLength() == 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
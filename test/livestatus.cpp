@@ -18,9 +18,15 @@
  ******************************************************************************/
 
 #include "livestatus/livestatusquery.hpp"
+#include "livestatus/avgaggregator.hpp"
+#include "livestatus/stdaggregator.hpp"
+#include "livestatus/minaggregator.hpp"
+#include "livestatus/maxaggregator.hpp"
+#include "livestatus/sumaggregator.hpp"
 #include "base/application.hpp"
 #include "base/stdiostream.hpp"
 #include "base/json.hpp"
+#include "base/utility.hpp"
 #include <BoostTestTargetConfig.h>
 
 using namespace icinga;
@@ -119,6 +125,128 @@ BOOST_AUTO_TEST_CASE(services)
 
 	BOOST_TEST_MESSAGE("Done with testing livestatus services...");
 }
+
+BOOST_AUTO_TEST_CASE(services_filter)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET services");
+	lines.emplace_back("Columns: host_name service_description");
+	lines.emplace_back("Filter: host_name = test-01");
+	lines.emplace_back("Filter: description = livestatus");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	Array::Ptr query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	BOOST_CHECK(query_result->GetLength() == 1);
+
+	Array::Ptr res1 = query_result->Get(0);
+
+	BOOST_CHECK(res1->Get(0) == "test-01");
+	BOOST_CHECK(res1->Get(1) == "livestatus");
+
+	lines.clear();
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Columns: name");
+	lines.emplace_back("Filter: name = test-02");
+	lines.emplace_back("Filter: address = 127.0.0.1");
+	lines.emplace_back("OutputFormat: json");
+	lines.emplace_back("\n");
+
+	query_result = JsonDecode(LivestatusQueryHelper(lines));
+
+	/* the index only selects candidates, all other filters are still applied */
+	BOOST_CHECK(query_result->GetLength() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(output_formats)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET services");
+	lines.emplace_back("Columns: host_name notes check_interval");
+	lines.emplace_back("Filter: host_name = test-01");
+	lines.emplace_back("Filter: description = livestatus");
+	lines.emplace_back("ColumnHeaders: on");
+	lines.emplace_back("\n");
+
+	BOOST_CHECK(LivestatusQueryHelper(lines) == "host_name;notes;check_interval\ntest-01;test livestatus;5\n");
+
+	lines[4] = "OutputFormat: python";
+	BOOST_CHECK(LivestatusQueryHelper(lines) == "[[ r\"test-01\", r\"test livestatus\", 5 ]]\n");
+
+	lines[4] = "OutputFormat: json";
+	BOOST_CHECK(LivestatusQueryHelper(lines) == "[[\"test-01\",\"test livestatus\",5.0]]\n");
+}
+
+BOOST_AUTO_TEST_CASE(wait_query)
+{
+	std::vector<String> lines;
+	lines.emplace_back("GET hosts");
+	lines.emplace_back("Columns: name");
+	lines.emplace_back("Filter: name = test-01");
+	lines.emplace_back("WaitObject: test-01");
+	lines.emplace_back("WaitCondition: address = 127.0.0.1");
+	lines.emplace_back("WaitTimeout: 10000");
+	lines.emplace_back("\n");
+
+	/* The condition is already met, the query doesn't wait. */
+	double start = Utility::GetTime();
+	BOOST_CHECK(LivestatusQueryHelper(lines) == "test-01\n");
+	BOOST_CHECK(Utility::GetTime() - start < 5);
+
+	lines[0] = "GET services";
+	lines[1] = "Columns: host_name";
+	lines[2] = "Filter: description = livestatus";
+	lines[3] = "WaitObject: test-01;livestatus";
+	lines[4] = "WaitCondition: notes = test livestatus";
+
+	start = Utility::GetTime();
+	String output = LivestatusQueryHelper(lines);
+	BOOST_CHECK(output == "test-01\ntest-02\n" || output == "test-02\ntest-01\n");
+	BOOST_CHECK(Utility::GetTime() - start < 5);
+
+	/* The condition isn't met for this object, the query waits until the timeout expires. */
+	lines[0] = "GET hosts";
+	lines[1] = "Columns: name";
+	lines[2] = "Filter: name = test-02";
+	lines[3] = "WaitObject: test-02";
+	lines[4] = "WaitCondition: address = 127.0.0.1";
+	lines[5] = "WaitTimeout: 200";
+
+	start = Utility::GetTime();
+	BOOST_CHECK(LivestatusQueryHelper(lines) == "test-02\n");
+	BOOST_CHECK(Utility::GetTime() - start >= 0.15);
+}
+
+BOOST_AUTO_TEST_CASE(aggregator_merge)
+{
+	Table::Ptr table = Table::GetByName("services");
+	std::vector<LivestatusRowValue> rows = table->FilterRows(nullptr);
+
+	BOOST_CHECK(rows.size() > 1);
+
+	std::vector<Aggregator::Ptr> aggregators;
+	aggregators.emplace_back(new SumAggregator("check_interval"));
+	aggregators.emplace_back(new AvgAggregator("check_interval"));
+	aggregators.emplace_back(new StdAggregator("check_interval"));
+	aggregators.emplace_back(new MinAggregator("check_interval"));
+	aggregators.emplace_back(new MaxAggregator("check_interval"));
+
+	for (const Aggregator::Ptr& aggregator : aggregators) {
+		AggregatorState *state = nullptr;
+		AggregatorState *left = nullptr;
+		AggregatorState *right = nullptr;
+
+		for (size_t i = 0; i < rows.size(); i++) {
+			aggregator->Apply(table, rows[i].Row, &state);
+			aggregator->Apply(table, rows[i].Row, i < rows.size() / 2 ? &left : &right);
+		}
+
+		aggregator->MergeAndFreeState(&left, right);
+
+		BOOST_CHECK_CLOSE(aggregator->GetResultAndFreeState(left), aggregator->GetResultAndFreeState(state), 0.0001);
+	}
+}
 //____________________________________________________________________________//
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,184 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/compiledfilter.hpp"
+#include "remote/filterutility.hpp"
+#include "remote/eventqueue.hpp"
+#include "base/dictionary.hpp"
+#include "base/array.hpp"
+#include "base/convert.hpp"
+#include "base/json.hpp"
+#include "base/scriptframe.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_compiledfilter)
+
+static bool EvaluateEventFilter(const String& text, const Dictionary::Ptr& event, const Dictionary::Ptr& vars = nullptr)
+{
+	CompiledFilter::Ptr filter = CompiledFilter::Compile(text);
+
+	ScriptFrame frame(true);
+	frame.Sandboxed = true;
+
+	if (vars)
+		frame.Self = vars;
+
+	CompiledFilterState state = filter->CreateState();
+
+	bool result = filter->Evaluate(frame, state, event, "event");
+
+	/* The interpreter must come to the same conclusion. */
+	ScriptFrame iframe(true);
+	iframe.Sandboxed = true;
+
+	if (vars)
+		iframe.Self = vars->ShallowClone();
+
+	BOOST_CHECK(FilterUtility::EvaluateFilter(iframe, filter->GetExpression(), event, "event") == result);
+
+	return result;
+}
+
+BOOST_AUTO_TEST_CASE(compile)
+{
+	BOOST_CHECK(CompiledFilter::Compile("event.type == \"CheckResult\" && event.state >= 2")->IsCompiled());
+	BOOST_CHECK(CompiledFilter::Compile("!(event.state in [ 0, 1 ]) || event.vars.env != \"prod\"")->IsCompiled());
+
+	/* Function calls and value-context logical operators are left to the interpreter. */
+	BOOST_CHECK(!CompiledFilter::Compile("match(\"Check*\", event.type)")->IsCompiled());
+	BOOST_CHECK(!CompiledFilter::Compile("(event.a || event.b) == 1")->IsCompiled());
+
+	BOOST_CHECK(CompiledFilter::Compile("event.state == 2") == CompiledFilter::Compile("event.state == 2"));
+}
+
+BOOST_AUTO_TEST_CASE(evaluate)
+{
+	Dictionary::Ptr event = new Dictionary({
+		{ "type", "CheckResult" },
+		{ "state", 2 },
+		{ "vars", new Dictionary({ { "env", "prod" } }) }
+	});
+
+	BOOST_CHECK(EvaluateEventFilter("event.type == \"CheckResult\" && event.state >= 2", event));
+	BOOST_CHECK(!EvaluateEventFilter("event.type == \"StateChange\" || event.state < 2", event));
+	BOOST_CHECK(EvaluateEventFilter("event.vars.env == \"prod\" && !(event.state in [ 0, 1 ])", event));
+	BOOST_CHECK(EvaluateEventFilter("event.vars.missing == null", event));
+	BOOST_CHECK(EvaluateEventFilter("obj.state != 0", event));
+	BOOST_CHECK(EvaluateEventFilter("match(\"Check*\", event.type)", event));
+
+	Dictionary::Ptr vars = new Dictionary({ { "limit", 1 } });
+	BOOST_CHECK(EvaluateEventFilter("event.state > limit", event, vars));
+}
+
+BOOST_AUTO_TEST_CASE(index_hints)
+{
+	CompiledFilter::Ptr filter = CompiledFilter::Compile("event.type == \"CheckResult\" && (\"prod\" in obj.tags && event.state != 0)");
+
+	std::vector<CompiledFilterIndexHint> hints = filter->GetIndexHints(Dictionary::TypeInstance, "event");
+
+	BOOST_CHECK(hints.size() == 2);
+	BOOST_CHECK(hints[0].Operator == ConfigType::IndexEqual);
+	BOOST_CHECK(hints[0].Attribute == "type");
+	BOOST_CHECK(hints[0].Literal == "CheckResult");
+	BOOST_CHECK(hints[1].Operator == ConfigType::IndexContains);
+	BOOST_CHECK(hints[1].Attribute == "tags");
+	BOOST_CHECK(hints[1].Literal == "prod");
+
+	/* Conditions below an || don't have to be satisfied by all matching objects. */
+	filter = CompiledFilter::Compile("event.type == \"CheckResult\" || event.state != 0");
+	BOOST_CHECK(filter->GetIndexHints(Dictionary::TypeInstance, "event").empty());
+}
+
+BOOST_AUTO_TEST_CASE(shared_event_filters)
+{
+	CompiledFilter::Ptr filter = EventQueue::CompileFilter("event.state != 0");
+	BOOST_CHECK(filter == EventQueue::CompileFilter("event.state != 0"));
+	BOOST_CHECK(filter != EventQueue::CompileFilter("event.state == 0"));
+
+	std::vector<EventQueue::Ptr> queues;
+	int clients[3];
+
+	for (int i = 0; i < 3; i++) {
+		EventQueue::Ptr queue = new EventQueue("test" + Convert::ToString(i));
+		queue->AddClient(&clients[i]);
+		queues.push_back(queue);
+	}
+
+	queues[0]->SetFilter(filter);
+	queues[1]->SetFilter(EventQueue::CompileFilter("event.state != 0"));
+
+	Dictionary::Ptr event = new Dictionary({ { "state", 2 } });
+	EventQueue::ProcessEvent(queues, event);
+	EventQueue::ProcessEvent(queues, new Dictionary({ { "state", 0 } }));
+
+	std::shared_ptr<const String> body0 = queues[0]->WaitForEvent(&clients[0], 0);
+	std::shared_ptr<const String> body1 = queues[1]->WaitForEvent(&clients[1], 0);
+	std::shared_ptr<const String> body2 = queues[2]->WaitForEvent(&clients[2], 0);
+
+	/* All queues write the same encoded event. */
+	BOOST_CHECK(body0 && body0 == body1 && body1 == body2);
+	BOOST_CHECK(*body0 == JsonEncode(event) + "\n");
+
+	BOOST_CHECK(!queues[0]->WaitForEvent(&clients[0], 0));
+	BOOST_CHECK(!queues[1]->WaitForEvent(&clients[1], 0));
+	BOOST_CHECK(queues[2]->WaitForEvent(&clients[2], 0));
+}
+
+BOOST_AUTO_TEST_CASE(event_queue_overflow)
+{
+	int client;
+	EventQueue::Ptr queue = new EventQueue("overflow");
+	queue->AddClient(&client);
+	queue->SetCapacity(2);
+
+	for (int i = 0; i < 3; i++)
+		queue->ProcessEvent(new Dictionary({ { "id", i } }));
+
+	/* The oldest event was dropped. */
+	BOOST_CHECK(*queue->WaitForEvent(&client, 0) == JsonEncode(new Dictionary({ { "id", 1 } })) + "\n");
+
+	Dictionary::Ptr status = queue->GetStatus();
+	BOOST_CHECK(status->Get("dropped") == 1);
+	BOOST_CHECK(status->Get("overflow_policy") == "drop-oldest");
+
+	Array::Ptr clients = status->Get("clients");
+	BOOST_CHECK(clients->GetLength() == 1);
+	BOOST_CHECK(Dictionary::Ptr(clients->Get(0))->Get("queue_items") == 1);
+
+	queue->SetOverflowPolicy(EventQueueDropNewest);
+	queue->ProcessEvent(new Dictionary({ { "id", 3 } }));
+	queue->ProcessEvent(new Dictionary({ { "id", 4 } }));
+
+	BOOST_CHECK(*queue->WaitForEvent(&client, 0) == JsonEncode(new Dictionary({ { "id", 2 } })) + "\n");
+	BOOST_CHECK(*queue->WaitForEvent(&client, 0) == JsonEncode(new Dictionary({ { "id", 3 } })) + "\n");
+	BOOST_CHECK(!queue->WaitForEvent(&client, 0));
+
+	queue->SetOverflowPolicy(EventQueueDisconnect);
+
+	for (int i = 0; i < 3; i++)
+		queue->ProcessEvent(new Dictionary({ { "id", i } }));
+
+	BOOST_CHECK(queue->HasOverflowed(&client));
+	BOOST_CHECK(!queue->WaitForEvent(&client, 0));
+	BOOST_CHECK(queue->GetStatus()->Get("dropped") == 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
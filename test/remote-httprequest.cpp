@@ -0,0 +1,109 @@
+/******************************************************************************
+ * Icinga 2                                                                   *
+ * Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)  *
+ *                                                                            *
+ * This program is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU General Public License                *
+ * as published by the Free Software Foundation; either version 2             *
+ * of the License, or (at your option) any later version.                     *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU General Public License for more details.                               *
+ *                                                                            *
+ * You should have received a copy of the GNU General Public License          *
+ * along with this program; if not, write to the Free Software Foundation     *
+ * Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.             *
+ ******************************************************************************/
+
+#include "remote/httprequest.hpp"
+#include "base/fifo.hpp"
+#include <BoostTestTargetConfig.h>
+
+using namespace icinga;
+
+BOOST_AUTO_TEST_SUITE(remote_httprequest)
+
+static void ParseRequest(HttpRequest& request, StreamReadContext& context)
+{
+	while (!request.CompleteHeaders)
+		BOOST_REQUIRE(request.ParseHeaders(context, false));
+
+	while (!request.CompleteBody)
+		BOOST_REQUIRE(request.ParseBody(context, false));
+}
+
+BOOST_AUTO_TEST_CASE(parse_headers)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	String data = "GET /v1/objects/hosts?filter=true HTTP/1.0\r\n"
+		"Accept :  application/json \r\n"
+		"X-HTTP-Method-Override: POST\r\n"
+		"\r\n";
+	fifo->Write(data.CStr(), data.GetLength());
+
+	StreamReadContext context;
+	HttpRequest request(fifo);
+	ParseRequest(request, context);
+
+	BOOST_CHECK(request.RequestMethod == "POST");
+	BOOST_CHECK(request.RequestUrl->Format(true) == "/v1/objects/hosts?filter=true");
+	BOOST_CHECK(request.ProtocolVersion == HttpVersion10);
+	BOOST_CHECK(request.Headers->GetLength() == 2);
+	BOOST_CHECK(request.Headers->Get("accept") == "application/json");
+	BOOST_CHECK(request.Headers->Get("x-http-method-override") == "POST");
+	BOOST_CHECK(context.Size == 0);
+}
+
+BOOST_AUTO_TEST_CASE(invalid_request_line)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	String data = "GET  /v1 HTTP/1.1\r\n\r\n";
+	fifo->Write(data.CStr(), data.GetLength());
+
+	StreamReadContext context;
+	HttpRequest request(fifo);
+	BOOST_CHECK_THROW(request.ParseHeaders(context, false), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(pipelined)
+{
+	FIFO::Ptr fifo = new FIFO();
+
+	/* Both requests arrive in the same read. */
+	String data = "POST /v1/actions/a HTTP/1.1\r\n"
+		"Content-Length: 4\r\n"
+		"\r\n"
+		"test"
+		"GET /v1/status HTTP/1.1\r\n"
+		"Host: localhost\r\n"
+		"\r\n";
+	fifo->Write(data.CStr(), data.GetLength());
+
+	StreamReadContext context;
+
+	HttpRequest first(fifo);
+	ParseRequest(first, context);
+
+	BOOST_CHECK(first.RequestMethod == "POST");
+	BOOST_CHECK(first.RequestUrl->Format(true) == "/v1/actions/a");
+
+	char body[16];
+	BOOST_CHECK(first.ReadBody(body, sizeof(body)) == 4);
+	BOOST_CHECK(String(body, body + 4) == "test");
+
+	BOOST_CHECK(context.Size > 0);
+
+	HttpRequest second(fifo);
+	ParseRequest(second, context);
+
+	BOOST_CHECK(second.RequestMethod == "GET");
+	BOOST_CHECK(second.RequestUrl->Format(true) == "/v1/status");
+	BOOST_CHECK(second.Headers->Get("host") == "localhost");
+	BOOST_CHECK(context.Size == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
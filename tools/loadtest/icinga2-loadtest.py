@@ -0,0 +1,481 @@
+#!/usr/bin/env python3
+# Icinga 2
+# Copyright (C) 2012-2018 Icinga Development Team (https://www.icinga.com/)
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software Foundation
+# Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+
+"""Starts Icinga 2 with a generated configuration, puts it under load and
+reports check result throughput, latencies and memory usage."""
+
+import argparse
+import base64
+import http.client
+import http.server
+import json
+import os
+import shutil
+import socketserver
+import ssl
+import stat
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+API_USER = "loadtest"
+API_PASSWORD = "loadtest"
+NODE_NAME = "loadtest"
+
+WRITERS = ("graphite", "opentsdb", "gelf", "influxdb", "elasticsearch")
+
+
+def generate_config(args, workdir, sink_ports):
+    lines = [
+        'include <itl>',
+        '',
+        'const NodeName = "%s"' % NODE_NAME,
+        'const ZoneName = "%s"' % NODE_NAME,
+        '',
+        'object Endpoint NodeName { }',
+        'object Zone ZoneName { endpoints = [ NodeName ] }',
+        '',
+        'object ApiListener "api" {',
+        '  bind_host = "127.0.0.1"',
+        '  bind_port = %d' % args.api_port,
+        '}',
+        '',
+        'object ApiUser "%s" {' % API_USER,
+        '  password = "%s"' % API_PASSWORD,
+        '  permissions = [ "*" ]',
+        '}',
+        '',
+        'object CheckerComponent "checker" { }',
+        'object ExternalCommandListener "command" {',
+        '  command_path = "%s"' % os.path.join(workdir, "icinga2.cmd"),
+        '}',
+        '',
+    ]
+
+    for writer in args.writers:
+        port = sink_ports[writer]
+
+        if writer == "graphite":
+            lines.append('object GraphiteWriter "loadtest" { host = "127.0.0.1"; port = %d }' % port)
+        elif writer == "opentsdb":
+            lines.append('object OpenTsdbWriter "loadtest" { host = "127.0.0.1"; port = %d }' % port)
+        elif writer == "gelf":
+            lines.append('object GelfWriter "loadtest" { host = "127.0.0.1"; port = %d }' % port)
+        elif writer == "influxdb":
+            lines.append('object InfluxdbWriter "loadtest" { host = "127.0.0.1"; port = %d }' % port)
+        elif writer == "elasticsearch":
+            lines.append('object ElasticsearchWriter "loadtest" { host = "127.0.0.1"; port = %d; index = "icinga2" }' % port)
+
+    lines += [
+        '',
+        'for (i in range(%d)) {' % args.hosts,
+        '  object Host "loadtest-host-" + i {',
+        '    check_command = "%s"' % args.check_command,
+        '    check_interval = %ds' % args.check_interval,
+        '    retry_interval = %ds' % args.check_interval,
+        '  }',
+        '}',
+        '',
+        'apply Service "active-" for (i in range(%d)) {' % args.services,
+        '  check_command = "%s"' % args.check_command,
+        '  check_interval = %ds' % args.check_interval,
+        '  retry_interval = %ds' % args.check_interval,
+        '  assign where match("loadtest-host-*", host.name)',
+        '}',
+        '',
+        'apply Service "passive-" for (i in range(%d)) {' % args.passive_services,
+        '  check_command = "passive"',
+        '  enable_active_checks = false',
+        '  assign where match("loadtest-host-*", host.name)',
+        '}',
+    ]
+
+    with open(os.path.join(workdir, "icinga2.conf"), "w") as fp:
+        fp.write("\n".join(lines) + "\n")
+
+
+def daemon_command(args, workdir, *command):
+    return [args.icinga2] + list(command) + [
+        "-DLocalStateDir=" + os.path.join(workdir, "var"),
+        "-DRunDir=" + os.path.join(workdir, "run"),
+        "-DSysconfDir=" + os.path.join(workdir, "etc"),
+    ]
+
+
+def prepare_workdir(args, workdir):
+    certs = os.path.join(workdir, "var", "lib", "icinga2", "certs")
+
+    for path in (certs, os.path.join(workdir, "run", "icinga2"), os.path.join(workdir, "etc", "icinga2")):
+        os.makedirs(path, exist_ok=True)
+
+    # A self-signed certificate doubles as the CA, the clients don't verify it.
+    key = os.path.join(certs, NODE_NAME + ".key")
+    cert = os.path.join(certs, NODE_NAME + ".crt")
+
+    subprocess.check_call([args.icinga2, "pki", "new-cert", "--cn", NODE_NAME, "--key", key, "--cert", cert],
+                          stdout=subprocess.DEVNULL)
+    shutil.copy(cert, os.path.join(certs, "ca.crt"))
+
+
+class DiscardHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        while self.request.recv(65536):
+            pass
+
+
+class HttpSinkHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def do_POST(self):
+        self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+        if self.server.status == 204:
+            self.send_response(204)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+        else:
+            body = b'{"took":1,"errors":false,"items":[]}'
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+class ThreadingTCPServer(socketserver.ThreadingMixIn, socketserver.TCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+class ThreadingHTTPServer(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+
+def start_sinks(writers):
+    """Starts a local endpoint for each writer which accepts and discards its data."""
+    ports = {}
+
+    for writer in writers:
+        if writer in ("influxdb", "elasticsearch"):
+            server = ThreadingHTTPServer(("127.0.0.1", 0), HttpSinkHandler)
+            server.status = 204 if writer == "influxdb" else 200
+        else:
+            server = ThreadingTCPServer(("127.0.0.1", 0), DiscardHandler)
+
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        ports[writer] = server.server_address[1]
+
+    return ports
+
+
+class ApiClient(object):
+    def __init__(self, port):
+        self.port = port
+        self.context = ssl.create_default_context()
+        self.context.check_hostname = False
+        self.context.verify_mode = ssl.CERT_NONE
+        self.auth = "Basic " + base64.b64encode(("%s:%s" % (API_USER, API_PASSWORD)).encode()).decode()
+        self.connection = None
+
+    def request(self, method, url, body=None):
+        if self.connection is None:
+            self.connection = http.client.HTTPSConnection("127.0.0.1", self.port, context=self.context, timeout=30)
+
+        headers = {"Accept": "application/json", "Authorization": self.auth}
+
+        if body is not None:
+            body = json.dumps(body)
+            headers["Content-Type"] = "application/json"
+
+        try:
+            self.connection.request(method, url, body, headers)
+            response = self.connection.getresponse()
+            data = response.read()
+        except (OSError, http.client.HTTPException):
+            self.connection.close()
+            self.connection = None
+            raise
+
+        if response.status >= 300:
+            raise RuntimeError("%s %s failed: %d %s" % (method, url, response.status, data[:200]))
+
+        return json.loads(data.decode())
+
+    def status(self, name):
+        return self.request("GET", "/v1/status/" + name)["results"][0]["status"]
+
+
+class PassiveDriver(threading.Thread):
+    """Submits passive check results at a fixed rate, either via the API or the command pipe."""
+
+    def __init__(self, args, workdir, mode, rate, offset):
+        threading.Thread.__init__(self, daemon=True)
+        self.args = args
+        self.mode = mode
+        self.interval = 1.0 / rate
+        self.offset = offset
+        self.sent = 0
+        self.errors = 0
+        self.stop = threading.Event()
+        self.command_path = os.path.join(workdir, "icinga2.cmd")
+
+    def targets(self):
+        i = self.offset
+
+        while True:
+            host = i % self.args.hosts
+            service = (i // self.args.hosts) % self.args.passive_services
+            yield "loadtest-host-%d" % host, "passive-%d" % service
+            i += 1
+
+    def run(self):
+        client = ApiClient(self.args.api_port) if self.mode == "api" else None
+        pipe = open(self.command_path, "w") if self.mode == "pipe" else None
+        next_time = time.time()
+
+        for host, service in self.targets():
+            if self.stop.is_set():
+                break
+
+            state = self.sent % 4
+            output = "Load test result %d" % self.sent
+            perfdata = "time=%.3fs;1;2;0 size=%dB;;;0" % (self.sent % 1000 / 1000.0, self.sent)
+
+            try:
+                if client:
+                    client.request("POST", "/v1/actions/process-check-result", {
+                        "type": "Service",
+                        "service": "%s!%s" % (host, service),
+                        "exit_status": state,
+                        "plugin_output": output,
+                        "performance_data": perfdata.split(" ")
+                    })
+                else:
+                    pipe.write("[%d] PROCESS_SERVICE_CHECK_RESULT;%s;%s;%d;%s|%s\n"
+                               % (time.time(), host, service, state, output, perfdata))
+                    pipe.flush()
+
+                self.sent += 1
+            except Exception:
+                self.errors += 1
+
+            next_time += self.interval
+            delay = next_time - time.time()
+
+            if delay > 0:
+                time.sleep(delay)
+            elif delay < -1:
+                # Don't try to catch up after a stall, it would distort the rate.
+                next_time = time.time()
+
+        if pipe:
+            pipe.close()
+
+
+def get_rss(pid):
+    with open("/proc/%d/status" % pid) as fp:
+        for line in fp:
+            if line.startswith("VmRSS:"):
+                return int(line.split()[1]) * 1024
+
+    return 0
+
+
+def wait_for_api(client, process, timeout):
+    deadline = time.time() + timeout
+
+    while time.time() < deadline:
+        if process.poll() is not None:
+            raise RuntimeError("Icinga 2 exited with code %d during startup." % process.returncode)
+
+        try:
+            client.status("IcingaApplication")
+            return
+        except Exception:
+            time.sleep(0.5)
+
+    raise RuntimeError("The API did not become available within %d seconds." % timeout)
+
+
+def wait_for_pipe(path, timeout):
+    deadline = time.time() + timeout
+
+    # Opening the path before the listener has created the FIFO would create a regular file.
+    while time.time() < deadline:
+        if os.path.exists(path) and stat.S_ISFIFO(os.stat(path).st_mode):
+            return
+
+        time.sleep(0.5)
+
+    raise RuntimeError("The command pipe '%s' was not created within %d seconds." % (path, timeout))
+
+
+def run(args, workdir):
+    sink_ports = start_sinks(args.writers)
+    prepare_workdir(args, workdir)
+    generate_config(args, workdir, sink_ports)
+
+    env = dict(os.environ)
+    env.setdefault("ICINGA2_USER", os.environ.get("USER", "root"))
+    env.setdefault("ICINGA2_GROUP", os.environ.get("USER", "root"))
+
+    log = open(os.path.join(workdir, "icinga2.log"), "w")
+    process = subprocess.Popen(daemon_command(args, workdir, "daemon", "-c", os.path.join(workdir, "icinga2.conf")),
+                               stdout=log, stderr=subprocess.STDOUT, env=env)
+    drivers = []
+
+    try:
+        client = ApiClient(args.api_port)
+        start = time.time()
+        wait_for_api(client, process, args.startup_timeout)
+        startup_time = time.time() - start
+        rss_idle = get_rss(process.pid)
+
+        if args.pipe_rate > 0:
+            wait_for_pipe(os.path.join(workdir, "icinga2.cmd"), args.startup_timeout)
+
+        for mode, rate in (("api", args.api_rate), ("pipe", args.pipe_rate)):
+            if rate <= 0:
+                continue
+
+            per_thread = float(rate) / args.threads
+
+            for i in range(args.threads if mode == "api" else 1):
+                driver = PassiveDriver(args, workdir, mode, per_thread if mode == "api" else rate, i * 7919)
+                driver.start()
+                drivers.append(driver)
+
+        time.sleep(args.duration)
+
+        cib = client.status("CIB")
+        latencies = client.status("LatencyHistogram")
+        rss = get_rss(process.pid)
+    finally:
+        for driver in drivers:
+            driver.stop.set()
+
+        for driver in drivers:
+            driver.join(10)
+
+        process.terminate()
+
+        try:
+            process.wait(60)
+        except subprocess.TimeoutExpired:
+            process.kill()
+
+        log.close()
+
+    objects = args.hosts * (1 + args.services + args.passive_services)
+
+    return {
+        "config": {
+            "hosts": args.hosts,
+            "services_per_host": args.services,
+            "passive_services_per_host": args.passive_services,
+            "check_command": args.check_command,
+            "check_interval": args.check_interval,
+            "writers": args.writers,
+            "api_rate": args.api_rate,
+            "pipe_rate": args.pipe_rate,
+            "duration": args.duration,
+        },
+        "startup_time": startup_time,
+        "results_per_second": {
+            "active": cib["active_host_checks"] + cib["active_service_checks"],
+            "passive": cib["passive_host_checks"] + cib["passive_service_checks"],
+        },
+        "submitted": {
+            "sent": sum(driver.sent for driver in drivers),
+            "errors": sum(driver.errors for driver in drivers),
+        },
+        "latency": {name: latencies[name] for name in ("checker_scheduling_delay", "process_check_result",
+                                                        "process_runtime") if name in latencies},
+        "memory": {
+            "rss_idle": rss_idle,
+            "rss": rss,
+            "rss_per_object": float(rss) / objects,
+        },
+    }
+
+
+def print_report(report):
+    print("Startup time:       %.1fs" % report["startup_time"])
+    print("Active results/s:   %.1f" % report["results_per_second"]["active"])
+    print("Passive results/s:  %.1f (%d submitted, %d errors)" % (report["results_per_second"]["passive"],
+                                                                 report["submitted"]["sent"],
+                                                                 report["submitted"]["errors"]))
+
+    for name, values in sorted(report["latency"].items()):
+        print("%-19s p50 %.4fs  p99 %.4fs  p99.9 %.4fs" % (name + ":", values["p50"], values["p99"], values["p999"]))
+
+    print("RSS:                %.1f MiB (%.1f MiB after startup)" % (report["memory"]["rss"] / 1048576.0,
+                                                                     report["memory"]["rss_idle"] / 1048576.0))
+    print("RSS per object:     %.0f bytes" % report["memory"]["rss_per_object"])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--icinga2", default="icinga2", help="path to the icinga2 binary")
+    parser.add_argument("--hosts", type=int, default=1000, help="number of hosts")
+    parser.add_argument("--services", type=int, default=10, help="number of actively checked services per host")
+    parser.add_argument("--passive-services", type=int, default=1, help="number of passive services per host")
+    parser.add_argument("--check-command", choices=("random", "dummy"), default="random")
+    parser.add_argument("--check-interval", type=int, default=60, help="check interval in seconds")
+    parser.add_argument("--api-rate", type=float, default=0, help="passive results per second via the API")
+    parser.add_argument("--pipe-rate", type=float, default=0, help="passive results per second via the command pipe")
+    parser.add_argument("--threads", type=int, default=4, help="number of API client connections")
+    parser.add_argument("--writer", dest="writers", action="append", choices=WRITERS, default=[],
+                        help="enable a metric writer with a local sink (can be repeated)")
+    parser.add_argument("--duration", type=int, default=120, help="measurement duration in seconds")
+    parser.add_argument("--startup-timeout", type=int, default=300)
+    parser.add_argument("--api-port", type=int, default=15665)
+    parser.add_argument("--workdir", help="keep configuration, state and logs in this directory")
+    parser.add_argument("--json", action="store_true", help="print the report as JSON")
+    args = parser.parse_args()
+
+    if args.passive_services <= 0 and (args.api_rate > 0 or args.pipe_rate > 0):
+        parser.error("--passive-services must be greater than 0 to submit passive results")
+
+    workdir = args.workdir or tempfile.mkdtemp(prefix="icinga2-loadtest.")
+
+    try:
+        report = run(args, workdir)
+    except Exception as ex:
+        print("Load test failed: %s (see %s)" % (ex, os.path.join(workdir, "icinga2.log")), file=sys.stderr)
+        return 1
+
+    if args.json:
+        json.dump(report, sys.stdout, indent=2, sort_keys=True)
+        print()
+    else:
+        print_report(report)
+
+    if not args.workdir:
+        shutil.rmtree(workdir, ignore_errors=True)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -129,25 +129,31 @@ unsigned long ClassCompiler::SDBM(const std::string& str, size_t len = std::stri
 	return hash;
 }
 
-static int TypePreference(const std::string& type)
+/* Orders the members by alignment so that the compiler doesn't have to add
+ * padding between them: 8 byte types first, then int and enums, then bool. */
+static int TypePreference(const Field& field)
 {
+	std::string type = field.Type.GetRealType();
+
 	if (type == "Value")
 		return 0;
 	else if (type == "String")
 		return 1;
-	else if (type == "double")
+	else if (type == "double" || type == "Timestamp")
 		return 2;
 	else if (type.find("::Ptr") != std::string::npos)
 		return 3;
-	else if (type == "int")
-		return 4;
-	else
+	else if (type == "int" || (field.Attributes & FAEnum))
 		return 5;
+	else if (type == "bool")
+		return 6;
+	else
+		return 4;
 }
 
 static bool FieldLayoutCmp(const Field& a, const Field& b)
 {
-	return TypePreference(a.Type.GetRealType()) < TypePreference(b.Type.GetRealType());
+	return TypePreference(a) < TypePreference(b);
 }
 
 static bool FieldTypeCmp(const Field& a, const Field& b)
@@ -327,25 +333,11 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 	m_Impl << ";" << std::endl
 		<< "}" << std::endl << std::endl;
 
-	/* GetFieldInfo */
-	m_Header << "\t" << "Field GetFieldInfo(int id) const override;" << std::endl;
-
-	m_Impl << "Field TypeImpl<" << klass.Name << ">::GetFieldInfo(int id) const" << std::endl
-		<< "{" << std::endl;
-
-	if (!klass.Parent.empty())
-		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount();" << std::endl
-			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::TypeInstance->GetFieldInfo(id); }" << std::endl;
-
+	/* FieldInfos */
 	if (!klass.Fields.empty()) {
-		m_Impl << "\t" << "switch (";
-
-		if (!klass.Parent.empty())
-			m_Impl << "real_id";
-		else
-			m_Impl << "id";
+		m_Header << "\t" << "static const Field FieldInfos[" << klass.Fields.size() << "];" << std::endl;
 
-		m_Impl << ") {" << std::endl;
+		m_Impl << "const Field TypeImpl<" << klass.Name << ">::FieldInfos[" << klass.Fields.size() << "] = {" << std::endl;
 
 		size_t num = 0;
 		for (const Field& field : klass.Fields) {
@@ -358,21 +350,32 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 			else
 				nameref = "nullptr";
 
-			m_Impl << "\t\t" << "case " << num << ":" << std::endl
-					<< "\t\t\t" << "return {" << num << ", \"" << ftype << "\", \"" << field.Name << "\", \"" << (field.NavigationName.empty() ? field.Name : field.NavigationName) << "\", "  << nameref << ", " << field.Attributes << ", " << field.Type.ArrayRank << "};" << std::endl;
+			m_Impl << "\t" << "{" << num << ", \"" << ftype << "\", \"" << field.Name << "\", \"" << (field.NavigationName.empty() ? field.Name : field.NavigationName) << "\", "  << nameref << ", " << field.Attributes << ", " << field.Type.ArrayRank << "}," << std::endl;
 			num++;
 		}
 
-		m_Impl << "\t\t" << "default:" << std::endl
-				<< "\t\t";
+		m_Impl << "};" << std::endl << std::endl;
 	}
 
-	m_Impl << "\t" << "throw std::runtime_error(\"Invalid field ID.\");" << std::endl;
+	/* GetFieldInfo */
+	m_Header << "\t" << "Field GetFieldInfo(int id) const override;" << std::endl;
 
-	if (!klass.Fields.empty())
-		m_Impl << "\t" << "}" << std::endl;
+	m_Impl << "Field TypeImpl<" << klass.Name << ">::GetFieldInfo(int id) const" << std::endl
+		<< "{" << std::endl;
 
-	m_Impl << "}" << std::endl << std::endl;
+	if (!klass.Parent.empty())
+		m_Impl << "\t" << "int real_id = id - " << klass.Parent << "::TypeInstance->GetFieldCount();" << std::endl
+			<< "\t" << "if (real_id < 0) { return " << klass.Parent << "::TypeInstance->GetFieldInfo(id); }" << std::endl;
+
+	if (!klass.Fields.empty()) {
+		std::string idName = klass.Parent.empty() ? "id" : "real_id";
+
+		m_Impl << "\t" << "if (" << idName << " >= 0 && " << idName << " < " << klass.Fields.size() << ")" << std::endl
+			<< "\t\t" << "return FieldInfos[" << idName << "];" << std::endl << std::endl;
+	}
+
+	m_Impl << "\t" << "throw std::runtime_error(\"Invalid field ID.\");" << std::endl
+		<< "}" << std::endl << std::endl;
 
 	/* GetFieldCount */
 	m_Header << "\t" << "int GetFieldCount() const override;" << std::endl;
@@ -568,6 +571,11 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 		<< "{" << std::endl;
 
 	for (const Field& field : klass.Fields) {
+		/* A pure virtual setter can't be called from the constructor, the
+		 * derived class has to initialize the field itself. */
+		if (field.PureSetAccessor)
+			continue;
+
 		m_Impl << "\t" << "Set" << field.GetFriendlyName() << "(" << "GetDefault" << field.GetFriendlyName() << "(), true);" << std::endl;
 	}
 
@@ -658,6 +666,25 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 
 		m_Impl << "}" << std::endl << std::endl;
 		
+		/* VisitFields */
+		m_Header << "public:" << std::endl
+				<< "\t" << "void VisitFields(int attributeTypes, const FieldVisitor& visitor) const override;" << std::endl;
+
+		m_Impl << "void ObjectImpl<" << klass.Name << ">::VisitFields(int attributeTypes, const FieldVisitor& visitor) const" << std::endl
+			<< "{" << std::endl;
+
+		if (!klass.Parent.empty())
+			m_Impl << "\t" << klass.Parent << "::VisitFields(attributeTypes, visitor);" << std::endl << std::endl;
+
+		num = 0;
+		for (const Field& field : klass.Fields) {
+			m_Impl << "\t" << "if (attributeTypes == 0 || (attributeTypes & " << field.Attributes << ") != 0)" << std::endl
+				<< "\t\t" << "visitor(TypeImpl<" << klass.Name << ">::FieldInfos[" << num << "], Get" << field.GetFriendlyName() << "());" << std::endl;
+			num++;
+		}
+
+		m_Impl << "}" << std::endl << std::endl;
+
 		/* ValidateField */
 		m_Header << "public:" << std::endl
 				<< "\t" << "void ValidateField(int id, const Lazy<Value>& lvalue, const ValidationUtils& utils) override;" << std::endl;
@@ -1020,8 +1047,14 @@ void ClassCompiler::HandleClass(const Klass& klass, const ClassDebugInfo&)
 				<< "{" << std::endl;
 
 			if (field.Name != "active") {
-				m_Impl << "\t" << "auto *dobj = dynamic_cast<ConfigObject *>(this);" << std::endl
-					<< "\t" << "if (!dobj || dobj->IsActive())" << std::endl
+				m_Impl << "\t" << "auto *dobj = dynamic_cast<ConfigObject *>(this);" << std::endl;
+
+				/* remember which objects need to be written to the state file */
+				if (field.Attributes & FAState)
+					m_Impl << "\t" << "if (dobj)" << std::endl
+						<< "\t\t" << "dobj->MarkStateDirty();" << std::endl;
+
+				m_Impl << "\t" << "if (!dobj || dobj->IsActive())" << std::endl
 					<< "\t";
 			}
 